@@ -11,20 +11,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <esp_err.h>
 #include <esp_wifi_types.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include "csi_frame.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/**
- * @brief Maximum number of subcarriers in CSI data
- */
-#define CSI_MAX_SUBCARRIERS     64
-
 /**
  * @brief Maximum CSI data length in bytes
  */
@@ -47,7 +44,9 @@ typedef struct {
  * @brief CSI data structure
  */
 typedef struct {
-    uint64_t timestamp;         ///< Timestamp in microseconds
+    uint32_t sequence;          ///< Per-node capture sequence number
+    uint64_t timestamp;         ///< Capture time in microseconds (uptime, or UTC if utc_timestamp)
+    bool utc_timestamp;         ///< timestamp has been converted to UTC
     uint8_t mac[6];            ///< Source MAC address
     int8_t rssi;               ///< RSSI value
     uint8_t channel;           ///< Wi-Fi channel
@@ -60,6 +59,39 @@ typedef struct {
     bool valid;                ///< Data validity flag
 } csi_data_t;
 
+/**
+ * @brief Pipeline stage at which a captured frame was dropped
+ * 
+ * Every captured frame gets the next sequence number, so a receiver sees
+ * a lost frame as a gap. Drops are logged with these codes and reported
+ * as sequence ranges, which lets the receiver name the stage for each gap;
+ * gaps without a report were lost after the frame left the node.
+ */
+typedef enum {
+    CSI_DROP_NONE = 0,
+    CSI_DROP_NO_MEM,            ///< No memory to copy the frame at capture
+    CSI_DROP_BUFFER_FULL,       ///< Capture buffer full
+    CSI_DROP_FILTERED,          ///< Rejected by the CSI filter
+    CSI_DROP_QUEUE_FULL,        ///< Consumer queue full
+    CSI_DROP_HTTP_POLL,         ///< Taken by an /api/csi-data request instead of the stream
+    CSI_DROP_NOT_CONNECTED,     ///< MQTT not connected
+    CSI_DROP_ENCODE,            ///< Serialization failed
+    CSI_DROP_OUTBOX_FULL,       ///< Over the MQTT outbox budget or heap low
+    CSI_DROP_OUTBOX_EXPIRED,    ///< Went stale in the MQTT outbox
+    CSI_DROP_PUBLISH,           ///< esp-mqtt refused the message
+    CSI_DROP_WS_SEND,           ///< WebSocket send could not be queued
+    CSI_DROP_REASON_MAX
+} csi_drop_reason_t;
+
+/**
+ * @brief Run of consecutive sequence numbers dropped for the same reason
+ */
+typedef struct {
+    uint32_t first_sequence;    ///< First dropped sequence number
+    uint16_t count;             ///< Number of consecutive frames
+    uint8_t reason;             ///< csi_drop_reason_t
+} csi_drop_range_t;
+
 /**
  * @brief CSI collector statistics
  */
@@ -71,6 +103,9 @@ typedef struct {
     uint32_t buffer_overruns;  ///< Buffer overrun count
     float average_rssi;        ///< Average RSSI
     uint64_t last_packet_time; ///< Last packet timestamp
+    uint32_t next_sequence;    ///< Sequence number the next captured frame gets
+    uint32_t drops[CSI_DROP_REASON_MAX]; ///< Dropped frames by csi_drop_reason_t
+    uint32_t drop_log_overruns; ///< Drop ranges lost before they were reported
 } csi_collector_stats_t;
 
 /**
@@ -111,6 +146,19 @@ esp_err_t csi_collector_deinit(void);
  */
 bool csi_collector_is_running(void);
 
+/**
+ * @brief Feed a CSI report through the same path as the radio callback
+ * 
+ * Used to replay recorded traces. The report is numbered, processed and
+ * buffered exactly like one from the driver; info->buf is copied.
+ * 
+ * @param info CSI report
+ * @param wait_ms How long to wait for room in the capture buffer before
+ *                handing the report over anyway (0 = never wait)
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not running
+ */
+esp_err_t csi_collector_inject(wifi_csi_info_t *info, uint32_t wait_ms);
+
 /**
  * @brief Get CSI data from the queue
  * @param csi_data Pointer to CSI data structure to fill
@@ -146,6 +194,14 @@ esp_err_t csi_collector_get_stats(csi_collector_stats_t *stats);
  */
 esp_err_t csi_collector_reset_stats(void);
 
+/**
+ * @brief Get the number of frames waiting in the collector pipeline
+ * @param depth Pointer to store the number of queued frames
+ * @param capacity Pointer to store the total queue capacity (optional)
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t csi_collector_get_queue_depth(uint32_t *depth, uint32_t *capacity);
+
 /**
  * @brief Update collector configuration
  * @param config New configuration
@@ -160,6 +216,61 @@ esp_err_t csi_collector_update_config(const csi_collector_config_t *config);
  */
 esp_err_t csi_collector_get_config(csi_collector_config_t *config);
 
+/**
+ * @brief Record that a captured frame was dropped
+ * 
+ * Safe to call from any task, before or after initialization.
+ * 
+ * @param sequence Sequence number of the frame
+ * @param reason Stage that dropped it
+ */
+void csi_collector_record_drop(uint32_t sequence, csi_drop_reason_t reason);
+
+/**
+ * @brief Take the drop ranges recorded since the last call
+ * @param ranges Array to fill, oldest first
+ * @param max_ranges Capacity of ranges
+ * @param count Pointer to store the number of ranges written
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t csi_collector_take_drops(csi_drop_range_t *ranges, size_t max_ranges, size_t *count);
+
+/**
+ * @brief Serialize a drop report
+ * 
+ * Produces {"type":"drops","next_seq":N,"ranges":[[first,count,reason],...]}.
+ * 
+ * @param ranges Drop ranges
+ * @param count Number of ranges
+ * @return Heap-allocated JSON string to free(), or NULL if out of memory
+ */
+char *csi_collector_drops_to_json(const csi_drop_range_t *ranges, size_t count);
+
+/**
+ * @brief Serialize CSI data as the JSON published to <prefix>/csi
+ * 
+ * Produces {"seq":N,"timestamp":T,"mac":"..","rssi":R,...} with the
+ * amplitude and phase arrays when they were computed.
+ * 
+ * @param csi_data CSI data
+ * @return Heap-allocated JSON string to free(), or NULL if out of memory
+ */
+char *csi_collector_data_to_json(const csi_data_t *csi_data);
+
+/**
+ * @brief Size of the binary frame (csi_frame_header_t + raw CSI) of CSI data
+ * @param csi_data CSI data
+ * @return Frame size in bytes
+ */
+size_t csi_collector_frame_size(const csi_data_t *csi_data);
+
+/**
+ * @brief Encode CSI data as a binary frame
+ * @param csi_data CSI data
+ * @param frame Output of csi_collector_frame_size() bytes
+ */
+void csi_collector_encode_frame(const csi_data_t *csi_data, uint8_t *frame);
+
 /**
  * @brief Free CSI data structure memory
  * @param csi_data Pointer to CSI data structure
@@ -0,0 +1,115 @@
+/**
+ * @file csi_features.h
+ * @brief Feature kernels shared by the node and the server
+ *
+ * Kept free of ESP-IDF headers, like csi_frame.h, so that the server-side
+ * feature engine compiles this very code. The kernels use only + - * /
+ * and sqrt in a fixed order and are built with -ffp-contract=off on both
+ * sides, so a frame yields bit-identical features on the device and on
+ * the server. The phase of raw CSI and the FFT twiddles come from
+ * polynomials rather than libm, whose atan2f, sinf and cosf differ between
+ * newlib and glibc.
+ */
+
+#ifndef CSI_FEATURES_H
+#define CSI_FEATURES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_FEATURES_MAX_FFT    1024    ///< Largest transform of csi_features_fft_magnitude()
+
+/**
+ * @brief Amplitude and phase of each subcarrier of raw CSI
+ *
+ * Pairs are read as the radio delivers them to the collector: iq[2i] real,
+ * iq[2i + 1] imaginary. The phase is within 3e-7 of the exact angle, as
+ * close as atan2f gets.
+ *
+ * @param iq 2 * n values
+ * @param amplitude n values, or NULL
+ * @param phase n values in [-pi, pi], or NULL
+ */
+void csi_features_amplitude_phase(const int8_t *iq, uint32_t n, float *amplitude, float *phase);
+
+/**
+ * @brief Mean and population variance of n values
+ *
+ * Summed in index order, so it matches a plain loop over the values.
+ */
+void csi_features_mean_variance(const float *x, uint32_t n, float *mean, float *variance);
+
+/**
+ * @brief Scale amplitudes to unit RMS, removing the gain of the receiver
+ *
+ * All-zero input is copied as is. in and out may be the same.
+ */
+void csi_features_normalize_amplitude(const float *in, uint32_t n, float *out);
+
+/**
+ * @brief Remove the timing and carrier offsets from the phase of a frame
+ *
+ * Unwraps the phase across subcarriers, then subtracts the least-squares
+ * line over the subcarrier index: its slope is the sampling time offset
+ * and its intercept the carrier phase offset, neither of which says
+ * anything about the channel. in and out may be the same.
+ */
+void csi_features_sanitize_phase(const float *in, uint32_t n, float *out);
+
+/**
+ * @brief The last `window` frames of `width` values each
+ *
+ * Storage is the caller's, window * width floats, so the node can keep
+ * it in static memory.
+ */
+typedef struct {
+    float *ring;                ///< window rows of width values, oldest at head once full
+    uint16_t window;            ///< Rows held at most
+    uint16_t width;             ///< Values per row
+    uint16_t count;             ///< Rows held
+    uint16_t head;              ///< Next row written
+} csi_features_window_t;
+
+void csi_features_window_init(csi_features_window_t *w, float *storage, uint16_t window, uint16_t width);
+
+/**
+ * @brief Append a row, dropping the oldest once the window is full
+ */
+void csi_features_window_push(csi_features_window_t *w, const float *row);
+
+/**
+ * @brief Population variance of every column over the rows held
+ *
+ * Computed afresh in two passes from oldest to newest row, so it neither
+ * drifts nor depends on how the rows arrived.
+ *
+ * @param out width values
+ */
+void csi_features_window_variance(const csi_features_window_t *w, float *out);
+
+/**
+ * @brief One column of the rows held, oldest first
+ * @param out count values
+ */
+void csi_features_window_column(const csi_features_window_t *w, uint16_t column, float *out);
+
+/**
+ * @brief Magnitude spectrum of a real series
+ * @param in n values; n a power of two from 2 to CSI_FEATURES_MAX_FFT
+ * @param n Transform length
+ * @param scratch 2 * n floats
+ * @param out n / 2 + 1 magnitudes, DC first
+ * @return false if n is not a supported length
+ */
+bool csi_features_fft_magnitude(const float *in, uint32_t n, float *scratch, float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_FEATURES_H
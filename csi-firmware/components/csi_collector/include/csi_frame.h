@@ -0,0 +1,66 @@
+/**
+ * @file csi_frame.h
+ * @brief Wire format of CSI published by the node
+ *
+ * Kept free of ESP-IDF headers so that receivers built for other
+ * platforms (the server-side ingest daemon, host tools) decode frames
+ * with the very definitions the firmware encodes them with.
+ */
+
+#ifndef CSI_FRAME_H
+#define CSI_FRAME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum number of subcarriers in CSI data
+ */
+#define CSI_MAX_SUBCARRIERS     64
+
+/**
+ * @brief Binary CSI frame
+ *
+ * Wire format of CSI published in binary form. The little-endian header
+ * is followed by raw_len bytes of raw CSI (int8 imaginary/real pairs as
+ * delivered by the radio) when CSI_FRAME_FLAG_RAW is set.
+ */
+#define CSI_FRAME_MAGIC         0x5343  ///< "CS" in little-endian byte order
+#define CSI_FRAME_VERSION       2
+#define CSI_FRAME_FLAG_RAW      0x01    ///< Raw CSI follows the header
+#define CSI_FRAME_FLAG_UTC      0x02    ///< timestamp is UTC, not uptime
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;             ///< CSI_FRAME_MAGIC
+    uint8_t version;            ///< CSI_FRAME_VERSION
+    uint8_t flags;              ///< CSI_FRAME_FLAG_* bits
+    uint32_t sequence;          ///< Per-node capture sequence number
+    uint64_t timestamp;         ///< Capture time in microseconds
+    uint8_t mac[6];             ///< Source MAC address
+    int8_t rssi;                ///< RSSI value
+    uint8_t channel;            ///< Wi-Fi channel
+    uint8_t secondary_channel;  ///< Secondary channel
+    uint8_t subcarrier_count;   ///< Number of subcarriers
+    uint16_t raw_len;           ///< Length of the raw CSI that follows
+} csi_frame_header_t;
+
+/**
+ * @brief Topics under the node's prefix that carry CSI
+ *
+ * JSON from csi_collector_data_to_json() is published to
+ * <prefix>/CSI_TOPIC_JSON, binary frames to <prefix>/CSI_TOPIC_FRAME with
+ * CSI_FRAME_CONTENT_TYPE.
+ */
+#define CSI_TOPIC_JSON          "csi_data"
+#define CSI_TOPIC_FRAME         "csi_frame"
+#define CSI_TOPIC_DROPS         "csi_drops"
+#define CSI_FRAME_CONTENT_TYPE  "application/x-csi-frame"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_FRAME_H
@@ -17,6 +17,7 @@ typedef struct csi_buffer_ctx {
     QueueHandle_t queue;
     SemaphoreHandle_t mutex;
     uint16_t size;
+    uint32_t capacity;
     uint32_t total_items;
     uint32_t dropped_items;
     bool overwrite_enabled;
@@ -34,7 +35,8 @@ esp_err_t csi_buffer_init(csi_buffer_handle_t *handle, uint16_t size)
         return ESP_ERR_NO_MEM;
     }
 
-    ctx->queue = xQueueCreate(size / 64, sizeof(csi_data_t)); // Approximate queue size
+    ctx->capacity = size / 64; // Approximate queue size
+    ctx->queue = xQueueCreate(ctx->capacity, sizeof(csi_data_t));
     if (!ctx->queue) {
         free(ctx);
         return ESP_ERR_NO_MEM;
@@ -158,6 +160,21 @@ esp_err_t csi_buffer_get_stats(csi_buffer_handle_t handle, uint32_t *total_items
     return ESP_OK;
 }
 
+esp_err_t csi_buffer_get_capacity(csi_buffer_handle_t handle, uint32_t *capacity)
+{
+    if (!handle || !capacity) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    csi_buffer_ctx_t *ctx = (csi_buffer_ctx_t *)handle;
+    if (!ctx->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    *capacity = ctx->capacity;
+    return ESP_OK;
+}
+
 esp_err_t csi_buffer_set_overwrite(csi_buffer_handle_t handle, bool enable)
 {
     if (!handle) {
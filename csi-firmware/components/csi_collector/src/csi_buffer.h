@@ -57,6 +57,14 @@ esp_err_t csi_buffer_get_data(csi_buffer_handle_t handle, csi_data_t *data, Tick
 esp_err_t csi_buffer_get_stats(csi_buffer_handle_t handle, uint32_t *total_items, 
                               uint32_t *dropped_items, uint32_t *queue_size);
 
+/**
+ * @brief Get the maximum number of items the buffer can hold
+ * @param handle Buffer handle
+ * @param capacity Pointer to store the capacity
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t csi_buffer_get_capacity(csi_buffer_handle_t handle, uint32_t *capacity);
+
 /**
  * @brief Set buffer overwrite mode
  * @param handle Buffer handle
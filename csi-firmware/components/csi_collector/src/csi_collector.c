@@ -6,17 +6,28 @@
 #include "csi_collector.h"
 #include "csi_filter.h"
 #include "csi_buffer.h"
+#include "csi_features.h"
 #include <string.h>
-#include <math.h>
 #include <esp_log.h>
 #include <esp_wifi.h>
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <cJSON.h>
 
 static const char *TAG = "CSI_COLLECTOR";
 
+/**
+ * @brief Depth of the processed data queue handed to consumers
+ */
+#define CSI_DATA_QUEUE_LEN      10
+
+/**
+ * @brief Drop ranges kept until the next csi_collector_take_drops()
+ */
+#define CSI_DROP_LOG_LEN        32
+
 /**
  * @brief CSI collector context structure
  */
@@ -36,6 +47,23 @@ typedef struct {
 
 static csi_collector_ctx_t s_ctx = {0};
 
+/**
+ * @brief Drop log, a ring of coalesced sequence ranges
+ */
+typedef struct {
+    csi_drop_range_t ranges[CSI_DROP_LOG_LEN];
+    uint8_t head;                       ///< Oldest range
+    uint8_t count;                      ///< Ranges held
+    uint32_t drops[CSI_DROP_REASON_MAX]; ///< Dropped frames by reason
+    uint32_t overruns;                  ///< Ranges overwritten before being taken
+} csi_drop_log_t;
+
+static csi_drop_log_t s_drop_log = {0};
+static portMUX_TYPE s_drop_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Outlives init/deinit so sequence numbers never repeat within a boot
+static uint32_t s_next_sequence = 0;
+
 /**
  * @brief CSI data processing task
  * @param pvParameters Task parameters
@@ -52,10 +80,11 @@ static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *data);
 /**
  * @brief Process raw CSI data
  * @param raw_data Raw CSI data from Wi-Fi
+ * @param sequence Sequence number assigned at capture
  * @param processed_data Processed CSI data output
  * @return ESP_OK on success, error code on failure
  */
-static esp_err_t process_csi_data(const wifi_csi_info_t *raw_data, csi_data_t *processed_data);
+static esp_err_t process_csi_data(const wifi_csi_info_t *raw_data, uint32_t sequence, csi_data_t *processed_data);
 
 esp_err_t csi_collector_init(const csi_collector_config_t *config)
 {
@@ -92,7 +121,7 @@ esp_err_t csi_collector_init(const csi_collector_config_t *config)
     }
 
     // Create data queue
-    s_ctx.data_queue = xQueueCreate(10, sizeof(csi_data_t));
+    s_ctx.data_queue = xQueueCreate(CSI_DATA_QUEUE_LEN, sizeof(csi_data_t));
     if (!s_ctx.data_queue) {
         ESP_LOGE(TAG, "Failed to create data queue");
         vSemaphoreDelete(s_ctx.mutex);
@@ -144,6 +173,10 @@ esp_err_t csi_collector_start(void)
         return ESP_OK;
     }
 
+    // Set before the task exists: it runs while s_ctx.running and, at a
+    // higher priority than the caller, starts before xTaskCreate() returns
+    s_ctx.running = true;
+
     // Create processing task
     BaseType_t ret = xTaskCreate(
         csi_process_task,
@@ -156,6 +189,7 @@ esp_err_t csi_collector_start(void)
 
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Failed to create processing task");
+        s_ctx.running = false;
         return ESP_ERR_NO_MEM;
     }
 
@@ -163,6 +197,7 @@ esp_err_t csi_collector_start(void)
     esp_err_t err = esp_wifi_set_csi_rx_cb(wifi_csi_rx_cb, NULL);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register CSI callback: %s", esp_err_to_name(err));
+        s_ctx.running = false;
         vTaskDelete(s_ctx.process_task);
         s_ctx.process_task = NULL;
         return err;
@@ -183,6 +218,7 @@ esp_err_t csi_collector_start(void)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure CSI: %s", esp_err_to_name(err));
         esp_wifi_set_csi_rx_cb(NULL, NULL);
+        s_ctx.running = false;
         vTaskDelete(s_ctx.process_task);
         s_ctx.process_task = NULL;
         return err;
@@ -192,12 +228,12 @@ esp_err_t csi_collector_start(void)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to enable CSI: %s", esp_err_to_name(err));
         esp_wifi_set_csi_rx_cb(NULL, NULL);
+        s_ctx.running = false;
         vTaskDelete(s_ctx.process_task);
         s_ctx.process_task = NULL;
         return err;
     }
 
-    s_ctx.running = true;
     ESP_LOGI(TAG, "CSI collector started");
     
     return ESP_OK;
@@ -241,11 +277,19 @@ esp_err_t csi_collector_deinit(void)
         csi_filter_deinit(s_ctx.filter_handle);
     }
 
+    // Frames still waiting own their data buffers
+    csi_data_t csi_data;
     if (s_ctx.buffer_handle) {
+        while (csi_buffer_get_data(s_ctx.buffer_handle, &csi_data, 0) == ESP_OK) {
+            csi_collector_free_data(&csi_data);
+        }
         csi_buffer_deinit(s_ctx.buffer_handle);
     }
 
     if (s_ctx.data_queue) {
+        while (xQueueReceive(s_ctx.data_queue, &csi_data, 0) == pdTRUE) {
+            csi_collector_free_data(&csi_data);
+        }
         vQueueDelete(s_ctx.data_queue);
     }
 
@@ -264,6 +308,33 @@ bool csi_collector_is_running(void)
     return s_ctx.running;
 }
 
+esp_err_t csi_collector_inject(wifi_csi_info_t *info, uint32_t wait_ms)
+{
+    if (!info || !info->buf) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_ctx.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Back-pressure for replays that run faster than the process task
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(wait_ms);
+    uint32_t capacity = 0;
+    csi_buffer_get_capacity(s_ctx.buffer_handle, &capacity);
+    while (wait_ms > 0 && s_ctx.running) {
+        uint32_t buffered = 0;
+        csi_buffer_get_stats(s_ctx.buffer_handle, NULL, NULL, &buffered);
+        if (buffered < capacity || (int32_t)(deadline - xTaskGetTickCount()) <= 0) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    wifi_csi_rx_cb(NULL, info);
+    return ESP_OK;
+}
+
 esp_err_t csi_collector_get_data(csi_data_t *csi_data, uint32_t timeout_ms)
 {
     if (!csi_data) {
@@ -317,6 +388,12 @@ esp_err_t csi_collector_get_stats(csi_collector_stats_t *stats)
     memcpy(stats, &s_ctx.stats, sizeof(csi_collector_stats_t));
     xSemaphoreGive(s_ctx.mutex);
 
+    taskENTER_CRITICAL(&s_drop_lock);
+    memcpy(stats->drops, s_drop_log.drops, sizeof(stats->drops));
+    stats->drop_log_overruns = s_drop_log.overruns;
+    stats->next_sequence = s_next_sequence;
+    taskEXIT_CRITICAL(&s_drop_lock);
+
     return ESP_OK;
 }
 
@@ -326,6 +403,34 @@ esp_err_t csi_collector_reset_stats(void)
     memset(&s_ctx.stats, 0, sizeof(csi_collector_stats_t));
     xSemaphoreGive(s_ctx.mutex);
 
+    taskENTER_CRITICAL(&s_drop_lock);
+    memset(s_drop_log.drops, 0, sizeof(s_drop_log.drops));
+    s_drop_log.overruns = 0;
+    taskEXIT_CRITICAL(&s_drop_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t csi_collector_get_queue_depth(uint32_t *depth, uint32_t *capacity)
+{
+    if (!depth) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_ctx.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t buffered = 0;
+    uint32_t buffer_capacity = 0;
+    csi_buffer_get_stats(s_ctx.buffer_handle, NULL, NULL, &buffered);
+    csi_buffer_get_capacity(s_ctx.buffer_handle, &buffer_capacity);
+
+    *depth = buffered + (uint32_t)uxQueueMessagesWaiting(s_ctx.data_queue);
+    if (capacity) {
+        *capacity = buffer_capacity + CSI_DATA_QUEUE_LEN;
+    }
+
     return ESP_OK;
 }
 
@@ -413,6 +518,8 @@ static void csi_process_task(void *pvParameters)
                     xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
                     s_ctx.stats.packets_dropped++;
                     xSemaphoreGive(s_ctx.mutex);
+                    csi_collector_record_drop(csi_data.sequence, CSI_DROP_FILTERED);
+                    csi_collector_free_data(&csi_data);
                     continue;
                 }
                 
@@ -429,16 +536,23 @@ static void csi_process_task(void *pvParameters)
             xSemaphoreGive(s_ctx.mutex);
             
             // Send to queue
-            if (xQueueSend(s_ctx.data_queue, &csi_data, 0) != pdTRUE) {
+            bool queued = xQueueSend(s_ctx.data_queue, &csi_data, 0) == pdTRUE;
+            if (!queued) {
                 xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
                 s_ctx.stats.buffer_overruns++;
                 xSemaphoreGive(s_ctx.mutex);
+                csi_collector_record_drop(csi_data.sequence, CSI_DROP_QUEUE_FULL);
             }
             
             // Call callback if registered
             if (s_ctx.callback) {
                 s_ctx.callback(&csi_data, s_ctx.callback_ctx);
             }
+
+            // Nobody else holds the buffers of a frame that did not make the queue
+            if (!queued) {
+                csi_collector_free_data(&csi_data);
+            }
         }
         
         vTaskDelay(pdMS_TO_TICKS(1000 / s_ctx.config.sample_rate));
@@ -454,13 +568,23 @@ static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *data)
         return;
     }
 
+    // Numbered before anything can fail, so every loss shows up as a gap
+    uint32_t sequence = s_next_sequence++;
+
     csi_data_t processed_data;
-    if (process_csi_data(data, &processed_data) == ESP_OK) {
-        if (csi_buffer_put_data(s_ctx.buffer_handle, &processed_data) != ESP_OK) {
-            xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
-            s_ctx.stats.packets_dropped++;
-            xSemaphoreGive(s_ctx.mutex);
-        }
+    csi_drop_reason_t reason = CSI_DROP_NONE;
+    if (process_csi_data(data, sequence, &processed_data) != ESP_OK) {
+        reason = CSI_DROP_NO_MEM;
+    } else if (csi_buffer_put_data(s_ctx.buffer_handle, &processed_data) != ESP_OK) {
+        reason = CSI_DROP_BUFFER_FULL;
+    }
+
+    if (reason != CSI_DROP_NONE) {
+        csi_collector_free_data(&processed_data);
+        csi_collector_record_drop(sequence, reason);
+        xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
+        s_ctx.stats.packets_dropped++;
+        xSemaphoreGive(s_ctx.mutex);
     }
 
     xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
@@ -468,7 +592,7 @@ static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *data)
     xSemaphoreGive(s_ctx.mutex);
 }
 
-static esp_err_t process_csi_data(const wifi_csi_info_t *raw_data, csi_data_t *processed_data)
+static esp_err_t process_csi_data(const wifi_csi_info_t *raw_data, uint32_t sequence, csi_data_t *processed_data)
 {
     if (!raw_data || !processed_data) {
         return ESP_ERR_INVALID_ARG;
@@ -478,11 +602,12 @@ static esp_err_t process_csi_data(const wifi_csi_info_t *raw_data, csi_data_t *p
     memset(processed_data, 0, sizeof(csi_data_t));
     
     // Copy basic information
+    processed_data->sequence = sequence;
     processed_data->timestamp = esp_timer_get_time();
     memcpy(processed_data->mac, raw_data->mac, 6);
-    processed_data->rssi = raw_data->rssi;
-    processed_data->channel = raw_data->channel;
-    processed_data->secondary_channel = raw_data->secondary_channel;
+    processed_data->rssi = raw_data->rx_ctrl.rssi;
+    processed_data->channel = raw_data->rx_ctrl.channel;
+    processed_data->secondary_channel = raw_data->rx_ctrl.secondary_channel;
     processed_data->len = raw_data->len;
     processed_data->valid = true;
 
@@ -499,28 +624,15 @@ static esp_err_t process_csi_data(const wifi_csi_info_t *raw_data, csi_data_t *p
         processed_data->subcarrier_count = CSI_MAX_SUBCARRIERS;
     }
 
-    // Process amplitude and phase if requested
+    // Process amplitude and phase if requested, with the server's kernel
     if (s_ctx.config.enable_amplitude) {
         processed_data->amplitude = malloc(processed_data->subcarrier_count * sizeof(float));
-        if (processed_data->amplitude) {
-            for (int i = 0; i < processed_data->subcarrier_count; i++) {
-                int8_t real = raw_data->buf[i * 2];
-                int8_t imag = raw_data->buf[i * 2 + 1];
-                processed_data->amplitude[i] = sqrtf(real * real + imag * imag);
-            }
-        }
     }
-
     if (s_ctx.config.enable_phase) {
         processed_data->phase = malloc(processed_data->subcarrier_count * sizeof(float));
-        if (processed_data->phase) {
-            for (int i = 0; i < processed_data->subcarrier_count; i++) {
-                int8_t real = raw_data->buf[i * 2];
-                int8_t imag = raw_data->buf[i * 2 + 1];
-                processed_data->phase[i] = atan2f(imag, real);
-            }
-        }
     }
+    csi_features_amplitude_phase((const int8_t *)raw_data->buf, processed_data->subcarrier_count,
+                                 processed_data->amplitude, processed_data->phase);
 
     return ESP_OK;
 }
@@ -541,4 +653,164 @@ void csi_collector_free_data(csi_data_t *csi_data)
             csi_data->phase = NULL;
         }
     }
-}
\ No newline at end of file
+}
+
+void csi_collector_record_drop(uint32_t sequence, csi_drop_reason_t reason)
+{
+    if (reason <= CSI_DROP_NONE || reason >= CSI_DROP_REASON_MAX) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_drop_lock);
+    s_drop_log.drops[reason]++;
+
+    // Extend the newest range when this frame directly follows it
+    if (s_drop_log.count > 0) {
+        csi_drop_range_t *last = &s_drop_log.ranges[(s_drop_log.head + s_drop_log.count - 1) % CSI_DROP_LOG_LEN];
+        if (last->reason == reason && last->count < UINT16_MAX &&
+            last->first_sequence + last->count == sequence) {
+            last->count++;
+            taskEXIT_CRITICAL(&s_drop_lock);
+            return;
+        }
+    }
+
+    if (s_drop_log.count == CSI_DROP_LOG_LEN) {
+        s_drop_log.head = (s_drop_log.head + 1) % CSI_DROP_LOG_LEN;
+        s_drop_log.count--;
+        s_drop_log.overruns++;
+    }
+    csi_drop_range_t *range = &s_drop_log.ranges[(s_drop_log.head + s_drop_log.count) % CSI_DROP_LOG_LEN];
+    range->first_sequence = sequence;
+    range->count = 1;
+    range->reason = reason;
+    s_drop_log.count++;
+    taskEXIT_CRITICAL(&s_drop_lock);
+}
+
+esp_err_t csi_collector_take_drops(csi_drop_range_t *ranges, size_t max_ranges, size_t *count)
+{
+    if (!ranges || !count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t taken = 0;
+    taskENTER_CRITICAL(&s_drop_lock);
+    while (taken < max_ranges && s_drop_log.count > 0) {
+        ranges[taken++] = s_drop_log.ranges[s_drop_log.head];
+        s_drop_log.head = (s_drop_log.head + 1) % CSI_DROP_LOG_LEN;
+        s_drop_log.count--;
+    }
+    taskEXIT_CRITICAL(&s_drop_lock);
+
+    *count = taken;
+    return ESP_OK;
+}
+
+char *csi_collector_data_to_json(const csi_data_t *csi_data)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (!json) {
+        return NULL;
+    }
+
+    // Add sequence number and capture timestamp
+    cJSON_AddNumberToObject(json, "seq", csi_data->sequence);
+    cJSON_AddNumberToObject(json, "timestamp", csi_data->timestamp);
+    
+    // Add MAC address
+    char mac_str[18];
+    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
+             csi_data->mac[0], csi_data->mac[1], csi_data->mac[2],
+             csi_data->mac[3], csi_data->mac[4], csi_data->mac[5]);
+    cJSON_AddStringToObject(json, "mac", mac_str);
+    
+    // Add basic information
+    cJSON_AddNumberToObject(json, "rssi", csi_data->rssi);
+    cJSON_AddNumberToObject(json, "channel", csi_data->channel);
+    cJSON_AddNumberToObject(json, "secondary_channel", csi_data->secondary_channel);
+    cJSON_AddNumberToObject(json, "subcarrier_count", csi_data->subcarrier_count);
+    
+    // Add amplitude data if available
+    if (csi_data->amplitude && csi_data->subcarrier_count > 0) {
+        cJSON *amplitude_array = cJSON_CreateArray();
+        for (int i = 0; i < csi_data->subcarrier_count; i++) {
+            cJSON_AddItemToArray(amplitude_array, cJSON_CreateNumber(csi_data->amplitude[i]));
+        }
+        cJSON_AddItemToObject(json, "amplitude", amplitude_array);
+    }
+    
+    // Add phase data if available
+    if (csi_data->phase && csi_data->subcarrier_count > 0) {
+        cJSON *phase_array = cJSON_CreateArray();
+        for (int i = 0; i < csi_data->subcarrier_count; i++) {
+            cJSON_AddItemToArray(phase_array, cJSON_CreateNumber(csi_data->phase[i]));
+        }
+        cJSON_AddItemToObject(json, "phase", phase_array);
+    }
+
+    // No indentation: whitespace is a third of a formatted CSI message
+    char *json_string = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    
+    return json_string;
+}
+
+char *csi_collector_drops_to_json(const csi_drop_range_t *ranges, size_t count)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (!json) {
+        return NULL;
+    }
+
+    cJSON_AddStringToObject(json, "type", "drops");
+    cJSON_AddNumberToObject(json, "next_seq", s_next_sequence);
+
+    cJSON *array = cJSON_AddArrayToObject(json, "ranges");
+    for (size_t i = 0; array && i < count; i++) {
+        const double range[3] = {ranges[i].first_sequence, ranges[i].count, ranges[i].reason};
+        cJSON_AddItemToArray(array, cJSON_CreateDoubleArray(range, 3));
+    }
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+
+    return json_string;
+}
+
+size_t csi_collector_frame_size(const csi_data_t *csi_data)
+{
+    return sizeof(csi_frame_header_t) + (csi_data->data ? csi_data->len : 0);
+}
+
+void csi_collector_encode_frame(const csi_data_t *csi_data, uint8_t *frame)
+{
+    uint16_t raw_len = csi_data->data ? csi_data->len : 0;
+
+    uint8_t flags = 0;
+    if (raw_len) {
+        flags |= CSI_FRAME_FLAG_RAW;
+    }
+    if (csi_data->utc_timestamp) {
+        flags |= CSI_FRAME_FLAG_UTC;
+    }
+
+    csi_frame_header_t header = {
+        .magic = CSI_FRAME_MAGIC,
+        .version = CSI_FRAME_VERSION,
+        .flags = flags,
+        .sequence = csi_data->sequence,
+        .timestamp = csi_data->timestamp,
+        .rssi = csi_data->rssi,
+        .channel = csi_data->channel,
+        .secondary_channel = csi_data->secondary_channel,
+        .subcarrier_count = csi_data->subcarrier_count,
+        .raw_len = raw_len,
+    };
+    memcpy(header.mac, csi_data->mac, sizeof(header.mac));
+
+    memcpy(frame, &header, sizeof(header));
+    if (raw_len) {
+        memcpy(frame + sizeof(header), csi_data->data, raw_len);
+    }
+}
@@ -0,0 +1,296 @@
+/**
+ * @file csi_features.c
+ * @brief Feature kernels shared by the node and the server
+ *
+ * Must be compiled with -ffp-contract=off: a fused multiply-add rounds
+ * once where the separate operations round twice, and whether the compiler
+ * fuses differs between the Xtensa and x86 builds.
+ */
+
+#include "csi_features.h"
+
+#include <math.h>
+#include <string.h>
+
+#define PI_F        3.14159265358979f
+#define TWO_PI_F    6.28318530717959f
+#define HALF_PI_F   1.57079632679490f
+#define SIXTH_PI_F  0.523598775598299f
+#define SQRT3_F     1.73205080756888f
+#define TAN_PI_12_F 0.267949192431123f
+
+/**
+ * @brief atan(t) for t in [0, 1]
+ *
+ * Above tan(pi/12), atan(t) = pi/6 + atan((t sqrt3 - 1) / (t + sqrt3)),
+ * which brings the argument back below tan(pi/12); there the Taylor series
+ * to the 15th power leaves out less than 1e-10, evaluated in Horner form.
+ */
+static float atan_unit(float t)
+{
+    float base = 0.0f;
+    if (t > TAN_PI_12_F) {
+        t = (t * SQRT3_F - 1.0f) / (t + SQRT3_F);
+        base = SIXTH_PI_F;
+    }
+    float t2 = t * t;
+    return base + t * (1.0f - t2 * (1.0f / 3.0f - t2 * (1.0f / 5.0f - t2 * (1.0f / 7.0f - t2 *
+           (1.0f / 9.0f - t2 * (1.0f / 11.0f - t2 * (1.0f / 13.0f - t2 * (1.0f / 15.0f))))))));
+}
+
+void csi_features_amplitude_phase(const int8_t *iq, uint32_t n, float *amplitude, float *phase)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        int real = iq[2 * i];
+        int imag = iq[2 * i + 1];
+        if (amplitude) {
+            amplitude[i] = sqrtf((float)(real * real + imag * imag));
+        }
+        if (phase) {
+            // Reduced to the first octant, where the integers are exact
+            float ax = (float)(real < 0 ? -real : real);
+            float ay = (float)(imag < 0 ? -imag : imag);
+            float a = 0.0f;
+            if (ay <= ax && ax > 0.0f) {
+                a = atan_unit(ay / ax);
+            } else if (ay > ax) {
+                a = HALF_PI_F - atan_unit(ax / ay);
+            }
+            if (real < 0) {
+                a = PI_F - a;
+            }
+            phase[i] = imag < 0 ? -a : a;
+        }
+    }
+}
+
+void csi_features_mean_variance(const float *x, uint32_t n, float *mean, float *variance)
+{
+    if (n == 0) {
+        *mean = 0.0f;
+        *variance = 0.0f;
+        return;
+    }
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += x[i];
+    }
+    float m = sum / n;
+    float sq = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        float d = x[i] - m;
+        sq += d * d;
+    }
+    *mean = m;
+    *variance = sq / n;
+}
+
+void csi_features_normalize_amplitude(const float *in, uint32_t n, float *out)
+{
+    float sq = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        sq += in[i] * in[i];
+    }
+    if (sq == 0.0f) {
+        memmove(out, in, n * sizeof(float));
+        return;
+    }
+    float scale = 1.0f / sqrtf(sq / n);
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = in[i] * scale;
+    }
+}
+
+void csi_features_sanitize_phase(const float *in, uint32_t n, float *out)
+{
+    if (n == 0) {
+        return;
+    }
+    // Unwrap, keeping the raw previous value as in and out may alias
+    float prev = in[0], acc = in[0];
+    out[0] = acc;
+    for (uint32_t i = 1; i < n; i++) {
+        float d = in[i] - prev;
+        prev = in[i];
+        while (d > PI_F) {
+            d -= TWO_PI_F;
+        }
+        while (d < -PI_F) {
+            d += TWO_PI_F;
+        }
+        acc += d;
+        out[i] = acc;
+    }
+
+    // Least-squares line over the subcarrier index
+    float mean_x = (n - 1) * 0.5f;
+    float mean_y, unused;
+    csi_features_mean_variance(out, n, &mean_y, &unused);
+    float sxy = 0.0f, sxx = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        float dx = i - mean_x;
+        sxy += dx * (out[i] - mean_y);
+        sxx += dx * dx;
+    }
+    float slope = sxx > 0.0f ? sxy / sxx : 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = out[i] - mean_y - slope * (i - mean_x);
+    }
+}
+
+void csi_features_window_init(csi_features_window_t *w, float *storage, uint16_t window, uint16_t width)
+{
+    w->ring = storage;
+    w->window = window;
+    w->width = width;
+    w->count = 0;
+    w->head = 0;
+}
+
+void csi_features_window_push(csi_features_window_t *w, const float *row)
+{
+    memcpy(w->ring + (size_t)w->head * w->width, row, w->width * sizeof(float));
+    w->head = w->head + 1 == w->window ? 0 : w->head + 1;
+    if (w->count < w->window) {
+        w->count++;
+    }
+}
+
+/**
+ * @brief Ring row of the i-th oldest row held
+ */
+static const float *window_row(const csi_features_window_t *w, uint16_t i)
+{
+    uint32_t first = w->count < w->window ? 0 : w->head;
+    uint32_t r = first + i;
+    if (r >= w->window) {
+        r -= w->window;
+    }
+    return w->ring + (size_t)r * w->width;
+}
+
+void csi_features_window_variance(const csi_features_window_t *w, float *out)
+{
+    const uint16_t width = w->width;
+    if (w->count == 0) {
+        memset(out, 0, width * sizeof(float));
+        return;
+    }
+    // Row by row rather than column by column: same sums, unit stride
+    float mean[width];
+    memset(mean, 0, sizeof(mean));
+    for (uint16_t i = 0; i < w->count; i++) {
+        const float *row = window_row(w, i);
+        for (uint16_t c = 0; c < width; c++) {
+            mean[c] += row[c];
+        }
+    }
+    for (uint16_t c = 0; c < width; c++) {
+        mean[c] /= w->count;
+        out[c] = 0.0f;
+    }
+    for (uint16_t i = 0; i < w->count; i++) {
+        const float *row = window_row(w, i);
+        for (uint16_t c = 0; c < width; c++) {
+            float d = row[c] - mean[c];
+            out[c] += d * d;
+        }
+    }
+    for (uint16_t c = 0; c < width; c++) {
+        out[c] /= w->count;
+    }
+}
+
+void csi_features_window_column(const csi_features_window_t *w, uint16_t column, float *out)
+{
+    for (uint16_t i = 0; i < w->count; i++) {
+        out[i] = window_row(w, i)[column];
+    }
+}
+
+/**
+ * @brief cos and sin of x in [0, pi/2]
+ *
+ * Taylor series to the 14th and 13th power, whose first omitted terms are
+ * below 1e-8 over the range, evaluated in Horner form.
+ */
+static void cos_sin(float x, float *c, float *s)
+{
+    float x2 = x * x;
+    *c = 1.0f - x2 / 2.0f * (1.0f - x2 / 12.0f * (1.0f - x2 / 30.0f * (1.0f - x2 / 56.0f *
+         (1.0f - x2 / 90.0f * (1.0f - x2 / 132.0f * (1.0f - x2 / 182.0f))))));
+    *s = x * (1.0f - x2 / 6.0f * (1.0f - x2 / 20.0f * (1.0f - x2 / 42.0f * (1.0f - x2 / 72.0f *
+         (1.0f - x2 / 110.0f * (1.0f - x2 / 156.0f))))));
+}
+
+/**
+ * @brief exp(-2 pi i k / n), reduced to the first quadrant in integers
+ */
+static void twiddle(uint32_t k, uint32_t n, float *re, float *im)
+{
+    uint32_t quadrant = 4 * k / n;
+    uint32_t rest = 4 * k - quadrant * n;
+    float c, s;
+    cos_sin(HALF_PI_F * rest / n, &c, &s);
+    // Rotate (c, s) by quadrant quarter turns; exact
+    switch (quadrant) {
+    case 0:
+        *re = c;
+        *im = -s;
+        break;
+    case 1:
+        *re = -s;
+        *im = -c;
+        break;
+    case 2:
+        *re = -c;
+        *im = s;
+        break;
+    default:
+        *re = s;
+        *im = c;
+        break;
+    }
+}
+
+bool csi_features_fft_magnitude(const float *in, uint32_t n, float *scratch, float *out)
+{
+    if (n < 2 || n > CSI_FEATURES_MAX_FFT || (n & (n - 1))) {
+        return false;
+    }
+    float *re = scratch, *im = scratch + n;
+    uint32_t bits = 0;
+    while ((1u << bits) < n) {
+        bits++;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1u) << (bits - 1 - b);
+        }
+        re[r] = in[i];
+        im[r] = 0.0f;
+    }
+
+    // Iterative radix-2 decimation in time
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        uint32_t half = len / 2;
+        for (uint32_t k = 0; k < half; k++) {
+            float wr, wi;
+            twiddle(k, len, &wr, &wi);
+            for (uint32_t i = k; i < n; i += len) {
+                uint32_t j = i + half;
+                float tr = re[j] * wr - im[j] * wi;
+                float ti = re[j] * wi + im[j] * wr;
+                re[j] = re[i] - tr;
+                im[j] = im[i] - ti;
+                re[i] = re[i] + tr;
+                im[i] = im[i] + ti;
+            }
+        }
+    }
+    for (uint32_t i = 0; i <= n / 2; i++) {
+        out[i] = sqrtf(re[i] * re[i] + im[i] * im[i]);
+    }
+    return true;
+}
@@ -4,6 +4,7 @@
  */
 
 #include "csi_filter.h"
+#include "csi_features.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -115,11 +116,8 @@ esp_err_t csi_filter_process(csi_filter_handle_t handle, csi_data_t *data)
     
     // Apply amplitude-based filtering if enabled and data is available
     if (pass_filter && ctx->config.enable_amplitude_filter && data->amplitude && ctx->amplitude_history) {
-        float avg_amplitude = 0.0f;
-        for (int i = 0; i < data->subcarrier_count; i++) {
-            avg_amplitude += data->amplitude[i];
-        }
-        avg_amplitude /= data->subcarrier_count;
+        float avg_amplitude, amplitude_variance;
+        csi_features_mean_variance(data->amplitude, data->subcarrier_count, &avg_amplitude, &amplitude_variance);
         
         // Compare with historical average
         float historical_avg = 0.0f;
@@ -157,19 +155,8 @@ esp_err_t csi_filter_process(csi_filter_handle_t handle, csi_data_t *data)
     // Apply phase-based filtering if enabled and data is available
     if (pass_filter && ctx->config.enable_phase_filter && data->phase && ctx->phase_history) {
         // Calculate phase variance
-        float phase_variance = 0.0f;
-        float phase_mean = 0.0f;
-        
-        for (int i = 0; i < data->subcarrier_count; i++) {
-            phase_mean += data->phase[i];
-        }
-        phase_mean /= data->subcarrier_count;
-        
-        for (int i = 0; i < data->subcarrier_count; i++) {
-            float diff = data->phase[i] - phase_mean;
-            phase_variance += diff * diff;
-        }
-        phase_variance /= data->subcarrier_count;
+        float phase_mean, phase_variance;
+        csi_features_mean_variance(data->phase, data->subcarrier_count, &phase_mean, &phase_variance);
         
         // Filter based on phase stability
         if (phase_variance < ctx->config.threshold * 0.1f) {
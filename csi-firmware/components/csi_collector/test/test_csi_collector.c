@@ -4,8 +4,10 @@
  */
 
 #include <unity.h>
+#include <math.h>
 #include <string.h>
 #include "csi_collector.h"
+#include "csi_features.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
@@ -280,6 +282,253 @@ void test_csi_collector_statistics_null_pointer(void)
     TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
 }
 
+/**
+ * @brief Test queue depth reporting
+ */
+void test_csi_collector_queue_depth(void)
+{
+    uint32_t depth = 0;
+    uint32_t capacity = 0;
+    
+    esp_err_t err = csi_collector_get_queue_depth(&depth, &capacity);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
+    
+    err = csi_collector_init(&test_config);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    
+    err = csi_collector_get_queue_depth(NULL, &capacity);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
+    
+    err = csi_collector_get_queue_depth(&depth, &capacity);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    TEST_ASSERT_EQUAL(0, depth);
+    TEST_ASSERT_GREATER_THAN(0, capacity);
+}
+
+/**
+ * @brief Test feeding a report through the radio callback path
+ */
+void test_csi_collector_inject(void)
+{
+    int8_t raw[8] = {1, -1, 2, -2, 3, -3, 4, -4};
+    wifi_csi_info_t info = {
+        .mac = {0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03},
+        .buf = raw,
+        .len = sizeof(raw),
+    };
+    info.rx_ctrl.rssi = -47;
+    info.rx_ctrl.channel = 6;
+
+    esp_err_t err = csi_collector_inject(&info, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
+
+    err = csi_collector_init(&test_config);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    err = csi_collector_start();
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+
+    err = csi_collector_inject(NULL, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
+
+    err = csi_collector_inject(&info, 100);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+
+    csi_data_t csi_data;
+    err = csi_collector_get_data(&csi_data, 1000);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    TEST_ASSERT_EQUAL_MEMORY(info.mac, csi_data.mac, 6);
+    TEST_ASSERT_EQUAL(-47, csi_data.rssi);
+    TEST_ASSERT_EQUAL(6, csi_data.channel);
+    TEST_ASSERT_EQUAL(sizeof(raw), csi_data.len);
+    TEST_ASSERT_EQUAL_MEMORY(raw, csi_data.data, sizeof(raw));
+
+    // The node's features come from the kernel the server decodes with
+    float amplitude[4], phase[4];
+    csi_features_amplitude_phase(raw, 4, amplitude, phase);
+    TEST_ASSERT_EQUAL(4, csi_data.subcarrier_count);
+    TEST_ASSERT_EQUAL_MEMORY(amplitude, csi_data.amplitude, sizeof(amplitude));
+    TEST_ASSERT_EQUAL_MEMORY(phase, csi_data.phase, sizeof(phase));
+    csi_collector_free_data(&csi_data);
+}
+
+/**
+ * @brief Test drop logging and range coalescing
+ */
+void test_csi_collector_drop_log(void)
+{
+    csi_drop_range_t ranges[8];
+    size_t count = 0;
+
+    // Start from an empty log
+    while (csi_collector_take_drops(ranges, 8, &count) == ESP_OK && count > 0) {
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, csi_collector_take_drops(NULL, 8, &count));
+
+    csi_collector_record_drop(100, CSI_DROP_BUFFER_FULL);
+    csi_collector_record_drop(101, CSI_DROP_BUFFER_FULL);
+    csi_collector_record_drop(102, CSI_DROP_BUFFER_FULL);
+    csi_collector_record_drop(104, CSI_DROP_BUFFER_FULL);
+    csi_collector_record_drop(105, CSI_DROP_OUTBOX_EXPIRED);
+    csi_collector_record_drop(106, CSI_DROP_REASON_MAX); // ignored
+
+    esp_err_t err = csi_collector_take_drops(ranges, 8, &count);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    TEST_ASSERT_EQUAL(3, count);
+    TEST_ASSERT_EQUAL(100, ranges[0].first_sequence);
+    TEST_ASSERT_EQUAL(3, ranges[0].count);
+    TEST_ASSERT_EQUAL(CSI_DROP_BUFFER_FULL, ranges[0].reason);
+    TEST_ASSERT_EQUAL(104, ranges[1].first_sequence);
+    TEST_ASSERT_EQUAL(1, ranges[1].count);
+    TEST_ASSERT_EQUAL(CSI_DROP_OUTBOX_EXPIRED, ranges[2].reason);
+
+    err = csi_collector_take_drops(ranges, 8, &count);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    TEST_ASSERT_EQUAL(0, count);
+
+    char *json = csi_collector_drops_to_json(ranges, 0);
+    TEST_ASSERT_NOT_NULL(json);
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"ranges\":[]"));
+    free(json);
+}
+
+/**
+ * @brief Test binary frame encoding
+ */
+void test_csi_collector_encode_frame(void)
+{
+    int8_t raw[8] = {1, -1, 2, -2, 3, -3, 4, -4};
+    csi_data_t csi_data = {
+        .sequence = 4242,
+        .timestamp = 1700000000123456ULL,
+        .utc_timestamp = true,
+        .mac = {0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03},
+        .rssi = -55,
+        .channel = 6,
+        .len = sizeof(raw),
+        .data = raw,
+        .subcarrier_count = 4,
+        .valid = true
+    };
+
+    size_t frame_len = csi_collector_frame_size(&csi_data);
+    TEST_ASSERT_EQUAL(sizeof(csi_frame_header_t) + sizeof(raw), frame_len);
+
+    uint8_t frame[sizeof(csi_frame_header_t) + sizeof(raw)];
+    csi_collector_encode_frame(&csi_data, frame);
+
+    csi_frame_header_t header;
+    memcpy(&header, frame, sizeof(header));
+    TEST_ASSERT_EQUAL_HEX16(CSI_FRAME_MAGIC, header.magic);
+    TEST_ASSERT_EQUAL(CSI_FRAME_VERSION, header.version);
+    TEST_ASSERT_EQUAL_HEX8(CSI_FRAME_FLAG_RAW | CSI_FRAME_FLAG_UTC, header.flags);
+    TEST_ASSERT_EQUAL_UINT32(4242, header.sequence);
+    TEST_ASSERT_TRUE(header.timestamp == csi_data.timestamp);
+    TEST_ASSERT_EQUAL(-55, header.rssi);
+    TEST_ASSERT_EQUAL(sizeof(raw), header.raw_len);
+    TEST_ASSERT_EQUAL_MEMORY(raw, frame + sizeof(header), sizeof(raw));
+}
+
+/**
+ * @brief Test the feature kernels shared with the server
+ */
+void test_csi_features_kernels(void)
+{
+    float amplitude[4] = {3.0f, 4.0f, 3.0f, 4.0f};
+    float mean, variance;
+    csi_features_mean_variance(amplitude, 4, &mean, &variance);
+    TEST_ASSERT_EQUAL_FLOAT(3.5f, mean);
+    TEST_ASSERT_EQUAL_FLOAT(0.25f, variance);
+
+    // Unit RMS
+    float normalized[4];
+    csi_features_normalize_amplitude(amplitude, 4, normalized);
+    float sq = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        sq += normalized[i] * normalized[i];
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 4.0f, sq);
+
+    // A wrapped linear phase sanitizes to nothing
+    float phase[16];
+    for (int i = 0; i < 16; i++) {
+        float p = 0.5f + 0.9f * i;
+        while (p > 3.14159265f) {
+            p -= 6.28318531f;
+        }
+        phase[i] = p;
+    }
+    csi_features_sanitize_phase(phase, 16, phase);
+    for (int i = 0; i < 16; i++) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.0f, phase[i]);
+    }
+
+    // A tone in bin 4 of 32
+    float series[32], scratch[64], spectrum[17];
+    for (int i = 0; i < 32; i++) {
+        series[i] = (i % 8) < 4 ? 1.0f : -1.0f;
+    }
+    TEST_ASSERT_TRUE(csi_features_fft_magnitude(series, 32, scratch, spectrum));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.0f, spectrum[0]);
+    for (int i = 1; i < 17; i++) {
+        TEST_ASSERT_TRUE(spectrum[4] >= spectrum[i]);
+    }
+    TEST_ASSERT_FALSE(csi_features_fft_magnitude(series, 24, scratch, spectrum));
+}
+
+/**
+ * @brief Test amplitude and phase over every int8 I/Q pair
+ */
+void test_csi_features_amplitude_phase(void)
+{
+    int8_t iq[2];
+    float amplitude, phase;
+    for (int real = -128; real < 128; real++) {
+        for (int imag = -128; imag < 128; imag++) {
+            iq[0] = (int8_t)real;
+            iq[1] = (int8_t)imag;
+            csi_features_amplitude_phase(iq, 1, &amplitude, &phase);
+            TEST_ASSERT_EQUAL_FLOAT(sqrtf((float)(real * real + imag * imag)), amplitude);
+            TEST_ASSERT_TRUE(fabs((double)phase - atan2((double)imag, (double)real)) <= 3e-7);
+        }
+    }
+
+    iq[0] = 0;
+    iq[1] = 0;
+    csi_features_amplitude_phase(iq, 1, &amplitude, &phase);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, phase);
+
+    // Either output may be skipped
+    iq[0] = -1;
+    csi_features_amplitude_phase(iq, 1, NULL, &phase);
+    TEST_ASSERT_FLOAT_WITHIN(3e-7f, 3.14159265f, phase);
+    csi_features_amplitude_phase(iq, 1, &amplitude, NULL);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, amplitude);
+}
+
+/**
+ * @brief Test the variance window drops its oldest rows
+ */
+void test_csi_features_window(void)
+{
+    float storage[3 * 2], variance[2];
+    csi_features_window_t window;
+    csi_features_window_init(&window, storage, 3, 2);
+    for (int i = 0; i < 5; i++) {
+        float row[2] = {(float)i, 7.0f};
+        csi_features_window_push(&window, row);
+    }
+    // Rows 2, 3, 4 remain
+    TEST_ASSERT_EQUAL(3, window.count);
+    csi_features_window_variance(&window, variance);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.0f / 3.0f, variance[0]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, variance[1]);
+
+    float column[3];
+    csi_features_window_column(&window, 0, column);
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, column[0]);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, column[2]);
+}
+
 /**
  * @brief Test configuration update
  */
@@ -423,6 +672,13 @@ void app_main(void)
     // Statistics tests
     RUN_TEST(test_csi_collector_statistics);
     RUN_TEST(test_csi_collector_statistics_null_pointer);
+    RUN_TEST(test_csi_collector_queue_depth);
+    RUN_TEST(test_csi_collector_inject);
+    RUN_TEST(test_csi_collector_drop_log);
+    RUN_TEST(test_csi_collector_encode_frame);
+    RUN_TEST(test_csi_features_kernels);
+    RUN_TEST(test_csi_features_amplitude_phase);
+    RUN_TEST(test_csi_features_window);
     
     // Configuration tests
     RUN_TEST(test_csi_collector_config_update);
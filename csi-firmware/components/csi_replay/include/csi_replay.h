@@ -0,0 +1,199 @@
+/**
+ * @file csi_replay.h
+ * @brief Replay of recorded CSI traces through the capture pipeline
+ *
+ * Reads a recording and feeds every CSI report to the collector as if the
+ * radio had delivered it, at the recorded timing, scaled by a speed
+ * factor, or as fast as the pipeline accepts. Identical input makes
+ * before/after measurements of the pipeline comparable.
+ *
+ * Supported recordings:
+ * - ESP32-CSI-Tool CSV: "CSI_DATA,..." lines with the raw CSI in brackets
+ *   (header "type,role,mac,rssi,...,len,CSI_DATA"); paced by
+ *   local_timestamp.
+ * - Binary frames: concatenated csi_frame_header_t (version 2) records
+ *   with raw CSI, as published to <prefix>/csi_frame; paced by the header
+ *   timestamp.
+ * - pcap (not pcapng): one binary frame per packet, either as the UDP
+ *   payload of Ethernet, Linux cooked or raw IP captures, or as the whole
+ *   packet with LINKTYPE_USER0; paced by the capture time.
+ */
+
+#ifndef CSI_REPLAY_H
+#define CSI_REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <esp_wifi_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Largest raw CSI report a recording may carry
+ */
+#define CSI_REPLAY_MAX_CSI_LEN      1024
+
+/**
+ * @brief Recording formats
+ */
+typedef enum {
+    CSI_REPLAY_FORMAT_AUTO = 0,     ///< Detect from the first bytes
+    CSI_REPLAY_FORMAT_CSV,          ///< ESP32-CSI-Tool CSV
+    CSI_REPLAY_FORMAT_BINARY,       ///< Concatenated binary frames
+    CSI_REPLAY_FORMAT_PCAP,         ///< pcap of binary frames
+} csi_replay_format_t;
+
+/**
+ * @brief One report read from a recording
+ */
+typedef struct {
+    uint64_t timestamp_us;          ///< Recording time, monotonic within a file
+    wifi_csi_info_t info;           ///< Report; buf stays valid until the next read
+} csi_replay_record_t;
+
+/**
+ * @brief Recording reader handle
+ */
+typedef struct csi_replay_reader *csi_replay_reader_handle_t;
+
+/**
+ * @brief Where replayed reports go
+ * @param ctx User context
+ * @param info CSI report
+ * @return ESP_OK if the report was accepted
+ */
+typedef esp_err_t (*csi_replay_sink_t)(void *ctx, wifi_csi_info_t *info);
+
+/**
+ * @brief Replay configuration
+ */
+typedef struct {
+    csi_replay_format_t format;     ///< Recording format
+    float speed;                    ///< 1 = recorded timing, N = N times faster, 0 = as fast as possible
+    bool exclusive;                 ///< Disable radio CSI for the duration of the replay
+    uint32_t wait_ms;               ///< Back-pressure: wait up to this long for room in the collector
+    bool close_input;               ///< fclose() the input when a started replay ends
+    csi_replay_sink_t sink;         ///< Custom destination (NULL = csi_collector_inject)
+    void *sink_ctx;                 ///< Context passed to sink
+} csi_replay_config_t;
+
+/**
+ * @brief Replay statistics
+ */
+typedef struct {
+    uint32_t frames_read;           ///< Reports read from the recording
+    uint32_t frames_injected;       ///< Reports the sink accepted
+    uint32_t frames_rejected;       ///< Reports the sink refused
+    uint32_t records_skipped;       ///< Lines or packets that carried no report
+    uint32_t max_lag_us;            ///< Largest delay behind the schedule
+    uint64_t duration_us;           ///< Wall time from first to last report
+    esp_err_t result;               ///< ESP_OK, or why reading stopped early
+    bool running;                   ///< Replay in progress
+} csi_replay_stats_t;
+
+/**
+ * @brief Default configuration: auto-detected format, recorded timing
+ */
+#define CSI_REPLAY_DEFAULT_CONFIG() {       \
+    .format = CSI_REPLAY_FORMAT_AUTO,       \
+    .speed = 1.0f,                          \
+    .exclusive = true,                      \
+    .wait_ms = 0,                           \
+    .close_input = false,                   \
+    .sink = NULL,                           \
+    .sink_ctx = NULL,                       \
+}
+
+/**
+ * @brief Open a reader on a recording
+ * @param input Stream positioned at the start of the recording
+ * @param format Recording format, or CSI_REPLAY_FORMAT_AUTO
+ * @param reader Pointer to store the reader handle
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED for unknown formats,
+ *         other error codes on failure
+ */
+esp_err_t csi_replay_reader_open(FILE *input, csi_replay_format_t format,
+                                 csi_replay_reader_handle_t *reader);
+
+/**
+ * @brief Read the next report
+ * @param reader Reader handle
+ * @param record Record to fill
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND at the end of the recording,
+ *         ESP_ERR_INVALID_SIZE or ESP_ERR_INVALID_RESPONSE on corrupt input
+ */
+esp_err_t csi_replay_reader_next(csi_replay_reader_handle_t reader, csi_replay_record_t *record);
+
+/**
+ * @brief Format of an open reader, after detection
+ * @param reader Reader handle
+ * @return Recording format
+ */
+csi_replay_format_t csi_replay_reader_format(csi_replay_reader_handle_t reader);
+
+/**
+ * @brief Number of lines or packets skipped so far because they held no report
+ * @param reader Reader handle
+ * @return Skipped records
+ */
+uint32_t csi_replay_reader_skipped(csi_replay_reader_handle_t reader);
+
+/**
+ * @brief Close a reader; the stream itself is left open
+ * @param reader Reader handle
+ */
+void csi_replay_reader_close(csi_replay_reader_handle_t reader);
+
+/**
+ * @brief Start replaying a recording in the background
+ * @param input Stream positioned at the start of the recording; left open
+ *              and to the caller if the replay does not start
+ * @param config Replay configuration
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if a replay is running,
+ *         other error codes on failure
+ */
+esp_err_t csi_replay_start(FILE *input, const csi_replay_config_t *config);
+
+/**
+ * @brief Stop a replay and wait for it to finish
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t csi_replay_stop(void);
+
+/**
+ * @brief Wait for a replay to reach the end of its recording
+ * @param timeout_ms Timeout in milliseconds
+ * @return ESP_OK when no replay is running, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t csi_replay_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Check if a replay is running
+ * @return true if running, false otherwise
+ */
+bool csi_replay_is_running(void);
+
+/**
+ * @brief Get statistics of the current or last replay
+ * @param stats Pointer to statistics structure
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t csi_replay_get_stats(csi_replay_stats_t *stats);
+
+/**
+ * @brief Parse a format name ("auto", "csv", "binary", "pcap")
+ * @param name Format name
+ * @param format Pointer to store the format
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for unknown names
+ */
+esp_err_t csi_replay_format_from_name(const char *name, csi_replay_format_t *format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_REPLAY_H
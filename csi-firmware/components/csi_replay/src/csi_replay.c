@@ -0,0 +1,318 @@
+/**
+ * @file csi_replay.c
+ * @brief Background replay of recorded CSI traces
+ */
+
+#include "csi_replay.h"
+#include <math.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include "csi_collector.h"
+
+static const char *TAG = "CSI_REPLAY";
+
+#define CSI_REPLAY_TASK_STACK       4096
+#define CSI_REPLAY_TASK_PRIORITY    5
+#define CSI_REPLAY_DONE_BIT         BIT0
+
+/**
+ * @brief Longest single sleep, so a stop request is noticed promptly
+ */
+#define CSI_REPLAY_MAX_SLEEP_MS     100
+
+/**
+ * @brief Time csi_replay_stop() gives the task on top of config.wait_ms
+ */
+#define CSI_REPLAY_STOP_TIMEOUT_MS  2000
+
+/**
+ * @brief Replay context structure
+ */
+typedef struct {
+    csi_replay_config_t config;         ///< Configuration
+    csi_replay_stats_t stats;           ///< Statistics
+    csi_replay_reader_handle_t reader;  ///< Recording being replayed
+    FILE *input;                        ///< Stream under the reader
+    TaskHandle_t task;                  ///< Replay task handle
+    SemaphoreHandle_t mutex;            ///< Protects stats
+    EventGroupHandle_t events;          ///< CSI_REPLAY_DONE_BIT
+    volatile bool stop_requested;       ///< Set by csi_replay_stop()
+    bool radio_muted;                   ///< Radio CSI disabled for the replay
+} csi_replay_ctx_t;
+
+static csi_replay_ctx_t s_ctx = {0};
+
+/**
+ * @brief Default sink: the collector's radio callback path
+ */
+static esp_err_t collector_sink(void *ctx, wifi_csi_info_t *info)
+{
+    return csi_collector_inject(info, s_ctx.config.wait_ms);
+}
+
+/**
+ * @brief Sleep until due_us at tick resolution
+ *
+ * The schedule is absolute, so sleeping up to a tick short of it only adds
+ * jitter, never drift.
+ */
+static void wait_until(int64_t due_us)
+{
+    const int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+
+    while (!s_ctx.stop_requested) {
+        int64_t remaining = due_us - esp_timer_get_time();
+        if (remaining < tick_us) {
+            return;
+        }
+        TickType_t ticks = (TickType_t)(remaining / tick_us);
+        if (ticks > pdMS_TO_TICKS(CSI_REPLAY_MAX_SLEEP_MS)) {
+            ticks = pdMS_TO_TICKS(CSI_REPLAY_MAX_SLEEP_MS);
+        }
+        vTaskDelay(ticks);
+    }
+}
+
+/**
+ * @brief Release everything the replay holds and signal completion
+ */
+static void replay_finish(esp_err_t result, int64_t first_us, int64_t last_us, bool close_input)
+{
+    if (s_ctx.radio_muted) {
+        // The collector disables CSI itself when it stops
+        if (csi_collector_is_running()) {
+            esp_wifi_set_csi(true);
+        }
+        s_ctx.radio_muted = false;
+    }
+
+    xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
+    s_ctx.stats.result = result;
+    s_ctx.stats.records_skipped = csi_replay_reader_skipped(s_ctx.reader);
+    s_ctx.stats.duration_us = (uint64_t)(last_us - first_us);
+    s_ctx.stats.running = false;
+    xSemaphoreGive(s_ctx.mutex);
+
+    csi_replay_reader_close(s_ctx.reader);
+    s_ctx.reader = NULL;
+    if (close_input) {
+        fclose(s_ctx.input);
+    }
+    s_ctx.input = NULL;
+}
+
+static void csi_replay_task(void *pvParameters)
+{
+    csi_replay_sink_t sink = s_ctx.config.sink ? s_ctx.config.sink : collector_sink;
+    float speed = s_ctx.config.speed;
+    csi_replay_record_t record;
+    esp_err_t result = ESP_OK;
+    int64_t first_us = 0;
+    int64_t last_us = 0;
+    uint64_t last_ts = 0;
+    uint64_t elapsed_us = 0;           // Recording time since the first report
+
+    ESP_LOGI(TAG, "Replay task started");
+
+    for (uint32_t n = 0; !s_ctx.stop_requested; n++) {
+        result = csi_replay_reader_next(s_ctx.reader, &record);
+        if (result != ESP_OK) {
+            break;
+        }
+
+        // Clock jumps backwards (a reboot, a new NTP fix) replay back to back
+        if (n == 0) {
+            first_us = esp_timer_get_time();
+        } else if (record.timestamp_us > last_ts) {
+            elapsed_us += record.timestamp_us - last_ts;
+        }
+        last_ts = record.timestamp_us;
+
+        uint32_t lag_us = 0;
+        if (speed > 0) {
+            int64_t due_us = first_us + (int64_t)((double)elapsed_us / speed);
+            wait_until(due_us);
+            if (s_ctx.stop_requested) {
+                break;
+            }
+            int64_t late = esp_timer_get_time() - due_us;
+            lag_us = late > 0 ? (uint32_t)late : 0;
+        }
+
+        esp_err_t err = sink(s_ctx.config.sink_ctx, &record.info);
+        last_us = esp_timer_get_time();
+
+        xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
+        s_ctx.stats.frames_read++;
+        if (err == ESP_OK) {
+            s_ctx.stats.frames_injected++;
+        } else {
+            s_ctx.stats.frames_rejected++;
+        }
+        if (lag_us > s_ctx.stats.max_lag_us) {
+            s_ctx.stats.max_lag_us = lag_us;
+        }
+        xSemaphoreGive(s_ctx.mutex);
+    }
+
+    if (result == ESP_ERR_NOT_FOUND) {
+        result = ESP_OK;
+    } else if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Replay stopped early: %s", esp_err_to_name(result));
+    }
+    replay_finish(result, first_us, last_us, s_ctx.config.close_input);
+
+    ESP_LOGI(TAG, "Replay finished: %lu injected, %lu rejected, %lu skipped",
+             (unsigned long)s_ctx.stats.frames_injected, (unsigned long)s_ctx.stats.frames_rejected,
+             (unsigned long)s_ctx.stats.records_skipped);
+
+    s_ctx.task = NULL;
+    xEventGroupSetBits(s_ctx.events, CSI_REPLAY_DONE_BIT);
+    vTaskDelete(NULL);
+}
+
+esp_err_t csi_replay_start(FILE *input, const csi_replay_config_t *config)
+{
+    if (!input || !config) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!(config->speed >= 0) || isinf(config->speed)) {
+        ESP_LOGE(TAG, "Invalid speed: %f", config->speed);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!config->sink && !csi_collector_is_running()) {
+        ESP_LOGE(TAG, "Collector not running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Created once and kept, so stats stay readable after a replay ends
+    if (!s_ctx.mutex) {
+        s_ctx.mutex = xSemaphoreCreateMutex();
+        s_ctx.events = xEventGroupCreate();
+        if (!s_ctx.mutex || !s_ctx.events) {
+            ESP_LOGE(TAG, "Failed to create synchronization objects");
+            if (s_ctx.mutex) {
+                vSemaphoreDelete(s_ctx.mutex);
+                s_ctx.mutex = NULL;
+            }
+            if (s_ctx.events) {
+                vEventGroupDelete(s_ctx.events);
+                s_ctx.events = NULL;
+            }
+            return ESP_ERR_NO_MEM;
+        }
+        xEventGroupSetBits(s_ctx.events, CSI_REPLAY_DONE_BIT);
+    }
+
+    if (csi_replay_is_running()) {
+        ESP_LOGW(TAG, "Replay already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    csi_replay_reader_handle_t reader;
+    esp_err_t err = csi_replay_reader_open(input, config->format, &reader);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open recording: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_ctx.config = *config;
+    s_ctx.reader = reader;
+    s_ctx.input = input;
+    s_ctx.stop_requested = false;
+
+    xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
+    memset(&s_ctx.stats, 0, sizeof(s_ctx.stats));
+    s_ctx.stats.running = true;
+    xSemaphoreGive(s_ctx.mutex);
+
+    // Logged before the task exists: a short recording can be replayed and
+    // the reader closed before xTaskCreate() returns
+    static const char *const format_names[] = {"auto", "CSV", "binary", "pcap"};
+    if (config->speed > 0) {
+        ESP_LOGI(TAG, "Replaying %s recording at %.2fx recorded timing",
+                 format_names[csi_replay_reader_format(reader)], config->speed);
+    } else {
+        ESP_LOGI(TAG, "Replaying %s recording as fast as possible",
+                 format_names[csi_replay_reader_format(reader)]);
+    }
+
+    if (config->exclusive) {
+        esp_wifi_set_csi(false);
+        s_ctx.radio_muted = true;
+    }
+
+    xEventGroupClearBits(s_ctx.events, CSI_REPLAY_DONE_BIT);
+    if (xTaskCreate(csi_replay_task, "csi_replay", CSI_REPLAY_TASK_STACK, NULL,
+                    CSI_REPLAY_TASK_PRIORITY, &s_ctx.task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create replay task");
+        s_ctx.task = NULL;
+        // The input is only ours once the task runs; the caller still holds it
+        replay_finish(ESP_ERR_NO_MEM, 0, 0, false);
+        xEventGroupSetBits(s_ctx.events, CSI_REPLAY_DONE_BIT);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t csi_replay_stop(void)
+{
+    if (!csi_replay_is_running()) {
+        return ESP_OK;
+    }
+
+    s_ctx.stop_requested = true;
+    EventBits_t bits = xEventGroupWaitBits(s_ctx.events, CSI_REPLAY_DONE_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(CSI_REPLAY_STOP_TIMEOUT_MS + s_ctx.config.wait_ms));
+    if (!(bits & CSI_REPLAY_DONE_BIT)) {
+        ESP_LOGE(TAG, "Replay task did not stop");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    ESP_LOGI(TAG, "Replay stopped");
+    return ESP_OK;
+}
+
+esp_err_t csi_replay_wait(uint32_t timeout_ms)
+{
+    if (!s_ctx.events) {
+        return ESP_OK;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(s_ctx.events, CSI_REPLAY_DONE_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    return (bits & CSI_REPLAY_DONE_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+bool csi_replay_is_running(void)
+{
+    return s_ctx.events && !(xEventGroupGetBits(s_ctx.events) & CSI_REPLAY_DONE_BIT);
+}
+
+esp_err_t csi_replay_get_stats(csi_replay_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_ctx.mutex) {
+        memset(stats, 0, sizeof(*stats));
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
+    memcpy(stats, &s_ctx.stats, sizeof(*stats));
+    xSemaphoreGive(s_ctx.mutex);
+
+    return ESP_OK;
+}
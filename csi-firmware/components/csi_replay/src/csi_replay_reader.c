@@ -0,0 +1,656 @@
+/**
+ * @file csi_replay_reader.c
+ * @brief Readers for ESP32-CSI-Tool CSV, binary frame and pcap recordings
+ */
+
+#include "csi_replay.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <esp_log.h>
+#include "csi_collector.h"
+
+static const char *TAG = "CSI_REPLAY";
+
+/**
+ * @brief Longest CSV line; 384 values of up to five characters plus metadata
+ */
+#define CSV_MAX_LINE            4096
+
+/**
+ * @brief Fields before the bracketed CSI in an ESP32-CSI-Tool line
+ */
+#define CSV_FIELDS              25
+
+/**
+ * @brief Largest pcap packet kept; anything longer cannot hold a frame
+ */
+#define PCAP_MAX_PACKET         (64 + sizeof(csi_frame_header_t) + CSI_REPLAY_MAX_CSI_LEN)
+
+#define PCAP_MAGIC_US           0xa1b2c3d4
+#define PCAP_MAGIC_NS           0xa1b23c4d
+#define PCAPNG_MAGIC            0x0a0d0d0a
+
+#define LINKTYPE_NULL           0
+#define LINKTYPE_ETHERNET       1
+#define LINKTYPE_RAW            101
+#define LINKTYPE_LINUX_SLL      113
+#define LINKTYPE_USER0          147
+#define LINKTYPE_IPV4           228
+#define LINKTYPE_IPV6           229
+#define LINKTYPE_LINUX_SLL2     276
+
+#define ETHERTYPE_IPV4          0x0800
+#define ETHERTYPE_VLAN          0x8100
+#define ETHERTYPE_IPV6          0x86dd
+#define IPPROTO_UDP_NUM         17
+
+/**
+ * @brief Reader state
+ */
+struct csi_replay_reader {
+    FILE *input;
+    csi_replay_format_t format;
+    uint32_t skipped;                   ///< Records without a report
+    uint8_t pushback[4];                ///< Bytes consumed by format detection
+    size_t pushback_len;
+    size_t pushback_pos;
+    bool pcap_swapped;                  ///< pcap written with the other byte order
+    bool pcap_nanos;                    ///< pcap timestamps in nanoseconds
+    uint32_t pcap_linktype;
+    bool have_timestamp;                ///< CSV: last_timestamp is valid
+    uint32_t last_timestamp;            ///< CSV: last 32-bit local_timestamp
+    uint64_t timestamp_base;            ///< CSV: accumulated wraps
+    int8_t csi[CSI_REPLAY_MAX_CSI_LEN];
+    uint8_t packet[PCAP_MAX_PACKET];
+    char line[CSV_MAX_LINE];
+};
+
+// ===== STREAM =====
+
+static size_t reader_read(csi_replay_reader_handle_t r, void *buf, size_t len)
+{
+    uint8_t *out = buf;
+    size_t n = 0;
+    while (n < len && r->pushback_pos < r->pushback_len) {
+        out[n++] = r->pushback[r->pushback_pos++];
+    }
+    if (n < len) {
+        n += fread(out + n, 1, len - n, r->input);
+    }
+    return n;
+}
+
+static int reader_getc(csi_replay_reader_handle_t r)
+{
+    if (r->pushback_pos < r->pushback_len) {
+        return r->pushback[r->pushback_pos++];
+    }
+    return getc(r->input);
+}
+
+/**
+ * @brief Discard len bytes of input
+ * @return true if all of them were there
+ */
+static bool reader_skip(csi_replay_reader_handle_t r, size_t len)
+{
+    uint8_t scratch[64];
+    while (len > 0) {
+        size_t chunk = len < sizeof(scratch) ? len : sizeof(scratch);
+        if (reader_read(r, scratch, chunk) != chunk) {
+            return false;
+        }
+        len -= chunk;
+    }
+    return true;
+}
+
+static uint16_t load_be16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t load_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t load_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// ===== BINARY FRAMES =====
+
+/**
+ * @brief Turn a binary frame into a record
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if it carries no raw CSI,
+ *         ESP_ERR_INVALID_RESPONSE if it is not a frame
+ */
+static esp_err_t frame_to_record(csi_replay_reader_handle_t r, const uint8_t *frame, size_t len,
+                                 csi_replay_record_t *record)
+{
+    csi_frame_header_t header;
+    if (len < sizeof(header)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    memcpy(&header, frame, sizeof(header));
+    if (header.magic != CSI_FRAME_MAGIC || header.version != CSI_FRAME_VERSION ||
+        sizeof(header) + header.raw_len > len) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (!(header.flags & CSI_FRAME_FLAG_RAW) || header.raw_len == 0 ||
+        header.raw_len > CSI_REPLAY_MAX_CSI_LEN) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memcpy(r->csi, frame + sizeof(header), header.raw_len);
+    memset(record, 0, sizeof(*record));
+    record->timestamp_us = header.timestamp;
+    memcpy(record->info.mac, header.mac, sizeof(header.mac));
+    record->info.rx_ctrl.rssi = header.rssi;
+    record->info.rx_ctrl.channel = header.channel;
+    record->info.rx_ctrl.secondary_channel = header.secondary_channel;
+    record->info.rx_ctrl.timestamp = (uint32_t)header.timestamp;
+    record->info.buf = r->csi;
+    record->info.len = header.raw_len;
+    return ESP_OK;
+}
+
+static esp_err_t binary_next(csi_replay_reader_handle_t r, csi_replay_record_t *record)
+{
+    const size_t header_len = sizeof(csi_frame_header_t);
+
+    while (true) {
+        size_t n = reader_read(r, r->packet, header_len);
+        if (n == 0) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (n != header_len) {
+            ESP_LOGW(TAG, "Truncated frame header at end of recording");
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        csi_frame_header_t header;
+        memcpy(&header, r->packet, header_len);
+        if (header.magic != CSI_FRAME_MAGIC || header.version != CSI_FRAME_VERSION) {
+            ESP_LOGE(TAG, "Not a version %d frame (magic 0x%04x, version %d)",
+                     CSI_FRAME_VERSION, header.magic, header.version);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (header.raw_len > CSI_REPLAY_MAX_CSI_LEN) {
+            ESP_LOGE(TAG, "Frame too large: %u bytes of CSI", header.raw_len);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (reader_read(r, r->packet + header_len, header.raw_len) != header.raw_len) {
+            ESP_LOGW(TAG, "Truncated frame at end of recording");
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        esp_err_t err = frame_to_record(r, r->packet, header_len + header.raw_len, record);
+        if (err != ESP_ERR_NOT_FOUND) {
+            return err;
+        }
+        r->skipped++;
+    }
+}
+
+// ===== PCAP =====
+
+static uint32_t pcap_u32(csi_replay_reader_handle_t r, const uint8_t *p)
+{
+    return r->pcap_swapped ? load_be32(p) : load_le32(p);
+}
+
+static esp_err_t pcap_open(csi_replay_reader_handle_t r)
+{
+    uint8_t header[24];
+    if (reader_read(r, header, sizeof(header)) != sizeof(header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t magic = load_le32(header);
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+        r->pcap_swapped = false;
+    } else {
+        magic = load_be32(header);
+        if (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS) {
+            ESP_LOGE(TAG, "Not a pcap file");
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        r->pcap_swapped = true;
+    }
+    r->pcap_nanos = magic == PCAP_MAGIC_NS;
+    r->pcap_linktype = pcap_u32(r, header + 20) & 0x0fffffff;
+
+    switch (r->pcap_linktype) {
+        case LINKTYPE_NULL:
+        case LINKTYPE_ETHERNET:
+        case LINKTYPE_RAW:
+        case LINKTYPE_LINUX_SLL:
+        case LINKTYPE_USER0:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+        case LINKTYPE_LINUX_SLL2:
+            return ESP_OK;
+        default:
+            ESP_LOGE(TAG, "Unsupported pcap link type %lu", (unsigned long)r->pcap_linktype);
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+/**
+ * @brief Find the UDP payload of an IP packet
+ * @return Payload, or NULL if the packet is not an unfragmented UDP datagram
+ */
+static const uint8_t *ip_udp_payload(const uint8_t *ip, size_t len, size_t *payload_len)
+{
+    if (len < 1) {
+        return NULL;
+    }
+
+    const uint8_t *udp;
+    size_t udp_len;
+    if ((ip[0] >> 4) == 4) {
+        size_t ihl = (size_t)(ip[0] & 0x0f) * 4;
+        if (len < 20 || ihl < 20 || len < ihl || ip[9] != IPPROTO_UDP_NUM) {
+            return NULL;
+        }
+        // Fragments other than a complete datagram cannot be reassembled here
+        if (load_be16(ip + 6) & 0x3fff) {
+            return NULL;
+        }
+        size_t total = load_be16(ip + 2);
+        if (total < ihl || total > len) {
+            return NULL;
+        }
+        udp = ip + ihl;
+        udp_len = total - ihl;
+    } else if ((ip[0] >> 4) == 6) {
+        if (len < 40 || ip[6] != IPPROTO_UDP_NUM) {
+            return NULL;
+        }
+        size_t payload = load_be16(ip + 4);
+        if (40 + payload > len) {
+            return NULL;
+        }
+        udp = ip + 40;
+        udp_len = payload;
+    } else {
+        return NULL;
+    }
+
+    if (udp_len < 8) {
+        return NULL;
+    }
+    size_t datagram = load_be16(udp + 4);
+    if (datagram < 8 || datagram > udp_len) {
+        return NULL;
+    }
+    *payload_len = datagram - 8;
+    return udp + 8;
+}
+
+/**
+ * @brief Find the binary frame in a captured packet
+ */
+static const uint8_t *pcap_frame(csi_replay_reader_handle_t r, const uint8_t *packet, size_t len,
+                                 size_t *frame_len)
+{
+    size_t offset;
+    uint16_t proto;
+
+    switch (r->pcap_linktype) {
+        case LINKTYPE_USER0:
+            *frame_len = len;
+            return packet;
+        case LINKTYPE_RAW:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            return ip_udp_payload(packet, len, frame_len);
+        case LINKTYPE_NULL:
+            // Address family in the byte order of the capturing host
+            return len >= 4 ? ip_udp_payload(packet + 4, len - 4, frame_len) : NULL;
+        case LINKTYPE_LINUX_SLL:
+            if (len < 16) {
+                return NULL;
+            }
+            proto = load_be16(packet + 14);
+            offset = 16;
+            break;
+        case LINKTYPE_LINUX_SLL2:
+            if (len < 20) {
+                return NULL;
+            }
+            proto = load_be16(packet);
+            offset = 20;
+            break;
+        case LINKTYPE_ETHERNET:
+        default:
+            if (len < 14) {
+                return NULL;
+            }
+            proto = load_be16(packet + 12);
+            offset = 14;
+            if (proto == ETHERTYPE_VLAN && len >= 18) {
+                proto = load_be16(packet + 16);
+                offset = 18;
+            }
+            break;
+    }
+
+    if (proto != ETHERTYPE_IPV4 && proto != ETHERTYPE_IPV6) {
+        return NULL;
+    }
+    return ip_udp_payload(packet + offset, len - offset, frame_len);
+}
+
+static esp_err_t pcap_next(csi_replay_reader_handle_t r, csi_replay_record_t *record)
+{
+    while (true) {
+        uint8_t header[16];
+        size_t n = reader_read(r, header, sizeof(header));
+        if (n == 0) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (n != sizeof(header)) {
+            ESP_LOGW(TAG, "Truncated packet header at end of capture");
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint32_t ts_sec = pcap_u32(r, header);
+        uint32_t ts_frac = pcap_u32(r, header + 4);
+        uint32_t caplen = pcap_u32(r, header + 8);
+
+        if (caplen > sizeof(r->packet)) {
+            if (!reader_skip(r, caplen)) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            r->skipped++;
+            continue;
+        }
+        if (reader_read(r, r->packet, caplen) != caplen) {
+            ESP_LOGW(TAG, "Truncated packet at end of capture");
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        size_t frame_len = 0;
+        const uint8_t *frame = pcap_frame(r, r->packet, caplen, &frame_len);
+        if (!frame || frame_to_record(r, frame, frame_len, record) != ESP_OK) {
+            r->skipped++;
+            continue;
+        }
+
+        record->timestamp_us = (uint64_t)ts_sec * 1000000ULL +
+                               (r->pcap_nanos ? ts_frac / 1000 : ts_frac);
+        return ESP_OK;
+    }
+}
+
+// ===== CSV =====
+
+/**
+ * @brief Read one line, without the line terminator
+ * @return Line length, -1 at end of input, -2 if the line was too long
+ */
+static int csv_read_line(csi_replay_reader_handle_t r)
+{
+    size_t len = 0;
+    bool truncated = false;
+    int c;
+
+    while ((c = reader_getc(r)) != EOF && c != '\n') {
+        if (len + 1 < sizeof(r->line)) {
+            r->line[len++] = (char)c;
+        } else {
+            truncated = true;
+        }
+    }
+    if (c == EOF && len == 0 && !truncated) {
+        return -1;
+    }
+    if (len > 0 && r->line[len - 1] == '\r') {
+        len--;
+    }
+    r->line[len] = '\0';
+    return truncated ? -2 : (int)len;
+}
+
+/**
+ * @brief Parse an ESP32-CSI-Tool "CSI_DATA,..." line
+ * @return true if the line holds a complete report
+ */
+static bool csv_parse_line(csi_replay_reader_handle_t r, csi_replay_record_t *record)
+{
+    if (strncmp(r->line, "CSI_DATA,", 9) != 0) {
+        return false;
+    }
+
+    // Split the metadata; the role (field 1) and real_timestamp (field 23)
+    // are free text and not used
+    char *fields[CSV_FIELDS];
+    char *p = r->line;
+    for (int i = 0; i < CSV_FIELDS; i++) {
+        fields[i] = p;
+        p = strchr(p, ',');
+        if (!p) {
+            return false;
+        }
+        *p++ = '\0';
+    }
+
+    long values[CSV_FIELDS] = {0};
+    for (int i = 3; i < CSV_FIELDS; i++) {
+        if (i == 23) {
+            continue;
+        }
+        char *end;
+        values[i] = strtol(fields[i], &end, 10);
+        if (end == fields[i]) {
+            return false;
+        }
+    }
+
+    memset(record, 0, sizeof(*record));
+    unsigned mac[6];
+    if (sscanf(fields[2], "%2x:%2x:%2x:%2x:%2x:%2x",
+               &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        record->info.mac[i] = (uint8_t)mac[i];
+    }
+
+    // Raw CSI: "[v v v ...]", sometimes quoted
+    while (*p == ' ' || *p == '"') {
+        p++;
+    }
+    if (*p++ != '[') {
+        return false;
+    }
+    uint16_t len = 0;
+    while (true) {
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p == ']') {
+            break;
+        }
+        char *end;
+        long v = strtol(p, &end, 10);
+        if (end == p || v < INT8_MIN || v > INT8_MAX || len >= CSI_REPLAY_MAX_CSI_LEN) {
+            return false;
+        }
+        r->csi[len++] = (int8_t)v;
+        p = end;
+    }
+    if (len == 0) {
+        return false;
+    }
+
+    wifi_pkt_rx_ctrl_t *rx = &record->info.rx_ctrl;
+    rx->rssi = values[3];
+    rx->rate = values[4];
+    rx->sig_mode = values[5];
+    rx->mcs = values[6];
+    rx->cwb = values[7];
+    rx->smoothing = values[8];
+    rx->not_sounding = values[9];
+    rx->aggregation = values[10];
+    rx->stbc = values[11];
+    rx->fec_coding = values[12];
+    rx->sgi = values[13];
+    rx->noise_floor = values[14];
+    rx->ampdu_cnt = values[15];
+    rx->channel = values[16];
+    rx->secondary_channel = values[17];
+    rx->timestamp = (uint32_t)values[18];
+    rx->ant = values[19];
+    rx->sig_len = values[20];
+    rx->rx_state = values[21];
+
+    // The tool prints a fixed number of values regardless of the len column
+    record->info.buf = r->csi;
+    record->info.len = len;
+
+    // local_timestamp is the 32-bit microsecond counter; unwrap it
+    uint32_t ts = (uint32_t)values[18];
+    if (r->have_timestamp && ts < r->last_timestamp) {
+        r->timestamp_base += 1ULL << 32;
+    }
+    r->have_timestamp = true;
+    r->last_timestamp = ts;
+    record->timestamp_us = r->timestamp_base + ts;
+    return true;
+}
+
+static esp_err_t csv_next(csi_replay_reader_handle_t r, csi_replay_record_t *record)
+{
+    while (true) {
+        int len = csv_read_line(r);
+        if (len == -1) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (len > 0 && csv_parse_line(r, record)) {
+            return ESP_OK;
+        }
+        // Header, log output and torn lines from an interrupted recording
+        if (len != 0) {
+            r->skipped++;
+        }
+    }
+}
+
+// ===== API =====
+
+/**
+ * @brief Guess the format from the first four bytes
+ */
+static csi_replay_format_t detect_format(const uint8_t *head, size_t len)
+{
+    if (len >= 4) {
+        uint32_t le = load_le32(head);
+        uint32_t be = load_be32(head);
+        if (le == PCAP_MAGIC_US || le == PCAP_MAGIC_NS || be == PCAP_MAGIC_US ||
+            be == PCAP_MAGIC_NS || le == PCAPNG_MAGIC) {
+            return CSI_REPLAY_FORMAT_PCAP;
+        }
+    }
+    if (len >= 3 && head[0] == (CSI_FRAME_MAGIC & 0xff) && head[1] == (CSI_FRAME_MAGIC >> 8) &&
+        head[2] == CSI_FRAME_VERSION) {
+        return CSI_REPLAY_FORMAT_BINARY;
+    }
+    return CSI_REPLAY_FORMAT_CSV;
+}
+
+esp_err_t csi_replay_reader_open(FILE *input, csi_replay_format_t format,
+                                 csi_replay_reader_handle_t *reader)
+{
+    if (!input || !reader || format > CSI_REPLAY_FORMAT_PCAP) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    csi_replay_reader_handle_t r = calloc(1, sizeof(*r));
+    if (!r) {
+        ESP_LOGE(TAG, "Failed to allocate reader");
+        return ESP_ERR_NO_MEM;
+    }
+    r->input = input;
+
+    if (format == CSI_REPLAY_FORMAT_AUTO) {
+        r->pushback_len = fread(r->pushback, 1, sizeof(r->pushback), input);
+        format = detect_format(r->pushback, r->pushback_len);
+        if (r->pushback_len == sizeof(r->pushback) && load_le32(r->pushback) == PCAPNG_MAGIC) {
+            ESP_LOGE(TAG, "pcapng is not supported, convert with: editcap -F pcap");
+            free(r);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+    r->format = format;
+
+    if (format == CSI_REPLAY_FORMAT_PCAP) {
+        esp_err_t err = pcap_open(r);
+        if (err != ESP_OK) {
+            free(r);
+            return err;
+        }
+    }
+
+    *reader = r;
+    return ESP_OK;
+}
+
+esp_err_t csi_replay_reader_next(csi_replay_reader_handle_t reader, csi_replay_record_t *record)
+{
+    if (!reader || !record) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    switch (reader->format) {
+        case CSI_REPLAY_FORMAT_CSV:
+            return csv_next(reader, record);
+        case CSI_REPLAY_FORMAT_BINARY:
+            return binary_next(reader, record);
+        case CSI_REPLAY_FORMAT_PCAP:
+            return pcap_next(reader, record);
+        default:
+            return ESP_ERR_INVALID_STATE;
+    }
+}
+
+csi_replay_format_t csi_replay_reader_format(csi_replay_reader_handle_t reader)
+{
+    return reader ? reader->format : CSI_REPLAY_FORMAT_AUTO;
+}
+
+uint32_t csi_replay_reader_skipped(csi_replay_reader_handle_t reader)
+{
+    return reader ? reader->skipped : 0;
+}
+
+void csi_replay_reader_close(csi_replay_reader_handle_t reader)
+{
+    free(reader);
+}
+
+esp_err_t csi_replay_format_from_name(const char *name, csi_replay_format_t *format)
+{
+    static const char *const names[] = {
+        [CSI_REPLAY_FORMAT_AUTO] = "auto",
+        [CSI_REPLAY_FORMAT_CSV] = "csv",
+        [CSI_REPLAY_FORMAT_BINARY] = "binary",
+        [CSI_REPLAY_FORMAT_PCAP] = "pcap",
+    };
+
+    if (!name || !format) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            *format = (csi_replay_format_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,661 @@
+/**
+ * @file test_csi_replay.c
+ * @brief Unit tests for CSI replay component
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "csi_replay.h"
+#include "csi_collector.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#ifdef CSI_HOST_BUILD
+#include "esp_host.h"
+#endif
+
+static const char *TAG = "REPLAY_TEST";
+
+static const char *CSV_HEADER =
+    "type,role,mac,rssi,rate,sig_mode,mcs,bandwidth,smoothing,not_sounding,aggregation,stbc,"
+    "fec_coding,sgi,noise_floor,ampdu_cnt,channel,secondary_channel,local_timestamp,ant,sig_len,"
+    "rx_state,real_time_set,real_timestamp,len,CSI_DATA\n";
+
+/**
+ * @brief Recording buffer shared by the tests
+ */
+static uint8_t s_recording[4096];
+static size_t s_recording_len;
+
+/**
+ * @brief Reports seen by the test sink
+ */
+static struct {
+    uint32_t count;
+    int64_t times_us[16];
+    uint8_t last_mac[6];
+    int8_t last_buf[16];
+    uint16_t last_len;
+    esp_err_t result;
+} s_sink;
+
+static esp_err_t test_sink(void *ctx, wifi_csi_info_t *info)
+{
+    if (s_sink.count < sizeof(s_sink.times_us) / sizeof(s_sink.times_us[0])) {
+        s_sink.times_us[s_sink.count] = esp_timer_get_time();
+    }
+    s_sink.count++;
+    memcpy(s_sink.last_mac, info->mac, sizeof(s_sink.last_mac));
+    s_sink.last_len = info->len;
+    memcpy(s_sink.last_buf, info->buf, info->len < sizeof(s_sink.last_buf) ? info->len : sizeof(s_sink.last_buf));
+    return s_sink.result;
+}
+
+static void append(const void *data, size_t len)
+{
+    TEST_ASSERT_TRUE(s_recording_len + len <= sizeof(s_recording));
+    memcpy(s_recording + s_recording_len, data, len);
+    s_recording_len += len;
+}
+
+static void append_csv_line(const char *mac, int rssi, int channel, uint32_t local_timestamp)
+{
+    char line[256];
+    int n = snprintf(line, sizeof(line),
+                     "CSI_DATA,STA,%s,%d,11,1,7,0,0,0,0,0,0,0,-92,0,%d,0,%lu,0,128,0,0,0.0,8,"
+                     "[1 -1 2 -2 3 -3 4 -4 ]\n",
+                     mac, rssi, channel, (unsigned long)local_timestamp);
+    append(line, (size_t)n);
+}
+
+/**
+ * @brief Append a binary frame with raw CSI {1, -1, 2, -2, ...}
+ */
+static void append_frame(uint32_t sequence, uint64_t timestamp, bool raw)
+{
+    int8_t data[8] = {1, -1, 2, -2, 3, -3, 4, -4};
+    csi_data_t csi_data = {
+        .sequence = sequence,
+        .timestamp = timestamp,
+        .mac = {0x24, 0x0a, 0xc4, 0x01, 0x02, (uint8_t)sequence},
+        .rssi = -60,
+        .channel = 11,
+        .len = sizeof(data),
+        .data = raw ? data : NULL,
+        .subcarrier_count = 4,
+    };
+    uint8_t frame[sizeof(csi_frame_header_t) + sizeof(data)];
+    csi_collector_encode_frame(&csi_data, frame);
+    append(frame, csi_collector_frame_size(&csi_data));
+}
+
+static void append_u32(uint32_t v, bool big_endian)
+{
+    uint8_t b[4];
+    for (int i = 0; i < 4; i++) {
+        b[big_endian ? 3 - i : i] = (uint8_t)(v >> (8 * i));
+    }
+    append(b, sizeof(b));
+}
+
+static void append_pcap_header(uint32_t magic, uint32_t linktype, bool big_endian)
+{
+    append_u32(magic, big_endian);
+    append_u32(0x00040002, big_endian);     // 2.4, both halves swapped together
+    append_u32(0, big_endian);
+    append_u32(0, big_endian);
+    append_u32(65535, big_endian);
+    append_u32(linktype, big_endian);
+}
+
+static void append_pcap_record(uint32_t ts_sec, uint32_t ts_frac, size_t len, bool big_endian)
+{
+    append_u32(ts_sec, big_endian);
+    append_u32(ts_frac, big_endian);
+    append_u32((uint32_t)len, big_endian);
+    append_u32((uint32_t)len, big_endian);
+}
+
+/**
+ * @brief Append an Ethernet/IPv4/UDP packet carrying a binary frame
+ */
+static void append_pcap_udp_frame(uint32_t ts_sec, uint32_t ts_usec, uint32_t sequence)
+{
+    size_t frame_len = sizeof(csi_frame_header_t) + 8;
+    size_t ip_len = 20 + 8 + frame_len;
+    append_pcap_record(ts_sec, ts_usec, 14 + ip_len, false);
+
+    uint8_t eth[14] = {0x02, 0, 0, 0, 0, 1, 0x02, 0, 0, 0, 0, 2, 0x08, 0x00};
+    append(eth, sizeof(eth));
+    uint8_t ip[20] = {0x45, 0, (uint8_t)(ip_len >> 8), (uint8_t)ip_len, 0, 0, 0x40, 0, 64, 17};
+    append(ip, sizeof(ip));
+    uint16_t udp_len = (uint16_t)(8 + frame_len);
+    uint8_t udp[8] = {0x13, 0x88, 0x13, 0x88, (uint8_t)(udp_len >> 8), (uint8_t)udp_len, 0, 0};
+    append(udp, sizeof(udp));
+    append_frame(sequence, 1000 + sequence, true);
+}
+
+static FILE *open_recording(void)
+{
+    FILE *f = fmemopen(s_recording, s_recording_len, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    return f;
+}
+
+void setUp(void)
+{
+    memset(s_recording, 0, sizeof(s_recording));
+    s_recording_len = 0;
+    memset(&s_sink, 0, sizeof(s_sink));
+}
+
+void tearDown(void)
+{
+    csi_replay_stop();
+    csi_collector_deinit();
+}
+
+/**
+ * @brief Test format names
+ */
+void test_csi_replay_format_from_name(void)
+{
+    csi_replay_format_t format;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_format_from_name("pcap", &format));
+    TEST_ASSERT_EQUAL(CSI_REPLAY_FORMAT_PCAP, format);
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_format_from_name("CSV", &format));
+    TEST_ASSERT_EQUAL(CSI_REPLAY_FORMAT_CSV, format);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, csi_replay_format_from_name("pcapng", &format));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, csi_replay_format_from_name(NULL, &format));
+}
+
+/**
+ * @brief Test reading an ESP32-CSI-Tool CSV recording
+ */
+void test_csi_replay_reader_csv(void)
+{
+    append(CSV_HEADER, strlen(CSV_HEADER));
+    append("I (1234) wifi: connected\n", 25);
+    append_csv_line("24:0A:C4:01:02:03", -48, 6, 1000);
+    append("\n", 1);
+    append_csv_line("24:0A:C4:01:02:04", -51, 6, 21000);
+    append("CSI_DATA,STA,24:0A:C4", 21);      // Torn last line
+
+    FILE *f = open_recording();
+    csi_replay_reader_handle_t reader;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_AUTO, &reader));
+    TEST_ASSERT_EQUAL(CSI_REPLAY_FORMAT_CSV, csi_replay_reader_format(reader));
+
+    csi_replay_record_t record;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03};
+    TEST_ASSERT_EQUAL_MEMORY(mac, record.info.mac, 6);
+    TEST_ASSERT_EQUAL(-48, record.info.rx_ctrl.rssi);
+    TEST_ASSERT_EQUAL(6, record.info.rx_ctrl.channel);
+    TEST_ASSERT_EQUAL(-92, record.info.rx_ctrl.noise_floor);
+    TEST_ASSERT_EQUAL(7, record.info.rx_ctrl.mcs);
+    TEST_ASSERT_EQUAL(8, record.info.len);
+    int8_t expected[8] = {1, -1, 2, -2, 3, -3, 4, -4};
+    TEST_ASSERT_EQUAL_MEMORY(expected, record.info.buf, sizeof(expected));
+    TEST_ASSERT_TRUE(record.timestamp_us == 1000);
+
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_EQUAL(-51, record.info.rx_ctrl.rssi);
+    TEST_ASSERT_TRUE(record.timestamp_us == 21000);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_EQUAL(3, csi_replay_reader_skipped(reader));
+
+    csi_replay_reader_close(reader);
+    fclose(f);
+}
+
+/**
+ * @brief Test that the 32-bit CSV timestamp is unwrapped
+ */
+void test_csi_replay_reader_csv_timestamp_wrap(void)
+{
+    append_csv_line("24:0A:C4:01:02:03", -48, 6, 4294967000UL);
+    append_csv_line("24:0A:C4:01:02:03", -48, 6, 200);
+
+    FILE *f = open_recording();
+    csi_replay_reader_handle_t reader;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_CSV, &reader));
+
+    csi_replay_record_t first;
+    csi_replay_record_t second;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &first));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &second));
+    TEST_ASSERT_TRUE(second.timestamp_us - first.timestamp_us == 496);
+
+    csi_replay_reader_close(reader);
+    fclose(f);
+}
+
+/**
+ * @brief Test reading concatenated binary frames
+ */
+void test_csi_replay_reader_binary(void)
+{
+    append_frame(1, 5000, true);
+    append_frame(2, 6000, false);       // No raw CSI, nothing to replay
+    append_frame(3, 7000, true);
+
+    FILE *f = open_recording();
+    csi_replay_reader_handle_t reader;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_AUTO, &reader));
+    TEST_ASSERT_EQUAL(CSI_REPLAY_FORMAT_BINARY, csi_replay_reader_format(reader));
+
+    csi_replay_record_t record;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_TRUE(record.timestamp_us == 5000);
+    TEST_ASSERT_EQUAL(1, record.info.mac[5]);
+    TEST_ASSERT_EQUAL(-60, record.info.rx_ctrl.rssi);
+    TEST_ASSERT_EQUAL(11, record.info.rx_ctrl.channel);
+    TEST_ASSERT_EQUAL(8, record.info.len);
+
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_TRUE(record.timestamp_us == 7000);
+    TEST_ASSERT_EQUAL(3, record.info.mac[5]);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_EQUAL(1, csi_replay_reader_skipped(reader));
+
+    csi_replay_reader_close(reader);
+    fclose(f);
+}
+
+/**
+ * @brief Test that corrupt binary recordings stop the reader
+ */
+void test_csi_replay_reader_binary_corrupt(void)
+{
+    append_frame(1, 5000, true);
+    append("\x43\x53\x01\x01", 4);      // Version 1 header
+    append(s_recording, 24);
+
+    FILE *f = open_recording();
+    csi_replay_reader_handle_t reader;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_BINARY, &reader));
+    csi_replay_record_t record;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, csi_replay_reader_next(reader, &record));
+    csi_replay_reader_close(reader);
+    fclose(f);
+
+    // Cut short in the middle of the raw CSI
+    s_recording_len = sizeof(csi_frame_header_t) + 8 + sizeof(csi_frame_header_t) + 3;
+    memcpy(s_recording + sizeof(csi_frame_header_t) + 8, s_recording, sizeof(csi_frame_header_t));
+    f = open_recording();
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_BINARY, &reader));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, csi_replay_reader_next(reader, &record));
+    csi_replay_reader_close(reader);
+    fclose(f);
+}
+
+/**
+ * @brief Test reading binary frames from an Ethernet pcap
+ */
+void test_csi_replay_reader_pcap_ethernet(void)
+{
+    append_pcap_header(0xa1b2c3d4, 1, false);
+    append_pcap_udp_frame(100, 250000, 1);
+
+    // ARP packet, skipped
+    uint8_t arp[42] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0, 0, 0, 0, 1, 0x08, 0x06};
+    append_pcap_record(100, 260000, sizeof(arp), false);
+    append(arp, sizeof(arp));
+
+    append_pcap_udp_frame(100, 270000, 2);
+
+    FILE *f = open_recording();
+    csi_replay_reader_handle_t reader;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_AUTO, &reader));
+    TEST_ASSERT_EQUAL(CSI_REPLAY_FORMAT_PCAP, csi_replay_reader_format(reader));
+
+    csi_replay_record_t record;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_TRUE(record.timestamp_us == 100250000ULL);
+    TEST_ASSERT_EQUAL(1, record.info.mac[5]);
+    TEST_ASSERT_EQUAL(8, record.info.len);
+
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_TRUE(record.timestamp_us == 100270000ULL);
+    TEST_ASSERT_EQUAL(2, record.info.mac[5]);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_EQUAL(1, csi_replay_reader_skipped(reader));
+
+    csi_replay_reader_close(reader);
+    fclose(f);
+}
+
+/**
+ * @brief Test a big-endian, nanosecond pcap with frames as whole packets
+ */
+void test_csi_replay_reader_pcap_user0(void)
+{
+    append_pcap_header(0xa1b23c4d, 147, true);
+    append_pcap_record(7, 1500, sizeof(csi_frame_header_t) + 8, true);
+    append_frame(9, 0, true);
+
+    FILE *f = open_recording();
+    csi_replay_reader_handle_t reader;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_PCAP, &reader));
+
+    csi_replay_record_t record;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_reader_next(reader, &record));
+    TEST_ASSERT_TRUE(record.timestamp_us == 7000001ULL);
+    TEST_ASSERT_EQUAL(9, record.info.mac[5]);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, csi_replay_reader_next(reader, &record));
+
+    csi_replay_reader_close(reader);
+    fclose(f);
+}
+
+/**
+ * @brief Test that pcapng and unknown link types are refused
+ */
+void test_csi_replay_reader_pcap_unsupported(void)
+{
+    append_u32(0x0a0d0d0a, false);
+    append_u32(28, false);
+    append_u32(0x1a2b3c4d, false);
+
+    FILE *f = open_recording();
+    csi_replay_reader_handle_t reader;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_AUTO, &reader));
+    fclose(f);
+
+    s_recording_len = 0;
+    append_pcap_header(0xa1b2c3d4, 105, false);     // 802.11
+    f = open_recording();
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, csi_replay_reader_open(f, CSI_REPLAY_FORMAT_AUTO, &reader));
+    fclose(f);
+}
+
+/**
+ * @brief Test argument and state checks of csi_replay_start()
+ */
+void test_csi_replay_start_invalid(void)
+{
+    append_frame(1, 0, true);
+    FILE *f = open_recording();
+
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, csi_replay_start(NULL, &config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, csi_replay_start(f, NULL));
+
+    config.speed = -1.0f;
+    config.sink = test_sink;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, csi_replay_start(f, &config));
+
+    // The default sink needs a running collector
+    config.speed = 1.0f;
+    config.sink = NULL;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, csi_replay_start(f, &config));
+    TEST_ASSERT_FALSE(csi_replay_is_running());
+
+    fclose(f);
+}
+
+/**
+ * @brief Test replaying as fast as possible into a custom sink
+ */
+void test_csi_replay_full_speed(void)
+{
+    for (uint32_t i = 0; i < 10; i++) {
+        append_frame(i, i * 1000000ULL, true);  // One second apart
+    }
+    FILE *f = open_recording();
+
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    config.speed = 0;
+    config.exclusive = false;
+    config.sink = test_sink;
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_start(f, &config));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_wait(2000));
+    TEST_ASSERT_TRUE(esp_timer_get_time() - start < 1000000);
+
+    csi_replay_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_get_stats(&stats));
+    TEST_ASSERT_FALSE(stats.running);
+    TEST_ASSERT_EQUAL(ESP_OK, stats.result);
+    TEST_ASSERT_EQUAL(10, stats.frames_read);
+    TEST_ASSERT_EQUAL(10, stats.frames_injected);
+    TEST_ASSERT_EQUAL(10, s_sink.count);
+    TEST_ASSERT_EQUAL(9, s_sink.last_mac[5]);
+
+    fclose(f);
+}
+
+/**
+ * @brief Test recorded timing and the speed factor
+ */
+void test_csi_replay_timing(void)
+{
+    for (uint32_t i = 0; i < 5; i++) {
+        append_csv_line("24:0A:C4:01:02:03", -48, 6, 500000 + i * 50000);
+    }
+    FILE *f = open_recording();
+
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    config.exclusive = false;
+    config.sink = test_sink;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_start(f, &config));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_wait(2000));
+    TEST_ASSERT_EQUAL(5, s_sink.count);
+    int64_t span = s_sink.times_us[4] - s_sink.times_us[0];
+    ESP_LOGI(TAG, "1x: 200 ms recording replayed in %lld us", (long long)span);
+    TEST_ASSERT_INT_WITHIN(30000, 200000, (int)span);
+    fclose(f);
+
+    memset(&s_sink, 0, sizeof(s_sink));
+    f = open_recording();
+    config.speed = 4.0f;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_start(f, &config));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_wait(2000));
+    span = s_sink.times_us[4] - s_sink.times_us[0];
+    ESP_LOGI(TAG, "4x: 200 ms recording replayed in %lld us", (long long)span);
+    TEST_ASSERT_INT_WITHIN(30000, 50000, (int)span);
+    fclose(f);
+}
+
+/**
+ * @brief Test stopping a replay in the middle of a long gap
+ */
+void test_csi_replay_stop(void)
+{
+    append_frame(1, 0, true);
+    append_frame(2, 60000000ULL, true);     // A minute later
+    FILE *f = open_recording();
+
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    config.exclusive = false;
+    config.sink = test_sink;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_start(f, &config));
+    TEST_ASSERT_TRUE(csi_replay_is_running());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, csi_replay_start(f, &config));
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, csi_replay_wait(100));
+
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_stop());
+    TEST_ASSERT_FALSE(csi_replay_is_running());
+    TEST_ASSERT_EQUAL(1, s_sink.count);
+
+    fclose(f);
+}
+
+/**
+ * @brief Test that refused reports are counted
+ */
+void test_csi_replay_sink_rejects(void)
+{
+    append_frame(1, 0, true);
+    append_frame(2, 0, true);
+    FILE *f = open_recording();
+
+    s_sink.result = ESP_ERR_NO_MEM;
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    config.speed = 0;
+    config.exclusive = false;
+    config.sink = test_sink;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_start(f, &config));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_wait(2000));
+
+    csi_replay_stats_t stats;
+    csi_replay_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.frames_injected);
+    TEST_ASSERT_EQUAL(2, stats.frames_rejected);
+
+    fclose(f);
+}
+
+/**
+ * @brief Test replaying into the collector through its radio callback path
+ */
+void test_csi_replay_into_collector(void)
+{
+    csi_collector_config_t collector_config = {
+        .sample_rate = 100,
+        .buffer_size = 256,
+        .enable_rssi = true,
+        .enable_phase = true,
+        .enable_amplitude = true
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, csi_collector_init(&collector_config));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_collector_start());
+
+    for (uint32_t i = 0; i < 5; i++) {
+        append_frame(i, i * 1000ULL, true);
+    }
+    FILE *f = open_recording();
+
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    config.speed = 0;
+    config.wait_ms = 100;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_start(f, &config));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_wait(2000));
+
+    csi_replay_stats_t stats;
+    csi_replay_get_stats(&stats);
+    TEST_ASSERT_EQUAL(5, stats.frames_injected);
+
+    csi_data_t csi_data;
+    TEST_ASSERT_EQUAL(ESP_OK, csi_collector_get_data(&csi_data, 1000));
+    TEST_ASSERT_EQUAL(0, csi_data.mac[5]);
+    TEST_ASSERT_EQUAL(-60, csi_data.rssi);
+    TEST_ASSERT_EQUAL(11, csi_data.channel);
+    TEST_ASSERT_EQUAL(8, csi_data.len);
+    csi_collector_free_data(&csi_data);
+
+    csi_collector_stats_t collector_stats;
+    csi_collector_get_stats(&collector_stats);
+    TEST_ASSERT_EQUAL(5, collector_stats.packets_received);
+    TEST_ASSERT_EQUAL(0, collector_stats.packets_dropped);
+
+    fclose(f);
+}
+
+#ifdef CSI_HOST_BUILD
+static struct {
+    size_t pos;
+    int closes;
+} s_counted;
+
+static ssize_t counted_read(void *cookie, char *buf, size_t size)
+{
+    size_t n = s_recording_len - s_counted.pos < size ? s_recording_len - s_counted.pos : size;
+    memcpy(buf, s_recording + s_counted.pos, n);
+    s_counted.pos += n;
+    return (ssize_t)n;
+}
+
+static int counted_close(void *cookie)
+{
+    s_counted.closes++;
+    return 0;
+}
+
+/**
+ * @brief Recording stream that counts how often it is closed
+ */
+static FILE *open_counted_recording(void)
+{
+    memset(&s_counted, 0, sizeof(s_counted));
+    FILE *f = fopencookie(NULL, "rb", (cookie_io_functions_t){
+        .read = counted_read,
+        .close = counted_close,
+    });
+    TEST_ASSERT_NOT_NULL(f);
+    return f;
+}
+
+/**
+ * @brief Test that the input has one owner whether or not the replay starts
+ */
+void test_csi_replay_close_input(void)
+{
+    append_frame(1, 0, true);
+
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    config.speed = 0;
+    config.exclusive = false;
+    config.close_input = true;
+    config.sink = test_sink;
+
+    // No task: the input stays with the caller
+    FILE *f = open_counted_recording();
+    esp_host_fail_task_create(1);
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, csi_replay_start(f, &config));
+    TEST_ASSERT_FALSE(csi_replay_is_running());
+    TEST_ASSERT_EQUAL(0, s_counted.closes);
+    fclose(f);
+    TEST_ASSERT_EQUAL(1, s_counted.closes);
+
+    // Started: the replay closes it when it ends
+    f = open_counted_recording();
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_start(f, &config));
+    TEST_ASSERT_EQUAL(ESP_OK, csi_replay_wait(2000));
+    TEST_ASSERT_EQUAL(1, s_sink.count);
+    TEST_ASSERT_EQUAL(1, s_counted.closes);
+}
+#endif
+
+/**
+ * @brief Main test runner
+ */
+void app_main(void)
+{
+    ESP_LOGI(TAG, "Starting CSI Replay unit tests");
+
+    UNITY_BEGIN();
+
+    // Reader tests
+    RUN_TEST(test_csi_replay_format_from_name);
+    RUN_TEST(test_csi_replay_reader_csv);
+    RUN_TEST(test_csi_replay_reader_csv_timestamp_wrap);
+    RUN_TEST(test_csi_replay_reader_binary);
+    RUN_TEST(test_csi_replay_reader_binary_corrupt);
+    RUN_TEST(test_csi_replay_reader_pcap_ethernet);
+    RUN_TEST(test_csi_replay_reader_pcap_user0);
+    RUN_TEST(test_csi_replay_reader_pcap_unsupported);
+
+    // Replay tests
+    RUN_TEST(test_csi_replay_start_invalid);
+    RUN_TEST(test_csi_replay_full_speed);
+    RUN_TEST(test_csi_replay_timing);
+    RUN_TEST(test_csi_replay_stop);
+    RUN_TEST(test_csi_replay_sink_rejects);
+    RUN_TEST(test_csi_replay_into_collector);
+#ifdef CSI_HOST_BUILD
+    RUN_TEST(test_csi_replay_close_input);
+#endif
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "CSI Replay unit tests completed");
+}
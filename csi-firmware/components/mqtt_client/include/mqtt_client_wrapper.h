@@ -46,8 +46,60 @@ typedef struct {
     uint32_t publish_errors;    ///< Publish error count
     bool connected;             ///< Current connection status
     uint64_t last_activity;     ///< Last activity timestamp
+    uint32_t tls_handshakes;    ///< Completed TLS handshakes
+    uint32_t tls_resumed;       ///< TLS handshakes that resumed a cached session
+    uint32_t tls_handshake_ms;  ///< Duration of the last TLS handshake
+    uint32_t tls_handshake_max_ms; ///< Longest TLS handshake
+    uint32_t tls_heap_peak;     ///< Largest heap use during a TLS handshake (bytes)
+    uint32_t reconnect_attempts; ///< Reconnect attempts made
+    uint32_t last_reconnect_delay_ms; ///< Backoff delay before the last reconnect attempt
 } mqtt_stats_t;
 
+/**
+ * @brief Message classes of the priority outbox
+ * 
+ * Each class has its own memory budget and overflow policy and a weighted
+ * share of the link. Control, alerts and status always get through; bulk
+ * CSI is dropped first under congestion or memory pressure.
+ */
+typedef enum {
+    MQTT_CLASS_TELEMETRY = 0,   ///< Periodic metrics and other default traffic
+    MQTT_CLASS_CONTROL,         ///< Config acks and command responses
+    MQTT_CLASS_ALERT,           ///< Alerts and errors
+    MQTT_CLASS_STATUS,          ///< Device status
+    MQTT_CLASS_CSI,             ///< Bulk CSI data
+    MQTT_CLASS_MAX
+} mqtt_msg_class_t;
+
+/**
+ * @brief Outbox counters of one message class
+ */
+typedef struct {
+    uint32_t queued_msgs;       ///< Messages waiting
+    uint32_t queued_bytes;      ///< Bytes waiting
+    uint32_t sent;              ///< Messages handed to the MQTT client
+    uint32_t dropped;           ///< Messages dropped by the overflow policy
+    uint32_t expired;           ///< Messages dropped because they went stale
+    uint32_t max_wait_ms;       ///< Longest time a sent message spent queued
+} mqtt_outbox_stats_t;
+
+/**
+ * @brief Per-message publish options
+ * 
+ * Everything except qos and retain is an MQTT v5 property. The properties
+ * are sent when the firmware is built with CONFIG_MQTT_PROTOCOL_5 and are
+ * ignored on MQTT 3.1.1.
+ */
+typedef struct {
+    int qos;                    ///< Quality of Service level
+    bool retain;                ///< Retain message flag
+    bool utf8_payload;          ///< Payload format indicator: payload is UTF-8 text
+    const char *content_type;   ///< MIME type of the payload, NULL for none
+    uint32_t expiry_s;          ///< Message expiry interval in seconds, 0 for none
+    bool topic_alias;           ///< Send a topic alias instead of the topic once established
+    mqtt_msg_class_t msg_class; ///< Outbox class (default: telemetry)
+} mqtt_publish_options_t;
+
 /**
  * @brief MQTT message callback function type
  * @param topic Message topic
@@ -95,6 +147,30 @@ bool mqtt_client_is_connected(void);
  */
 esp_err_t mqtt_client_publish_csi_data(const csi_data_t *csi_data);
 
+/**
+ * @brief Publish CSI data as a binary frame
+ * 
+ * Publishes a csi_frame_header_t followed by the raw CSI buffer to
+ * "<prefix>/csi_frame". Much smaller than the JSON form; amplitude and
+ * phase are left to the receiver.
+ * 
+ * @param csi_data CSI data to publish
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t mqtt_client_publish_csi_frame(const csi_data_t *csi_data);
+
+/**
+ * @brief Publish a CSI drop report
+ * 
+ * Publishes the ranges as JSON (see csi_collector_drops_to_json()) to
+ * "<prefix>/csi_drops" so a receiver can attribute sequence gaps.
+ * 
+ * @param ranges Drop ranges from csi_collector_take_drops()
+ * @param count Number of ranges
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t mqtt_client_publish_csi_drops(const csi_drop_range_t *ranges, size_t count);
+
 /**
  * @brief Publish generic message
  * @param topic Topic to publish to
@@ -106,6 +182,21 @@ esp_err_t mqtt_client_publish_csi_data(const csi_data_t *csi_data);
  */
 esp_err_t mqtt_client_publish(const char *topic, const char *data, int data_len, int qos, int retain);
 
+/**
+ * @brief Publish message with MQTT v5 properties and an outbox class
+ * 
+ * Like every publish, the message is queued in the priority outbox and
+ * sent by the outbox task; ESP_OK means it was accepted.
+ * 
+ * @param topic Topic to publish to
+ * @param data Message data
+ * @param data_len Message data length
+ * @param options Publish options
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t mqtt_client_publish_with_options(const char *topic, const char *data, int data_len,
+                                           const mqtt_publish_options_t *options);
+
 /**
  * @brief Subscribe to topic
  * @param topic Topic to subscribe to
@@ -142,6 +233,25 @@ esp_err_t mqtt_client_get_stats(mqtt_stats_t *stats);
  */
 esp_err_t mqtt_client_reset_stats(void);
 
+/**
+ * @brief Get outbox counters of a message class
+ * @param msg_class Message class
+ * @param stats Pointer to statistics structure to fill
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t mqtt_client_get_outbox_stats(mqtt_msg_class_t msg_class, mqtt_outbox_stats_t *stats);
+
+/**
+ * @brief Forget the cached TLS session
+ * 
+ * With SSL enabled, reconnects resume the last TLS session, which is also
+ * kept in RTC memory across soft restarts. Clear it after changing the
+ * broker or its certificate.
+ * 
+ * @return ESP_OK on success
+ */
+esp_err_t mqtt_client_clear_tls_session(void);
+
 // ===== MQTT PUBLISHER UTILITIES =====
 
 /**
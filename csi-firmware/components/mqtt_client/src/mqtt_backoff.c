@@ -0,0 +1,129 @@
+/**
+ * @file mqtt_backoff.c
+ * @brief Reconnect backoff with decorrelated jitter
+ */
+
+#include "mqtt_backoff.h"
+#include <string.h>
+
+// MQTT v5 reason codes signalling broker overload
+#define MQTT5_RC_SERVER_UNAVAILABLE     0x88
+#define MQTT5_RC_SERVER_BUSY            0x89
+#define MQTT5_RC_QUOTA_EXCEEDED         0x97
+#define MQTT5_RC_CONNECTION_RATE        0x9F
+
+// MQTT 3.1.1 CONNACK return code
+#define MQTT3_RC_SERVER_UNAVAILABLE     0x03
+
+static uint32_t mqtt_backoff_random(mqtt_backoff_t *backoff)
+{
+    uint32_t x = backoff->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    backoff->rng = x;
+    return x;
+}
+
+/**
+ * @brief Uniform value in [lo, hi]
+ */
+static uint32_t mqtt_backoff_between(mqtt_backoff_t *backoff, uint32_t lo, uint32_t hi)
+{
+    if (hi <= lo) {
+        return lo;
+    }
+    return lo + (uint32_t)(((uint64_t)mqtt_backoff_random(backoff) * (hi - lo + 1)) >> 32);
+}
+
+uint32_t mqtt_backoff_phase_ms(const uint8_t mac[6], uint32_t window_ms)
+{
+    if (!mac || window_ms == 0) {
+        return 0;
+    }
+
+    // FNV-1a: neighbouring MACs from one vendor block land far apart
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        hash ^= mac[i];
+        hash *= 16777619u;
+    }
+    return hash % window_ms;
+}
+
+void mqtt_backoff_init(mqtt_backoff_t *backoff, uint32_t base_ms, uint32_t cap_ms,
+                       const uint8_t mac[6], uint32_t seed)
+{
+    memset(backoff, 0, sizeof(mqtt_backoff_t));
+    backoff->base_ms = base_ms > 0 ? base_ms : 1;
+    backoff->cap_ms = cap_ms > backoff->base_ms ? cap_ms : backoff->base_ms;
+    backoff->phase_ms = mqtt_backoff_phase_ms(mac, MQTT_BACKOFF_PHASE_MS);
+
+    uint32_t rng = seed ^ 0x9E3779B9u;
+    if (mac) {
+        for (int i = 0; i < 6; i++) {
+            rng = (rng ^ mac[i]) * 16777619u;
+        }
+    }
+    backoff->rng = rng ? rng : 1;
+}
+
+uint32_t mqtt_backoff_next(mqtt_backoff_t *backoff)
+{
+    uint32_t delay;
+
+    if (backoff->hint_ms > 0) {
+        // Honour the server, with some jitter so hinted nodes do not align
+        delay = mqtt_backoff_between(backoff, backoff->hint_ms, backoff->hint_ms + backoff->base_ms);
+        backoff->hint_ms = 0;
+    } else {
+        uint32_t prev = backoff->prev_ms > 0 ? backoff->prev_ms : backoff->base_ms;
+        uint64_t hi = (uint64_t)prev * 3;
+        delay = mqtt_backoff_between(backoff, backoff->base_ms,
+                                     hi > backoff->cap_ms ? backoff->cap_ms : (uint32_t)hi);
+    }
+
+    // A hinted delay may exceed the cap; the sequence continues from below it
+    backoff->prev_ms = delay < backoff->cap_ms ? delay : backoff->cap_ms;
+
+    if (backoff->attempts++ == 0) {
+        // Spread the first retry of a fleet that lost the broker together
+        delay += backoff->phase_ms;
+    }
+
+    return delay;
+}
+
+void mqtt_backoff_set_hint(mqtt_backoff_t *backoff, uint32_t hint_ms)
+{
+    if (hint_ms > MQTT_BACKOFF_HINT_MAX_MS) {
+        hint_ms = MQTT_BACKOFF_HINT_MAX_MS;
+    }
+    if (hint_ms > backoff->hint_ms) {
+        backoff->hint_ms = hint_ms;
+    }
+}
+
+void mqtt_backoff_reset(mqtt_backoff_t *backoff)
+{
+    backoff->prev_ms = 0;
+    backoff->hint_ms = 0;
+    backoff->attempts = 0;
+}
+
+uint32_t mqtt_backoff_hint_for_reason(int reason_code, bool mqtt_v5)
+{
+    if (!mqtt_v5) {
+        return reason_code == MQTT3_RC_SERVER_UNAVAILABLE ? MQTT_BACKOFF_BUSY_MS : 0;
+    }
+
+    switch (reason_code) {
+        case MQTT5_RC_SERVER_UNAVAILABLE:
+        case MQTT5_RC_SERVER_BUSY:
+        case MQTT5_RC_QUOTA_EXCEEDED:
+        case MQTT5_RC_CONNECTION_RATE:
+            return MQTT_BACKOFF_BUSY_MS;
+        default:
+            return 0;
+    }
+}
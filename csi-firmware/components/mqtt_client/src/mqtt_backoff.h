@@ -0,0 +1,106 @@
+/**
+ * @file mqtt_backoff.h
+ * @brief Reconnect backoff with decorrelated jitter
+ *
+ * Delays follow the "decorrelated jitter" scheme: each delay is drawn
+ * uniformly from [base, 3 * previous delay] and capped. Nodes that lost
+ * the broker at the same instant therefore drift apart instead of
+ * retrying in lockstep. A per-node phase derived from the MAC address
+ * spreads the very first retry, and a server hint (MQTT v5 reason code or
+ * retry property) sets a floor for the next delay.
+ *
+ * This file has no ESP-IDF dependencies so host tools can share it.
+ */
+
+#ifndef MQTT_BACKOFF_H
+#define MQTT_BACKOFF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_BACKOFF_BASE_MS        1000    ///< Smallest delay
+#define MQTT_BACKOFF_CAP_MS         120000  ///< Largest delay
+#define MQTT_BACKOFF_PHASE_MS       10000   ///< Window for the per-node phase offset
+#define MQTT_BACKOFF_BUSY_MS        30000   ///< Floor after the broker reported overload
+#define MQTT_BACKOFF_STABLE_MS      30000   ///< Connection age that resets the backoff
+#define MQTT_BACKOFF_HINT_MAX_MS    3600000 ///< Longest server hint honoured
+
+/**
+ * @brief Backoff state
+ */
+typedef struct {
+    uint32_t base_ms;           ///< Smallest delay
+    uint32_t cap_ms;            ///< Largest delay
+    uint32_t prev_ms;           ///< Previous delay (0 before the first retry)
+    uint32_t hint_ms;           ///< Server requested minimum for the next delay
+    uint32_t phase_ms;          ///< Per-node offset added to the first retry
+    uint32_t rng;               ///< xorshift32 state
+    uint32_t attempts;          ///< Retries since the last reset
+} mqtt_backoff_t;
+
+/**
+ * @brief Initialize backoff state
+ * @param backoff Backoff state
+ * @param base_ms Smallest delay
+ * @param cap_ms Largest delay
+ * @param mac Node MAC address, used for the phase offset and the RNG seed
+ * @param seed Additional entropy (e.g. a hardware random number)
+ */
+void mqtt_backoff_init(mqtt_backoff_t *backoff, uint32_t base_ms, uint32_t cap_ms,
+                       const uint8_t mac[6], uint32_t seed);
+
+/**
+ * @brief Compute the delay before the next reconnect attempt
+ * @param backoff Backoff state
+ * @return Delay in milliseconds
+ */
+uint32_t mqtt_backoff_next(mqtt_backoff_t *backoff);
+
+/**
+ * @brief Record a server provided retry hint
+ *
+ * The next delay will be at least the hint, limited to
+ * MQTT_BACKOFF_HINT_MAX_MS, plus up to one base delay of jitter. The
+ * decorrelated sequence continues from the hint afterwards.
+ *
+ * @param backoff Backoff state
+ * @param hint_ms Minimum delay requested by the server
+ */
+void mqtt_backoff_set_hint(mqtt_backoff_t *backoff, uint32_t hint_ms);
+
+/**
+ * @brief Start over after a stable connection
+ * @param backoff Backoff state
+ */
+void mqtt_backoff_reset(mqtt_backoff_t *backoff);
+
+/**
+ * @brief Derive a stable per-node offset from a MAC address
+ * @param mac Node MAC address
+ * @param window_ms Offset range
+ * @return Offset in [0, window_ms)
+ */
+uint32_t mqtt_backoff_phase_ms(const uint8_t mac[6], uint32_t window_ms);
+
+/**
+ * @brief Map an MQTT connect/disconnect reason code to a retry hint
+ *
+ * Covers the MQTT v5 overload codes (server unavailable, server busy,
+ * quota exceeded, connection rate exceeded) and the MQTT 3.1.1 "server
+ * unavailable" CONNACK code.
+ *
+ * @param reason_code Reason or return code
+ * @param mqtt_v5 true if the code is an MQTT v5 reason code
+ * @return Minimum delay in milliseconds, 0 if the code carries no hint
+ */
+uint32_t mqtt_backoff_hint_for_reason(int reason_code, bool mqtt_v5);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_BACKOFF_H
@@ -20,22 +20,63 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_system.h>
+#include <esp_mac.h>
+#include <esp_random.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 #include <esp_tls.h>
 #include <mqtt_client.h>
-#include <cJSON.h>
+#ifdef CONFIG_MQTT_PROTOCOL_5
+#include <mqtt5_client.h>
+#endif
 
 #include "mqtt_client_wrapper.h"
+#include "mqtt_tls_transport.h"
+#include "mqtt_backoff.h"
+#include "mqtt_outbox.h"
 
 static const char *TAG = "MQTT_CLIENT";
 
 // Event bits for MQTT connection status
 #define MQTT_CONNECTED_BIT      BIT0
 #define MQTT_DISCONNECTED_BIT   BIT1
+#define MQTT_ATTEMPT_DONE_BIT   BIT2
+#define MQTT_OUTBOX_STOPPED_BIT BIT3
 
-// Maximum retry attempts for reconnection
-#define MAX_RETRY_ATTEMPTS      10
-#define RETRY_DELAY_MS         5000
+// Upper bound for one reconnect attempt to report back
+#define RECONNECT_ATTEMPT_TIMEOUT_MS 15000
+
+// Server hint carried as an MQTT v5 user property, in seconds
+#define MQTT_RETRY_AFTER_PROPERTY "retry-after"
+
+// Topics that may be replaced by an MQTT v5 topic alias
+#define MQTT_TOPIC_ALIAS_MAX    4
+
+// CSI older than this is of no use to the positioning pipeline
+#define CSI_MESSAGE_EXPIRY_S    5
+
+// CSI_FRAME_CONTENT_TYPE is sent with every binary frame; JSON is marked by
+// the payload format indicator alone, as a content type would cost more
+// than the alias saves
+
+// Outbox sender: bulk classes wait while esp-mqtt holds more than this
+#define OUTBOX_INFLIGHT_LIMIT   8192
+#define OUTBOX_BULK_CLASSES     ((1u << MQTT_CLASS_CSI) | (1u << MQTT_CLASS_TELEMETRY))
+#define OUTBOX_LOW_HEAP         24576   // below this CSI is refused and shed
+#define OUTBOX_IDLE_MS          100
+#define OUTBOX_STOP_TIMEOUT_MS  2000    // Stop warns, then keeps waiting
+
+_Static_assert(MQTT_CLASS_MAX == MQTT_OUTBOX_CLASSES, "outbox class count mismatch");
+
+// Budgets and weights per class; CSI gets the largest budget but the
+// smallest share and is the first to go
+static const mqtt_outbox_class_config_t s_outbox_classes[MQTT_CLASS_MAX] = {
+    [MQTT_CLASS_TELEMETRY] = { .budget_bytes = 8 * 1024,  .weight = 2, .policy = MQTT_OUTBOX_DROP_OLDEST },
+    [MQTT_CLASS_CONTROL]   = { .budget_bytes = 8 * 1024,  .weight = 8, .policy = MQTT_OUTBOX_DROP_NEWEST },
+    [MQTT_CLASS_ALERT]     = { .budget_bytes = 8 * 1024,  .weight = 8, .policy = MQTT_OUTBOX_DROP_OLDEST },
+    [MQTT_CLASS_STATUS]    = { .budget_bytes = 4 * 1024,  .weight = 4, .policy = MQTT_OUTBOX_DROP_OLDEST },
+    [MQTT_CLASS_CSI]       = { .budget_bytes = 32 * 1024, .weight = 1, .policy = MQTT_OUTBOX_DROP_OLDEST },
+};
 
 // Internal state structure
 typedef struct {
@@ -50,6 +91,18 @@ typedef struct {
     bool connected;
     uint32_t retry_count;
     TaskHandle_t reconnect_task;
+    mqtt_backoff_t backoff;         ///< Under mutex: hinted by the event task, advanced by the reconnect task
+    int64_t connected_since_us;
+    bool protocol_v5;
+    SemaphoreHandle_t outbox_mutex;
+    mqtt_outbox_t outbox;
+    TaskHandle_t outbox_task;
+    volatile bool outbox_running;
+    volatile bool topic_alias_reset;                // set on (re)connect, applied by the outbox task
+    uint16_t topic_alias_max;                       // aliases the broker takes on this connection
+    char topic_aliases[MQTT_TOPIC_ALIAS_MAX][128];  // alias N is topic_aliases[N - 1]
+    char csi_topic[128];
+    char csi_frame_topic[128];
 } mqtt_client_state_t;
 
 static mqtt_client_state_t s_mqtt_state = {0};
@@ -57,9 +110,14 @@ static mqtt_client_state_t s_mqtt_state = {0};
 // Forward declarations
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
 static void mqtt_reconnect_task(void *pvParameters);
-static esp_err_t mqtt_publish_internal(const char *topic, const char *data, int data_len, int qos, int retain);
-static char* csi_data_to_json(const csi_data_t *csi_data);
+static esp_err_t mqtt_publish_internal(const char *topic, const char *data, int data_len,
+                                       const mqtt_publish_options_t *options);
+static esp_err_t mqtt_outbox_submit(mqtt_outbox_msg_t *msg, const mqtt_publish_options_t *options);
+static void mqtt_outbox_task(void *pvParameters);
+static void mqtt_outbox_on_drop(const mqtt_outbox_msg_t *msg, bool expired, void *ctx);
 static void update_connection_stats(bool connected);
+static void mqtt_apply_retry_hint(esp_mqtt_event_handle_t event);
+static void mqtt_backoff_hint(uint32_t hint_ms);
 
 /**
  * @brief Initialize MQTT client
@@ -85,19 +143,42 @@ esp_err_t mqtt_client_init(const mqtt_config_t *config)
         return ESP_ERR_NO_MEM;
     }
 
+    s_mqtt_state.outbox_mutex = xSemaphoreCreateMutex();
+    if (!s_mqtt_state.outbox_mutex) {
+        ESP_LOGE(TAG, "Failed to create outbox mutex");
+        vSemaphoreDelete(s_mqtt_state.mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
     s_mqtt_state.event_group = xEventGroupCreate();
     if (!s_mqtt_state.event_group) {
         ESP_LOGE(TAG, "Failed to create event group");
+        vSemaphoreDelete(s_mqtt_state.outbox_mutex);
         vSemaphoreDelete(s_mqtt_state.mutex);
         return ESP_ERR_NO_MEM;
     }
 
     // Copy configuration
     memcpy(&s_mqtt_state.config, config, sizeof(mqtt_config_t));
+    
+    // High-rate topics are built once instead of on every publish
+    snprintf(s_mqtt_state.csi_topic, sizeof(s_mqtt_state.csi_topic),
+             "%s/" CSI_TOPIC_JSON, s_mqtt_state.config.topic_prefix);
+    snprintf(s_mqtt_state.csi_frame_topic, sizeof(s_mqtt_state.csi_frame_topic),
+             "%s/" CSI_TOPIC_FRAME, s_mqtt_state.config.topic_prefix);
 
     // Initialize statistics
     memset(&s_mqtt_state.stats, 0, sizeof(mqtt_stats_t));
     
+    mqtt_outbox_init(&s_mqtt_state.outbox, s_outbox_classes);
+    mqtt_outbox_set_drop_callback(&s_mqtt_state.outbox, mqtt_outbox_on_drop, NULL);
+    
+    // Backoff phase and jitter are seeded per node so a fleet does not reconnect in lockstep
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    mqtt_backoff_init(&s_mqtt_state.backoff, MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_CAP_MS,
+                      mac, esp_random());
+    
     // Configure MQTT client
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker = {
@@ -122,12 +203,27 @@ esp_err_t mqtt_client_init(const mqtt_config_t *config)
         }
     };
 
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    mqtt_cfg.session.protocol_ver = MQTT_PROTOCOL_V_5;
+    s_mqtt_state.protocol_v5 = true;
+#endif
+
     // Configure SSL/TLS if enabled
     if (s_mqtt_state.config.ssl_enabled) {
         if (s_mqtt_state.config.port == 0) {
             mqtt_cfg.broker.address.port = 8883; // Default MQTT SSL port
         }
         mqtt_cfg.broker.address.transport = MQTT_TRANSPORT_OVER_SSL;
+        
+        // Session-resuming TLS transport, owned and destroyed by esp-mqtt
+        mqtt_cfg.network.transport = mqtt_tls_transport_create();
+        if (!mqtt_cfg.network.transport) {
+            ESP_LOGE(TAG, "Failed to create TLS transport");
+            vSemaphoreDelete(s_mqtt_state.outbox_mutex);
+            vSemaphoreDelete(s_mqtt_state.mutex);
+            vEventGroupDelete(s_mqtt_state.event_group);
+            return ESP_ERR_NO_MEM;
+        }
     } else {
         if (s_mqtt_state.config.port == 0) {
             mqtt_cfg.broker.address.port = 1883; // Default MQTT port
@@ -139,6 +235,7 @@ esp_err_t mqtt_client_init(const mqtt_config_t *config)
     s_mqtt_state.client = esp_mqtt_client_init(&mqtt_cfg);
     if (!s_mqtt_state.client) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
+        vSemaphoreDelete(s_mqtt_state.outbox_mutex);
         vSemaphoreDelete(s_mqtt_state.mutex);
         vEventGroupDelete(s_mqtt_state.event_group);
         return ESP_FAIL;
@@ -149,6 +246,7 @@ esp_err_t mqtt_client_init(const mqtt_config_t *config)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register MQTT event handler: %s", esp_err_to_name(err));
         esp_mqtt_client_destroy(s_mqtt_state.client);
+        vSemaphoreDelete(s_mqtt_state.outbox_mutex);
         vSemaphoreDelete(s_mqtt_state.mutex);
         vEventGroupDelete(s_mqtt_state.event_group);
         return err;
@@ -190,6 +288,16 @@ esp_err_t mqtt_client_start(void)
         &s_mqtt_state.reconnect_task
     );
 
+    // Create outbox sender task; all publishes go through it
+    s_mqtt_state.outbox_running = true;
+    xEventGroupClearBits(s_mqtt_state.event_group, MQTT_OUTBOX_STOPPED_BIT);
+    if (xTaskCreate(mqtt_outbox_task, "mqtt_outbox", 4096, NULL, 5,
+                    &s_mqtt_state.outbox_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create outbox task");
+        s_mqtt_state.outbox_running = false;
+        s_mqtt_state.outbox_task = NULL;
+    }
+
     ESP_LOGI(TAG, "MQTT client started successfully");
     return ESP_OK;
 }
@@ -211,6 +319,22 @@ esp_err_t mqtt_client_stop(void)
         s_mqtt_state.reconnect_task = NULL;
     }
 
+    // Let the outbox task finish its current message; queued ones are kept.
+    // It uses the client, the mutexes and the event group until it reports
+    // it stopped, so wait for that however long the publish in progress takes
+    if (s_mqtt_state.outbox_task) {
+        s_mqtt_state.outbox_running = false;
+        xTaskNotifyGive(s_mqtt_state.outbox_task);
+        EventBits_t bits = xEventGroupWaitBits(s_mqtt_state.event_group, MQTT_OUTBOX_STOPPED_BIT,
+                                               pdFALSE, pdFALSE, pdMS_TO_TICKS(OUTBOX_STOP_TIMEOUT_MS));
+        if (!(bits & MQTT_OUTBOX_STOPPED_BIT)) {
+            ESP_LOGW(TAG, "Outbox task still publishing, waiting for it to stop");
+            xEventGroupWaitBits(s_mqtt_state.event_group, MQTT_OUTBOX_STOPPED_BIT,
+                               pdFALSE, pdFALSE, portMAX_DELAY);
+        }
+        s_mqtt_state.outbox_task = NULL;
+    }
+
     esp_err_t err = esp_mqtt_client_stop(s_mqtt_state.client);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to stop MQTT client: %s", esp_err_to_name(err));
@@ -251,6 +375,12 @@ esp_err_t mqtt_client_deinit(void)
         s_mqtt_state.mutex = NULL;
     }
 
+    if (s_mqtt_state.outbox_mutex) {
+        mqtt_outbox_clear(&s_mqtt_state.outbox);
+        vSemaphoreDelete(s_mqtt_state.outbox_mutex);
+        s_mqtt_state.outbox_mutex = NULL;
+    }
+
     if (s_mqtt_state.event_group) {
         vEventGroupDelete(s_mqtt_state.event_group);
         s_mqtt_state.event_group = NULL;
@@ -281,33 +411,117 @@ esp_err_t mqtt_client_publish_csi_data(const csi_data_t *csi_data)
 
     if (!s_mqtt_state.connected) {
         ESP_LOGD(TAG, "MQTT not connected, skipping CSI data publish");
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_NOT_CONNECTED);
         return ESP_ERR_INVALID_STATE;
     }
 
     // Convert CSI data to JSON
-    char *json_data = csi_data_to_json(csi_data);
+    char *json_data = csi_collector_data_to_json(csi_data);
     if (!json_data) {
         ESP_LOGE(TAG, "Failed to serialize CSI data to JSON");
         s_mqtt_state.stats.publish_errors++;
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_ENCODE);
         return ESP_ERR_NO_MEM;
     }
 
-    // Create topic
-    char topic[128];
-    snprintf(topic, sizeof(topic), "%s/csi_data", s_mqtt_state.config.topic_prefix);
+    mqtt_publish_options_t options = {
+        .qos = s_mqtt_state.config.qos,
+        .retain = s_mqtt_state.config.retain,
+        .utf8_payload = true,
+        .expiry_s = CSI_MESSAGE_EXPIRY_S,
+        .topic_alias = true,
+        .msg_class = MQTT_CLASS_CSI,
+    };
 
-    // Publish data
-    esp_err_t err = mqtt_publish_internal(topic, json_data, strlen(json_data), 
-                                         s_mqtt_state.config.qos, s_mqtt_state.config.retain);
-    
+    size_t json_len = strlen(json_data);
+    mqtt_outbox_msg_t *msg = mqtt_outbox_msg_alloc(s_mqtt_state.csi_topic, NULL, json_len);
+    if (!msg) {
+        free(json_data);
+        s_mqtt_state.stats.publish_errors++;
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_ENCODE);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(msg->data, json_data, json_len);
     free(json_data);
-    
+    msg->tracked = true;
+    msg->sequence = csi_data->sequence;
+
+    // CSI is the first to be dropped under congestion; that is not an error worth logging
+    esp_err_t err = mqtt_outbox_submit(msg, &options);
     if (err == ESP_OK) {
-        ESP_LOGD(TAG, "CSI data published successfully");
-    } else {
-        ESP_LOGE(TAG, "Failed to publish CSI data: %s", esp_err_to_name(err));
+        ESP_LOGD(TAG, "CSI data queued");
+    }
+
+    return err;
+}
+
+/**
+ * @brief Publish CSI data as a binary frame
+ */
+esp_err_t mqtt_client_publish_csi_frame(const csi_data_t *csi_data)
+{
+    if (!csi_data || !csi_data->valid) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_mqtt_state.connected) {
+        ESP_LOGD(TAG, "MQTT not connected, skipping CSI frame publish");
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_NOT_CONNECTED);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    mqtt_publish_options_t options = {
+        .qos = s_mqtt_state.config.qos,
+        .retain = s_mqtt_state.config.retain,
+        .utf8_payload = false,
+        .content_type = CSI_FRAME_CONTENT_TYPE,
+        .expiry_s = CSI_MESSAGE_EXPIRY_S,
+        .topic_alias = true,
+        .msg_class = MQTT_CLASS_CSI,
+    };
+
+    // Encoded straight into the outbox message
+    mqtt_outbox_msg_t *msg = mqtt_outbox_msg_alloc(s_mqtt_state.csi_frame_topic, CSI_FRAME_CONTENT_TYPE,
+                                                   csi_collector_frame_size(csi_data));
+    if (!msg) {
+        ESP_LOGE(TAG, "Failed to allocate CSI frame");
         s_mqtt_state.stats.publish_errors++;
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_ENCODE);
+        return ESP_ERR_NO_MEM;
     }
+    csi_collector_encode_frame(csi_data, msg->data);
+    msg->tracked = true;
+    msg->sequence = csi_data->sequence;
+
+    return mqtt_outbox_submit(msg, &options);
+}
+
+/**
+ * @brief Publish a CSI drop report
+ */
+esp_err_t mqtt_client_publish_csi_drops(const csi_drop_range_t *ranges, size_t count)
+{
+    if (!ranges && count > 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char *json_data = csi_collector_drops_to_json(ranges, count);
+    if (!json_data) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/" CSI_TOPIC_DROPS, s_mqtt_state.config.topic_prefix);
+
+    // QoS 1 and no expiry: a lost report leaves its gaps unexplained
+    mqtt_publish_options_t options = {
+        .qos = 1,
+        .retain = false,
+        .utf8_payload = true,
+        .msg_class = MQTT_CLASS_TELEMETRY,
+    };
+    esp_err_t err = mqtt_client_publish_with_options(topic, json_data, strlen(json_data), &options);
+    free(json_data);
 
     return err;
 }
@@ -317,7 +531,21 @@ esp_err_t mqtt_client_publish_csi_data(const csi_data_t *csi_data)
  */
 esp_err_t mqtt_client_publish(const char *topic, const char *data, int data_len, int qos, int retain)
 {
-    if (!topic || !data || data_len < 0) {
+    mqtt_publish_options_t options = {
+        .qos = qos,
+        .retain = retain,
+    };
+
+    return mqtt_client_publish_with_options(topic, data, data_len, &options);
+}
+
+/**
+ * @brief Publish message with MQTT v5 properties
+ */
+esp_err_t mqtt_client_publish_with_options(const char *topic, const char *data, int data_len,
+                                           const mqtt_publish_options_t *options)
+{
+    if (!topic || !data || data_len < 0 || !options) {
         return ESP_ERR_INVALID_ARG;
     }
 
@@ -326,7 +554,23 @@ esp_err_t mqtt_client_publish(const char *topic, const char *data, int data_len,
         return ESP_ERR_INVALID_STATE;
     }
 
-    return mqtt_publish_internal(topic, data, data_len, qos, retain);
+    if (options->msg_class >= MQTT_CLASS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mqtt_outbox_msg_t *msg = mqtt_outbox_msg_alloc(topic, options->content_type, data_len);
+    if (!msg) {
+        ESP_LOGE(TAG, "No memory to queue message for %s", topic);
+        s_mqtt_state.stats.publish_errors++;
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(msg->data, data, data_len);
+
+    esp_err_t err = mqtt_outbox_submit(msg, options);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Outbox full for class %d, message to %s dropped", options->msg_class, topic);
+    }
+    return err;
 }
 
 /**
@@ -412,6 +656,26 @@ esp_err_t mqtt_client_get_stats(mqtt_stats_t *stats)
     memcpy(stats, &s_mqtt_state.stats, sizeof(mqtt_stats_t));
     xSemaphoreGive(s_mqtt_state.mutex);
 
+    if (s_mqtt_state.config.ssl_enabled) {
+        mqtt_tls_metrics_t tls;
+        mqtt_tls_transport_get_metrics(&tls);
+        stats->tls_handshakes = tls.handshakes;
+        stats->tls_resumed = tls.resumed;
+        stats->tls_handshake_ms = tls.last_ms;
+        stats->tls_handshake_max_ms = tls.max_ms;
+        stats->tls_heap_peak = tls.max_heap_peak;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Forget the cached TLS session
+ */
+esp_err_t mqtt_client_clear_tls_session(void)
+{
+    mqtt_tls_transport_forget_session();
+    ESP_LOGI(TAG, "TLS session cache cleared");
     return ESP_OK;
 }
 
@@ -441,10 +705,13 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT connected");
+            // Aliases are per connection; the new one starts without any
+            s_mqtt_state.topic_alias_reset = true;
             s_mqtt_state.connected = true;
             s_mqtt_state.retry_count = 0;
+            s_mqtt_state.connected_since_us = esp_timer_get_time();
             xEventGroupClearBits(s_mqtt_state.event_group, MQTT_DISCONNECTED_BIT);
-            xEventGroupSetBits(s_mqtt_state.event_group, MQTT_CONNECTED_BIT);
+            xEventGroupSetBits(s_mqtt_state.event_group, MQTT_CONNECTED_BIT | MQTT_ATTEMPT_DONE_BIT);
             update_connection_stats(true);
             
             // Subscribe to configuration topic
@@ -455,14 +722,36 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             // Publish device status
             char status_topic[128];
             snprintf(status_topic, sizeof(status_topic), "%s/status", s_mqtt_state.config.topic_prefix);
-            mqtt_publish_internal(status_topic, "online", 6, 1, true);
+            mqtt_publish_options_t status_options = {
+                .qos = 1,
+                .retain = true,
+                .utf8_payload = true,
+                .msg_class = MQTT_CLASS_STATUS,
+            };
+            mqtt_client_publish_with_options(status_topic, "online", 6, &status_options);
+            
+            // Drain whatever queued up while disconnected
+            if (s_mqtt_state.outbox_task) {
+                xTaskNotifyGive(s_mqtt_state.outbox_task);
+            }
             break;
 
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "MQTT disconnected");
+            
+            // Only a connection that held for a while earns a fresh backoff sequence
+            if (s_mqtt_state.connected_since_us > 0 &&
+                esp_timer_get_time() - s_mqtt_state.connected_since_us >= MQTT_BACKOFF_STABLE_MS * 1000LL) {
+                xSemaphoreTake(s_mqtt_state.mutex, portMAX_DELAY);
+                mqtt_backoff_reset(&s_mqtt_state.backoff);
+                xSemaphoreGive(s_mqtt_state.mutex);
+            }
+            s_mqtt_state.connected_since_us = 0;
+            mqtt_apply_retry_hint(event);
+            
             s_mqtt_state.connected = false;
             xEventGroupClearBits(s_mqtt_state.event_group, MQTT_CONNECTED_BIT);
-            xEventGroupSetBits(s_mqtt_state.event_group, MQTT_DISCONNECTED_BIT);
+            xEventGroupSetBits(s_mqtt_state.event_group, MQTT_DISCONNECTED_BIT | MQTT_ATTEMPT_DONE_BIT);
             update_connection_stats(false);
             s_mqtt_state.stats.connection_errors++;
             break;
@@ -478,6 +767,11 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGD(TAG, "MQTT published (msg_id: %d)", event->msg_id);
             s_mqtt_state.stats.messages_sent++;
+            
+            // esp-mqtt's outbox shrank; bulk classes may be able to go again
+            if (s_mqtt_state.outbox_task) {
+                xTaskNotifyGive(s_mqtt_state.outbox_task);
+            }
             break;
 
         case MQTT_EVENT_DATA:
@@ -513,6 +807,8 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             } else if (event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
                 ESP_LOGE(TAG, "Connection refused error: 0x%x", 
                         event->error_handle->connect_return_code);
+                mqtt_backoff_hint(mqtt_backoff_hint_for_reason(event->error_handle->connect_return_code,
+                                                               s_mqtt_state.protocol_v5));
             }
             break;
 
@@ -522,8 +818,64 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     }
 }
 
+/**
+ * @brief Record a retry hint for the reconnect task's next delay
+ */
+static void mqtt_backoff_hint(uint32_t hint_ms)
+{
+    xSemaphoreTake(s_mqtt_state.mutex, portMAX_DELAY);
+    mqtt_backoff_set_hint(&s_mqtt_state.backoff, hint_ms);
+    xSemaphoreGive(s_mqtt_state.mutex);
+}
+
+/**
+ * @brief Pick up a retry hint sent by the broker with a disconnect
+ */
+static void mqtt_apply_retry_hint(esp_mqtt_event_handle_t event)
+{
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    if (!s_mqtt_state.protocol_v5 || !event) {
+        return;
+    }
+    
+    if (event->error_handle) {
+        mqtt_backoff_hint(mqtt_backoff_hint_for_reason(event->error_handle->disconnect_return_code, true));
+    }
+    
+    if (event->property && event->property->user_property) {
+        uint8_t count = esp_mqtt5_client_get_user_property_count(event->property->user_property);
+        if (count > 0) {
+            esp_mqtt5_user_property_item_t *items = calloc(count, sizeof(esp_mqtt5_user_property_item_t));
+            if (items && esp_mqtt5_client_get_user_property(event->property->user_property,
+                                                            items, &count) == ESP_OK) {
+                for (int i = 0; i < count; i++) {
+                    if (strcmp(items[i].key, MQTT_RETRY_AFTER_PROPERTY) == 0) {
+                        unsigned long seconds = strtoul(items[i].value, NULL, 10);
+                        ESP_LOGI(TAG, "Broker asked to retry after %lu s", seconds);
+                        // Limited before scaling so a huge value cannot wrap to a short delay
+                        if (seconds > MQTT_BACKOFF_HINT_MAX_MS / 1000) {
+                            seconds = MQTT_BACKOFF_HINT_MAX_MS / 1000;
+                        }
+                        mqtt_backoff_hint((uint32_t)seconds * 1000);
+                    }
+                    free((char *)items[i].key);
+                    free((char *)items[i].value);
+                }
+            }
+            free(items);
+        }
+    }
+#else
+    (void)event;
+#endif
+}
+
 /**
  * @brief MQTT reconnection task
+ * 
+ * Waits out a decorrelated-jitter backoff between attempts, starting with
+ * a per-node phase offset, so a fleet that lost the broker together does
+ * not come back in one burst.
  */
 static void mqtt_reconnect_task(void *pvParameters)
 {
@@ -539,102 +891,268 @@ static void mqtt_reconnect_task(void *pvParameters)
             break;
         }
 
-        if (s_mqtt_state.retry_count >= MAX_RETRY_ATTEMPTS) {
-            ESP_LOGE(TAG, "Max retry attempts reached, stopping reconnection attempts");
-            vTaskDelay(pdMS_TO_TICKS(60000)); // Wait 1 minute before resetting counter
-            s_mqtt_state.retry_count = 0;
+        xSemaphoreTake(s_mqtt_state.mutex, portMAX_DELAY);
+        uint32_t delay_ms = mqtt_backoff_next(&s_mqtt_state.backoff);
+        xSemaphoreGive(s_mqtt_state.mutex);
+        s_mqtt_state.stats.last_reconnect_delay_ms = delay_ms;
+        ESP_LOGI(TAG, "Attempting MQTT reconnection in %lu ms (attempt %lu)", 
+                (unsigned long)delay_ms, (unsigned long)s_mqtt_state.retry_count + 1);
+        
+        // Returns early if the connection came back in the meantime
+        EventBits_t bits = xEventGroupWaitBits(s_mqtt_state.event_group, MQTT_CONNECTED_BIT,
+                                               pdFALSE, pdFALSE, pdMS_TO_TICKS(delay_ms));
+        if ((bits & MQTT_CONNECTED_BIT) || s_mqtt_state.connected) {
             continue;
         }
 
-        // Wait before retry
-        ESP_LOGI(TAG, "Attempting MQTT reconnection (attempt %d/%d)", 
-                s_mqtt_state.retry_count + 1, MAX_RETRY_ATTEMPTS);
+        xEventGroupClearBits(s_mqtt_state.event_group, MQTT_ATTEMPT_DONE_BIT);
+        esp_err_t err = esp_mqtt_client_reconnect(s_mqtt_state.client);
+        s_mqtt_state.retry_count++;
+        s_mqtt_state.stats.reconnect_attempts++;
         
-        vTaskDelay(pdMS_TO_TICKS(RETRY_DELAY_MS));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "MQTT reconnection failed: %s", esp_err_to_name(err));
+            s_mqtt_state.stats.connection_errors++;
+            continue;
+        }
+        
+        // Let the attempt finish so a refusal hint applies to the next delay
+        xEventGroupWaitBits(s_mqtt_state.event_group, MQTT_ATTEMPT_DONE_BIT,
+                           pdFALSE, pdFALSE, pdMS_TO_TICKS(RECONNECT_ATTEMPT_TIMEOUT_MS));
+    }
 
-        if (!s_mqtt_state.connected) {
-            esp_err_t err = esp_mqtt_client_reconnect(s_mqtt_state.client);
-            s_mqtt_state.retry_count++;
-            
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "MQTT reconnection failed: %s", esp_err_to_name(err));
-                s_mqtt_state.stats.connection_errors++;
+    ESP_LOGI(TAG, "MQTT reconnection task stopped");
+    vTaskDelete(NULL);
+}
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+/**
+ * @brief Look up or assign the topic alias of a topic
+ * 
+ * Aliases are handed out first come, first served to the topics that ask
+ * for one; esp-mqtt sends the full topic with the alias once per
+ * connection and the bare alias afterwards. The table starts empty on
+ * every connection, as the broker forgets aliases when it drops one.
+ * 
+ * @return Alias (1..topic_alias_max) or 0 if none is available
+ */
+static uint16_t mqtt_topic_alias_for(const char *topic)
+{
+    if (s_mqtt_state.topic_alias_reset) {
+        s_mqtt_state.topic_alias_reset = false;
+        memset(s_mqtt_state.topic_aliases, 0, sizeof(s_mqtt_state.topic_aliases));
+        s_mqtt_state.topic_alias_max = MQTT_TOPIC_ALIAS_MAX;
+    }
+
+    for (int i = 0; i < s_mqtt_state.topic_alias_max; i++) {
+        if (s_mqtt_state.topic_aliases[i][0] == '\0') {
+            if (strlen(topic) >= sizeof(s_mqtt_state.topic_aliases[i])) {
+                return 0;
             }
+            strcpy(s_mqtt_state.topic_aliases[i], topic);
+            return i + 1;
+        }
+        if (strcmp(s_mqtt_state.topic_aliases[i], topic) == 0) {
+            return i + 1;
         }
     }
+    return 0;
+}
+#endif
 
-    ESP_LOGI(TAG, "MQTT reconnection task stopped");
+/**
+ * @brief Queue a message in the priority outbox
+ * 
+ * Takes ownership of msg.
+ */
+static esp_err_t mqtt_outbox_submit(mqtt_outbox_msg_t *msg, const mqtt_publish_options_t *options)
+{
+    msg->msg_class = options->msg_class;
+    msg->qos = options->qos;
+    msg->retain = options->retain;
+    msg->utf8_payload = options->utf8_payload;
+    msg->topic_alias = options->topic_alias;
+    msg->expiry_s = options->expiry_s;
+    msg->expiry_ms = options->expiry_s * 1000;
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool low_heap = esp_get_free_heap_size() < OUTBOX_LOW_HEAP;
+
+    xSemaphoreTake(s_mqtt_state.outbox_mutex, portMAX_DELAY);
+    bool queued;
+    if (low_heap && msg->msg_class == MQTT_CLASS_CSI) {
+        s_mqtt_state.outbox.queues[MQTT_CLASS_CSI].stats.dropped++;
+        mqtt_outbox_on_drop(msg, false, NULL);
+        mqtt_outbox_msg_free(msg);
+        queued = false;
+    } else {
+        if (low_heap) {
+            // Make room for the important message at the expense of CSI
+            mqtt_outbox_shed(&s_mqtt_state.outbox, MQTT_CLASS_CSI);
+        }
+        queued = mqtt_outbox_push(&s_mqtt_state.outbox, msg, now_ms);
+    }
+    xSemaphoreGive(s_mqtt_state.outbox_mutex);
+
+    if (!queued) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (s_mqtt_state.outbox_task) {
+        xTaskNotifyGive(s_mqtt_state.outbox_task);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Outbox sender task
+ * 
+ * Drains the priority outbox into esp-mqtt by weighted round robin. Bulk
+ * classes are held back while esp-mqtt's own outbox (unacknowledged QoS>0
+ * messages) is above OUTBOX_INFLIGHT_LIMIT, so control traffic never
+ * queues behind thousands of CSI frames.
+ */
+static void mqtt_outbox_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "MQTT outbox task started");
+
+    while (s_mqtt_state.outbox_running) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OUTBOX_IDLE_MS));
+
+        while (s_mqtt_state.outbox_running && s_mqtt_state.connected) {
+            uint32_t blocked = 0;
+            if (esp_mqtt_client_get_outbox_size(s_mqtt_state.client) > OUTBOX_INFLIGHT_LIMIT) {
+                blocked = OUTBOX_BULK_CLASSES;
+            }
+
+            uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+            xSemaphoreTake(s_mqtt_state.outbox_mutex, portMAX_DELAY);
+            mqtt_outbox_msg_t *msg = mqtt_outbox_pop(&s_mqtt_state.outbox, now_ms, blocked);
+            xSemaphoreGive(s_mqtt_state.outbox_mutex);
+            if (!msg) {
+                break;
+            }
+
+            mqtt_publish_options_t options = {
+                .qos = msg->qos,
+                .retain = msg->retain,
+                .utf8_payload = msg->utf8_payload,
+                .content_type = msg->content_type,
+                .expiry_s = msg->expiry_s,
+                .topic_alias = msg->topic_alias,
+                .msg_class = msg->msg_class,
+            };
+            esp_err_t err = mqtt_publish_internal(msg->topic, (const char *)msg->data,
+                                                  msg->data_len, &options);
+
+            // Keep accepted non-CSI messages across a dropped connection
+            if (err != ESP_OK && !s_mqtt_state.connected && msg->msg_class != MQTT_CLASS_CSI) {
+                xSemaphoreTake(s_mqtt_state.outbox_mutex, portMAX_DELAY);
+                mqtt_outbox_requeue(&s_mqtt_state.outbox, msg);
+                xSemaphoreGive(s_mqtt_state.outbox_mutex);
+                break;
+            }
+            if (err != ESP_OK && msg->tracked) {
+                csi_collector_record_drop(msg->sequence, CSI_DROP_PUBLISH);
+            }
+            mqtt_outbox_msg_free(msg);
+        }
+    }
+
+    ESP_LOGI(TAG, "MQTT outbox task stopped");
+    xEventGroupSetBits(s_mqtt_state.event_group, MQTT_OUTBOX_STOPPED_BIT);
     vTaskDelete(NULL);
 }
 
 /**
- * @brief Internal publish function with error handling
+ * @brief Log outbox drops of CSI frames against their sequence numbers
  */
-static esp_err_t mqtt_publish_internal(const char *topic, const char *data, int data_len, int qos, int retain)
+static void mqtt_outbox_on_drop(const mqtt_outbox_msg_t *msg, bool expired, void *ctx)
 {
-    if (!s_mqtt_state.connected) {
-        return ESP_ERR_INVALID_STATE;
+    if (msg->tracked) {
+        csi_collector_record_drop(msg->sequence, expired ? CSI_DROP_OUTBOX_EXPIRED : CSI_DROP_OUTBOX_FULL);
     }
+}
 
-    int msg_id = esp_mqtt_client_publish(s_mqtt_state.client, topic, data, data_len, qos, retain);
-    if (msg_id == -1) {
-        ESP_LOGE(TAG, "Failed to publish to topic: %s", topic);
-        s_mqtt_state.stats.publish_errors++;
-        return ESP_FAIL;
+/**
+ * @brief Get outbox counters of a message class
+ */
+esp_err_t mqtt_client_get_outbox_stats(mqtt_msg_class_t msg_class, mqtt_outbox_stats_t *stats)
+{
+    if (!stats || msg_class >= MQTT_CLASS_MAX) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_LOGD(TAG, "Published to topic: %s (msg_id: %d, len: %d)", topic, msg_id, data_len);
+    if (!s_mqtt_state.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mqtt_state.outbox_mutex, portMAX_DELAY);
+    const mqtt_outbox_class_stats_t *counters = &s_mqtt_state.outbox.queues[msg_class].stats;
+    stats->queued_msgs = counters->queued_msgs;
+    stats->queued_bytes = counters->queued_bytes;
+    stats->sent = counters->sent;
+    stats->dropped = counters->dropped;
+    stats->expired = counters->expired;
+    stats->max_wait_ms = counters->max_wait_ms;
+    xSemaphoreGive(s_mqtt_state.outbox_mutex);
+
     return ESP_OK;
 }
 
 /**
- * @brief Convert CSI data to JSON string
+ * @brief Internal publish function with error handling
  */
-static char* csi_data_to_json(const csi_data_t *csi_data)
+static esp_err_t mqtt_publish_internal(const char *topic, const char *data, int data_len,
+                                       const mqtt_publish_options_t *options)
 {
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        return NULL;
+    if (!s_mqtt_state.connected) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    // Add timestamp
-    cJSON_AddNumberToObject(json, "timestamp", csi_data->timestamp);
-    
-    // Add MAC address
-    char mac_str[18];
-    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-             csi_data->mac[0], csi_data->mac[1], csi_data->mac[2],
-             csi_data->mac[3], csi_data->mac[4], csi_data->mac[5]);
-    cJSON_AddStringToObject(json, "mac", mac_str);
-    
-    // Add basic information
-    cJSON_AddNumberToObject(json, "rssi", csi_data->rssi);
-    cJSON_AddNumberToObject(json, "channel", csi_data->channel);
-    cJSON_AddNumberToObject(json, "secondary_channel", csi_data->secondary_channel);
-    cJSON_AddNumberToObject(json, "subcarrier_count", csi_data->subcarrier_count);
-    
-    // Add amplitude data if available
-    if (csi_data->amplitude && csi_data->subcarrier_count > 0) {
-        cJSON *amplitude_array = cJSON_CreateArray();
-        for (int i = 0; i < csi_data->subcarrier_count; i++) {
-            cJSON_AddItemToArray(amplitude_array, cJSON_CreateNumber(csi_data->amplitude[i]));
-        }
-        cJSON_AddItemToObject(json, "amplitude", amplitude_array);
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    // Properties are client state in esp-mqtt; only the outbox task publishes,
+    // so they stay paired with their message
+    esp_mqtt5_publish_property_config_t property = {0};
+    if (s_mqtt_state.protocol_v5) {
+        property.payload_format_indicator = options->utf8_payload;
+        property.message_expiry_interval = options->expiry_s;
+        property.content_type = options->content_type;
+        property.topic_alias = options->topic_alias ? mqtt_topic_alias_for(topic) : 0;
+        esp_mqtt5_client_set_publish_property(s_mqtt_state.client, &property);
     }
-    
-    // Add phase data if available
-    if (csi_data->phase && csi_data->subcarrier_count > 0) {
-        cJSON *phase_array = cJSON_CreateArray();
-        for (int i = 0; i < csi_data->subcarrier_count; i++) {
-            cJSON_AddItemToArray(phase_array, cJSON_CreateNumber(csi_data->phase[i]));
+#endif
+
+    int msg_id = esp_mqtt_client_publish(s_mqtt_state.client, topic, data, data_len,
+                                         options->qos, options->retain);
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    if (msg_id == -1 && property.topic_alias) {
+        // esp-mqtt refuses aliases above the Topic Alias Maximum of the
+        // broker's CONNACK, which it does not report otherwise. Only if the
+        // message goes out without its alias was the alias the problem;
+        // a disconnect or a full outbox fails both.
+        uint16_t alias = property.topic_alias;
+        property.topic_alias = 0;
+        esp_mqtt5_client_set_publish_property(s_mqtt_state.client, &property);
+        msg_id = esp_mqtt_client_publish(s_mqtt_state.client, topic, data, data_len,
+                                         options->qos, options->retain);
+        if (msg_id != -1) {
+            ESP_LOGW(TAG, "Topic alias %u rejected, broker takes at most %u on this connection",
+                     alias, alias - 1);
+            s_mqtt_state.topic_alias_max = alias - 1;
         }
-        cJSON_AddItemToObject(json, "phase", phase_array);
     }
+#endif
 
-    char *json_string = cJSON_Print(json);
-    cJSON_Delete(json);
-    
-    return json_string;
+    if (msg_id == -1) {
+        ESP_LOGE(TAG, "Failed to publish to topic: %s", topic);
+        s_mqtt_state.stats.publish_errors++;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGD(TAG, "Published to topic: %s (msg_id: %d, len: %d)", topic, msg_id, data_len);
+    return ESP_OK;
 }
 
 /**
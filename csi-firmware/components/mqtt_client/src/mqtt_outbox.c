@@ -0,0 +1,233 @@
+/**
+ * @file mqtt_outbox.c
+ * @brief Priority outbox for outgoing MQTT messages
+ */
+
+#include "mqtt_outbox.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void mqtt_outbox_unlink_head(mqtt_outbox_queue_t *queue)
+{
+    mqtt_outbox_msg_t *msg = queue->head;
+    queue->head = msg->next;
+    if (!queue->head) {
+        queue->tail = NULL;
+    }
+    msg->next = NULL;
+    queue->stats.queued_msgs--;
+    queue->stats.queued_bytes -= msg->size;
+}
+
+static void mqtt_outbox_discard(mqtt_outbox_t *outbox, mqtt_outbox_queue_t *queue,
+                                mqtt_outbox_msg_t *msg, bool expired)
+{
+    if (expired) {
+        queue->stats.expired++;
+    } else {
+        queue->stats.dropped++;
+    }
+    if (outbox->on_drop) {
+        outbox->on_drop(msg, expired, outbox->drop_ctx);
+    }
+    mqtt_outbox_msg_free(msg);
+}
+
+static bool mqtt_outbox_expired(const mqtt_outbox_msg_t *msg, uint32_t now_ms)
+{
+    return msg->expiry_ms > 0 && (uint32_t)(now_ms - msg->enqueued_ms) > msg->expiry_ms;
+}
+
+void mqtt_outbox_init(mqtt_outbox_t *outbox, const mqtt_outbox_class_config_t config[MQTT_OUTBOX_CLASSES])
+{
+    memset(outbox, 0, sizeof(mqtt_outbox_t));
+    for (int i = 0; i < MQTT_OUTBOX_CLASSES; i++) {
+        outbox->queues[i].config = config[i];
+        if (outbox->queues[i].config.weight == 0) {
+            outbox->queues[i].config.weight = 1;
+        }
+    }
+}
+
+void mqtt_outbox_set_drop_callback(mqtt_outbox_t *outbox, mqtt_outbox_drop_cb_t on_drop, void *ctx)
+{
+    outbox->on_drop = on_drop;
+    outbox->drop_ctx = ctx;
+}
+
+void mqtt_outbox_clear(mqtt_outbox_t *outbox)
+{
+    for (int i = 0; i < MQTT_OUTBOX_CLASSES; i++) {
+        mqtt_outbox_shed(outbox, i);
+    }
+}
+
+mqtt_outbox_msg_t *mqtt_outbox_msg_alloc(const char *topic, const char *content_type, uint32_t data_len)
+{
+    size_t topic_len = strlen(topic) + 1;
+    size_t type_len = content_type ? strlen(content_type) + 1 : 0;
+    size_t size = sizeof(mqtt_outbox_msg_t) + topic_len + type_len + data_len;
+
+    mqtt_outbox_msg_t *msg = malloc(size);
+    if (!msg) {
+        return NULL;
+    }
+    memset(msg, 0, sizeof(mqtt_outbox_msg_t));
+
+    char *p = (char *)(msg + 1);
+    msg->topic = p;
+    memcpy(p, topic, topic_len);
+    p += topic_len;
+    if (content_type) {
+        msg->content_type = p;
+        memcpy(p, content_type, type_len);
+        p += type_len;
+    }
+    msg->data = (uint8_t *)p;
+    msg->data_len = data_len;
+    msg->size = size;
+    return msg;
+}
+
+void mqtt_outbox_msg_free(mqtt_outbox_msg_t *msg)
+{
+    free(msg);
+}
+
+bool mqtt_outbox_push(mqtt_outbox_t *outbox, mqtt_outbox_msg_t *msg, uint32_t now_ms)
+{
+    if (msg->msg_class >= MQTT_OUTBOX_CLASSES) {
+        mqtt_outbox_msg_free(msg);
+        return false;
+    }
+
+    mqtt_outbox_queue_t *queue = &outbox->queues[msg->msg_class];
+    uint32_t budget = queue->config.budget_bytes;
+
+    if (msg->size > budget) {
+        mqtt_outbox_discard(outbox, queue, msg, false);
+        return false;
+    }
+
+    // Stale messages go first, whatever the policy
+    while (queue->head && mqtt_outbox_expired(queue->head, now_ms)) {
+        mqtt_outbox_msg_t *stale = queue->head;
+        mqtt_outbox_unlink_head(queue);
+        mqtt_outbox_discard(outbox, queue, stale, true);
+    }
+
+    if (queue->stats.queued_bytes + msg->size > budget) {
+        if (queue->config.policy == MQTT_OUTBOX_DROP_NEWEST) {
+            mqtt_outbox_discard(outbox, queue, msg, false);
+            return false;
+        }
+        while (queue->stats.queued_bytes + msg->size > budget) {
+            mqtt_outbox_msg_t *old = queue->head;
+            mqtt_outbox_unlink_head(queue);
+            mqtt_outbox_discard(outbox, queue, old, false);
+        }
+    }
+
+    msg->next = NULL;
+    msg->enqueued_ms = now_ms;
+    if (queue->tail) {
+        queue->tail->next = msg;
+    } else {
+        queue->head = msg;
+    }
+    queue->tail = msg;
+    queue->stats.queued_msgs++;
+    queue->stats.queued_bytes += msg->size;
+    return true;
+}
+
+void mqtt_outbox_requeue(mqtt_outbox_t *outbox, mqtt_outbox_msg_t *msg)
+{
+    mqtt_outbox_queue_t *queue = &outbox->queues[msg->msg_class];
+
+    msg->next = queue->head;
+    queue->head = msg;
+    if (!queue->tail) {
+        queue->tail = msg;
+    }
+    queue->stats.queued_msgs++;
+    queue->stats.queued_bytes += msg->size;
+    queue->stats.sent--;
+}
+
+mqtt_outbox_msg_t *mqtt_outbox_pop(mqtt_outbox_t *outbox, uint32_t now_ms, uint32_t blocked_mask)
+{
+    // Deficit round robin: a class gets weight * quantum bytes of credit each
+    // time the scan reaches it and sends while its head message fits
+    for (;;) {
+        bool eligible = false;
+        for (int i = 0; i < MQTT_OUTBOX_CLASSES; i++) {
+            mqtt_outbox_queue_t *queue = &outbox->queues[i];
+            while (queue->head && mqtt_outbox_expired(queue->head, now_ms)) {
+                mqtt_outbox_msg_t *stale = queue->head;
+                mqtt_outbox_unlink_head(queue);
+                mqtt_outbox_discard(outbox, queue, stale, true);
+            }
+            if (!queue->head) {
+                queue->deficit = 0;
+            } else if (!(blocked_mask & (1u << i))) {
+                eligible = true;
+            }
+        }
+        if (!eligible) {
+            return NULL;
+        }
+
+        mqtt_outbox_queue_t *queue = &outbox->queues[outbox->current];
+        if (queue->head && !(blocked_mask & (1u << outbox->current))) {
+            if (queue->head->size <= queue->deficit) {
+                mqtt_outbox_msg_t *msg = queue->head;
+                mqtt_outbox_unlink_head(queue);
+                queue->deficit -= msg->size;
+                if (!queue->head) {
+                    queue->deficit = 0;
+                }
+
+                uint32_t wait_ms = now_ms - msg->enqueued_ms;
+                if (wait_ms > queue->stats.max_wait_ms) {
+                    queue->stats.max_wait_ms = wait_ms;
+                }
+                queue->stats.sent++;
+                return msg;
+            }
+        }
+
+        // Move on and grant the next class its credit for this round
+        outbox->current = (outbox->current + 1) % MQTT_OUTBOX_CLASSES;
+        mqtt_outbox_queue_t *next = &outbox->queues[outbox->current];
+        if (next->head && !(blocked_mask & (1u << outbox->current))) {
+            next->deficit += (uint32_t)next->config.weight * MQTT_OUTBOX_QUANTUM;
+        }
+    }
+}
+
+uint32_t mqtt_outbox_shed(mqtt_outbox_t *outbox, uint8_t msg_class)
+{
+    if (msg_class >= MQTT_OUTBOX_CLASSES) {
+        return 0;
+    }
+
+    mqtt_outbox_queue_t *queue = &outbox->queues[msg_class];
+    uint32_t released = queue->stats.queued_bytes;
+    while (queue->head) {
+        mqtt_outbox_msg_t *msg = queue->head;
+        mqtt_outbox_unlink_head(queue);
+        mqtt_outbox_discard(outbox, queue, msg, false);
+    }
+    queue->deficit = 0;
+    return released;
+}
+
+uint32_t mqtt_outbox_queued_bytes(const mqtt_outbox_t *outbox)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < MQTT_OUTBOX_CLASSES; i++) {
+        total += outbox->queues[i].stats.queued_bytes;
+    }
+    return total;
+}
@@ -0,0 +1,205 @@
+/**
+ * @file mqtt_outbox.h
+ * @brief Priority outbox for outgoing MQTT messages
+ *
+ * Messages wait here, one queue per message class, until the sender task
+ * hands them to esp-mqtt. Each class has its own byte budget and overflow
+ * policy, so a flood of CSI can never push an alert or a config ack out,
+ * and the queues are drained by deficit round robin with per-class
+ * weights so bulk traffic keeps flowing without starving control traffic.
+ *
+ * The outbox itself does no locking and has no ESP-IDF dependencies, so
+ * host tools can share it; the caller serializes access.
+ */
+
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_OUTBOX_CLASSES     5       ///< Matches MQTT_CLASS_MAX
+#define MQTT_OUTBOX_QUANTUM     512     ///< Bytes of credit per unit of weight and round
+
+/**
+ * @brief What to do when a message does not fit the class budget
+ */
+typedef enum {
+    MQTT_OUTBOX_DROP_OLDEST,    ///< Evict queued messages, oldest first
+    MQTT_OUTBOX_DROP_NEWEST,    ///< Reject the new message
+} mqtt_outbox_policy_t;
+
+/**
+ * @brief Per-class limits and scheduling weight
+ */
+typedef struct {
+    uint32_t budget_bytes;      ///< Bytes the class may hold (message sizes incl. overhead)
+    uint16_t weight;            ///< Relative share of the drain bandwidth
+    mqtt_outbox_policy_t policy; ///< Overflow policy
+} mqtt_outbox_class_config_t;
+
+/**
+ * @brief Per-class counters
+ */
+typedef struct {
+    uint32_t queued_msgs;       ///< Messages waiting
+    uint32_t queued_bytes;      ///< Bytes waiting
+    uint32_t sent;              ///< Messages handed to the sender
+    uint32_t dropped;           ///< Messages dropped by the overflow policy
+    uint32_t expired;           ///< Messages dropped because they went stale
+    uint32_t max_wait_ms;       ///< Longest time a sent message spent queued
+} mqtt_outbox_class_stats_t;
+
+/**
+ * @brief Queued message
+ *
+ * Topic, content type and payload live in one allocation behind the
+ * header.
+ */
+typedef struct mqtt_outbox_msg {
+    struct mqtt_outbox_msg *next;
+    uint32_t size;              ///< Allocation size, charged against the budget
+    uint32_t enqueued_ms;       ///< Time the message was queued
+    uint32_t expiry_ms;         ///< Lifetime in the outbox, 0 for unlimited
+    uint8_t msg_class;          ///< Class index
+    int8_t qos;                 ///< Quality of Service level
+    bool retain;                ///< Retain message flag
+    bool utf8_payload;          ///< MQTT v5 payload format indicator
+    bool topic_alias;           ///< Use a topic alias
+    uint32_t expiry_s;          ///< MQTT v5 message expiry interval
+    bool tracked;               ///< Carries a CSI frame numbered by sequence
+    uint32_t sequence;          ///< CSI frame sequence number, if tracked
+    char *topic;                ///< Topic, NUL terminated
+    char *content_type;         ///< Content type or NULL
+    uint8_t *data;              ///< Payload
+    uint32_t data_len;          ///< Payload length
+} mqtt_outbox_msg_t;
+
+/**
+ * @brief Called for every message the outbox drops
+ * @param msg Message about to be freed
+ * @param expired true if it went stale, false if the overflow policy dropped it
+ * @param ctx Context given to mqtt_outbox_set_drop_callback()
+ */
+typedef void (*mqtt_outbox_drop_cb_t)(const mqtt_outbox_msg_t *msg, bool expired, void *ctx);
+
+/**
+ * @brief Queue of one class
+ */
+typedef struct {
+    mqtt_outbox_msg_t *head;
+    mqtt_outbox_msg_t *tail;
+    uint32_t deficit;           ///< Unspent round robin credit
+    mqtt_outbox_class_config_t config;
+    mqtt_outbox_class_stats_t stats;
+} mqtt_outbox_queue_t;
+
+/**
+ * @brief Outbox state
+ */
+typedef struct {
+    mqtt_outbox_queue_t queues[MQTT_OUTBOX_CLASSES];
+    uint8_t current;            ///< Class the round robin is visiting
+    mqtt_outbox_drop_cb_t on_drop; ///< Drop notification or NULL
+    void *drop_ctx;             ///< Context for on_drop
+} mqtt_outbox_t;
+
+/**
+ * @brief Initialize an empty outbox
+ * @param outbox Outbox state
+ * @param config Limits for each class
+ */
+void mqtt_outbox_init(mqtt_outbox_t *outbox, const mqtt_outbox_class_config_t config[MQTT_OUTBOX_CLASSES]);
+
+/**
+ * @brief Get told about every dropped message
+ * @param outbox Outbox state
+ * @param on_drop Callback, run with the caller's serialization held, or NULL
+ * @param ctx Context passed to the callback
+ */
+void mqtt_outbox_set_drop_callback(mqtt_outbox_t *outbox, mqtt_outbox_drop_cb_t on_drop, void *ctx);
+
+/**
+ * @brief Free all queued messages
+ * @param outbox Outbox state
+ */
+void mqtt_outbox_clear(mqtt_outbox_t *outbox);
+
+/**
+ * @brief Allocate a message
+ *
+ * The payload is left uninitialized so it can be encoded in place.
+ *
+ * @param topic Topic
+ * @param content_type Content type or NULL
+ * @param data_len Payload length
+ * @return Message or NULL if out of memory
+ */
+mqtt_outbox_msg_t *mqtt_outbox_msg_alloc(const char *topic, const char *content_type, uint32_t data_len);
+
+/**
+ * @brief Free a message that is not queued
+ * @param msg Message
+ */
+void mqtt_outbox_msg_free(mqtt_outbox_msg_t *msg);
+
+/**
+ * @brief Queue a message, applying the class overflow policy
+ *
+ * The outbox takes ownership in every case; a rejected message is freed.
+ *
+ * @param outbox Outbox state
+ * @param msg Message with msg_class set
+ * @param now_ms Current time
+ * @return true if queued, false if rejected
+ */
+bool mqtt_outbox_push(mqtt_outbox_t *outbox, mqtt_outbox_msg_t *msg, uint32_t now_ms);
+
+/**
+ * @brief Put a message that could not be sent back at the head of its queue
+ *
+ * Bypasses the budget so a message already accepted is never lost to a
+ * transient send failure.
+ *
+ * @param outbox Outbox state
+ * @param msg Message returned by mqtt_outbox_pop()
+ */
+void mqtt_outbox_requeue(mqtt_outbox_t *outbox, mqtt_outbox_msg_t *msg);
+
+/**
+ * @brief Take the next message to send
+ *
+ * Stale messages met on the way are dropped.
+ *
+ * @param outbox Outbox state
+ * @param now_ms Current time
+ * @param blocked_mask Classes (bit per class index) not to drain right now
+ * @return Message, owned by the caller, or NULL if nothing is eligible
+ */
+mqtt_outbox_msg_t *mqtt_outbox_pop(mqtt_outbox_t *outbox, uint32_t now_ms, uint32_t blocked_mask);
+
+/**
+ * @brief Drop every queued message of a class
+ * @param outbox Outbox state
+ * @param msg_class Class index
+ * @return Bytes released
+ */
+uint32_t mqtt_outbox_shed(mqtt_outbox_t *outbox, uint8_t msg_class);
+
+/**
+ * @brief Total queued bytes over all classes
+ * @param outbox Outbox state
+ * @return Bytes
+ */
+uint32_t mqtt_outbox_queued_bytes(const mqtt_outbox_t *outbox);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_OUTBOX_H
@@ -20,6 +20,22 @@
 
 static const char *TAG = "MQTT_PUB";
 
+/**
+ * @brief Queue a JSON message in the given outbox class
+ */
+static esp_err_t mqtt_publisher_send(const char *topic, const char *json_string, int qos, bool retain,
+                                     mqtt_msg_class_t msg_class)
+{
+    mqtt_publish_options_t options = {
+        .qos = qos,
+        .retain = retain,
+        .utf8_payload = true,
+        .msg_class = msg_class,
+    };
+
+    return mqtt_client_publish_with_options(topic, json_string, strlen(json_string), &options);
+}
+
 /**
  * @brief Publish device status information
  */
@@ -60,7 +76,7 @@ esp_err_t mqtt_publish_device_status(const char *device_id, const char *version,
     char topic[128];
     snprintf(topic, sizeof(topic), "devices/%s/status", device_id);
 
-    esp_err_t err = mqtt_client_publish(topic, json_string, strlen(json_string), 1, true);
+    esp_err_t err = mqtt_publisher_send(topic, json_string, 1, true, MQTT_CLASS_STATUS);
     
     free(json_string);
 
@@ -113,7 +129,7 @@ esp_err_t mqtt_publish_system_metrics(const char *device_id, float cpu_usage,
     char topic[128];
     snprintf(topic, sizeof(topic), "devices/%s/metrics", device_id);
 
-    esp_err_t err = mqtt_client_publish(topic, json_string, strlen(json_string), 0, false);
+    esp_err_t err = mqtt_publisher_send(topic, json_string, 0, false, MQTT_CLASS_TELEMETRY);
     
     free(json_string);
 
@@ -164,7 +180,7 @@ esp_err_t mqtt_publish_alert(const char *device_id, const char *level,
     char topic[128];
     snprintf(topic, sizeof(topic), "devices/%s/alerts", device_id);
 
-    esp_err_t err = mqtt_client_publish(topic, json_string, strlen(json_string), 1, false);
+    esp_err_t err = mqtt_publisher_send(topic, json_string, 1, false, MQTT_CLASS_ALERT);
     
     free(json_string);
 
@@ -218,7 +234,7 @@ esp_err_t mqtt_publish_config_ack(const char *device_id, const char *config_id,
     char topic[128];
     snprintf(topic, sizeof(topic), "devices/%s/config/ack", device_id);
 
-    esp_err_t err = mqtt_client_publish(topic, json_string, strlen(json_string), 1, false);
+    esp_err_t err = mqtt_publisher_send(topic, json_string, 1, false, MQTT_CLASS_CONTROL);
     
     free(json_string);
 
@@ -267,7 +283,7 @@ esp_err_t mqtt_publish_last_will(const char *device_id)
     char topic[128];
     snprintf(topic, sizeof(topic), "devices/%s/status", device_id);
 
-    esp_err_t err = mqtt_client_publish(topic, json_string, strlen(json_string), 1, true);
+    esp_err_t err = mqtt_publisher_send(topic, json_string, 1, true, MQTT_CLASS_STATUS);
     
     free(json_string);
 
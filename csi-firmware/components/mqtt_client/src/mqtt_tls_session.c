@@ -0,0 +1,47 @@
+/**
+ * @file mqtt_tls_session.c
+ * @brief Serialized TLS session record kept across soft restarts
+ */
+
+#include <string.h>
+#include <esp_rom_crc.h>
+
+#include "mqtt_tls_session.h"
+
+#define MQTT_TLS_SESSION_MAGIC      0x544C5331  // "TLS1"
+
+static uint32_t mqtt_tls_session_record_crc(const mqtt_tls_session_record_t *record)
+{
+    size_t start = offsetof(mqtt_tls_session_record_t, port);
+    size_t len = offsetof(mqtt_tls_session_record_t, data) - start + record->len;
+    return esp_rom_crc32_le(0, (const uint8_t *)record + start, len);
+}
+
+bool mqtt_tls_session_record_seal(mqtt_tls_session_record_t *record, const char *host,
+                                  uint16_t port, size_t len)
+{
+    if (len == 0 || len > MQTT_TLS_SESSION_MAX) {
+        mqtt_tls_session_record_clear(record);
+        return false;
+    }
+
+    record->port = port;
+    record->len = (uint16_t)len;
+    memset(record->host, 0, sizeof(record->host));
+    strlcpy(record->host, host, sizeof(record->host));
+    record->crc = mqtt_tls_session_record_crc(record);
+    record->magic = MQTT_TLS_SESSION_MAGIC;
+    return true;
+}
+
+bool mqtt_tls_session_record_valid(const mqtt_tls_session_record_t *record)
+{
+    return record->magic == MQTT_TLS_SESSION_MAGIC &&
+           record->len > 0 && record->len <= MQTT_TLS_SESSION_MAX &&
+           record->crc == mqtt_tls_session_record_crc(record);
+}
+
+void mqtt_tls_session_record_clear(mqtt_tls_session_record_t *record)
+{
+    record->magic = 0;
+}
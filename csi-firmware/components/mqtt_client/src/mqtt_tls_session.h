@@ -0,0 +1,64 @@
+/**
+ * @file mqtt_tls_session.h
+ * @brief Serialized TLS session record kept across soft restarts
+ *
+ * The TLS transport serializes the broker session into a record that lives
+ * in RTC memory. RTC memory is not initialized at power-on, so a record is
+ * only trusted when its magic, length and CRC all check out.
+ */
+
+#ifndef MQTT_TLS_SESSION_H
+#define MQTT_TLS_SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_TLS_HOST_MAX           64
+#define MQTT_TLS_SESSION_MAX        1024    // Serialized session kept in RTC memory, without the peer certificate
+
+/**
+ * @brief Serialized session and the broker it belongs to
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;               ///< CRC over the fields below
+    uint16_t port;
+    uint16_t len;
+    char host[MQTT_TLS_HOST_MAX];
+    uint8_t data[MQTT_TLS_SESSION_MAX];
+} mqtt_tls_session_record_t;
+
+/**
+ * @brief Seal a record whose data holds a freshly serialized session
+ * @param record Record, data already filled
+ * @param host Broker host
+ * @param port Broker port
+ * @param len Bytes of data used
+ * @return false if len does not fit the record, which is then cleared
+ */
+bool mqtt_tls_session_record_seal(mqtt_tls_session_record_t *record, const char *host,
+                                  uint16_t port, size_t len);
+
+/**
+ * @brief Whether the record holds a sealed, intact session
+ * @param record Record
+ * @return true if data, len, host and port can be used
+ */
+bool mqtt_tls_session_record_valid(const mqtt_tls_session_record_t *record);
+
+/**
+ * @brief Invalidate the record
+ * @param record Record
+ */
+void mqtt_tls_session_record_clear(mqtt_tls_session_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_TLS_SESSION_H
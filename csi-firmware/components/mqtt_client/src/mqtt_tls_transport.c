@@ -0,0 +1,609 @@
+/**
+ * @file mqtt_tls_transport.c
+ * @brief TLS transport for esp-mqtt with session resumption
+ *
+ * A full TLS handshake costs an ESP32 several hundred milliseconds of CPU
+ * and a large transient heap allocation for certificate parsing. Every
+ * reconnect used to pay that cost while CSI frames kept arriving. This
+ * transport keeps the negotiated session and offers it on the next
+ * connection, so the broker can resume it with an abbreviated handshake.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <esp_tls.h>
+#include <esp_transport.h>
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include <esp_crt_bundle.h>
+#endif
+
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/error.h>
+#include <mbedtls/version.h>
+
+#include "mqtt_tls_transport.h"
+#include "mqtt_tls_session.h"
+
+static const char *TAG = "MQTT_TLS";
+
+// Struct members became private in mbedtls 3. mqtt_tls_setup() still reads
+// the verify callback of the config, which mbedtls offers no getter for;
+// checked against the 2.x and 3.x lines shipped with ESP-IDF 4 and 5.
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+#if MBEDTLS_VERSION_MAJOR > 3
+#error "mqtt_tls_setup() reads mbedtls_ssl_config internals: check f_vrfy/p_vrfy on this mbedtls version"
+#endif
+
+#define MQTT_TLS_DEFAULT_PORT       8883
+
+typedef int (*mqtt_tls_verify_func_t)(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags);
+
+/**
+ * @brief Per-transport connection state
+ */
+typedef struct {
+    int sock;
+    mbedtls_net_context net;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    bool ssl_ready;
+
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    bool drbg_ready;
+
+    // Certificate verification, chained to the configured verifier
+    mqtt_tls_verify_func_t chained_verify;
+    void *chained_verify_ctx;
+    bool cert_verified;
+
+    // Broker address resolved on the first connection
+    char host[MQTT_TLS_HOST_MAX];
+    int port;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+} mqtt_tls_t;
+
+// Serialized session persisted across soft restarts
+static RTC_NOINIT_ATTR mqtt_tls_session_record_t s_rtc_session;
+
+// Session cache, shared by all connections of the process
+static mbedtls_ssl_session s_session;
+static bool s_session_valid = false;
+static char s_session_host[MQTT_TLS_HOST_MAX];
+static uint16_t s_session_port = 0;
+static SemaphoreHandle_t s_session_mutex = NULL;
+
+static mqtt_tls_metrics_t s_metrics = {0};
+
+// ===== SESSION CACHE =====
+
+static void mqtt_tls_session_clear_locked(void)
+{
+    if (s_session_valid) {
+        mbedtls_ssl_session_free(&s_session);
+        s_session_valid = false;
+    }
+    mqtt_tls_session_record_clear(&s_rtc_session);
+}
+
+/**
+ * @brief Restore the session saved before the last soft restart
+ */
+static void mqtt_tls_session_load_rtc_locked(void)
+{
+    if (s_session_valid || !mqtt_tls_session_record_valid(&s_rtc_session)) {
+        return;
+    }
+
+    mbedtls_ssl_session_init(&s_session);
+    int ret = mbedtls_ssl_session_load(&s_session, s_rtc_session.data, s_rtc_session.len);
+    if (ret != 0) {
+        ESP_LOGW(TAG, "Discarding stored TLS session: -0x%04x", -ret);
+        mbedtls_ssl_session_free(&s_session);
+        mqtt_tls_session_record_clear(&s_rtc_session);
+        return;
+    }
+
+    strlcpy(s_session_host, s_rtc_session.host, sizeof(s_session_host));
+    s_session_port = s_rtc_session.port;
+    s_session_valid = true;
+    ESP_LOGI(TAG, "Restored TLS session for %s:%u from RTC memory", s_session_host, s_session_port);
+}
+
+/**
+ * @brief Offer the cached session for this broker, if any
+ * @return true if a session was offered
+ */
+static bool mqtt_tls_session_offer(mqtt_tls_t *tls, const char *host, int port)
+{
+    bool offered = false;
+
+    xSemaphoreTake(s_session_mutex, portMAX_DELAY);
+    mqtt_tls_session_load_rtc_locked();
+    if (s_session_valid && s_session_port == port && strcmp(s_session_host, host) == 0) {
+        offered = mbedtls_ssl_set_session(&tls->ssl, &s_session) == 0;
+    }
+    xSemaphoreGive(s_session_mutex);
+
+    return offered;
+}
+
+/**
+ * @brief Cache the session negotiated on this connection
+ */
+static void mqtt_tls_session_store(mqtt_tls_t *tls, const char *host, int port)
+{
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    int ret = mbedtls_ssl_get_session(&tls->ssl, &session);
+    if (ret != 0) {
+        // Keep whatever was cached before
+        ESP_LOGD(TAG, "No resumable session: -0x%04x", -ret);
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+
+    xSemaphoreTake(s_session_mutex, portMAX_DELAY);
+
+    mqtt_tls_session_clear_locked();
+    s_session = session;
+    strlcpy(s_session_host, host, sizeof(s_session_host));
+    s_session_port = port;
+    s_session_valid = true;
+
+    size_t len = 0;
+    ret = mbedtls_ssl_session_save(&s_session, s_rtc_session.data, sizeof(s_rtc_session.data), &len);
+    if (ret != 0 || !mqtt_tls_session_record_seal(&s_rtc_session, host, port, len)) {
+        // RAM only: resumed on reconnect, not after a soft restart
+        ESP_LOGW(TAG, "TLS session of %u bytes not persisted (max %d): -0x%04x",
+                 (unsigned)len, MQTT_TLS_SESSION_MAX, -ret);
+    }
+
+    xSemaphoreGive(s_session_mutex);
+}
+
+void mqtt_tls_transport_forget_session(void)
+{
+    if (!s_session_mutex) {
+        mqtt_tls_session_record_clear(&s_rtc_session);
+        return;
+    }
+
+    xSemaphoreTake(s_session_mutex, portMAX_DELAY);
+    mqtt_tls_session_clear_locked();
+    xSemaphoreGive(s_session_mutex);
+}
+
+void mqtt_tls_transport_get_metrics(mqtt_tls_metrics_t *metrics)
+{
+    if (metrics) {
+        memcpy(metrics, &s_metrics, sizeof(mqtt_tls_metrics_t));
+    }
+}
+
+// ===== SOCKET HELPERS =====
+
+/**
+ * @brief Wait until the socket is readable or writable
+ * @return >0 when ready, 0 on timeout, -1 on error
+ */
+static int mqtt_tls_wait(int sock, bool read, int timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+
+    int ret = select(sock + 1, read ? &fds : NULL, read ? NULL : &fds, NULL,
+                     timeout_ms < 0 ? NULL : &tv);
+    return ret < 0 ? -1 : ret;
+}
+
+static int mqtt_tls_resolve(mqtt_tls_t *tls, const char *host, int port)
+{
+    // Reuse the address resolved for the previous connection to the same broker
+    if (tls->addr_len > 0 && tls->port == port && strcmp(tls->host, host) == 0) {
+        return 0;
+    }
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+
+    int ret = getaddrinfo(host, port_str, &hints, &res);
+    if (ret != 0 || !res) {
+        ESP_LOGE(TAG, "Failed to resolve %s: %d", host, ret);
+        return -1;
+    }
+
+    memcpy(&tls->addr, res->ai_addr, res->ai_addrlen);
+    tls->addr_len = res->ai_addrlen;
+    strlcpy(tls->host, host, sizeof(tls->host));
+    tls->port = port;
+    freeaddrinfo(res);
+    return 0;
+}
+
+static int mqtt_tls_tcp_connect(mqtt_tls_t *tls, const char *host, int port, int timeout_ms)
+{
+    if (mqtt_tls_resolve(tls, host, port) != 0) {
+        return -1;
+    }
+
+    tls->sock = socket(tls->addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (tls->sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: %d", errno);
+        return -1;
+    }
+
+    fcntl(tls->sock, F_SETFL, fcntl(tls->sock, F_GETFL, 0) | O_NONBLOCK);
+
+    int ret = connect(tls->sock, (struct sockaddr *)&tls->addr, tls->addr_len);
+    if (ret < 0 && errno == EINPROGRESS) {
+        ret = (mqtt_tls_wait(tls->sock, false, timeout_ms) > 0) ? 0 : -1;
+        if (ret == 0) {
+            int sock_err = 0;
+            socklen_t len = sizeof(sock_err);
+            getsockopt(tls->sock, SOL_SOCKET, SO_ERROR, &sock_err, &len);
+            ret = sock_err ? -1 : 0;
+        }
+    }
+
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", host, port);
+        close(tls->sock);
+        tls->sock = -1;
+        tls->addr_len = 0; // Resolve again next time
+        return -1;
+    }
+
+    return 0;
+}
+
+// ===== TLS =====
+
+static int mqtt_tls_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    mqtt_tls_t *tls = (mqtt_tls_t *)ctx;
+
+    // Only invoked when the broker sent its certificate, i.e. on a full handshake
+    tls->cert_verified = true;
+
+    if (tls->chained_verify) {
+        return tls->chained_verify(tls->chained_verify_ctx, crt, depth, flags);
+    }
+    return 0;
+}
+
+static void mqtt_tls_free_connection(mqtt_tls_t *tls)
+{
+    if (tls->ssl_ready) {
+        mbedtls_ssl_free(&tls->ssl);
+        mbedtls_ssl_config_free(&tls->conf);
+        tls->ssl_ready = false;
+    }
+
+    if (tls->sock >= 0) {
+        close(tls->sock);
+        tls->sock = -1;
+    }
+}
+
+static int mqtt_tls_setup(mqtt_tls_t *tls, const char *host)
+{
+    int ret;
+
+    if (!tls->drbg_ready) {
+        mbedtls_entropy_init(&tls->entropy);
+        mbedtls_ctr_drbg_init(&tls->drbg);
+        ret = mbedtls_ctr_drbg_seed(&tls->drbg, mbedtls_entropy_func, &tls->entropy,
+                                    (const unsigned char *)TAG, strlen(TAG));
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Failed to seed DRBG: -0x%04x", -ret);
+            mbedtls_ctr_drbg_free(&tls->drbg);
+            mbedtls_entropy_free(&tls->entropy);
+            return -1;
+        }
+        tls->drbg_ready = true;
+    }
+
+    mbedtls_ssl_init(&tls->ssl);
+    mbedtls_ssl_config_init(&tls->conf);
+    tls->ssl_ready = true;
+
+    ret = mbedtls_ssl_config_defaults(&tls->conf, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to set TLS defaults: -0x%04x", -ret);
+        return -1;
+    }
+
+    mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_rng(&tls->conf, mbedtls_ctr_drbg_random, &tls->drbg);
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    mbedtls_ssl_conf_session_tickets(&tls->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    // Same trust anchors as before: the global CA store, else the certificate bundle
+    mbedtls_x509_crt *ca_store = esp_tls_get_global_ca_store();
+    if (ca_store) {
+        mbedtls_ssl_conf_ca_chain(&tls->conf, ca_store, NULL);
+    } else {
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        if (esp_crt_bundle_attach(&tls->conf) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to attach certificate bundle");
+            return -1;
+        }
+#else
+        ESP_LOGE(TAG, "No CA certificates available for broker verification");
+        return -1;
+#endif
+    }
+
+    // Wrap whichever verifier is configured to learn whether the handshake was full
+    tls->chained_verify = tls->conf.MBEDTLS_PRIVATE(f_vrfy);
+    tls->chained_verify_ctx = tls->conf.MBEDTLS_PRIVATE(p_vrfy);
+    tls->cert_verified = false;
+    mbedtls_ssl_conf_verify(&tls->conf, mqtt_tls_verify, tls);
+
+    ret = mbedtls_ssl_setup(&tls->ssl, &tls->conf);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to set up TLS context: -0x%04x", -ret);
+        return -1;
+    }
+
+    ret = mbedtls_ssl_set_hostname(&tls->ssl, host);
+    if (ret != 0) {
+        return -1;
+    }
+
+    tls->net.fd = tls->sock;
+    mbedtls_ssl_set_bio(&tls->ssl, &tls->net, mbedtls_net_send, mbedtls_net_recv, NULL);
+    return 0;
+}
+
+// ===== TRANSPORT FUNCTIONS =====
+
+static int mqtt_tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    mqtt_tls_t *tls = esp_transport_get_context_data(t);
+    int64_t start_us = esp_timer_get_time();
+
+    if (mqtt_tls_tcp_connect(tls, host, port, timeout_ms) != 0) {
+        s_metrics.failures++;
+        return -1;
+    }
+
+    if (mqtt_tls_setup(tls, host) != 0) {
+        mqtt_tls_free_connection(tls);
+        s_metrics.failures++;
+        return -1;
+    }
+
+    bool offered = mqtt_tls_session_offer(tls, host, port);
+
+    // Heap peak is sampled between handshake steps
+    uint32_t heap_before = esp_get_free_heap_size();
+    uint32_t heap_min = heap_before;
+    int64_t handshake_start_us = esp_timer_get_time();
+
+    int ret;
+    while ((ret = mbedtls_ssl_handshake(&tls->ssl)) != 0) {
+        heap_min = MIN(heap_min, esp_get_free_heap_size());
+
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGE(TAG, "TLS handshake failed: -0x%04x", -ret);
+            if (offered) {
+                // A stale session must not break the next attempt
+                mqtt_tls_transport_forget_session();
+            }
+            break;
+        }
+
+        int remaining_ms = timeout_ms - (int)((esp_timer_get_time() - start_us) / 1000);
+        if (remaining_ms <= 0 ||
+            mqtt_tls_wait(tls->sock, ret == MBEDTLS_ERR_SSL_WANT_READ, remaining_ms) <= 0) {
+            ESP_LOGE(TAG, "TLS handshake timed out");
+            break;
+        }
+    }
+
+    if (ret != 0) {
+        mqtt_tls_free_connection(tls);
+        s_metrics.failures++;
+        return -1;
+    }
+
+    heap_min = MIN(heap_min, esp_get_free_heap_size());
+    uint32_t handshake_ms = (uint32_t)((esp_timer_get_time() - handshake_start_us) / 1000);
+    uint32_t heap_peak = heap_before - heap_min;
+    bool resumed = offered && !tls->cert_verified;
+
+    s_metrics.handshakes++;
+    if (resumed) {
+        s_metrics.resumed++;
+    }
+    s_metrics.last_ms = handshake_ms;
+    s_metrics.max_ms = MAX(s_metrics.max_ms, handshake_ms);
+    s_metrics.last_heap_peak = heap_peak;
+    s_metrics.max_heap_peak = MAX(s_metrics.max_heap_peak, heap_peak);
+
+    ESP_LOGI(TAG, "TLS %s handshake with %s:%d in %lu ms (heap peak %lu bytes)",
+             resumed ? "resumed" : "full", host, port,
+             (unsigned long)handshake_ms, (unsigned long)heap_peak);
+
+    // Also after a resumption: the broker may have issued a fresh ticket
+    mqtt_tls_session_store(tls, host, port);
+
+    return 0;
+}
+
+static int mqtt_tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    mqtt_tls_t *tls = esp_transport_get_context_data(t);
+    if (tls->sock < 0) {
+        return -1;
+    }
+
+    // Decrypted bytes may already be buffered inside the TLS context
+    if (tls->ssl_ready && mbedtls_ssl_get_bytes_avail(&tls->ssl) > 0) {
+        return 1;
+    }
+    return mqtt_tls_wait(tls->sock, true, timeout_ms);
+}
+
+static int mqtt_tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    mqtt_tls_t *tls = esp_transport_get_context_data(t);
+    if (tls->sock < 0) {
+        return -1;
+    }
+    return mqtt_tls_wait(tls->sock, false, timeout_ms);
+}
+
+static int mqtt_tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    mqtt_tls_t *tls = esp_transport_get_context_data(t);
+    if (!tls->ssl_ready) {
+        return -1;
+    }
+
+    if (mbedtls_ssl_get_bytes_avail(&tls->ssl) == 0) {
+        int poll = mqtt_tls_wait(tls->sock, true, timeout_ms);
+        if (poll <= 0) {
+            return poll == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : -1;
+        }
+    }
+
+    int ret = mbedtls_ssl_read(&tls->ssl, (unsigned char *)buffer, len);
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        // Only part of a record has arrived
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0 || ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+
+    ESP_LOGE(TAG, "TLS read failed: -0x%04x", -ret);
+    return -1;
+}
+
+static int mqtt_tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    mqtt_tls_t *tls = esp_transport_get_context_data(t);
+    if (!tls->ssl_ready) {
+        return -1;
+    }
+
+    int written = 0;
+    int64_t start_us = esp_timer_get_time();
+
+    while (written < len) {
+        int ret = mbedtls_ssl_write(&tls->ssl, (const unsigned char *)buffer + written, len - written);
+        if (ret > 0) {
+            written += ret;
+            continue;
+        }
+
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGE(TAG, "TLS write failed: -0x%04x", -ret);
+            return -1;
+        }
+
+        int remaining_ms = timeout_ms - (int)((esp_timer_get_time() - start_us) / 1000);
+        if (remaining_ms <= 0 ||
+            mqtt_tls_wait(tls->sock, ret == MBEDTLS_ERR_SSL_WANT_READ, remaining_ms) <= 0) {
+            break;
+        }
+    }
+
+    return written;
+}
+
+static int mqtt_tls_close(esp_transport_handle_t t)
+{
+    mqtt_tls_t *tls = esp_transport_get_context_data(t);
+
+    if (tls->ssl_ready && tls->sock >= 0) {
+        // Best effort, the socket is non-blocking
+        mbedtls_ssl_close_notify(&tls->ssl);
+    }
+    mqtt_tls_free_connection(tls);
+    return 0;
+}
+
+static int mqtt_tls_destroy(esp_transport_handle_t t)
+{
+    mqtt_tls_t *tls = esp_transport_get_context_data(t);
+
+    mqtt_tls_close(t);
+    if (tls->drbg_ready) {
+        mbedtls_ctr_drbg_free(&tls->drbg);
+        mbedtls_entropy_free(&tls->entropy);
+    }
+    free(tls);
+    return 0;
+}
+
+esp_transport_handle_t mqtt_tls_transport_create(void)
+{
+    if (!s_session_mutex) {
+        s_session_mutex = xSemaphoreCreateMutex();
+        if (!s_session_mutex) {
+            return NULL;
+        }
+    }
+
+    mqtt_tls_t *tls = calloc(1, sizeof(mqtt_tls_t));
+    if (!tls) {
+        return NULL;
+    }
+    tls->sock = -1;
+    mbedtls_net_init(&tls->net);
+
+    esp_transport_handle_t t = esp_transport_init();
+    if (!t) {
+        free(tls);
+        return NULL;
+    }
+
+    esp_transport_set_context_data(t, tls);
+    esp_transport_set_default_port(t, MQTT_TLS_DEFAULT_PORT);
+    esp_transport_set_func(t, mqtt_tls_connect, mqtt_tls_read, mqtt_tls_write, mqtt_tls_close,
+                           mqtt_tls_poll_read, mqtt_tls_poll_write, mqtt_tls_destroy);
+    return t;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file mqtt_tls_transport.h
+ * @brief TLS transport for esp-mqtt with session resumption
+ *
+ * Replaces the stock SSL transport so the TLS session negotiated with the
+ * broker can be reused. Reconnects offer the cached session (session ID or
+ * ticket, whichever the broker issued) and complete an abbreviated
+ * handshake without certificate chain verification. The session is
+ * mirrored into RTC memory so it also survives soft restarts.
+ */
+
+#ifndef MQTT_TLS_TRANSPORT_H
+#define MQTT_TLS_TRANSPORT_H
+
+#include <stdint.h>
+#include <esp_transport.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Handshake metrics
+ */
+typedef struct {
+    uint32_t handshakes;        ///< Completed handshakes
+    uint32_t resumed;           ///< Handshakes that resumed a cached session
+    uint32_t failures;          ///< Failed connection attempts
+    uint32_t last_ms;           ///< Duration of the last handshake
+    uint32_t max_ms;            ///< Longest handshake
+    uint32_t last_heap_peak;    ///< Heap used at the peak of the last handshake
+    uint32_t max_heap_peak;     ///< Largest handshake heap peak
+} mqtt_tls_metrics_t;
+
+/**
+ * @brief Create the TLS transport
+ *
+ * The handle is owned by esp-mqtt once passed in the client configuration
+ * and is destroyed together with the client.
+ *
+ * @return Transport handle or NULL on failure
+ */
+esp_transport_handle_t mqtt_tls_transport_create(void);
+
+/**
+ * @brief Get handshake metrics
+ * @param metrics Metrics output
+ */
+void mqtt_tls_transport_get_metrics(mqtt_tls_metrics_t *metrics);
+
+/**
+ * @brief Drop the cached session, in RAM and in RTC memory
+ */
+void mqtt_tls_transport_forget_session(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_TLS_TRANSPORT_H
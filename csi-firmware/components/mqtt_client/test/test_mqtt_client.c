@@ -17,6 +17,8 @@
 #include "freertos/task.h"
 
 #include "mqtt_client_wrapper.h"
+#include "mqtt_tls_session.h"
+#include "mqtt_outbox.h"
 
 static const char *TAG = "MQTT_TEST";
 
@@ -170,6 +172,8 @@ void test_mqtt_client_statistics(void)
     TEST_ASSERT_EQUAL(0, stats.messages_received);
     TEST_ASSERT_EQUAL(0, stats.connection_errors);
     TEST_ASSERT_EQUAL(0, stats.publish_errors);
+    TEST_ASSERT_EQUAL(0, stats.reconnect_attempts);
+    TEST_ASSERT_EQUAL(0, stats.last_reconnect_delay_ms);
     TEST_ASSERT_FALSE(stats.connected);
     
     // Reset stats
@@ -181,6 +185,73 @@ void test_mqtt_client_statistics(void)
     TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
 }
 
+void test_mqtt_client_tls_session(void)
+{
+    ESP_LOGI(TAG, "Testing MQTT TLS session cache");
+    
+    mqtt_config_t ssl_config = test_config;
+    ssl_config.ssl_enabled = true;
+    ssl_config.port = 8883;
+    
+    esp_err_t err = mqtt_client_init(&ssl_config);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    
+    // No handshake has happened yet
+    mqtt_stats_t stats;
+    err = mqtt_client_get_stats(&stats);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    TEST_ASSERT_EQUAL(0, stats.tls_handshakes);
+    TEST_ASSERT_EQUAL(0, stats.tls_resumed);
+    
+    // Clearing is always allowed, with or without a cached session
+    err = mqtt_client_clear_tls_session();
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    
+    err = mqtt_client_deinit();
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+}
+
+void test_mqtt_tls_session_record(void)
+{
+    ESP_LOGI(TAG, "Testing the TLS session record kept across restarts");
+    
+    static mqtt_tls_session_record_t record;
+    
+    // RTC memory holds garbage after power-on
+    memset(&record, 0xa5, sizeof(record));
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_valid(&record));
+    
+    // Save, then load back what was saved
+    for (size_t i = 0; i < 300; i++) {
+        record.data[i] = (uint8_t)i;
+    }
+    TEST_ASSERT_TRUE(mqtt_tls_session_record_seal(&record, "broker.example.com", 8883, 300));
+    TEST_ASSERT_TRUE(mqtt_tls_session_record_valid(&record));
+    TEST_ASSERT_EQUAL_STRING("broker.example.com", record.host);
+    TEST_ASSERT_EQUAL(8883, record.port);
+    TEST_ASSERT_EQUAL(300, record.len);
+    
+    // A corrupted session or broker key is not trusted
+    record.data[299] ^= 0x01;
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_valid(&record));
+    record.data[299] ^= 0x01;
+    TEST_ASSERT_TRUE(mqtt_tls_session_record_valid(&record));
+    record.port = 1883;
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_valid(&record));
+    record.port = 8883;
+    
+    // Clearing forgets the session
+    mqtt_tls_session_record_clear(&record);
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_valid(&record));
+    
+    // Sessions that do not fit are not kept at all
+    TEST_ASSERT_TRUE(mqtt_tls_session_record_seal(&record, "broker.example.com", 8883, 300));
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_seal(&record, "broker.example.com", 8883, MQTT_TLS_SESSION_MAX + 1));
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_valid(&record));
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_seal(&record, "broker.example.com", 8883, 0));
+    TEST_ASSERT_FALSE(mqtt_tls_session_record_valid(&record));
+}
+
 void test_mqtt_client_publish_invalid_args(void)
 {
     ESP_LOGI(TAG, "Testing MQTT publish with invalid arguments");
@@ -203,6 +274,324 @@ void test_mqtt_client_publish_invalid_args(void)
     TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
 }
 
+void test_mqtt_client_publish_options(void)
+{
+    ESP_LOGI(TAG, "Testing MQTT publish with options");
+    
+    esp_err_t err = mqtt_client_init(&test_config);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    
+    mqtt_publish_options_t options = {
+        .qos = 0,
+        .utf8_payload = false,
+        .content_type = "application/x-csi-frame",
+        .expiry_s = 5,
+        .topic_alias = true,
+    };
+    const char *test_data = "test message";
+    
+    // Options are required
+    err = mqtt_client_publish_with_options("test/topic", test_data, strlen(test_data), NULL);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
+    
+    // Not connected
+    err = mqtt_client_publish_with_options("test/topic", test_data, strlen(test_data), &options);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
+    
+    // Binary CSI frames need valid data
+    err = mqtt_client_publish_csi_frame(NULL);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
+    
+    int8_t raw[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    csi_data_t csi = {
+        .timestamp = 1000,
+        .rssi = -50,
+        .channel = 6,
+        .len = sizeof(raw),
+        .data = raw,
+        .subcarrier_count = 4,
+        .valid = true,
+    };
+    err = mqtt_client_publish_csi_frame(&csi);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
+    
+    // The frame header layout is part of the wire format
+    TEST_ASSERT_EQUAL(28, sizeof(csi_frame_header_t));
+}
+
+void test_mqtt_client_outbox_stats(void)
+{
+    ESP_LOGI(TAG, "Testing MQTT outbox statistics");
+    
+    mqtt_outbox_stats_t stats;
+    
+    // Not initialized
+    esp_err_t err = mqtt_client_get_outbox_stats(MQTT_CLASS_CSI, &stats);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
+    
+    err = mqtt_client_init(&test_config);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+    
+    // Every class starts empty
+    for (int i = 0; i < MQTT_CLASS_MAX; i++) {
+        err = mqtt_client_get_outbox_stats((mqtt_msg_class_t)i, &stats);
+        TEST_ASSERT_EQUAL(ESP_OK, err);
+        TEST_ASSERT_EQUAL(0, stats.queued_msgs);
+        TEST_ASSERT_EQUAL(0, stats.queued_bytes);
+        TEST_ASSERT_EQUAL(0, stats.dropped);
+    }
+    
+    // Invalid arguments
+    err = mqtt_client_get_outbox_stats(MQTT_CLASS_MAX, &stats);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
+    
+    err = mqtt_client_get_outbox_stats(MQTT_CLASS_ALERT, NULL);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, err);
+}
+
+// ===== OUTBOX =====
+
+#define OUTBOX_TEST_TOPIC   "test/outbox"
+#define OUTBOX_TEST_SIZE    MQTT_OUTBOX_QUANTUM     // One quantum of credit per message
+
+static struct {
+    int dropped;
+    int expired;
+    uint32_t last_sequence;
+} s_outbox_drops;
+
+static void outbox_test_on_drop(const mqtt_outbox_msg_t *msg, bool expired, void *ctx)
+{
+    if (expired) {
+        s_outbox_drops.expired++;
+    } else {
+        s_outbox_drops.dropped++;
+    }
+    s_outbox_drops.last_sequence = msg->sequence;
+}
+
+/**
+ * @brief Message of one class whose allocation is exactly OUTBOX_TEST_SIZE bytes
+ */
+static mqtt_outbox_msg_t *outbox_test_msg(uint8_t msg_class, uint32_t sequence)
+{
+    uint32_t data_len = OUTBOX_TEST_SIZE - sizeof(mqtt_outbox_msg_t) - sizeof(OUTBOX_TEST_TOPIC);
+    mqtt_outbox_msg_t *msg = mqtt_outbox_msg_alloc(OUTBOX_TEST_TOPIC, NULL, data_len);
+    TEST_ASSERT_NOT_NULL(msg);
+    TEST_ASSERT_EQUAL(OUTBOX_TEST_SIZE, msg->size);
+    msg->msg_class = msg_class;
+    msg->sequence = sequence;
+    return msg;
+}
+
+/**
+ * @brief Outbox whose classes all hold four test messages
+ */
+static void outbox_test_init(mqtt_outbox_t *outbox, mqtt_outbox_policy_t policy)
+{
+    mqtt_outbox_class_config_t config[MQTT_OUTBOX_CLASSES];
+    for (int i = 0; i < MQTT_OUTBOX_CLASSES; i++) {
+        config[i] = (mqtt_outbox_class_config_t){
+            .budget_bytes = 4 * OUTBOX_TEST_SIZE,
+            .weight = 1,
+            .policy = policy,
+        };
+    }
+    mqtt_outbox_init(outbox, config);
+    memset(&s_outbox_drops, 0, sizeof(s_outbox_drops));
+    mqtt_outbox_set_drop_callback(outbox, outbox_test_on_drop, NULL);
+}
+
+void test_mqtt_outbox_weighted_drain(void)
+{
+    ESP_LOGI(TAG, "Testing outbox deficit round robin weights");
+    
+    mqtt_outbox_class_config_t config[MQTT_OUTBOX_CLASSES] = {
+        [0] = { .budget_bytes = 64 * OUTBOX_TEST_SIZE, .weight = 1 },
+        [1] = { .budget_bytes = 64 * OUTBOX_TEST_SIZE, .weight = 4 },
+    };
+    mqtt_outbox_t outbox;
+    mqtt_outbox_init(&outbox, config);
+    for (uint32_t i = 0; i < 40; i++) {
+        TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(0, i), 0));
+        TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(1, i), 0));
+    }
+    
+    // While both are backlogged, class 1 drains four times as fast
+    int sent[2] = {0};
+    for (int i = 0; i < 25; i++) {
+        mqtt_outbox_msg_t *msg = mqtt_outbox_pop(&outbox, 0, 0);
+        TEST_ASSERT_NOT_NULL(msg);
+        sent[msg->msg_class]++;
+        mqtt_outbox_msg_free(msg);
+    }
+    TEST_ASSERT_INT_WITHIN(1, 5, sent[0]);
+    TEST_ASSERT_INT_WITHIN(1, 20, sent[1]);
+    
+    // A blocked class is skipped without losing its place in the queue
+    for (int i = 0; i < 10; i++) {
+        mqtt_outbox_msg_t *msg = mqtt_outbox_pop(&outbox, 0, 1u << 1);
+        TEST_ASSERT_NOT_NULL(msg);
+        TEST_ASSERT_EQUAL(0, msg->msg_class);
+        mqtt_outbox_msg_free(msg);
+    }
+    TEST_ASSERT_EQUAL(40 - sent[1], outbox.queues[1].stats.queued_msgs);
+    
+    // Nothing to send while every backlogged class is blocked
+    TEST_ASSERT_NULL(mqtt_outbox_pop(&outbox, 0, (1u << 0) | (1u << 1)));
+
+    mqtt_outbox_clear(&outbox);
+    TEST_ASSERT_EQUAL(0, mqtt_outbox_queued_bytes(&outbox));
+}
+
+void test_mqtt_outbox_class_budgets(void)
+{
+    ESP_LOGI(TAG, "Testing outbox per-class budgets");
+    
+    mqtt_outbox_t outbox;
+    outbox_test_init(&outbox, MQTT_OUTBOX_DROP_NEWEST);
+    
+    // Each class is charged its messages' full allocation size
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(0, i), 0));
+    }
+    TEST_ASSERT_EQUAL(4, outbox.queues[0].stats.queued_msgs);
+    TEST_ASSERT_EQUAL(4 * OUTBOX_TEST_SIZE, outbox.queues[0].stats.queued_bytes);
+    
+    // A full class does not take room from another
+    TEST_ASSERT_FALSE(mqtt_outbox_push(&outbox, outbox_test_msg(0, 4), 0));
+    TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(1, 0), 0));
+    TEST_ASSERT_EQUAL(1, outbox.queues[1].stats.queued_msgs);
+    TEST_ASSERT_EQUAL(0, outbox.queues[1].stats.dropped);
+    TEST_ASSERT_EQUAL(5 * OUTBOX_TEST_SIZE, mqtt_outbox_queued_bytes(&outbox));
+    
+    // A message larger than the whole budget is refused outright
+    mqtt_outbox_msg_t *huge = mqtt_outbox_msg_alloc(OUTBOX_TEST_TOPIC, NULL, 4 * OUTBOX_TEST_SIZE);
+    TEST_ASSERT_NOT_NULL(huge);
+    huge->msg_class = 2;
+    TEST_ASSERT_FALSE(mqtt_outbox_push(&outbox, huge, 0));
+    TEST_ASSERT_EQUAL(0, outbox.queues[2].stats.queued_msgs);
+    TEST_ASSERT_EQUAL(1, outbox.queues[2].stats.dropped);
+    
+    // Popping releases what the message was charged
+    mqtt_outbox_msg_t *msg = mqtt_outbox_pop(&outbox, 0, 0);
+    TEST_ASSERT_NOT_NULL(msg);
+    mqtt_outbox_msg_free(msg);
+    TEST_ASSERT_EQUAL(4 * OUTBOX_TEST_SIZE, mqtt_outbox_queued_bytes(&outbox));
+    
+    mqtt_outbox_clear(&outbox);
+}
+
+void test_mqtt_outbox_overflow_policies(void)
+{
+    ESP_LOGI(TAG, "Testing outbox reject and drop-oldest policies");
+    
+    mqtt_outbox_t outbox;
+    
+    // Reject: the queue keeps what it had, the newcomer is dropped
+    outbox_test_init(&outbox, MQTT_OUTBOX_DROP_NEWEST);
+    for (uint32_t i = 1; i <= 5; i++) {
+        TEST_ASSERT_EQUAL(i <= 4, mqtt_outbox_push(&outbox, outbox_test_msg(0, i), 0));
+    }
+    TEST_ASSERT_EQUAL(1, s_outbox_drops.dropped);
+    TEST_ASSERT_EQUAL(5, s_outbox_drops.last_sequence);
+    mqtt_outbox_msg_t *msg = mqtt_outbox_pop(&outbox, 0, 0);
+    TEST_ASSERT_EQUAL(1, msg->sequence);
+    mqtt_outbox_msg_free(msg);
+    mqtt_outbox_clear(&outbox);
+    
+    // Drop-oldest: the newcomer is queued, the head makes room
+    outbox_test_init(&outbox, MQTT_OUTBOX_DROP_OLDEST);
+    for (uint32_t i = 1; i <= 6; i++) {
+        TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(0, i), 0));
+    }
+    TEST_ASSERT_EQUAL(2, s_outbox_drops.dropped);
+    TEST_ASSERT_EQUAL(2, s_outbox_drops.last_sequence);
+    TEST_ASSERT_EQUAL(2, outbox.queues[0].stats.dropped);
+    TEST_ASSERT_EQUAL(4, outbox.queues[0].stats.queued_msgs);
+    for (uint32_t i = 3; i <= 6; i++) {
+        msg = mqtt_outbox_pop(&outbox, 0, 0);
+        TEST_ASSERT_NOT_NULL(msg);
+        TEST_ASSERT_EQUAL(i, msg->sequence);
+        mqtt_outbox_msg_free(msg);
+    }
+    TEST_ASSERT_NULL(mqtt_outbox_pop(&outbox, 0, 0));
+}
+
+void test_mqtt_outbox_requeue(void)
+{
+    ESP_LOGI(TAG, "Testing outbox requeue after a failed publish");
+    
+    mqtt_outbox_t outbox;
+    outbox_test_init(&outbox, MQTT_OUTBOX_DROP_NEWEST);
+    for (uint32_t i = 1; i <= 4; i++) {
+        TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(0, i), 0));
+    }
+    
+    mqtt_outbox_msg_t *msg = mqtt_outbox_pop(&outbox, 0, 0);
+    TEST_ASSERT_EQUAL(1, msg->sequence);
+    TEST_ASSERT_EQUAL(1, outbox.queues[0].stats.sent);
+    
+    // The slot freed by the pop was taken in the meantime
+    TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(0, 5), 0));
+    
+    // The failed message goes back to the head, over budget if need be, and is not counted as sent
+    mqtt_outbox_requeue(&outbox, msg);
+    TEST_ASSERT_EQUAL(5, outbox.queues[0].stats.queued_msgs);
+    TEST_ASSERT_EQUAL(0, outbox.queues[0].stats.sent);
+    TEST_ASSERT_EQUAL(0, s_outbox_drops.dropped);
+    
+    for (uint32_t i = 1; i <= 5; i++) {
+        msg = mqtt_outbox_pop(&outbox, 0, 0);
+        TEST_ASSERT_NOT_NULL(msg);
+        TEST_ASSERT_EQUAL(i, msg->sequence);
+        mqtt_outbox_msg_free(msg);
+    }
+    TEST_ASSERT_EQUAL(0, mqtt_outbox_queued_bytes(&outbox));
+}
+
+void test_mqtt_outbox_expiry(void)
+{
+    ESP_LOGI(TAG, "Testing outbox message expiry");
+    
+    mqtt_outbox_t outbox;
+    outbox_test_init(&outbox, MQTT_OUTBOX_DROP_NEWEST);
+    
+    mqtt_outbox_msg_t *msg = outbox_test_msg(0, 1);
+    msg->expiry_ms = 100;
+    TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, msg, 1000));
+    msg = outbox_test_msg(0, 2);
+    TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, msg, 1000));
+    
+    // Within its lifetime a message is sent normally
+    msg = mqtt_outbox_pop(&outbox, 1100, 0);
+    TEST_ASSERT_EQUAL(1, msg->sequence);
+    mqtt_outbox_requeue(&outbox, msg);
+    
+    // Past it, the message is dropped on the way and the next one is sent
+    msg = mqtt_outbox_pop(&outbox, 1101, 0);
+    TEST_ASSERT_NOT_NULL(msg);
+    TEST_ASSERT_EQUAL(2, msg->sequence);
+    mqtt_outbox_msg_free(msg);
+    TEST_ASSERT_EQUAL(1, s_outbox_drops.expired);
+    TEST_ASSERT_EQUAL(1, s_outbox_drops.last_sequence);
+    TEST_ASSERT_EQUAL(1, outbox.queues[0].stats.expired);
+    TEST_ASSERT_EQUAL(0, outbox.queues[0].stats.dropped);
+    
+    // Stale messages also make room for new ones, ahead of the overflow policy
+    for (uint32_t i = 10; i < 14; i++) {
+        msg = outbox_test_msg(0, i);
+        msg->expiry_ms = 100;
+        TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, msg, 2000));
+    }
+    TEST_ASSERT_TRUE(mqtt_outbox_push(&outbox, outbox_test_msg(0, 20), 2200));
+    TEST_ASSERT_EQUAL(5, s_outbox_drops.expired);
+    TEST_ASSERT_EQUAL(0, s_outbox_drops.dropped);
+    TEST_ASSERT_EQUAL(1, outbox.queues[0].stats.queued_msgs);
+    
+    mqtt_outbox_clear(&outbox);
+}
+
 void test_mqtt_client_subscribe_operations(void)
 {
     ESP_LOGI(TAG, "Testing MQTT subscribe operations");
@@ -327,10 +716,21 @@ void app_main(void)
     RUN_TEST(test_mqtt_client_lifecycle);
     RUN_TEST(test_mqtt_client_callback_registration);
     RUN_TEST(test_mqtt_client_statistics);
+    RUN_TEST(test_mqtt_client_tls_session);
+    RUN_TEST(test_mqtt_tls_session_record);
     
     // Publish/Subscribe tests
     RUN_TEST(test_mqtt_client_publish_without_connection);
     RUN_TEST(test_mqtt_client_publish_invalid_args);
+    RUN_TEST(test_mqtt_client_publish_options);
+    RUN_TEST(test_mqtt_client_outbox_stats);
+    
+    // Outbox tests
+    RUN_TEST(test_mqtt_outbox_weighted_drain);
+    RUN_TEST(test_mqtt_outbox_class_budgets);
+    RUN_TEST(test_mqtt_outbox_overflow_policies);
+    RUN_TEST(test_mqtt_outbox_requeue);
+    RUN_TEST(test_mqtt_outbox_expiry);
     RUN_TEST(test_mqtt_client_subscribe_operations);
     
     // Publisher utility tests
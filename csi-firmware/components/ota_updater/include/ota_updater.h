@@ -55,8 +55,28 @@ typedef struct {
     uint64_t last_update_time;  ///< Last successful update timestamp
     char current_version[32];   ///< Current firmware version
     char available_version[32]; ///< Available update version
+    uint32_t downloads_resumed; ///< Number of downloads resumed from a checkpoint
+    uint32_t bytes_resumed;     ///< Bytes skipped thanks to resumed downloads
+    uint32_t checks_not_modified; ///< Checks answered from the cached manifest (HTTP 304)
 } ota_stats_t;
 
+/**
+ * @brief Load sample used to pace OTA downloads against CSI ingestion
+ */
+typedef struct {
+    uint32_t queue_depth;       ///< Frames currently waiting in the CSI pipeline
+    uint32_t queue_capacity;    ///< Total capacity of the CSI pipeline queues
+    uint32_t frames_dropped;    ///< Frames the CSI pipeline dropped since it started
+} ota_load_sample_t;
+
+/**
+ * @brief Load probe function type
+ * @param sample Sample structure to fill
+ * @param user_ctx User context pointer
+ * @return true if the sample is valid, false otherwise
+ */
+typedef bool (*ota_load_probe_t)(ota_load_sample_t *sample, void *user_ctx);
+
 /**
  * @brief OTA progress callback function type
  * @param status Current OTA status
@@ -96,6 +116,19 @@ esp_err_t ota_updater_deinit(void);
  */
 esp_err_t ota_updater_check_for_updates(void);
 
+/**
+ * @brief Compare two firmware versions using semantic versioning
+ * 
+ * Accepts an optional leading 'v', up to three numeric components and an
+ * optional pre-release suffix; build metadata after '+' is ignored.
+ * A release orders after its pre-releases (1.2.0-rc.1 < 1.2.0).
+ * 
+ * @param a First version string
+ * @param b Second version string
+ * @return Negative if a < b, zero if equal, positive if a > b
+ */
+int ota_updater_compare_versions(const char *a, const char *b);
+
 /**
  * @brief Start firmware update process
  * @param url Update URL (optional, uses config URL if NULL)
@@ -137,6 +170,24 @@ esp_err_t ota_updater_register_callback(ota_progress_callback_t callback, void *
  */
 esp_err_t ota_updater_update_config(const ota_config_t *config);
 
+/**
+ * @brief Register a load probe used to pace downloads
+ * 
+ * Downloads run at full speed while the probe reports an idle pipeline and
+ * back off as the CSI queues fill up, and fully whenever frames are dropped.
+ * 
+ * @param probe Probe function (NULL to download without pacing)
+ * @param user_ctx User context pointer
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t ota_updater_register_load_probe(ota_load_probe_t probe, void *user_ctx);
+
+/**
+ * @brief Discard any persisted partial download
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t ota_updater_clear_resume_state(void);
+
 /**
  * @brief Rollback to previous firmware version
  * @return ESP_OK on success, error code on failure
@@ -3,15 +3,36 @@
  * @brief OTA HTTP Client with Advanced Security Features
  */
 
+#include "ota_client.h"
 #include <string.h>
+#include <strings.h>
 #include <esp_log.h>
 #include <esp_http_client.h>
 #include <esp_crt_bundle.h>
 #include <esp_tls.h>
 #include <mbedtls/error.h>
+#include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 static const char *TAG = "ota_client";
 
+#define OTA_MANIFEST_MAX_SIZE   1024
+
+/**
+ * @brief Response collected by the version check client
+ */
+typedef struct {
+    char etag[64];
+    char body[OTA_MANIFEST_MAX_SIZE];
+    int body_len;
+    bool truncated;
+} ota_check_response_t;
+
+// Persistent keep-alive client shared by all version checks
+static esp_http_client_handle_t s_check_client = NULL;
+static SemaphoreHandle_t s_check_mutex = NULL;
+
 // Certificate validation callback
 static esp_err_t ota_http_event_handler(esp_http_client_event_t *evt)
 {
@@ -27,9 +48,25 @@ static esp_err_t ota_http_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (evt->user_data && strcasecmp(evt->header_key, "ETag") == 0) {
+                ota_check_response_t *resp = (ota_check_response_t *)evt->user_data;
+                strlcpy(resp->etag, evt->header_value, sizeof(resp->etag));
+            }
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
+            if (evt->user_data) {
+                ota_check_response_t *resp = (ota_check_response_t *)evt->user_data;
+                int space = (int)sizeof(resp->body) - 1 - resp->body_len;
+                int copy = evt->data_len < space ? evt->data_len : space;
+                if (copy < evt->data_len) {
+                    resp->truncated = true;
+                }
+                if (copy > 0) {
+                    memcpy(&resp->body[resp->body_len], evt->data, copy);
+                    resp->body_len += copy;
+                }
+            }
             break;
         case HTTP_EVENT_ON_FINISH:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
@@ -70,61 +107,159 @@ esp_http_client_handle_t ota_http_client_init(const char *url, const char *cert_
     return esp_http_client_init(&config);
 }
 
-esp_err_t ota_http_check_version(const char *base_url, char *version_out, size_t version_len)
+static esp_http_client_handle_t ota_check_client_get(const char *url, const char *cert_pem)
+{
+    if (s_check_client) {
+        // Same host keeps the connection, a new host reconnects
+        if (esp_http_client_set_url(s_check_client, url) == ESP_OK) {
+            return s_check_client;
+        }
+        esp_http_client_cleanup(s_check_client);
+        s_check_client = NULL;
+    }
+    
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_GET,
+        .event_handler = ota_http_event_handler,
+        .timeout_ms = 10000,
+        .buffer_size = 1024,
+        .buffer_size_tx = 512,
+        .keep_alive_enable = true,
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        // Reconnects after the server dropped the idle connection resume the session
+        .save_client_session = true,
+#endif
+    };
+    
+    if (cert_pem && strlen(cert_pem) > 0) {
+        config.cert_pem = cert_pem;
+    } else {
+        config.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+    
+    s_check_client = esp_http_client_init(&config);
+    return s_check_client;
+}
+
+static esp_err_t ota_parse_manifest_version(const char *body, char *version_out, size_t version_len)
+{
+    cJSON *json = cJSON_Parse(body);
+    if (!json) {
+        // Fallback: treat entire response as version string
+        strlcpy(version_out, body, version_len);
+        version_out[strcspn(version_out, "\r\n")] = '\0';
+        return strlen(version_out) > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+    }
+    
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    cJSON *version_item = cJSON_GetObjectItem(json, "version");
+    if (version_item && cJSON_IsString(version_item)) {
+        strlcpy(version_out, version_item->valuestring, version_len);
+        ret = ESP_OK;
+    }
+    cJSON_Delete(json);
+    return ret;
+}
+
+esp_err_t ota_http_check_version(const char *base_url, const char *cert_pem,
+                                 ota_manifest_cache_t *cache, bool *not_modified)
 {
+    if (!base_url || !cache) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (not_modified) {
+        *not_modified = false;
+    }
+    
+    if (!s_check_mutex) {
+        s_check_mutex = xSemaphoreCreateMutex();
+        if (!s_check_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
     char version_url[512];
     snprintf(version_url, sizeof(version_url), "%s/version.json", base_url);
     
-    esp_http_client_handle_t client = ota_http_client_init(version_url, NULL);
+    // An ETag from another server says nothing about this one
+    if (cache->valid && strcmp(cache->url, base_url) != 0) {
+        ESP_LOGI(TAG, "Update URL changed, dropping the cached manifest");
+        memset(cache, 0, sizeof(*cache));
+    }
+    
+    xSemaphoreTake(s_check_mutex, portMAX_DELAY);
+    
+    esp_http_client_handle_t client = ota_check_client_get(version_url, cert_pem);
     if (!client) {
+        xSemaphoreGive(s_check_mutex);
         return ESP_ERR_NO_MEM;
     }
     
+    static ota_check_response_t resp;
+    memset(&resp, 0, sizeof(resp));
+    esp_http_client_set_user_data(client, &resp);
+    
+    if (cache->valid && strlen(cache->etag) > 0) {
+        esp_http_client_set_header(client, "If-None-Match", cache->etag);
+    } else {
+        esp_http_client_delete_header(client, "If-None-Match");
+    }
+    
     esp_err_t ret = esp_http_client_perform(client);
     
     if (ret == ESP_OK) {
         int status_code = esp_http_client_get_status_code(client);
-        int content_length = esp_http_client_get_content_length(client);
         
-        if (status_code == 200 && content_length > 0 && content_length < 1024) {
-            char buffer[1024];
-            int data_read = esp_http_client_read_response(client, buffer, sizeof(buffer) - 1);
-            if (data_read > 0) {
-                buffer[data_read] = '\0';
-                
-                // Simple version extraction - look for version field in JSON
-                char *version_start = strstr(buffer, "\"version\"");
-                if (version_start) {
-                    version_start = strchr(version_start, ':');
-                    if (version_start) {
-                        version_start = strchr(version_start, '"');
-                        if (version_start) {
-                            version_start++; // Skip opening quote
-                            char *version_end = strchr(version_start, '"');
-                            if (version_end) {
-                                size_t len = version_end - version_start;
-                                if (len < version_len) {
-                                    strncpy(version_out, version_start, len);
-                                    version_out[len] = '\0';
-                                    ret = ESP_OK;
-                                } else {
-                                    ret = ESP_ERR_NO_MEM;
-                                }
-                            }
-                        }
-                    }
-                }
+        if (status_code == 304 && cache->valid) {
+            ESP_LOGD(TAG, "Version manifest not modified (%s)", cache->etag);
+            if (not_modified) {
+                *not_modified = true;
+            }
+        } else if (status_code == 200 && resp.body_len > 0 && !resp.truncated) {
+            resp.body[resp.body_len] = '\0';
+            char version[sizeof(cache->version)];
+            ret = ota_parse_manifest_version(resp.body, version, sizeof(version));
+            if (ret == ESP_OK) {
+                strlcpy(cache->url, base_url, sizeof(cache->url));
+                strlcpy(cache->version, version, sizeof(cache->version));
+                strlcpy(cache->etag, resp.etag, sizeof(cache->etag));
+                cache->valid = true;
             }
         } else {
             ESP_LOGW(TAG, "Version check failed: HTTP %d", status_code);
-            ret = ESP_FAIL;
+            ret = (status_code == 200) ? ESP_ERR_INVALID_SIZE : ESP_ERR_HTTP_BASE + status_code;
         }
+    } else {
+        // Drop the connection so the next check starts from a clean client
+        ESP_LOGW(TAG, "Version check request failed: %s", esp_err_to_name(ret));
+        esp_http_client_cleanup(s_check_client);
+        s_check_client = NULL;
     }
     
-    esp_http_client_cleanup(client);
+    if (s_check_client) {
+        esp_http_client_set_user_data(s_check_client, NULL);
+    }
+    
+    xSemaphoreGive(s_check_mutex);
     return ret;
 }
 
+void ota_http_check_client_close(void)
+{
+    if (!s_check_mutex) {
+        return;
+    }
+    
+    xSemaphoreTake(s_check_mutex, portMAX_DELAY);
+    if (s_check_client) {
+        esp_http_client_cleanup(s_check_client);
+        s_check_client = NULL;
+    }
+    xSemaphoreGive(s_check_mutex);
+}
+
 esp_err_t ota_http_download_file(const char *url, const char *cert_pem, 
                                  esp_err_t (*data_handler)(const char *data, size_t len, void *ctx),
                                  void *handler_ctx)
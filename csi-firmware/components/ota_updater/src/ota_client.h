@@ -0,0 +1,75 @@
+/**
+ * @file ota_client.h
+ * @brief OTA HTTP client helpers
+ */
+
+#ifndef OTA_CLIENT_H
+#define OTA_CLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <esp_http_client.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Last version manifest received from the update server
+ */
+typedef struct {
+    char url[128];              ///< Update base URL the manifest came from
+    char etag[64];              ///< ETag of the cached manifest
+    char version[32];           ///< Version announced by the cached manifest
+    bool valid;                 ///< Cache holds a manifest
+} ota_manifest_cache_t;
+
+/**
+ * @brief Create an HTTP client for OTA transfers
+ * @param url URL to request
+ * @param cert_pem Server certificate (NULL to use the certificate bundle)
+ * @return Client handle or NULL on failure
+ */
+esp_http_client_handle_t ota_http_client_init(const char *url, const char *cert_pem);
+
+/**
+ * @brief Fetch the version manifest, revalidating the cached copy
+ *
+ * Uses one keep-alive client for all checks so polling reuses the
+ * connection, or resumes the TLS session when the server closed it.
+ * The request carries If-None-Match when the cache is valid; a 304
+ * answer returns the cached version without transferring the manifest.
+ * A cache filled from another base URL is dropped first.
+ *
+ * @param base_url Update base URL ("/version.json" is appended)
+ * @param cert_pem Server certificate (NULL or empty to use the certificate bundle)
+ * @param cache Manifest cache, updated on a 200 response
+ * @param not_modified Set to true when the server answered 304 (optional)
+ * @return ESP_OK on success, cache->version holds the available version
+ */
+esp_err_t ota_http_check_version(const char *base_url, const char *cert_pem,
+                                 ota_manifest_cache_t *cache, bool *not_modified);
+
+/**
+ * @brief Close the persistent version check client
+ */
+void ota_http_check_client_close(void);
+
+/**
+ * @brief Download a file and pass its contents to a handler
+ * @param url File URL
+ * @param cert_pem Server certificate (NULL to use the certificate bundle)
+ * @param data_handler Called for every chunk received
+ * @param handler_ctx Handler context
+ * @return ESP_OK on success
+ */
+esp_err_t ota_http_download_file(const char *url, const char *cert_pem,
+                                 esp_err_t (*data_handler)(const char *data, size_t len, void *ctx),
+                                 void *handler_ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_CLIENT_H
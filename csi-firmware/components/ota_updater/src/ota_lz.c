@@ -0,0 +1,249 @@
+/**
+ * @file ota_lz.c
+ * @brief Streaming decoder for compressed OTA images
+ */
+
+#include "ota_lz.h"
+#include <string.h>
+
+static uint32_t ota_lz_read_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void ota_lz_write_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+bool ota_lz_is_compressed(const uint8_t *data, size_t len)
+{
+    return data && len >= 4 && memcmp(data, OTA_LZ_MAGIC, 4) == 0;
+}
+
+ota_lz_result_t ota_lz_parse_header(const uint8_t *data, ota_lz_header_t *header)
+{
+    if (!data || !header || !ota_lz_is_compressed(data, OTA_LZ_HEADER_SIZE)) {
+        return OTA_LZ_ERR_FORMAT;
+    }
+
+    memset(header, 0, sizeof(ota_lz_header_t));
+    header->version = data[4];
+    header->window_bits = data[5];
+    header->lookahead_bits = data[6];
+    header->raw_size = ota_lz_read_u32(&data[8]);
+    header->block_size = ota_lz_read_u32(&data[12]);
+    memcpy(header->sha256, &data[16], sizeof(header->sha256));
+
+    if (header->version != OTA_LZ_VERSION ||
+        header->window_bits < OTA_LZ_MIN_WINDOW_BITS ||
+        header->window_bits > OTA_LZ_MAX_WINDOW_BITS ||
+        header->lookahead_bits < OTA_LZ_MIN_LOOKAHEAD_BITS ||
+        header->lookahead_bits > header->window_bits ||
+        header->block_size == 0 || header->block_size > OTA_LZ_BLOCK_SIZE ||
+        (1U << header->window_bits) > header->block_size) {
+        return OTA_LZ_ERR_FORMAT;
+    }
+
+    return OTA_LZ_OK;
+}
+
+void ota_lz_write_header(const ota_lz_header_t *header, uint8_t *data)
+{
+    memset(data, 0, OTA_LZ_HEADER_SIZE);
+    memcpy(data, OTA_LZ_MAGIC, 4);
+    data[4] = header->version;
+    data[5] = header->window_bits;
+    data[6] = header->lookahead_bits;
+    ota_lz_write_u32(&data[8], header->raw_size);
+    ota_lz_write_u32(&data[12], header->block_size);
+    memcpy(&data[16], header->sha256, sizeof(header->sha256));
+}
+
+void ota_lz_decoder_init(ota_lz_decoder_t *dec, ota_lz_output_cb_t output, void *output_ctx)
+{
+    memset(dec, 0, sizeof(ota_lz_decoder_t));
+    dec->output = output;
+    dec->output_ctx = output_ctx;
+}
+
+void ota_lz_decoder_resume(ota_lz_decoder_t *dec, const ota_lz_header_t *header,
+                           uint32_t block_index, uint32_t consumed,
+                           ota_lz_output_cb_t output, void *output_ctx)
+{
+    ota_lz_decoder_init(dec, output, output_ctx);
+    memcpy(&dec->header, header, sizeof(ota_lz_header_t));
+    dec->header_valid = true;
+    dec->block_index = block_index;
+    dec->consumed = consumed;
+    dec->produced = block_index * header->block_size;
+}
+
+/**
+ * @brief MSB-first bit reader over one block payload
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    uint8_t bit;
+} ota_lz_bits_t;
+
+static bool ota_lz_get_bits(ota_lz_bits_t *br, uint8_t count, uint32_t *value)
+{
+    uint32_t v = 0;
+    while (count--) {
+        if (br->pos >= br->len) {
+            return false;
+        }
+        v = (v << 1) | ((br->data[br->pos] >> (7 - br->bit)) & 1);
+        if (++br->bit == 8) {
+            br->bit = 0;
+            br->pos++;
+        }
+    }
+    *value = v;
+    return true;
+}
+
+ota_lz_result_t ota_lz_decode_block(const ota_lz_header_t *header, const uint8_t *in, size_t in_len,
+                                    uint8_t *out, size_t out_len)
+{
+    ota_lz_bits_t br = { .data = in, .len = in_len };
+    size_t produced = 0;
+
+    while (produced < out_len) {
+        uint32_t tag;
+        if (!ota_lz_get_bits(&br, 1, &tag)) {
+            return OTA_LZ_ERR_FORMAT;
+        }
+
+        if (tag) {
+            uint32_t literal;
+            if (!ota_lz_get_bits(&br, 8, &literal)) {
+                return OTA_LZ_ERR_FORMAT;
+            }
+            out[produced++] = (uint8_t)literal;
+            continue;
+        }
+
+        uint32_t offset, count;
+        if (!ota_lz_get_bits(&br, header->window_bits, &offset) ||
+            !ota_lz_get_bits(&br, header->lookahead_bits, &count)) {
+            return OTA_LZ_ERR_FORMAT;
+        }
+        offset += 1;
+        count += 1;
+
+        if (offset > produced || count > out_len - produced) {
+            return OTA_LZ_ERR_FORMAT;
+        }
+
+        // Byte-wise copy: overlapping references repeat the pattern
+        const uint8_t *src = &out[produced - offset];
+        for (uint32_t i = 0; i < count; i++) {
+            out[produced + i] = src[i];
+        }
+        produced += count;
+    }
+
+    return OTA_LZ_OK;
+}
+
+static uint32_t ota_lz_block_raw_len(const ota_lz_decoder_t *dec)
+{
+    uint32_t start = dec->block_index * dec->header.block_size;
+    uint32_t remaining = dec->header.raw_size - start;
+    return remaining < dec->header.block_size ? remaining : dec->header.block_size;
+}
+
+ota_lz_result_t ota_lz_decoder_feed(ota_lz_decoder_t *dec, const uint8_t *data, size_t len)
+{
+    if (!dec || (!data && len > 0)) {
+        return OTA_LZ_ERR_FORMAT;
+    }
+
+    while (len > 0) {
+        if (dec->header_valid && dec->produced >= dec->header.raw_size) {
+            return OTA_LZ_DONE;
+        }
+
+        if (!dec->header_valid) {
+            size_t take = OTA_LZ_HEADER_SIZE - dec->fill;
+            take = take < len ? take : len;
+            memcpy(&dec->header_buf[dec->fill], data, take);
+            dec->fill += take;
+            dec->consumed += take;
+            data += take;
+            len -= take;
+
+            if (dec->fill == OTA_LZ_HEADER_SIZE) {
+                if (ota_lz_parse_header(dec->header_buf, &dec->header) != OTA_LZ_OK) {
+                    return OTA_LZ_ERR_FORMAT;
+                }
+                dec->header_valid = true;
+                dec->fill = 0;
+            }
+            continue;
+        }
+
+        if (dec->block_len == 0) {
+            // Two byte block length, possibly split across feeds
+            dec->in[dec->fill++] = *data++;
+            dec->consumed++;
+            len--;
+            if (dec->fill < 2) {
+                continue;
+            }
+
+            uint16_t raw = (uint16_t)(dec->in[0] | (dec->in[1] << 8));
+            dec->block_stored = (raw & OTA_LZ_BLOCK_STORED) != 0;
+            dec->block_len = raw & ~OTA_LZ_BLOCK_STORED;
+            dec->fill = 0;
+
+            if (dec->block_len == 0 || dec->block_len > OTA_LZ_BLOCK_SIZE ||
+                (dec->block_stored && dec->block_len != ota_lz_block_raw_len(dec))) {
+                return OTA_LZ_ERR_FORMAT;
+            }
+            continue;
+        }
+
+        size_t take = dec->block_len - dec->fill;
+        take = take < len ? take : len;
+        memcpy(&dec->in[dec->fill], data, take);
+        dec->fill += take;
+        dec->consumed += take;
+        data += take;
+        len -= take;
+
+        if (dec->fill < dec->block_len) {
+            continue;
+        }
+
+        uint32_t raw_len = ota_lz_block_raw_len(dec);
+        const uint8_t *block = dec->in;
+        if (!dec->block_stored) {
+            if (ota_lz_decode_block(&dec->header, dec->in, dec->block_len, dec->out, raw_len) != OTA_LZ_OK) {
+                return OTA_LZ_ERR_FORMAT;
+            }
+            block = dec->out;
+        }
+
+        dec->block_index++;
+        dec->produced += raw_len;
+        dec->block_len = 0;
+        dec->fill = 0;
+
+        if (dec->output && dec->output(block, raw_len, dec->output_ctx) != 0) {
+            return OTA_LZ_ERR_OUTPUT;
+        }
+    }
+
+    if (dec->header_valid && dec->produced >= dec->header.raw_size) {
+        return OTA_LZ_DONE;
+    }
+    return OTA_LZ_OK;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file ota_lz.h
+ * @brief Streaming decoder for compressed OTA images
+ *
+ * Compressed images use a heatshrink-style LZSS bitstream split into
+ * independent blocks of one flash sector each. A block only references
+ * bytes inside itself, so the decoder needs a single block of history
+ * and every block boundary is a valid resume point.
+ *
+ * Image layout (little endian):
+ *   header  : "CSIZ", version, window_bits, lookahead_bits, reserved,
+ *             raw_size (u32), block_size (u32), sha256 of raw image [32]
+ *   blocks  : u16 length (bit 15 set = stored uncompressed), payload
+ *
+ * Bitstream: tag bit 1 + 8 bit literal, or tag bit 0 + (offset - 1) in
+ * window_bits + (length - 1) in lookahead_bits. Bits are MSB first and
+ * each block payload is padded to a whole byte.
+ *
+ * This file has no ESP-IDF dependencies so the host packer can share it.
+ */
+
+#ifndef OTA_LZ_H
+#define OTA_LZ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_LZ_MAGIC            "CSIZ"
+#define OTA_LZ_VERSION          1
+#define OTA_LZ_HEADER_SIZE      48
+#define OTA_LZ_BLOCK_SIZE       4096
+#define OTA_LZ_BLOCK_STORED     0x8000
+#define OTA_LZ_MIN_WINDOW_BITS  4
+#define OTA_LZ_MAX_WINDOW_BITS  12
+#define OTA_LZ_MIN_LOOKAHEAD_BITS 2
+
+/**
+ * @brief Decoder result codes
+ */
+typedef enum {
+    OTA_LZ_OK = 0,          ///< Input consumed, more input expected
+    OTA_LZ_DONE,            ///< Whole image decoded
+    OTA_LZ_ERR_FORMAT,      ///< Malformed header or block
+    OTA_LZ_ERR_OUTPUT,      ///< Output callback reported a failure
+} ota_lz_result_t;
+
+/**
+ * @brief Compressed image header
+ */
+typedef struct {
+    uint8_t version;            ///< Format version
+    uint8_t window_bits;        ///< Backreference offset width
+    uint8_t lookahead_bits;     ///< Backreference length width
+    uint32_t raw_size;          ///< Size of the uncompressed image
+    uint32_t block_size;        ///< Uncompressed bytes per block
+    uint8_t sha256[32];         ///< SHA-256 of the uncompressed image
+} ota_lz_header_t;
+
+/**
+ * @brief Output callback, invoked once per decoded block
+ * @param data Decoded bytes
+ * @param len Number of decoded bytes
+ * @param user_ctx User context pointer
+ * @return 0 on success, non-zero to abort decoding
+ */
+typedef int (*ota_lz_output_cb_t)(const uint8_t *data, size_t len, void *user_ctx);
+
+/**
+ * @brief Decoder state
+ *
+ * Memory use is fixed: one compressed and one decoded block buffer.
+ */
+typedef struct {
+    ota_lz_header_t header;     ///< Parsed image header
+    bool header_valid;          ///< Header has been parsed
+    uint8_t header_buf[OTA_LZ_HEADER_SIZE];
+    uint32_t block_index;       ///< Index of the block being received
+    uint16_t block_len;         ///< Payload length of the current block
+    bool block_stored;          ///< Current block is stored uncompressed
+    uint32_t fill;              ///< Bytes buffered for header/length/payload
+    uint32_t consumed;          ///< Total compressed bytes consumed
+    uint32_t produced;          ///< Total decoded bytes emitted
+    uint8_t in[OTA_LZ_BLOCK_SIZE];  ///< Compressed payload of current block
+    uint8_t out[OTA_LZ_BLOCK_SIZE]; ///< Decoded block (also the history window)
+    ota_lz_output_cb_t output;  ///< Output callback
+    void *output_ctx;           ///< Output callback context
+} ota_lz_decoder_t;
+
+/**
+ * @brief Check whether a buffer starts with a compressed image header
+ * @param data Buffer to inspect
+ * @param len Buffer length
+ * @return true if the magic matches
+ */
+bool ota_lz_is_compressed(const uint8_t *data, size_t len);
+
+/**
+ * @brief Parse a serialized header
+ * @param data Header bytes (OTA_LZ_HEADER_SIZE)
+ * @param header Parsed header output
+ * @return OTA_LZ_OK or OTA_LZ_ERR_FORMAT
+ */
+ota_lz_result_t ota_lz_parse_header(const uint8_t *data, ota_lz_header_t *header);
+
+/**
+ * @brief Serialize a header
+ * @param header Header to serialize
+ * @param data Output buffer (OTA_LZ_HEADER_SIZE)
+ */
+void ota_lz_write_header(const ota_lz_header_t *header, uint8_t *data);
+
+/**
+ * @brief Initialize decoder at the start of an image
+ * @param dec Decoder state
+ * @param output Output callback
+ * @param output_ctx Output callback context
+ */
+void ota_lz_decoder_init(ota_lz_decoder_t *dec, ota_lz_output_cb_t output, void *output_ctx);
+
+/**
+ * @brief Initialize decoder at a block boundary of a partially received image
+ * @param dec Decoder state
+ * @param header Header of the image being resumed
+ * @param block_index Index of the next block to receive
+ * @param consumed Compressed stream offset of that block
+ * @param output Output callback
+ * @param output_ctx Output callback context
+ */
+void ota_lz_decoder_resume(ota_lz_decoder_t *dec, const ota_lz_header_t *header,
+                           uint32_t block_index, uint32_t consumed,
+                           ota_lz_output_cb_t output, void *output_ctx);
+
+/**
+ * @brief Feed compressed bytes to the decoder
+ * @param dec Decoder state
+ * @param data Compressed bytes
+ * @param len Number of bytes
+ * @return OTA_LZ_OK, OTA_LZ_DONE or an error code
+ */
+ota_lz_result_t ota_lz_decoder_feed(ota_lz_decoder_t *dec, const uint8_t *data, size_t len);
+
+/**
+ * @brief Decode a single block payload
+ * @param header Image header (bit widths)
+ * @param in Compressed payload
+ * @param in_len Payload length
+ * @param out Output buffer
+ * @param out_len Number of bytes the block must decode to
+ * @return OTA_LZ_OK or OTA_LZ_ERR_FORMAT
+ */
+ota_lz_result_t ota_lz_decode_block(const ota_lz_header_t *header, const uint8_t *in, size_t in_len,
+                                    uint8_t *out, size_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_LZ_H
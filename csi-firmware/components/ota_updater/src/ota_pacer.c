@@ -0,0 +1,96 @@
+/**
+ * @file ota_pacer.c
+ * @brief Adaptive pacing of OTA downloads against CSI load
+ * 
+ * The pacer reads the CSI pipeline through the registered probe: how full
+ * its queues are, and whether it dropped frames since the previous
+ * sample. A drop counts as full load. Both are measured in the pipeline
+ * itself, so the download's own CPU use and sleeps do not skew them.
+ */
+
+#include "ota_pacer.h"
+#include <string.h>
+#include <esp_log.h>
+
+static const char *TAG = "ota_pacer";
+
+// Weight of the newest sample in the smoothed load
+#define OTA_PACE_SMOOTHING      0.3f
+
+void ota_pacer_reset(ota_pacer_t *pacer, ota_load_probe_t probe, void *probe_ctx)
+{
+    if (!pacer) {
+        return;
+    }
+
+    memset(pacer, 0, sizeof(ota_pacer_t));
+    pacer->probe = probe;
+    pacer->probe_ctx = probe_ctx;
+}
+
+uint32_t ota_pacer_delay_for_load(float load)
+{
+    if (load <= OTA_PACE_LOAD_LOW) {
+        return 0;
+    }
+
+    if (load >= OTA_PACE_LOAD_HIGH) {
+        return OTA_PACE_MAX_DELAY_MS;
+    }
+
+    float scale = (load - OTA_PACE_LOAD_LOW) / (OTA_PACE_LOAD_HIGH - OTA_PACE_LOAD_LOW);
+    return (uint32_t)(scale * OTA_PACE_MAX_DELAY_MS);
+}
+
+/**
+ * @brief Load of the CSI pipeline as reported by the probe
+ * 
+ * Queue fill level, or full load when frames were dropped since the
+ * previous sample. The first sample only records the drop count.
+ */
+static float ota_pacer_sample_load(ota_pacer_t *pacer)
+{
+    if (!pacer->probe) {
+        return 0.0f;
+    }
+
+    ota_load_sample_t sample = {0};
+    if (!pacer->probe(&sample, pacer->probe_ctx)) {
+        return 0.0f;
+    }
+
+    bool dropped = pacer->have_drops && sample.frames_dropped != pacer->frames_dropped;
+    pacer->frames_dropped = sample.frames_dropped;
+    pacer->have_drops = true;
+    if (dropped) {
+        return 1.0f;
+    }
+
+    if (sample.queue_capacity == 0) {
+        return 0.0f;
+    }
+
+    float fill = (float)sample.queue_depth / (float)sample.queue_capacity;
+    return fill > 1.0f ? 1.0f : fill;
+}
+
+uint32_t ota_pacer_next_delay_ms(ota_pacer_t *pacer)
+{
+    if (!pacer) {
+        return 0;
+    }
+
+    float sample = ota_pacer_sample_load(pacer);
+
+    // React to rising load immediately, release the brake gradually
+    if (sample > pacer->load) {
+        pacer->load = sample;
+    } else {
+        pacer->load += (sample - pacer->load) * OTA_PACE_SMOOTHING;
+    }
+
+    uint32_t delay_ms = ota_pacer_delay_for_load(pacer->load);
+    ESP_LOGV(TAG, "sample=%.2f load=%.2f delay=%lums",
+             sample, pacer->load, (unsigned long)delay_ms);
+    return delay_ms;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file ota_pacer.h
+ * @brief Adaptive pacing of OTA downloads against CSI load
+ */
+
+#ifndef OTA_PACER_H
+#define OTA_PACER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ota_updater.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Load below which downloads run without any delay
+ */
+#define OTA_PACE_LOAD_LOW       0.25f
+
+/**
+ * @brief Load above which downloads are delayed by the maximum amount
+ */
+#define OTA_PACE_LOAD_HIGH      0.85f
+
+/**
+ * @brief Maximum delay inserted between two chunks
+ */
+#define OTA_PACE_MAX_DELAY_MS   250
+
+/**
+ * @brief OTA pacer state
+ */
+typedef struct {
+    ota_load_probe_t probe;     ///< Pipeline load probe
+    void *probe_ctx;            ///< Probe context
+    float load;                 ///< Smoothed load (0.0-1.0)
+    uint32_t frames_dropped;    ///< Pipeline drop count at last sample
+    bool have_drops;            ///< frames_dropped holds a sample
+} ota_pacer_t;
+
+/**
+ * @brief Reset pacer state
+ * @param pacer Pacer to reset
+ * @param probe Pipeline load probe (optional)
+ * @param probe_ctx Probe context
+ */
+void ota_pacer_reset(ota_pacer_t *pacer, ota_load_probe_t probe, void *probe_ctx);
+
+/**
+ * @brief Sample current load and compute the delay before the next chunk
+ * @param pacer Pacer state
+ * @return Delay in milliseconds (0 when the node is idle)
+ */
+uint32_t ota_pacer_next_delay_ms(ota_pacer_t *pacer);
+
+/**
+ * @brief Map a load value to a delay
+ * @param load Load value (0.0-1.0)
+ * @return Delay in milliseconds
+ */
+uint32_t ota_pacer_delay_for_load(float load);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_PACER_H
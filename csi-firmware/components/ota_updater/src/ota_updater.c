@@ -11,14 +11,20 @@
  */
 
 #include "ota_updater.h"
+#include "ota_pacer.h"
+#include "ota_lz.h"
+#include "ota_client.h"
 #include "mqtt_client_wrapper.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <sys/time.h>
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_ota_ops.h>
 #include <esp_partition.h>
+#include <spi_flash_mmap.h>
 #include <esp_https_ota.h>
 #include <esp_http_client.h>
 #include <esp_timer.h>
@@ -66,21 +72,71 @@ typedef struct {
     size_t downloaded_size;
     uint32_t start_time;
     
+    // Download pacing
+    ota_load_probe_t load_probe;
+    void *load_probe_ctx;
+    
+    // Cached version manifest
+    ota_manifest_cache_t manifest;
+    
 } ota_context_t;
 
+/**
+ * @brief Partial download checkpoint persisted in NVS
+ */
+typedef struct {
+    char url[128];              ///< Image URL the checkpoint belongs to
+    char etag[64];              ///< Server entity tag of the image
+    uint32_t image_size;        ///< Total (uncompressed) image size in bytes
+    uint32_t written;           ///< Bytes written to the update partition
+    uint8_t partial_sha256[32]; ///< SHA-256 of the first 'written' bytes
+    uint32_t source_offset;     ///< Offset in the downloaded stream matching 'written'
+    bool compressed;            ///< Stream is a compressed image
+    uint8_t lz_header[OTA_LZ_HEADER_SIZE]; ///< Header of a compressed stream
+} ota_resume_state_t;
+
+/**
+ * @brief Destination of downloaded image bytes
+ */
+typedef struct {
+    esp_ota_handle_t handle;        ///< OTA write handle
+    mbedtls_sha256_context *sha_ctx; ///< Hash of the uncompressed image
+    mbedtls_sha256_context checkpoint_sha; ///< sha_ctx as of the last checkpoint
+    ota_resume_state_t *resume;     ///< Checkpoint being maintained
+    ota_lz_decoder_t *decoder;      ///< Decoder for compressed streams
+    uint32_t pending;               ///< Bytes written past the checkpoint, in the current sector
+    uint32_t last_saved;            ///< Bytes covered by the last NVS checkpoint
+    esp_err_t error;                ///< First write error
+} ota_image_writer_t;
+
+/**
+ * @brief Response headers captured during a download request
+ */
+typedef struct {
+    char etag[64];              ///< ETag response header
+    char sha256_hex[65];        ///< X-Firmware-SHA256 response header
+    char content_type[48];      ///< Content-Type response header
+} ota_download_headers_t;
+
 static ota_context_t s_ota_ctx = {0};
 
 // Forward declarations
-static esp_err_t ota_check_task(void *param);
-static esp_err_t ota_update_task(void *param);
+static void ota_check_task(void *param);
+static void ota_update_task(void *param);
 static esp_err_t ota_download_and_install(const char *url);
 static esp_err_t ota_verify_firmware(const esp_partition_t *partition);
-static esp_err_t ota_check_version(const char *url, char *available_version, size_t version_len);
+static uint32_t ota_next_check_delay_ms(bool first);
+static esp_err_t ota_load_manifest_cache(void);
+static esp_err_t ota_save_manifest_cache(void);
 static void ota_report_progress(ota_status_t status, uint8_t progress);
 static void ota_timer_callback(TimerHandle_t xTimer);
 static esp_err_t ota_save_stats(void);
 static esp_err_t ota_load_stats(void);
 static esp_err_t ota_publish_status(const char *status_msg, const char *details);
+static esp_err_t ota_load_resume_state(ota_resume_state_t *state);
+static esp_err_t ota_save_resume_state(const ota_resume_state_t *state);
+static esp_err_t ota_download_attempt(const char *url, ota_resume_state_t *resume,
+                                      mbedtls_sha256_context *sha_ctx, ota_pacer_t *pacer);
 
 // MQTT topic definitions
 #define OTA_MQTT_TOPIC_STATUS "csi/ota/status"
@@ -91,6 +147,17 @@ static esp_err_t ota_publish_status(const char *status_msg, const char *details)
 #define NVS_NAMESPACE "ota_stats"
 #define NVS_KEY_STATS "stats"
 #define NVS_KEY_CONFIG "config"
+#define NVS_KEY_RESUME "resume"
+#define NVS_KEY_MANIFEST "manifest"
+
+// Download tuning
+#define OTA_CHUNK_SIZE            4096
+#define OTA_CHECKPOINT_INTERVAL   (64 * 1024)   // Bytes between NVS checkpoints
+#define OTA_MAX_ATTEMPTS          5
+#define OTA_RETRY_DELAY_MS        2000
+
+// Check scheduling
+#define OTA_CHECK_JITTER_PCT      20            // +/- spread of the check interval
 
 esp_err_t ota_updater_init(const ota_config_t *config)
 {
@@ -153,13 +220,14 @@ esp_err_t ota_updater_init(const ota_config_t *config)
     
     // Load saved statistics
     ota_load_stats();
+    ota_load_manifest_cache();
     
-    // Create timer for periodic checks
+    // Create timer for periodic checks, re-armed with a jittered period after every check
     if (config->auto_update && config->check_interval > 0) {
         s_ota_ctx.check_timer = xTimerCreate(
             "ota_check_timer",
-            pdMS_TO_TICKS(config->check_interval * 60000), // Convert minutes to ms
-            pdTRUE, // Auto reload
+            pdMS_TO_TICKS(ota_next_check_delay_ms(true)),
+            pdFALSE, // One shot
             NULL,
             ota_timer_callback
         );
@@ -193,14 +261,7 @@ esp_err_t ota_updater_start(void)
     
     ESP_LOGI(TAG, "Starting OTA updater service");
     
-    // Start periodic check timer if configured
-    if (s_ota_ctx.check_timer) {
-        xTimerStart(s_ota_ctx.check_timer, portMAX_DELAY);
-        ESP_LOGI(TAG, "Automatic update checks enabled (interval: %d minutes)", 
-                 s_ota_ctx.config.check_interval);
-    }
-    
-    // Create check task for manual checks
+    // Create check task, woken by the check timer
     BaseType_t ret = xTaskCreate(
         ota_check_task,
         "ota_check",
@@ -215,6 +276,14 @@ esp_err_t ota_updater_start(void)
         return ESP_ERR_NO_MEM;
     }
     
+    // Start periodic check timer if configured
+    if (s_ota_ctx.check_timer) {
+        uint32_t first_ms = ota_next_check_delay_ms(true);
+        xTimerChangePeriod(s_ota_ctx.check_timer, pdMS_TO_TICKS(first_ms), portMAX_DELAY);
+        ESP_LOGI(TAG, "Automatic update checks enabled (interval: %d minutes, first in %lu s)", 
+                 s_ota_ctx.config.check_interval, (unsigned long)(first_ms / 1000));
+    }
+    
     ota_publish_status("started", "OTA service active");
     return ESP_OK;
 }
@@ -285,6 +354,8 @@ esp_err_t ota_updater_deinit(void)
         s_ota_ctx.check_timer = NULL;
     }
     
+    ota_http_check_client_close();
+    
     if (s_ota_ctx.state_mutex) {
         vSemaphoreDelete(s_ota_ctx.state_mutex);
         s_ota_ctx.state_mutex = NULL;
@@ -319,16 +390,24 @@ esp_err_t ota_updater_check_for_updates(void)
     ota_report_progress(OTA_STATUS_CHECKING, 0);
     ota_publish_status("checking", "Checking for updates");
     
-    char available_version[32];
-    esp_err_t ret = ota_check_version(s_ota_ctx.config.update_url, 
-                                     available_version, sizeof(available_version));
+    ota_manifest_cache_t previous_manifest = s_ota_ctx.manifest;
+    
+    bool not_modified = false;
+    esp_err_t ret = ota_http_check_version(s_ota_ctx.config.update_url, s_ota_ctx.config.cert_pem,
+                                           &s_ota_ctx.manifest, &not_modified);
     
     if (ret == ESP_OK) {
+        const char *available_version = s_ota_ctx.manifest.version;
         strlcpy(s_ota_ctx.stats.available_version, available_version,
                 sizeof(s_ota_ctx.stats.available_version));
         
-        // Compare versions (simple string comparison for now)
-        if (strcmp(s_ota_ctx.firmware_version, available_version) != 0) {
+        if (not_modified) {
+            s_ota_ctx.stats.checks_not_modified++;
+        } else if (memcmp(&previous_manifest, &s_ota_ctx.manifest, sizeof(previous_manifest)) != 0) {
+            ota_save_manifest_cache();
+        }
+        
+        if (ota_updater_compare_versions(available_version, s_ota_ctx.firmware_version) > 0) {
             s_ota_ctx.stats.updates_available++;
             ESP_LOGI(TAG, "Update available: %s -> %s", 
                      s_ota_ctx.firmware_version, available_version);
@@ -495,6 +574,40 @@ esp_err_t ota_updater_update_config(const ota_config_t *config)
     return ret;
 }
 
+esp_err_t ota_updater_register_load_probe(ota_load_probe_t probe, void *user_ctx)
+{
+    if (!s_ota_ctx.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    xSemaphoreTake(s_ota_ctx.state_mutex, portMAX_DELAY);
+    s_ota_ctx.load_probe = probe;
+    s_ota_ctx.load_probe_ctx = user_ctx;
+    xSemaphoreGive(s_ota_ctx.state_mutex);
+    
+    return ESP_OK;
+}
+
+esp_err_t ota_updater_clear_resume_state(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    ret = nvs_erase_key(nvs_handle, NVS_KEY_RESUME);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        ret = ESP_OK;
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    
+    return ret;
+}
+
 esp_err_t ota_updater_rollback(void)
 {
     if (!s_ota_ctx.initialized || !s_ota_ctx.rollback_enabled) {
@@ -538,18 +651,37 @@ esp_err_t ota_updater_mark_valid(void)
 
 // Internal implementation functions
 
-static esp_err_t ota_check_task(void *param)
+static void ota_check_task(void *param)
 {
     while (s_ota_ctx.initialized) {
-        vTaskDelay(pdMS_TO_TICKS(60000)); // Check every minute for manual requests
-        // This task can be extended for more complex check logic
+        // Woken by the check timer; the timeout only re-evaluates 'initialized'
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(60000)) == 0) {
+            continue;
+        }
+        
+        if (s_ota_ctx.status == OTA_STATUS_IDLE || s_ota_ctx.status == OTA_STATUS_ERROR) {
+            ESP_LOGI(TAG, "Automatic update check triggered");
+            
+            // A failed check must not stop later automatic checks
+            xSemaphoreTake(s_ota_ctx.state_mutex, portMAX_DELAY);
+            if (s_ota_ctx.status == OTA_STATUS_ERROR && !s_ota_ctx.update_in_progress) {
+                s_ota_ctx.status = OTA_STATUS_IDLE;
+            }
+            xSemaphoreGive(s_ota_ctx.state_mutex);
+            
+            ota_updater_check_for_updates();
+        }
+        
+        if (s_ota_ctx.check_timer) {
+            xTimerChangePeriod(s_ota_ctx.check_timer,
+                               pdMS_TO_TICKS(ota_next_check_delay_ms(false)), portMAX_DELAY);
+        }
     }
     
     vTaskDelete(NULL);
-    return ESP_OK;
 }
 
-static esp_err_t ota_update_task(void *param)
+static void ota_update_task(void *param)
 {
     const char *url = (const char*)param;
     esp_err_t ret = ota_download_and_install(url);
@@ -581,81 +713,528 @@ static esp_err_t ota_update_task(void *param)
     }
     
     vTaskDelete(NULL);
-    return ret;
+}
+
+static esp_err_t ota_download_event_handler(esp_http_client_event_t *evt)
+{
+    ota_download_headers_t *headers = (ota_download_headers_t *)evt->user_data;
+    
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && headers) {
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            strlcpy(headers->etag, evt->header_value, sizeof(headers->etag));
+        } else if (strcasecmp(evt->header_key, "X-Firmware-SHA256") == 0) {
+            strlcpy(headers->sha256_hex, evt->header_value, sizeof(headers->sha256_hex));
+        } else if (strcasecmp(evt->header_key, "Content-Type") == 0) {
+            strlcpy(headers->content_type, evt->header_value, sizeof(headers->content_type));
+        }
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Hash the first 'length' bytes of a partition into a SHA-256 context
+ */
+static esp_err_t ota_hash_partition_prefix(const esp_partition_t *partition, size_t length,
+                                           mbedtls_sha256_context *sha_ctx)
+{
+    uint8_t buffer[1024];
+    size_t offset = 0;
+    
+    while (offset < length) {
+        size_t read_size = MIN(sizeof(buffer), length - offset);
+        esp_err_t ret = esp_partition_read(partition, offset, buffer, read_size);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        mbedtls_sha256_update_ret(sha_ctx, buffer, read_size);
+        offset += read_size;
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Snapshot the digest of everything hashed so far
+ */
+static void ota_snapshot_digest(const mbedtls_sha256_context *sha_ctx, uint8_t digest[32])
+{
+    mbedtls_sha256_context snapshot;
+    mbedtls_sha256_init(&snapshot);
+    mbedtls_sha256_clone(&snapshot, sha_ctx);
+    mbedtls_sha256_finish_ret(&snapshot, digest);
+    mbedtls_sha256_free(&snapshot);
+}
+
+/**
+ * @brief Validate a persisted checkpoint against the update partition
+ * 
+ * The partition prefix is re-hashed so a checkpoint is only trusted when
+ * flash still holds exactly the bytes it describes. On success the hash
+ * context is left primed to continue from the checkpoint.
+ */
+static bool ota_validate_resume_state(const char *url, const esp_partition_t *partition,
+                                      const ota_resume_state_t *state,
+                                      mbedtls_sha256_context *sha_ctx)
+{
+    if (state->written == 0 || strcmp(state->url, url) != 0) {
+        return false;
+    }
+    
+    if (state->written > partition->size || (state->written % SPI_FLASH_SEC_SIZE) != 0) {
+        return false;
+    }
+    
+    if (state->compressed) {
+        ota_lz_header_t header;
+        if (ota_lz_parse_header(state->lz_header, &header) != OTA_LZ_OK ||
+            header.block_size != SPI_FLASH_SEC_SIZE) {
+            return false;
+        }
+    } else if (state->source_offset != state->written) {
+        return false;
+    }
+    
+    if (ota_hash_partition_prefix(partition, state->written, sha_ctx) != ESP_OK) {
+        return false;
+    }
+    
+    uint8_t digest[32];
+    ota_snapshot_digest(sha_ctx, digest);
+    return memcmp(digest, state->partial_sha256, sizeof(digest)) == 0;
 }
 
 static esp_err_t ota_download_and_install(const char *url)
 {
     ESP_LOGI(TAG, "Starting OTA download from: %s", url);
     
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (!update_partition) {
+        ESP_LOGE(TAG, "No OTA update partition found");
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_ota_ctx.update_partition = update_partition;
+    
+    mbedtls_sha256_context sha_ctx;
+    mbedtls_sha256_init(&sha_ctx);
+    mbedtls_sha256_starts_ret(&sha_ctx, 0);
+    
+    // Pick up where a previous, interrupted download left off
+    ota_resume_state_t resume = {0};
+    if (ota_load_resume_state(&resume) == ESP_OK &&
+        ota_validate_resume_state(url, update_partition, &resume, &sha_ctx)) {
+        ESP_LOGI(TAG, "Resuming %s OTA download at %lu/%lu bytes",
+                 resume.compressed ? "compressed" : "raw",
+                 (unsigned long)resume.written, (unsigned long)resume.image_size);
+        s_ota_ctx.stats.downloads_resumed++;
+        s_ota_ctx.stats.bytes_resumed += resume.written;
+    } else {
+        memset(&resume, 0, sizeof(resume));
+        strlcpy(resume.url, url, sizeof(resume.url));
+        mbedtls_sha256_free(&sha_ctx);
+        mbedtls_sha256_init(&sha_ctx);
+        mbedtls_sha256_starts_ret(&sha_ctx, 0);
+    }
+    
+    ota_pacer_t pacer;
+    ota_pacer_reset(&pacer, s_ota_ctx.load_probe, s_ota_ctx.load_probe_ctx);
+    
+    esp_err_t ret = ESP_FAIL;
+    for (int attempt = 1; attempt <= OTA_MAX_ATTEMPTS && s_ota_ctx.update_in_progress; attempt++) {
+        ret = ota_download_attempt(url, &resume, &sha_ctx, &pacer);
+        if (ret == ESP_OK || ret == ESP_ERR_INVALID_CRC || ret == ESP_ERR_OTA_VALIDATE_FAILED) {
+            break;
+        }
+        
+        ESP_LOGW(TAG, "OTA download interrupted at %lu bytes (attempt %d/%d): %s",
+                 (unsigned long)resume.written, attempt, OTA_MAX_ATTEMPTS, esp_err_to_name(ret));
+        vTaskDelay(pdMS_TO_TICKS(OTA_RETRY_DELAY_MS * attempt));
+    }
+    
+    mbedtls_sha256_free(&sha_ctx);
+    
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    ota_updater_clear_resume_state();
+    ESP_LOGI(TAG, "OTA update completed successfully");
+    return ESP_OK;
+}
+
+/**
+ * @brief Record a checkpoint after a whole sector has been written
+ * 
+ * Only here do the bytes written since the last checkpoint count towards
+ * resume->written, so 'written', 'source_offset' and 'partial_sha256'
+ * always describe the same whole-sector prefix.
+ */
+static void ota_writer_checkpoint(ota_image_writer_t *writer, uint32_t source_offset)
+{
+    ota_resume_state_t *resume = writer->resume;
+    
+    resume->written += writer->pending;
+    writer->pending = 0;
+    resume->source_offset = source_offset;
+    ota_snapshot_digest(writer->sha_ctx, resume->partial_sha256);
+    mbedtls_sha256_free(&writer->checkpoint_sha);
+    mbedtls_sha256_init(&writer->checkpoint_sha);
+    mbedtls_sha256_clone(&writer->checkpoint_sha, writer->sha_ctx);
+    if (resume->written - writer->last_saved >= OTA_CHECKPOINT_INTERVAL) {
+        ota_save_resume_state(resume);
+        writer->last_saved = resume->written;
+    }
+}
+
+/**
+ * @brief Write uncompressed image bytes to flash and hash them
+ */
+static esp_err_t ota_writer_write(ota_image_writer_t *writer, const uint8_t *data, size_t len)
+{
+    esp_err_t ret = esp_ota_write(writer->handle, data, len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    mbedtls_sha256_update_ret(writer->sha_ctx, data, len);
+    writer->pending += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Drop everything written since the last checkpoint
+ * 
+ * The hash goes back to the checkpoint too, so the next attempt hashes
+ * the rewritten bytes of a partial sector exactly once.
+ */
+static void ota_writer_rewind(ota_image_writer_t *writer)
+{
+    writer->pending = 0;
+    mbedtls_sha256_free(writer->sha_ctx);
+    mbedtls_sha256_init(writer->sha_ctx);
+    mbedtls_sha256_clone(writer->sha_ctx, &writer->checkpoint_sha);
+}
+
+/**
+ * @brief Image bytes written to flash so far, checkpointed or not
+ */
+static uint32_t ota_writer_total(const ota_image_writer_t *writer)
+{
+    return writer->resume->written + writer->pending;
+}
+
+/**
+ * @brief Decoder output: one decoded block is exactly one flash sector
+ */
+static int ota_writer_decoded_block(const uint8_t *data, size_t len, void *user_ctx)
+{
+    ota_image_writer_t *writer = (ota_image_writer_t *)user_ctx;
+    
+    writer->error = ota_writer_write(writer, data, len);
+    if (writer->error != ESP_OK) {
+        return -1;
+    }
+    
+    ota_writer_checkpoint(writer, writer->decoder->consumed);
+    return 0;
+}
+
+/**
+ * @brief Run a single (possibly ranged) download request
+ * 
+ * Raw images are written on flash sector boundaries; compressed images are
+ * decoded one sector-sized block at a time. Either way every checkpoint
+ * covers whole, fully written sectors that can be resumed with
+ * esp_ota_resume().
+ */
+static esp_err_t ota_download_attempt(const char *url, ota_resume_state_t *resume,
+                                      mbedtls_sha256_context *sha_ctx, ota_pacer_t *pacer)
+{
+    const esp_partition_t *update_partition = s_ota_ctx.update_partition;
+    ota_download_headers_t headers = {0};
+    
     esp_http_client_config_t http_config = {
         .url = url,
         .timeout_ms = s_ota_ctx.config.timeout_ms,
         .keep_alive_enable = true,
+        .event_handler = ota_download_event_handler,
+        .user_data = &headers,
+        .buffer_size = OTA_CHUNK_SIZE,
     };
     
     // Add certificate if provided
     if (strlen(s_ota_ctx.config.cert_pem) > 0) {
         http_config.cert_pem = s_ota_ctx.config.cert_pem;
-        ESP_LOGI(TAG, "Using custom certificate for HTTPS verification");
     }
     
-    esp_https_ota_config_t ota_config = {
-        .http_config = &http_config,
-    };
+    esp_http_client_handle_t client = esp_http_client_init(&http_config);
+    if (!client) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    uint32_t source = resume->source_offset;
+    if (resume->written > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)source);
+        esp_http_client_set_header(client, "Range", range);
+        if (strlen(resume->etag) > 0) {
+            esp_http_client_set_header(client, "If-Range", resume->etag);
+        }
+    }
     
-    esp_https_ota_handle_t https_ota_handle = NULL;
-    esp_err_t ret = esp_https_ota_begin(&ota_config, &https_ota_handle);
+    esp_err_t ret = esp_http_client_open(client, 0);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to begin OTA: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(ret));
+        esp_http_client_cleanup(client);
         return ret;
     }
     
-    // Get image size for progress calculation
-    int image_len = esp_https_ota_get_image_len_read(https_ota_handle);
-    s_ota_ctx.total_size = image_len;
-    s_ota_ctx.downloaded_size = 0;
+    int content_length = esp_http_client_fetch_headers(client);
+    int status_code = esp_http_client_get_status_code(client);
+    
+    if (status_code == 200 && resume->written > 0) {
+        // Server ignored the range or the image changed: start over
+        ESP_LOGW(TAG, "Server sent full image, restarting download from zero");
+        source = 0;
+        resume->written = 0;
+        resume->source_offset = 0;
+        resume->compressed = false;
+        mbedtls_sha256_free(sha_ctx);
+        mbedtls_sha256_init(sha_ctx);
+        mbedtls_sha256_starts_ret(sha_ctx, 0);
+    } else if (status_code != 200 && status_code != 206) {
+        ESP_LOGE(TAG, "Unexpected HTTP status %d", status_code);
+        if (status_code == 416) {
+            // Checkpoint no longer matches the image on the server
+            memset(resume->url, 0, sizeof(resume->url));
+            resume->written = 0;
+            resume->source_offset = 0;
+            ota_updater_clear_resume_state();
+            mbedtls_sha256_free(sha_ctx);
+            mbedtls_sha256_init(sha_ctx);
+            mbedtls_sha256_starts_ret(sha_ctx, 0);
+        }
+        esp_http_client_cleanup(client);
+        return ESP_FAIL;
+    }
     
-    ESP_LOGI(TAG, "OTA image size: %d bytes", image_len);
+    if (content_length <= 0) {
+        ESP_LOGE(TAG, "Missing content length");
+        esp_http_client_cleanup(client);
+        return ESP_FAIL;
+    }
     
-    ota_report_progress(OTA_STATUS_DOWNLOADING, 0);
+    uint32_t stream_size = source + (uint32_t)content_length;
+    strlcpy(resume->etag, headers.etag, sizeof(resume->etag));
     
-    // Download and install firmware
-    while (1) {
-        ret = esp_https_ota_perform(https_ota_handle);
-        if (ret != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+    static uint8_t buffer[OTA_CHUNK_SIZE];
+    int data_read = 0;
+    
+    // A fresh download decides between raw and compressed on its first bytes
+    if (source == 0) {
+        data_read = esp_http_client_read(client, (char *)buffer, OTA_LZ_HEADER_SIZE);
+        if (data_read <= 0) {
+            esp_http_client_cleanup(client);
+            return ESP_FAIL;
+        }
+        resume->compressed = ota_lz_is_compressed(buffer, data_read) ||
+                             strcasecmp(headers.content_type, "application/x-csi-lz") == 0;
+    }
+    
+    ota_image_writer_t writer = {
+        .sha_ctx = sha_ctx,
+        .resume = resume,
+        .last_saved = resume->written,
+    };
+    
+    ota_lz_header_t lz_header = {0};
+    if (resume->compressed) {
+        writer.decoder = malloc(sizeof(ota_lz_decoder_t));
+        if (!writer.decoder) {
+            esp_http_client_cleanup(client);
+            return ESP_ERR_NO_MEM;
+        }
+        
+        if (source == 0) {
+            if (data_read < OTA_LZ_HEADER_SIZE ||
+                ota_lz_parse_header(buffer, &lz_header) != OTA_LZ_OK ||
+                lz_header.block_size != SPI_FLASH_SEC_SIZE || lz_header.raw_size == 0) {
+                ESP_LOGE(TAG, "Invalid compressed image header");
+                free(writer.decoder);
+                esp_http_client_cleanup(client);
+                return ESP_ERR_INVALID_CRC;
+            }
+            memcpy(resume->lz_header, buffer, OTA_LZ_HEADER_SIZE);
+            ota_lz_decoder_init(writer.decoder, ota_writer_decoded_block, &writer);
+        } else {
+            ota_lz_parse_header(resume->lz_header, &lz_header);
+            ota_lz_decoder_resume(writer.decoder, &lz_header,
+                                  resume->written / lz_header.block_size, source,
+                                  ota_writer_decoded_block, &writer);
+        }
+        resume->image_size = lz_header.raw_size;
+    } else {
+        resume->image_size = stream_size;
+    }
+    
+    if (resume->image_size > update_partition->size) {
+        ESP_LOGE(TAG, "Image too large for partition: %lu bytes", (unsigned long)resume->image_size);
+        free(writer.decoder);
+        esp_http_client_cleanup(client);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    if (resume->written > 0) {
+        ret = esp_ota_resume(update_partition, OTA_WITH_SEQUENTIAL_WRITES, resume->written, &writer.handle);
+    } else {
+        ret = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &writer.handle);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to begin OTA write: %s", esp_err_to_name(ret));
+        free(writer.decoder);
+        esp_http_client_cleanup(client);
+        return ret;
+    }
+    s_ota_ctx.ota_handle = writer.handle;
+    
+    mbedtls_sha256_init(&writer.checkpoint_sha);
+    mbedtls_sha256_clone(&writer.checkpoint_sha, sha_ctx);
+    
+    s_ota_ctx.total_size = resume->image_size;
+    s_ota_ctx.downloaded_size = resume->written;
+    ESP_LOGI(TAG, "OTA %s image: %lu bytes (%lu on the wire), starting at offset %lu",
+             resume->compressed ? "compressed" : "raw", (unsigned long)resume->image_size,
+             (unsigned long)stream_size, (unsigned long)source);
+    
+    ret = ESP_OK;
+    while (s_ota_ctx.update_in_progress) {
+        if (data_read > 0) {
+            if (writer.decoder) {
+                ota_lz_result_t lz_ret = ota_lz_decoder_feed(writer.decoder, buffer, data_read);
+                if (lz_ret == OTA_LZ_ERR_FORMAT) {
+                    ESP_LOGE(TAG, "Corrupt compressed image at offset %lu", (unsigned long)source);
+                    ret = ESP_ERR_INVALID_CRC;
+                    break;
+                } else if (lz_ret == OTA_LZ_ERR_OUTPUT) {
+                    ret = writer.error;
+                    break;
+                }
+            } else {
+                ret = ota_writer_write(&writer, buffer, data_read);
+                if (ret != ESP_OK) {
+                    break;
+                }
+                if (writer.pending == SPI_FLASH_SEC_SIZE) {
+                    ota_writer_checkpoint(&writer, ota_writer_total(&writer));
+                }
+            }
+            source += data_read;
+        }
+        
+        if (source >= stream_size) {
             break;
         }
         
         // Update progress
-        int data_read = esp_https_ota_get_image_len_read(https_ota_handle);
-        if (s_ota_ctx.total_size > 0) {
-            uint8_t new_progress = (data_read * 100) / s_ota_ctx.total_size;
-            if (new_progress != s_ota_ctx.progress) {
-                s_ota_ctx.progress = new_progress;
-                s_ota_ctx.downloaded_size = data_read;
-                ota_report_progress(OTA_STATUS_DOWNLOADING, s_ota_ctx.progress);
-            }
+        uint32_t written = ota_writer_total(&writer);
+        uint8_t new_progress = ((uint64_t)written * 100) / resume->image_size;
+        s_ota_ctx.downloaded_size = written;
+        if (new_progress != s_ota_ctx.progress) {
+            s_ota_ctx.progress = new_progress;
+            ota_report_progress(OTA_STATUS_DOWNLOADING, s_ota_ctx.progress);
+        }
+        
+        // Yield bandwidth and CPU to CSI ingestion when it needs it
+        uint32_t delay_ms = ota_pacer_next_delay_ms(pacer);
+        if (delay_ms > 0) {
+            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        } else {
+            taskYIELD();
         }
         
-        vTaskDelay(pdMS_TO_TICKS(100)); // Allow other tasks to run
+        // Raw writes never straddle a sector boundary
+        size_t to_read = sizeof(buffer);
+        if (!writer.decoder) {
+            to_read = MIN(to_read, SPI_FLASH_SEC_SIZE - writer.pending);
+        }
+        to_read = MIN(to_read, stream_size - source);
+        
+        data_read = esp_http_client_read(client, (char *)buffer, to_read);
+        if (data_read <= 0) {
+            ret = (data_read == 0) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+            break;
+        }
     }
     
+    esp_http_client_cleanup(client);
+    free(writer.decoder);
+    
+    if (ret == ESP_OK && ota_writer_total(&writer) < resume->image_size) {
+        ret = resume->compressed ? ESP_ERR_INVALID_SIZE : ESP_FAIL;
+    }
+    
+    if (ret != ESP_OK) {
+        // Bytes past the checkpoint are written and hashed again by the next attempt
+        ota_writer_rewind(&writer);
+    }
+    mbedtls_sha256_free(&writer.checkpoint_sha);
+    
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "OTA download failed: %s", esp_err_to_name(ret));
-        esp_https_ota_abort(https_ota_handle);
+        if (ret == ESP_ERR_INVALID_CRC) {
+            ota_updater_clear_resume_state();
+        } else if (resume->written > writer.last_saved) {
+            // Keep the last whole-sector checkpoint for the next attempt
+            ota_save_resume_state(resume);
+        }
+        esp_ota_abort(writer.handle);
+        s_ota_ctx.ota_handle = 0;
         return ret;
     }
     
-    // Verify downloaded firmware
+    // Verify against the hash of the uncompressed image
     ota_report_progress(OTA_STATUS_VERIFYING, 100);
     
+    uint8_t digest[32];
+    ota_snapshot_digest(sha_ctx, digest);
+    
+    char digest_hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(&digest_hex[i * 2], 3, "%02x", digest[i]);
+    }
+    
+    bool hash_mismatch = false;
+    if (resume->compressed) {
+        ota_lz_parse_header(resume->lz_header, &lz_header);
+        hash_mismatch = memcmp(digest, lz_header.sha256, sizeof(digest)) != 0;
+    }
+    if (strlen(headers.sha256_hex) == 64 && strcasecmp(digest_hex, headers.sha256_hex) != 0) {
+        hash_mismatch = true;
+    }
+    
+    if (hash_mismatch) {
+        ESP_LOGE(TAG, "Image hash mismatch: %s", digest_hex);
+        esp_ota_abort(writer.handle);
+        s_ota_ctx.ota_handle = 0;
+        ota_updater_clear_resume_state();
+        return ESP_ERR_INVALID_CRC;
+    }
+    ESP_LOGI(TAG, "Image hash verified: %s", digest_hex);
+    memcpy(s_ota_ctx.firmware_hash, digest, sizeof(s_ota_ctx.firmware_hash));
+    
+    ret = esp_ota_end(writer.handle);
+    s_ota_ctx.ota_handle = 0;
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "OTA end failed: %s", esp_err_to_name(ret));
+        ota_updater_clear_resume_state();
+        return ret;
+    }
+    
     if (s_ota_ctx.config.verify_signature) {
-        const esp_partition_t *update_partition = esp_https_ota_get_boot_partition();
         ret = ota_verify_firmware(update_partition);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Firmware verification failed: %s", esp_err_to_name(ret));
-            esp_https_ota_abort(https_ota_handle);
+            ota_updater_clear_resume_state();
             return ret;
         }
         ESP_LOGI(TAG, "Firmware verification successful");
@@ -664,13 +1243,12 @@ static esp_err_t ota_download_and_install(const char *url)
     // Complete the OTA update
     ota_report_progress(OTA_STATUS_INSTALLING, 100);
     
-    ret = esp_https_ota_finish(https_ota_handle);
+    ret = esp_ota_set_boot_partition(update_partition);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "OTA finish failed: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(ret));
         return ret;
     }
     
-    ESP_LOGI(TAG, "OTA update completed successfully");
     return ESP_OK;
 }
 
@@ -696,70 +1274,6 @@ static esp_err_t ota_verify_firmware(const esp_partition_t *partition)
     return ESP_OK;
 }
 
-static esp_err_t ota_check_version(const char *url, char *available_version, size_t version_len)
-{
-    // Create a version check URL by appending "/version.json" to the base URL
-    char version_url[256];
-    snprintf(version_url, sizeof(version_url), "%s/version.json", url);
-    
-    esp_http_client_config_t config = {
-        .url = version_url,
-        .timeout_ms = 10000,
-        .method = HTTP_METHOD_GET,
-    };
-    
-    if (strlen(s_ota_ctx.config.cert_pem) > 0) {
-        config.cert_pem = s_ota_ctx.config.cert_pem;
-    }
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        return ESP_ERR_NO_MEM;
-    }
-    
-    esp_err_t ret = esp_http_client_perform(client);
-    
-    if (ret == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        int content_length = esp_http_client_get_content_length(client);
-        
-        if (status_code == 200 && content_length > 0) {
-            char *buffer = malloc(content_length + 1);
-            if (buffer) {
-                int data_read = esp_http_client_read_response(client, buffer, content_length);
-                buffer[data_read] = '\0';
-                
-                // Parse JSON response
-                cJSON *json = cJSON_Parse(buffer);
-                if (json) {
-                    cJSON *version_item = cJSON_GetObjectItem(json, "version");
-                    if (version_item && cJSON_IsString(version_item)) {
-                        strlcpy(available_version, version_item->valuestring, version_len);
-                        ret = ESP_OK;
-                    } else {
-                        ret = ESP_ERR_NOT_FOUND;
-                    }
-                    cJSON_Delete(json);
-                } else {
-                    // Fallback: treat entire response as version string
-                    strlcpy(available_version, buffer, version_len);
-                    ret = ESP_OK;
-                }
-                
-                free(buffer);
-            } else {
-                ret = ESP_ERR_NO_MEM;
-            }
-        } else {
-            ESP_LOGW(TAG, "Version check failed: HTTP %d", status_code);
-            ret = ESP_ERR_HTTP_BASE + status_code;
-        }
-    }
-    
-    esp_http_client_cleanup(client);
-    return ret;
-}
-
 static void ota_report_progress(ota_status_t status, uint8_t progress)
 {
     // Call registered callback
@@ -797,7 +1311,7 @@ static void ota_report_progress(ota_status_t status, uint8_t progress)
         
         char *json_string = cJSON_Print(progress_json);
         if (json_string) {
-            mqtt_client_publish(OTA_MQTT_TOPIC_PROGRESS, json_string, 0, 0);
+            mqtt_client_publish(OTA_MQTT_TOPIC_PROGRESS, json_string, strlen(json_string), 0, 0);
             free(json_string);
         }
         
@@ -809,9 +1323,118 @@ static void ota_timer_callback(TimerHandle_t xTimer)
 {
     (void)xTimer;
     
-    if (s_ota_ctx.status == OTA_STATUS_IDLE) {
-        ESP_LOGI(TAG, "Automatic update check triggered");
-        ota_updater_check_for_updates();
+    // Checks block on the network, so run them on the check task rather than the timer task
+    if (s_ota_ctx.check_task_handle) {
+        xTaskNotifyGive(s_ota_ctx.check_task_handle);
+    }
+}
+
+/**
+ * @brief Delay until the next automatic check
+ * 
+ * The first check after boot lands anywhere in one interval so a fleet
+ * that rebooted together does not poll together; later checks are spread
+ * by +/- OTA_CHECK_JITTER_PCT so the phases do not line up again.
+ */
+static uint32_t ota_next_check_delay_ms(bool first)
+{
+    uint32_t interval_ms = (uint32_t)s_ota_ctx.config.check_interval * 60000U;
+    if (interval_ms == 0) {
+        return 60000;
+    }
+    
+    if (first) {
+        return 1000 + esp_random() % interval_ms;
+    }
+    
+    uint32_t spread = (uint32_t)(((uint64_t)interval_ms * OTA_CHECK_JITTER_PCT) / 100);
+    if (spread == 0) {
+        return interval_ms;
+    }
+    return interval_ms - spread + esp_random() % (2 * spread + 1);
+}
+
+/**
+ * @brief Compare one dot-separated pre-release identifier
+ */
+static int ota_compare_prerelease_ident(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    bool a_num = a_len > 0, b_num = b_len > 0;
+    for (size_t i = 0; i < a_len; i++) {
+        a_num &= isdigit((unsigned char)a[i]) != 0;
+    }
+    for (size_t i = 0; i < b_len; i++) {
+        b_num &= isdigit((unsigned char)b[i]) != 0;
+    }
+    
+    if (a_num && b_num) {
+        // Numeric identifiers compare by value
+        while (a_len > 1 && *a == '0') { a++; a_len--; }
+        while (b_len > 1 && *b == '0') { b++; b_len--; }
+        if (a_len != b_len) {
+            return a_len < b_len ? -1 : 1;
+        }
+        return memcmp(a, b, a_len);
+    }
+    if (a_num != b_num) {
+        // Numeric identifiers have lower precedence than alphanumeric ones
+        return a_num ? -1 : 1;
+    }
+    
+    int ret = memcmp(a, b, MIN(a_len, b_len));
+    if (ret != 0) {
+        return ret;
+    }
+    return (a_len == b_len) ? 0 : (a_len < b_len ? -1 : 1);
+}
+
+int ota_updater_compare_versions(const char *a, const char *b)
+{
+    if (!a || !b) {
+        return (a == b) ? 0 : (a ? 1 : -1);
+    }
+    
+    if (*a == 'v' || *a == 'V') a++;
+    if (*b == 'v' || *b == 'V') b++;
+    
+    if (!isdigit((unsigned char)*a) || !isdigit((unsigned char)*b)) {
+        // Not a version number, fall back to plain ordering
+        return strcmp(a, b);
+    }
+    
+    // Numeric core: major.minor.patch, missing components count as zero
+    for (int i = 0; i < 3; i++) {
+        unsigned long va = strtoul(a, (char **)&a, 10);
+        unsigned long vb = strtoul(b, (char **)&b, 10);
+        if (va != vb) {
+            return va < vb ? -1 : 1;
+        }
+        if (*a == '.') a++;
+        if (*b == '.') b++;
+    }
+    
+    // Build metadata does not take part in ordering
+    const char *a_pre = (*a == '-') ? a + 1 : NULL;
+    const char *b_pre = (*b == '-') ? b + 1 : NULL;
+    if (!a_pre || !b_pre) {
+        return (a_pre == b_pre) ? 0 : (a_pre ? -1 : 1);
+    }
+    
+    while (true) {
+        size_t a_len = strcspn(a_pre, ".+");
+        size_t b_len = strcspn(b_pre, ".+");
+        int ret = ota_compare_prerelease_ident(a_pre, a_len, b_pre, b_len);
+        if (ret != 0) {
+            return ret;
+        }
+        
+        bool a_more = a_pre[a_len] == '.';
+        bool b_more = b_pre[b_len] == '.';
+        if (!a_more || !b_more) {
+            return (a_more == b_more) ? 0 : (a_more ? 1 : -1);
+        }
+        a_pre += a_len + 1;
+        b_pre += b_len + 1;
     }
 }
 
@@ -831,6 +1454,43 @@ static esp_err_t ota_save_stats(void)
     return ret;
 }
 
+static esp_err_t ota_save_manifest_cache(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(nvs_handle, NVS_KEY_MANIFEST, &s_ota_ctx.manifest, sizeof(ota_manifest_cache_t));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    
+    return ret;
+}
+
+static esp_err_t ota_load_manifest_cache(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    
+    if (ret == ESP_OK) {
+        size_t required_size = sizeof(ota_manifest_cache_t);
+        ret = nvs_get_blob(nvs_handle, NVS_KEY_MANIFEST, &s_ota_ctx.manifest, &required_size);
+        if (ret == ESP_OK && required_size != sizeof(ota_manifest_cache_t)) {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+        nvs_close(nvs_handle);
+    }
+    
+    if (ret != ESP_OK) {
+        memset(&s_ota_ctx.manifest, 0, sizeof(ota_manifest_cache_t));
+    }
+    
+    return ret;
+}
+
 static esp_err_t ota_load_stats(void)
 {
     nvs_handle_t nvs_handle;
@@ -851,6 +1511,39 @@ static esp_err_t ota_load_stats(void)
     return ESP_OK;
 }
 
+static esp_err_t ota_load_resume_state(ota_resume_state_t *state)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    
+    if (ret == ESP_OK) {
+        size_t required_size = sizeof(ota_resume_state_t);
+        ret = nvs_get_blob(nvs_handle, NVS_KEY_RESUME, state, &required_size);
+        nvs_close(nvs_handle);
+    }
+    
+    return ret;
+}
+
+static esp_err_t ota_save_resume_state(const ota_resume_state_t *state)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(nvs_handle, NVS_KEY_RESUME, state, sizeof(ota_resume_state_t));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to persist OTA checkpoint: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
 static esp_err_t ota_publish_status(const char *status_msg, const char *details)
 {
     cJSON *status_json = cJSON_CreateObject();
@@ -877,7 +1570,7 @@ static esp_err_t ota_publish_status(const char *status_msg, const char *details)
     esp_err_t ret = ESP_ERR_NO_MEM;
     
     if (json_string) {
-        ret = mqtt_client_publish(OTA_MQTT_TOPIC_STATUS, json_string, 0, 1); // Retain message
+        ret = mqtt_client_publish(OTA_MQTT_TOPIC_STATUS, json_string, strlen(json_string), 0, 1); // Retain message
         free(json_string);
     }
     
@@ -3,6 +3,7 @@
  * @brief OTA Firmware Verification and Security
  */
 
+#include "ota_updater.h"
 #include <string.h>
 #include <esp_log.h>
 #include <esp_ota_ops.h>
@@ -163,11 +164,8 @@ esp_err_t ota_verify_version_compatibility(const char *current_version,
     ESP_LOGI(TAG, "Checking version compatibility: %s -> %s", 
              current_version, new_version);
     
-    // Simple version comparison
-    // In production, implement proper semantic versioning
-    
     // Check for downgrade protection
-    if (strcmp(new_version, current_version) <= 0) {
+    if (ota_updater_compare_versions(new_version, current_version) <= 0) {
         ESP_LOGW(TAG, "Downgrade or same version detected");
         // Allow same version for testing, reject in production
         // return ESP_ERR_NOT_SUPPORTED;
@@ -7,7 +7,20 @@
 #include <string.h>
 #include <unity.h>
 #include "ota_updater.h"
+#include "ota_pacer.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
+#ifdef CSI_HOST_BUILD
+#include <stdlib.h>
+#include "esp_host.h"
+#include "ota_client.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "spi_flash_mmap.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#endif
 
 static const char *TAG = "test_ota";
 
@@ -39,6 +52,9 @@ void test_ota_progress_callback(ota_status_t status, uint8_t progress, void *use
 
 void setUp(void)
 {
+    // Checkpoints, statistics and the manifest cache live in NVS
+    nvs_flash_init();
+    
     // Reset callback state
     callback_status = OTA_STATUS_IDLE;
     callback_progress = 0;
@@ -230,6 +246,139 @@ void test_ota_rollback_operations(void)
     // In test environment, this might return ESP_ERR_NOT_FOUND
 }
 
+static bool test_ota_load_probe(ota_load_sample_t *sample, void *user_ctx)
+{
+    sample->queue_depth = 3;
+    sample->queue_capacity = 10;
+    return true;
+}
+
+void test_ota_load_probe_registration(void)
+{
+    ESP_LOGI(TAG, "Testing OTA load probe registration");
+    
+    // Test without initialization
+    esp_err_t ret = ota_updater_register_load_probe(test_ota_load_probe, NULL);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, ret);
+    
+    ret = ota_updater_init(&test_config);
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+    
+    ret = ota_updater_register_load_probe(test_ota_load_probe, NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+    
+    // NULL probe turns pacing off
+    ret = ota_updater_register_load_probe(NULL, NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+}
+
+// Synthetic CSI pipeline load fed to the pacer
+static ota_load_sample_t s_pipeline;
+
+static bool test_pipeline_probe(ota_load_sample_t *sample, void *user_ctx)
+{
+    *sample = s_pipeline;
+    return true;
+}
+
+void test_ota_pacer_follows_queue_load(void)
+{
+    ESP_LOGI(TAG, "Testing OTA pacing against CSI queue load");
+    
+    ota_pacer_t pacer;
+    s_pipeline = (ota_load_sample_t){ .queue_depth = 0, .queue_capacity = 64 };
+    ota_pacer_reset(&pacer, test_pipeline_probe, NULL);
+    TEST_ASSERT_EQUAL(0, ota_pacer_next_delay_ms(&pacer));
+    
+    // Filling queues brake the download at once
+    s_pipeline.queue_depth = 32;
+    uint32_t half = ota_pacer_next_delay_ms(&pacer);
+    TEST_ASSERT_TRUE(half > 0 && half < OTA_PACE_MAX_DELAY_MS);
+    s_pipeline.queue_depth = 60;
+    TEST_ASSERT_EQUAL(OTA_PACE_MAX_DELAY_MS, ota_pacer_next_delay_ms(&pacer));
+    
+    // Draining queues release the brake step by step, down to full speed
+    s_pipeline.queue_depth = 0;
+    uint32_t previous = OTA_PACE_MAX_DELAY_MS;
+    uint32_t delay = 0;
+    int steps = 0;
+    do {
+        delay = ota_pacer_next_delay_ms(&pacer);
+        TEST_ASSERT_TRUE(delay <= previous);
+        previous = delay;
+        steps++;
+    } while (delay > 0 && steps < 50);
+    TEST_ASSERT_EQUAL(0, delay);
+    TEST_ASSERT_TRUE(steps > 2);
+}
+
+void test_ota_pacer_brakes_on_drops(void)
+{
+    ESP_LOGI(TAG, "Testing OTA pacing against CSI frame drops");
+    
+    // Drops from before the download started do not count
+    ota_pacer_t pacer;
+    s_pipeline = (ota_load_sample_t){ .queue_depth = 0, .queue_capacity = 64, .frames_dropped = 100 };
+    ota_pacer_reset(&pacer, test_pipeline_probe, NULL);
+    TEST_ASSERT_EQUAL(0, ota_pacer_next_delay_ms(&pacer));
+    TEST_ASSERT_EQUAL(0, ota_pacer_next_delay_ms(&pacer));
+    
+    // A new drop means full load, even with empty queues
+    s_pipeline.frames_dropped = 101;
+    TEST_ASSERT_EQUAL(OTA_PACE_MAX_DELAY_MS, ota_pacer_next_delay_ms(&pacer));
+    
+    // No further drops: the brake releases
+    uint32_t delay = OTA_PACE_MAX_DELAY_MS;
+    for (int i = 0; i < 50 && delay > 0; i++) {
+        delay = ota_pacer_next_delay_ms(&pacer);
+    }
+    TEST_ASSERT_EQUAL(0, delay);
+    
+    // Without a probe there is nothing to pace against
+    ota_pacer_reset(&pacer, NULL, NULL);
+    TEST_ASSERT_EQUAL(0, ota_pacer_next_delay_ms(&pacer));
+}
+
+void test_ota_clear_resume_state(void)
+{
+    ESP_LOGI(TAG, "Testing OTA resume state reset");
+    
+    esp_err_t ret = ota_updater_init(&test_config);
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+    
+    // Clearing is idempotent, with or without a stored checkpoint
+    ret = ota_updater_clear_resume_state();
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+    
+    ret = ota_updater_clear_resume_state();
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+    
+    ota_stats_t stats;
+    ret = ota_updater_get_stats(&stats);
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+    TEST_ASSERT_EQUAL(0, stats.downloads_resumed);
+}
+
+void test_ota_compare_versions(void)
+{
+    ESP_LOGI(TAG, "Testing semantic version ordering");
+    
+    TEST_ASSERT_EQUAL(0, ota_updater_compare_versions("1.0.0", "1.0.0"));
+    TEST_ASSERT_EQUAL(0, ota_updater_compare_versions("v1.2", "1.2.0"));
+    TEST_ASSERT_EQUAL(0, ota_updater_compare_versions("1.0.0+build.5", "1.0.0+build.7"));
+    
+    // Numeric components compare by value, not as strings
+    TEST_ASSERT_TRUE(ota_updater_compare_versions("1.0.10", "1.0.9") > 0);
+    TEST_ASSERT_TRUE(ota_updater_compare_versions("2.0.0", "10.0.0") < 0);
+    
+    // Pre-releases order before the release
+    TEST_ASSERT_TRUE(ota_updater_compare_versions("1.2.0-rc.1", "1.2.0") < 0);
+    TEST_ASSERT_TRUE(ota_updater_compare_versions("1.0.0-alpha", "1.0.0-alpha.1") < 0);
+    TEST_ASSERT_TRUE(ota_updater_compare_versions("1.0.0-alpha.1", "1.0.0-alpha.beta") < 0);
+    TEST_ASSERT_TRUE(ota_updater_compare_versions("1.0.0-beta.2", "1.0.0-beta.11") < 0);
+    TEST_ASSERT_TRUE(ota_updater_compare_versions("1.0.0-beta.11", "1.0.0-rc.1") < 0);
+}
+
 void test_ota_multiple_operations(void)
 {
     ESP_LOGI(TAG, "Testing multiple OTA operations");
@@ -291,6 +440,144 @@ void test_ota_stress_test(void)
     }
 }
 
+#ifdef CSI_HOST_BUILD
+#define TEST_IMAGE_SIZE     150000
+#define TEST_DROP_AFTER     70000       // Mid-sector, past the 64 KiB checkpoint
+
+static struct {
+    uint8_t image[TEST_IMAGE_SIZE];
+    char sha256_hex[65];
+    int requests;
+    long range_start;                   // Range of the last request, -1 if none
+} s_origin;
+
+/**
+ * @brief Origin serving one raw image, dropping the first connection mid-sector
+ */
+static void test_ota_origin(const char *url, const char *headers,
+                            esp_host_http_response_t *response, void *ctx)
+{
+    s_origin.requests++;
+    s_origin.range_start = -1;
+    const char *range = strstr(headers, "Range: bytes=");
+    if (range) {
+        s_origin.range_start = strtol(range + strlen("Range: bytes="), NULL, 10);
+    }
+    
+    size_t start = s_origin.range_start > 0 ? (size_t)s_origin.range_start : 0;
+    response->status = start > 0 ? 206 : 200;
+    snprintf(response->headers, sizeof(response->headers),
+             "Content-Type: application/octet-stream\r\n"
+             "ETag: \"test-image\"\r\n"
+             "X-Firmware-SHA256: %s\r\n", s_origin.sha256_hex);
+    response->body = s_origin.image + start;
+    response->body_len = TEST_IMAGE_SIZE - start;
+    if (s_origin.requests == 1) {
+        response->drop_after = TEST_DROP_AFTER;
+    }
+}
+
+void test_ota_resume_mid_sector(void)
+{
+    ESP_LOGI(TAG, "Testing OTA resume after a connection drop mid-sector");
+    
+    for (size_t i = 0; i < TEST_IMAGE_SIZE; i++) {
+        s_origin.image[i] = (uint8_t)(i * 31 + (i >> 12));
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_ret(s_origin.image, TEST_IMAGE_SIZE, digest, 0);
+    for (int i = 0; i < 32; i++) {
+        snprintf(&s_origin.sha256_hex[i * 2], 3, "%02x", digest[i]);
+    }
+    s_origin.requests = 0;
+    esp_host_http_set_handler(test_ota_origin, NULL);
+    esp_host_trap_restart(true);
+    uint32_t restarts = esp_host_restart_count();
+    
+    ota_config_t config = test_config;
+    config.verify_signature = false;    // The test image carries no app descriptor
+    TEST_ASSERT_EQUAL(ESP_OK, ota_updater_init(&config));
+    TEST_ASSERT_EQUAL(ESP_OK, ota_updater_clear_resume_state());
+    TEST_ASSERT_EQUAL(ESP_OK, ota_updater_start_update("https://example.com/firmware.bin"));
+    
+    // One retry delay, then the reboot delay after success
+    for (int i = 0; i < 200 && esp_host_restart_count() == restarts; i++) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    
+    // The second request picks up at the last whole sector, not where the drop was
+    TEST_ASSERT_EQUAL(OTA_STATUS_SUCCESS, ota_updater_get_status());
+    TEST_ASSERT_EQUAL(restarts + 1, esp_host_restart_count());
+    TEST_ASSERT_EQUAL(2, s_origin.requests);
+    TEST_ASSERT_TRUE(s_origin.range_start > 0);
+    TEST_ASSERT_TRUE(s_origin.range_start <= TEST_DROP_AFTER);
+    TEST_ASSERT_EQUAL(0, s_origin.range_start % SPI_FLASH_SEC_SIZE);
+    
+    // The digest check passed, and the partition holds the image
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_EQUAL_PTR(update_partition, esp_ota_get_boot_partition());
+    static uint8_t written[TEST_IMAGE_SIZE];
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_read(update_partition, 0, written, TEST_IMAGE_SIZE));
+    TEST_ASSERT_EQUAL_MEMORY(s_origin.image, written, TEST_IMAGE_SIZE);
+    
+    esp_ota_set_boot_partition(esp_ota_get_running_partition());
+    esp_host_http_set_handler(NULL, NULL);
+    esp_host_trap_restart(false);
+}
+
+static struct {
+    int requests;
+    bool conditional;                   // Last request carried If-None-Match
+} s_manifest_origin;
+
+/**
+ * @brief Origin whose manifests all share one ETag, whatever the server
+ */
+static void test_manifest_origin(const char *url, const char *headers,
+                                 esp_host_http_response_t *response, void *ctx)
+{
+    static const char manifest[] = "{\"version\": \"2.0.0\"}";
+    
+    s_manifest_origin.requests++;
+    s_manifest_origin.conditional = strstr(headers, "If-None-Match: \"manifest\"") != NULL;
+    response->status = s_manifest_origin.conditional ? 304 : 200;
+    snprintf(response->headers, sizeof(response->headers), "ETag: \"manifest\"\r\n");
+    if (!s_manifest_origin.conditional) {
+        response->body = (const uint8_t *)manifest;
+        response->body_len = strlen(manifest);
+    }
+}
+
+void test_ota_manifest_cache_per_url(void)
+{
+    ESP_LOGI(TAG, "Testing the manifest cache is keyed by update URL");
+    
+    memset(&s_manifest_origin, 0, sizeof(s_manifest_origin));
+    esp_host_http_set_handler(test_manifest_origin, NULL);
+    
+    ota_manifest_cache_t cache = {0};
+    bool not_modified = true;
+    TEST_ASSERT_EQUAL(ESP_OK, ota_http_check_version("https://a.example.com", NULL, &cache, &not_modified));
+    TEST_ASSERT_FALSE(not_modified);
+    TEST_ASSERT_EQUAL_STRING("2.0.0", cache.version);
+    
+    // Same server: revalidated
+    TEST_ASSERT_EQUAL(ESP_OK, ota_http_check_version("https://a.example.com", NULL, &cache, &not_modified));
+    TEST_ASSERT_TRUE(s_manifest_origin.conditional);
+    TEST_ASSERT_TRUE(not_modified);
+    
+    // Another server: fetched in full, and the cache now belongs to it
+    TEST_ASSERT_EQUAL(ESP_OK, ota_http_check_version("https://b.example.com", NULL, &cache, &not_modified));
+    TEST_ASSERT_FALSE(s_manifest_origin.conditional);
+    TEST_ASSERT_FALSE(not_modified);
+    TEST_ASSERT_EQUAL_STRING("https://b.example.com", cache.url);
+    TEST_ASSERT_EQUAL(3, s_manifest_origin.requests);
+    
+    ota_http_check_client_close();
+    esp_host_http_set_handler(NULL, NULL);
+}
+#endif
+
 // Main test runner
 void app_main(void)
 {
@@ -307,6 +594,15 @@ void app_main(void)
     RUN_TEST(test_ota_start_update_invalid_args);
     RUN_TEST(test_ota_cancel_update);
     RUN_TEST(test_ota_rollback_operations);
+    RUN_TEST(test_ota_load_probe_registration);
+    RUN_TEST(test_ota_pacer_follows_queue_load);
+    RUN_TEST(test_ota_pacer_brakes_on_drops);
+    RUN_TEST(test_ota_clear_resume_state);
+    RUN_TEST(test_ota_compare_versions);
+#ifdef CSI_HOST_BUILD
+    RUN_TEST(test_ota_resume_mid_sector);
+    RUN_TEST(test_ota_manifest_cache_per_url);
+#endif
     RUN_TEST(test_ota_multiple_operations);
     RUN_TEST(test_ota_stress_test);
     
@@ -82,6 +82,26 @@ esp_err_t web_server_reset_stats(void);
  */
 esp_err_t web_server_update_config(const web_server_config_t *config);
 
+/**
+ * @brief Check if any WebSocket client is connected to /ws
+ * @return true if at least one client is connected
+ */
+bool web_server_ws_has_clients(void);
+
+/**
+ * @brief Send a message to every WebSocket client on /ws
+ * 
+ * The data is copied and the sends run on the server task, so this never
+ * blocks on a slow client.
+ * 
+ * @param data Message
+ * @param len Message length
+ * @param binary Send as a binary frame rather than text
+ * @return ESP_OK if queued for every client, ESP_ERR_NOT_FOUND if there are
+ *         no clients, error code on failure
+ */
+esp_err_t web_server_ws_broadcast(const void *data, size_t len, bool binary);
+
 #ifdef __cplusplus
 }
 #endif
@@ -59,6 +59,17 @@ static esp_err_t websocket_handler(httpd_req_t *req);
 static bool authenticate_request(httpd_req_t *req);
 static void update_stats(size_t bytes_sent, size_t bytes_received);
 
+/**
+ * @brief WebSocket message waiting for the server task
+ */
+typedef struct {
+    httpd_handle_t server;
+    int fd;
+    bool binary;
+    size_t len;
+    uint8_t data[];
+} ws_send_job_t;
+
 esp_err_t web_server_start(const web_server_config_t *config)
 {
     if (!config) {
@@ -66,6 +77,11 @@ esp_err_t web_server_start(const web_server_config_t *config)
         return ESP_ERR_INVALID_ARG;
     }
 
+    if (config->port == 0) {
+        ESP_LOGE(TAG, "Invalid port");
+        return ESP_ERR_INVALID_ARG;
+    }
+
     if (s_ctx.running) {
         ESP_LOGW(TAG, "Web server already running");
         return ESP_OK;
@@ -88,6 +104,7 @@ esp_err_t web_server_start(const web_server_config_t *config)
     server_config.stack_size = 8192;
     server_config.task_priority = 5;
     server_config.lru_purge_enable = true;
+    server_config.max_uri_handlers = 12; // The default of 8 leaves /ws unregistered
 
     // Start the HTTP server
     esp_err_t err = httpd_start(&s_ctx.server, &server_config);
@@ -236,6 +253,93 @@ esp_err_t web_server_reset_stats(void)
     return ESP_OK;
 }
 
+static void ws_send_work(void *arg)
+{
+    ws_send_job_t *job = (ws_send_job_t *)arg;
+
+    httpd_ws_frame_t ws_pkt = {
+        .final = true,
+        .type = job->binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT,
+        .payload = job->data,
+        .len = job->len
+    };
+    if (httpd_ws_send_frame_async(job->server, job->fd, &ws_pkt) != ESP_OK) {
+        ESP_LOGD(TAG, "WebSocket send to fd %d failed", job->fd);
+    }
+
+    free(job);
+}
+
+bool web_server_ws_has_clients(void)
+{
+    if (!s_ctx.running) {
+        return false;
+    }
+
+    size_t fd_count = CONFIG_LWIP_MAX_SOCKETS;
+    int fds[CONFIG_LWIP_MAX_SOCKETS];
+    if (httpd_get_client_list(s_ctx.server, &fd_count, fds) != ESP_OK) {
+        return false;
+    }
+
+    for (size_t i = 0; i < fd_count; i++) {
+        if (httpd_ws_get_fd_info(s_ctx.server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t web_server_ws_broadcast(const void *data, size_t len, bool binary)
+{
+    if (!data || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_ctx.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t fd_count = CONFIG_LWIP_MAX_SOCKETS;
+    int fds[CONFIG_LWIP_MAX_SOCKETS];
+    esp_err_t err = httpd_get_client_list(s_ctx.server, &fd_count, fds);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t clients = 0;
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < fd_count; i++) {
+        if (httpd_ws_get_fd_info(s_ctx.server, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            continue;
+        }
+        clients++;
+
+        ws_send_job_t *job = malloc(sizeof(ws_send_job_t) + len);
+        if (!job) {
+            result = ESP_ERR_NO_MEM;
+            continue;
+        }
+        job->server = s_ctx.server;
+        job->fd = fds[i];
+        job->binary = binary;
+        job->len = len;
+        memcpy(job->data, data, len);
+
+        if (httpd_queue_work(s_ctx.server, ws_send_work, job) != ESP_OK) {
+            free(job);
+            result = ESP_FAIL;
+            continue;
+        }
+
+        xSemaphoreTake(s_ctx.mutex, portMAX_DELAY);
+        s_ctx.stats.bytes_sent += len;
+        xSemaphoreGive(s_ctx.mutex);
+    }
+
+    return clients ? result : ESP_ERR_NOT_FOUND;
+}
+
 esp_err_t web_server_update_config(const web_server_config_t *config)
 {
     if (!config) {
@@ -502,8 +606,12 @@ static esp_err_t api_csi_data_handler(httpd_req_t *req)
     esp_err_t err = csi_collector_get_data(&csi_data, pdMS_TO_TICKS(100));
     
     if (err == ESP_OK) {
+        // This frame will not reach the stream; account for its sequence number
+        csi_collector_record_drop(csi_data.sequence, CSI_DROP_HTTP_POLL);
+
         cJSON *json = cJSON_CreateObject();
         
+        cJSON_AddNumberToObject(json, "seq", csi_data.sequence);
         cJSON_AddNumberToObject(json, "timestamp", csi_data.timestamp);
         
         // MAC address as hex string
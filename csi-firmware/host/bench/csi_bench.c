@@ -0,0 +1,740 @@
+/**
+ * @file csi_bench.c
+ * @brief Throughput and per-stage cost of the CSI pipeline on the host
+ *
+ * Times each stage of the firmware's data path on identical input and
+ * reports ns/frame and frames/s:
+ *
+ *   ingest           csi_collector_inject(): radio callback, copy, buffer
+ *   ingest_features  the same with amplitude and phase computed
+ *   filter           csi_filter_process() with both history filters on
+ *   encode_json      csi_collector_data_to_json()
+ *   encode_binary    csi_collector_encode_frame()
+ *   encode_batch     BENCH_BATCH_FRAMES frames encoded back to back
+ *   mqtt_json        mqtt_client_publish_csi_data() until the broker has it
+ *   mqtt_binary      mqtt_client_publish_csi_frame() until the broker has it
+ *
+ * The difference between ingest_features and ingest is the cost of the
+ * feature kernels. Each stage is warmed up once, then runs --repeat times
+ * and the fastest run is kept: interference from the rest of the machine
+ * only ever adds time. Stages other than ingest that take less than
+ * BENCH_MIN_RUN_NS per repetition get proportionally more frames.
+ *
+ *     csi_bench --output bench.json
+ *     csi_bench --baseline bench/baseline.json --threshold 15
+ *     csi_bench --input trace.pcap --broker 127.0.0.1 --qos 1
+ *
+ * With --baseline every stage present in both runs is compared and the
+ * exit status is 3 when one got slower by more than --threshold percent.
+ * MQTT stages are only compared when the broker and QoS match. Baselines
+ * are machine-specific: regenerate the committed one with --output on the
+ * machine that runs the comparison. The default threshold allows for a
+ * shared single-core VM, where separate runs differ by up to a fifth; a
+ * dedicated runner can hold stages to 10% or less.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_host.h>
+#include <esp_log.h>
+#include "csi_collector.h"
+#include "csi_filter.h"
+#include "csi_replay.h"
+#include "mqtt_client_wrapper.h"
+
+#define BENCH_RESULT_VERSION        1
+#define BENCH_POOL_FRAMES           32      ///< Distinct frames cycled through every stage
+#define BENCH_MAX_REPEAT            15
+#define BENCH_BATCH_FRAMES          16
+#define BENCH_INGEST_BURST          48      ///< Injects per collector run, below the buffer capacity
+#define BENCH_INGEST_BUFFER_SIZE    4096    ///< Collector buffer_size: 64 frames of capacity
+#define BENCH_MQTT_WINDOW_BYTES     (16 * 1024) ///< Half the CSI outbox budget, so nothing is dropped
+#define BENCH_MIN_RUN_NS            200000000LL ///< Shortest repetition worth timing
+#define BENCH_MAX_RUN_FRAMES        10000000
+#define BENCH_CONNECT_WAIT_MS       5000
+#define BENCH_DRAIN_TIMEOUT_MS      10000
+
+static const char *TAG = "csi_bench";
+
+typedef enum {
+    BENCH_INGEST = 0,
+    BENCH_INGEST_FEATURES,
+    BENCH_FILTER,
+    BENCH_ENCODE_JSON,
+    BENCH_ENCODE_BINARY,
+    BENCH_ENCODE_BATCH,
+    BENCH_MQTT_JSON,
+    BENCH_MQTT_BINARY,
+    BENCH_STAGE_MAX,
+} bench_stage_t;
+
+static const char *s_stage_names[BENCH_STAGE_MAX] = {
+    "ingest", "ingest_features", "filter", "encode_json", "encode_binary",
+    "encode_batch", "mqtt_json", "mqtt_binary",
+};
+
+typedef struct {
+    uint32_t frames;                ///< Frames per repetition, more for cheap stages
+    uint32_t repeat;                ///< Repetitions per stage, fastest kept
+    uint16_t subcarriers;           ///< Subcarriers of synthetic frames
+    const char *input;              ///< Recording to take frames from, NULL for synthetic
+    const char *output;             ///< Results file
+    const char *baseline;           ///< Baseline to compare with
+    double threshold_pct;           ///< Allowed slowdown against the baseline
+    bool skip_mqtt;
+    mqtt_config_t mqtt;
+} bench_options_t;
+
+typedef struct {
+    bool measured;
+    uint64_t frames;                ///< Frames timed in the fastest repetition
+    double ns_per_frame;            ///< Fastest of the repetitions
+    double bytes_per_frame;         ///< Encoded size, 0 where it does not apply
+} bench_result_t;
+
+typedef struct {
+    wifi_csi_info_t info[BENCH_POOL_FRAMES];
+    int8_t buf[BENCH_POOL_FRAMES][CSI_REPLAY_MAX_CSI_LEN];
+    csi_data_t processed[BENCH_POOL_FRAMES];  ///< The same frames out of the collector
+    uint32_t count;
+} bench_pool_t;
+
+static bench_pool_t s_pool;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --frames N           minimum frames per repetition (default 5000)\n"
+            "  --repeat N           repetitions per stage, fastest kept, 1-%d (default 5)\n"
+            "  --subcarriers N      subcarriers of synthetic frames, 1-%d (default 64)\n"
+            "  --input FILE         take frames from a recording (see csi_replay.h)\n"
+            "  --broker HOST        MQTT broker; \"%s\" for the in-process broker (default)\n"
+            "  --port N             MQTT port (default 1883)\n"
+            "  --qos N              QoS of the MQTT stages (default 0)\n"
+            "  --no-mqtt            skip the MQTT stages\n"
+            "  --output FILE        write the results as JSON\n"
+            "  --baseline FILE      compare with earlier results\n"
+            "  --threshold PCT      slowdown that counts as a regression (default 25)\n",
+            prog, BENCH_MAX_REPEAT, CSI_REPLAY_MAX_CSI_LEN / 2, ESP_HOST_MQTT_LOOPBACK);
+}
+
+static bool parse_options(int argc, char **argv, bench_options_t *opt)
+{
+    opt->frames = 5000;
+    opt->repeat = 5;
+    opt->subcarriers = 64;
+    opt->threshold_pct = 25.0;
+    opt->mqtt = (mqtt_config_t){
+        .enabled = true,
+        .port = 1883,
+        .keepalive = 60,
+        .qos = 0,
+    };
+    snprintf(opt->mqtt.broker_url, sizeof(opt->mqtt.broker_url), "%s", ESP_HOST_MQTT_LOOPBACK);
+    snprintf(opt->mqtt.client_id, sizeof(opt->mqtt.client_id), "csi-bench");
+    snprintf(opt->mqtt.topic_prefix, sizeof(opt->mqtt.topic_prefix), "csi/bench");
+
+    static const struct option long_options[] = {
+        { "frames", required_argument, NULL, 'n' },
+        { "repeat", required_argument, NULL, 'r' },
+        { "subcarriers", required_argument, NULL, 's' },
+        { "input", required_argument, NULL, 'i' },
+        { "broker", required_argument, NULL, 'm' },
+        { "port", required_argument, NULL, 'P' },
+        { "qos", required_argument, NULL, 'q' },
+        { "no-mqtt", no_argument, NULL, 'N' },
+        { "output", required_argument, NULL, 'o' },
+        { "baseline", required_argument, NULL, 'b' },
+        { "threshold", required_argument, NULL, 't' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'n': opt->frames = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'r': opt->repeat = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 's': opt->subcarriers = (uint16_t)atoi(optarg); break;
+            case 'i': opt->input = optarg; break;
+            case 'm': snprintf(opt->mqtt.broker_url, sizeof(opt->mqtt.broker_url), "%s", optarg); break;
+            case 'P': opt->mqtt.port = (uint16_t)atoi(optarg); break;
+            case 'q': opt->mqtt.qos = (uint8_t)atoi(optarg); break;
+            case 'N': opt->skip_mqtt = true; break;
+            case 'o': opt->output = optarg; break;
+            case 'b': opt->baseline = optarg; break;
+            case 't': opt->threshold_pct = strtod(optarg, NULL); break;
+            default:
+                return false;
+        }
+    }
+    return optind == argc && opt->frames > 0 && opt->repeat >= 1 && opt->repeat <= BENCH_MAX_REPEAT &&
+           opt->subcarriers >= 1 && opt->subcarriers <= CSI_REPLAY_MAX_CSI_LEN / 2 &&
+           opt->mqtt.qos <= 2 && opt->threshold_pct >= 0;
+}
+
+// ===== INPUT =====
+
+static void pool_add(const wifi_csi_info_t *info)
+{
+    uint32_t i = s_pool.count++;
+    s_pool.info[i] = *info;
+    memcpy(s_pool.buf[i], info->buf, info->len);
+    s_pool.info[i].buf = s_pool.buf[i];
+}
+
+/**
+ * @brief Frames of a fixed pseudo-random multipath shape, identical on every run
+ */
+static void pool_synthesize(uint16_t subcarriers)
+{
+    uint32_t rng = 0x12345678;
+    wifi_csi_info_t info = {0};
+    int8_t buf[CSI_REPLAY_MAX_CSI_LEN];
+
+    for (uint32_t n = 0; n < BENCH_POOL_FRAMES; n++) {
+        for (uint16_t k = 0; k < subcarriers; k++) {
+            rng = rng * 1664525u + 1013904223u;
+            float noise = (float)((rng >> 24) & 0x0f) - 7.5f;
+            float angle = 0.2f * k + 0.05f * n;
+            buf[2 * k] = (int8_t)(40.0f * cosf(angle) + 20.0f * cosf(3.1f * angle) + noise);
+            buf[2 * k + 1] = (int8_t)(40.0f * sinf(angle) + 20.0f * sinf(3.1f * angle) - noise);
+        }
+        memset(&info, 0, sizeof(info));
+        uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, (uint8_t)(n % 4)};
+        memcpy(info.mac, mac, sizeof(mac));
+        info.rx_ctrl.rssi = -40 - (int)(n % 20);
+        info.rx_ctrl.channel = 6;
+        info.len = (uint16_t)(2 * subcarriers);
+        info.buf = buf;
+        pool_add(&info);
+    }
+}
+
+static esp_err_t pool_read(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    csi_replay_reader_handle_t reader;
+    esp_err_t err = csi_replay_reader_open(file, CSI_REPLAY_FORMAT_AUTO, &reader);
+    if (err == ESP_OK) {
+        csi_replay_record_t record;
+        while (s_pool.count < BENCH_POOL_FRAMES && csi_replay_reader_next(reader, &record) == ESP_OK) {
+            pool_add(&record.info);
+        }
+        csi_replay_reader_close(reader);
+        if (s_pool.count == 0) {
+            ESP_LOGE(TAG, "No CSI reports in %s", path);
+            err = ESP_ERR_NOT_FOUND;
+        }
+    }
+    fclose(file);
+    return err;
+}
+
+static csi_collector_config_t collector_config(uint8_t sample_rate, bool features)
+{
+    return (csi_collector_config_t){
+        .sample_rate = sample_rate,
+        .buffer_size = BENCH_INGEST_BUFFER_SIZE,
+        .filter_threshold = 0.5f,
+        .enable_rssi = true,
+        .enable_phase = features,
+        .enable_amplitude = features,
+    };
+}
+
+/**
+ * @brief Run the pool through the collector once, for the downstream stages
+ */
+static esp_err_t pool_process(void)
+{
+    csi_collector_config_t config = collector_config(100, true);
+    esp_err_t err = csi_collector_init(&config);
+    if (err == ESP_OK) {
+        err = csi_collector_start();
+    }
+    for (uint32_t i = 0; err == ESP_OK && i < s_pool.count; i++) {
+        err = csi_collector_inject(&s_pool.info[i], 1000);
+        if (err == ESP_OK) {
+            err = csi_collector_get_data(&s_pool.processed[i], 1000);
+        }
+    }
+    csi_collector_stop();
+    csi_collector_deinit();
+    return err;
+}
+
+static void pool_free(void)
+{
+    for (uint32_t i = 0; i < s_pool.count; i++) {
+        csi_collector_free_data(&s_pool.processed[i]);
+    }
+}
+
+// ===== STAGES =====
+// Each returns the time taken for *frames frames in ns, or -1 on failure.
+
+static int64_t run_ingest(uint32_t frames, bool features, uint64_t *timed)
+{
+    // At 1 Hz the process task takes the first frame and then sleeps, so on
+    // a single core it does not preempt the injects being timed
+    csi_collector_config_t config = collector_config(1, features);
+    int64_t total = 0;
+    uint32_t done = 0;
+
+    // Each run stays under the buffer capacity and the collector is
+    // restarted for the next
+    while (done < frames) {
+        if (csi_collector_init(&config) != ESP_OK || csi_collector_start() != ESP_OK) {
+            csi_collector_deinit();
+            return -1;
+        }
+        uint32_t burst = frames - done < BENCH_INGEST_BURST ? frames - done : BENCH_INGEST_BURST;
+        int64_t start = now_ns();
+        for (uint32_t i = 0; i < burst; i++) {
+            csi_collector_inject(&s_pool.info[(done + i) % s_pool.count], 0);
+        }
+        total += now_ns() - start;
+
+        csi_collector_stats_t stats;
+        csi_collector_get_stats(&stats);
+        csi_collector_stop();
+        csi_collector_deinit();
+        if (stats.packets_received != burst || stats.drops[CSI_DROP_BUFFER_FULL] ||
+            stats.drops[CSI_DROP_NO_MEM]) {
+            ESP_LOGE(TAG, "Ingest dropped frames: %" PRIu32 " of %" PRIu32 " received",
+                     stats.packets_received, burst);
+            return -1;
+        }
+        done += burst;
+    }
+
+    *timed = done;
+    return total;
+}
+
+static int64_t run_filter(uint32_t frames, uint64_t *timed)
+{
+    csi_filter_config_t config = {
+        .threshold = 0.5f,
+        .enable_amplitude_filter = true,
+        .enable_phase_filter = true,
+    };
+    csi_filter_handle_t filter;
+    if (csi_filter_init(&filter, &config) != ESP_OK) {
+        return -1;
+    }
+
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < frames; i++) {
+        csi_filter_process(filter, &s_pool.processed[i % s_pool.count]);
+    }
+    int64_t elapsed = now_ns() - start;
+
+    csi_filter_deinit(filter);
+    *timed = frames;
+    return elapsed;
+}
+
+static int64_t run_encode_json(uint32_t frames, uint64_t *timed, uint64_t *bytes)
+{
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < frames; i++) {
+        char *json = csi_collector_data_to_json(&s_pool.processed[i % s_pool.count]);
+        if (!json) {
+            return -1;
+        }
+        *bytes += strlen(json);
+        free(json);
+    }
+    int64_t elapsed = now_ns() - start;
+
+    *timed = frames;
+    return elapsed;
+}
+
+static int64_t run_encode_binary(uint32_t frames, uint32_t batch, uint64_t *timed, uint64_t *bytes)
+{
+    size_t max_size = 0;
+    for (uint32_t i = 0; i < s_pool.count; i++) {
+        size_t size = csi_collector_frame_size(&s_pool.processed[i]);
+        max_size = size > max_size ? size : max_size;
+    }
+    uint8_t *out = malloc(max_size * batch);
+    if (!out) {
+        return -1;
+    }
+
+    uint32_t done = 0;
+    int64_t start = now_ns();
+    while (done < frames) {
+        size_t offset = 0;
+        for (uint32_t j = 0; j < batch; j++, done++) {
+            const csi_data_t *csi_data = &s_pool.processed[done % s_pool.count];
+            csi_collector_encode_frame(csi_data, out + offset);
+            offset += csi_collector_frame_size(csi_data);
+        }
+        *bytes += offset;
+    }
+    int64_t elapsed = now_ns() - start;
+
+    free(out);
+    *timed = done;
+    return elapsed;
+}
+
+static bool mqtt_outbox_idle(void)
+{
+    mqtt_outbox_stats_t outbox;
+    mqtt_client_get_outbox_stats(MQTT_CLASS_CSI, &outbox);
+    return outbox.queued_msgs == 0;
+}
+
+/**
+ * @brief Publish frames and wait until the client has written them all
+ *
+ * Publishing stops while the CSI outbox holds BENCH_MQTT_WINDOW_BYTES so
+ * its drop-oldest policy never kicks in; a drop fails the run instead of
+ * flattering it.
+ */
+static int64_t run_mqtt(uint32_t frames, bool binary, uint64_t *timed, uint64_t *bytes)
+{
+    mqtt_outbox_stats_t before;
+    esp_host_mqtt_stats_t client_before;
+    mqtt_client_get_outbox_stats(MQTT_CLASS_CSI, &before);
+    esp_host_mqtt_get_stats(&client_before);
+
+    int64_t start = now_ns();
+    for (uint32_t i = 0; i < frames; i++) {
+        for (;;) {
+            mqtt_outbox_stats_t outbox;
+            mqtt_client_get_outbox_stats(MQTT_CLASS_CSI, &outbox);
+            if (outbox.queued_bytes < BENCH_MQTT_WINDOW_BYTES) {
+                break;
+            }
+            taskYIELD();
+        }
+        const csi_data_t *csi_data = &s_pool.processed[i % s_pool.count];
+        esp_err_t err = binary ? mqtt_client_publish_csi_frame(csi_data)
+                               : mqtt_client_publish_csi_data(csi_data);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Publish failed: %s", esp_err_to_name(err));
+            return -1;
+        }
+    }
+
+    int64_t deadline = now_ns() + BENCH_DRAIN_TIMEOUT_MS * 1000000LL;
+    esp_host_mqtt_stats_t client;
+    for (;;) {
+        esp_host_mqtt_get_stats(&client);
+        if (client.publishes - client_before.publishes >= frames && mqtt_outbox_idle()) {
+            break;
+        }
+        if (now_ns() > deadline) {
+            ESP_LOGE(TAG, "Broker took %" PRIu32 " of %" PRIu32 " publishes",
+                     client.publishes - client_before.publishes, frames);
+            return -1;
+        }
+        taskYIELD();
+    }
+    int64_t elapsed = now_ns() - start;
+
+    mqtt_outbox_stats_t after;
+    mqtt_client_get_outbox_stats(MQTT_CLASS_CSI, &after);
+    if (after.dropped != before.dropped || after.expired != before.expired) {
+        ESP_LOGE(TAG, "Outbox dropped %" PRIu32 " frames", (after.dropped - before.dropped) +
+                 (after.expired - before.expired));
+        return -1;
+    }
+
+    *bytes += client.publish_bytes - client_before.publish_bytes;
+    *timed = frames;
+    return elapsed;
+}
+
+static int64_t run_stage(bench_stage_t stage, uint32_t frames, uint64_t *timed, uint64_t *bytes)
+{
+    switch (stage) {
+        case BENCH_INGEST:          return run_ingest(frames, false, timed);
+        case BENCH_INGEST_FEATURES: return run_ingest(frames, true, timed);
+        case BENCH_FILTER:          return run_filter(frames, timed);
+        case BENCH_ENCODE_JSON:     return run_encode_json(frames, timed, bytes);
+        case BENCH_ENCODE_BINARY:   return run_encode_binary(frames, 1, timed, bytes);
+        case BENCH_ENCODE_BATCH:    return run_encode_binary(frames, BENCH_BATCH_FRAMES, timed, bytes);
+        case BENCH_MQTT_JSON:       return run_mqtt(frames, false, timed, bytes);
+        case BENCH_MQTT_BINARY:     return run_mqtt(frames, true, timed, bytes);
+        default:                    return -1;
+    }
+}
+
+static esp_err_t measure(bench_stage_t stage, const bench_options_t *opt, bench_result_t *result)
+{
+    double best = INFINITY;
+    uint64_t timed = 0;
+    uint64_t bytes = 0;
+
+    // Warm-up, which also scales cheap stages up to a run long enough to time
+    uint64_t frames = 0;
+    int64_t elapsed = run_stage(stage, opt->frames, &frames, &bytes);
+    if (elapsed < 0 || frames == 0) {
+        return ESP_FAIL;
+    }
+    // Ingest restarts the collector every BENCH_INGEST_BURST frames, which
+    // costs far more than the frames themselves; it is not scaled
+    uint32_t run_frames = opt->frames;
+    bool scalable = stage != BENCH_INGEST && stage != BENCH_INGEST_FEATURES;
+    if (scalable && elapsed < BENCH_MIN_RUN_NS) {
+        double scale = ceil((double)BENCH_MIN_RUN_NS / (elapsed > 0 ? elapsed : 1));
+        run_frames = (uint32_t)fmin((double)opt->frames * scale, BENCH_MAX_RUN_FRAMES);
+    }
+
+    for (uint32_t r = 0; r < opt->repeat; r++) {
+        uint64_t run_bytes = 0;
+        frames = 0;
+        elapsed = run_stage(stage, run_frames, &frames, &run_bytes);
+        if (elapsed < 0 || frames == 0) {
+            return ESP_FAIL;
+        }
+        double ns_per_frame = (double)elapsed / frames;
+        if (ns_per_frame < best) {
+            best = ns_per_frame;
+            timed = frames;
+            bytes = run_bytes;
+        }
+    }
+
+    result->measured = true;
+    result->frames = timed;
+    result->ns_per_frame = best;
+    result->bytes_per_frame = (double)bytes / timed;
+    return ESP_OK;
+}
+
+// ===== RESULTS =====
+
+static cJSON *results_to_json(const bench_options_t *opt, const bench_result_t results[BENCH_STAGE_MAX])
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "version", BENCH_RESULT_VERSION);
+
+    cJSON *config = cJSON_AddObjectToObject(json, "config");
+    cJSON_AddNumberToObject(config, "frames", opt->frames);
+    cJSON_AddNumberToObject(config, "repeat", opt->repeat);
+    cJSON_AddNumberToObject(config, "subcarriers", opt->input ? 0 : opt->subcarriers);
+    cJSON_AddStringToObject(config, "input", opt->input ? opt->input : "synthetic");
+    cJSON_AddStringToObject(config, "broker", opt->mqtt.broker_url);
+    cJSON_AddNumberToObject(config, "qos", opt->mqtt.qos);
+
+    cJSON *stages = cJSON_AddObjectToObject(json, "stages");
+    for (int i = 0; i < BENCH_STAGE_MAX; i++) {
+        if (!results[i].measured) {
+            continue;
+        }
+        cJSON *stage = cJSON_AddObjectToObject(stages, s_stage_names[i]);
+        cJSON_AddNumberToObject(stage, "frames", results[i].frames);
+        cJSON_AddNumberToObject(stage, "ns_per_frame", round(results[i].ns_per_frame * 10) / 10);
+        cJSON_AddNumberToObject(stage, "frames_per_s", round(1e9 / results[i].ns_per_frame));
+        if (results[i].bytes_per_frame > 0) {
+            cJSON_AddNumberToObject(stage, "bytes_per_frame", round(results[i].bytes_per_frame * 10) / 10);
+        }
+    }
+    return json;
+}
+
+static cJSON *read_json(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = size > 0 ? malloc(size + 1) : NULL;
+    cJSON *json = NULL;
+    if (text && fread(text, 1, size, file) == (size_t)size) {
+        text[size] = '\0';
+        json = cJSON_Parse(text);
+    }
+    free(text);
+    fclose(file);
+    return json;
+}
+
+static bool same_string(const cJSON *a, const cJSON *b, const char *key)
+{
+    const cJSON *x = cJSON_GetObjectItem(a, key);
+    const cJSON *y = cJSON_GetObjectItem(b, key);
+    return cJSON_IsString(x) && cJSON_IsString(y) && strcmp(x->valuestring, y->valuestring) == 0;
+}
+
+static bool same_number(const cJSON *a, const cJSON *b, const char *key)
+{
+    const cJSON *x = cJSON_GetObjectItem(a, key);
+    const cJSON *y = cJSON_GetObjectItem(b, key);
+    return cJSON_IsNumber(x) && cJSON_IsNumber(y) && x->valuedouble == y->valuedouble;
+}
+
+/**
+ * @brief Print the results, against the baseline when there is one
+ * @return Number of stages slower than the threshold allows
+ */
+static int report(const bench_options_t *opt, const cJSON *current, const cJSON *baseline)
+{
+    const cJSON *stages = cJSON_GetObjectItem(current, "stages");
+    const cJSON *base_stages = cJSON_GetObjectItem(baseline, "stages");
+    const cJSON *config = cJSON_GetObjectItem(current, "config");
+    const cJSON *base_config = cJSON_GetObjectItem(baseline, "config");
+    bool same_input = same_string(config, base_config, "input") &&
+                      same_number(config, base_config, "subcarriers");
+    bool same_broker = same_string(config, base_config, "broker") &&
+                       same_number(config, base_config, "qos");
+    int regressions = 0;
+
+    if (baseline && !same_input) {
+        printf("input differs from the baseline, nothing compared\n");
+    }
+    printf("%-16s %12s %12s %10s %12s %9s\n", "stage", "ns/frame", "frames/s", "bytes", "baseline", "change");
+
+    const cJSON *stage;
+    cJSON_ArrayForEach(stage, stages) {
+        double ns = cJSON_GetObjectItem(stage, "ns_per_frame")->valuedouble;
+        const cJSON *bytes = cJSON_GetObjectItem(stage, "bytes_per_frame");
+        printf("%-16s %12.1f %12.0f ", stage->string, ns, cJSON_GetObjectItem(stage, "frames_per_s")->valuedouble);
+        if (bytes) {
+            printf("%10.1f ", bytes->valuedouble);
+        } else {
+            printf("%10s ", "-");
+        }
+
+        const cJSON *base = cJSON_GetObjectItem(base_stages, stage->string);
+        bool comparable = base && same_input && (strncmp(stage->string, "mqtt_", 5) != 0 || same_broker);
+        if (!comparable) {
+            printf("%12s %9s\n", "-", "-");
+            continue;
+        }
+        double base_ns = cJSON_GetObjectItem(base, "ns_per_frame")->valuedouble;
+        double change = base_ns > 0 ? (ns - base_ns) / base_ns * 100.0 : 0.0;
+        bool regressed = change > opt->threshold_pct;
+        regressions += regressed;
+        printf("%12.1f %+8.1f%%%s\n", base_ns, change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t opt = {0};
+    if (!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Every ingest run restarts the collector; its logs would swamp the table
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    cJSON *baseline = NULL;
+    if (opt.baseline) {
+        baseline = read_json(opt.baseline);
+        const cJSON *version = cJSON_GetObjectItem(baseline, "version");
+        if (!cJSON_IsNumber(version) || version->valueint != BENCH_RESULT_VERSION) {
+            ESP_LOGE(TAG, "%s is not a version %d result file", opt.baseline, BENCH_RESULT_VERSION);
+            cJSON_Delete(baseline);
+            return 2;
+        }
+    }
+
+    if (opt.input) {
+        if (pool_read(opt.input) != ESP_OK) {
+            cJSON_Delete(baseline);
+            return 2;
+        }
+    } else {
+        pool_synthesize(opt.subcarriers);
+    }
+    if (pool_process() != ESP_OK) {
+        ESP_LOGE(TAG, "Collector failed to process the input frames");
+        cJSON_Delete(baseline);
+        return 1;
+    }
+
+    if (!opt.skip_mqtt) {
+        esp_err_t err = mqtt_client_init(&opt.mqtt);
+        if (err == ESP_OK) {
+            err = mqtt_client_start();
+        }
+        for (int i = 0; err == ESP_OK && i < BENCH_CONNECT_WAIT_MS / 100 && !mqtt_client_is_connected(); i++) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        if (err != ESP_OK || !mqtt_client_is_connected()) {
+            ESP_LOGE(TAG, "Not connected to %s:%u", opt.mqtt.broker_url, opt.mqtt.port);
+            pool_free();
+            cJSON_Delete(baseline);
+            return 1;
+        }
+    }
+
+    bench_result_t results[BENCH_STAGE_MAX] = {0};
+    int status = 0;
+    for (int i = 0; i < BENCH_STAGE_MAX; i++) {
+        if (opt.skip_mqtt && (i == BENCH_MQTT_JSON || i == BENCH_MQTT_BINARY)) {
+            continue;
+        }
+        if (measure(i, &opt, &results[i]) != ESP_OK) {
+            ESP_LOGE(TAG, "Stage %s failed", s_stage_names[i]);
+            status = 1;
+            break;
+        }
+    }
+
+    if (!opt.skip_mqtt) {
+        mqtt_client_deinit();
+    }
+    pool_free();
+
+    cJSON *current = results_to_json(&opt, results);
+    int regressions = report(&opt, current, baseline);
+
+    if (opt.output) {
+        char *text = cJSON_Print(current);
+        FILE *file = fopen(opt.output, "w");
+        if (!text || !file || fprintf(file, "%s\n", text) < 0) {
+            ESP_LOGE(TAG, "Cannot write %s", opt.output);
+            status = 1;
+        }
+        if (file) {
+            fclose(file);
+        }
+        free(text);
+    }
+
+    cJSON_Delete(current);
+    cJSON_Delete(baseline);
+
+    if (status == 0 && regressions > 0) {
+        printf("%d stage(s) more than %.1f%% slower than the baseline\n", regressions, opt.threshold_pct);
+        status = 3;
+    }
+    return status;
+}
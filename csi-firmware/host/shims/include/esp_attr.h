@@ -0,0 +1,16 @@
+/**
+ * @file esp_attr.h
+ * @brief Host shim: memory placement attributes, all no-ops
+ */
+
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_BSS_ATTR
+#define NOINLINE_ATTR __attribute__((noinline))
+
+#endif // ESP_ATTR_H
@@ -0,0 +1,21 @@
+/**
+ * @file esp_crt_bundle.h
+ * @brief Host shim: certificate bundle hook, a no-op
+ */
+
+#ifndef _ESP_CRT_BUNDLE_H_
+#define _ESP_CRT_BUNDLE_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_crt_bundle_attach(void *conf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ESP_CRT_BUNDLE_H_
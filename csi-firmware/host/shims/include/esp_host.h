@@ -0,0 +1,135 @@
+/**
+ * @file esp_host.h
+ * @brief Host-only controls of the shims
+ *
+ * Not part of ESP-IDF. Simulators and host tests use these to play the
+ * parts of the device the firmware does not own: the radio, the heap and
+ * the node identity.
+ */
+
+#ifndef ESP_HOST_H
+#define ESP_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Set the station MAC returned by esp_read_mac()
+ * @param mac 6 bytes
+ */
+void esp_host_set_base_mac(const uint8_t mac[6]);
+
+/**
+ * @brief Set the figure returned by esp_get_free_heap_size()
+ * @param bytes Free heap to report
+ */
+void esp_host_set_free_heap(uint32_t bytes);
+
+/**
+ * @brief Make the next xTaskCreate() calls fail, as on a heap too small for the task
+ * @param count Number of calls to fail
+ */
+void esp_host_fail_task_create(uint32_t count);
+
+/**
+ * @brief Make esp_restart() end the calling task instead of the process
+ *
+ * For tests of code that restarts the device when it is done, such as an
+ * OTA update. Shutdown handlers do not run on a trapped restart.
+ *
+ * @param trap true to trap restarts, false to exit as the device would reset
+ */
+void esp_host_trap_restart(bool trap);
+
+/**
+ * @brief Number of trapped esp_restart() calls
+ * @return Count since the process started
+ */
+uint32_t esp_host_restart_count(void);
+
+/**
+ * @brief Hand a CSI report to the firmware as the Wi-Fi driver would
+ *
+ * Runs the callback registered with esp_wifi_set_csi_rx_cb() on the
+ * calling thread, which plays the Wi-Fi task. The buffers only need to
+ * live for the duration of the call.
+ *
+ * @param info CSI report
+ * @return true if delivered, false if CSI is disabled or nobody listens
+ */
+bool esp_host_wifi_deliver_csi(wifi_csi_info_t *info);
+
+/**
+ * @brief Whether CSI is enabled and a receive callback is registered
+ * @return true if esp_host_wifi_deliver_csi() would deliver
+ */
+bool esp_host_wifi_csi_enabled(void);
+
+/**
+ * @brief Counters of the esp-mqtt shim, summed over all clients
+ */
+typedef struct {
+    uint32_t connects;          ///< Sessions established
+    uint32_t publishes;         ///< PUBLISH packets sent
+    uint64_t publish_bytes;     ///< Bytes of those packets on the wire
+    uint32_t acks;              ///< PUBACKs received
+    uint32_t received;          ///< PUBLISH packets received
+} esp_host_mqtt_stats_t;
+
+/**
+ * @brief Read the esp-mqtt shim counters
+ * @param stats Output
+ */
+void esp_host_mqtt_get_stats(esp_host_mqtt_stats_t *stats);
+
+/**
+ * @brief Broker host name that selects the in-process loopback broker
+ *
+ * A client pointed at this host connects without a network and has every
+ * QoS 1 publish acknowledged at once, so the firmware's publish path can
+ * be measured on its own.
+ */
+#define ESP_HOST_MQTT_LOOPBACK "loopback"
+
+/**
+ * @brief Answer of the in-process HTTP origin to one request
+ */
+typedef struct {
+    int status;                 ///< Status code, 0 refuses the connection
+    char headers[512];          ///< Header lines, "Name: value\r\n" each
+    const uint8_t *body;        ///< Body, must stay valid until the client is cleaned up
+    size_t body_len;            ///< Body length, sent as Content-Length
+    size_t drop_after;          ///< Body bytes delivered before the connection drops (0: all)
+} esp_host_http_response_t;
+
+/**
+ * @brief Origin handler for requests of the esp_http_client shim
+ * @param url Request URL
+ * @param headers Request header lines, "Name: value\r\n" each
+ * @param response Answer to fill, zeroed on entry
+ * @param ctx Handler context
+ */
+typedef void (*esp_host_http_handler_t)(const char *url, const char *headers,
+                                         esp_host_http_response_t *response, void *ctx);
+
+/**
+ * @brief Set the origin that answers every esp_http_client request
+ *
+ * Without a handler, connections are refused.
+ *
+ * @param handler Handler, NULL to remove
+ * @param ctx Handler context
+ */
+void esp_host_http_set_handler(esp_host_http_handler_t handler, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_HOST_H
@@ -0,0 +1,15 @@
+/**
+ * @file esp_https_ota.h
+ * @brief Host shim: empty
+ *
+ * ota_updater includes it but drives esp_http_client and esp_ota_ops
+ * itself; see esp_http_client.h and esp_ota_ops.h.
+ */
+
+#ifndef _ESP_HTTPS_OTA_H_
+#define _ESP_HTTPS_OTA_H_
+
+#include "esp_http_client.h"
+#include "esp_ota_ops.h"
+
+#endif // _ESP_HTTPS_OTA_H_
@@ -0,0 +1,73 @@
+/**
+ * @file esp_log.h
+ * @brief Host shim: ESP-IDF logging to stderr
+ *
+ * Same line format as the device console. The level can be set per tag
+ * with esp_log_level_set() and defaults to ESP_LOG_INFO, or to the level
+ * named by the CSI_HOST_LOG_LEVEL environment variable (E, W, I, D, V
+ * or NONE).
+ */
+
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdint.h>
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+/**
+ * @brief Set the log level of a tag, or of all tags with "*"
+ * @param tag Tag
+ * @param level Most verbose level to print
+ */
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+
+/**
+ * @brief Get the log level of a tag
+ * @param tag Tag
+ * @return Level
+ */
+esp_log_level_t esp_log_level_get(const char *tag);
+
+/**
+ * @brief Milliseconds since start, as printed in log lines
+ * @return Timestamp
+ */
+uint32_t esp_log_timestamp(void);
+
+/**
+ * @brief Write a log line if the level of the tag allows it
+ */
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOG_LEVEL(level, letter, tag, format, ...) do {                 \
+        if (esp_log_level_get(tag) >= (level)) {                            \
+            esp_log_write(level, tag, letter " (%u) %s: " format "\n",      \
+                          (unsigned)esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        }                                                                   \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_ERROR,   "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_WARN,    "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_INFO,    "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_DEBUG,   "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_LOG_H
@@ -0,0 +1,42 @@
+/**
+ * @file esp_mac.h
+ * @brief Host shim: MAC addresses
+ */
+
+#ifndef ESP_MAC_H
+#define ESP_MAC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH,
+} esp_mac_type_t;
+
+#define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
+#define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+
+/**
+ * @brief Read a MAC address of the node
+ *
+ * The station MAC is the one set with esp_host_set_base_mac(); the other
+ * interfaces follow it as on the device (+1 AP, +2 BT, +3 Ethernet).
+ *
+ * @param mac Output, 6 bytes
+ * @param type Interface
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG
+ */
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_MAC_H
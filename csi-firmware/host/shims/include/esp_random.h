@@ -0,0 +1,33 @@
+/**
+ * @file esp_random.h
+ * @brief Host shim: random numbers
+ */
+
+#ifndef ESP_RANDOM_H
+#define ESP_RANDOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Random 32-bit word from the OS generator
+ * @return Random value
+ */
+uint32_t esp_random(void);
+
+/**
+ * @brief Fill a buffer with random bytes
+ * @param buf Buffer
+ * @param len Length
+ */
+void esp_fill_random(void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_RANDOM_H
@@ -0,0 +1,28 @@
+/**
+ * @file esp_rom_crc.h
+ * @brief Host shim: CRC routines of the ROM
+ */
+
+#ifndef ESP_ROM_CRC_H
+#define ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief CRC-32 (IEEE 802.3, little endian), as zlib's crc32()
+ * @param crc CRC of the preceding data, 0 to start
+ * @param buf Data
+ * @param len Length
+ * @return Updated CRC
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_ROM_CRC_H
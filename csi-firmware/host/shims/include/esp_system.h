@@ -0,0 +1,57 @@
+/**
+ * @file esp_system.h
+ * @brief Host shim: system information and restart
+ */
+
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_bit_defs.h"
+#include "esp_random.h"
+#include "esp_mac.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Free heap as the firmware sees it
+ *
+ * The host has no fixed heap; this reports a device-like figure that the
+ * simulator can lower with esp_host_set_free_heap() to exercise low-memory
+ * paths.
+ *
+ * @return Bytes
+ */
+uint32_t esp_get_free_heap_size(void);
+
+/**
+ * @brief Lowest free heap reported since start
+ * @return Bytes
+ */
+uint32_t esp_get_minimum_free_heap_size(void);
+
+/**
+ * @brief Restart the firmware
+ *
+ * Runs the handlers registered with esp_register_shutdown_handler() and
+ * exits the process.
+ */
+void esp_restart(void) __attribute__((noreturn));
+
+typedef void (*shutdown_handler_t)(void);
+
+/**
+ * @brief Register a function to run before esp_restart() exits
+ * @param handle Handler
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the table is full
+ */
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_SYSTEM_H
@@ -0,0 +1,26 @@
+/**
+ * @file esp_timer.h
+ * @brief Host shim: microsecond uptime clock
+ */
+
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds since the process started (monotonic)
+ * @return Time in microseconds
+ */
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_TIMER_H
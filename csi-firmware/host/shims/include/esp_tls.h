@@ -0,0 +1,28 @@
+/**
+ * @file esp_tls.h
+ * @brief Host shim: esp-tls error codes only
+ *
+ * The host build has no TLS stack; an esp-mqtt client configured for
+ * MQTT over TLS reports a transport error with ESP_ERR_NOT_SUPPORTED
+ * instead of connecting.
+ */
+
+#ifndef ESP_TLS_H
+#define ESP_TLS_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_ESP_TLS_BASE                0x8000
+#define ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME (ESP_ERR_ESP_TLS_BASE + 0x01)
+#define ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST  (ESP_ERR_ESP_TLS_BASE + 0x03)
+#define ESP_ERR_ESP_TLS_CONNECTION_TIMEOUT      (ESP_ERR_ESP_TLS_BASE + 0x06)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_TLS_H
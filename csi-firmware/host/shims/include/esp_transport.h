@@ -0,0 +1,31 @@
+/**
+ * @file esp_transport.h
+ * @brief Host shim: opaque transport handle
+ *
+ * Only handle bookkeeping is provided; the host esp-mqtt client does its
+ * own socket I/O and refuses transports it cannot run (see mqtt_client.h).
+ */
+
+#ifndef _ESP_TRANSPORT_H_
+#define _ESP_TRANSPORT_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_transport_item_t *esp_transport_handle_t;
+
+esp_transport_handle_t esp_transport_init(void);
+esp_err_t esp_transport_destroy(esp_transport_handle_t t);
+esp_err_t esp_transport_set_default_port(esp_transport_handle_t t, int port);
+int esp_transport_get_default_port(esp_transport_handle_t t);
+esp_err_t esp_transport_set_context_data(esp_transport_handle_t t, void *data);
+void *esp_transport_get_context_data(esp_transport_handle_t t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ESP_TRANSPORT_H_
@@ -0,0 +1,39 @@
+/**
+ * @file esp_wifi.h
+ * @brief Host shim: the CSI part of the Wi-Fi driver
+ *
+ * There is no radio; CSI reports come from esp_host_wifi_deliver_csi(),
+ * called by the simulated radio or a replay.
+ */
+
+#ifndef ESP_WIFI_H
+#define ESP_WIFI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_WIFI_NOT_INIT   (ESP_ERR_WIFI_BASE + 1)
+#define ESP_ERR_WIFI_NOT_STARTED (ESP_ERR_WIFI_BASE + 2)
+#define ESP_ERR_WIFI_NOT_CONNECT (ESP_ERR_WIFI_BASE + 15)
+
+esp_err_t esp_wifi_set_csi_rx_cb(wifi_csi_cb_t cb, void *ctx);
+esp_err_t esp_wifi_set_csi_config(const wifi_csi_config_t *config);
+esp_err_t esp_wifi_set_csi(bool en);
+
+/**
+ * @brief Always ESP_ERR_WIFI_NOT_CONNECT: the host station is never associated
+ */
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_WIFI_H
@@ -0,0 +1,98 @@
+/**
+ * @file esp_wifi_types.h
+ * @brief Host shim: Wi-Fi CSI types, laid out as on the ESP32
+ */
+
+#ifndef ESP_WIFI_TYPES_H
+#define ESP_WIFI_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_event.h"  // Included by the IDF header as well
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Receive metadata of a packet (ESP32 layout)
+ */
+typedef struct {
+    signed rssi:8;                  ///< Received signal strength, dBm
+    unsigned rate:5;                ///< PHY rate of non-HT packets
+    unsigned :1;
+    unsigned sig_mode:2;            ///< 0 non-HT, 1 HT, 3 VHT
+    unsigned :16;
+    unsigned mcs:7;                 ///< Modulation coding scheme of HT packets
+    unsigned cwb:1;                 ///< Channel bandwidth, 0 20 MHz, 1 40 MHz
+    unsigned :16;
+    unsigned smoothing:1;
+    unsigned not_sounding:1;
+    unsigned :1;
+    unsigned aggregation:1;
+    unsigned stbc:2;
+    unsigned fec_coding:1;
+    unsigned sgi:1;
+    signed noise_floor:8;           ///< Noise floor, dBm
+    unsigned ampdu_cnt:8;
+    unsigned channel:4;             ///< Primary channel
+    unsigned secondary_channel:4;   ///< 0 none, 1 above, 2 below
+    unsigned :8;
+    unsigned timestamp:32;          ///< Local time of reception, microseconds
+    unsigned :32;
+    unsigned :31;
+    unsigned ant:1;                 ///< Antenna number
+    unsigned sig_len:12;            ///< Packet length incl. FCS
+    unsigned :12;
+    unsigned rx_state:8;            ///< 0 if received without error
+} wifi_pkt_rx_ctrl_t;
+
+/**
+ * @brief CSI report passed to the receive callback
+ */
+typedef struct {
+    wifi_pkt_rx_ctrl_t rx_ctrl;     ///< Receive metadata
+    uint8_t mac[6];                 ///< Source MAC
+    uint8_t dmac[6];                ///< Destination MAC
+    bool first_word_invalid;        ///< First four bytes of buf are invalid
+    int8_t *buf;                    ///< CSI, interleaved imaginary and real parts
+    uint16_t len;                   ///< Length of buf
+    uint8_t *hdr;                   ///< 802.11 header
+    uint8_t *payload;               ///< Packet payload
+    uint16_t payload_len;           ///< Payload length
+    uint16_t rx_seq;                ///< 802.11 sequence number
+} wifi_csi_info_t;
+
+/**
+ * @brief CSI configuration (ESP32)
+ */
+typedef struct {
+    bool lltf_en;
+    bool htltf_en;
+    bool stbc_htltf2_en;
+    bool ltf_merge_en;
+    bool channel_filter_en;
+    bool manu_scale;
+    uint8_t shift;
+} wifi_csi_config_t;
+
+/**
+ * @brief Description of the access point the station is associated with
+ *
+ * Only the leading fields; the host never reports an association.
+ */
+typedef struct {
+    uint8_t bssid[6];               ///< MAC address of the AP
+    uint8_t ssid[33];               ///< SSID of the AP
+    uint8_t primary;                ///< Primary channel
+    uint8_t second;                 ///< Secondary channel
+    int8_t rssi;                    ///< Signal strength, dBm
+} wifi_ap_record_t;
+
+typedef void (*wifi_csi_cb_t)(void *ctx, wifi_csi_info_t *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_WIFI_TYPES_H
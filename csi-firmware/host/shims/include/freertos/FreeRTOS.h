@@ -0,0 +1,81 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host shim: FreeRTOS types and port macros on POSIX threads
+ *
+ * Tasks are threads, the tick is 1 ms and scheduling is left to the OS:
+ * priorities and core affinity are accepted and ignored. Critical
+ * sections are recursive mutexes, so code that takes a spinlock around a
+ * few lines behaves the same, only without disabling interrupts.
+ */
+
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "sdkconfig.h"
+#include "esp_bit_defs.h"
+#include "esp_system.h"     // Reached through portmacro.h on the device
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define errQUEUE_EMPTY          ((BaseType_t)0)
+#define errQUEUE_FULL           ((BaseType_t)0)
+
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES    25
+#define configMINIMAL_STACK_SIZE 768
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+#define pdTICKS_TO_MS(ticks)    ((uint32_t)(((uint64_t)(ticks) * 1000U) / configTICK_RATE_HZ))
+
+/**
+ * @brief Critical section lock
+ */
+typedef struct {
+    pthread_mutex_t lock;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+#define portMUX_INITIALIZE(mux)     freertos_host_mux_init(mux)
+
+void freertos_host_mux_init(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->lock)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->lock)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux)    portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux)         portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)          portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+
+#define portYIELD_FROM_ISR(x)           ((void)(x))
+#define portNUM_PROCESSORS              2
+
+#define pvPortMalloc(size)              malloc(size)
+#define vPortFree(ptr)                  free(ptr)
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <stdlib.h>
+
+#endif // INC_FREERTOS_H
@@ -0,0 +1,34 @@
+/**
+ * @file event_groups.h
+ * @brief Host shim: FreeRTOS event groups
+ */
+
+#ifndef EVENT_GROUPS_H
+#define EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct freertos_host_event_group *EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bits_to_wait_for,
+                                const BaseType_t clear_on_exit, const BaseType_t wait_for_all_bits,
+                                TickType_t ticks_to_wait);
+
+#define xEventGroupSetBitsFromISR(group, bits, woken) \
+    ((void)(woken), xEventGroupSetBits(group, bits), pdPASS)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_GROUPS_H
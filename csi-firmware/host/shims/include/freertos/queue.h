@@ -0,0 +1,40 @@
+/**
+ * @file queue.h
+ * @brief Host shim: FreeRTOS queues (copy semantics, fixed item size)
+ */
+
+#ifndef INC_QUEUE_H
+#define INC_QUEUE_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct freertos_host_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+#define xQueueSend(queue, item, ticks)  xQueueSendToBack(queue, item, ticks)
+#define xQueueSendFromISR(queue, item, woken) \
+    ((void)(woken), xQueueSendToBack(queue, item, 0))
+#define xQueueSendToBackFromISR(queue, item, woken) \
+    ((void)(woken), xQueueSendToBack(queue, item, 0))
+#define xQueueReceiveFromISR(queue, buffer, woken) \
+    ((void)(woken), xQueueReceive(queue, buffer, 0))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INC_QUEUE_H
@@ -0,0 +1,47 @@
+/**
+ * @file mqtt5_client.h
+ * @brief Host shim: esp-mqtt MQTT v5 property API
+ */
+
+#ifndef MQTT5_CLIENT_H_
+#define MQTT5_CLIENT_H_
+
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *key;
+    const char *value;
+} esp_mqtt5_user_property_item_t;
+
+/**
+ * @brief Properties applied to the next publish
+ */
+typedef struct {
+    bool payload_format_indicator;
+    uint32_t message_expiry_interval;
+    uint16_t topic_alias;
+    const char *response_topic;
+    const char *correlation_data;
+    uint16_t correlation_data_len;
+    const char *content_type;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_publish_property_config_t;
+
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t client,
+                                                const esp_mqtt5_publish_property_config_t *property);
+esp_err_t esp_mqtt5_client_set_user_property(mqtt5_user_property_handle_t *user_property,
+                                             esp_mqtt5_user_property_item_t item[], uint8_t item_num);
+esp_err_t esp_mqtt5_client_get_user_property(mqtt5_user_property_handle_t user_property,
+                                             esp_mqtt5_user_property_item_t *item, uint8_t *item_num);
+uint8_t esp_mqtt5_client_get_user_property_count(mqtt5_user_property_handle_t user_property);
+void esp_mqtt5_client_delete_user_property(mqtt5_user_property_handle_t user_property);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT5_CLIENT_H_
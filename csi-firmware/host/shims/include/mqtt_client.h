@@ -0,0 +1,224 @@
+/**
+ * @file mqtt_client.h
+ * @brief Host shim: esp-mqtt client API (IDF 5 layout)
+ *
+ * A small MQTT 3.1.1 / 5 client over plain TCP that raises the same
+ * events as esp-mqtt on its own thread. Unacknowledged QoS 1 messages
+ * stay in the client outbox and are retransmitted after a reconnect.
+ * Hostname ESP_HOST_MQTT_LOOPBACK (esp_host.h) selects an in-process
+ * broker. TLS, WebSocket transports, QoS 2 and last will are not
+ * implemented.
+ */
+
+#ifndef _MQTT_CLIENT_H_
+#define _MQTT_CLIENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum esp_mqtt_event_id_t {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+    MQTT_USER_EVENT,
+} esp_mqtt_event_id_t;
+
+typedef enum esp_mqtt_connect_return_code_t {
+    MQTT_CONNECTION_ACCEPTED = 0,
+    MQTT_CONNECTION_REFUSE_PROTOCOL,
+    MQTT_CONNECTION_REFUSE_ID_REJECTED,
+    MQTT_CONNECTION_REFUSE_SERVER_UNAVAILABLE,
+    MQTT_CONNECTION_REFUSE_BAD_USERNAME,
+    MQTT_CONNECTION_REFUSE_NOT_AUTHORIZED,
+} esp_mqtt_connect_return_code_t;
+
+typedef enum esp_mqtt_error_type_t {
+    MQTT_ERROR_TYPE_NONE = 0,
+    MQTT_ERROR_TYPE_TCP_TRANSPORT,
+    MQTT_ERROR_TYPE_CONNECTION_REFUSED,
+    MQTT_ERROR_TYPE_SUBSCRIBE_FAILED,
+} esp_mqtt_error_type_t;
+
+typedef enum esp_mqtt_transport_t {
+    MQTT_TRANSPORT_UNKNOWN = 0x0,
+    MQTT_TRANSPORT_OVER_TCP,
+    MQTT_TRANSPORT_OVER_SSL,
+    MQTT_TRANSPORT_OVER_WS,
+    MQTT_TRANSPORT_OVER_WSS,
+} esp_mqtt_transport_t;
+
+typedef enum esp_mqtt_protocol_ver_t {
+    MQTT_PROTOCOL_UNDEFINED = 0,
+    MQTT_PROTOCOL_V_3_1,
+    MQTT_PROTOCOL_V_3_1_1,
+    MQTT_PROTOCOL_V_5,
+} esp_mqtt_protocol_ver_t;
+
+/**
+ * @brief Error details of MQTT_EVENT_ERROR and MQTT_EVENT_DISCONNECTED
+ *
+ * connect_return_code carries the CONNACK code; with MQTT v5 it is the
+ * reason code, as is disconnect_return_code for a broker DISCONNECT.
+ */
+typedef struct esp_mqtt_error_codes {
+    esp_err_t esp_tls_last_esp_err;
+    int esp_tls_stack_err;
+    int esp_tls_cert_verify_flags;
+    esp_mqtt_error_type_t error_type;
+    esp_mqtt_connect_return_code_t connect_return_code;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    int disconnect_return_code;
+#endif
+    int esp_transport_sock_errno;
+} esp_mqtt_error_codes_t;
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+typedef struct mqtt5_user_property_list_t *mqtt5_user_property_handle_t;
+
+/**
+ * @brief MQTT v5 properties of a received packet
+ */
+typedef struct esp_mqtt5_event_property_t {
+    bool payload_format_indicator;
+    char *response_topic;
+    int response_topic_len;
+    char *correlation_data;
+    uint16_t correlation_data_len;
+    char *content_type;
+    int content_type_len;
+    uint16_t subscribe_id;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_event_property_t;
+#endif
+
+typedef struct esp_mqtt_event_t {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char *data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char *topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+    esp_mqtt_error_codes_t *error_handle;
+    bool retain;
+    int qos;
+    bool dup;
+    esp_mqtt_protocol_ver_t protocol_ver;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    esp_mqtt5_event_property_t *property;
+#endif
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef struct esp_mqtt_client_config_t {
+    struct broker_t {
+        struct address_t {
+            const char *uri;
+            const char *hostname;
+            esp_mqtt_transport_t transport;
+            const char *path;
+            uint32_t port;
+        } address;
+        struct verification_t {
+            bool use_global_ca_store;
+            esp_err_t (*crt_bundle_attach)(void *conf);
+            const char *certificate;
+            size_t certificate_len;
+            bool skip_cert_common_name_check;
+            const char **alpn_protos;
+            const char *common_name;
+        } verification;
+    } broker;
+    struct credentials_t {
+        const char *username;
+        const char *client_id;
+        bool set_null_client_id;
+        struct authentication_t {
+            const char *password;
+            const char *certificate;
+            size_t certificate_len;
+            const char *key;
+            size_t key_len;
+            const char *key_password;
+            int key_password_len;
+            bool use_secure_element;
+            void *ds_data;
+        } authentication;
+    } credentials;
+    struct session_t {
+        struct last_will_t {
+            const char *topic;
+            const char *msg;
+            int msg_len;
+            int qos;
+            int retain;
+        } last_will;
+        bool disable_clean_session;
+        int keepalive;
+        bool disable_keepalive;
+        esp_mqtt_protocol_ver_t protocol_ver;
+        int message_retransmit_timeout;
+    } session;
+    struct network_t {
+        int reconnect_timeout_ms;
+        int timeout_ms;
+        int refresh_connection_after_ms;
+        bool disable_auto_reconnect;
+        esp_transport_handle_t transport;
+    } network;
+    struct task_t {
+        int priority;
+        int stack_size;
+    } task;
+    struct buffer_t {
+        int size;
+        int out_size;
+    } buffer;
+    struct outbox_config_t {
+        uint64_t limit;
+    } outbox;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain, bool store);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg);
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _MQTT_CLIENT_H_
@@ -0,0 +1,28 @@
+/**
+ * @file newlib_host.h
+ * @brief Host shim: newlib string functions missing from older glibc
+ *
+ * Force-included into every host target (see host/CMakeLists.txt), since
+ * the firmware takes them from <string.h> as newlib declares them there.
+ */
+
+#ifndef NEWLIB_HOST_H
+#define NEWLIB_HOST_H
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+#define NEWLIB_HOST_STRLCPY 1
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NEWLIB_HOST_H
@@ -0,0 +1,32 @@
+/**
+ * @file sdkconfig_host.h
+ * @brief Host shim: options the device build gets from Kconfig defaults
+ *
+ * Included at the end of the generated sdkconfig.h; values set in
+ * sdkconfig.defaults take precedence.
+ */
+
+#ifndef SDKCONFIG_HOST_H
+#define SDKCONFIG_HOST_H
+
+#ifndef CONFIG_IDF_TARGET
+#define CONFIG_IDF_TARGET "linux"
+#endif
+
+#ifndef CONFIG_FREERTOS_HZ
+#define CONFIG_FREERTOS_HZ 1000
+#endif
+
+#ifndef CONFIG_LWIP_MAX_SOCKETS
+#define CONFIG_LWIP_MAX_SOCKETS 16
+#endif
+
+#ifndef CONFIG_HTTPD_MAX_URI_LEN
+#define CONFIG_HTTPD_MAX_URI_LEN 512
+#endif
+
+#ifndef CONFIG_HTTPD_MAX_REQ_HDR_LEN
+#define CONFIG_HTTPD_MAX_REQ_HDR_LEN 512
+#endif
+
+#endif // SDKCONFIG_HOST_H
@@ -0,0 +1,11 @@
+/**
+ * @file spi_flash_mmap.h
+ * @brief Host shim: flash geometry only
+ */
+
+#ifndef ESP_SPI_FLASH_MMAP_H
+#define ESP_SPI_FLASH_MMAP_H
+
+#define SPI_FLASH_SEC_SIZE      4096
+
+#endif // ESP_SPI_FLASH_MMAP_H
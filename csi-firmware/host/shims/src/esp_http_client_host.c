@@ -0,0 +1,289 @@
+/**
+ * @file esp_http_client_host.c
+ * @brief Host shim: esp_http_client against the in-process origin
+ *
+ * open() hands the request to the origin handler and keeps its answer;
+ * fetch_headers() reports the header events and the length; read() and
+ * perform() deliver the body until it ends or the origin drops the
+ * connection.
+ */
+
+#include <esp_http_client.h>
+#include <esp_crt_bundle.h>
+#include <esp_host.h>
+#include <esp_log.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define HTTP_HOST_HEADERS_MAX   16
+
+static const char *TAG = "esp_http_client_host";
+
+typedef struct {
+    char key[64];
+    char value[256];
+} http_host_header_t;
+
+struct esp_http_client {
+    char url[512];
+    esp_http_client_method_t method;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    http_host_header_t headers[HTTP_HOST_HEADERS_MAX];
+    int header_count;
+    bool open;
+    bool headers_fetched;
+    esp_host_http_response_t response;
+    size_t position;            ///< Body bytes delivered
+};
+
+static pthread_mutex_t s_origin_lock = PTHREAD_MUTEX_INITIALIZER;
+static esp_host_http_handler_t s_origin;
+static void *s_origin_ctx;
+
+void esp_host_http_set_handler(esp_host_http_handler_t handler, void *ctx)
+{
+    pthread_mutex_lock(&s_origin_lock);
+    s_origin = handler;
+    s_origin_ctx = ctx;
+    pthread_mutex_unlock(&s_origin_lock);
+}
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    (void)conf;
+    return ESP_OK;
+}
+
+static void http_event(esp_http_client_handle_t client, esp_http_client_event_id_t id,
+                       void *data, int data_len, char *key, char *value)
+{
+    if (!client->event_handler) {
+        return;
+    }
+    esp_http_client_event_t evt = {
+        .event_id = id,
+        .client = client,
+        .data = data,
+        .data_len = data_len,
+        .user_data = client->user_data,
+        .header_key = key,
+        .header_value = value,
+    };
+    client->event_handler(&evt);
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    if (!config || !config->url) {
+        return NULL;
+    }
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (!client) {
+        return NULL;
+    }
+    snprintf(client->url, sizeof(client->url), "%s", config->url);
+    client->method = config->method;
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+    return client;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->open) {
+        client->open = false;
+        http_event(client, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (!client) {
+        return ESP_FAIL;
+    }
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    if (!client || !url) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    snprintf(client->url, sizeof(client->url), "%s", url);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_user_data(esp_http_client_handle_t client, void *data)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->user_data = data;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    if (!client || !key || !value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    http_host_header_t *header = NULL;
+    for (int i = 0; i < client->header_count; i++) {
+        if (strcasecmp(client->headers[i].key, key) == 0) {
+            header = &client->headers[i];
+        }
+    }
+    if (!header) {
+        if (client->header_count == HTTP_HOST_HEADERS_MAX) {
+            return ESP_ERR_NO_MEM;
+        }
+        header = &client->headers[client->header_count++];
+    }
+    snprintf(header->key, sizeof(header->key), "%s", key);
+    snprintf(header->value, sizeof(header->value), "%s", value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    if (!client || !key) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < client->header_count; i++) {
+        if (strcasecmp(client->headers[i].key, key) == 0) {
+            client->headers[i] = client->headers[--client->header_count];
+            return ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    (void)write_len;
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_http_client_close(client);
+
+    char request_headers[HTTP_HOST_HEADERS_MAX * 324] = "";
+    size_t used = 0;
+    for (int i = 0; i < client->header_count; i++) {
+        used += snprintf(request_headers + used, sizeof(request_headers) - used, "%s: %s\r\n",
+                         client->headers[i].key, client->headers[i].value);
+    }
+
+    memset(&client->response, 0, sizeof(client->response));
+    pthread_mutex_lock(&s_origin_lock);
+    if (s_origin) {
+        s_origin(client->url, request_headers, &client->response, s_origin_ctx);
+    }
+    pthread_mutex_unlock(&s_origin_lock);
+
+    if (client->response.status == 0) {
+        ESP_LOGE(TAG, "Connection to %s refused", client->url);
+        http_event(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    client->open = true;
+    client->headers_fetched = false;
+    client->position = 0;
+    http_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    http_event(client, HTTP_EVENT_HEADERS_SENT, NULL, 0, NULL, NULL);
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    if (!client || !client->open) {
+        return ESP_FAIL;
+    }
+    if (!client->headers_fetched) {
+        client->headers_fetched = true;
+        char lines[sizeof(client->response.headers)];
+        memcpy(lines, client->response.headers, sizeof(lines));
+        char *save = NULL;
+        for (char *line = strtok_r(lines, "\r\n", &save); line; line = strtok_r(NULL, "\r\n", &save)) {
+            char *colon = strchr(line, ':');
+            if (!colon) {
+                continue;
+            }
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ') {
+                value++;
+            }
+            http_event(client, HTTP_EVENT_ON_HEADER, NULL, 0, line, value);
+        }
+    }
+    return (int64_t)client->response.body_len;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (!client || !client->open || len < 0) {
+        return ESP_FAIL;
+    }
+    const esp_host_http_response_t *response = &client->response;
+    size_t end = response->body_len;
+    if (response->drop_after && response->drop_after < end) {
+        end = response->drop_after;
+        if (client->position >= end) {
+            ESP_LOGW(TAG, "Origin dropped the connection after %zu bytes", client->position);
+            esp_http_client_close(client);
+            return ESP_FAIL;
+        }
+    }
+
+    size_t count = end - client->position;
+    if (count > (size_t)len) {
+        count = (size_t)len;
+    }
+    memcpy(buffer, response->body + client->position, count);
+    client->position += count;
+    return (int)count;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return (client && client->open) ? client->response.status : -1;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return (client && client->open) ? (int64_t)client->response.body_len : -1;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    esp_err_t ret = esp_http_client_open(client, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    esp_http_client_fetch_headers(client);
+
+    char buffer[1024];
+    for (;;) {
+        int len = esp_http_client_read(client, buffer, sizeof(buffer));
+        if (len < 0) {
+            return ESP_ERR_HTTP_CONNECTION_CLOSED;
+        }
+        if (len == 0) {
+            break;
+        }
+        http_event(client, HTTP_EVENT_ON_DATA, buffer, len, NULL, NULL);
+    }
+    http_event(client, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+    return ESP_OK;
+}
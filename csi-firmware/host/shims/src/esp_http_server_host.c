@@ -0,0 +1,778 @@
+/**
+ * @file esp_http_server_host.c
+ * @brief Host shim: esp_http_server on a socket server thread
+ */
+
+#include <esp_http_server.h>
+#include <esp_log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HTTPD_HOST_MAX_HEADERS      32
+#define HTTPD_HOST_RESP_HDR_LEN     64
+
+static const char *TAG = "httpd_host";
+
+typedef struct work_item {
+    struct work_item *next;
+    httpd_work_fn_t fn;
+    void *arg;
+} work_item_t;
+
+typedef struct {
+    char field[HTTPD_HOST_RESP_HDR_LEN];
+    char value[HTTPD_MAX_REQ_HDR_LEN];
+} resp_hdr_t;
+
+/**
+ * @brief Per-request state behind httpd_req_t.aux
+ */
+typedef struct {
+    int fd;
+    char raw[HTTPD_MAX_REQ_HDR_LEN * 4];    ///< Request line and headers
+    size_t raw_len;
+    const char *headers[HTTPD_HOST_MAX_HEADERS];
+    int header_count;
+    const uint8_t *body_buffered;           ///< Body bytes read together with the headers
+    size_t body_buffered_len;
+    size_t body_remaining;
+    char status[48];
+    char type[64];
+    resp_hdr_t *resp_hdrs;
+    int resp_hdr_count;
+    bool responded;
+    int timeout_s;
+} req_aux_t;
+
+typedef struct {
+    httpd_config_t config;
+    int listen_fd;
+    int wake_pipe[2];
+    pthread_t thread;
+    volatile bool run;
+    pthread_mutex_t lock;
+    httpd_uri_t *handlers;
+    int handler_count;
+    work_item_t *work;
+    int client_fd;                          ///< Connection being served, -1 if idle
+} httpd_host_t;
+
+// ===== SOCKET HELPERS =====
+
+static int send_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static const char *err_status(httpd_err_code_t error)
+{
+    switch (error) {
+        case HTTPD_501_METHOD_NOT_IMPLEMENTED:    return "501 Method Not Implemented";
+        case HTTPD_505_VERSION_NOT_SUPPORTED:     return "505 Version Not Supported";
+        case HTTPD_400_BAD_REQUEST:               return "400 Bad Request";
+        case HTTPD_401_UNAUTHORIZED:              return "401 Unauthorized";
+        case HTTPD_403_FORBIDDEN:                 return "403 Forbidden";
+        case HTTPD_404_NOT_FOUND:                 return "404 Not Found";
+        case HTTPD_405_METHOD_NOT_ALLOWED:        return "405 Method Not Allowed";
+        case HTTPD_408_REQ_TIMEOUT:               return "408 Request Timeout";
+        case HTTPD_411_LENGTH_REQUIRED:           return "411 Length Required";
+        case HTTPD_414_URI_TOO_LONG:              return "414 URI Too Long";
+        case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE:  return "431 Request Header Fields Too Large";
+        default:                                  return "500 Internal Server Error";
+    }
+}
+
+static int method_from_name(const char *name)
+{
+    static const struct { const char *name; int method; } methods[] = {
+        { "DELETE", HTTP_DELETE }, { "GET", HTTP_GET }, { "HEAD", HTTP_HEAD },
+        { "POST", HTTP_POST }, { "PUT", HTTP_PUT }, { "OPTIONS", HTTP_OPTIONS },
+        { "PATCH", HTTP_PATCH },
+    };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        if (strcmp(name, methods[i].name) == 0) {
+            return methods[i].method;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Find a request header
+ * @return Value with leading blanks skipped, not NUL terminated at the line end, or NULL
+ */
+static const char *find_header(const req_aux_t *aux, const char *field, size_t *len)
+{
+    size_t field_len = strlen(field);
+    for (int i = 0; i < aux->header_count; i++) {
+        const char *h = aux->headers[i];
+        if (strncasecmp(h, field, field_len) == 0 && h[field_len] == ':') {
+            const char *v = h + field_len + 1;
+            while (*v == ' ' || *v == '\t') {
+                v++;
+            }
+            *len = strlen(v);
+            while (*len > 0 && (v[*len - 1] == ' ' || v[*len - 1] == '\t')) {
+                (*len)--;
+            }
+            return v;
+        }
+    }
+    return NULL;
+}
+
+// ===== REQUEST SERVING =====
+
+static void send_error_raw(int fd, httpd_err_code_t error, const char *msg)
+{
+    char buf[256];
+    const char *body = msg ? msg : err_status(error);
+    int n = snprintf(buf, sizeof(buf),
+                     "HTTP/1.1 %s\r\nContent-Type: text/html\r\nContent-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n%s",
+                     err_status(error), strlen(body), body);
+    send_all(fd, buf, (size_t)(n < (int)sizeof(buf) ? n : (int)sizeof(buf) - 1));
+}
+
+/**
+ * @brief Read the request head and split it into lines
+ * @return 0 on success, otherwise the error to answer with (a negative value means just close)
+ */
+static int read_head(req_aux_t *aux)
+{
+    char *end = NULL;
+    while (!end) {
+        if (aux->raw_len == sizeof(aux->raw) - 1) {
+            return HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE;
+        }
+        ssize_t n = recv(aux->fd, aux->raw + aux->raw_len, sizeof(aux->raw) - 1 - aux->raw_len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTPD_408_REQ_TIMEOUT : -1;
+        }
+        aux->raw_len += (size_t)n;
+        aux->raw[aux->raw_len] = '\0';
+        end = strstr(aux->raw, "\r\n\r\n");
+    }
+
+    *end = '\0';
+    aux->body_buffered = (const uint8_t *)end + 4;
+    aux->body_buffered_len = aux->raw_len - (size_t)((char *)aux->body_buffered - aux->raw);
+
+    char *save = NULL;
+    char *line = strtok_r(aux->raw, "\r\n", &save);
+    if (!line) {
+        return HTTPD_400_BAD_REQUEST;
+    }
+    // The request line stays first; headers follow
+    while ((line = strtok_r(NULL, "\r\n", &save)) != NULL) {
+        if (aux->header_count == HTTPD_HOST_MAX_HEADERS) {
+            return HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE;
+        }
+        aux->headers[aux->header_count++] = line;
+    }
+    return 0;
+}
+
+static const httpd_uri_t *match_handler(httpd_host_t *hd, const char *path, int method, bool *path_known)
+{
+    *path_known = false;
+    for (int i = 0; i < hd->handler_count; i++) {
+        if (strcmp(hd->handlers[i].uri, path) == 0) {
+            *path_known = true;
+            if ((int)hd->handlers[i].method == method) {
+                return &hd->handlers[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+static void serve_connection(httpd_host_t *hd, int fd)
+{
+    struct timeval tv = { hd->config.recv_wait_timeout, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    tv.tv_sec = hd->config.send_wait_timeout;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    req_aux_t *aux = calloc(1, sizeof(*aux));
+    httpd_req_t *req = calloc(1, sizeof(*req));
+    resp_hdr_t *resp_hdrs = calloc(hd->config.max_resp_headers ? hd->config.max_resp_headers : 1,
+                                   sizeof(resp_hdr_t));
+    if (!aux || !req || !resp_hdrs) {
+        send_error_raw(fd, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        goto done;
+    }
+    aux->fd = fd;
+    aux->resp_hdrs = resp_hdrs;
+    aux->timeout_s = hd->config.recv_wait_timeout;
+
+    int err = read_head(aux);
+    if (err != 0) {
+        if (err > 0) {
+            send_error_raw(fd, (httpd_err_code_t)err, NULL);
+        }
+        goto done;
+    }
+
+    char method_name[16] = {0};
+    _Static_assert(HTTPD_MAX_URI_LEN == 512, "request line format below assumes 512");
+    char target[HTTPD_MAX_URI_LEN + 2] = {0};
+    char version[16] = {0};
+    if (sscanf(aux->raw, "%15s %513s %15s", method_name, target, version) != 3 ||
+        strncmp(version, "HTTP/1.", 7) != 0) {
+        send_error_raw(fd, HTTPD_400_BAD_REQUEST, NULL);
+        goto done;
+    }
+    if (strlen(target) > HTTPD_MAX_URI_LEN) {
+        send_error_raw(fd, HTTPD_414_URI_TOO_LONG, NULL);
+        goto done;
+    }
+
+    req->handle = hd;
+    req->method = method_from_name(method_name);
+    req->aux = aux;
+    memcpy((char *)req->uri, target, strlen(target) + 1);
+
+    size_t len = 0;
+    const char *content_length = find_header(aux, "Content-Length", &len);
+    req->content_len = content_length ? strtoul(content_length, NULL, 10) : 0;
+    if (aux->body_buffered_len > req->content_len) {
+        aux->body_buffered_len = req->content_len;
+    }
+    aux->body_remaining = req->content_len - aux->body_buffered_len;
+
+    char path[sizeof(target)];
+    snprintf(path, sizeof(path), "%s", target);
+    path[strcspn(path, "?")] = '\0';
+
+    pthread_mutex_lock(&hd->lock);
+    bool path_known = false;
+    const httpd_uri_t *found = match_handler(hd, path, req->method, &path_known);
+    httpd_uri_t handler = found ? *found : (httpd_uri_t){0};
+    pthread_mutex_unlock(&hd->lock);
+
+    if (!found) {
+        send_error_raw(fd, path_known ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL);
+        goto done;
+    }
+    if (handler.is_websocket) {
+        send_error_raw(fd, HTTPD_501_METHOD_NOT_IMPLEMENTED, "WebSocket is not available on the host build");
+        goto done;
+    }
+
+    req->user_ctx = handler.user_ctx;
+    hd->client_fd = fd;
+    esp_err_t ret = handler.handler(req);
+    hd->client_fd = -1;
+    if (ret != ESP_OK) {
+        ESP_LOGD(TAG, "Handler for %s returned %s, closing", path, esp_err_to_name(ret));
+    } else if (!aux->responded) {
+        ESP_LOGW(TAG, "Handler for %s sent no response", path);
+    }
+
+done:
+    free(resp_hdrs);
+    free(req);
+    free(aux);
+    shutdown(fd, SHUT_WR);
+    close(fd);
+}
+
+static void run_work(httpd_host_t *hd)
+{
+    pthread_mutex_lock(&hd->lock);
+    work_item_t *work = hd->work;
+    hd->work = NULL;
+    pthread_mutex_unlock(&hd->lock);
+
+    while (work) {
+        work_item_t *item = work;
+        work = item->next;
+        item->fn(item->arg);
+        free(item);
+    }
+}
+
+static void *server_thread(void *arg)
+{
+    httpd_host_t *hd = arg;
+
+    while (hd->run) {
+        struct pollfd pfds[2] = {
+            { .fd = hd->listen_fd, .events = POLLIN },
+            { .fd = hd->wake_pipe[0], .events = POLLIN },
+        };
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TAG, "poll failed: %s", strerror(errno));
+            break;
+        }
+        if (pfds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(hd->wake_pipe[0], drain, sizeof(drain)) > 0) {
+            }
+            run_work(hd);
+        }
+        if (!hd->run) {
+            break;
+        }
+        if (pfds[0].revents & POLLIN) {
+            int fd = accept(hd->listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                serve_connection(hd, fd);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void wake(httpd_host_t *hd)
+{
+    char c = 0;
+    if (write(hd->wake_pipe[1], &c, 1) < 0 && errno != EAGAIN) {
+        ESP_LOGW(TAG, "Wake write failed: %s", strerror(errno));
+    }
+}
+
+// ===== SERVER =====
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    if (!handle || !config || config->max_uri_handlers == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    httpd_host_t *hd = calloc(1, sizeof(*hd));
+    if (!hd) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    hd->config = *config;
+    hd->client_fd = -1;
+    hd->handlers = calloc(config->max_uri_handlers, sizeof(httpd_uri_t));
+    if (!hd->handlers || pipe2(hd->wake_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        free(hd->handlers);
+        free(hd);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+
+    hd->listen_fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    int zero = 0;
+    struct sockaddr_in6 addr = {
+        .sin6_family = AF_INET6,
+        .sin6_addr = in6addr_any,
+        .sin6_port = htons(config->server_port),
+    };
+    if (hd->listen_fd < 0 ||
+        setsockopt(hd->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        setsockopt(hd->listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)) != 0 ||
+        bind(hd->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(hd->listen_fd, config->backlog_conn ? config->backlog_conn : 5) != 0) {
+        ESP_LOGE(TAG, "Cannot listen on port %u: %s", config->server_port, strerror(errno));
+        if (hd->listen_fd >= 0) {
+            close(hd->listen_fd);
+        }
+        close(hd->wake_pipe[0]);
+        close(hd->wake_pipe[1]);
+        free(hd->handlers);
+        free(hd);
+        return ESP_ERR_HTTPD_TASK;
+    }
+
+    pthread_mutex_init(&hd->lock, NULL);
+    hd->run = true;
+    if (pthread_create(&hd->thread, NULL, server_thread, hd) != 0) {
+        close(hd->listen_fd);
+        close(hd->wake_pipe[0]);
+        close(hd->wake_pipe[1]);
+        pthread_mutex_destroy(&hd->lock);
+        free(hd->handlers);
+        free(hd);
+        return ESP_ERR_HTTPD_TASK;
+    }
+
+    ESP_LOGI(TAG, "Started server on port: '%u'", config->server_port);
+    *handle = hd;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    httpd_host_t *hd = handle;
+    if (!hd) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hd->run = false;
+    wake(hd);
+    pthread_join(hd->thread, NULL);
+
+    // Queued work still owns its arguments
+    run_work(hd);
+
+    close(hd->listen_fd);
+    close(hd->wake_pipe[0]);
+    close(hd->wake_pipe[1]);
+    pthread_mutex_destroy(&hd->lock);
+    if (hd->config.global_user_ctx_free_fn) {
+        hd->config.global_user_ctx_free_fn(hd->config.global_user_ctx);
+    }
+    free(hd->handlers);
+    free(hd);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    httpd_host_t *hd = handle;
+    if (!hd || !uri_handler || !uri_handler->uri || !uri_handler->handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&hd->lock);
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < hd->handler_count; i++) {
+        if (strcmp(hd->handlers[i].uri, uri_handler->uri) == 0 &&
+            hd->handlers[i].method == uri_handler->method) {
+            ret = ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (ret == ESP_OK && hd->handler_count == hd->config.max_uri_handlers) {
+        ESP_LOGW(TAG, "No slots left for registering handler");
+        ret = ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    if (ret == ESP_OK) {
+        hd->handlers[hd->handler_count++] = *uri_handler;
+    }
+    pthread_mutex_unlock(&hd->lock);
+    return ret;
+}
+
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle, const char *uri, httpd_method_t method)
+{
+    httpd_host_t *hd = handle;
+    if (!hd || !uri) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&hd->lock);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    for (int i = 0; i < hd->handler_count; i++) {
+        if (strcmp(hd->handlers[i].uri, uri) == 0 && hd->handlers[i].method == method) {
+            memmove(&hd->handlers[i], &hd->handlers[i + 1],
+                    (size_t)(hd->handler_count - i - 1) * sizeof(httpd_uri_t));
+            hd->handler_count--;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&hd->lock);
+    return ret;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+    httpd_host_t *hd = handle;
+    if (!hd || !work) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    work_item_t *item = calloc(1, sizeof(*item));
+    if (!item) {
+        return ESP_FAIL;
+    }
+    item->fn = work;
+    item->arg = arg;
+
+    pthread_mutex_lock(&hd->lock);
+    if (!hd->run) {
+        pthread_mutex_unlock(&hd->lock);
+        free(item);
+        return ESP_FAIL;
+    }
+    work_item_t **tail = &hd->work;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = item;
+    pthread_mutex_unlock(&hd->lock);
+    wake(hd);
+    return ESP_OK;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds)
+{
+    httpd_host_t *hd = handle;
+    if (!hd || !fds || !client_fds) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Connections close after one response; only the one being served is open
+    size_t capacity = *fds;
+    *fds = 0;
+    if (hd->client_fd >= 0 && capacity > 0) {
+        client_fds[0] = hd->client_fd;
+        *fds = 1;
+    }
+    return ESP_OK;
+}
+
+// ===== REQUEST =====
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return r && r->aux ? ((req_aux_t *)r->aux)->fd : -1;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    if (!r || !r->aux || !buf) {
+        return HTTPD_SOCK_ERR_INVALID;
+    }
+    req_aux_t *aux = r->aux;
+    size_t total = aux->body_buffered_len + aux->body_remaining;
+    if (buf_len > total) {
+        buf_len = total;
+    }
+    if (buf_len == 0) {
+        return 0;
+    }
+
+    if (aux->body_buffered_len) {
+        size_t n = buf_len < aux->body_buffered_len ? buf_len : aux->body_buffered_len;
+        memcpy(buf, aux->body_buffered, n);
+        aux->body_buffered += n;
+        aux->body_buffered_len -= n;
+        return (int)n;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(aux->fd, buf, buf_len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+    }
+    if (n == 0) {
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    aux->body_remaining -= (size_t)n;
+    return (int)n;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    if (!r || !r->aux || !field) {
+        return 0;
+    }
+    size_t len = 0;
+    return find_header(r->aux, field, &len) ? len : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    if (!r || !r->aux || !field || !val || val_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len = 0;
+    const char *v = find_header(r->aux, field, &len);
+    if (!v) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t n = len < val_size - 1 ? len : val_size - 1;
+    memcpy(val, v, n);
+    val[n] = '\0';
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    if (!r || !buf || buf_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *q = strchr(r->uri, '?');
+    if (!q) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    q++;
+    size_t len = strlen(q);
+    size_t n = len < buf_len - 1 ? len : buf_len - 1;
+    memcpy(buf, q, n);
+    buf[n] = '\0';
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size)
+{
+    if (!qry || !key || !val || val_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t key_len = strlen(key);
+    const char *p = qry;
+    while (p && *p) {
+        const char *end = strchr(p, '&');
+        size_t pair_len = end ? (size_t)(end - p) : strlen(p);
+        if (pair_len > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            const char *v = p + key_len + 1;
+            size_t len = pair_len - key_len - 1;
+            size_t n = len < val_size - 1 ? len : val_size - 1;
+            memcpy(val, v, n);
+            val[n] = '\0';
+            return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+// ===== RESPONSE =====
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    if (!r || !r->aux || !status) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    req_aux_t *aux = r->aux;
+    snprintf(aux->status, sizeof(aux->status), "%s", status);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    if (!r || !r->aux || !type) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    req_aux_t *aux = r->aux;
+    snprintf(aux->type, sizeof(aux->type), "%s", type);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    if (!r || !r->aux || !field || !value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    req_aux_t *aux = r->aux;
+    httpd_host_t *hd = r->handle;
+    if (aux->resp_hdr_count >= hd->config.max_resp_headers) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    resp_hdr_t *h = &aux->resp_hdrs[aux->resp_hdr_count++];
+    snprintf(h->field, sizeof(h->field), "%s", field);
+    snprintf(h->value, sizeof(h->value), "%s", value);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    if (!r || !r->aux) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+    req_aux_t *aux = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? (ssize_t)strlen(buf) : 0;
+    }
+
+    char head[HTTPD_MAX_REQ_HDR_LEN * 2];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zd\r\nConnection: close\r\n",
+                     aux->status[0] ? aux->status : "200 OK",
+                     aux->type[0] ? aux->type : "text/html", buf_len);
+    for (int i = 0; i < aux->resp_hdr_count && n < (int)sizeof(head); i++) {
+        n += snprintf(head + n, sizeof(head) - (size_t)n, "%s: %s\r\n",
+                      aux->resp_hdrs[i].field, aux->resp_hdrs[i].value);
+    }
+    if (n >= (int)sizeof(head) - 2) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    n += snprintf(head + n, sizeof(head) - (size_t)n, "\r\n");
+
+    aux->responded = true;
+    if (send_all(aux->fd, head, (size_t)n) != 0 ||
+        (buf_len > 0 && send_all(aux->fd, buf, (size_t)buf_len) != 0)) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str)
+{
+    return httpd_resp_send(r, str, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    esp_err_t ret = httpd_resp_set_status(req, err_status(error));
+    if (ret == ESP_OK) {
+        httpd_resp_set_type(req, "text/html");
+        ret = httpd_resp_send(req, msg ? msg : err_status(error), HTTPD_RESP_USE_STRLEN);
+    }
+    return ret;
+}
+
+esp_err_t httpd_resp_send_404(httpd_req_t *r)
+{
+    return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, NULL);
+}
+
+esp_err_t httpd_resp_send_408(httpd_req_t *r)
+{
+    return httpd_resp_send_err(r, HTTPD_408_REQ_TIMEOUT, NULL);
+}
+
+esp_err_t httpd_resp_send_500(httpd_req_t *r)
+{
+    return httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
+
+// ===== WEBSOCKET =====
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt, size_t max_len)
+{
+    (void)req;
+    (void)pkt;
+    (void)max_len;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *pkt)
+{
+    (void)req;
+    (void)pkt;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+{
+    (void)hd;
+    (void)fd;
+    (void)frame;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd)
+{
+    httpd_host_t *server = hd;
+    return server && fd >= 0 && fd == server->client_fd ? HTTPD_WS_CLIENT_HTTP : HTTPD_WS_CLIENT_INVALID;
+}
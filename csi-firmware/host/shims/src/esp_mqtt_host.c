@@ -0,0 +1,1443 @@
+/**
+ * @file esp_mqtt_host.c
+ * @brief Host shim: esp-mqtt client over plain TCP
+ *
+ * One thread per client connects, reads packets and dispatches events, as
+ * the esp-mqtt task does. Publishing writes straight to the socket from
+ * the caller's thread under the write lock. QoS 1 messages stay in the
+ * outbox until acknowledged and are sent again, with DUP set, after a
+ * reconnect. Automatic reconnection follows network.disable_auto_reconnect
+ * and network.reconnect_timeout_ms.
+ */
+
+#include <mqtt_client.h>
+#include <mqtt5_client.h>
+#include <esp_host.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_tls.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// The event and error structs only carry the v5 fields with this option
+#ifndef CONFIG_MQTT_PROTOCOL_5
+#error "The host esp-mqtt shim needs CONFIG_MQTT_PROTOCOL_5; the protocol itself follows session.protocol_ver"
+#endif
+
+#define MQTT_HOST_POLL_MS               100
+#define MQTT_HOST_DEFAULT_KEEPALIVE_S   120
+#define MQTT_HOST_DEFAULT_TIMEOUT_MS    10000
+#define MQTT_HOST_DEFAULT_RECONNECT_MS  10000
+#define MQTT_HOST_LOOPBACK_ALIAS_MAX    16
+#define MQTT_HOST_MAX_PACKET            (256 * 1024)
+
+// Packet types
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        0x20
+#define MQTT_PUBLISH        0x30
+#define MQTT_PUBACK         0x40
+#define MQTT_SUBSCRIBE      0x82
+#define MQTT_SUBACK         0x90
+#define MQTT_UNSUBSCRIBE    0xA2
+#define MQTT_UNSUBACK       0xB0
+#define MQTT_PINGREQ        0xC0
+#define MQTT_PINGRESP       0xD0
+#define MQTT_DISCONNECT     0xE0
+
+// MQTT v5 property identifiers used here
+#define PROP_PAYLOAD_FORMAT     0x01
+#define PROP_MESSAGE_EXPIRY     0x02
+#define PROP_CONTENT_TYPE       0x03
+#define PROP_RESPONSE_TOPIC     0x08
+#define PROP_CORRELATION_DATA   0x09
+#define PROP_TOPIC_ALIAS_MAX    0x22
+#define PROP_TOPIC_ALIAS        0x23
+#define PROP_USER_PROPERTY      0x26
+
+static const char *TAG = "esp_mqtt_host";
+
+typedef enum {
+    CLIENT_STOPPED,
+    CLIENT_CONNECTING,
+    CLIENT_CONNECTED,
+    CLIENT_WAIT_RECONNECT,
+} client_state_t;
+
+/**
+ * @brief Unacknowledged QoS 1 message
+ *
+ * Kept unencoded so it can be sent again with a fresh topic alias mapping.
+ */
+typedef struct outbox_item {
+    struct outbox_item *next;
+    int msg_id;
+    int retain;
+    bool utf8_payload;
+    uint32_t expiry_s;
+    uint16_t topic_alias;
+    char *content_type;
+    char *topic;
+    uint8_t *data;
+    int len;
+    int wire_len;               ///< Encoded size, counted by get_outbox_size
+} outbox_item_t;
+
+/**
+ * @brief Acknowledgement the loopback broker owes the client
+ */
+typedef struct loop_ack {
+    struct loop_ack *next;
+    esp_mqtt_event_id_t event_id;
+    int msg_id;
+} loop_ack_t;
+
+struct mqtt5_user_property_list_t {
+    uint8_t count;
+    esp_mqtt5_user_property_item_t items[UINT8_MAX];
+};
+
+struct esp_mqtt_client {
+    char *host;
+    uint32_t port;
+    esp_mqtt_transport_t transport;
+    char *client_id;
+    char *username;
+    char *password;
+    int keepalive_s;
+    bool clean_session;
+    bool v5;
+    int timeout_ms;
+    int reconnect_timeout_ms;
+    bool auto_reconnect;
+    bool loopback;
+    esp_transport_handle_t transport_handle;
+
+    esp_event_handler_t handler;
+    void *handler_arg;
+
+    pthread_mutex_t lock;       ///< Client state, outbox and publish properties
+    pthread_mutex_t write_lock; ///< Socket writes
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool thread_started;
+    volatile bool run;
+    bool reconnect_requested;
+    client_state_t state;
+    int sock;
+
+    uint16_t next_msg_id;
+    outbox_item_t *outbox;
+    loop_ack_t *loop_acks;
+
+    esp_mqtt5_publish_property_config_t publish_property;
+    char *publish_content_type;
+    uint16_t server_alias_max;
+    char **alias_topics;        ///< Topic sent with each alias this connection, 1-based
+
+    int64_t last_tx_us;
+    int64_t ping_sent_us;
+};
+
+static _Atomic uint32_t s_stat_connects;
+static _Atomic uint32_t s_stat_publishes;
+static _Atomic uint64_t s_stat_publish_bytes;
+static _Atomic uint32_t s_stat_acks;
+static _Atomic uint32_t s_stat_received;
+
+void esp_host_mqtt_get_stats(esp_host_mqtt_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    stats->connects = atomic_load(&s_stat_connects);
+    stats->publishes = atomic_load(&s_stat_publishes);
+    stats->publish_bytes = atomic_load(&s_stat_publish_bytes);
+    stats->acks = atomic_load(&s_stat_acks);
+    stats->received = atomic_load(&s_stat_received);
+}
+
+// ===== ENCODING =====
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    bool failed;
+} wbuf_t;
+
+static void wb_reserve(wbuf_t *b, size_t extra)
+{
+    if (b->failed || b->len + extra <= b->cap) {
+        return;
+    }
+    size_t cap = b->cap ? b->cap : 64;
+    while (cap < b->len + extra) {
+        cap *= 2;
+    }
+    uint8_t *p = realloc(b->buf, cap);
+    if (!p) {
+        b->failed = true;
+        return;
+    }
+    b->buf = p;
+    b->cap = cap;
+}
+
+static void wb_bytes(wbuf_t *b, const void *data, size_t len)
+{
+    wb_reserve(b, len);
+    if (!b->failed && len) {
+        memcpy(b->buf + b->len, data, len);
+        b->len += len;
+    }
+}
+
+static void wb_u8(wbuf_t *b, uint8_t v)
+{
+    wb_bytes(b, &v, 1);
+}
+
+static void wb_u16(wbuf_t *b, uint16_t v)
+{
+    uint8_t be[2] = { (uint8_t)(v >> 8), (uint8_t)v };
+    wb_bytes(b, be, 2);
+}
+
+static void wb_u32(wbuf_t *b, uint32_t v)
+{
+    uint8_t be[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    wb_bytes(b, be, 4);
+}
+
+static void wb_varint(wbuf_t *b, uint32_t v)
+{
+    do {
+        uint8_t byte = v & 0x7F;
+        v >>= 7;
+        wb_u8(b, v ? byte | 0x80 : byte);
+    } while (v);
+}
+
+static void wb_str(wbuf_t *b, const char *s, size_t len)
+{
+    wb_u16(b, (uint16_t)len);
+    wb_bytes(b, s, len);
+}
+
+/**
+ * @brief Prefix a packet body with its fixed header
+ */
+static bool wb_finish(wbuf_t *out, uint8_t type, const wbuf_t *body)
+{
+    if (body->failed) {
+        return false;
+    }
+    wb_u8(out, type);
+    wb_varint(out, (uint32_t)body->len);
+    wb_bytes(out, body->buf, body->len);
+    return !out->failed;
+}
+
+// ===== DECODING =====
+
+typedef struct {
+    const uint8_t *p;
+    size_t left;
+    bool failed;
+} rbuf_t;
+
+static uint8_t rb_u8(rbuf_t *r)
+{
+    if (r->left < 1) {
+        r->failed = true;
+        return 0;
+    }
+    r->left--;
+    return *r->p++;
+}
+
+static uint16_t rb_u16(rbuf_t *r)
+{
+    uint16_t hi = rb_u8(r);
+    return (uint16_t)(hi << 8 | rb_u8(r));
+}
+
+static uint32_t rb_varint(rbuf_t *r)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+        uint8_t byte = rb_u8(r);
+        v |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return v;
+        }
+    }
+    r->failed = true;
+    return 0;
+}
+
+static const uint8_t *rb_take(rbuf_t *r, size_t len)
+{
+    if (r->left < len) {
+        r->failed = true;
+        return NULL;
+    }
+    const uint8_t *p = r->p;
+    r->p += len;
+    r->left -= len;
+    return p;
+}
+
+/**
+ * @brief Walk a v5 property block
+ *
+ * Reports the topic alias maximum and collects user properties; all other
+ * properties are skipped by type.
+ */
+static bool rb_properties(rbuf_t *r, uint16_t *alias_max, mqtt5_user_property_handle_t *user)
+{
+    uint32_t len = rb_varint(r);
+    const uint8_t *block = rb_take(r, len);
+    if (r->failed) {
+        return false;
+    }
+    rbuf_t props = { .p = block, .left = len };
+    while (props.left && !props.failed) {
+        uint8_t id = rb_u8(&props);
+        switch (id) {
+            case 0x01: case 0x17: case 0x19: case 0x24: case 0x25:
+            case 0x28: case 0x29: case 0x2A:
+                rb_u8(&props);
+                break;
+            case 0x13: case 0x21: case 0x23:
+                rb_u16(&props);
+                break;
+            case PROP_TOPIC_ALIAS_MAX: {
+                uint16_t v = rb_u16(&props);
+                if (alias_max) {
+                    *alias_max = v;
+                }
+                break;
+            }
+            case 0x02: case 0x11: case 0x18: case 0x27:
+                rb_take(&props, 4);
+                break;
+            case 0x0B:
+                rb_varint(&props);
+                break;
+            case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16:
+            case 0x1A: case 0x1C: case 0x1F:
+                rb_take(&props, rb_u16(&props));
+                break;
+            case PROP_USER_PROPERTY: {
+                uint16_t klen = rb_u16(&props);
+                const uint8_t *key = rb_take(&props, klen);
+                uint16_t vlen = rb_u16(&props);
+                const uint8_t *value = rb_take(&props, vlen);
+                if (!props.failed && user) {
+                    char *k = strndup((const char *)key, klen);
+                    char *v = strndup((const char *)value, vlen);
+                    esp_mqtt5_user_property_item_t item = { k, v };
+                    esp_mqtt5_client_set_user_property(user, &item, 1);
+                    free(k);
+                    free(v);
+                }
+                break;
+            }
+            default:
+                props.failed = true;
+                break;
+        }
+    }
+    return !props.failed;
+}
+
+// ===== SOCKET I/O =====
+
+static int send_all(esp_mqtt_client_handle_t client, const uint8_t *data, size_t len)
+{
+    if (client->loopback) {
+        client->last_tx_us = esp_timer_get_time();
+        return 0;
+    }
+    pthread_mutex_lock(&client->write_lock);
+    int ret = 0;
+    while (len > 0) {
+        ssize_t n = send(client->sock, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ret = -1;
+            break;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    client->last_tx_us = esp_timer_get_time();
+    pthread_mutex_unlock(&client->write_lock);
+    return ret;
+}
+
+static int recv_all(int sock, uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = recv(sock, data, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Read one packet
+ * @return Body allocated with malloc, or NULL on error
+ */
+static uint8_t *recv_packet(int sock, uint8_t *type, size_t *len)
+{
+    uint8_t byte;
+    if (recv_all(sock, type, 1) != 0) {
+        return NULL;
+    }
+    uint32_t remaining = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (shift > 21 || recv_all(sock, &byte, 1) != 0) {
+            return NULL;
+        }
+        remaining |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    if (remaining > MQTT_HOST_MAX_PACKET) {
+        ESP_LOGE(TAG, "Packet of %u bytes exceeds the host limit", (unsigned)remaining);
+        return NULL;
+    }
+    uint8_t *body = malloc(remaining ? remaining : 1);
+    if (!body || recv_all(sock, body, remaining) != 0) {
+        free(body);
+        return NULL;
+    }
+    *len = remaining;
+    return body;
+}
+
+static void close_socket(esp_mqtt_client_handle_t client)
+{
+    if (client->sock >= 0) {
+        close(client->sock);
+        client->sock = -1;
+    }
+}
+
+// ===== EVENTS =====
+
+static void dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_t *event)
+{
+    event->client = client;
+    event->protocol_ver = client->v5 ? MQTT_PROTOCOL_V_5 : MQTT_PROTOCOL_V_3_1_1;
+    if (client->handler) {
+        client->handler(client->handler_arg, "MQTT_EVENTS", event->event_id, event);
+    }
+}
+
+static void dispatch_simple(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t event = { .event_id = id, .msg_id = msg_id };
+    dispatch(client, &event);
+}
+
+// ===== CLIENT STATE =====
+
+static void clear_aliases(esp_mqtt_client_handle_t client)
+{
+    if (client->alias_topics) {
+        for (int i = 0; i <= client->server_alias_max; i++) {
+            free(client->alias_topics[i]);
+        }
+        free(client->alias_topics);
+        client->alias_topics = NULL;
+    }
+    client->server_alias_max = 0;
+}
+
+static void free_outbox_item(outbox_item_t *item)
+{
+    free(item->content_type);
+    free(item->topic);
+    free(item->data);
+    free(item);
+}
+
+static void clear_loop_acks(esp_mqtt_client_handle_t client)
+{
+    while (client->loop_acks) {
+        loop_ack_t *ack = client->loop_acks;
+        client->loop_acks = ack->next;
+        free(ack);
+    }
+}
+
+static int next_msg_id(esp_mqtt_client_handle_t client)
+{
+    if (++client->next_msg_id == 0) {
+        client->next_msg_id = 1;
+    }
+    return client->next_msg_id;
+}
+
+static void loop_ack_push(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t id, int msg_id)
+{
+    loop_ack_t *ack = calloc(1, sizeof(*ack));
+    if (!ack) {
+        return;
+    }
+    ack->event_id = id;
+    ack->msg_id = msg_id;
+    loop_ack_t **tail = &client->loop_acks;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = ack;
+    pthread_cond_broadcast(&client->cond);
+}
+
+/**
+ * @brief Encode a PUBLISH
+ *
+ * The topic is sent empty when its alias already carried it on this
+ * connection. Called with the client lock held.
+ *
+ * @return 0 on success, -1 if the alias is not allowed or out of memory
+ */
+static int encode_publish(esp_mqtt_client_handle_t client, wbuf_t *out, const outbox_item_t *m,
+                          int qos, bool dup)
+{
+    const char *topic = m->topic;
+    size_t topic_len = strlen(m->topic);
+    if (client->v5 && m->topic_alias) {
+        if (m->topic_alias > client->server_alias_max) {
+            return -1;
+        }
+        char **known = &client->alias_topics[m->topic_alias];
+        if (*known && strcmp(*known, m->topic) == 0) {
+            topic_len = 0;
+        } else {
+            free(*known);
+            *known = strdup(m->topic);
+        }
+    }
+
+    wbuf_t body = {0};
+    wb_str(&body, topic, topic_len);
+    if (qos > 0) {
+        wb_u16(&body, (uint16_t)m->msg_id);
+    }
+    if (client->v5) {
+        wbuf_t props = {0};
+        if (m->utf8_payload) {
+            wb_u8(&props, PROP_PAYLOAD_FORMAT);
+            wb_u8(&props, 1);
+        }
+        if (m->expiry_s) {
+            wb_u8(&props, PROP_MESSAGE_EXPIRY);
+            wb_u32(&props, m->expiry_s);
+        }
+        if (m->content_type) {
+            wb_u8(&props, PROP_CONTENT_TYPE);
+            wb_str(&props, m->content_type, strlen(m->content_type));
+        }
+        if (m->topic_alias) {
+            wb_u8(&props, PROP_TOPIC_ALIAS);
+            wb_u16(&props, m->topic_alias);
+        }
+        wb_varint(&body, (uint32_t)props.len);
+        wb_bytes(&body, props.buf, props.len);
+        body.failed |= props.failed;
+        free(props.buf);
+    }
+    wb_bytes(&body, m->data, (size_t)m->len);
+
+    uint8_t type = MQTT_PUBLISH | (dup ? 0x08 : 0) | (uint8_t)(qos << 1) | (m->retain ? 1 : 0);
+    bool ok = wb_finish(out, type, &body);
+    free(body.buf);
+    return ok ? 0 : -1;
+}
+
+static int send_publish(esp_mqtt_client_handle_t client, const outbox_item_t *m, int qos, bool dup)
+{
+    wbuf_t out = {0};
+    if (encode_publish(client, &out, m, qos, dup) != 0) {
+        free(out.buf);
+        return -1;
+    }
+    int ret = send_all(client, out.buf, out.len);
+    if (ret == 0) {
+        atomic_fetch_add(&s_stat_publishes, 1);
+        atomic_fetch_add(&s_stat_publish_bytes, out.len);
+        if (client->loopback && qos > 0) {
+            loop_ack_push(client, MQTT_EVENT_PUBLISHED, m->msg_id);
+        }
+    }
+    free(out.buf);
+    return ret;
+}
+
+// ===== CONNECTION =====
+
+static int open_socket(esp_mqtt_client_handle_t client, esp_mqtt_error_codes_t *err)
+{
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)client->port);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(client->host, port, &hints, &res) != 0) {
+        err->esp_tls_last_esp_err = ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME;
+        return -1;
+    }
+
+    int sock = -1;
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        struct timeval tv = { client->timeout_ms / 1000, (client->timeout_ms % 1000) * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        err->esp_transport_sock_errno = errno;
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0) {
+        err->esp_tls_last_esp_err = ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST;
+    }
+    return sock;
+}
+
+/**
+ * @brief Open the connection and run the CONNECT / CONNACK exchange
+ * @return 0 when connected, -1 with err filled in otherwise
+ */
+static int do_connect(esp_mqtt_client_handle_t client, esp_mqtt_error_codes_t *err, bool *session_present)
+{
+    uint16_t alias_max = 0;
+    *session_present = false;
+
+    if (client->transport == MQTT_TRANSPORT_OVER_SSL || client->transport == MQTT_TRANSPORT_OVER_WS ||
+        client->transport == MQTT_TRANSPORT_OVER_WSS) {
+        ESP_LOGE(TAG, "Only MQTT over TCP is available on the host");
+        err->error_type = MQTT_ERROR_TYPE_TCP_TRANSPORT;
+        err->esp_tls_last_esp_err = ESP_ERR_NOT_SUPPORTED;
+        return -1;
+    }
+
+    if (client->loopback) {
+        alias_max = MQTT_HOST_LOOPBACK_ALIAS_MAX;
+    } else {
+        int sock = open_socket(client, err);
+        if (sock < 0) {
+            err->error_type = MQTT_ERROR_TYPE_TCP_TRANSPORT;
+            return -1;
+        }
+        client->sock = sock;
+
+        wbuf_t body = {0};
+        wb_str(&body, "MQTT", 4);
+        wb_u8(&body, client->v5 ? 5 : 4);
+        uint8_t flags = client->clean_session ? 0x02 : 0;
+        if (client->username) {
+            flags |= 0x80;
+        }
+        if (client->password) {
+            flags |= 0x40;
+        }
+        wb_u8(&body, flags);
+        wb_u16(&body, (uint16_t)client->keepalive_s);
+        if (client->v5) {
+            wb_varint(&body, 0);
+        }
+        wb_str(&body, client->client_id, strlen(client->client_id));
+        if (client->username) {
+            wb_str(&body, client->username, strlen(client->username));
+        }
+        if (client->password) {
+            wb_str(&body, client->password, strlen(client->password));
+        }
+        wbuf_t out = {0};
+        bool ok = wb_finish(&out, MQTT_CONNECT, &body) && send_all(client, out.buf, out.len) == 0;
+        free(body.buf);
+        free(out.buf);
+
+        uint8_t type = 0;
+        size_t len = 0;
+        uint8_t *packet = ok ? recv_packet(sock, &type, &len) : NULL;
+        if (!packet || (type & 0xF0) != MQTT_CONNACK) {
+            free(packet);
+            err->error_type = MQTT_ERROR_TYPE_TCP_TRANSPORT;
+            err->esp_transport_sock_errno = errno;
+            close_socket(client);
+            return -1;
+        }
+        rbuf_t r = { .p = packet, .left = len };
+        *session_present = rb_u8(&r) & 0x01;
+        uint8_t code = rb_u8(&r);
+        if (client->v5 && !r.failed && r.left) {
+            rb_properties(&r, &alias_max, NULL);
+        }
+        free(packet);
+        if (r.failed || code != 0) {
+            err->error_type = MQTT_ERROR_TYPE_CONNECTION_REFUSED;
+            err->connect_return_code = (esp_mqtt_connect_return_code_t)code;
+            close_socket(client);
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&client->lock);
+    clear_aliases(client);
+    if (client->v5) {
+        client->server_alias_max = alias_max;
+        client->alias_topics = calloc((size_t)alias_max + 1, sizeof(char *));
+    }
+    client->state = CLIENT_CONNECTED;
+    client->ping_sent_us = 0;
+    client->last_tx_us = esp_timer_get_time();
+    pthread_mutex_unlock(&client->lock);
+    atomic_fetch_add(&s_stat_connects, 1);
+    return 0;
+}
+
+/**
+ * @brief Send every unacknowledged message again after a reconnect
+ */
+static void resend_outbox(esp_mqtt_client_handle_t client)
+{
+    pthread_mutex_lock(&client->lock);
+    for (outbox_item_t *m = client->outbox; m; m = m->next) {
+        if (send_publish(client, m, 1, true) != 0) {
+            ESP_LOGW(TAG, "Could not resend message %d", m->msg_id);
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+}
+
+/**
+ * @brief Drop the connection and tell the application
+ */
+static void connection_lost(esp_mqtt_client_handle_t client, esp_mqtt_error_codes_t *err,
+                            esp_mqtt5_event_property_t *property)
+{
+    pthread_mutex_lock(&client->lock);
+    close_socket(client);
+    clear_loop_acks(client);
+    if (client->state != CLIENT_STOPPED) {
+        client->state = CLIENT_WAIT_RECONNECT;
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_EVENT_DISCONNECTED,
+        .error_handle = err,
+        .property = property,
+    };
+    dispatch(client, &event);
+}
+
+// ===== PACKET HANDLING =====
+
+static void ack_outbox(esp_mqtt_client_handle_t client, int msg_id)
+{
+    pthread_mutex_lock(&client->lock);
+    for (outbox_item_t **pp = &client->outbox; *pp; pp = &(*pp)->next) {
+        if ((*pp)->msg_id == msg_id) {
+            outbox_item_t *item = *pp;
+            *pp = item->next;
+            free_outbox_item(item);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+    atomic_fetch_add(&s_stat_acks, 1);
+}
+
+static void handle_publish(esp_mqtt_client_handle_t client, uint8_t type, const uint8_t *body, size_t len)
+{
+    rbuf_t r = { .p = body, .left = len };
+    int qos = (type >> 1) & 0x03;
+    uint16_t topic_len = rb_u16(&r);
+    const uint8_t *topic = rb_take(&r, topic_len);
+    int msg_id = qos > 0 ? rb_u16(&r) : 0;
+    if (client->v5 && !r.failed) {
+        rb_properties(&r, NULL, NULL);
+    }
+    if (r.failed) {
+        ESP_LOGW(TAG, "Malformed PUBLISH ignored");
+        return;
+    }
+    atomic_fetch_add(&s_stat_received, 1);
+
+    if (qos == 1) {
+        uint8_t ack[4] = { MQTT_PUBACK, 2, (uint8_t)(msg_id >> 8), (uint8_t)msg_id };
+        send_all(client, ack, sizeof(ack));
+    }
+
+    esp_mqtt5_event_property_t property = {0};
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_EVENT_DATA,
+        .topic = (char *)topic,
+        .topic_len = topic_len,
+        .data = (char *)r.p,
+        .data_len = (int)r.left,
+        .total_data_len = (int)r.left,
+        .msg_id = msg_id,
+        .qos = qos,
+        .retain = type & 0x01,
+        .dup = type & 0x08,
+        .property = &property,
+    };
+    dispatch(client, &event);
+}
+
+/**
+ * @brief Handle one packet from the broker
+ * @return false if the connection is gone
+ */
+static bool handle_packet(esp_mqtt_client_handle_t client, uint8_t type, const uint8_t *body, size_t len)
+{
+    rbuf_t r = { .p = body, .left = len };
+    switch (type & 0xF0) {
+        case MQTT_PUBLISH:
+            handle_publish(client, type, body, len);
+            return true;
+        case MQTT_PUBACK: {
+            int msg_id = rb_u16(&r);
+            ack_outbox(client, msg_id);
+            dispatch_simple(client, MQTT_EVENT_PUBLISHED, msg_id);
+            return true;
+        }
+        case MQTT_SUBACK & 0xF0:
+            dispatch_simple(client, MQTT_EVENT_SUBSCRIBED, rb_u16(&r));
+            return true;
+        case MQTT_UNSUBACK & 0xF0:
+            dispatch_simple(client, MQTT_EVENT_UNSUBSCRIBED, rb_u16(&r));
+            return true;
+        case MQTT_PINGRESP:
+            client->ping_sent_us = 0;
+            return true;
+        case MQTT_DISCONNECT: {
+            esp_mqtt_error_codes_t err = { .error_type = MQTT_ERROR_TYPE_NONE };
+            mqtt5_user_property_handle_t user = NULL;
+            if (client->v5 && r.left) {
+                err.disconnect_return_code = rb_u8(&r);
+                if (r.left) {
+                    rb_properties(&r, NULL, &user);
+                }
+            }
+            ESP_LOGW(TAG, "Broker sent DISCONNECT (reason 0x%02x)", err.disconnect_return_code);
+            esp_mqtt5_event_property_t property = { .user_property = user };
+            connection_lost(client, &err, &property);
+            esp_mqtt5_client_delete_user_property(user);
+            return false;
+        }
+        default:
+            ESP_LOGD(TAG, "Ignoring packet type 0x%02x", type);
+            return true;
+    }
+}
+
+/**
+ * @brief Serve a connected session until it ends or the client stops
+ */
+static void run_session(esp_mqtt_client_handle_t client)
+{
+    int64_t keepalive_us = (int64_t)client->keepalive_s * 1000000;
+
+    while (client->run) {
+        if (client->loopback) {
+            pthread_mutex_lock(&client->lock);
+            if (!client->loop_acks && client->run && client->state == CLIENT_CONNECTED) {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += MQTT_HOST_POLL_MS * 1000000L;
+                if (ts.tv_nsec >= 1000000000L) {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&client->cond, &client->lock, &ts);
+            }
+            loop_ack_t *acks = client->loop_acks;
+            client->loop_acks = NULL;
+            bool connected = client->state == CLIENT_CONNECTED;
+            pthread_mutex_unlock(&client->lock);
+            while (acks) {
+                loop_ack_t *ack = acks;
+                acks = ack->next;
+                if (ack->event_id == MQTT_EVENT_PUBLISHED) {
+                    ack_outbox(client, ack->msg_id);
+                }
+                dispatch_simple(client, ack->event_id, ack->msg_id);
+                free(ack);
+            }
+            if (!connected) {
+                return;
+            }
+            continue;
+        }
+
+        struct pollfd pfd = { .fd = client->sock, .events = POLLIN };
+        int ready = poll(&pfd, 1, MQTT_HOST_POLL_MS);
+        if (!client->run) {
+            return;
+        }
+        if (ready > 0) {
+            uint8_t type = 0;
+            size_t len = 0;
+            uint8_t *body = recv_packet(client->sock, &type, &len);
+            if (!body) {
+                esp_mqtt_error_codes_t err = {
+                    .error_type = MQTT_ERROR_TYPE_TCP_TRANSPORT,
+                    .esp_transport_sock_errno = errno,
+                };
+                ESP_LOGW(TAG, "Connection to broker lost");
+                esp_mqtt_event_t event = { .event_id = MQTT_EVENT_ERROR, .error_handle = &err };
+                dispatch(client, &event);
+                connection_lost(client, &err, NULL);
+                return;
+            }
+            bool alive = handle_packet(client, type, body, len);
+            free(body);
+            if (!alive) {
+                return;
+            }
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (keepalive_us > 0 && client->ping_sent_us &&
+            now - client->ping_sent_us > (int64_t)client->timeout_ms * 1000) {
+            ESP_LOGW(TAG, "No PINGRESP from broker");
+            esp_mqtt_error_codes_t err = { .error_type = MQTT_ERROR_TYPE_TCP_TRANSPORT };
+            connection_lost(client, &err, NULL);
+            return;
+        }
+        if (keepalive_us > 0 && !client->ping_sent_us && now - client->last_tx_us >= keepalive_us) {
+            uint8_t ping[2] = { MQTT_PINGREQ, 0 };
+            if (send_all(client, ping, sizeof(ping)) == 0) {
+                client->ping_sent_us = now;
+            }
+        }
+    }
+}
+
+static void *client_thread(void *arg)
+{
+    esp_mqtt_client_handle_t client = arg;
+
+    while (client->run) {
+        pthread_mutex_lock(&client->lock);
+        while (client->run && client->state == CLIENT_WAIT_RECONNECT && !client->reconnect_requested) {
+            if (client->auto_reconnect) {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_sec += client->reconnect_timeout_ms / 1000;
+                ts.tv_nsec += (client->reconnect_timeout_ms % 1000) * 1000000L;
+                if (ts.tv_nsec >= 1000000000L) {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000000000L;
+                }
+                if (pthread_cond_timedwait(&client->cond, &client->lock, &ts) == ETIMEDOUT) {
+                    break;
+                }
+            } else {
+                pthread_cond_wait(&client->cond, &client->lock);
+            }
+        }
+        client->reconnect_requested = false;
+        if (!client->run) {
+            pthread_mutex_unlock(&client->lock);
+            break;
+        }
+        client->state = CLIENT_CONNECTING;
+        pthread_mutex_unlock(&client->lock);
+
+        dispatch_simple(client, MQTT_EVENT_BEFORE_CONNECT, 0);
+
+        esp_mqtt_error_codes_t err = {0};
+        bool session_present = false;
+        if (do_connect(client, &err, &session_present) != 0) {
+            ESP_LOGD(TAG, "Connect to %s:%u failed", client->host, (unsigned)client->port);
+            esp_mqtt_event_t event = { .event_id = MQTT_EVENT_ERROR, .error_handle = &err };
+            dispatch(client, &event);
+            connection_lost(client, &err, NULL);
+            continue;
+        }
+
+        esp_mqtt_event_t event = { .event_id = MQTT_EVENT_CONNECTED, .session_present = session_present };
+        dispatch(client, &event);
+        resend_outbox(client);
+        run_session(client);
+    }
+
+    pthread_mutex_lock(&client->lock);
+    close_socket(client);
+    pthread_mutex_unlock(&client->lock);
+    return NULL;
+}
+
+// ===== PUBLIC API =====
+
+static char *dup_or_null(const char *s)
+{
+    return s ? strdup(s) : NULL;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    if (!config || !config->broker.address.hostname) {
+        ESP_LOGE(TAG, "Only broker.address.hostname is supported on the host");
+        return NULL;
+    }
+
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(*client));
+    if (!client) {
+        return NULL;
+    }
+
+    client->host = strdup(config->broker.address.hostname);
+    client->transport = config->broker.address.transport ? config->broker.address.transport
+                                                         : MQTT_TRANSPORT_OVER_TCP;
+    client->port = config->broker.address.port ? config->broker.address.port
+                 : client->transport == MQTT_TRANSPORT_OVER_SSL ? 8883 : 1883;
+    if (config->credentials.client_id && config->credentials.client_id[0]) {
+        client->client_id = strdup(config->credentials.client_id);
+    } else {
+        char id[32];
+        snprintf(id, sizeof(id), "ESP32_%08x", (unsigned)esp_timer_get_time());
+        client->client_id = strdup(id);
+    }
+    client->username = dup_or_null(config->credentials.username);
+    client->password = dup_or_null(config->credentials.authentication.password);
+    client->keepalive_s = config->session.disable_keepalive ? 0
+                        : config->session.keepalive ? config->session.keepalive
+                        : MQTT_HOST_DEFAULT_KEEPALIVE_S;
+    client->clean_session = !config->session.disable_clean_session;
+    client->v5 = config->session.protocol_ver == MQTT_PROTOCOL_V_5;
+    client->timeout_ms = config->network.timeout_ms ? config->network.timeout_ms : MQTT_HOST_DEFAULT_TIMEOUT_MS;
+    client->reconnect_timeout_ms = config->network.reconnect_timeout_ms ? config->network.reconnect_timeout_ms
+                                 : MQTT_HOST_DEFAULT_RECONNECT_MS;
+    client->auto_reconnect = !config->network.disable_auto_reconnect;
+    client->loopback = strcmp(client->host, ESP_HOST_MQTT_LOOPBACK) == 0;
+    client->transport_handle = config->network.transport;
+    client->sock = -1;
+    client->state = CLIENT_STOPPED;
+
+    if (!client->host || !client->client_id) {
+        esp_mqtt_client_destroy(client);
+        return NULL;
+    }
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&client->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&client->write_lock, NULL);
+    pthread_cond_init(&client->cond, NULL);
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (!client || event != MQTT_EVENT_ANY) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&client->lock);
+    if (client->state != CLIENT_STOPPED) {
+        pthread_mutex_unlock(&client->lock);
+        ESP_LOGE(TAG, "Client has started");
+        return ESP_FAIL;
+    }
+    client->state = CLIENT_CONNECTING;
+    client->run = true;
+    pthread_mutex_unlock(&client->lock);
+
+    if (pthread_create(&client->thread, NULL, client_thread, client) != 0) {
+        client->run = false;
+        client->state = CLIENT_STOPPED;
+        return ESP_FAIL;
+    }
+    client->thread_started = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&client->lock);
+    esp_err_t ret = ESP_FAIL;
+    if (client->state == CLIENT_WAIT_RECONNECT) {
+        client->reconnect_requested = true;
+        pthread_cond_broadcast(&client->cond);
+        ret = ESP_OK;
+    }
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&client->lock);
+    if (client->state == CLIENT_CONNECTED) {
+        uint8_t packet[2] = { MQTT_DISCONNECT, 0 };
+        send_all(client, packet, sizeof(packet));
+        if (client->sock >= 0) {
+            shutdown(client->sock, SHUT_RDWR);
+        } else {
+            client->state = CLIENT_WAIT_RECONNECT;
+            pthread_cond_broadcast(&client->cond);
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->thread_started && pthread_equal(pthread_self(), client->thread)) {
+        ESP_LOGE(TAG, "Client cannot be stopped from the MQTT task");
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&client->lock);
+    if (client->state == CLIENT_STOPPED) {
+        pthread_mutex_unlock(&client->lock);
+        return ESP_FAIL;
+    }
+    if (client->state == CLIENT_CONNECTED) {
+        uint8_t packet[2] = { MQTT_DISCONNECT, 0 };
+        send_all(client, packet, sizeof(packet));
+    }
+    client->run = false;
+    client->state = CLIENT_STOPPED;
+    pthread_cond_broadcast(&client->cond);
+    pthread_mutex_unlock(&client->lock);
+
+    if (client->thread_started) {
+        pthread_join(client->thread, NULL);
+        client->thread_started = false;
+    }
+    pthread_mutex_lock(&client->lock);
+    clear_loop_acks(client);
+    clear_aliases(client);
+    pthread_mutex_unlock(&client->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->state != CLIENT_STOPPED) {
+        esp_mqtt_client_stop(client);
+    }
+    if (client->host) {
+        // Fully initialized: the sync objects exist
+        dispatch_simple(client, MQTT_EVENT_DELETED, 0);
+        pthread_mutex_destroy(&client->lock);
+        pthread_mutex_destroy(&client->write_lock);
+        pthread_cond_destroy(&client->cond);
+    }
+    while (client->outbox) {
+        outbox_item_t *item = client->outbox;
+        client->outbox = item->next;
+        free_outbox_item(item);
+    }
+    esp_transport_destroy(client->transport_handle);
+    free(client->publish_content_type);
+    free(client->host);
+    free(client->client_id);
+    free(client->username);
+    free(client->password);
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    if (!client || !topic) {
+        return -1;
+    }
+    pthread_mutex_lock(&client->lock);
+    if (client->state != CLIENT_CONNECTED) {
+        pthread_mutex_unlock(&client->lock);
+        return -1;
+    }
+    int msg_id = next_msg_id(client);
+    wbuf_t body = {0};
+    wb_u16(&body, (uint16_t)msg_id);
+    if (client->v5) {
+        wb_varint(&body, 0);
+    }
+    wb_str(&body, topic, strlen(topic));
+    wb_u8(&body, (uint8_t)qos);
+    wbuf_t out = {0};
+    bool ok = wb_finish(&out, MQTT_SUBSCRIBE, &body) && send_all(client, out.buf, out.len) == 0;
+    if (ok && client->loopback) {
+        loop_ack_push(client, MQTT_EVENT_SUBSCRIBED, msg_id);
+    }
+    pthread_mutex_unlock(&client->lock);
+    free(body.buf);
+    free(out.buf);
+    return ok ? msg_id : -1;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic)
+{
+    if (!client || !topic) {
+        return -1;
+    }
+    pthread_mutex_lock(&client->lock);
+    if (client->state != CLIENT_CONNECTED) {
+        pthread_mutex_unlock(&client->lock);
+        return -1;
+    }
+    int msg_id = next_msg_id(client);
+    wbuf_t body = {0};
+    wb_u16(&body, (uint16_t)msg_id);
+    if (client->v5) {
+        wb_varint(&body, 0);
+    }
+    wb_str(&body, topic, strlen(topic));
+    wbuf_t out = {0};
+    bool ok = wb_finish(&out, MQTT_UNSUBSCRIBE, &body) && send_all(client, out.buf, out.len) == 0;
+    if (ok && client->loopback) {
+        loop_ack_push(client, MQTT_EVENT_UNSUBSCRIBED, msg_id);
+    }
+    pthread_mutex_unlock(&client->lock);
+    free(body.buf);
+    free(out.buf);
+    return ok ? msg_id : -1;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain)
+{
+    if (!client || !topic) {
+        return -1;
+    }
+    if (qos > 1) {
+        ESP_LOGE(TAG, "QoS 2 is not implemented on the host");
+        return -1;
+    }
+    if (len <= 0) {
+        len = data ? (int)strlen(data) : 0;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    const esp_mqtt5_publish_property_config_t *prop = &client->publish_property;
+    outbox_item_t msg = {
+        .msg_id = qos > 0 ? next_msg_id(client) : 0,
+        .retain = retain,
+        .utf8_payload = client->v5 && prop->payload_format_indicator,
+        .expiry_s = client->v5 ? prop->message_expiry_interval : 0,
+        .topic_alias = client->v5 ? prop->topic_alias : 0,
+        .content_type = client->v5 ? client->publish_content_type : NULL,
+        .topic = (char *)topic,
+        .data = (uint8_t *)data,
+        .len = len,
+    };
+
+    if (msg.topic_alias && client->state == CLIENT_CONNECTED && msg.topic_alias > client->server_alias_max) {
+        ESP_LOGE(TAG, "Topic alias %u exceeds the broker maximum %u",
+                 msg.topic_alias, client->server_alias_max);
+        pthread_mutex_unlock(&client->lock);
+        return -1;
+    }
+
+    if (qos == 0) {
+        int ret = client->state == CLIENT_CONNECTED ? send_publish(client, &msg, 0, false) : -1;
+        pthread_mutex_unlock(&client->lock);
+        return ret == 0 ? 0 : -1;
+    }
+
+    // QoS 1: keep a copy until acknowledged, even while disconnected
+    outbox_item_t *item = calloc(1, sizeof(*item));
+    if (item) {
+        *item = msg;
+        item->content_type = dup_or_null(msg.content_type);
+        item->topic = strdup(topic);
+        item->data = malloc(len ? (size_t)len : 1);
+    }
+    if (!item || !item->topic || !item->data || (msg.content_type && !item->content_type)) {
+        if (item) {
+            free_outbox_item(item);
+        }
+        pthread_mutex_unlock(&client->lock);
+        return -1;
+    }
+    if (len) {
+        memcpy(item->data, data, (size_t)len);
+    }
+    item->wire_len = len + (int)strlen(topic) + 16;
+    outbox_item_t **tail = &client->outbox;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = item;
+
+    if (client->state == CLIENT_CONNECTED && send_publish(client, item, 1, false) != 0) {
+        ESP_LOGW(TAG, "Publish failed, message %d stays in the outbox", item->msg_id);
+    }
+    int msg_id = item->msg_id;
+    pthread_mutex_unlock(&client->lock);
+    return msg_id;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain, bool store)
+{
+    (void)store;
+    return esp_mqtt_client_publish(client, topic, data, len, qos, retain);
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return 0;
+    }
+    int size = 0;
+    pthread_mutex_lock(&client->lock);
+    for (outbox_item_t *m = client->outbox; m; m = m->next) {
+        size += m->wire_len;
+    }
+    pthread_mutex_unlock(&client->lock);
+    return size;
+}
+
+// ===== MQTT V5 PROPERTIES =====
+
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t client,
+                                                const esp_mqtt5_publish_property_config_t *property)
+{
+    if (!client || !property) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!client->v5) {
+        ESP_LOGE(TAG, "MQTT protocol version is not v5");
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&client->lock);
+    char *content_type = dup_or_null(property->content_type);
+    free(client->publish_content_type);
+    client->publish_content_type = content_type;
+    client->publish_property = *property;
+    client->publish_property.content_type = content_type;
+    pthread_mutex_unlock(&client->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt5_client_set_user_property(mqtt5_user_property_handle_t *user_property,
+                                             esp_mqtt5_user_property_item_t item[], uint8_t item_num)
+{
+    if (!user_property || (!item && item_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!*user_property) {
+        *user_property = calloc(1, sizeof(struct mqtt5_user_property_list_t));
+        if (!*user_property) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    struct mqtt5_user_property_list_t *list = *user_property;
+    for (uint8_t i = 0; i < item_num; i++) {
+        if (list->count == UINT8_MAX) {
+            return ESP_ERR_NO_MEM;
+        }
+        char *key = strdup(item[i].key);
+        char *value = strdup(item[i].value);
+        if (!key || !value) {
+            free(key);
+            free(value);
+            return ESP_ERR_NO_MEM;
+        }
+        list->items[list->count].key = key;
+        list->items[list->count].value = value;
+        list->count++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt5_client_get_user_property(mqtt5_user_property_handle_t user_property,
+                                             esp_mqtt5_user_property_item_t *item, uint8_t *item_num)
+{
+    if (!user_property || !item || !item_num) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (*item_num < user_property->count) {
+        return ESP_FAIL;
+    }
+    for (uint8_t i = 0; i < user_property->count; i++) {
+        item[i].key = strdup(user_property->items[i].key);
+        item[i].value = strdup(user_property->items[i].value);
+    }
+    *item_num = user_property->count;
+    return ESP_OK;
+}
+
+uint8_t esp_mqtt5_client_get_user_property_count(mqtt5_user_property_handle_t user_property)
+{
+    return user_property ? user_property->count : 0;
+}
+
+void esp_mqtt5_client_delete_user_property(mqtt5_user_property_handle_t user_property)
+{
+    if (!user_property) {
+        return;
+    }
+    for (uint8_t i = 0; i < user_property->count; i++) {
+        free((char *)user_property->items[i].key);
+        free((char *)user_property->items[i].value);
+    }
+    free(user_property);
+}
@@ -0,0 +1,252 @@
+/**
+ * @file esp_ota_host.c
+ * @brief Host shim: in-memory app partitions and the OTA operations on them
+ */
+
+#include <esp_partition.h>
+#include <esp_ota_ops.h>
+#include <esp_log.h>
+#include <pthread.h>
+#include <string.h>
+
+#define OTA_HOST_HANDLES_MAX    2
+
+static const char *TAG = "esp_ota_host";
+
+static const esp_partition_t s_partitions[2] = {
+    {
+        .type = ESP_PARTITION_TYPE_APP,
+        .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0,
+        .address = 0x10000,
+        .size = ESP_HOST_APP_PARTITION_SIZE,
+        .erase_size = 4096,
+        .label = "ota_0",
+    },
+    {
+        .type = ESP_PARTITION_TYPE_APP,
+        .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_1,
+        .address = 0x10000 + ESP_HOST_APP_PARTITION_SIZE,
+        .size = ESP_HOST_APP_PARTITION_SIZE,
+        .erase_size = 4096,
+        .label = "ota_1",
+    },
+};
+
+static uint8_t s_flash[2][ESP_HOST_APP_PARTITION_SIZE];
+
+typedef struct {
+    bool used;
+    const esp_partition_t *partition;
+    size_t offset;              ///< Next byte written
+} ota_host_handle_t;
+
+static pthread_mutex_t s_ota_lock = PTHREAD_MUTEX_INITIALIZER;
+static ota_host_handle_t s_handles[OTA_HOST_HANDLES_MAX];
+static const esp_partition_t *s_boot = &s_partitions[0];
+
+static const esp_app_desc_t s_app_desc = {
+    .magic_word = 0xABCD5432,
+    .version = "1.0.0-host",
+    .project_name = "csi-firmware",
+    .time = __TIME__,
+    .date = __DATE__,
+    .idf_ver = "host",
+};
+
+// ===== PARTITIONS =====
+
+static uint8_t *partition_data(const esp_partition_t *partition)
+{
+    for (int i = 0; i < 2; i++) {
+        if (partition == &s_partitions[i]) {
+            return s_flash[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t partition_check(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!partition_data(partition)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    esp_err_t ret = partition_check(partition, src_offset, size);
+    if (ret == ESP_OK) {
+        pthread_mutex_lock(&s_ota_lock);
+        memcpy(dst, partition_data(partition) + src_offset, size);
+        pthread_mutex_unlock(&s_ota_lock);
+    }
+    return ret;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    esp_err_t ret = partition_check(partition, dst_offset, size);
+    if (ret == ESP_OK) {
+        pthread_mutex_lock(&s_ota_lock);
+        memcpy(partition_data(partition) + dst_offset, src, size);
+        pthread_mutex_unlock(&s_ota_lock);
+    }
+    return ret;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    esp_err_t ret = partition_check(partition, offset, size);
+    if (ret == ESP_OK) {
+        pthread_mutex_lock(&s_ota_lock);
+        memset(partition_data(partition) + offset, 0xff, size);
+        pthread_mutex_unlock(&s_ota_lock);
+    }
+    return ret;
+}
+
+// ===== OTA =====
+
+const esp_app_desc_t *esp_ota_get_app_description(void)
+{
+    return &s_app_desc;
+}
+
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc)
+{
+    if (!partition_data(partition) || !app_desc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (partition != esp_ota_get_running_partition()) {
+        // Written images are not parsed
+        return ESP_ERR_NOT_FOUND;
+    }
+    *app_desc = s_app_desc;
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &s_partitions[0];
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+    pthread_mutex_lock(&s_ota_lock);
+    const esp_partition_t *boot = s_boot;
+    pthread_mutex_unlock(&s_ota_lock);
+    return boot;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    if (!start_from) {
+        start_from = esp_ota_get_running_partition();
+    }
+    return start_from == &s_partitions[0] ? &s_partitions[1] : &s_partitions[0];
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    if (!partition_data(partition)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_ota_lock);
+    s_boot = partition;
+    pthread_mutex_unlock(&s_ota_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Open a write handle at an offset, erasing everything after it
+ */
+static esp_err_t ota_open(const esp_partition_t *partition, size_t offset, esp_ota_handle_t *out_handle)
+{
+    if (!out_handle || !partition_data(partition) || offset > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (partition == esp_ota_get_running_partition()) {
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+    }
+
+    pthread_mutex_lock(&s_ota_lock);
+    for (int i = 0; i < OTA_HOST_HANDLES_MAX; i++) {
+        if (!s_handles[i].used) {
+            s_handles[i] = (ota_host_handle_t){ .used = true, .partition = partition, .offset = offset };
+            memset(partition_data(partition) + offset, 0xff, partition->size - offset);
+            pthread_mutex_unlock(&s_ota_lock);
+            *out_handle = (esp_ota_handle_t)(i + 1);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_ota_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (partition && image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES &&
+        image_size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ota_open(partition, 0, out_handle);
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *partition, const size_t erase_size,
+                         const size_t image_offset, esp_ota_handle_t *out_handle)
+{
+    (void)erase_size;
+    return ota_open(partition, image_offset, out_handle);
+}
+
+static ota_host_handle_t *ota_handle_get(esp_ota_handle_t handle)
+{
+    if (handle == 0 || handle > OTA_HOST_HANDLES_MAX || !s_handles[handle - 1].used) {
+        return NULL;
+    }
+    return &s_handles[handle - 1];
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    pthread_mutex_lock(&s_ota_lock);
+    ota_host_handle_t *ota = ota_handle_get(handle);
+    if (!ota) {
+        pthread_mutex_unlock(&s_ota_lock);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size > ota->partition->size - ota->offset) {
+        pthread_mutex_unlock(&s_ota_lock);
+        ESP_LOGE(TAG, "Write past the end of %s", ota->partition->label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(partition_data(ota->partition) + ota->offset, data, size);
+    ota->offset += size;
+    pthread_mutex_unlock(&s_ota_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    return esp_ota_abort(handle);
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    pthread_mutex_lock(&s_ota_lock);
+    ota_host_handle_t *ota = ota_handle_get(handle);
+    if (ota) {
+        ota->used = false;
+    }
+    pthread_mutex_unlock(&s_ota_lock);
+    return ota ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,300 @@
+/**
+ * @file esp_system_host.c
+ * @brief Host shim: error names, logging, heap, MAC, random and restart
+ */
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_random.h>
+#include <esp_rom_crc.h>
+#include <esp_mac.h>
+#include <esp_timer.h>
+#include <esp_host.h>
+#include <esp_ota_ops.h>
+#include <esp_http_client.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/random.h>
+
+#define LOG_TAG_LEVELS_MAX      32
+#define SHUTDOWN_HANDLERS_MAX   5
+#define HOST_DEFAULT_FREE_HEAP  (180 * 1024)
+
+static const char *TAG = "esp_system_host";
+
+// ===== ERRORS =====
+
+typedef struct {
+    esp_err_t code;
+    const char *name;
+} esp_err_msg_t;
+
+#define ERR_TBL_IT(err) { err, #err }
+
+static const esp_err_msg_t s_err_names[] = {
+    ERR_TBL_IT(ESP_OK),
+    ERR_TBL_IT(ESP_FAIL),
+    ERR_TBL_IT(ESP_ERR_NO_MEM),
+    ERR_TBL_IT(ESP_ERR_INVALID_ARG),
+    ERR_TBL_IT(ESP_ERR_INVALID_STATE),
+    ERR_TBL_IT(ESP_ERR_INVALID_SIZE),
+    ERR_TBL_IT(ESP_ERR_NOT_FOUND),
+    ERR_TBL_IT(ESP_ERR_NOT_SUPPORTED),
+    ERR_TBL_IT(ESP_ERR_TIMEOUT),
+    ERR_TBL_IT(ESP_ERR_INVALID_RESPONSE),
+    ERR_TBL_IT(ESP_ERR_INVALID_CRC),
+    ERR_TBL_IT(ESP_ERR_INVALID_VERSION),
+    ERR_TBL_IT(ESP_ERR_INVALID_MAC),
+    ERR_TBL_IT(ESP_ERR_NOT_FINISHED),
+    ERR_TBL_IT(ESP_ERR_NOT_ALLOWED),
+    { ESP_ERR_NVS_BASE + 0x01, "ESP_ERR_NVS_NOT_INITIALIZED" },
+    { ESP_ERR_NVS_BASE + 0x02, "ESP_ERR_NVS_NOT_FOUND" },
+    { ESP_ERR_NVS_BASE + 0x03, "ESP_ERR_NVS_TYPE_MISMATCH" },
+    { ESP_ERR_NVS_BASE + 0x04, "ESP_ERR_NVS_READ_ONLY" },
+    { ESP_ERR_NVS_BASE + 0x05, "ESP_ERR_NVS_NOT_ENOUGH_SPACE" },
+    { ESP_ERR_NVS_BASE + 0x06, "ESP_ERR_NVS_INVALID_NAME" },
+    { ESP_ERR_NVS_BASE + 0x07, "ESP_ERR_NVS_INVALID_HANDLE" },
+    { ESP_ERR_NVS_BASE + 0x09, "ESP_ERR_NVS_KEY_TOO_LONG" },
+    { ESP_ERR_NVS_BASE + 0x0c, "ESP_ERR_NVS_INVALID_LENGTH" },
+    { ESP_ERR_NVS_BASE + 0x0d, "ESP_ERR_NVS_NO_FREE_PAGES" },
+    { ESP_ERR_NVS_BASE + 0x0e, "ESP_ERR_NVS_VALUE_TOO_LONG" },
+    { ESP_ERR_NVS_BASE + 0x10, "ESP_ERR_NVS_NEW_VERSION_FOUND" },
+    ERR_TBL_IT(ESP_ERR_OTA_PARTITION_CONFLICT),
+    ERR_TBL_IT(ESP_ERR_OTA_VALIDATE_FAILED),
+    ERR_TBL_IT(ESP_ERR_HTTP_CONNECT),
+    ERR_TBL_IT(ESP_ERR_HTTP_FETCH_HEADER),
+    ERR_TBL_IT(ESP_ERR_HTTP_CONNECTION_CLOSED),
+    { ESP_ERR_HTTPD_BASE + 1, "ESP_ERR_HTTPD_HANDLERS_FULL" },
+    { ESP_ERR_HTTPD_BASE + 2, "ESP_ERR_HTTPD_HANDLER_EXISTS" },
+    { ESP_ERR_HTTPD_BASE + 3, "ESP_ERR_HTTPD_INVALID_REQ" },
+    { ESP_ERR_HTTPD_BASE + 4, "ESP_ERR_HTTPD_RESULT_TRUNC" },
+    { ESP_ERR_HTTPD_BASE + 5, "ESP_ERR_HTTPD_RESP_HDR" },
+    { ESP_ERR_HTTPD_BASE + 6, "ESP_ERR_HTTPD_RESP_SEND" },
+    { ESP_ERR_HTTPD_BASE + 7, "ESP_ERR_HTTPD_ALLOC_MEM" },
+    { ESP_ERR_HTTPD_BASE + 8, "ESP_ERR_HTTPD_TASK" },
+};
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    for (size_t i = 0; i < sizeof(s_err_names) / sizeof(s_err_names[0]); i++) {
+        if (s_err_names[i].code == code) {
+            return s_err_names[i].name;
+        }
+    }
+    return "UNKNOWN ERROR";
+}
+
+// ===== LOGGING =====
+
+typedef struct {
+    char tag[32];
+    esp_log_level_t level;
+} log_tag_level_t;
+
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static log_tag_level_t s_log_tags[LOG_TAG_LEVELS_MAX];
+static int s_log_tag_count;
+static esp_log_level_t s_log_default = ESP_LOG_INFO;
+
+__attribute__((constructor))
+static void esp_log_env_init(void)
+{
+    const char *env = getenv("CSI_HOST_LOG_LEVEL");
+    if (!env) {
+        return;
+    }
+    static const struct { const char *name; esp_log_level_t level; } names[] = {
+        { "NONE", ESP_LOG_NONE }, { "E", ESP_LOG_ERROR }, { "W", ESP_LOG_WARN },
+        { "I", ESP_LOG_INFO }, { "D", ESP_LOG_DEBUG }, { "V", ESP_LOG_VERBOSE },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcasecmp(env, names[i].name) == 0) {
+            s_log_default = names[i].level;
+        }
+    }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&s_log_lock);
+    if (strcmp(tag, "*") == 0) {
+        s_log_default = level;
+        s_log_tag_count = 0;
+        pthread_mutex_unlock(&s_log_lock);
+        return;
+    }
+    for (int i = 0; i < s_log_tag_count; i++) {
+        if (strcmp(s_log_tags[i].tag, tag) == 0) {
+            s_log_tags[i].level = level;
+            pthread_mutex_unlock(&s_log_lock);
+            return;
+        }
+    }
+    if (s_log_tag_count < LOG_TAG_LEVELS_MAX) {
+        snprintf(s_log_tags[s_log_tag_count].tag, sizeof(s_log_tags[0].tag), "%s", tag);
+        s_log_tags[s_log_tag_count].level = level;
+        s_log_tag_count++;
+    }
+    pthread_mutex_unlock(&s_log_lock);
+}
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    pthread_mutex_lock(&s_log_lock);
+    esp_log_level_t level = s_log_default;
+    for (int i = 0; i < s_log_tag_count; i++) {
+        if (strcmp(s_log_tags[i].tag, tag) == 0) {
+            level = s_log_tags[i].level;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_log_lock);
+    return level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)level;
+    (void)tag;
+    va_list args;
+    va_start(args, format);
+    flockfile(stderr);
+    vfprintf(stderr, format, args);
+    funlockfile(stderr);
+    va_end(args);
+}
+
+// ===== HEAP =====
+
+static volatile uint32_t s_free_heap = HOST_DEFAULT_FREE_HEAP;
+static volatile uint32_t s_min_free_heap = HOST_DEFAULT_FREE_HEAP;
+
+void esp_host_set_free_heap(uint32_t bytes)
+{
+    s_free_heap = bytes;
+    if (bytes < s_min_free_heap) {
+        s_min_free_heap = bytes;
+    }
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return s_free_heap;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return s_min_free_heap;
+}
+
+// ===== IDENTITY AND RANDOM =====
+
+static uint8_t s_base_mac[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+
+void esp_host_set_base_mac(const uint8_t mac[6])
+{
+    memcpy(s_base_mac, mac, 6);
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    if (!mac || type > ESP_MAC_ETH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(mac, s_base_mac, 6);
+    mac[5] += (uint8_t)type;
+    return ESP_OK;
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = getrandom(p, len, 0);
+        if (n <= 0) {
+            abort();
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+uint32_t esp_random(void)
+{
+    uint32_t value;
+    esp_fill_random(&value, sizeof(value));
+    return value;
+}
+
+// ===== ROM =====
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// ===== RESTART =====
+
+static shutdown_handler_t s_shutdown_handlers[SHUTDOWN_HANDLERS_MAX];
+static volatile bool s_trap_restart;
+static uint32_t s_restart_count;
+
+void esp_host_trap_restart(bool trap)
+{
+    s_trap_restart = trap;
+}
+
+uint32_t esp_host_restart_count(void)
+{
+    return __atomic_load_n(&s_restart_count, __ATOMIC_RELAXED);
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle)
+{
+    for (int i = 0; i < SHUTDOWN_HANDLERS_MAX; i++) {
+        if (s_shutdown_handlers[i] == handle) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (!s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i] = handle;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void esp_restart(void)
+{
+    if (s_trap_restart) {
+        ESP_LOGW(TAG, "esp_restart() called, ending task %s", pcTaskGetName(NULL));
+        __atomic_add_fetch(&s_restart_count, 1, __ATOMIC_RELAXED);
+        vTaskDelete(NULL);
+    }
+    ESP_LOGW(TAG, "esp_restart() called, exiting");
+    for (int i = SHUTDOWN_HANDLERS_MAX - 1; i >= 0; i--) {
+        if (s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i]();
+        }
+    }
+    fflush(NULL);
+    _Exit(0);
+}
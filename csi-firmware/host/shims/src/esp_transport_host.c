@@ -0,0 +1,51 @@
+/**
+ * @file esp_transport_host.c
+ * @brief Host shim: transport handle bookkeeping
+ */
+
+#include <esp_transport.h>
+#include <stdlib.h>
+
+struct esp_transport_item_t {
+    int default_port;
+    void *context;
+};
+
+esp_transport_handle_t esp_transport_init(void)
+{
+    return calloc(1, sizeof(struct esp_transport_item_t));
+}
+
+esp_err_t esp_transport_destroy(esp_transport_handle_t t)
+{
+    free(t);
+    return ESP_OK;
+}
+
+esp_err_t esp_transport_set_default_port(esp_transport_handle_t t, int port)
+{
+    if (!t) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->default_port = port;
+    return ESP_OK;
+}
+
+int esp_transport_get_default_port(esp_transport_handle_t t)
+{
+    return t ? t->default_port : -1;
+}
+
+esp_err_t esp_transport_set_context_data(esp_transport_handle_t t, void *data)
+{
+    if (!t) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->context = data;
+    return ESP_OK;
+}
+
+void *esp_transport_get_context_data(esp_transport_handle_t t)
+{
+    return t ? t->context : NULL;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file esp_wifi_host.c
+ * @brief Host shim: CSI callback registration and delivery
+ */
+
+#include <esp_wifi.h>
+#include <esp_host.h>
+#include <pthread.h>
+
+// Held across a delivery so unregistering waits for a callback in flight,
+// as the driver does
+static pthread_mutex_t s_csi_lock = PTHREAD_MUTEX_INITIALIZER;
+static wifi_csi_cb_t s_csi_cb;
+static void *s_csi_ctx;
+static wifi_csi_config_t s_csi_config;
+static bool s_csi_enabled;
+
+esp_err_t esp_wifi_set_csi_rx_cb(wifi_csi_cb_t cb, void *ctx)
+{
+    pthread_mutex_lock(&s_csi_lock);
+    s_csi_cb = cb;
+    s_csi_ctx = ctx;
+    pthread_mutex_unlock(&s_csi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_csi_config(const wifi_csi_config_t *config)
+{
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_csi_lock);
+    s_csi_config = *config;
+    pthread_mutex_unlock(&s_csi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_csi(bool en)
+{
+    pthread_mutex_lock(&s_csi_lock);
+    s_csi_enabled = en;
+    pthread_mutex_unlock(&s_csi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (!ap_info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_ERR_WIFI_NOT_CONNECT;
+}
+
+bool esp_host_wifi_csi_enabled(void)
+{
+    pthread_mutex_lock(&s_csi_lock);
+    bool enabled = s_csi_enabled && s_csi_cb;
+    pthread_mutex_unlock(&s_csi_lock);
+    return enabled;
+}
+
+bool esp_host_wifi_deliver_csi(wifi_csi_info_t *info)
+{
+    pthread_mutex_lock(&s_csi_lock);
+    bool delivered = s_csi_enabled && s_csi_cb;
+    if (delivered) {
+        s_csi_cb(s_csi_ctx, info);
+    }
+    pthread_mutex_unlock(&s_csi_lock);
+    return delivered;
+}
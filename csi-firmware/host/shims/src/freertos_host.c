@@ -0,0 +1,919 @@
+/**
+ * @file freertos_host.c
+ * @brief Host shim: FreeRTOS tasks, queues, semaphores, event groups and timers on pthreads
+ *
+ * Every blocking call waits in slices of FREERTOS_HOST_SLICE_MS so a task
+ * marked for deletion notices within one slice and leaves; see task.h.
+ */
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <freertos/timers.h>
+#include <esp_log.h>
+#include <esp_host.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FREERTOS_HOST_SLICE_MS          10
+#define FREERTOS_HOST_DELETE_WAIT_MS    2000
+
+static const char *TAG = "freertos_host";
+
+struct freertos_host_task {
+    struct freertos_host_task *next;    ///< All tasks, for the life of the process
+    pthread_t thread;
+    char name[16];
+    TaskFunction_t code;
+    void *parameters;
+    UBaseType_t priority;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_value;
+    volatile bool delete_requested;
+    volatile bool exited;
+};
+
+struct freertos_host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+typedef enum {
+    SEM_BINARY,
+    SEM_COUNTING,
+    SEM_MUTEX,
+    SEM_RECURSIVE,
+} sem_kind_t;
+
+struct freertos_host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    sem_kind_t kind;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    TaskHandle_t holder;
+    UBaseType_t recursion;
+};
+
+struct freertos_host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+struct freertos_host_timer {
+    struct freertos_host_timer *next;   ///< All timers, for the life of the process
+    char name[16];
+    TickType_t period;
+    bool auto_reload;
+    void *timer_id;
+    TimerCallbackFunction_t callback;
+    bool active;
+    uint64_t expiry_us;
+};
+
+// Task records are never freed, so a stale handle never dangles
+static pthread_mutex_t s_tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct freertos_host_task *s_tasks;
+static UBaseType_t s_task_count;
+static __thread struct freertos_host_task *s_self;
+static uint32_t s_task_create_failures;    // esp_host_fail_task_create()
+
+// ===== TIME =====
+
+static uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t s_start_us;
+
+__attribute__((constructor))
+static void freertos_host_clock_init(void)
+{
+    s_start_us = monotonic_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)(monotonic_us() - s_start_us);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)((monotonic_us() - s_start_us) * configTICK_RATE_HZ / 1000000ULL);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+/**
+ * @brief Absolute deadline of a wait, or 0 for none
+ */
+static uint64_t deadline_for(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        return 0;
+    }
+    return monotonic_us() + (uint64_t)ticks * 1000000ULL / configTICK_RATE_HZ;
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void freertos_host_mux_init(portMUX_TYPE *mux)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mux->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+// ===== TASKS =====
+
+static struct freertos_host_task *task_alloc(const char *name)
+{
+    struct freertos_host_task *task = calloc(1, sizeof(*task));
+    if (!task) {
+        return NULL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name ? name : "");
+    pthread_mutex_init(&task->lock, NULL);
+    cond_init(&task->cond);
+
+    pthread_mutex_lock(&s_tasks_lock);
+    task->next = s_tasks;
+    s_tasks = task;
+    s_task_count++;
+    pthread_mutex_unlock(&s_tasks_lock);
+    return task;
+}
+
+/**
+ * @brief Task record of the calling thread
+ *
+ * Threads not started by xTaskCreate() (main, the simulated radio) get a
+ * record on first use.
+ */
+static struct freertos_host_task *task_self(void)
+{
+    if (!s_self) {
+        char name[16] = "main";
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        s_self = task_alloc(name);
+        if (!s_self) {
+            abort();
+        }
+        s_self->thread = pthread_self();
+    }
+    return s_self;
+}
+
+static void task_exit(void) __attribute__((noreturn));
+
+static void task_exit(void)
+{
+    struct freertos_host_task *self = task_self();
+    pthread_mutex_lock(&s_tasks_lock);
+    s_task_count--;
+    pthread_mutex_unlock(&s_tasks_lock);
+    self->exited = true;
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Leave if another task deleted the caller; only called with no lock held
+ */
+static void task_check_deleted(void)
+{
+    if (s_self && s_self->delete_requested) {
+        task_exit();
+    }
+}
+
+/**
+ * @brief Wait on a condition for one slice, bounded by a deadline
+ * @return false once the deadline has passed
+ */
+static bool wait_slice(pthread_cond_t *cond, pthread_mutex_t *lock, uint64_t deadline_us)
+{
+    uint64_t now = monotonic_us();
+    if (deadline_us && now >= deadline_us) {
+        return false;
+    }
+    uint64_t until = now + FREERTOS_HOST_SLICE_MS * 1000ULL;
+    if (deadline_us && deadline_us < until) {
+        until = deadline_us;
+    }
+    struct timespec ts = {
+        .tv_sec = until / 1000000ULL,
+        .tv_nsec = (until % 1000000ULL) * 1000,
+    };
+    pthread_cond_timedwait(cond, lock, &ts);
+    return true;
+}
+
+static void *task_entry(void *arg)
+{
+    struct freertos_host_task *task = arg;
+    s_self = task;
+    pthread_setname_np(pthread_self(), task->name);
+
+    task->code(task->parameters);
+
+    // Returning from a task function aborts on the device
+    ESP_LOGE(TAG, "Task %s returned from its function", task->name);
+    abort();
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth,
+                                   void *parameters, UBaseType_t priority, TaskHandle_t *created_task,
+                                   BaseType_t core_id)
+{
+    (void)core_id;
+    uint32_t failures = __atomic_load_n(&s_task_create_failures, __ATOMIC_RELAXED);
+    while (failures > 0) {
+        if (__atomic_compare_exchange_n(&s_task_create_failures, &failures, failures - 1,
+                                        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return pdFAIL;
+        }
+    }
+
+    struct freertos_host_task *task = task_alloc(name);
+    if (!task) {
+        return pdFAIL;
+    }
+    task->code = task_code;
+    task->parameters = parameters;
+    task->priority = priority;
+
+    // Host code paths (printf, libc) need more stack than the firmware budgets
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    size_t stack = stack_depth * 4 < 256 * 1024 ? 256 * 1024 : stack_depth * 4;
+    pthread_attr_setstacksize(&attr, stack);
+
+    // Publish the handle before the task can run, as FreeRTOS does
+    if (created_task) {
+        *created_task = task;
+    }
+    int ret = pthread_create(&task->thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        if (created_task) {
+            *created_task = NULL;
+        }
+        task->exited = true;
+        pthread_mutex_lock(&s_tasks_lock);
+        s_task_count--;
+        pthread_mutex_unlock(&s_tasks_lock);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void esp_host_fail_task_create(uint32_t count)
+{
+    __atomic_store_n(&s_task_create_failures, count, __ATOMIC_RELAXED);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *created_task)
+{
+    return xTaskCreatePinnedToCore(task_code, name, stack_depth, parameters, priority,
+                                   created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == task_self()) {
+        task_exit();
+    }
+    if (task->exited) {
+        return;
+    }
+
+    task->delete_requested = true;
+    pthread_mutex_lock(&task->lock);
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+
+    uint64_t deadline = monotonic_us() + FREERTOS_HOST_DELETE_WAIT_MS * 1000ULL;
+    while (!task->exited) {
+        if (monotonic_us() >= deadline) {
+            ESP_LOGW(TAG, "Task %s did not reach a blocking call to be deleted", task->name);
+            return;
+        }
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    uint64_t deadline = deadline_for(ticks);
+    for (;;) {
+        task_check_deleted();
+        uint64_t now = monotonic_us();
+        if (now >= deadline) {
+            return;
+        }
+        uint64_t left = deadline - now;
+        if (left > FREERTOS_HOST_SLICE_MS * 1000ULL) {
+            left = FREERTOS_HOST_SLICE_MS * 1000ULL;
+        }
+        struct timespec ts = { .tv_sec = left / 1000000ULL, .tv_nsec = (left % 1000000ULL) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment)
+{
+    *previous_wake_time += increment;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*previous_wake_time - now) > 0) {
+        vTaskDelay(*previous_wake_time - now);
+    } else {
+        task_check_deleted();
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return task_self();
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : task_self())->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void)task;
+    return 4096;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    pthread_mutex_lock(&s_tasks_lock);
+    UBaseType_t count = s_task_count;
+    pthread_mutex_unlock(&s_tasks_lock);
+    return count;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return (task ? task : task_self())->priority;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify_value++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    struct freertos_host_task *self = task_self();
+    uint64_t deadline = deadline_for(ticks_to_wait);
+    for (;;) {
+        pthread_mutex_lock(&self->lock);
+        uint32_t value = self->notify_value;
+        if (value > 0) {
+            self->notify_value = clear_count_on_exit ? 0 : value - 1;
+            pthread_mutex_unlock(&self->lock);
+            return value;
+        }
+        bool waiting = wait_slice(&self->cond, &self->lock, deadline);
+        pthread_mutex_unlock(&self->lock);
+        task_check_deleted();
+        if (!waiting) {
+            return 0;
+        }
+    }
+}
+
+// ===== QUEUES =====
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    if (length == 0) {
+        return NULL;
+    }
+    struct freertos_host_queue *queue = calloc(1, sizeof(*queue));
+    if (!queue) {
+        return NULL;
+    }
+    queue->storage = malloc((size_t)length * (item_size ? item_size : 1));
+    if (!queue->storage) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init(&queue->cond);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (!queue) {
+        return;
+    }
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    free(queue->storage);
+    free(queue);
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait, bool front)
+{
+    uint64_t deadline = deadline_for(ticks_to_wait);
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        if (queue->count < queue->length) {
+            UBaseType_t slot;
+            if (front) {
+                queue->head = (queue->head + queue->length - 1) % queue->length;
+                slot = queue->head;
+            } else {
+                slot = (queue->head + queue->count) % queue->length;
+            }
+            memcpy(queue->storage + (size_t)slot * queue->item_size, item, queue->item_size);
+            queue->count++;
+            pthread_cond_broadcast(&queue->cond);
+            pthread_mutex_unlock(&queue->lock);
+            return pdPASS;
+        }
+        bool waiting = ticks_to_wait > 0 && wait_slice(&queue->cond, &queue->lock, deadline);
+        pthread_mutex_unlock(&queue->lock);
+        task_check_deleted();
+        if (!waiting) {
+            return errQUEUE_FULL;
+        }
+    }
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_send(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->head = 0;
+    queue->count = 1;
+    memcpy(queue->storage, item, queue->item_size);
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait, bool peek)
+{
+    uint64_t deadline = deadline_for(ticks_to_wait);
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        if (queue->count > 0) {
+            memcpy(buffer, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+            if (!peek) {
+                queue->head = (queue->head + 1) % queue->length;
+                queue->count--;
+                pthread_cond_broadcast(&queue->cond);
+            }
+            pthread_mutex_unlock(&queue->lock);
+            return pdPASS;
+        }
+        bool waiting = ticks_to_wait > 0 && wait_slice(&queue->cond, &queue->lock, deadline);
+        pthread_mutex_unlock(&queue->lock);
+        task_check_deleted();
+        if (!waiting) {
+            return errQUEUE_EMPTY;
+        }
+    }
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return queue_receive(queue, buffer, ticks_to_wait, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return queue_receive(queue, buffer, ticks_to_wait, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return spaces;
+}
+
+// ===== SEMAPHORES =====
+
+static SemaphoreHandle_t sem_create(sem_kind_t kind, UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct freertos_host_sem *sem = calloc(1, sizeof(*sem));
+    if (!sem) {
+        return NULL;
+    }
+    sem->kind = kind;
+    sem->max_count = max_count;
+    sem->count = initial_count;
+    pthread_mutex_init(&sem->lock, NULL);
+    cond_init(&sem->cond);
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_create(SEM_MUTEX, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return sem_create(SEM_RECURSIVE, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_create(SEM_BINARY, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    return sem_create(SEM_COUNTING, max_count, initial_count);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    if (!sem) {
+        return;
+    }
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->cond);
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    TaskHandle_t self = task_self();
+    uint64_t deadline = deadline_for(ticks_to_wait);
+    for (;;) {
+        pthread_mutex_lock(&sem->lock);
+        if (sem->kind == SEM_RECURSIVE && sem->holder == self) {
+            sem->recursion++;
+            pthread_mutex_unlock(&sem->lock);
+            return pdTRUE;
+        }
+        if (sem->count > 0) {
+            sem->count--;
+            if (sem->kind == SEM_MUTEX || sem->kind == SEM_RECURSIVE) {
+                sem->holder = self;
+                sem->recursion = 1;
+            }
+            pthread_mutex_unlock(&sem->lock);
+            return pdTRUE;
+        }
+        bool waiting = ticks_to_wait > 0 && wait_slice(&sem->cond, &sem->lock, deadline);
+        pthread_mutex_unlock(&sem->lock);
+        task_check_deleted();
+        if (!waiting) {
+            return pdFALSE;
+        }
+    }
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    if (sem->kind == SEM_RECURSIVE && sem->holder == task_self() && sem->recursion > 1) {
+        sem->recursion--;
+        pthread_mutex_unlock(&sem->lock);
+        return pdTRUE;
+    }
+    if (sem->count >= sem->max_count) {
+        pthread_mutex_unlock(&sem->lock);
+        return pdFALSE;
+    }
+    sem->count++;
+    sem->holder = NULL;
+    sem->recursion = 0;
+    pthread_cond_broadcast(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    return xSemaphoreTake(sem, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    return xSemaphoreGive(sem);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    UBaseType_t count = sem->count;
+    pthread_mutex_unlock(&sem->lock);
+    return count;
+}
+
+// ===== EVENT GROUPS =====
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct freertos_host_event_group *group = calloc(1, sizeof(*group));
+    if (!group) {
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    cond_init(&group->cond);
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    if (!group) {
+        return;
+    }
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->cond);
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t bits = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bits_to_wait_for,
+                                const BaseType_t clear_on_exit, const BaseType_t wait_for_all_bits,
+                                TickType_t ticks_to_wait)
+{
+    uint64_t deadline = deadline_for(ticks_to_wait);
+    for (;;) {
+        pthread_mutex_lock(&group->lock);
+        EventBits_t bits = group->bits;
+        bool met = wait_for_all_bits ? (bits & bits_to_wait_for) == bits_to_wait_for
+                                     : (bits & bits_to_wait_for) != 0;
+        if (met) {
+            if (clear_on_exit) {
+                group->bits &= ~bits_to_wait_for;
+            }
+            pthread_mutex_unlock(&group->lock);
+            return bits;
+        }
+        bool waiting = ticks_to_wait > 0 && wait_slice(&group->cond, &group->lock, deadline);
+        pthread_mutex_unlock(&group->lock);
+        task_check_deleted();
+        if (!waiting) {
+            return bits;
+        }
+    }
+}
+
+// ===== TIMERS =====
+
+// Timer records are never freed either: a callback may still hold one
+static pthread_mutex_t s_timers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_timers_cond;
+static pthread_once_t s_timers_once = PTHREAD_ONCE_INIT;
+static struct freertos_host_timer *s_timers;
+
+static uint64_t ticks_to_us(TickType_t ticks)
+{
+    return (uint64_t)ticks * 1000000ULL / configTICK_RATE_HZ;
+}
+
+/**
+ * @brief Timer service: runs the callbacks of expired timers in turn
+ */
+static void *timer_service(void *arg)
+{
+    (void)arg;
+    pthread_setname_np(pthread_self(), "Tmr Svc");
+
+    pthread_mutex_lock(&s_timers_lock);
+    for (;;) {
+        uint64_t now = monotonic_us();
+        uint64_t next = 0;
+        struct freertos_host_timer *due = NULL;
+        for (struct freertos_host_timer *timer = s_timers; timer; timer = timer->next) {
+            if (!timer->active) {
+                continue;
+            }
+            if (timer->expiry_us <= now) {
+                due = timer;
+                break;
+            }
+            if (!next || timer->expiry_us < next) {
+                next = timer->expiry_us;
+            }
+        }
+
+        if (due) {
+            if (due->auto_reload) {
+                due->expiry_us += ticks_to_us(due->period);
+            } else {
+                due->active = false;
+            }
+            pthread_mutex_unlock(&s_timers_lock);
+            due->callback(due);
+            pthread_mutex_lock(&s_timers_lock);
+        } else if (next) {
+            struct timespec ts = {
+                .tv_sec = next / 1000000ULL,
+                .tv_nsec = (next % 1000000ULL) * 1000,
+            };
+            pthread_cond_timedwait(&s_timers_cond, &s_timers_lock, &ts);
+        } else {
+            pthread_cond_wait(&s_timers_cond, &s_timers_lock);
+        }
+    }
+    return NULL;
+}
+
+static void timer_service_start(void)
+{
+    cond_init(&s_timers_cond);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, timer_service, NULL) != 0) {
+        abort();
+    }
+    pthread_detach(thread);
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload,
+                           void *timer_id, TimerCallbackFunction_t callback)
+{
+    if (period == 0 || !callback) {
+        return NULL;
+    }
+    pthread_once(&s_timers_once, timer_service_start);
+
+    struct freertos_host_timer *timer = calloc(1, sizeof(*timer));
+    if (!timer) {
+        return NULL;
+    }
+    snprintf(timer->name, sizeof(timer->name), "%s", name ? name : "");
+    timer->period = period;
+    timer->auto_reload = auto_reload != pdFALSE;
+    timer->timer_id = timer_id;
+    timer->callback = callback;
+
+    pthread_mutex_lock(&s_timers_lock);
+    timer->next = s_timers;
+    s_timers = timer;
+    pthread_mutex_unlock(&s_timers_lock);
+    return timer;
+}
+
+static BaseType_t timer_arm(TimerHandle_t timer, TickType_t period)
+{
+    if (!timer || period == 0) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&s_timers_lock);
+    timer->period = period;
+    timer->expiry_us = monotonic_us() + ticks_to_us(period);
+    timer->active = true;
+    pthread_cond_broadcast(&s_timers_cond);
+    pthread_mutex_unlock(&s_timers_lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    return timer_arm(timer, timer ? timer->period : 0);
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    return xTimerStart(timer, ticks_to_wait);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    return timer_arm(timer, period);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    if (!timer) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&s_timers_lock);
+    timer->active = false;
+    pthread_mutex_unlock(&s_timers_lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    return xTimerStop(timer, ticks_to_wait);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer)
+{
+    pthread_mutex_lock(&s_timers_lock);
+    BaseType_t active = timer->active ? pdTRUE : pdFALSE;
+    pthread_mutex_unlock(&s_timers_lock);
+    return active;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer)
+{
+    return timer->timer_id;
+}
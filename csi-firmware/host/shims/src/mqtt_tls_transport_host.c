@@ -0,0 +1,31 @@
+/**
+ * @file mqtt_tls_transport_host.c
+ * @brief Host replacement for mqtt_tls_transport.c
+ *
+ * The host build has no TLS stack. The handle keeps the wrapper's SSL
+ * configuration path working; the host esp-mqtt client then reports
+ * ESP_ERR_NOT_SUPPORTED as a transport error on every connect attempt.
+ */
+
+#include <string.h>
+#include "mqtt_tls_transport.h"
+
+esp_transport_handle_t mqtt_tls_transport_create(void)
+{
+    esp_transport_handle_t t = esp_transport_init();
+    if (t) {
+        esp_transport_set_default_port(t, 8883);
+    }
+    return t;
+}
+
+void mqtt_tls_transport_get_metrics(mqtt_tls_metrics_t *metrics)
+{
+    if (metrics) {
+        memset(metrics, 0, sizeof(*metrics));
+    }
+}
+
+void mqtt_tls_transport_forget_session(void)
+{
+}
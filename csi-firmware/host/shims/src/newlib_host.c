@@ -0,0 +1,19 @@
+/**
+ * @file newlib_host.c
+ * @brief Host shim: newlib string functions missing from older glibc
+ */
+
+#include <newlib_host.h>
+
+#ifdef NEWLIB_HOST_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t copy = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, copy);
+        dst[copy] = '\0';
+    }
+    return len;
+}
+#endif
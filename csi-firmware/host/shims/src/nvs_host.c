@@ -0,0 +1,366 @@
+/**
+ * @file nvs_host.c
+ * @brief Host shim: in-memory NVS
+ *
+ * Writes are visible at once; nvs_commit() is accepted for symmetry with
+ * the device, where it is what makes them durable.
+ */
+
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_HOST_HANDLES_MAX    16
+#define NVS_HOST_STR_MAX        4000    ///< Longest string value on the device
+#define NVS_HOST_BLOB_MAX       (508000 / 2)
+
+typedef enum {
+    NVS_TYPE_U8 = 0x01,
+    NVS_TYPE_I8 = 0x11,
+    NVS_TYPE_U16 = 0x02,
+    NVS_TYPE_I16 = 0x12,
+    NVS_TYPE_U32 = 0x04,
+    NVS_TYPE_I32 = 0x14,
+    NVS_TYPE_U64 = 0x08,
+    NVS_TYPE_I64 = 0x18,
+    NVS_TYPE_STR = 0x21,
+    NVS_TYPE_BLOB = 0x42,
+} nvs_type_t;
+
+typedef struct nvs_entry {
+    struct nvs_entry *next;
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    size_t len;
+    uint8_t data[];
+} nvs_entry_t;
+
+typedef struct {
+    bool used;
+    bool writable;
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+} nvs_open_handle_t;
+
+static pthread_mutex_t s_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_nvs_initialized;
+static nvs_entry_t *s_entries;
+static nvs_open_handle_t s_handles[NVS_HOST_HANDLES_MAX];
+
+static void nvs_free_entries(const char *ns)
+{
+    nvs_entry_t **link = &s_entries;
+    while (*link) {
+        nvs_entry_t *entry = *link;
+        if (!ns || strcmp(entry->ns, ns) == 0) {
+            *link = entry->next;
+            free(entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    s_nvs_initialized = true;
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_deinit(void)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    if (!s_nvs_initialized) {
+        pthread_mutex_unlock(&s_nvs_lock);
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    s_nvs_initialized = false;
+    memset(s_handles, 0, sizeof(s_handles));
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_free_entries(NULL);
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_OK;
+}
+
+static bool nvs_name_valid(const char *name)
+{
+    return name && name[0] != '\0';
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!nvs_name_valid(namespace_name) || !out_handle) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    if (strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    pthread_mutex_lock(&s_nvs_lock);
+    if (!s_nvs_initialized) {
+        pthread_mutex_unlock(&s_nvs_lock);
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    // A namespace only exists once something was written to it
+    if (open_mode == NVS_READONLY) {
+        bool found = false;
+        for (nvs_entry_t *entry = s_entries; entry; entry = entry->next) {
+            if (strcmp(entry->ns, namespace_name) == 0) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            pthread_mutex_unlock(&s_nvs_lock);
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+    }
+
+    for (int i = 0; i < NVS_HOST_HANDLES_MAX; i++) {
+        if (!s_handles[i].used) {
+            s_handles[i].used = true;
+            s_handles[i].writable = open_mode == NVS_READWRITE;
+            strcpy(s_handles[i].ns, namespace_name);
+            *out_handle = (nvs_handle_t)(i + 1);
+            pthread_mutex_unlock(&s_nvs_lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    if (handle >= 1 && handle <= NVS_HOST_HANDLES_MAX) {
+        s_handles[handle - 1].used = false;
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+}
+
+/**
+ * @brief Look up an open handle; call with s_nvs_lock held
+ */
+static nvs_open_handle_t *nvs_handle_get(nvs_handle_t handle)
+{
+    if (handle < 1 || handle > NVS_HOST_HANDLES_MAX || !s_handles[handle - 1].used) {
+        return NULL;
+    }
+    return &s_handles[handle - 1];
+}
+
+static nvs_entry_t **nvs_find(const char *ns, const char *key)
+{
+    for (nvs_entry_t **link = &s_entries; *link; link = &(*link)->next) {
+        if (strcmp((*link)->ns, ns) == 0 && strcmp((*link)->key, key) == 0) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    esp_err_t err = nvs_handle_get(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_open_handle_t *open = nvs_handle_get(handle);
+    esp_err_t err = ESP_OK;
+    if (!open) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (!open->writable) {
+        err = ESP_ERR_NVS_READ_ONLY;
+    } else {
+        nvs_entry_t **link = nvs_find(open->ns, key);
+        if (!link) {
+            err = ESP_ERR_NVS_NOT_FOUND;
+        } else {
+            nvs_entry_t *entry = *link;
+            *link = entry->next;
+            free(entry);
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_open_handle_t *open = nvs_handle_get(handle);
+    esp_err_t err = ESP_OK;
+    if (!open) {
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    } else if (!open->writable) {
+        err = ESP_ERR_NVS_READ_ONLY;
+    } else {
+        nvs_free_entries(open->ns);
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t len)
+{
+    if (!nvs_name_valid(key)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_open_handle_t *open = nvs_handle_get(handle);
+    if (!open) {
+        pthread_mutex_unlock(&s_nvs_lock);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!open->writable) {
+        pthread_mutex_unlock(&s_nvs_lock);
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+
+    nvs_entry_t *entry = malloc(sizeof(nvs_entry_t) + len);
+    if (!entry) {
+        pthread_mutex_unlock(&s_nvs_lock);
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    strcpy(entry->ns, open->ns);
+    strcpy(entry->key, key);
+    entry->type = type;
+    entry->len = len;
+    memcpy(entry->data, value, len);
+
+    // A key holds one value of any type; writing replaces it
+    nvs_entry_t **link = nvs_find(open->ns, key);
+    if (link) {
+        nvs_entry_t *old = *link;
+        entry->next = old->next;
+        *link = entry;
+        free(old);
+    } else {
+        entry->next = s_entries;
+        s_entries = entry;
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_OK;
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, nvs_type_t type, void *out, size_t *len)
+{
+    if (!nvs_name_valid(key)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_open_handle_t *open = nvs_handle_get(handle);
+    if (!open) {
+        pthread_mutex_unlock(&s_nvs_lock);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    nvs_entry_t **link = nvs_find(open->ns, key);
+    if (!link || (*link)->type != type) {
+        pthread_mutex_unlock(&s_nvs_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    nvs_entry_t *entry = *link;
+    esp_err_t err = ESP_OK;
+    if (type == NVS_TYPE_STR || type == NVS_TYPE_BLOB) {
+        // Variable length: NULL output asks for the length only
+        if (!out) {
+            *len = entry->len;
+        } else if (*len < entry->len) {
+            *len = entry->len;
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(out, entry->data, entry->len);
+            *len = entry->len;
+        }
+    } else {
+        memcpy(out, entry->data, entry->len);
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+#define NVS_HOST_INT_ACCESSORS(suffix, ctype, tag)                                      \
+    esp_err_t nvs_set_##suffix(nvs_handle_t handle, const char *key, ctype value)       \
+    {                                                                                   \
+        return nvs_set(handle, key, tag, &value, sizeof(value));                        \
+    }                                                                                   \
+    esp_err_t nvs_get_##suffix(nvs_handle_t handle, const char *key, ctype *out_value)  \
+    {                                                                                   \
+        if (!out_value) {                                                               \
+            return ESP_ERR_INVALID_ARG;                                                 \
+        }                                                                               \
+        size_t len = sizeof(*out_value);                                                \
+        return nvs_get(handle, key, tag, out_value, &len);                              \
+    }
+
+NVS_HOST_INT_ACCESSORS(i8, int8_t, NVS_TYPE_I8)
+NVS_HOST_INT_ACCESSORS(u8, uint8_t, NVS_TYPE_U8)
+NVS_HOST_INT_ACCESSORS(i16, int16_t, NVS_TYPE_I16)
+NVS_HOST_INT_ACCESSORS(u16, uint16_t, NVS_TYPE_U16)
+NVS_HOST_INT_ACCESSORS(i32, int32_t, NVS_TYPE_I32)
+NVS_HOST_INT_ACCESSORS(u32, uint32_t, NVS_TYPE_U32)
+NVS_HOST_INT_ACCESSORS(i64, int64_t, NVS_TYPE_I64)
+NVS_HOST_INT_ACCESSORS(u64, uint64_t, NVS_TYPE_U64)
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    if (!value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t len = strlen(value) + 1;
+    if (len > NVS_HOST_STR_MAX) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+    return nvs_set(handle, key, NVS_TYPE_STR, value, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (!value && length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (length > NVS_HOST_BLOB_MAX) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+    return nvs_set(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    if (!length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return nvs_get(handle, key, NVS_TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    if (!length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return nvs_get(handle, key, NVS_TYPE_BLOB, out_value, length);
+}
@@ -0,0 +1,387 @@
+/**
+ * @file csi_host_sim.c
+ * @brief Run the CSI pipeline on the host against the simulated radio
+ *
+ * Starts the real collector and, when a broker is given, the real MQTT
+ * client, then consumes frames the way main.c does: publish each frame,
+ * record a drop when MQTT is down, report the drop log every second. At
+ * the end every delivered frame is accounted for as published, dropped
+ * (by reason) or still in flight.
+ *
+ *     csi_host_sim --rate 100 --duration 30
+ *     csi_host_sim --rate 500 --pattern bursty --broker loopback --binary
+ *     csi_host_sim --rate 0 --frames 100000 --broker 127.0.0.1
+ *     csi_host_sim --replay trace.pcap --speed 0 --backpressure 100
+ *
+ * With --replay a recording (ESP32-CSI-Tool CSV, binary frames or pcap,
+ * see csi_replay.h) takes the place of the radio and the run lasts until
+ * the recording ends.
+ *
+ * "loopback" is an in-process broker in the esp-mqtt shim that acks
+ * QoS 1 and discards the rest, so the numbers reflect the firmware alone.
+ * The collector's process task takes one frame per 1000/sample_rate ms, so
+ * a radio faster than --sample-rate shows up as buffer_full drops; that
+ * is the device's behaviour, not a simulator artefact.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_host.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "csi_collector.h"
+#include "csi_replay.h"
+#include "mqtt_client_wrapper.h"
+#include "radio_sim.h"
+
+#define SIM_DROP_REPORT_INTERVAL_MS 1000
+#define SIM_DROP_REPORT_MAX_RANGES  16
+#define SIM_CONNECT_WAIT_MS         5000
+#define SIM_DRAIN_MS                1000
+
+static const char *TAG = "csi_host_sim";
+
+static const char *s_drop_names[CSI_DROP_REASON_MAX] = {
+    "none", "no_mem", "buffer_full", "filtered", "queue_full", "http_poll",
+    "not_connected", "encode", "outbox_full", "outbox_expired", "publish", "ws_send",
+};
+
+typedef struct {
+    radio_sim_config_t radio;
+    csi_collector_config_t collector;
+    mqtt_config_t mqtt;
+    double duration_s;              ///< 0 = until the replay ends
+    bool binary;
+    const char *replay_path;        ///< Recording to replay instead of the radio
+    csi_replay_config_t replay;
+} sim_options_t;
+
+typedef struct {
+    uint64_t consumed;
+    uint64_t published;
+    uint64_t publish_errors;
+    uint64_t drop_reports;
+} sim_counters_t;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --rate HZ            radio frame rate, 0 = as fast as accepted (default 100)\n"
+            "  --pattern P          constant | poisson | bursty (default constant)\n"
+            "  --burst N            frames per burst for bursty (default 8)\n"
+            "  --subcarriers N      subcarriers per report, 1-%d (default 64)\n"
+            "  --transmitters N     distinct source MACs (default 1)\n"
+            "  --frames N           stop the radio after N frames\n"
+            "  --duration S         run time in seconds (default 10)\n"
+            "  --seed N             radio random seed\n"
+            "  --sample-rate HZ     collector sample_rate, 1-100 (default 100)\n"
+            "  --buffer-size N      collector buffer_size, 256-4096 (default 1024)\n"
+            "  --filter T           enable the CSI filter with threshold T\n"
+            "  --broker HOST        MQTT broker; \"%s\" for the in-process broker\n"
+            "  --port N             MQTT port (default 1883)\n"
+            "  --binary             publish binary frames instead of JSON\n"
+            "  --replay FILE        replay a recording instead of the simulated radio\n"
+            "  --replay-format F    auto | csv | binary | pcap (default auto)\n"
+            "  --speed X            replay speed factor, 0 = as fast as possible (default 1)\n"
+            "  --backpressure MS    wait up to MS for room in the collector instead of dropping\n",
+            prog, RADIO_SIM_MAX_SUBCARRIERS, ESP_HOST_MQTT_LOOPBACK);
+}
+
+static bool parse_options(int argc, char **argv, sim_options_t *opt)
+{
+    radio_sim_default_config(&opt->radio);
+    opt->collector = (csi_collector_config_t){
+        .sample_rate = 100,
+        .buffer_size = 1024,
+        .filter_threshold = 0.5f,
+        .enable_rssi = true,
+        .enable_phase = true,
+        .enable_amplitude = true,
+    };
+    opt->mqtt = (mqtt_config_t){
+        .port = 1883,
+        .keepalive = 60,
+        .qos = 0,
+    };
+    snprintf(opt->mqtt.client_id, sizeof(opt->mqtt.client_id), "csi-host-sim");
+    snprintf(opt->mqtt.topic_prefix, sizeof(opt->mqtt.topic_prefix), "csi/host-sim");
+    opt->duration_s = -1;
+    opt->replay = (csi_replay_config_t)CSI_REPLAY_DEFAULT_CONFIG();
+
+    static const struct option long_options[] = {
+        { "rate", required_argument, NULL, 'r' },
+        { "pattern", required_argument, NULL, 'p' },
+        { "burst", required_argument, NULL, 'B' },
+        { "subcarriers", required_argument, NULL, 's' },
+        { "transmitters", required_argument, NULL, 't' },
+        { "frames", required_argument, NULL, 'n' },
+        { "duration", required_argument, NULL, 'd' },
+        { "seed", required_argument, NULL, 'S' },
+        { "sample-rate", required_argument, NULL, 'R' },
+        { "buffer-size", required_argument, NULL, 'b' },
+        { "filter", required_argument, NULL, 'f' },
+        { "broker", required_argument, NULL, 'm' },
+        { "port", required_argument, NULL, 'P' },
+        { "binary", no_argument, NULL, 'x' },
+        { "replay", required_argument, NULL, 'X' },
+        { "replay-format", required_argument, NULL, 'F' },
+        { "speed", required_argument, NULL, 'v' },
+        { "backpressure", required_argument, NULL, 'w' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'r': opt->radio.rate_hz = strtod(optarg, NULL); break;
+            case 'p':
+                if (strcmp(optarg, "constant") == 0) {
+                    opt->radio.pattern = RADIO_SIM_CONSTANT;
+                } else if (strcmp(optarg, "poisson") == 0) {
+                    opt->radio.pattern = RADIO_SIM_POISSON;
+                } else if (strcmp(optarg, "bursty") == 0) {
+                    opt->radio.pattern = RADIO_SIM_BURSTY;
+                } else {
+                    fprintf(stderr, "Unknown pattern: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'B': opt->radio.burst_len = (uint16_t)atoi(optarg); break;
+            case 's': opt->radio.subcarriers = (uint16_t)atoi(optarg); break;
+            case 't': opt->radio.transmitters = (uint8_t)atoi(optarg); break;
+            case 'n': opt->radio.max_frames = strtoull(optarg, NULL, 10); break;
+            case 'd': opt->duration_s = strtod(optarg, NULL); break;
+            case 'S': opt->radio.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'R': opt->collector.sample_rate = (uint8_t)atoi(optarg); break;
+            case 'b': opt->collector.buffer_size = (uint16_t)atoi(optarg); break;
+            case 'f':
+                opt->collector.filter_enabled = true;
+                opt->collector.filter_threshold = strtof(optarg, NULL);
+                break;
+            case 'm':
+                opt->mqtt.enabled = true;
+                snprintf(opt->mqtt.broker_url, sizeof(opt->mqtt.broker_url), "%s", optarg);
+                break;
+            case 'P': opt->mqtt.port = (uint16_t)atoi(optarg); break;
+            case 'x': opt->binary = true; break;
+            case 'X': opt->replay_path = optarg; break;
+            case 'F':
+                if (csi_replay_format_from_name(optarg, &opt->replay.format) != ESP_OK) {
+                    fprintf(stderr, "Unknown replay format: %s\n", optarg);
+                    return false;
+                }
+                break;
+            case 'v': opt->replay.speed = strtof(optarg, NULL); break;
+            case 'w': opt->replay.wait_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default:
+                return false;
+        }
+    }
+    if (opt->duration_s < 0) {
+        opt->duration_s = opt->replay_path ? 0 : 10;
+    }
+    return optind == argc;
+}
+
+static void report_drops(bool mqtt_enabled, sim_counters_t *counters)
+{
+    if (!mqtt_enabled || !mqtt_client_is_connected()) {
+        return;
+    }
+    csi_drop_range_t ranges[SIM_DROP_REPORT_MAX_RANGES];
+    size_t count = 0;
+    if (csi_collector_take_drops(ranges, SIM_DROP_REPORT_MAX_RANGES, &count) == ESP_OK &&
+        mqtt_client_publish_csi_drops(ranges, count) == ESP_OK) {
+        counters->drop_reports++;
+    }
+}
+
+static void consume_frame(const sim_options_t *opt, csi_data_t *csi_data, sim_counters_t *counters)
+{
+    counters->consumed++;
+    if (opt->mqtt.enabled && mqtt_client_is_connected()) {
+        esp_err_t err = opt->binary ? mqtt_client_publish_csi_frame(csi_data)
+                                    : mqtt_client_publish_csi_data(csi_data);
+        if (err == ESP_OK) {
+            counters->published++;
+        } else {
+            counters->publish_errors++;
+        }
+    } else if (opt->mqtt.enabled) {
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_NOT_CONNECTED);
+    }
+    csi_collector_free_data(csi_data);
+}
+
+static void print_summary(const sim_options_t *opt, const sim_counters_t *counters, double elapsed_s)
+{
+    radio_sim_stats_t radio;
+    radio_sim_get_stats(&radio);
+    csi_replay_stats_t replay;
+    csi_replay_get_stats(&replay);
+    csi_collector_stats_t stats;
+    csi_collector_get_stats(&stats);
+    uint64_t delivered = opt->replay_path ? replay.frames_injected : radio.delivered;
+
+    // Frames dropped up to http_poll never reach the consumer; later reasons
+    // are recorded for frames the consumer already took
+    uint64_t dropped = 0;
+    uint64_t dropped_in_collector = 0;
+    for (int i = 1; i < CSI_DROP_REASON_MAX; i++) {
+        dropped += stats.drops[i];
+        if (i <= CSI_DROP_HTTP_POLL) {
+            dropped_in_collector += stats.drops[i];
+        }
+    }
+
+    printf("elapsed_s        %.3f\n", elapsed_s);
+    if (opt->replay_path) {
+        printf("replay           read %" PRIu32 ", injected %" PRIu32 ", rejected %" PRIu32
+               ", skipped %" PRIu32 ", max lag %" PRIu32 " us, %s\n",
+               replay.frames_read, replay.frames_injected, replay.frames_rejected,
+               replay.records_skipped, replay.max_lag_us, esp_err_to_name(replay.result));
+        printf("replay rate      %.1f frames/s\n", elapsed_s > 0 ? delivered / elapsed_s : 0.0);
+    } else {
+        printf("radio            generated %" PRIu64 ", delivered %" PRIu64 ", rejected %" PRIu64
+               ", max lag %" PRIu64 " us\n", radio.generated, radio.delivered, radio.rejected, radio.max_lag_us);
+        printf("radio rate       %.1f frames/s\n", elapsed_s > 0 ? delivered / elapsed_s : 0.0);
+    }
+    printf("collector        received %" PRIu32 ", processed %" PRIu32 ", next_seq %" PRIu32 "\n",
+           stats.packets_received, stats.packets_processed, stats.next_sequence);
+    printf("consumer         consumed %" PRIu64 " (%.1f frames/s), published %" PRIu64
+           ", publish errors %" PRIu64 ", drop reports %" PRIu64 "\n",
+           counters->consumed, elapsed_s > 0 ? counters->consumed / elapsed_s : 0.0,
+           counters->published, counters->publish_errors, counters->drop_reports);
+    printf("drops            %" PRIu64 " total", dropped);
+    for (int i = 1; i < CSI_DROP_REASON_MAX; i++) {
+        if (stats.drops[i]) {
+            printf(", %s %" PRIu32, s_drop_names[i], stats.drops[i]);
+        }
+    }
+    printf("\n");
+    printf("unaccounted      %" PRId64 " (in the collector at stop)\n",
+           (int64_t)delivered - (int64_t)(counters->consumed + dropped_in_collector));
+
+    if (opt->mqtt.enabled) {
+        esp_host_mqtt_stats_t mqtt;
+        esp_host_mqtt_get_stats(&mqtt);
+        printf("mqtt             connects %" PRIu32 ", publishes %" PRIu32 ", bytes %" PRIu64
+               ", acks %" PRIu32 ", received %" PRIu32 "\n",
+               mqtt.connects, mqtt.publishes, mqtt.publish_bytes, mqtt.acks, mqtt.received);
+        mqtt_outbox_stats_t outbox;
+        if (mqtt_client_get_outbox_stats(MQTT_CLASS_CSI, &outbox) == ESP_OK) {
+            printf("mqtt csi outbox  queued %" PRIu32 ", sent %" PRIu32 ", dropped %" PRIu32
+                   ", expired %" PRIu32 ", max wait %" PRIu32 " ms\n",
+                   outbox.queued_msgs, outbox.sent, outbox.dropped, outbox.expired, outbox.max_wait_ms);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    sim_options_t opt = {0};
+    if (!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    esp_err_t err = csi_collector_init(&opt.collector);
+    if (err == ESP_OK) {
+        err = csi_collector_start();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Collector failed to start: %s", esp_err_to_name(err));
+        return 1;
+    }
+
+    if (opt.mqtt.enabled) {
+        if (mqtt_client_init(&opt.mqtt) != ESP_OK || mqtt_client_start() != ESP_OK) {
+            ESP_LOGE(TAG, "MQTT client failed to start");
+            return 1;
+        }
+        for (int i = 0; i < SIM_CONNECT_WAIT_MS / 100 && !mqtt_client_is_connected(); i++) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        if (!mqtt_client_is_connected()) {
+            ESP_LOGW(TAG, "Not connected to %s:%u yet, frames count as not_connected",
+                     opt.mqtt.broker_url, opt.mqtt.port);
+        }
+    }
+
+    FILE *recording = NULL;
+    if (opt.replay_path) {
+        recording = fopen(opt.replay_path, "rb");
+        if (!recording) {
+            ESP_LOGE(TAG, "Cannot open %s", opt.replay_path);
+            return 1;
+        }
+        if (csi_replay_start(recording, &opt.replay) != ESP_OK) {
+            return 2;
+        }
+    } else if (radio_sim_start(&opt.radio) != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid radio configuration");
+        return 2;
+    }
+
+    sim_counters_t counters = {0};
+    int64_t start_us = esp_timer_get_time();
+    int64_t end_us = opt.duration_s > 0 ? start_us + (int64_t)(opt.duration_s * 1e6) : INT64_MAX;
+    int64_t last_report_us = start_us;
+    int64_t finished_us = 0;            // When the source ran out
+    csi_data_t csi_data;
+
+    while (esp_timer_get_time() < end_us) {
+        if (csi_collector_get_data(&csi_data, 100) == ESP_OK) {
+            consume_frame(&opt, &csi_data, &counters);
+        }
+        int64_t now = esp_timer_get_time();
+        if (now - last_report_us >= SIM_DROP_REPORT_INTERVAL_MS * 1000LL) {
+            last_report_us = now;
+            report_drops(opt.mqtt.enabled, &counters);
+        }
+        radio_sim_stats_t radio;
+        radio_sim_get_stats(&radio);
+        bool finished = opt.replay_path ? !csi_replay_is_running() : radio.finished;
+        if (!finished) {
+            finished_us = 0;
+        } else if (!finished_us) {
+            finished_us = now;
+        } else if (now - finished_us >= SIM_DRAIN_MS * 1000LL) {
+            break;
+        }
+    }
+
+    if (opt.replay_path) {
+        csi_replay_stop();
+        fclose(recording);
+    } else {
+        radio_sim_stop();
+    }
+    double elapsed_s = (esp_timer_get_time() - start_us) / 1e6;
+
+    // Let what is already queued through before counting
+    while (csi_collector_get_data(&csi_data, SIM_DRAIN_MS) == ESP_OK) {
+        consume_frame(&opt, &csi_data, &counters);
+    }
+    report_drops(opt.mqtt.enabled, &counters);
+    if (opt.mqtt.enabled) {
+        vTaskDelay(pdMS_TO_TICKS(SIM_DRAIN_MS));
+    }
+
+    print_summary(&opt, &counters, elapsed_s);
+
+    csi_collector_stop();
+    if (opt.mqtt.enabled) {
+        mqtt_client_stop();
+        mqtt_client_deinit();
+    }
+    csi_collector_deinit();
+    return 0;
+}
@@ -0,0 +1,262 @@
+/**
+ * @file radio_sim.c
+ * @brief Simulated Wi-Fi radio for the host build
+ *
+ * Each transmitter sees a three-path channel whose path gains drift
+ * slowly, with a breathing-rate modulation on the strongest path, plus
+ * receiver noise. Reports are scheduled on absolute times so a slow
+ * consumer shows up as lag instead of a lower rate.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <esp_host.h>
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include "radio_sim.h"
+
+#define RADIO_SIM_PATHS         3
+#define RADIO_SIM_NOISE_FLOOR   -92
+#define RADIO_SIM_BREATH_HZ     0.25
+
+static const char *TAG = "radio_sim";
+
+typedef struct {
+    float delay[RADIO_SIM_PATHS];   ///< Path delay in subcarrier periods
+    float gain[RADIO_SIM_PATHS];
+    float phase[RADIO_SIM_PATHS];
+} channel_t;
+
+static struct {
+    radio_sim_config_t config;
+    pthread_t thread;
+    atomic_bool running;
+    uint64_t rng;
+    channel_t channels[RADIO_SIM_MAX_TRANSMITTERS];
+    _Atomic uint64_t generated;
+    _Atomic uint64_t delivered;
+    _Atomic uint64_t rejected;
+    _Atomic uint64_t max_lag_us;
+    atomic_bool finished;
+} s_sim;
+
+// ===== RANDOM =====
+
+static uint64_t rng_next(void)
+{
+    // xorshift64*
+    s_sim.rng ^= s_sim.rng >> 12;
+    s_sim.rng ^= s_sim.rng << 25;
+    s_sim.rng ^= s_sim.rng >> 27;
+    return s_sim.rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_uniform(void)
+{
+    return ((rng_next() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_gauss(void)
+{
+    return sqrt(-2.0 * log(rng_uniform())) * cos(2.0 * M_PI * rng_uniform());
+}
+
+// ===== CHANNEL MODEL =====
+
+static void channel_init(channel_t *ch)
+{
+    for (int p = 0; p < RADIO_SIM_PATHS; p++) {
+        ch->delay[p] = (float)(p * 0.6 + rng_uniform() * 0.4);
+        ch->gain[p] = (float)(1.0 / (1 + p * 2) * (0.8 + 0.4 * rng_uniform()));
+        ch->phase[p] = (float)(2.0 * M_PI * rng_uniform());
+    }
+}
+
+/**
+ * @brief Synthesize one report as imaginary/real int8 pairs per subcarrier
+ */
+static void channel_render(channel_t *ch, double t, int8_t *buf, uint16_t subcarriers)
+{
+    for (int p = 0; p < RADIO_SIM_PATHS; p++) {
+        ch->phase[p] += (float)(rng_gauss() * 0.01);
+    }
+    double breath = 1.0 + 0.05 * sin(2.0 * M_PI * RADIO_SIM_BREATH_HZ * t);
+
+    for (uint16_t k = 0; k < subcarriers; k++) {
+        double re = 0;
+        double im = 0;
+        for (int p = 0; p < RADIO_SIM_PATHS; p++) {
+            double gain = ch->gain[p] * (p == 0 ? breath : 1.0);
+            double angle = ch->phase[p] - 2.0 * M_PI * ch->delay[p] * k / subcarriers;
+            re += gain * cos(angle);
+            im += gain * sin(angle);
+        }
+        re = re * 40.0 + rng_gauss();
+        im = im * 40.0 + rng_gauss();
+        buf[k * 2] = (int8_t)fmax(-128, fmin(127, lrint(im)));
+        buf[k * 2 + 1] = (int8_t)fmax(-128, fmin(127, lrint(re)));
+    }
+}
+
+// ===== SCHEDULE =====
+
+static void timespec_add_ns(struct timespec *ts, uint64_t ns)
+{
+    ns += (uint64_t)ts->tv_nsec;
+    ts->tv_sec += (time_t)(ns / 1000000000ULL);
+    ts->tv_nsec = (long)(ns % 1000000000ULL);
+}
+
+static int64_t timespec_diff_us(const struct timespec *a, const struct timespec *b)
+{
+    return (a->tv_sec - b->tv_sec) * 1000000LL + (a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+/**
+ * @brief Gap before frame n, in nanoseconds
+ */
+static uint64_t next_gap_ns(uint64_t n)
+{
+    const radio_sim_config_t *cfg = &s_sim.config;
+    if (cfg->rate_hz <= 0) {
+        return 0;
+    }
+    double period_ns = 1e9 / cfg->rate_hz;
+    switch (cfg->pattern) {
+        case RADIO_SIM_POISSON:
+            return (uint64_t)(-log(rng_uniform()) * period_ns);
+        case RADIO_SIM_BURSTY:
+            return n % cfg->burst_len == 0 ? (uint64_t)(period_ns * cfg->burst_len) : 0;
+        case RADIO_SIM_CONSTANT:
+        default:
+            return (uint64_t)period_ns;
+    }
+}
+
+static void *radio_thread(void *arg)
+{
+    (void)arg;
+    const radio_sim_config_t *cfg = &s_sim.config;
+    int8_t buf[RADIO_SIM_MAX_SUBCARRIERS * 2];
+    struct timespec due;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &due);
+    start = due;
+
+    for (uint64_t n = 0; atomic_load(&s_sim.running); n++) {
+        if (cfg->max_frames && n >= cfg->max_frames) {
+            atomic_store(&s_sim.finished, true);
+            break;
+        }
+
+        uint64_t gap = n ? next_gap_ns(n) : 0;
+        if (gap) {
+            timespec_add_ns(&due, gap);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0) {
+            }
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t lag = timespec_diff_us(&now, &due);
+        if (lag > 0 && (uint64_t)lag > atomic_load(&s_sim.max_lag_us)) {
+            atomic_store(&s_sim.max_lag_us, (uint64_t)lag);
+        }
+
+        uint8_t tx = (uint8_t)(n % cfg->transmitters);
+        channel_render(&s_sim.channels[tx], timespec_diff_us(&now, &start) / 1e6, buf, cfg->subcarriers);
+
+        wifi_csi_info_t info = {
+            .mac = { 0x02, 0x00, 0x5e, 0x10, 0x00, (uint8_t)(tx + 1) },
+            .buf = buf,
+            .len = (uint16_t)(cfg->subcarriers * 2),
+        };
+        info.rx_ctrl.rssi = (signed)lrint(fmax(-100, fmin(0, cfg->rssi + rng_gauss() * 2.0)));
+        info.rx_ctrl.noise_floor = RADIO_SIM_NOISE_FLOOR;
+        info.rx_ctrl.sig_mode = 1;
+        info.rx_ctrl.mcs = 7;
+        info.rx_ctrl.channel = cfg->channel;
+        info.rx_ctrl.timestamp = (uint32_t)esp_timer_get_time();
+        info.rx_ctrl.sig_len = 128;
+
+        atomic_fetch_add(&s_sim.generated, 1);
+        if (esp_host_wifi_deliver_csi(&info)) {
+            atomic_fetch_add(&s_sim.delivered, 1);
+        } else {
+            atomic_fetch_add(&s_sim.rejected, 1);
+        }
+    }
+    return NULL;
+}
+
+// ===== API =====
+
+void radio_sim_default_config(radio_sim_config_t *config)
+{
+    *config = (radio_sim_config_t){
+        .rate_hz = 100,
+        .pattern = RADIO_SIM_CONSTANT,
+        .burst_len = 8,
+        .subcarriers = 64,
+        .transmitters = 1,
+        .channel = 6,
+        .rssi = -55,
+    };
+}
+
+esp_err_t radio_sim_start(const radio_sim_config_t *config)
+{
+    if (!config || config->rate_hz < 0 || config->subcarriers == 0 ||
+        config->subcarriers > RADIO_SIM_MAX_SUBCARRIERS || config->transmitters == 0 ||
+        config->transmitters > RADIO_SIM_MAX_TRANSMITTERS || config->channel == 0 ||
+        config->channel > 14 || (config->pattern == RADIO_SIM_BURSTY && config->burst_len == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_load(&s_sim.running)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_sim.config = *config;
+    s_sim.rng = config->seed ? config->seed : esp_random() | 1;
+    for (int i = 0; i < config->transmitters; i++) {
+        channel_init(&s_sim.channels[i]);
+    }
+    atomic_store(&s_sim.generated, 0);
+    atomic_store(&s_sim.delivered, 0);
+    atomic_store(&s_sim.rejected, 0);
+    atomic_store(&s_sim.max_lag_us, 0);
+    atomic_store(&s_sim.finished, false);
+    atomic_store(&s_sim.running, true);
+
+    if (pthread_create(&s_sim.thread, NULL, radio_thread, NULL) != 0) {
+        atomic_store(&s_sim.running, false);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Radio started: %.1f Hz, %u subcarriers, %u transmitter(s)",
+             config->rate_hz, config->subcarriers, config->transmitters);
+    return ESP_OK;
+}
+
+void radio_sim_stop(void)
+{
+    if (!atomic_exchange(&s_sim.running, false)) {
+        return;
+    }
+    pthread_join(s_sim.thread, NULL);
+    ESP_LOGI(TAG, "Radio stopped");
+}
+
+void radio_sim_get_stats(radio_sim_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    stats->generated = atomic_load(&s_sim.generated);
+    stats->delivered = atomic_load(&s_sim.delivered);
+    stats->rejected = atomic_load(&s_sim.rejected);
+    stats->max_lag_us = atomic_load(&s_sim.max_lag_us);
+    stats->finished = atomic_load(&s_sim.finished);
+}
@@ -0,0 +1,88 @@
+/**
+ * @file radio_sim.h
+ * @brief Simulated Wi-Fi radio for the host build
+ *
+ * Plays the Wi-Fi driver: a thread synthesizes CSI reports from a small
+ * multipath channel model and hands them to the firmware through
+ * esp_host_wifi_deliver_csi() on a configurable arrival pattern.
+ */
+
+#ifndef RADIO_SIM_H
+#define RADIO_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RADIO_SIM_MAX_SUBCARRIERS   192     ///< HT40 with LLTF and HT-LTF
+#define RADIO_SIM_MAX_TRANSMITTERS  32
+
+/**
+ * @brief Frame arrival pattern
+ */
+typedef enum {
+    RADIO_SIM_CONSTANT,         ///< Evenly spaced frames
+    RADIO_SIM_POISSON,          ///< Exponentially distributed gaps
+    RADIO_SIM_BURSTY,           ///< burst_len frames back to back, bursts evenly spaced
+} radio_sim_pattern_t;
+
+/**
+ * @brief Simulator configuration
+ */
+typedef struct {
+    double rate_hz;             ///< Mean frame rate, 0 for as fast as the firmware takes them
+    radio_sim_pattern_t pattern; ///< Arrival pattern
+    uint16_t burst_len;         ///< Frames per burst (RADIO_SIM_BURSTY)
+    uint16_t subcarriers;       ///< Subcarriers per report (1-RADIO_SIM_MAX_SUBCARRIERS)
+    uint8_t transmitters;       ///< Distinct source MACs, served round robin
+    uint8_t channel;            ///< Primary channel
+    int8_t rssi;                ///< Mean RSSI in dBm
+    uint32_t seed;              ///< Random seed, 0 for a random one
+    uint64_t max_frames;        ///< Stop after this many frames, 0 for no limit
+} radio_sim_config_t;
+
+/**
+ * @brief Simulator counters
+ */
+typedef struct {
+    uint64_t generated;         ///< Reports synthesized
+    uint64_t delivered;         ///< Reports the firmware accepted
+    uint64_t rejected;          ///< Reports dropped because CSI was off
+    uint64_t max_lag_us;        ///< Worst delay behind the arrival schedule
+    bool finished;              ///< max_frames reached
+} radio_sim_stats_t;
+
+/**
+ * @brief Fill a configuration with defaults: 100 Hz constant, 64 subcarriers, 1 transmitter
+ * @param config Configuration output
+ */
+void radio_sim_default_config(radio_sim_config_t *config);
+
+/**
+ * @brief Start the radio thread
+ * @param config Configuration
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad configuration,
+ *         ESP_ERR_INVALID_STATE if already running
+ */
+esp_err_t radio_sim_start(const radio_sim_config_t *config);
+
+/**
+ * @brief Stop the radio thread and wait for it
+ */
+void radio_sim_stop(void);
+
+/**
+ * @brief Read the counters
+ * @param stats Output
+ */
+void radio_sim_get_stats(radio_sim_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RADIO_SIM_H
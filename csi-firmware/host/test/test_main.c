@@ -0,0 +1,17 @@
+/**
+ * @file test_main.c
+ * @brief Host entry point for the component Unity tests
+ *
+ * The component test files define app_main() as on the device; the exit
+ * status carries the failure count to ctest.
+ */
+
+#include <unity.h>
+
+void app_main(void);
+
+int main(void)
+{
+    app_main();
+    return Unity.TestFailures ? 1 : 0;
+}
@@ -16,6 +16,7 @@
 #include <esp_wifi.h>
 #include <esp_event.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 
 #include "app_config.h"
@@ -28,6 +29,94 @@
 
 static const char *TAG = "MAIN";
 
+/**
+ * @brief How often CSI drop reports go out, and how many ranges each carries
+ */
+#define CSI_DROP_REPORT_INTERVAL_MS 1000
+#define CSI_DROP_REPORT_MAX_RANGES  16
+
+/**
+ * @brief Report CSI pipeline fill level and drops so OTA downloads can back off
+ * @param sample Load sample to fill
+ * @param user_ctx User context (unused)
+ * @return true if the collector is active and the sample is valid
+ */
+static bool ota_csi_load_probe(ota_load_sample_t *sample, void *user_ctx)
+{
+    if (!csi_collector_is_running()) {
+        return false;
+    }
+    
+    csi_collector_stats_t stats;
+    if (csi_collector_get_stats(&stats) != ESP_OK) {
+        return false;
+    }
+    sample->frames_dropped = stats.packets_dropped;
+    
+    return csi_collector_get_queue_depth(&sample->queue_depth, &sample->queue_capacity) == ESP_OK;
+}
+
+/**
+ * @brief Send the CSI drop log to whoever is receiving the stream
+ * 
+ * Goes out every interval even when empty: next_seq lets the receiver tell
+ * frames still in flight from frames lost at the end of the stream.
+ * 
+ * @param mqtt_enabled MQTT is configured
+ */
+static void report_csi_drops(bool mqtt_enabled)
+{
+    bool to_mqtt = mqtt_enabled && mqtt_client_is_connected();
+    bool to_ws = web_server_ws_has_clients();
+    if (!to_mqtt && !to_ws) {
+        // Keep the ranges until someone is listening
+        return;
+    }
+
+    csi_drop_range_t ranges[CSI_DROP_REPORT_MAX_RANGES];
+    size_t count = 0;
+    if (csi_collector_take_drops(ranges, CSI_DROP_REPORT_MAX_RANGES, &count) != ESP_OK) {
+        return;
+    }
+
+    if (to_mqtt && mqtt_client_publish_csi_drops(ranges, count) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to publish CSI drop report");
+    }
+
+    if (to_ws) {
+        char *json = csi_collector_drops_to_json(ranges, count);
+        if (json) {
+            web_server_ws_broadcast(json, strlen(json), false);
+            free(json);
+        }
+    }
+}
+
+/**
+ * @brief Stream a CSI frame to WebSocket clients in binary form
+ * @param csi_data CSI data
+ */
+static void stream_csi_to_websocket(const csi_data_t *csi_data)
+{
+    if (!web_server_ws_has_clients()) {
+        return;
+    }
+
+    size_t frame_len = csi_collector_frame_size(csi_data);
+    uint8_t *frame = malloc(frame_len);
+    if (!frame) {
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_WS_SEND);
+        return;
+    }
+
+    csi_collector_encode_frame(csi_data, frame);
+    esp_err_t err = web_server_ws_broadcast(frame, frame_len, true);
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        csi_collector_record_drop(csi_data->sequence, CSI_DROP_WS_SEND);
+    }
+    free(frame);
+}
+
 /**
  * @brief Main application task that coordinates all system components
  * @param pvParameters Task parameters (unused)
@@ -140,6 +229,13 @@ static void app_main_task(void *pvParameters)
     // Initialize OTA updater
     if (ota_updater_init(&config.ota) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize OTA updater");
+    } else {
+        ota_updater_register_load_probe(ota_csi_load_probe, NULL);
+        
+        // Automatic checks run on the updater's own jittered schedule
+        if (config.ota.enabled && ota_updater_start() != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start OTA updater");
+        }
     }
     
     ESP_LOGI(TAG, "All systems initialized successfully");
@@ -150,8 +246,8 @@ static void app_main_task(void *pvParameters)
     uint32_t mqtt_publish_count = 0;
     uint32_t mqtt_publish_errors = 0;
     TickType_t last_stats_time = xTaskGetTickCount();
-    TickType_t last_ota_check = xTaskGetTickCount();
     TickType_t last_system_metrics = xTaskGetTickCount();
+    TickType_t last_drop_report = xTaskGetTickCount();
     
     // Main application loop
     while (1) {
@@ -163,11 +259,14 @@ static void app_main_task(void *pvParameters)
             if (csi_collector_get_data(&csi_data, pdMS_TO_TICKS(100)) == ESP_OK) {
                 csi_data_count++;
                 
-                // Ensure CSI data has proper timestamp
+                // Convert the capture timestamp to UTC, backdated by the time the
+                // frame spent queued so it still marks the moment of capture
                 if (ntp_sync_is_synchronized()) {
                     struct timeval tv;
                     if (ntp_sync_get_time(&tv) == ESP_OK) {
-                        csi_data.timestamp = tv.tv_sec * 1000000ULL + tv.tv_usec;
+                        int64_t age_us = esp_timer_get_time() - (int64_t)csi_data.timestamp;
+                        csi_data.timestamp = tv.tv_sec * 1000000ULL + tv.tv_usec - age_us;
+                        csi_data.utc_timestamp = true;
                     }
                 }
                 
@@ -185,15 +284,26 @@ static void app_main_task(void *pvParameters)
                         mqtt_publish_errors++;
                         ESP_LOGW(TAG, "Failed to publish CSI data to MQTT: %s", esp_err_to_name(err));
                     }
+                } else if (config.mqtt.enabled) {
+                    csi_collector_record_drop(csi_data.sequence, CSI_DROP_NOT_CONNECTED);
                 }
                 
+                stream_csi_to_websocket(&csi_data);
+                
                 // Free CSI data resources
                 csi_collector_free_data(&csi_data);
             }
         }
         
-        // Periodic statistics and monitoring (every 30 seconds)
         TickType_t current_time = xTaskGetTickCount();
+        
+        // CSI drop reports for sequence gap attribution (every second)
+        if ((current_time - last_drop_report) >= pdMS_TO_TICKS(CSI_DROP_REPORT_INTERVAL_MS)) {
+            last_drop_report = current_time;
+            report_csi_drops(config.mqtt.enabled);
+        }
+        
+        // Periodic statistics and monitoring (every 30 seconds)
         if ((current_time - last_stats_time) >= pdMS_TO_TICKS(30000)) {
             last_stats_time = current_time;
             
@@ -246,18 +356,6 @@ static void app_main_task(void *pvParameters)
             ESP_LOGI(TAG, "Published system metrics to MQTT");
         }
         
-        // Check for OTA updates periodically (every 5 minutes)
-        if (config.ota.enabled && config.ota.auto_update &&
-            (current_time - last_ota_check) >= pdMS_TO_TICKS(300000)) {
-            last_ota_check = current_time;
-            
-            ESP_LOGI(TAG, "Checking for OTA updates...");
-            esp_err_t ota_err = ota_updater_check_for_updates();
-            if (ota_err != ESP_OK) {
-                ESP_LOGW(TAG, "OTA update check failed: %s", esp_err_to_name(ota_err));
-            }
-        }
-        
         // Monitor system health and restart if necessary
         if (esp_get_free_heap_size() < 10000) {  // Less than 10KB free heap
             ESP_LOGE(TAG, "Critical low memory condition detected!");
@@ -11,6 +11,7 @@
 #include "app_config.h"
 #include "mqtt_client_wrapper.h"
 #include "csi_collector.h"
+#include "csi_replay.h"
 #include "web_server.h"
 #include "ntp_sync.h"
 
@@ -200,7 +201,12 @@ esp_err_t remote_config_update_handler(const cJSON *config)
     
     char *ack_str = cJSON_PrintUnformatted(ack);
     if (ack_str) {
-        mqtt_client_publish(ack_topic, ack_str, strlen(ack_str), 1, false);
+        mqtt_publish_options_t options = {
+            .qos = 1,
+            .utf8_payload = true,
+            .msg_class = MQTT_CLASS_CONTROL,
+        };
+        mqtt_client_publish_with_options(ack_topic, ack_str, strlen(ack_str), &options);
         free(ack_str);
     }
     cJSON_Delete(ack);
@@ -208,6 +214,53 @@ esp_err_t remote_config_update_handler(const cJSON *config)
     return err;
 }
 
+/**
+ * @brief Start replaying a recording from the filesystem
+ * 
+ * {"command":"replay_start","file":"/spiffs/trace.bin","speed":1,
+ *  "format":"auto","wait_ms":0}; only "file" is required.
+ */
+static esp_err_t handle_replay_start(const cJSON *params)
+{
+    cJSON *file = cJSON_GetObjectItem(params, "file");
+    if (!file || !cJSON_IsString(file)) {
+        ESP_LOGE(TAG, "replay_start needs a file");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    csi_replay_config_t config = CSI_REPLAY_DEFAULT_CONFIG();
+    config.close_input = true;
+
+    cJSON *item = cJSON_GetObjectItem(params, "speed");
+    if (item && cJSON_IsNumber(item)) {
+        config.speed = (float)item->valuedouble;
+    }
+
+    item = cJSON_GetObjectItem(params, "wait_ms");
+    if (item && cJSON_IsNumber(item)) {
+        config.wait_ms = (uint32_t)item->valueint;
+    }
+
+    item = cJSON_GetObjectItem(params, "format");
+    if (item && cJSON_IsString(item) &&
+        csi_replay_format_from_name(item->valuestring, &config.format) != ESP_OK) {
+        ESP_LOGE(TAG, "Unknown replay format: %s", item->valuestring);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    FILE *input = fopen(file->valuestring, "rb");
+    if (!input) {
+        ESP_LOGE(TAG, "Cannot open %s", file->valuestring);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = csi_replay_start(input, &config);
+    if (err != ESP_OK) {
+        fclose(input);
+    }
+    return err;
+}
+
 /**
  * @brief Remote command handler
  */
@@ -236,6 +289,12 @@ esp_err_t remote_command_handler(const cJSON *params)
     else if (strcmp(command, "stop_csi") == 0) {
         return csi_collector_stop();
     }
+    else if (strcmp(command, "replay_start") == 0) {
+        return handle_replay_start(params);
+    }
+    else if (strcmp(command, "replay_stop") == 0) {
+        return csi_replay_stop();
+    }
     else if (strcmp(command, "calibrate") == 0) {
         // Trigger calibration mode
         ESP_LOGI(TAG, "Starting calibration mode");
@@ -296,7 +355,12 @@ static void publish_detailed_status(void)
     
     char *status_str = cJSON_PrintUnformatted(status);
     if (status_str) {
-        mqtt_client_publish(topic, status_str, strlen(status_str), 1, false);
+        mqtt_publish_options_t options = {
+            .qos = 1,
+            .utf8_payload = true,
+            .msg_class = MQTT_CLASS_STATUS,
+        };
+        mqtt_client_publish_with_options(topic, status_str, strlen(status_str), &options);
         free(status_str);
     }
     cJSON_Delete(status);
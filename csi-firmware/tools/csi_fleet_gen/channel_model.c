@@ -0,0 +1,255 @@
+/**
+ * @file channel_model.c
+ * @brief Multipath channel of one room with people walking through it
+ */
+
+#include "channel_model.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SPEED_OF_LIGHT      299792458.0
+#define SUBCARRIER_SPACING  312500.0
+#define USED_SUBCARRIERS    26          // +-1..26 carry the LLTF; DC and guards are null
+#define TX_POWER_DBM        20.0f
+#define PERSON_GAIN         0.6f        // scattering strength of a body
+#define BREATH_DISPLACEMENT 0.004f      // chest movement (m)
+#define SHADOW_DEPTH        0.7f        // line of sight lost behind a body
+#define SHADOW_WIDTH        0.3f        // (m)
+#define MIN_DISTANCE        0.3f
+#define WALL_MARGIN         0.3f
+#define AGC_TARGET_RMS      18.0f       // typical ESP32 raw magnitude
+#define AGC_SMOOTHING       0.2f
+#define TIMING_OFFSET_S     50e-9
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static uint32_t model_random(channel_model_t *m)
+{
+    m->rng ^= m->rng << 13;
+    m->rng ^= m->rng >> 17;
+    m->rng ^= m->rng << 5;
+    return m->rng;
+}
+
+static float uniform(channel_model_t *m, float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(model_random(m) >> 8) / (float)(1u << 24);
+}
+
+static float gaussian(channel_model_t *m)
+{
+    float u1 = uniform(m, 1e-7f, 1.0f);
+    float u2 = uniform(m, 0.0f, 1.0f);
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+static float distance(float ax, float ay, float bx, float by)
+{
+    float d = hypotf(ax - bx, ay - by);
+    return d < MIN_DISTANCE ? MIN_DISTANCE : d;
+}
+
+static void pick_waypoint(channel_model_t *m, channel_person_t *p)
+{
+    p->goal_x = uniform(m, WALL_MARGIN, m->width - WALL_MARGIN);
+    p->goal_y = uniform(m, WALL_MARGIN, m->depth - WALL_MARGIN);
+}
+
+void channel_model_init(channel_model_t *m, uint32_t seed, int channel, int people)
+{
+    memset(m, 0, sizeof(*m));
+    m->rng = seed ? seed : 1;
+
+    m->width = uniform(m, 4.0f, 9.0f);
+    m->depth = uniform(m, 3.0f, 7.0f);
+    m->tx_x = uniform(m, WALL_MARGIN, 1.0f);
+    m->tx_y = uniform(m, 0.5f, m->depth - 0.5f);
+    m->rx_x = m->width - uniform(m, WALL_MARGIN, 1.0f);
+    m->rx_y = uniform(m, 0.5f, m->depth - 0.5f);
+    for (int i = 0; i < CHANNEL_WALLS; i++) {
+        m->wall_gain[i] = uniform(m, 0.2f, 0.6f);
+    }
+    // Without them every path has about the same length and the whole band fades at once
+    for (int i = 0; i < CHANNEL_SCATTERERS; i++) {
+        m->scatterer[i][0] = uniform(m, 0.0f, m->width);
+        m->scatterer[i][1] = uniform(m, 0.0f, m->depth);
+        m->scatterer[i][2] = uniform(m, 0.1f, 0.4f);
+    }
+    m->path_loss_db = uniform(m, 5.0f, 25.0f);
+    m->snr_db = uniform(m, 20.0f, 35.0f);
+
+    m->freq_hz = channel == 14 ? 2484e6f : (2407.0f + 5.0f * channel) * 1e6f;
+
+    m->people = people < 0 ? 0 : people > CHANNEL_MAX_PEOPLE ? CHANNEL_MAX_PEOPLE : people;
+    for (int i = 0; i < m->people; i++) {
+        channel_person_t *p = &m->person[i];
+        p->x = uniform(m, WALL_MARGIN, m->width - WALL_MARGIN);
+        p->y = uniform(m, WALL_MARGIN, m->depth - WALL_MARGIN);
+        p->speed = uniform(m, 0.5f, 1.4f);
+        p->pause_s = uniform(m, 0.0f, 10.0f);
+        p->breath_hz = uniform(m, 0.2f, 0.33f);
+        p->breath_phase = uniform(m, 0.0f, 2.0f * (float)M_PI);
+        pick_waypoint(m, p);
+    }
+}
+
+void channel_model_step(channel_model_t *m, float dt)
+{
+    m->t += dt;
+
+    for (int i = 0; i < m->people; i++) {
+        channel_person_t *p = &m->person[i];
+        if (p->pause_s > 0) {
+            p->pause_s -= dt;
+            continue;
+        }
+
+        float dx = p->goal_x - p->x;
+        float dy = p->goal_y - p->y;
+        float left = hypotf(dx, dy);
+        float step = p->speed * dt;
+        if (step >= left) {
+            p->x = p->goal_x;
+            p->y = p->goal_y;
+            p->pause_s = uniform(m, 0.0f, 8.0f);
+            pick_waypoint(m, p);
+        } else {
+            p->x += dx / left * step;
+            p->y += dy / left * step;
+        }
+    }
+}
+
+/**
+ * @brief Fraction of the line of sight left past the people standing on it
+ */
+static float los_shadow(const channel_model_t *m)
+{
+    float vx = m->rx_x - m->tx_x;
+    float vy = m->rx_y - m->tx_y;
+    float len2 = vx * vx + vy * vy;
+    float gain = 1.0f;
+
+    for (int i = 0; i < m->people; i++) {
+        const channel_person_t *p = &m->person[i];
+        float u = ((p->x - m->tx_x) * vx + (p->y - m->tx_y) * vy) / len2;
+        if (u <= 0.0f || u >= 1.0f) {
+            continue;
+        }
+        float d = hypotf(m->tx_x + u * vx - p->x, m->tx_y + u * vy - p->y) / SHADOW_WIDTH;
+        gain *= 1.0f - SHADOW_DEPTH * expf(-d * d);
+    }
+    return gain;
+}
+
+/**
+ * @brief Add one path to the channel response
+ *
+ * The phase over the subcarriers is a linear ramp, so it is rotated one
+ * subcarrier at a time instead of calling sin/cos for every bin.
+ */
+static void add_path(double *h_re, double *h_im, double freq_hz, double length, double amplitude)
+{
+    double tau = length / SPEED_OF_LIGHT;
+    double start = -2.0 * M_PI * (freq_hz - 32 * SUBCARRIER_SPACING) * tau;
+    double step = -2.0 * M_PI * SUBCARRIER_SPACING * tau;
+    double re = amplitude * cos(start);
+    double im = amplitude * sin(start);
+    double step_re = cos(step);
+    double step_im = sin(step);
+
+    for (int sc = -32; sc < 32; sc++) {
+        h_re[sc + 32] += re;
+        h_im[sc + 32] += im;
+        double next_re = re * step_re - im * step_im;
+        im = re * step_im + im * step_re;
+        re = next_re;
+    }
+}
+
+int8_t channel_model_sample(channel_model_t *m, int8_t *raw)
+{
+    double h_re[CHANNEL_SUBCARRIERS] = {0};
+    double h_im[CHANNEL_SUBCARRIERS] = {0};
+
+    // Line of sight
+    float los = distance(m->tx_x, m->tx_y, m->rx_x, m->rx_y);
+    add_path(h_re, h_im, m->freq_hz, los, los_shadow(m) / los);
+
+    // One bounce off each wall, through the image of the transmitter
+    const float images[CHANNEL_WALLS][2] = {
+        { -m->tx_x, m->tx_y },
+        { 2.0f * m->width - m->tx_x, m->tx_y },
+        { m->tx_x, -m->tx_y },
+        { m->tx_x, 2.0f * m->depth - m->tx_y },
+    };
+    for (int i = 0; i < CHANNEL_WALLS; i++) {
+        float len = distance(images[i][0], images[i][1], m->rx_x, m->rx_y);
+        add_path(h_re, h_im, m->freq_hz, len, m->wall_gain[i] / len);
+    }
+
+    // Furniture
+    for (int i = 0; i < CHANNEL_SCATTERERS; i++) {
+        const float *s = m->scatterer[i];
+        float d1 = distance(m->tx_x, m->tx_y, s[0], s[1]);
+        float d2 = distance(s[0], s[1], m->rx_x, m->rx_y);
+        add_path(h_re, h_im, m->freq_hz, d1 + d2, s[2] / (d1 * d2));
+    }
+
+    // Scattering off each person; breathing moves the chest a few mm
+    for (int i = 0; i < m->people; i++) {
+        const channel_person_t *p = &m->person[i];
+        float d1 = distance(m->tx_x, m->tx_y, p->x, p->y);
+        float d2 = distance(p->x, p->y, m->rx_x, m->rx_y);
+        float breath = 2.0f * BREATH_DISPLACEMENT *
+                       sinf(2.0f * (float)M_PI * p->breath_hz * m->t + p->breath_phase);
+        add_path(h_re, h_im, m->freq_hz, d1 + d2 + breath, PERSON_GAIN / (d1 * d2));
+    }
+
+    double power = 0;
+    for (int sc = -USED_SUBCARRIERS; sc <= USED_SUBCARRIERS; sc++) {
+        if (sc != 0) {
+            power += h_re[sc + 32] * h_re[sc + 32] + h_im[sc + 32] * h_im[sc + 32];
+        }
+    }
+    float rms = (float)sqrt(power / (2 * USED_SUBCARRIERS));
+
+    // AGC settles over a few packets rather than normalizing every one
+    float target = rms > 0 ? AGC_TARGET_RMS / rms : 1.0f;
+    m->agc = m->agc > 0 ? m->agc + AGC_SMOOTHING * (target - m->agc) : target;
+
+    float noise = AGC_TARGET_RMS * powf(10.0f, -m->snr_db / 20.0f) / sqrtf(2.0f);
+    float common = uniform(m, 0.0f, 2.0f * (float)M_PI);
+    float slope = -2.0f * (float)M_PI * (float)SUBCARRIER_SPACING *
+                  uniform(m, -(float)TIMING_OFFSET_S, (float)TIMING_OFFSET_S);
+
+    // Reported in the ESP32 order: subcarriers 0..31, then -32..-1
+    for (int k = 0; k < CHANNEL_SUBCARRIERS; k++) {
+        int sc = k < 32 ? k : k - 64;
+        if (sc == 0 || sc < -USED_SUBCARRIERS || sc > USED_SUBCARRIERS) {
+            raw[2 * k] = 0;
+            raw[2 * k + 1] = 0;
+            continue;
+        }
+
+        float rot = common + slope * sc;
+        float c = cosf(rot), s = sinf(rot);
+        float re = (float)h_re[sc + 32] * m->agc;
+        float im = (float)h_im[sc + 32] * m->agc;
+        float out_re = re * c - im * s + noise * gaussian(m);
+        float out_im = re * s + im * c + noise * gaussian(m);
+
+        float q_re = roundf(out_re), q_im = roundf(out_im);
+        raw[2 * k] = (int8_t)(q_im > 127 ? 127 : q_im < -128 ? -128 : q_im);
+        raw[2 * k + 1] = (int8_t)(q_re > 127 ? 127 : q_re < -128 ? -128 : q_re);
+    }
+
+    // Free space on top of the model's 1/d amplitudes, then walls and antennas
+    float lambda = (float)(SPEED_OF_LIGHT / m->freq_hz);
+    float rssi = TX_POWER_DBM + 20.0f * log10f(lambda / (4.0f * (float)M_PI)) +
+                 20.0f * log10f(rms > 0 ? rms : 1e-6f) - m->path_loss_db + gaussian(m);
+    return (int8_t)(rssi < -100 ? -100 : rssi > -10 ? -10 : lroundf(rssi));
+}
@@ -0,0 +1,79 @@
+/**
+ * @file channel_model.h
+ * @brief Multipath channel of one room with people walking through it
+ *
+ * The same idea as csi_visualization_example.py, extended to a whole room:
+ * the line of sight, one reflection off each wall (image method), a few
+ * static scatterers (furniture) and one scattered path per person, summed
+ * per subcarrier. People follow random waypoints with pauses, breathe
+ * while they stand, and shadow the line of sight when they cross it. On top come the impairments a real receiver
+ * adds: noise, a random common phase per packet (CFO/PLL), a random
+ * timing offset (a phase slope over the subcarriers) and AGC followed by
+ * int8 quantization. Null subcarriers (DC and guards) read zero, as on
+ * the ESP32.
+ */
+
+#ifndef CHANNEL_MODEL_H
+#define CHANNEL_MODEL_H
+
+#include <stdint.h>
+
+#define CHANNEL_MAX_PEOPLE      8
+#define CHANNEL_SUBCARRIERS     64      ///< HT20 LLTF, as the ESP32 reports it
+#define CHANNEL_WALLS           4
+#define CHANNEL_SCATTERERS      6
+
+/**
+ * @brief Person in the room
+ */
+typedef struct {
+    float x, y;                 ///< Position (m)
+    float goal_x, goal_y;       ///< Current waypoint
+    float speed;                ///< Walking speed (m/s)
+    float pause_s;              ///< Time left standing at the waypoint
+    float breath_hz;            ///< Breathing rate
+    float breath_phase;
+} channel_person_t;
+
+/**
+ * @brief Room, radios and occupants of one node
+ */
+typedef struct {
+    float width, depth;         ///< Room size (m)
+    float tx_x, tx_y;           ///< Access point
+    float rx_x, rx_y;           ///< Node
+    float wall_gain[CHANNEL_WALLS];
+    float scatterer[CHANNEL_SCATTERERS][3]; ///< x, y, gain
+    float path_loss_db;         ///< Walls and antennas on top of free space
+    float snr_db;
+    float agc;                  ///< Current AGC scale
+    float freq_hz;              ///< Centre frequency
+    float t;                    ///< Model time (s)
+    int people;
+    channel_person_t person[CHANNEL_MAX_PEOPLE];
+    uint32_t rng;
+} channel_model_t;
+
+/**
+ * @brief Lay out a random room with its own geometry and occupants
+ * @param m Model
+ * @param seed Per-node seed
+ * @param channel Wi-Fi channel (1-14)
+ * @param people Number of people in the room (clamped to CHANNEL_MAX_PEOPLE)
+ */
+void channel_model_init(channel_model_t *m, uint32_t seed, int channel, int people);
+
+/**
+ * @brief Advance people by dt seconds
+ */
+void channel_model_step(channel_model_t *m, float dt);
+
+/**
+ * @brief Draw one CSI report
+ * @param m Model
+ * @param raw Output, 2 * CHANNEL_SUBCARRIERS bytes of imaginary/real pairs
+ * @return RSSI (dBm)
+ */
+int8_t channel_model_sample(channel_model_t *m, int8_t *raw);
+
+#endif // CHANNEL_MODEL_H
@@ -0,0 +1,1390 @@
+/**
+ * @file csi_fleet_gen.c
+ * @brief Synthetic fleet of CSI nodes for broker and backend load tests
+ *
+ * Every virtual node behaves like the firmware on the wire: an MQTT v5
+ * client with the node's topics, QoS, retain flags and v5 properties,
+ * publishing through the firmware's own priority outbox (mqtt_outbox.c)
+ * and reconnecting with its backoff (mqtt_backoff.c). Payloads are
+ * byte-exact with mqtt_publisher.c and the collector's encoders, and the
+ * CSI comes from a multipath model of a room with people walking in it
+ * (channel_model.c).
+ *
+ *     devices/<node>/status    connect, QoS 1, retained
+ *     devices/<node>/metrics   every --metrics-interval, QoS 0
+ *     devices/<node>/alerts    "Critical low memory" then a restart, QoS 1
+ *     <node>/csi_data          --csi-rate Hz, JSON (or <node>/csi_frame with --binary)
+ *
+ * Nodes are sharded over --threads event loops (epoll, one timer heap
+ * each), so a single box drives thousands of them against the mosquitto
+ * of docker-compose.yml:
+ *
+ *     docker compose up -d mosquitto
+ *     csi_fleet_gen --nodes 2000 --threads 4 --csi-rate 10
+ *
+ * Once a second the totals are printed; with --duration the run ends on
+ * its own, otherwise on Ctrl-C, and each node sends a clean DISCONNECT.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mqtt_backoff.h"
+#include "mqtt_outbox.h"
+#include "mqtt5_codec.h"
+#include "fleet_payload.h"
+#include "channel_model.h"
+
+// Same as mqtt_client_wrapper.c
+#define MQTT_CLASS_TELEMETRY    0
+#define MQTT_CLASS_CONTROL      1
+#define MQTT_CLASS_ALERT        2
+#define MQTT_CLASS_STATUS       3
+#define MQTT_CLASS_CSI          4
+#define CSI_MESSAGE_EXPIRY_S    5
+#define OUTBOX_INFLIGHT_LIMIT   8192
+#define OUTBOX_BULK_CLASSES     ((1u << MQTT_CLASS_CSI) | (1u << MQTT_CLASS_TELEMETRY))
+#define CONNECT_TIMEOUT_MS      10000   // network.timeout_ms
+#define FIRMWARE_VERSION        "1.0.0"
+
+static const mqtt_outbox_class_config_t s_outbox_classes[MQTT_OUTBOX_CLASSES] = {
+    [MQTT_CLASS_TELEMETRY] = { .budget_bytes = 8 * 1024,  .weight = 2, .policy = MQTT_OUTBOX_DROP_OLDEST },
+    [MQTT_CLASS_CONTROL]   = { .budget_bytes = 8 * 1024,  .weight = 8, .policy = MQTT_OUTBOX_DROP_NEWEST },
+    [MQTT_CLASS_ALERT]     = { .budget_bytes = 8 * 1024,  .weight = 8, .policy = MQTT_OUTBOX_DROP_OLDEST },
+    [MQTT_CLASS_STATUS]    = { .budget_bytes = 4 * 1024,  .weight = 4, .policy = MQTT_OUTBOX_DROP_OLDEST },
+    [MQTT_CLASS_CSI]       = { .budget_bytes = 32 * 1024, .weight = 1, .policy = MQTT_OUTBOX_DROP_OLDEST },
+};
+
+#define DEFAULT_NODES           100
+#define DEFAULT_CSI_RATE        10      // csi.sample_rate default
+#define DEFAULT_PEOPLE          3
+#define DEFAULT_METRICS_S       300
+#define DEFAULT_ALERT_S         3600
+#define DEFAULT_CONNECT_RATE    200
+#define DEFAULT_KEEPALIVE       60
+#define RESTART_DELAY_MS        5000    // main.c waits this long before esp_restart()
+#define BOOT_MIN_MS             2000    // boot to first connect attempt
+#define BOOT_MAX_MS             4000
+#define INFLIGHT_SLOTS          64      // QoS 1 messages awaiting PUBACK
+#define TX_HIGH_WATER           (64 * 1024)
+#define RX_MAX                  (256 * 1024)
+#define MAX_EVENTS              256
+#define MAX_LAG_US              1000000 // CSI further behind than this is skipped
+
+typedef enum {
+    NODE_BOOTING,               // waiting for the first connect (or after a restart)
+    NODE_BACKOFF,
+    NODE_CONNECTING,            // TCP handshake
+    NODE_WAIT_CONNACK,
+    NODE_CONNECTED,
+} node_state_t;
+
+typedef struct {
+    const char *host;
+    const char *port;
+    const char *prefix;
+    int nodes;
+    int threads;
+    double csi_rate;
+    int qos;
+    bool binary;
+    int people;
+    double metrics_s;
+    double alert_s;
+    double connect_rate;
+    uint16_t keepalive;
+    double duration_s;
+    uint32_t seed;
+} fleet_config_t;
+
+/**
+ * @brief Counters of one worker, summed by the reporter
+ */
+typedef struct {
+    atomic_llong connected;
+    atomic_ullong connects;
+    atomic_ullong connect_failures;
+    atomic_ullong disconnects;
+    atomic_ullong restarts;
+    atomic_ullong sent[MQTT_OUTBOX_CLASSES];
+    atomic_ullong bytes;
+    atomic_ullong acks;
+    atomic_ullong received;
+    atomic_ullong dropped;      // outbox overflow
+    atomic_ullong expired;      // outbox expiry
+    atomic_ullong offline;      // CSI captured while not connected
+    atomic_ullong late;         // CSI skipped because the generator fell behind
+} fleet_stats_t;
+
+typedef struct {
+    uint64_t connects, connect_failures, disconnects, restarts;
+    uint64_t sent[MQTT_OUTBOX_CLASSES];
+    uint64_t bytes, acks, received, dropped, expired, offline, late;
+    int64_t connected;
+} fleet_totals_t;
+
+struct worker;
+
+typedef struct {
+    uint16_t packet_id;
+    uint32_t size;
+} inflight_t;
+
+typedef struct node {
+    struct worker *worker;
+    int index;
+    char name[32];
+    char csi_topic[48];
+    uint8_t ap_mac[6];          // transmitter the node captures CSI from
+    uint8_t wifi_channel;
+
+    node_state_t state;
+    int fd;
+    bool want_out;              // EPOLLOUT registered
+    int64_t wake_us;            // time of the live heap entry, -1 if none
+    int64_t deadline_us;        // connect or CONNACK timeout
+    int64_t next_connect_us;
+    int64_t connected_us;
+    int64_t boot_us;
+
+    mqtt_backoff_t backoff;
+    mqtt_outbox_t outbox;
+    uint8_t *tx;
+    size_t tx_len, tx_off, tx_cap;
+    uint8_t *rx;
+    size_t rx_len, rx_cap;
+
+    uint16_t next_packet_id;
+    uint16_t receive_max;
+    uint16_t keepalive;
+    bool alias_enabled;
+    bool alias_sent;
+    inflight_t inflight[INFLIGHT_SLOTS];
+    int inflight_count;
+    uint32_t inflight_bytes;
+    bool ping_outstanding;
+
+    uint32_t sequence;
+    int64_t next_csi_us;
+    int64_t next_metrics_us;
+    int64_t next_alert_us;
+    int64_t next_ping_us;
+    int64_t restart_us;         // pending restart after a low memory alert, 0 if none
+    int8_t rssi;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    channel_model_t channel;
+} node_t;
+
+typedef struct {
+    int64_t t;
+    node_t *node;
+} event_t;
+
+typedef struct {
+    event_t *items;
+    size_t len, cap;
+} heap_t;
+
+typedef struct worker {
+    int id;
+    int epfd;
+    pthread_t thread;
+    node_t *nodes;
+    int count;
+    heap_t heap;
+    uint32_t rng;
+    fleet_stats_t stats;
+    int8_t raw[2 * CHANNEL_SUBCARRIERS];
+    char json[FLEET_PAYLOAD_MAX_CSI_JSON];
+} worker_t;
+
+static fleet_config_t s_cfg;
+static struct sockaddr_storage s_addr;
+static socklen_t s_addr_len;
+static int64_t s_period_us;
+static uint32_t s_qos1_classes;
+static atomic_bool s_stop;
+
+#define STAT_ADD(w, field, n) atomic_fetch_add_explicit(&(w)->stats.field, (n), memory_order_relaxed)
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t utc_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t worker_random(worker_t *w)
+{
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 17;
+    w->rng ^= w->rng << 5;
+    return w->rng;
+}
+
+static double worker_uniform(worker_t *w)
+{
+    return (worker_random(w) >> 8) / (double)(1u << 24);
+}
+
+static int64_t seconds_us(double s)
+{
+    return (int64_t)(s * 1000000.0);
+}
+
+static bool heap_push(heap_t *h, int64_t t, node_t *node)
+{
+    if (h->len == h->cap) {
+        size_t cap = h->cap ? h->cap * 2 : 1024;
+        event_t *items = realloc(h->items, cap * sizeof(event_t));
+        if (!items) {
+            return false;
+        }
+        h->items = items;
+        h->cap = cap;
+    }
+
+    size_t i = h->len++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (h->items[parent].t <= t) {
+            break;
+        }
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i].t = t;
+    h->items[i].node = node;
+    return true;
+}
+
+static event_t heap_pop(heap_t *h)
+{
+    event_t top = h->items[0];
+    event_t last = h->items[--h->len];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= h->len) {
+            break;
+        }
+        if (child + 1 < h->len && h->items[child + 1].t < h->items[child].t) {
+            child++;
+        }
+        if (h->items[child].t >= last.t) {
+            break;
+        }
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->len > 0) {
+        h->items[i] = last;
+    }
+    return top;
+}
+
+/**
+ * @brief Earliest time the node has something to do
+ */
+static int64_t node_wake_time(const node_t *n)
+{
+    switch (n->state) {
+    case NODE_BOOTING:
+    case NODE_BACKOFF:
+        return n->next_connect_us;
+    case NODE_CONNECTING:
+    case NODE_WAIT_CONNACK:
+        return n->deadline_us;
+    case NODE_CONNECTED: {
+        int64_t t = n->next_ping_us;
+        if (n->next_csi_us < t) {
+            t = n->next_csi_us;
+        }
+        if (n->next_metrics_us < t) {
+            t = n->next_metrics_us;
+        }
+        if (n->next_alert_us < t) {
+            t = n->next_alert_us;
+        }
+        if (n->restart_us && n->restart_us < t) {
+            t = n->restart_us;
+        }
+        return t;
+    }
+    }
+    return INT64_MAX;
+}
+
+/**
+ * @brief Keep one live heap entry per node; superseded entries are skipped when popped
+ */
+static void node_reschedule(worker_t *w, node_t *n)
+{
+    int64_t t = node_wake_time(n);
+    if (t != n->wake_us && heap_push(&w->heap, t, n)) {
+        n->wake_us = t;
+    }
+}
+
+static void node_on_drop(const mqtt_outbox_msg_t *msg, bool expired, void *ctx)
+{
+    node_t *n = ctx;
+    if (expired) {
+        STAT_ADD(n->worker, expired, 1);
+    } else {
+        STAT_ADD(n->worker, dropped, 1);
+    }
+    (void)msg;
+}
+
+static void node_init(worker_t *w, node_t *n, int index)
+{
+    memset(n, 0, sizeof(*n));
+    n->worker = w;
+    n->index = index;
+    n->fd = -1;
+    n->wake_us = -1;
+    snprintf(n->name, sizeof(n->name), "%s-%05d", s_cfg.prefix, index);
+    snprintf(n->csi_topic, sizeof(n->csi_topic), "%s/%s", n->name,
+             s_cfg.binary ? CSI_TOPIC_FRAME : CSI_TOPIC_JSON);
+
+    // Node and access point MACs from one vendor block, like a real deployment
+    uint8_t mac[6] = {0x24, 0x0a, 0xc4, (uint8_t)(index >> 16), (uint8_t)(index >> 8), (uint8_t)index};
+    memcpy(n->ap_mac, mac, sizeof(mac));
+    n->ap_mac[0] = 0x30;
+    n->ap_mac[3] ^= 0x80;
+
+    static const uint8_t channels[] = {1, 6, 11};
+    uint32_t seed = s_cfg.seed * 2654435761u + (uint32_t)index * 40503u + 1;
+    n->wifi_channel = channels[index % 3];
+    channel_model_init(&n->channel, seed, n->wifi_channel,
+                       (int)(worker_random(w) % (uint32_t)(s_cfg.people + 1)));
+
+    mqtt_outbox_init(&n->outbox, s_outbox_classes);
+    mqtt_outbox_set_drop_callback(&n->outbox, node_on_drop, n);
+    mqtt_backoff_init(&n->backoff, MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_CAP_MS, mac, seed);
+
+    n->free_heap = 180000 + worker_random(w) % 40000;
+    n->min_free_heap = n->free_heap - worker_random(w) % 20000;
+    n->rssi = -50;
+}
+
+static void node_free(node_t *n)
+{
+    if (n->fd >= 0) {
+        close(n->fd);
+        n->fd = -1;
+    }
+    mqtt_outbox_clear(&n->outbox);
+    free(n->tx);
+    free(n->rx);
+}
+
+/**
+ * @brief Make room for len more bytes at the end of the transmit buffer
+ */
+static uint8_t *node_tx_reserve(node_t *n, size_t len)
+{
+    if (n->tx_off == n->tx_len) {
+        n->tx_off = n->tx_len = 0;
+    }
+    if (n->tx_cap - n->tx_len < len && n->tx_off > 0) {
+        memmove(n->tx, n->tx + n->tx_off, n->tx_len - n->tx_off);
+        n->tx_len -= n->tx_off;
+        n->tx_off = 0;
+    }
+    if (n->tx_cap - n->tx_len < len) {
+        size_t cap = n->tx_cap ? n->tx_cap : 4096;
+        while (cap - n->tx_len < len) {
+            cap *= 2;
+        }
+        uint8_t *tx = realloc(n->tx, cap);
+        if (!tx) {
+            return NULL;
+        }
+        n->tx = tx;
+        n->tx_cap = cap;
+    }
+    uint8_t *p = n->tx + n->tx_len;
+    n->tx_len += len;
+    return p;
+}
+
+static void node_set_out(node_t *n, bool want)
+{
+    if (n->want_out == want) {
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | (want ? EPOLLOUT : 0), .data.ptr = n };
+    epoll_ctl(n->worker->epfd, EPOLL_CTL_MOD, n->fd, &ev);
+    n->want_out = want;
+}
+
+static void node_disconnect(node_t *n, int64_t now, uint32_t hint_ms);
+
+/**
+ * @brief Write as much of the transmit buffer as the socket takes
+ * @return false if the connection was lost
+ */
+static bool node_flush(node_t *n, int64_t now)
+{
+    while (n->tx_off < n->tx_len) {
+        ssize_t r = send(n->fd, n->tx + n->tx_off, n->tx_len - n->tx_off, MSG_NOSIGNAL);
+        if (r > 0) {
+            n->tx_off += r;
+            continue;
+        }
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            node_set_out(n, true);
+            return true;
+        }
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        node_disconnect(n, now, 0);
+        return false;
+    }
+    node_set_out(n, false);
+    return true;
+}
+
+static uint16_t node_packet_id(node_t *n)
+{
+    if (++n->next_packet_id == 0) {
+        n->next_packet_id = 1;
+    }
+    return n->next_packet_id;
+}
+
+/**
+ * @brief Hand queued messages to the socket, as the outbox task hands them to esp-mqtt
+ *
+ * Bulk classes wait while unacknowledged and unsent bytes are above
+ * OUTBOX_INFLIGHT_LIMIT; QoS 1 classes wait while the broker's receive
+ * maximum (or our tracking table) is full.
+ */
+static void node_drain(node_t *n, int64_t now)
+{
+    worker_t *w = n->worker;
+    uint32_t now_ms = (uint32_t)(now / 1000);
+
+    while (n->state == NODE_CONNECTED && n->tx_len - n->tx_off < TX_HIGH_WATER) {
+        uint32_t blocked = 0;
+        if (n->inflight_bytes + (n->tx_len - n->tx_off) > OUTBOX_INFLIGHT_LIMIT) {
+            blocked |= OUTBOX_BULK_CLASSES;
+        }
+        int window = n->receive_max < INFLIGHT_SLOTS ? n->receive_max : INFLIGHT_SLOTS;
+        if (n->inflight_count >= window) {
+            blocked |= s_qos1_classes;
+        }
+
+        mqtt_outbox_msg_t *msg = mqtt_outbox_pop(&n->outbox, now_ms, blocked);
+        if (!msg) {
+            break;
+        }
+
+        mqtt5_publish_t pub = {
+            .topic = msg->topic,
+            .qos = msg->qos,
+            .retain = msg->retain,
+            .utf8_payload = msg->utf8_payload,
+            .expiry_s = msg->expiry_s,
+            .content_type = msg->content_type,
+            .payload = msg->data,
+            .payload_len = msg->data_len,
+        };
+
+        // The full topic goes out with the alias once per connection
+        if (msg->topic_alias && n->alias_enabled) {
+            pub.topic_alias = 1;
+            if (n->alias_sent) {
+                pub.topic = NULL;
+            }
+            n->alias_sent = true;
+        }
+
+        if (pub.qos > 0) {
+            pub.packet_id = node_packet_id(n);
+            for (int i = 0; i < INFLIGHT_SLOTS; i++) {
+                if (n->inflight[i].packet_id == 0) {
+                    n->inflight[i].packet_id = pub.packet_id;
+                    n->inflight[i].size = msg->data_len;
+                    n->inflight_count++;
+                    n->inflight_bytes += msg->data_len;
+                    break;
+                }
+            }
+        }
+
+        size_t size = mqtt5_publish_size(&pub);
+        uint8_t *p = node_tx_reserve(n, size);
+        if (p) {
+            mqtt5_encode_publish(p, &pub);
+            STAT_ADD(w, sent[msg->msg_class], 1);
+            STAT_ADD(w, bytes, size);
+        }
+        mqtt_outbox_msg_free(msg);
+    }
+}
+
+/**
+ * @brief Queue a message with the options the firmware would give it
+ */
+static void node_submit(node_t *n, const char *topic, const char *content_type, const void *data,
+                        size_t len, uint8_t msg_class, int qos, bool retain, bool utf8, uint32_t expiry_s,
+                        int64_t now)
+{
+    mqtt_outbox_msg_t *msg = mqtt_outbox_msg_alloc(topic, content_type, (uint32_t)len);
+    if (!msg) {
+        STAT_ADD(n->worker, dropped, 1);
+        return;
+    }
+    memcpy(msg->data, data, len);
+    msg->msg_class = msg_class;
+    msg->qos = (int8_t)qos;
+    msg->retain = retain;
+    msg->utf8_payload = utf8;
+    msg->topic_alias = msg_class == MQTT_CLASS_CSI;
+    msg->expiry_s = expiry_s;
+    msg->expiry_ms = expiry_s * 1000;
+    mqtt_outbox_push(&n->outbox, msg, (uint32_t)(now / 1000));
+}
+
+static void node_publish_status(node_t *n, int64_t now)
+{
+    char buf[FLEET_PAYLOAD_MAX_TEXT];
+    char topic[64];
+    snprintf(topic, sizeof(topic), "devices/%s/status", n->name);
+    size_t len = fleet_payload_status(buf, n->name, FIRMWARE_VERSION, (uint32_t)((now - n->boot_us) / 1000000),
+                                      n->rssi, n->free_heap, utc_us());
+    node_submit(n, topic, NULL, buf, len, MQTT_CLASS_STATUS, 1, true, true, 0, now);
+}
+
+static void node_publish_metrics(node_t *n, int64_t now)
+{
+    worker_t *w = n->worker;
+    char buf[FLEET_PAYLOAD_MAX_TEXT];
+    char topic[64];
+
+    // Heap wanders a little, the low-water mark only goes down
+    n->free_heap += (int32_t)(worker_random(w) % 8001) - 4000;
+    if (n->free_heap < n->min_free_heap) {
+        n->min_free_heap = n->free_heap;
+    }
+
+    snprintf(topic, sizeof(topic), "devices/%s/metrics", n->name);
+    size_t len = fleet_payload_metrics(buf, (float)(5.0 + 35.0 * worker_uniform(w)), n->free_heap,
+                                       n->min_free_heap, 18 + worker_random(w) % 5, utc_us());
+    node_submit(n, topic, NULL, buf, len, MQTT_CLASS_TELEMETRY, 0, false, true, 0, now);
+}
+
+/**
+ * @brief The one alert main.c raises, followed by its restart
+ */
+static void node_publish_alert(node_t *n, int64_t now)
+{
+    char buf[FLEET_PAYLOAD_MAX_TEXT];
+    char topic[64];
+    snprintf(topic, sizeof(topic), "devices/%s/alerts", n->name);
+    size_t len = fleet_payload_alert(buf, "ERROR", "SYSTEM", "Critical low memory", utc_us());
+    node_submit(n, topic, NULL, buf, len, MQTT_CLASS_ALERT, 1, false, true, 0, now);
+    n->restart_us = now + (int64_t)RESTART_DELAY_MS * 1000;
+}
+
+static void node_capture_csi(node_t *n, int64_t now)
+{
+    worker_t *w = n->worker;
+
+    channel_model_step(&n->channel, (float)s_period_us / 1e6f);
+    n->rssi = channel_model_sample(&n->channel, w->raw);
+
+    fleet_csi_t csi = {
+        .sequence = n->sequence++,
+        .timestamp = (uint64_t)(now - n->boot_us),
+        .rssi = n->rssi,
+        .channel = n->wifi_channel,
+        .raw = w->raw,
+        .raw_len = sizeof(w->raw),
+    };
+    memcpy(csi.mac, n->ap_mac, sizeof(csi.mac));
+
+    if (s_cfg.binary) {
+        size_t len = fleet_payload_csi_frame((uint8_t *)w->json, &csi);
+        node_submit(n, n->csi_topic, CSI_FRAME_CONTENT_TYPE, w->json, len, MQTT_CLASS_CSI,
+                    s_cfg.qos, false, false, CSI_MESSAGE_EXPIRY_S, now);
+    } else {
+        size_t len = fleet_payload_csi_json(w->json, &csi);
+        node_submit(n, n->csi_topic, NULL, w->json, len, MQTT_CLASS_CSI,
+                    s_cfg.qos, false, true, CSI_MESSAGE_EXPIRY_S, now);
+    }
+}
+
+static void node_start_connect(node_t *n, int64_t now)
+{
+    worker_t *w = n->worker;
+
+    n->state = NODE_CONNECTING;
+    n->fd = socket(s_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (n->fd < 0) {
+        fprintf(stderr, "%s: socket: %s\n", n->name, strerror(errno));
+        node_disconnect(n, now, 0);
+        return;
+    }
+    int one = 1;
+    setsockopt(n->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(n->fd, (struct sockaddr *)&s_addr, s_addr_len) < 0 && errno != EINPROGRESS) {
+        node_disconnect(n, now, 0);
+        return;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = n };
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, n->fd, &ev) < 0) {
+        node_disconnect(n, now, 0);
+        return;
+    }
+    n->want_out = true;
+    n->deadline_us = now + (int64_t)CONNECT_TIMEOUT_MS * 1000;
+}
+
+/**
+ * @brief Drop the connection and wait out the backoff, like the reconnect task
+ */
+static void node_disconnect(node_t *n, int64_t now, uint32_t hint_ms)
+{
+    worker_t *w = n->worker;
+
+    if (n->fd >= 0) {
+        close(n->fd);
+        n->fd = -1;
+    }
+    if (n->state == NODE_CONNECTED) {
+        STAT_ADD(w, disconnects, 1);
+        atomic_fetch_sub_explicit(&w->stats.connected, 1, memory_order_relaxed);
+        // Only a connection that held for a while earns a fresh backoff sequence
+        if (now - n->connected_us >= (int64_t)MQTT_BACKOFF_STABLE_MS * 1000) {
+            mqtt_backoff_reset(&n->backoff);
+        }
+    } else if (n->state != NODE_BOOTING && n->state != NODE_BACKOFF) {
+        STAT_ADD(w, connect_failures, 1);
+    }
+
+    // Clean start: whatever was unacknowledged or unsent is gone
+    n->tx_len = n->tx_off = 0;
+    n->rx_len = 0;
+    memset(n->inflight, 0, sizeof(n->inflight));
+    n->inflight_count = 0;
+    n->inflight_bytes = 0;
+    n->want_out = false;
+
+    if (hint_ms) {
+        mqtt_backoff_set_hint(&n->backoff, hint_ms);
+    }
+    n->state = NODE_BACKOFF;
+    n->next_connect_us = now + (int64_t)mqtt_backoff_next(&n->backoff) * 1000;
+}
+
+/**
+ * @brief esp_restart(): the connection drops without a DISCONNECT and the node boots again
+ */
+static void node_restart(node_t *n, int64_t now)
+{
+    worker_t *w = n->worker;
+
+    node_disconnect(n, now, 0);
+    mqtt_outbox_clear(&n->outbox);
+    mqtt_outbox_init(&n->outbox, s_outbox_classes);
+    mqtt_outbox_set_drop_callback(&n->outbox, node_on_drop, n);
+    mqtt_backoff_reset(&n->backoff);
+
+    n->state = NODE_BOOTING;
+    n->restart_us = 0;
+    n->boot_us = now;
+    n->sequence = 0;
+    n->next_csi_us = now + (int64_t)(worker_uniform(w) * s_period_us);
+    n->next_connect_us = now + (BOOT_MIN_MS + worker_random(w) % (BOOT_MAX_MS - BOOT_MIN_MS)) * 1000LL;
+    n->free_heap = 180000 + worker_random(w) % 40000;
+    n->min_free_heap = n->free_heap;
+    STAT_ADD(w, restarts, 1);
+}
+
+static void node_schedule_alert(node_t *n, int64_t now)
+{
+    if (s_cfg.alert_s <= 0) {
+        n->next_alert_us = INT64_MAX;
+        return;
+    }
+    // Poisson arrivals per node
+    double u = worker_uniform(n->worker);
+    n->next_alert_us = now + seconds_us(-log(1.0 - u) * s_cfg.alert_s);
+}
+
+static void node_on_connack(node_t *n, const uint8_t *body, size_t len, int64_t now)
+{
+    worker_t *w = n->worker;
+    mqtt5_connack_t ack;
+
+    if (!mqtt5_parse_connack(body, len, &ack)) {
+        node_disconnect(n, now, 0);
+        return;
+    }
+    if (ack.reason != 0) {
+        node_disconnect(n, now, mqtt_backoff_hint_for_reason(ack.reason, true));
+        return;
+    }
+
+    n->state = NODE_CONNECTED;
+    n->connected_us = now;
+    n->receive_max = ack.receive_max ? ack.receive_max : 65535;
+    n->keepalive = ack.server_keepalive ? ack.server_keepalive : s_cfg.keepalive;
+    n->alias_enabled = ack.topic_alias_max >= 1;
+    n->alias_sent = false;
+    n->ping_outstanding = false;
+    n->next_ping_us = n->keepalive ? now + (int64_t)n->keepalive * 1000000 : INT64_MAX;
+    STAT_ADD(w, connects, 1);
+    atomic_fetch_add_explicit(&w->stats.connected, 1, memory_order_relaxed);
+
+    // Frames the collector numbered while the link was down never reach the broker
+    if (n->next_csi_us <= now) {
+        int64_t missed = (now - n->next_csi_us) / s_period_us + 1;
+        n->sequence += (uint32_t)missed;
+        n->next_csi_us += missed * s_period_us;
+        STAT_ADD(w, offline, (unsigned long long)missed);
+    }
+    if (n->next_metrics_us == 0) {
+        n->next_metrics_us = now + seconds_us(worker_uniform(w) * s_cfg.metrics_s);
+    }
+    if (n->next_alert_us == 0) {
+        node_schedule_alert(n, now);
+    }
+
+    // main.c subscribes to the device topics, then announces itself
+    static const char *const suffixes[] = {"config", "command", "ota"};
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]) + 1; i++) {
+        char topic[64];
+        int qos = 1;
+        if (i < sizeof(suffixes) / sizeof(suffixes[0])) {
+            snprintf(topic, sizeof(topic), "devices/%s/%s", n->name, suffixes[i]);
+        } else {
+            snprintf(topic, sizeof(topic), "broadcast/command");
+            qos = 0;
+        }
+        uint8_t *p = node_tx_reserve(n, mqtt5_subscribe_size(topic));
+        if (p) {
+            mqtt5_encode_subscribe(p, node_packet_id(n), topic, qos);
+        }
+    }
+    node_publish_status(n, now);
+}
+
+static void node_on_puback(node_t *n, uint16_t packet_id)
+{
+    for (int i = 0; i < INFLIGHT_SLOTS; i++) {
+        if (n->inflight[i].packet_id == packet_id) {
+            n->inflight_count--;
+            n->inflight_bytes -= n->inflight[i].size;
+            n->inflight[i].packet_id = 0;
+            STAT_ADD(n->worker, acks, 1);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Act on every complete packet in the receive buffer
+ * @return false if the connection was dropped
+ */
+static bool node_process_rx(node_t *n, int64_t now)
+{
+    size_t off = 0;
+    bool ok = true;
+
+    while (ok) {
+        uint8_t type;
+        size_t header, total;
+        int r = mqtt5_next_packet(n->rx + off, n->rx_len - off, &type, &header, &total);
+        if (r == 0) {
+            break;
+        }
+        if (r < 0) {
+            node_disconnect(n, now, 0);
+            return false;
+        }
+
+        const uint8_t *body = n->rx + off + header;
+        size_t body_len = total - header;
+        off += total;
+
+        switch (type & 0xF0) {
+        case MQTT5_CONNACK:
+            if (n->state == NODE_WAIT_CONNACK) {
+                node_on_connack(n, body, body_len, now);
+                ok = n->state == NODE_CONNECTED;
+            }
+            break;
+        case MQTT5_PUBACK:
+            node_on_puback(n, mqtt5_ack_packet_id(body, body_len));
+            break;
+        case MQTT5_PINGRESP:
+            n->ping_outstanding = false;
+            break;
+        case MQTT5_PUBLISH: {
+            mqtt5_incoming_t in;
+            if (mqtt5_parse_publish(type, body, body_len, &in)) {
+                STAT_ADD(n->worker, received, 1);
+                if (in.qos == 1) {
+                    uint8_t *p = node_tx_reserve(n, 4);
+                    if (p) {
+                        mqtt5_encode_puback(p, in.packet_id);
+                    }
+                }
+            }
+            break;
+        }
+        case MQTT5_DISCONNECT: {
+            uint8_t reason = mqtt5_disconnect_reason(body, body_len);
+            node_disconnect(n, now, mqtt_backoff_hint_for_reason(reason, true));
+            return false;
+        }
+        default:
+            break;              // SUBACK and anything else needs no action
+        }
+    }
+
+    if (!ok) {
+        return false;
+    }
+    memmove(n->rx, n->rx + off, n->rx_len - off);
+    n->rx_len -= off;
+    return true;
+}
+
+static void node_on_readable(node_t *n, int64_t now)
+{
+    for (;;) {
+        if (n->rx_cap - n->rx_len < 2048) {
+            size_t cap = n->rx_cap ? n->rx_cap * 2 : 4096;
+            uint8_t *rx = cap <= RX_MAX ? realloc(n->rx, cap) : NULL;
+            if (!rx) {
+                node_disconnect(n, now, 0);
+                return;
+            }
+            n->rx = rx;
+            n->rx_cap = cap;
+        }
+
+        ssize_t r = recv(n->fd, n->rx + n->rx_len, n->rx_cap - n->rx_len, 0);
+        if (r > 0) {
+            n->rx_len += r;
+            if (!node_process_rx(n, now)) {
+                return;
+            }
+            continue;
+        }
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        node_disconnect(n, now, 0);
+        return;
+    }
+}
+
+static void node_on_event(node_t *n, uint32_t events, int64_t now)
+{
+    if (n->state == NODE_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if ((events & (EPOLLERR | EPOLLHUP)) ||
+            getsockopt(n->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            node_disconnect(n, now, 0);
+            return;
+        }
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+        const char *client_id = n->name;
+        uint8_t *p = node_tx_reserve(n, mqtt5_connect_size(client_id));
+        if (!p) {
+            node_disconnect(n, now, 0);
+            return;
+        }
+        mqtt5_encode_connect(p, client_id, s_cfg.keepalive);
+        n->state = NODE_WAIT_CONNACK;
+        node_flush(n, now);
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        node_on_readable(n, now);
+        if (n->fd < 0) {
+            return;
+        }
+    }
+    node_drain(n, now);
+    node_flush(n, now);
+}
+
+/**
+ * @brief Run whatever timers of the node are due
+ */
+static void node_service(node_t *n, int64_t now)
+{
+    worker_t *w = n->worker;
+
+    switch (n->state) {
+    case NODE_BOOTING:
+    case NODE_BACKOFF:
+        if (now >= n->next_connect_us) {
+            node_start_connect(n, now);
+        }
+        return;
+    case NODE_CONNECTING:
+    case NODE_WAIT_CONNACK:
+        if (now >= n->deadline_us) {
+            node_disconnect(n, now, 0);
+        }
+        return;
+    case NODE_CONNECTED:
+        break;
+    }
+
+    if (n->restart_us && now >= n->restart_us) {
+        node_restart(n, now);
+        return;
+    }
+
+    if (now >= n->next_ping_us) {
+        if (n->ping_outstanding) {
+            node_disconnect(n, now, 0);
+            return;
+        }
+        uint8_t *p = node_tx_reserve(n, 2);
+        if (p) {
+            mqtt5_encode_pingreq(p);
+        }
+        n->ping_outstanding = true;
+        n->next_ping_us = now + (int64_t)n->keepalive * 1000000;
+    }
+
+    if (now >= n->next_csi_us) {
+        if (now - n->next_csi_us > MAX_LAG_US) {
+            int64_t behind = (now - n->next_csi_us) / s_period_us;
+            n->sequence += (uint32_t)behind;
+            n->next_csi_us += behind * s_period_us;
+            STAT_ADD(w, late, (unsigned long long)behind);
+        }
+        node_capture_csi(n, now);
+        n->next_csi_us += s_period_us;
+    }
+
+    if (now >= n->next_metrics_us) {
+        node_publish_metrics(n, now);
+        n->next_metrics_us = now + seconds_us(s_cfg.metrics_s);
+    }
+
+    if (now >= n->next_alert_us) {
+        if (!n->restart_us) {
+            node_publish_alert(n, now);
+        }
+        node_schedule_alert(n, now);
+    }
+
+    node_drain(n, now);
+    node_flush(n, now);
+}
+
+static void worker_shutdown(worker_t *w)
+{
+    for (int i = 0; i < w->count; i++) {
+        node_t *n = &w->nodes[i];
+        // A DISCONNECT behind a partly written packet would corrupt the stream
+        if (n->state == NODE_CONNECTED && n->tx_off == n->tx_len) {
+            uint8_t bye[2];
+            size_t len = mqtt5_encode_disconnect(bye);
+            if (send(n->fd, bye, len, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+                // The broker treats it as an unexpected disconnect
+            }
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!atomic_load(&s_stop)) {
+        int64_t now = now_us();
+        while (w->heap.len > 0 && w->heap.items[0].t <= now) {
+            event_t ev = heap_pop(&w->heap);
+            node_t *n = ev.node;
+            if (ev.t != n->wake_us) {
+                continue;       // superseded
+            }
+            n->wake_us = -1;
+            node_service(n, now);
+            node_reschedule(w, n);
+        }
+
+        int timeout_ms = 100;
+        if (w->heap.len > 0) {
+            int64_t wait = (w->heap.items[0].t - now_us() + 999) / 1000;
+            if (wait < timeout_ms) {
+                timeout_ms = wait > 0 ? (int)wait : 0;
+            }
+        }
+
+        int count = epoll_wait(w->epfd, events, MAX_EVENTS, timeout_ms);
+        now = now_us();
+        for (int i = 0; i < count; i++) {
+            node_t *n = events[i].data.ptr;
+            if (n->fd < 0) {
+                continue;
+            }
+            node_on_event(n, events[i].events, now);
+            node_reschedule(w, n);
+        }
+    }
+
+    worker_shutdown(w);
+    return NULL;
+}
+
+static void collect(worker_t *workers, int count, fleet_totals_t *t)
+{
+    memset(t, 0, sizeof(*t));
+    for (int i = 0; i < count; i++) {
+        fleet_stats_t *s = &workers[i].stats;
+        t->connected += atomic_load_explicit(&s->connected, memory_order_relaxed);
+        t->connects += atomic_load_explicit(&s->connects, memory_order_relaxed);
+        t->connect_failures += atomic_load_explicit(&s->connect_failures, memory_order_relaxed);
+        t->disconnects += atomic_load_explicit(&s->disconnects, memory_order_relaxed);
+        t->restarts += atomic_load_explicit(&s->restarts, memory_order_relaxed);
+        for (int c = 0; c < MQTT_OUTBOX_CLASSES; c++) {
+            t->sent[c] += atomic_load_explicit(&s->sent[c], memory_order_relaxed);
+        }
+        t->bytes += atomic_load_explicit(&s->bytes, memory_order_relaxed);
+        t->acks += atomic_load_explicit(&s->acks, memory_order_relaxed);
+        t->received += atomic_load_explicit(&s->received, memory_order_relaxed);
+        t->dropped += atomic_load_explicit(&s->dropped, memory_order_relaxed);
+        t->expired += atomic_load_explicit(&s->expired, memory_order_relaxed);
+        t->offline += atomic_load_explicit(&s->offline, memory_order_relaxed);
+        t->late += atomic_load_explicit(&s->late, memory_order_relaxed);
+    }
+}
+
+static void report_line(double elapsed, const fleet_totals_t *cur, const fleet_totals_t *prev, double dt)
+{
+    if (dt <= 0) {
+        return;
+    }
+    printf("%7.1f s  up %5lld/%d  csi %8.0f/s  status %4.0f/s  metrics %4.0f/s  alerts %3.0f/s  "
+           "%7.2f MB/s  acks %6.0f/s  drop %llu exp %llu late %llu\n",
+           elapsed, (long long)cur->connected, s_cfg.nodes,
+           (cur->sent[MQTT_CLASS_CSI] - prev->sent[MQTT_CLASS_CSI]) / dt,
+           (cur->sent[MQTT_CLASS_STATUS] - prev->sent[MQTT_CLASS_STATUS]) / dt,
+           (cur->sent[MQTT_CLASS_TELEMETRY] - prev->sent[MQTT_CLASS_TELEMETRY]) / dt,
+           (cur->sent[MQTT_CLASS_ALERT] - prev->sent[MQTT_CLASS_ALERT]) / dt,
+           (cur->bytes - prev->bytes) / dt / 1e6,
+           (cur->acks - prev->acks) / dt,
+           (unsigned long long)cur->dropped, (unsigned long long)cur->expired,
+           (unsigned long long)cur->late);
+    fflush(stdout);
+}
+
+static void report_summary(const fleet_totals_t *t, double elapsed)
+{
+    printf("\nnodes=%d threads=%d csi=%.1f Hz %s qos=%d broker=%s:%s\n",
+           s_cfg.nodes, s_cfg.threads, s_cfg.csi_rate, s_cfg.binary ? "binary" : "json",
+           s_cfg.qos, s_cfg.host, s_cfg.port);
+    printf("  duration          %.1f s\n", elapsed);
+    printf("  connections       %llu, failed attempts %llu, dropped %llu, restarts %llu\n",
+           (unsigned long long)t->connects, (unsigned long long)t->connect_failures,
+           (unsigned long long)t->disconnects, (unsigned long long)t->restarts);
+    printf("  published         csi %llu, status %llu, metrics %llu, alerts %llu\n",
+           (unsigned long long)t->sent[MQTT_CLASS_CSI], (unsigned long long)t->sent[MQTT_CLASS_STATUS],
+           (unsigned long long)t->sent[MQTT_CLASS_TELEMETRY], (unsigned long long)t->sent[MQTT_CLASS_ALERT]);
+    printf("  throughput        %.0f msg/s, %.2f MB/s\n",
+           (t->sent[MQTT_CLASS_CSI] + t->sent[MQTT_CLASS_STATUS] + t->sent[MQTT_CLASS_TELEMETRY] +
+            t->sent[MQTT_CLASS_ALERT]) / elapsed, t->bytes / elapsed / 1e6);
+    printf("  acks / received   %llu / %llu\n", (unsigned long long)t->acks, (unsigned long long)t->received);
+    printf("  csi not sent      outbox full %llu, expired %llu, offline %llu, generator late %llu\n",
+           (unsigned long long)t->dropped, (unsigned long long)t->expired,
+           (unsigned long long)t->offline, (unsigned long long)t->late);
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    atomic_store(&s_stop, true);
+}
+
+static int resolve_broker(void)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    int err = getaddrinfo(s_cfg.host, s_cfg.port, &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "Cannot resolve %s: %s\n", s_cfg.host, gai_strerror(err));
+        return -1;
+    }
+    memcpy(&s_addr, res->ai_addr, res->ai_addrlen);
+    s_addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/**
+ * @brief Every node needs a descriptor; take as many as the hard limit allows
+ */
+static void raise_fd_limit(void)
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+        return;
+    }
+    rlim_t want = (rlim_t)s_cfg.nodes + 64;
+    if (rl.rlim_cur < want) {
+        rl.rlim_cur = want < rl.rlim_max ? want : rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur < want) {
+        fprintf(stderr, "Warning: descriptor limit %llu is below %d nodes, raise it with ulimit -n\n",
+                (unsigned long long)rl.rlim_cur, s_cfg.nodes);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --broker HOST[:PORT]     MQTT broker (default 127.0.0.1:1883)\n"
+            "  --nodes N                virtual nodes (default %d)\n"
+            "  --threads N              event loops (default 1)\n"
+            "  --prefix NAME            node names are NAME-00000... (default fleet)\n"
+            "  --csi-rate HZ            CSI reports per node and second (default %d)\n"
+            "  --binary                 publish csi_frame instead of csi_data JSON\n"
+            "  --qos 0|1                QoS of CSI messages (default 0)\n"
+            "  --people N               up to N people per room (default %d, max %d)\n"
+            "  --metrics-interval S     metrics period (default %d)\n"
+            "  --alert-interval S       mean time between low memory restarts per node,\n"
+            "                           0 to disable (default %d)\n"
+            "  --connect-rate N         initial connects per second (default %d)\n"
+            "  --keepalive S            MQTT keepalive (default %d)\n"
+            "  --duration S             stop after S seconds (default: run until Ctrl-C)\n"
+            "  --seed N                 random seed\n",
+            prog, DEFAULT_NODES, DEFAULT_CSI_RATE, DEFAULT_PEOPLE, CHANNEL_MAX_PEOPLE,
+            DEFAULT_METRICS_S, DEFAULT_ALERT_S, DEFAULT_CONNECT_RATE, DEFAULT_KEEPALIVE);
+}
+
+int main(int argc, char **argv)
+{
+    s_cfg = (fleet_config_t){
+        .host = "127.0.0.1",
+        .port = "1883",
+        .prefix = "fleet",
+        .nodes = DEFAULT_NODES,
+        .threads = 1,
+        .csi_rate = DEFAULT_CSI_RATE,
+        .people = DEFAULT_PEOPLE,
+        .metrics_s = DEFAULT_METRICS_S,
+        .alert_s = DEFAULT_ALERT_S,
+        .connect_rate = DEFAULT_CONNECT_RATE,
+        .keepalive = DEFAULT_KEEPALIVE,
+        .seed = 1,
+    };
+    static char broker[256];
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--broker") == 0 && val) {
+            snprintf(broker, sizeof(broker), "%s", val);
+            char *colon = strrchr(broker, ':');
+            if (colon) {
+                *colon = '\0';
+                s_cfg.port = colon + 1;
+            }
+            s_cfg.host = broker;
+            i++;
+        } else if (strcmp(arg, "--nodes") == 0 && val) {
+            s_cfg.nodes = atoi(val);
+            i++;
+        } else if (strcmp(arg, "--threads") == 0 && val) {
+            s_cfg.threads = atoi(val);
+            i++;
+        } else if (strcmp(arg, "--prefix") == 0 && val) {
+            s_cfg.prefix = val;
+            i++;
+        } else if (strcmp(arg, "--csi-rate") == 0 && val) {
+            s_cfg.csi_rate = atof(val);
+            i++;
+        } else if (strcmp(arg, "--binary") == 0) {
+            s_cfg.binary = true;
+        } else if (strcmp(arg, "--qos") == 0 && val) {
+            s_cfg.qos = atoi(val);
+            i++;
+        } else if (strcmp(arg, "--people") == 0 && val) {
+            s_cfg.people = atoi(val);
+            i++;
+        } else if (strcmp(arg, "--metrics-interval") == 0 && val) {
+            s_cfg.metrics_s = atof(val);
+            i++;
+        } else if (strcmp(arg, "--alert-interval") == 0 && val) {
+            s_cfg.alert_s = atof(val);
+            i++;
+        } else if (strcmp(arg, "--connect-rate") == 0 && val) {
+            s_cfg.connect_rate = atof(val);
+            i++;
+        } else if (strcmp(arg, "--keepalive") == 0 && val) {
+            s_cfg.keepalive = (uint16_t)atoi(val);
+            i++;
+        } else if (strcmp(arg, "--duration") == 0 && val) {
+            s_cfg.duration_s = atof(val);
+            i++;
+        } else if (strcmp(arg, "--seed") == 0 && val) {
+            s_cfg.seed = (uint32_t)strtoul(val, NULL, 0);
+            i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (s_cfg.nodes <= 0 || s_cfg.threads <= 0 || s_cfg.csi_rate <= 0 || s_cfg.csi_rate > 1000 ||
+        (s_cfg.qos != 0 && s_cfg.qos != 1) || s_cfg.people < 0 || s_cfg.people > CHANNEL_MAX_PEOPLE ||
+        s_cfg.metrics_s <= 0 || s_cfg.alert_s < 0 || s_cfg.connect_rate <= 0 || strlen(s_cfg.prefix) > 20) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (s_cfg.threads > s_cfg.nodes) {
+        s_cfg.threads = s_cfg.nodes;
+    }
+
+    if (resolve_broker() != 0) {
+        return 1;
+    }
+    raise_fd_limit();
+    fleet_payload_init();
+
+    s_period_us = (int64_t)(1000000.0 / s_cfg.csi_rate);
+    s_qos1_classes = (1u << MQTT_CLASS_CONTROL) | (1u << MQTT_CLASS_ALERT) | (1u << MQTT_CLASS_STATUS);
+    if (s_cfg.qos > 0) {
+        s_qos1_classes |= 1u << MQTT_CLASS_CSI;
+    }
+
+    worker_t *workers = calloc(s_cfg.threads, sizeof(worker_t));
+    if (!workers) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    // Nodes are dealt round robin so the connect ramp is spread over all loops
+    int64_t start = now_us();
+    for (int t = 0; t < s_cfg.threads; t++) {
+        worker_t *w = &workers[t];
+        w->id = t;
+        w->rng = s_cfg.seed * 747796405u + (uint32_t)t * 2891336453u + 1;
+        w->count = s_cfg.nodes / s_cfg.threads + (t < s_cfg.nodes % s_cfg.threads ? 1 : 0);
+        w->nodes = calloc(w->count, sizeof(node_t));
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (!w->nodes || w->epfd < 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        for (int i = 0; i < w->count; i++) {
+            int index = i * s_cfg.threads + t;
+            node_t *n = &w->nodes[i];
+            node_init(w, n, index);
+
+            // Booted some time ago; capture runs from boot, the first connect follows the ramp
+            n->boot_us = start - seconds_us(worker_uniform(w) * 86400.0);
+            n->state = NODE_BOOTING;
+            n->next_connect_us = start + seconds_us(index / s_cfg.connect_rate);
+            n->next_csi_us = n->next_connect_us + (int64_t)(worker_uniform(w) * s_period_us);
+            node_reschedule(w, n);
+        }
+    }
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("csi_fleet_gen: %d nodes on %d threads -> %s:%s, CSI %.1f Hz %s\n",
+           s_cfg.nodes, s_cfg.threads, s_cfg.host, s_cfg.port, s_cfg.csi_rate,
+           s_cfg.binary ? "binary" : "json");
+    fflush(stdout);
+
+    for (int t = 0; t < s_cfg.threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]) != 0) {
+            fprintf(stderr, "Failed to start worker thread\n");
+            atomic_store(&s_stop, true);
+            s_cfg.threads = t;
+            break;
+        }
+    }
+
+    fleet_totals_t prev = {0}, cur;
+    int64_t last = start;
+    while (!atomic_load(&s_stop)) {
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 100 * 1000000L };
+        nanosleep(&ts, NULL);
+        int64_t now = now_us();
+        if (s_cfg.duration_s > 0 && now - start >= seconds_us(s_cfg.duration_s)) {
+            atomic_store(&s_stop, true);
+        }
+        if (now - last >= 1000000 || atomic_load(&s_stop)) {
+            collect(workers, s_cfg.threads, &cur);
+            report_line((now - start) / 1e6, &cur, &prev, (now - last) / 1e6);
+            prev = cur;
+            last = now;
+        }
+    }
+
+    for (int t = 0; t < s_cfg.threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+
+    collect(workers, s_cfg.threads, &cur);
+    report_summary(&cur, (now_us() - start) / 1e6);
+
+    for (int t = 0; t < s_cfg.threads; t++) {
+        for (int i = 0; i < workers[t].count; i++) {
+            node_free(&workers[t].nodes[i]);
+        }
+        free(workers[t].nodes);
+        free(workers[t].heap.items);
+        close(workers[t].epfd);
+    }
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * @file fleet_payload.c
+ * @brief Byte-exact encoders for the payloads a node publishes
+ */
+
+#include "fleet_payload.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csi_frame.h"
+#include "csi_features.h"
+
+#define AMPLITUDE_ENTRIES       (2 * 128 * 128 + 1)     // every real^2 + imag^2 of int8 pairs
+#define PHASE_ENTRIES           (256 * 256)
+#define NUMBER_MAX              32
+
+/**
+ * @brief Printed numbers, one arena per table
+ */
+typedef struct {
+    char *text;
+    uint32_t *offset;
+    uint8_t *len;
+} number_table_t;
+
+static number_table_t s_amplitude;
+static number_table_t s_phase;
+
+typedef struct {
+    char *p;
+    char *end;
+} writer_t;
+
+static void put(writer_t *w, const char *s, size_t len)
+{
+    if (len > (size_t)(w->end - w->p)) {
+        len = w->end - w->p;
+    }
+    memcpy(w->p, s, len);
+    w->p += len;
+}
+
+static void put_char(writer_t *w, char c)
+{
+    if (w->p < w->end) {
+        *w->p++ = c;
+    }
+}
+
+/**
+ * @brief Print a number the way cJSON's print_number() does
+ */
+static int print_number(char *out, double d)
+{
+    int valueint = d >= INT_MAX ? INT_MAX : d <= (double)INT_MIN ? INT_MIN : (int)d;
+
+    if (isnan(d) || isinf(d)) {
+        return sprintf(out, "null");
+    }
+    if (d == (double)valueint) {
+        return sprintf(out, "%d", valueint);
+    }
+
+    int len = sprintf(out, "%1.15g", d);
+    double test = strtod(out, NULL);
+    double max = fabs(test) > fabs(d) ? fabs(test) : fabs(d);
+    if (!(fabs(test - d) <= max * DBL_EPSILON)) {
+        len = sprintf(out, "%1.17g", d);
+    }
+    return len;
+}
+
+static void put_number(writer_t *w, double d)
+{
+    char buf[NUMBER_MAX];
+    put(w, buf, print_number(buf, d));
+}
+
+static void put_string(writer_t *w, const char *s)
+{
+    put_char(w, '"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+        case '"':  put(w, "\\\"", 2); break;
+        case '\\': put(w, "\\\\", 2); break;
+        case '\b': put(w, "\\b", 2); break;
+        case '\f': put(w, "\\f", 2); break;
+        case '\n': put(w, "\\n", 2); break;
+        case '\r': put(w, "\\r", 2); break;
+        case '\t': put(w, "\\t", 2); break;
+        default:
+            if (c < 32) {
+                char esc[8];
+                put(w, esc, sprintf(esc, "\\u%04x", c));
+            } else {
+                put_char(w, (char)c);
+            }
+        }
+    }
+    put_char(w, '"');
+}
+
+/**
+ * @brief Key of a cJSON_Print()ed object member at depth 1
+ */
+static void put_key(writer_t *w, const char *key, bool first)
+{
+    if (!first) {
+        put(w, ",\n", 2);
+    }
+    put_char(w, '\t');
+    put_string(w, key);
+    put(w, ":\t", 2);
+}
+
+static void table_build(number_table_t *t, size_t entries, float (*value)(size_t))
+{
+    t->text = malloc(entries * NUMBER_MAX);
+    t->offset = malloc(entries * sizeof(uint32_t));
+    t->len = malloc(entries);
+    if (!t->text || !t->offset || !t->len) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    uint32_t pos = 0;
+    for (size_t i = 0; i < entries; i++) {
+        int len = print_number(t->text + pos, value(i));
+        t->offset[i] = pos;
+        t->len[i] = (uint8_t)len;
+        pos += len;
+    }
+}
+
+static float amplitude_of(size_t r2)
+{
+    // The collector squares and adds in int, then takes sqrtf
+    return sqrtf((float)(int)r2);
+}
+
+static float phase_of(size_t index)
+{
+    const int8_t iq[2] = {(int8_t)(index >> 8), (int8_t)(index & 0xFF)};
+    float phase;
+    csi_features_amplitude_phase(iq, 1, NULL, &phase);
+    return phase;
+}
+
+void fleet_payload_init(void)
+{
+    table_build(&s_amplitude, AMPLITUDE_ENTRIES, amplitude_of);
+    table_build(&s_phase, PHASE_ENTRIES, phase_of);
+}
+
+static void put_table(writer_t *w, const number_table_t *t, size_t index)
+{
+    put(w, t->text + t->offset[index], t->len[index]);
+}
+
+size_t fleet_payload_status(char *buf, const char *device_id, const char *version,
+                            uint32_t uptime, int8_t wifi_rssi, uint32_t free_heap, uint64_t timestamp)
+{
+    writer_t w = { buf, buf + FLEET_PAYLOAD_MAX_TEXT };
+    put(&w, "{\n", 2);
+    put_key(&w, "device_id", true);
+    put_string(&w, device_id);
+    put_key(&w, "version", false);
+    put_string(&w, version);
+    put_key(&w, "uptime", false);
+    put_number(&w, uptime);
+    put_key(&w, "wifi_rssi", false);
+    put_number(&w, wifi_rssi);
+    put_key(&w, "free_heap", false);
+    put_number(&w, free_heap);
+    put_key(&w, "timestamp", false);
+    put_number(&w, (double)timestamp);
+    put(&w, "\n}", 2);
+    return w.p - buf;
+}
+
+size_t fleet_payload_metrics(char *buf, float cpu_usage, uint32_t free_heap, uint32_t min_free_heap,
+                             uint32_t task_count, uint64_t timestamp)
+{
+    writer_t w = { buf, buf + FLEET_PAYLOAD_MAX_TEXT };
+    put(&w, "{\n", 2);
+    put_key(&w, "cpu_usage", true);
+    put_number(&w, cpu_usage);
+    put_key(&w, "free_heap", false);
+    put_number(&w, free_heap);
+    put_key(&w, "min_free_heap", false);
+    put_number(&w, min_free_heap);
+    put_key(&w, "task_count", false);
+    put_number(&w, task_count);
+    put_key(&w, "timestamp", false);
+    put_number(&w, (double)timestamp);
+    put(&w, "\n}", 2);
+    return w.p - buf;
+}
+
+size_t fleet_payload_alert(char *buf, const char *level, const char *component, const char *message,
+                           uint64_t timestamp)
+{
+    writer_t w = { buf, buf + FLEET_PAYLOAD_MAX_TEXT };
+    put(&w, "{\n", 2);
+    put_key(&w, "level", true);
+    put_string(&w, level);
+    put_key(&w, "component", false);
+    put_string(&w, component);
+    put_key(&w, "message", false);
+    put_string(&w, message);
+    put_key(&w, "timestamp", false);
+    put_number(&w, (double)timestamp);
+    put(&w, "\n}", 2);
+    return w.p - buf;
+}
+
+size_t fleet_payload_csi_json(char *buf, const fleet_csi_t *csi)
+{
+    writer_t w = { buf, buf + FLEET_PAYLOAD_MAX_CSI_JSON };
+    int count = csi->raw_len / 2;
+    if (count > CSI_MAX_SUBCARRIERS) {
+        count = CSI_MAX_SUBCARRIERS;
+    }
+
+    char mac[18];
+    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+             csi->mac[0], csi->mac[1], csi->mac[2], csi->mac[3], csi->mac[4], csi->mac[5]);
+
+    put(&w, "{\"seq\":", 7);
+    put_number(&w, csi->sequence);
+    put(&w, ",\"timestamp\":", 13);
+    put_number(&w, (double)csi->timestamp);
+    put(&w, ",\"mac\":", 7);
+    put_string(&w, mac);
+    put(&w, ",\"rssi\":", 8);
+    put_number(&w, csi->rssi);
+    put(&w, ",\"channel\":", 11);
+    put_number(&w, csi->channel);
+    put(&w, ",\"secondary_channel\":", 21);
+    put_number(&w, csi->secondary_channel);
+    put(&w, ",\"subcarrier_count\":", 20);
+    put_number(&w, count);
+
+    if (count > 0) {
+        put(&w, ",\"amplitude\":[", 14);
+        for (int i = 0; i < count; i++) {
+            int real = csi->raw[i * 2];
+            int imag = csi->raw[i * 2 + 1];
+            if (i > 0) {
+                put_char(&w, ',');
+            }
+            put_table(&w, &s_amplitude, (size_t)(real * real + imag * imag));
+        }
+        put(&w, "],\"phase\":[", 11);
+        for (int i = 0; i < count; i++) {
+            uint8_t real = (uint8_t)csi->raw[i * 2];
+            uint8_t imag = (uint8_t)csi->raw[i * 2 + 1];
+            if (i > 0) {
+                put_char(&w, ',');
+            }
+            put_table(&w, &s_phase, ((size_t)real << 8) | imag);
+        }
+        put_char(&w, ']');
+    }
+    put_char(&w, '}');
+    return w.p - buf;
+}
+
+size_t fleet_payload_csi_frame(uint8_t *buf, const fleet_csi_t *csi)
+{
+    int count = csi->raw_len / 2;
+    csi_frame_header_t header = {
+        .magic = CSI_FRAME_MAGIC,
+        .version = CSI_FRAME_VERSION,
+        .flags = csi->raw_len ? CSI_FRAME_FLAG_RAW : 0,
+        .sequence = csi->sequence,
+        .timestamp = csi->timestamp,
+        .rssi = csi->rssi,
+        .channel = csi->channel,
+        .secondary_channel = csi->secondary_channel,
+        .subcarrier_count = (uint8_t)(count > CSI_MAX_SUBCARRIERS ? CSI_MAX_SUBCARRIERS : count),
+        .raw_len = csi->raw_len,
+    };
+    memcpy(header.mac, csi->mac, sizeof(header.mac));
+
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), csi->raw, csi->raw_len);
+    return sizeof(header) + csi->raw_len;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file fleet_payload.h
+ * @brief Byte-exact encoders for the payloads a node publishes
+ *
+ * Status, metrics and alerts match mqtt_publisher.c (cJSON_Print, tab
+ * indented), csi_data matches csi_collector_data_to_json()
+ * (cJSON_PrintUnformatted) and csi_frame matches
+ * csi_collector_encode_frame(). Numbers are printed the way cJSON prints
+ * them, so a backend parser sees exactly what a real node would send.
+ */
+
+#ifndef FLEET_PAYLOAD_H
+#define FLEET_PAYLOAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "csi_frame.h"
+
+#define FLEET_PAYLOAD_MAX_TEXT      512     ///< Bound for status, metrics and alert JSON
+#define FLEET_PAYLOAD_MAX_CSI_JSON  8192    ///< Bound for csi_data JSON of 64 subcarriers
+#define FLEET_FRAME_HEADER_SIZE     sizeof(csi_frame_header_t)
+
+/**
+ * @brief One captured CSI report, as csi_data_t carries it
+ */
+typedef struct {
+    uint32_t sequence;
+    uint64_t timestamp;         ///< Microseconds since boot
+    uint8_t mac[6];             ///< Transmitter MAC
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t secondary_channel;
+    const int8_t *raw;          ///< Raw CSI in radio order, imaginary/real pairs
+    uint16_t raw_len;
+} fleet_csi_t;
+
+/**
+ * @brief Build the amplitude and phase text tables
+ *
+ * Raw CSI is int8, so every amplitude and phase the firmware can print is
+ * known up front. Call once before any other function, from one thread.
+ */
+void fleet_payload_init(void);
+
+/**
+ * @brief Encode the JSON of mqtt_publish_device_status() and friends
+ * @param buf At least FLEET_PAYLOAD_MAX_TEXT bytes; long strings are cut to fit
+ * @return Length, without a terminator
+ */
+size_t fleet_payload_status(char *buf, const char *device_id, const char *version,
+                            uint32_t uptime, int8_t wifi_rssi, uint32_t free_heap, uint64_t timestamp);
+
+size_t fleet_payload_metrics(char *buf, float cpu_usage, uint32_t free_heap, uint32_t min_free_heap,
+                             uint32_t task_count, uint64_t timestamp);
+
+size_t fleet_payload_alert(char *buf, const char *level, const char *component, const char *message,
+                           uint64_t timestamp);
+
+/**
+ * @brief Encode csi_data JSON
+ *
+ * Amplitude and phase are derived from the raw pairs exactly as the
+ * collector derives them, including its reading of buf[2i] as the real part.
+ *
+ * @param buf At least FLEET_PAYLOAD_MAX_CSI_JSON bytes
+ * @return Length, without a terminator
+ */
+size_t fleet_payload_csi_json(char *buf, const fleet_csi_t *csi);
+
+/**
+ * @brief Encode a csi_frame (header and raw CSI)
+ * @param buf At least FLEET_FRAME_HEADER_SIZE + raw_len bytes
+ * @return Length
+ */
+size_t fleet_payload_csi_frame(uint8_t *buf, const fleet_csi_t *csi);
+
+#endif // FLEET_PAYLOAD_H
@@ -0,0 +1,370 @@
+/**
+ * @file mqtt5_codec.c
+ * @brief Minimal MQTT v5 packet encoder and decoder for the fleet generator
+ */
+
+#include "mqtt5_codec.h"
+
+#include <string.h>
+
+#define PROP_PAYLOAD_FORMAT     0x01
+#define PROP_MESSAGE_EXPIRY     0x02
+#define PROP_CONTENT_TYPE       0x03
+#define PROP_RECEIVE_MAX        0x21
+#define PROP_TOPIC_ALIAS_MAX    0x22
+#define PROP_TOPIC_ALIAS        0x23
+#define PROP_SERVER_KEEPALIVE   0x13
+
+static size_t varint_size(uint32_t v)
+{
+    return v < 128 ? 1 : v < 16384 ? 2 : v < 2097152 ? 3 : 4;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        *p++ = v ? (b | 0x80) : b;
+    } while (v);
+    return p;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    *p++ = v >> 8;
+    *p++ = v & 0xFF;
+    return p;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p = put_u16(p, v >> 16);
+    return put_u16(p, v & 0xFFFF);
+}
+
+static uint8_t *put_string(uint8_t *p, const char *s, size_t len)
+{
+    p = put_u16(p, (uint16_t)len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint32_t *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+        if (*p >= end) {
+            return false;
+        }
+        uint8_t b = *(*p)++;
+        *v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Read one property, returning integer values and skipping the rest
+ */
+static bool get_property(const uint8_t **p, const uint8_t *end, uint8_t *id, uint32_t *value)
+{
+    if (*p >= end) {
+        return false;
+    }
+    *id = *(*p)++;
+    *value = 0;
+
+    size_t fixed = 0;
+    switch (*id) {
+    case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+        fixed = 1;
+        break;
+    case 0x13: case 0x21: case 0x22: case 0x23:
+        fixed = 2;
+        break;
+    case 0x02: case 0x11: case 0x18: case 0x27:
+        fixed = 4;
+        break;
+    case 0x0B:
+        return get_varint(p, end, value);
+    case 0x26:          // User property: two strings
+        for (int i = 0; i < 2; i++) {
+            if (end - *p < 2) {
+                return false;
+            }
+            size_t len = ((size_t)(*p)[0] << 8) | (*p)[1];
+            if ((size_t)(end - *p) < 2 + len) {
+                return false;
+            }
+            *p += 2 + len;
+        }
+        return true;
+    case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16:
+    case 0x1A: case 0x1C: case 0x1F: {
+        // Strings and binary data are both length prefixed
+        if (end - *p < 2) {
+            return false;
+        }
+        size_t len = ((size_t)(*p)[0] << 8) | (*p)[1];
+        if ((size_t)(end - *p) < 2 + len) {
+            return false;
+        }
+        *p += 2 + len;
+        return true;
+    }
+    default:
+        return false;
+    }
+
+    if ((size_t)(end - *p) < fixed) {
+        return false;
+    }
+    for (size_t i = 0; i < fixed; i++) {
+        *value = (*value << 8) | *(*p)++;
+    }
+    return true;
+}
+
+static size_t packet_size(uint32_t remaining)
+{
+    return 1 + varint_size(remaining) + remaining;
+}
+
+static uint32_t connect_remaining(const char *client_id)
+{
+    // Protocol name, level, flags, keepalive, empty properties, client id
+    return 6 + 1 + 1 + 2 + 1 + 2 + (uint32_t)strlen(client_id);
+}
+
+size_t mqtt5_connect_size(const char *client_id)
+{
+    return packet_size(connect_remaining(client_id));
+}
+
+size_t mqtt5_encode_connect(uint8_t *buf, const char *client_id, uint16_t keepalive)
+{
+    uint8_t *p = buf;
+    *p++ = MQTT5_CONNECT;
+    p = put_varint(p, connect_remaining(client_id));
+    p = put_string(p, "MQTT", 4);
+    *p++ = 5;                   // Protocol level
+    *p++ = 0x02;                // Clean start
+    p = put_u16(p, keepalive);
+    *p++ = 0;                   // No properties
+    p = put_string(p, client_id, strlen(client_id));
+    return p - buf;
+}
+
+static uint32_t publish_properties(const mqtt5_publish_t *pub)
+{
+    uint32_t len = 2;           // Payload format indicator
+    if (pub->expiry_s) {
+        len += 5;
+    }
+    if (pub->topic_alias) {
+        len += 3;
+    }
+    if (pub->content_type) {
+        len += 3 + (uint32_t)strlen(pub->content_type);
+    }
+    return len;
+}
+
+static uint32_t publish_remaining(const mqtt5_publish_t *pub)
+{
+    uint32_t props = publish_properties(pub);
+    uint32_t len = 2 + (pub->topic ? (uint32_t)strlen(pub->topic) : 0);
+    if (pub->qos > 0) {
+        len += 2;
+    }
+    return len + (uint32_t)varint_size(props) + props + pub->payload_len;
+}
+
+size_t mqtt5_publish_size(const mqtt5_publish_t *pub)
+{
+    return packet_size(publish_remaining(pub));
+}
+
+size_t mqtt5_encode_publish(uint8_t *buf, const mqtt5_publish_t *pub)
+{
+    uint8_t *p = buf;
+    *p++ = MQTT5_PUBLISH | (pub->qos << 1) | (pub->retain ? 1 : 0);
+    p = put_varint(p, publish_remaining(pub));
+    p = put_string(p, pub->topic ? pub->topic : "", pub->topic ? strlen(pub->topic) : 0);
+    if (pub->qos > 0) {
+        p = put_u16(p, pub->packet_id);
+    }
+
+    p = put_varint(p, publish_properties(pub));
+    *p++ = PROP_PAYLOAD_FORMAT;
+    *p++ = pub->utf8_payload ? 1 : 0;
+    if (pub->expiry_s) {
+        *p++ = PROP_MESSAGE_EXPIRY;
+        p = put_u32(p, pub->expiry_s);
+    }
+    if (pub->topic_alias) {
+        *p++ = PROP_TOPIC_ALIAS;
+        p = put_u16(p, pub->topic_alias);
+    }
+    if (pub->content_type) {
+        *p++ = PROP_CONTENT_TYPE;
+        p = put_string(p, pub->content_type, strlen(pub->content_type));
+    }
+
+    memcpy(p, pub->payload, pub->payload_len);
+    return p + pub->payload_len - buf;
+}
+
+static uint32_t subscribe_remaining(const char *topic)
+{
+    // Packet id, empty properties, topic filter, options
+    return 2 + 1 + 2 + (uint32_t)strlen(topic) + 1;
+}
+
+size_t mqtt5_subscribe_size(const char *topic)
+{
+    return packet_size(subscribe_remaining(topic));
+}
+
+size_t mqtt5_encode_subscribe(uint8_t *buf, uint16_t packet_id, const char *topic, int qos)
+{
+    uint8_t *p = buf;
+    *p++ = MQTT5_SUBSCRIBE;
+    p = put_varint(p, subscribe_remaining(topic));
+    p = put_u16(p, packet_id);
+    *p++ = 0;
+    p = put_string(p, topic, strlen(topic));
+    *p++ = (uint8_t)qos;
+    return p - buf;
+}
+
+size_t mqtt5_encode_puback(uint8_t *buf, uint16_t packet_id)
+{
+    // Reason code and properties may be omitted on success
+    buf[0] = MQTT5_PUBACK;
+    buf[1] = 2;
+    put_u16(buf + 2, packet_id);
+    return 4;
+}
+
+size_t mqtt5_encode_pingreq(uint8_t *buf)
+{
+    buf[0] = MQTT5_PINGREQ;
+    buf[1] = 0;
+    return 2;
+}
+
+size_t mqtt5_encode_disconnect(uint8_t *buf)
+{
+    buf[0] = MQTT5_DISCONNECT;
+    buf[1] = 0;
+    return 2;
+}
+
+int mqtt5_next_packet(const uint8_t *buf, size_t len, uint8_t *type, size_t *header_len, size_t *total)
+{
+    if (len < 2) {
+        return 0;
+    }
+
+    uint32_t remaining = 0;
+    size_t i = 1;
+    for (int shift = 0;; shift += 7) {
+        if (shift >= 28) {
+            return -1;
+        }
+        if (i >= len) {
+            return 0;
+        }
+        uint8_t b = buf[i++];
+        remaining |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+
+    *type = buf[0];
+    *header_len = i;
+    *total = i + remaining;
+    return len >= *total ? 1 : 0;
+}
+
+bool mqtt5_parse_connack(const uint8_t *body, size_t len, mqtt5_connack_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->receive_max = 65535;
+    if (len < 2) {
+        return false;
+    }
+    out->reason = body[1];
+
+    const uint8_t *p = body + 2;
+    const uint8_t *end = body + len;
+    uint32_t props_len;
+    if (p == end) {
+        return true;            // Properties omitted
+    }
+    if (!get_varint(&p, end, &props_len) || (size_t)(end - p) < props_len) {
+        return false;
+    }
+    end = p + props_len;
+    while (p < end) {
+        uint8_t id;
+        uint32_t value;
+        if (!get_property(&p, end, &id, &value)) {
+            return false;
+        }
+        if (id == PROP_TOPIC_ALIAS_MAX) {
+            out->topic_alias_max = (uint16_t)value;
+        } else if (id == PROP_RECEIVE_MAX) {
+            out->receive_max = (uint16_t)value;
+        } else if (id == PROP_SERVER_KEEPALIVE) {
+            out->server_keepalive = (uint16_t)value;
+        }
+    }
+    return true;
+}
+
+bool mqtt5_parse_publish(uint8_t type, const uint8_t *body, size_t len, mqtt5_incoming_t *out)
+{
+    out->qos = (type >> 1) & 0x03;
+    out->packet_id = 0;
+    if (len < 2) {
+        return false;
+    }
+    size_t topic_len = ((size_t)body[0] << 8) | body[1];
+    out->topic = (const char *)body + 2;
+    out->topic_len = (uint16_t)topic_len;
+    const uint8_t *p = body + 2 + topic_len;
+    const uint8_t *end = body + len;
+    if (p > end) {
+        return false;
+    }
+    if (out->qos > 0) {
+        if (end - p < 2) {
+            return false;
+        }
+        out->packet_id = ((uint16_t)p[0] << 8) | p[1];
+        p += 2;
+    }
+    uint32_t props_len;
+    if (!get_varint(&p, end, &props_len) || (size_t)(end - p) < props_len) {
+        return false;
+    }
+    out->payload = p + props_len;
+    out->payload_len = (uint32_t)(end - p - props_len);
+    return true;
+}
+
+uint16_t mqtt5_ack_packet_id(const uint8_t *body, size_t len)
+{
+    return len >= 2 ? (((uint16_t)body[0] << 8) | body[1]) : 0;
+}
+
+uint8_t mqtt5_disconnect_reason(const uint8_t *body, size_t len)
+{
+    return len >= 1 ? body[0] : 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file mqtt5_codec.h
+ * @brief Minimal MQTT v5 packet encoder and decoder for the fleet generator
+ *
+ * Also built into the server-side ingest daemon (csi-server/native), which
+ * needs the same packets as a subscriber.
+ *
+ * Covers what a node of the firmware sends and receives: CONNECT,
+ * PUBLISH with the properties mqtt_client_wrapper.c sets, SUBSCRIBE,
+ * PUBACK, PINGREQ and DISCONNECT out; CONNACK, PUBACK, SUBACK, PUBLISH,
+ * PINGRESP and DISCONNECT in. Encoders write into a caller buffer of at
+ * least the size the matching *_size() function returns.
+ */
+
+#ifndef MQTT5_CODEC_H
+#define MQTT5_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MQTT5_CONNECT       0x10
+#define MQTT5_CONNACK       0x20
+#define MQTT5_PUBLISH       0x30
+#define MQTT5_PUBACK        0x40
+#define MQTT5_SUBSCRIBE     0x82
+#define MQTT5_SUBACK        0x90
+#define MQTT5_PINGREQ       0xC0
+#define MQTT5_PINGRESP      0xD0
+#define MQTT5_DISCONNECT    0xE0
+
+#define MQTT5_MAX_HEADER    5       ///< Fixed header: type byte and 4-byte length
+
+/**
+ * @brief Outgoing PUBLISH
+ */
+typedef struct {
+    const char *topic;          ///< Topic, or NULL to send the bare alias
+    uint16_t topic_alias;       ///< Alias, 0 for none
+    uint16_t packet_id;         ///< Used when qos > 0
+    int qos;
+    bool retain;
+    bool utf8_payload;          ///< Payload format indicator
+    uint32_t expiry_s;          ///< Message expiry interval, 0 to omit
+    const char *content_type;   ///< Content type or NULL
+    const uint8_t *payload;
+    uint32_t payload_len;
+} mqtt5_publish_t;
+
+/**
+ * @brief Fields of a CONNACK the client acts on
+ */
+typedef struct {
+    uint8_t reason;             ///< 0 on success
+    uint16_t topic_alias_max;   ///< Aliases the server accepts, 0 for none
+    uint16_t receive_max;       ///< QoS 1 messages allowed in flight
+    uint16_t server_keepalive;  ///< Keepalive imposed by the server, 0 if not set
+} mqtt5_connack_t;
+
+/**
+ * @brief Fields of an incoming PUBLISH
+ */
+typedef struct {
+    int qos;
+    uint16_t packet_id;
+    const char *topic;          ///< Points into the packet, not terminated
+    uint16_t topic_len;
+    const uint8_t *payload;     ///< Points into the packet
+    uint32_t payload_len;
+} mqtt5_incoming_t;
+
+/**
+ * @brief Encode a clean-start CONNECT, as esp-mqtt sends it without credentials
+ */
+size_t mqtt5_connect_size(const char *client_id);
+size_t mqtt5_encode_connect(uint8_t *buf, const char *client_id, uint16_t keepalive);
+
+/**
+ * @brief Encode a PUBLISH with its v5 properties
+ */
+size_t mqtt5_publish_size(const mqtt5_publish_t *pub);
+size_t mqtt5_encode_publish(uint8_t *buf, const mqtt5_publish_t *pub);
+
+/**
+ * @brief Encode a SUBSCRIBE for one topic
+ */
+size_t mqtt5_subscribe_size(const char *topic);
+size_t mqtt5_encode_subscribe(uint8_t *buf, uint16_t packet_id, const char *topic, int qos);
+
+size_t mqtt5_encode_puback(uint8_t *buf, uint16_t packet_id);
+size_t mqtt5_encode_pingreq(uint8_t *buf);
+size_t mqtt5_encode_disconnect(uint8_t *buf);
+
+/**
+ * @brief Find the next complete packet in a receive buffer
+ * @param buf Received bytes
+ * @param len Number of bytes
+ * @param type Packet type byte (including flags)
+ * @param header_len Length of the fixed header
+ * @param total Length of the whole packet
+ * @return 1 if a complete packet is there, 0 if more bytes are needed,
+ *         -1 if the stream is malformed
+ */
+int mqtt5_next_packet(const uint8_t *buf, size_t len, uint8_t *type, size_t *header_len, size_t *total);
+
+/**
+ * @brief Decode the body of a CONNACK
+ * @return true if well formed
+ */
+bool mqtt5_parse_connack(const uint8_t *body, size_t len, mqtt5_connack_t *out);
+
+/**
+ * @brief Decode the body of a PUBLISH
+ * @return true if well formed
+ */
+bool mqtt5_parse_publish(uint8_t type, const uint8_t *body, size_t len, mqtt5_incoming_t *out);
+
+/**
+ * @brief Packet id of a PUBACK or SUBACK body
+ */
+uint16_t mqtt5_ack_packet_id(const uint8_t *body, size_t len);
+
+/**
+ * @brief Reason code of a DISCONNECT body (0 if omitted)
+ */
+uint8_t mqtt5_disconnect_reason(const uint8_t *body, size_t len);
+
+#endif // MQTT5_CODEC_H
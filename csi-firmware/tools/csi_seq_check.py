@@ -0,0 +1,607 @@
+#!/usr/bin/env python3
+"""
+End-to-end CSI frame accounting.
+
+Every captured frame gets a per-node sequence number, and the node reports
+the frames it dropped as sequence ranges with a reason code (see
+csi_drop_reason_t in csi_collector.h). This tool consumes a CSI stream,
+finds the gaps in each node's sequence, attributes every missing frame to
+the pipeline stage that dropped it and measures capture-to-server latency.
+
+Sources, one per run:
+
+    --mqtt HOST[:PORT]   subscribes to <prefix>/csi_data, <prefix>/csi_frame
+                         and <prefix>/csi_drops; the node is the topic prefix
+    --ws URL             the web server's /ws endpoint, e.g. ws://10.0.0.5/ws
+    --udp [HOST:]PORT    one message per datagram; the node is the sender
+
+Messages are binary frames (csi_frame_header_t, version 2), CSI JSON
+carrying "seq", or drop reports ({"type":"drops",...}). Gaps that no drop
+report covers were lost after leaving the node (broker, network, server).
+
+Latency needs capture timestamps in UTC: binary frames with
+CSI_FRAME_FLAG_UTC, or JSON timestamps past 1e15 us. It includes any
+offset between the node's NTP clock and this host's clock.
+
+    python3 csi_seq_check.py --mqtt broker.local --duration 60
+    python3 csi_seq_check.py --ws ws://192.168.4.1/ws --json report.json
+"""
+
+import argparse
+import base64
+import bisect
+import json
+import os
+import random
+import socket
+import ssl
+import struct
+import sys
+import time
+
+CSI_FRAME_MAGIC = 0x5343
+CSI_FRAME_VERSION = 2
+CSI_FRAME_FLAG_UTC = 0x02
+CSI_FRAME_HEADER = struct.Struct("<HBBIQ6sbBBBH")
+
+# csi_drop_reason_t, in enum order
+DROP_REASONS = [
+    "none",
+    "no_mem",
+    "buffer_full",
+    "filtered",
+    "queue_full",
+    "http_poll",
+    "not_connected",
+    "encode",
+    "outbox_full",
+    "outbox_expired",
+    "publish",
+    "ws_send",
+]
+
+UTC_THRESHOLD_US = 10**15      # uptime would need 31 years to get here
+REORDER_WINDOW = 256           # frames a gap may stay open waiting for stragglers
+RESTART_GAP = 1 << 16          # a sequence this far back means the node rebooted
+LATENCY_SAMPLES = 200000
+
+
+def reason_name(code):
+    return DROP_REASONS[code] if 0 <= code < len(DROP_REASONS) else "reason_%d" % code
+
+
+class NodeTracker:
+    """Sequence and latency bookkeeping of one node."""
+
+    def __init__(self, name, settle_s):
+        self.name = name
+        self.settle_s = settle_s
+        self.rng = random.Random(name)
+        self.received = 0
+        self.duplicates = 0
+        self.late = 0
+        self.restarts = 0
+        self.bad = 0
+        self.missing = 0
+        self.by_reason = {}
+        self.unattributed = 0
+        self.latencies = []
+        self.latency_seen = 0
+        self.first_us = None
+        self.last_us = None
+        self._reset_epoch()
+
+    def _reset_epoch(self):
+        self.cursor = None          # lowest sequence not yet received or declared missing
+        self.base = None            # lowest sequence received this epoch
+        self.pending = set()        # received sequences above the cursor
+        self.max_seen = None
+        self.gaps = []              # open gaps [start, end, declared_at], sorted
+        self.drops = []             # reported drops [start, end, reason], sorted by start
+        self.next_seq = None        # from the latest drop report
+
+    # Frames
+
+    def on_frame(self, seq, timestamp_us, utc, recv_us):
+        self.first_us = self.first_us if self.first_us is not None else recv_us
+        self.last_us = recv_us
+
+        if self.cursor is not None and seq + RESTART_GAP < self.cursor:
+            self._restart(recv_us)
+        if self.cursor is None:
+            self.cursor = self.base = seq
+
+        if seq < self.base and self.base - seq <= REORDER_WINDOW:
+            # Joined the stream just after a reordered frame: start earlier
+            self._open_gap(seq + 1, self.base, recv_us)
+            self.base = seq
+            self.received += 1
+            self._latency(timestamp_us, utc, recv_us)
+            return
+        if seq < self.cursor:
+            if self._close_gap(seq):
+                self.late += 1
+                self.received += 1
+                self._latency(timestamp_us, utc, recv_us)
+            else:
+                self.duplicates += 1
+            return
+        if seq in self.pending:
+            self.duplicates += 1
+            return
+
+        self.received += 1
+        self._latency(timestamp_us, utc, recv_us)
+        self.pending.add(seq)
+        self.max_seen = seq if self.max_seen is None else max(self.max_seen, seq)
+        self._advance(recv_us)
+
+    def _advance(self, now_us):
+        while True:
+            while self.cursor in self.pending:
+                self.pending.remove(self.cursor)
+                self.cursor += 1
+            if not self.pending or self.max_seen - self.cursor < REORDER_WINDOW:
+                return
+            # The frame at the cursor is overdue: everything up to the next
+            # received one is a gap
+            nxt = min(self.pending)
+            self._open_gap(self.cursor, nxt, now_us)
+            self.cursor = nxt
+
+    def _open_gap(self, start, end, now_us):
+        self.missing += end - start
+        if self.gaps and self.gaps[-1][1] == start and self.gaps[-1][2] == now_us:
+            self.gaps[-1][1] = end
+        else:
+            self.gaps.append([start, end, now_us])
+
+    def _close_gap(self, seq):
+        i = bisect.bisect_right(self.gaps, [seq, float("inf"), 0]) - 1
+        if i < 0 or not self.gaps[i][0] <= seq < self.gaps[i][1]:
+            return False
+        start, end, declared = self.gaps[i]
+        pieces = [p for p in ([start, seq, declared], [seq + 1, end, declared]) if p[0] < p[1]]
+        self.gaps[i:i + 1] = pieces
+        self.missing -= 1
+        return True
+
+    def _latency(self, timestamp_us, utc, recv_us):
+        if not utc:
+            return
+        value = (recv_us - timestamp_us) / 1000.0
+        self.latency_seen += 1
+        if len(self.latencies) < LATENCY_SAMPLES:
+            self.latencies.append(value)
+        else:
+            j = self.rng.randrange(self.latency_seen)
+            if j < LATENCY_SAMPLES:
+                self.latencies[j] = value
+
+    def _restart(self, now_us):
+        self.restarts += 1
+        self.flush(now_us)
+        self._reset_epoch()
+
+    # Drop reports
+
+    def on_drops(self, report, recv_us):
+        next_seq = report.get("next_seq")
+        if (next_seq is not None and self.cursor is not None
+                and next_seq + RESTART_GAP < self.cursor):
+            self._restart(recv_us)
+        if next_seq is not None:
+            self.next_seq = int(next_seq)
+        for first, count, reason in report.get("ranges", []):
+            bisect.insort(self.drops, [int(first), int(first) + int(count), int(reason)])
+
+    # Attribution
+
+    def settle(self, now_us, everything=False):
+        """Attribute gaps old enough for their drop report to have arrived."""
+        horizon = now_us - self.settle_s * 1e6
+        keep = []
+        for gap in self.gaps:
+            if everything or gap[2] <= horizon:
+                self._attribute(gap[0], gap[1])
+            else:
+                keep.append(gap)
+        self.gaps = keep
+
+        # Drop ranges below every open gap and the cursor can no longer match
+        floor = self.gaps[0][0] if self.gaps else self.cursor
+        if floor is not None:
+            self.drops = [d for d in self.drops if d[1] > floor]
+
+    def _attribute(self, start, end):
+        pos = start
+        for d_start, d_end, reason in self.drops:
+            if d_start >= end:
+                break
+            if d_end <= pos:
+                continue
+            if d_start > pos:
+                self.unattributed += min(d_start, end) - pos
+                pos = min(d_start, end)
+            covered = min(d_end, end) - pos
+            if covered > 0:
+                name = reason_name(reason)
+                self.by_reason[name] = self.by_reason.get(name, 0) + covered
+                pos += covered
+            if pos >= end:
+                break
+        if pos < end:
+            self.unattributed += end - pos
+
+    def flush(self, now_us):
+        """End of stream or epoch: close everything still open."""
+        if self.cursor is not None and self.pending:
+            self._open_gap(self.cursor, self.max_seen + 1, now_us)
+            for seq in self.pending:
+                self._close_gap(seq)
+            self.pending.clear()
+            self.cursor = self.max_seen + 1
+
+        # Frames the node numbered after the last one we saw: counted only
+        # when a drop report says what happened to them, the rest may have
+        # been in flight when we stopped
+        if self.next_seq is not None and self.cursor is not None and self.next_seq > self.cursor:
+            pos = self.cursor
+            for d_start, d_end, _ in self.drops:
+                lo, hi = max(d_start, pos), min(d_end, self.next_seq)
+                if lo < hi:
+                    self._open_gap(lo, hi, now_us)
+                    pos = hi
+        self.settle(now_us, everything=True)
+
+    # Reporting
+
+    def summary(self):
+        lat = sorted(self.latencies)
+
+        def pct(p):
+            return lat[min(len(lat) - 1, int(p * len(lat)))] if lat else None
+
+        expected = self.received + self.missing
+        span = (self.last_us - self.first_us) / 1e6 if self.first_us is not None else 0.0
+        return {
+            "node": self.name,
+            "received": self.received,
+            "missing": self.missing,
+            "loss_pct": 100.0 * self.missing / expected if expected else 0.0,
+            "duplicates": self.duplicates,
+            "late": self.late,
+            "restarts": self.restarts,
+            "malformed": self.bad,
+            "dropped_by": dict(sorted(self.by_reason.items())),
+            "unattributed": self.unattributed,
+            "unsettled": sum(g[1] - g[0] for g in self.gaps),
+            "frames_per_s": self.received / span if span > 0 else 0.0,
+            "latency_ms": {
+                "samples": self.latency_seen,
+                "min": lat[0] if lat else None,
+                "p50": pct(0.50),
+                "p90": pct(0.90),
+                "p99": pct(0.99),
+                "p999": pct(0.999),
+                "max": lat[-1] if lat else None,
+            },
+        }
+
+
+def format_summary(s):
+    lines = ["node %s" % s["node"]]
+    lines.append("  frames      received %d  missing %d (%.2f%%)  duplicate %d  late %d  restarts %d  %.1f/s"
+                 % (s["received"], s["missing"], s["loss_pct"], s["duplicates"], s["late"],
+                    s["restarts"], s["frames_per_s"]))
+    dropped = "  ".join("%s %d" % kv for kv in s["dropped_by"].items())
+    lines.append("  dropped at  %s%sunattributed %d%s"
+                 % (dropped, "  " if dropped else "", s["unattributed"],
+                    "  (unsettled %d)" % s["unsettled"] if s["unsettled"] else ""))
+    lat = s["latency_ms"]
+    if lat["samples"]:
+        lines.append("  latency ms  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  min %.1f  (n=%d)"
+                     % (lat["p50"], lat["p90"], lat["p99"], lat["p999"], lat["max"], lat["min"],
+                        lat["samples"]))
+        if lat["min"] < 0:
+            lines.append("  warning: negative latency, node and host clocks disagree")
+    else:
+        lines.append("  latency ms  no UTC timestamps (node not NTP synchronized?)")
+    if s["malformed"]:
+        lines.append("  malformed   %d" % s["malformed"])
+    return "\n".join(lines)
+
+
+class Checker:
+    def __init__(self, settle_s):
+        self.settle_s = settle_s
+        self.nodes = {}
+
+    def node(self, name):
+        if name not in self.nodes:
+            self.nodes[name] = NodeTracker(name, self.settle_s)
+        return self.nodes[name]
+
+    def on_message(self, node_name, payload, recv_us):
+        node = self.node(node_name)
+        if len(payload) >= CSI_FRAME_HEADER.size and payload[:2] == b"\x43\x53":
+            (magic, version, flags, seq, timestamp, _mac, _rssi, _ch, _sec,
+             _sub, raw_len) = CSI_FRAME_HEADER.unpack_from(payload)
+            if version != CSI_FRAME_VERSION or CSI_FRAME_HEADER.size + raw_len > len(payload):
+                node.bad += 1
+                return
+            node.on_frame(seq, timestamp, bool(flags & CSI_FRAME_FLAG_UTC), recv_us)
+            return
+
+        try:
+            msg = json.loads(payload)
+        except ValueError:
+            node.bad += 1
+            return
+        if not isinstance(msg, dict):
+            node.bad += 1
+        elif msg.get("type") == "drops":
+            node.on_drops(msg, recv_us)
+        elif "seq" in msg:
+            timestamp = int(msg.get("timestamp", 0))
+            node.on_frame(int(msg["seq"]), timestamp, timestamp >= UTC_THRESHOLD_US, recv_us)
+        else:
+            node.bad += 1
+
+    def settle(self, now_us):
+        for node in self.nodes.values():
+            node.settle(now_us)
+
+    def finish(self, now_us):
+        for node in self.nodes.values():
+            node.flush(now_us)
+        return [self.nodes[name].summary() for name in sorted(self.nodes)]
+
+
+def now_us():
+    return time.time_ns() // 1000
+
+
+def recv_exact(sock, n):
+    buf = bytearray()
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise ConnectionError("connection closed")
+        buf += chunk
+    return bytes(buf)
+
+
+# MQTT 3.1.1, just enough to subscribe at QoS 0
+
+def mqtt_varint(n):
+    out = bytearray()
+    while True:
+        byte = n % 128
+        n //= 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def mqtt_string(s):
+    data = s.encode()
+    return struct.pack(">H", len(data)) + data
+
+
+def mqtt_read_packet(sock):
+    header = recv_exact(sock, 1)[0]
+    length, shift = 0, 0
+    while True:
+        byte = recv_exact(sock, 1)[0]
+        length += (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return header, recv_exact(sock, length) if length else b""
+
+
+def run_mqtt(args, checker, on_tick):
+    host, _, port = args.mqtt.partition(":")
+    port = int(port) if port else (8883 if args.tls else 1883)
+    sock = socket.create_connection((host, port), timeout=10)
+    if args.tls:
+        ctx = ssl.create_default_context(cafile=args.cafile)
+        if args.insecure:
+            ctx.check_hostname = False
+            ctx.verify_mode = ssl.CERT_NONE
+        sock = ctx.wrap_socket(sock, server_hostname=host)
+
+    flags = 0x02
+    payload = mqtt_string("csi-seq-check-%d" % os.getpid())
+    if args.username:
+        flags |= 0x80
+        payload += mqtt_string(args.username)
+        if args.password:
+            flags |= 0x40
+            payload += mqtt_string(args.password)
+    keepalive = 30
+    body = mqtt_string("MQTT") + bytes([4, flags]) + struct.pack(">H", keepalive) + payload
+    sock.sendall(b"\x10" + mqtt_varint(len(body)) + body)
+    header, data = mqtt_read_packet(sock)
+    if header >> 4 != 2 or len(data) < 2 or data[1] != 0:
+        raise ConnectionError("CONNACK refused (%s)" % (data[1] if len(data) > 1 else "?"))
+
+    prefix = args.prefix
+    topics = ["%s/csi_data" % prefix, "%s/csi_frame" % prefix, "%s/csi_drops" % prefix]
+    body = struct.pack(">H", 1) + b"".join(mqtt_string(t) + b"\x00" for t in topics)
+    sock.sendall(b"\x82" + mqtt_varint(len(body)) + body)
+
+    sock.settimeout(0.5)
+    last_ping = time.monotonic()
+    while on_tick():
+        if time.monotonic() - last_ping > keepalive / 2:
+            sock.sendall(b"\xc0\x00")
+            last_ping = time.monotonic()
+        try:
+            header, data = mqtt_read_packet(sock)
+        except socket.timeout:
+            continue
+        if header >> 4 != 3:
+            continue
+        recv = now_us()
+        topic_len = struct.unpack_from(">H", data)[0]
+        topic = data[2:2 + topic_len].decode(errors="replace")
+        offset = 2 + topic_len + (2 if (header >> 1) & 0x03 else 0)
+        checker.on_message(topic.rsplit("/", 1)[0], data[offset:], recv)
+
+
+# WebSocket client (RFC 6455)
+
+def ws_send(sock, opcode, payload):
+    mask = os.urandom(4)
+    n = len(payload)
+    if n < 126:
+        header = struct.pack("!BB", 0x80 | opcode, 0x80 | n)
+    elif n < 65536:
+        header = struct.pack("!BBH", 0x80 | opcode, 0x80 | 126, n)
+    else:
+        header = struct.pack("!BBQ", 0x80 | opcode, 0x80 | 127, n)
+    sock.sendall(header + mask + bytes(b ^ mask[i % 4] for i, b in enumerate(payload)))
+
+
+def run_ws(args, checker, on_tick):
+    url = args.ws
+    if not url.startswith("ws://"):
+        raise ValueError("only ws:// URLs are supported")
+    hostport, _, path = url[5:].partition("/")
+    host, _, port = hostport.partition(":")
+    sock = socket.create_connection((host, int(port) if port else 80), timeout=10)
+
+    key = base64.b64encode(os.urandom(16)).decode()
+    sock.sendall(("GET /%s HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                  "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n"
+                  % (path, hostport, key)).encode())
+    response = b""
+    while b"\r\n\r\n" not in response:
+        chunk = sock.recv(1024)
+        if not chunk:
+            raise ConnectionError("connection closed during handshake")
+        response += chunk
+    head, _, rest = response.partition(b"\r\n\r\n")
+    if b" 101 " not in head.split(b"\r\n")[0]:
+        raise ConnectionError("handshake refused: %s" % head.split(b"\r\n")[0].decode(errors="replace"))
+
+    buffered = bytearray(rest)
+
+    def read(n):
+        while len(buffered) < n:
+            chunk = sock.recv(65536)
+            if not chunk:
+                raise ConnectionError("connection closed")
+            buffered.extend(chunk)
+        out = bytes(buffered[:n])
+        del buffered[:n]
+        return out
+
+    sock.settimeout(0.5)
+    message, message_opcode = bytearray(), 0
+    while on_tick():
+        try:
+            b0, b1 = read(2)
+        except socket.timeout:
+            continue
+        sock.settimeout(10)
+        opcode, n = b0 & 0x0F, b1 & 0x7F
+        if n == 126:
+            n = struct.unpack("!H", read(2))[0]
+        elif n == 127:
+            n = struct.unpack("!Q", read(8))[0]
+        mask = read(4) if b1 & 0x80 else None
+        payload = read(n)
+        sock.settimeout(0.5)
+        if mask:
+            payload = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+
+        if opcode == 0x8:
+            break
+        if opcode == 0x9:
+            ws_send(sock, 0xA, payload)
+            continue
+        if opcode in (0x1, 0x2):
+            message, message_opcode = bytearray(payload), opcode
+        elif opcode == 0x0:
+            message.extend(payload)
+        else:
+            continue
+        if b0 & 0x80 and message_opcode:
+            checker.on_message(url, bytes(message), now_us())
+            message, message_opcode = bytearray(), 0
+
+
+def run_udp(args, checker, on_tick):
+    host, _, port = args.udp.rpartition(":")
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+    sock.bind((host or "0.0.0.0", int(port)))
+    sock.settimeout(0.5)
+    while on_tick():
+        try:
+            payload, addr = sock.recvfrom(65535)
+        except socket.timeout:
+            continue
+        checker.on_message(addr[0], payload, now_us())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--mqtt", metavar="HOST[:PORT]")
+    source.add_argument("--ws", metavar="URL")
+    source.add_argument("--udp", metavar="[HOST:]PORT")
+    parser.add_argument("--prefix", default="+", help="MQTT topic prefix, '+' for every node")
+    parser.add_argument("--username")
+    parser.add_argument("--password")
+    parser.add_argument("--tls", action="store_true", help="MQTT over TLS")
+    parser.add_argument("--cafile", help="CA bundle for --tls")
+    parser.add_argument("--insecure", action="store_true", help="skip certificate checks")
+    parser.add_argument("--duration", type=float, default=0, help="seconds to run, 0 until Ctrl-C")
+    parser.add_argument("--interval", type=float, default=10, help="seconds between interim reports")
+    parser.add_argument("--settle", type=float, default=5,
+                        help="seconds a gap waits for its drop report before it is attributed")
+    parser.add_argument("--json", metavar="FILE", help="also write the final report as JSON")
+    args = parser.parse_args()
+
+    checker = Checker(args.settle)
+    start = time.monotonic()
+    last_report = [start]
+
+    def on_tick():
+        now = time.monotonic()
+        checker.settle(now_us())
+        if args.interval and now - last_report[0] >= args.interval:
+            last_report[0] = now
+            for node in sorted(checker.nodes):
+                print(format_summary(checker.nodes[node].summary()), flush=True)
+        return not args.duration or now - start < args.duration
+
+    run = run_mqtt if args.mqtt else run_ws if args.ws else run_udp
+    try:
+        run(args, checker, on_tick)
+    except KeyboardInterrupt:
+        pass
+    except (OSError, ConnectionError, ValueError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        if not checker.nodes:
+            return 1
+
+    summaries = checker.finish(now_us())
+    print("=== final ===")
+    for s in summaries:
+        print(format_summary(s))
+    if not summaries:
+        print("no CSI received")
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(summaries, f, indent=2)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,610 @@
+/**
+ * @file mqtt_fleet_sim.c
+ * @brief Simulate a fleet of nodes reconnecting after a broker outage
+ *
+ * Every node runs the reconnect policy of the mqtt_client component. The
+ * backoff code is compiled from the firmware sources; the previous fixed
+ * policy (5 s delay, 10 attempts, 60 s pause) is kept here for comparison.
+ *
+ * The default mode is a discrete-event model: the broker is down for
+ * --outage-ms, then accepts at most --accept-rate connections per second
+ * and refuses the excess with "server busy". The report shows how the
+ * connect attempts are spread over time and how long the fleet takes to
+ * get back.
+ *
+ *     mqtt_fleet_sim --nodes 500 --outage-ms 30000 --accept-rate 50
+ *
+ * With --broker the same schedules drive real MQTT 3.1.1 CONNECTs against
+ * a local broker (e.g. mosquitto with max_connections or a rate limit):
+ *
+ *     mqtt_fleet_sim --broker 127.0.0.1:1883 --nodes 200 --policy jitter
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mqtt_backoff.h"
+
+// Previous policy of mqtt_client_wrapper.c
+#define FIXED_RETRY_DELAY_MS    5000
+#define FIXED_MAX_ATTEMPTS      10
+#define FIXED_PAUSE_MS          60000
+
+#define BUCKET_MS               100
+#define DEFAULT_NODES           500
+#define DEFAULT_OUTAGE_MS       30000
+#define DEFAULT_ACCEPT_RATE     50
+#define DEFAULT_DETECT_MS       500     // spread of disconnect detection
+#define DEFAULT_HORIZON_MS      900000
+#define CONNECT_TIMEOUT_MS      10000   // matches network.timeout_ms
+
+#define MQTT3_CONNACK_ACCEPTED  0x00
+#define MQTT3_CONNACK_UNAVAILABLE 0x03
+
+typedef enum {
+    POLICY_FIXED,
+    POLICY_JITTER,
+} policy_t;
+
+typedef struct {
+    mqtt_backoff_t backoff;
+    uint32_t retry_count;
+    int64_t next_ms;            // -1 once connected
+    int64_t connected_ms;
+    uint32_t attempts;
+    int fd;                     // broker mode: socket of the pending attempt
+    int64_t deadline_ms;
+    uint8_t rx[4];
+    int rx_len;
+} node_t;
+
+typedef struct {
+    policy_t policy;
+    int nodes;
+    int64_t outage_ms;
+    uint32_t accept_rate;
+    int64_t detect_ms;
+    int64_t horizon_ms;
+    bool busy_hint;
+    uint32_t seed;
+    const char *broker;
+} sim_config_t;
+
+typedef struct {
+    uint32_t *buckets;          // attempts per BUCKET_MS
+    size_t bucket_count;
+    uint64_t attempts;
+    uint64_t refused;
+    uint64_t failed;
+    int connected;
+    int64_t *connect_times;
+} sim_result_t;
+
+// Min-heap of pending attempts
+typedef struct {
+    int64_t t;
+    int node;
+} event_t;
+
+typedef struct {
+    event_t *items;
+    size_t len;
+} heap_t;
+
+static uint32_t s_rng = 0x12345678u;
+
+static uint32_t sim_random(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void heap_push(heap_t *h, int64_t t, int node)
+{
+    size_t i = h->len++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (h->items[parent].t <= t) {
+            break;
+        }
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i].t = t;
+    h->items[i].node = node;
+}
+
+static event_t heap_pop(heap_t *h)
+{
+    event_t top = h->items[0];
+    event_t last = h->items[--h->len];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= h->len) {
+            break;
+        }
+        if (child + 1 < h->len && h->items[child + 1].t < h->items[child].t) {
+            child++;
+        }
+        if (h->items[child].t >= last.t) {
+            break;
+        }
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->len > 0) {
+        h->items[i] = last;
+    }
+    return top;
+}
+
+static void node_init(node_t *node, const sim_config_t *cfg)
+{
+    uint8_t mac[6] = {0x24, 0x0a, 0xc4};  // one vendor block, like a real fleet
+    uint32_t r = sim_random();
+    mac[3] = r >> 16;
+    mac[4] = r >> 8;
+    mac[5] = r;
+
+    memset(node, 0, sizeof(*node));
+    node->fd = -1;
+    mqtt_backoff_init(&node->backoff, MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_CAP_MS, mac, sim_random());
+    (void)cfg;
+}
+
+/**
+ * @brief Delay before the next attempt, as the reconnect task computes it
+ */
+static int64_t node_next_delay(node_t *node, policy_t policy)
+{
+    if (policy == POLICY_JITTER) {
+        return mqtt_backoff_next(&node->backoff);
+    }
+
+    if (node->retry_count >= FIXED_MAX_ATTEMPTS) {
+        node->retry_count = 0;
+        return FIXED_PAUSE_MS + FIXED_RETRY_DELAY_MS;
+    }
+    return FIXED_RETRY_DELAY_MS;
+}
+
+static void record_attempt(sim_result_t *res, int64_t t)
+{
+    size_t bucket = (size_t)(t / BUCKET_MS);
+    if (bucket < res->bucket_count) {
+        res->buckets[bucket]++;
+    }
+    res->attempts++;
+}
+
+/**
+ * @brief Discrete-event model of the outage and a rate-limited broker
+ */
+static void run_model(const sim_config_t *cfg, node_t *nodes, sim_result_t *res)
+{
+    heap_t heap = { calloc(cfg->nodes, sizeof(event_t)), 0 };
+
+    // All nodes lose the broker at t=0 and notice within detect_ms
+    for (int i = 0; i < cfg->nodes; i++) {
+        int64_t detect = cfg->detect_ms > 0 ? sim_random() % cfg->detect_ms : 0;
+        heap_push(&heap, detect + node_next_delay(&nodes[i], cfg->policy), i);
+    }
+
+    // Token bucket with 100 ms worth of burst
+    double tokens = 0;
+    double burst = cfg->accept_rate / 10.0 > 1.0 ? cfg->accept_rate / 10.0 : 1.0;
+    int64_t last_refill = cfg->outage_ms;
+
+    while (heap.len > 0) {
+        event_t ev = heap_pop(&heap);
+        if (ev.t > cfg->horizon_ms) {
+            break;
+        }
+        node_t *node = &nodes[ev.node];
+        node->attempts++;
+        node->retry_count++;
+        record_attempt(res, ev.t);
+
+        bool accepted = false;
+        bool busy = false;
+        if (ev.t < cfg->outage_ms) {
+            res->failed++;
+        } else {
+            tokens += (ev.t - last_refill) * cfg->accept_rate / 1000.0;
+            if (tokens > burst) {
+                tokens = burst;
+            }
+            last_refill = ev.t;
+            if (tokens >= 1.0) {
+                tokens -= 1.0;
+                accepted = true;
+            } else {
+                busy = true;
+                res->refused++;
+            }
+        }
+
+        if (accepted) {
+            node->connected_ms = ev.t;
+            res->connect_times[res->connected++] = ev.t;
+            continue;
+        }
+        if (busy && cfg->busy_hint) {
+            mqtt_backoff_set_hint(&node->backoff,
+                                  mqtt_backoff_hint_for_reason(MQTT3_CONNACK_UNAVAILABLE, false));
+        }
+        heap_push(&heap, ev.t + node_next_delay(node, cfg->policy), ev.node);
+    }
+
+    free(heap.items);
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int broker_connect(const struct sockaddr_storage *addr, socklen_t addr_len, int id)
+{
+    int fd = socket(addr->ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const struct sockaddr *)addr, addr_len) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+
+    // MQTT 3.1.1 CONNECT, clean session, 60 s keepalive, client id "sim-NNNNN"
+    char client_id[16];
+    int id_len = snprintf(client_id, sizeof(client_id), "sim-%05d", id);
+    uint8_t pkt[64];
+    size_t n = 0;
+    pkt[n++] = 0x10;
+    pkt[n++] = (uint8_t)(10 + 2 + id_len);
+    static const uint8_t header[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 0x3c};
+    memcpy(&pkt[n], header, sizeof(header));
+    n += sizeof(header);
+    pkt[n++] = 0;
+    pkt[n++] = (uint8_t)id_len;
+    memcpy(&pkt[n], client_id, id_len);
+    n += id_len;
+
+    // Wait for the TCP connect so the CONNECT goes out in one segment
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    if (poll(&pfd, 1, CONNECT_TIMEOUT_MS) <= 0 || send(fd, pkt, n, MSG_NOSIGNAL) != (ssize_t)n) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Drive real connections with the same schedules
+ *
+ * All nodes start disconnected at t=0, as if the broker just came back.
+ * Accepted connections are kept open until the run ends.
+ */
+static int run_broker(const sim_config_t *cfg, node_t *nodes, sim_result_t *res)
+{
+    char host[128];
+    snprintf(host, sizeof(host), "%s", cfg->broker);
+    char *colon = strrchr(host, ':');
+    const char *port = "1883";
+    if (colon) {
+        *colon = '\0';
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = {0}, *ai = NULL;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &ai) != 0 || !ai) {
+        fprintf(stderr, "Cannot resolve %s\n", cfg->broker);
+        return -1;
+    }
+    struct sockaddr_storage addr;
+    socklen_t addr_len = ai->ai_addrlen;
+    memcpy(&addr, ai->ai_addr, ai->ai_addrlen);
+    freeaddrinfo(ai);
+
+    heap_t heap = { calloc(cfg->nodes, sizeof(event_t)), 0 };
+    struct pollfd *pfds = calloc(cfg->nodes, sizeof(struct pollfd));
+    int *pending = calloc(cfg->nodes, sizeof(int));
+
+    for (int i = 0; i < cfg->nodes; i++) {
+        int64_t detect = cfg->detect_ms > 0 ? sim_random() % cfg->detect_ms : 0;
+        heap_push(&heap, detect + node_next_delay(&nodes[i], cfg->policy), i);
+    }
+
+    int64_t start = now_ms();
+    int in_flight = 0;
+    while ((heap.len > 0 || in_flight > 0) && now_ms() - start < cfg->horizon_ms) {
+        int64_t t = now_ms() - start;
+
+        while (heap.len > 0 && heap.items[0].t <= t) {
+            event_t ev = heap_pop(&heap);
+            node_t *node = &nodes[ev.node];
+            node->attempts++;
+            node->retry_count++;
+            record_attempt(res, t);
+            node->fd = broker_connect(&addr, addr_len, ev.node);
+            if (node->fd < 0) {
+                res->failed++;
+                heap_push(&heap, t + node_next_delay(node, cfg->policy), ev.node);
+                continue;
+            }
+            node->deadline_ms = t + CONNECT_TIMEOUT_MS;
+            node->rx_len = 0;
+            in_flight++;
+        }
+
+        int n = 0;
+        for (int i = 0; i < cfg->nodes; i++) {
+            if (nodes[i].fd >= 0 && nodes[i].next_ms >= 0) {
+                pfds[n].fd = nodes[i].fd;
+                pfds[n].events = POLLIN;
+                pending[n++] = i;
+            }
+        }
+        int wait = heap.len > 0 ? (int)(heap.items[0].t - t) : 50;
+        poll(pfds, n, wait < 0 ? 0 : (wait > 50 ? 50 : wait));
+
+        t = now_ms() - start;
+        for (int k = 0; k < n; k++) {
+            node_t *node = &nodes[pending[k]];
+            bool done = false, accepted = false, busy = false;
+            if (pfds[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t r = recv(node->fd, node->rx + node->rx_len, 4 - node->rx_len, 0);
+                if (r <= 0) {
+                    done = true;
+                } else if ((node->rx_len += r) == 4) {
+                    done = true;
+                    accepted = node->rx[0] == 0x20 && node->rx[3] == MQTT3_CONNACK_ACCEPTED;
+                    busy = node->rx[3] == MQTT3_CONNACK_UNAVAILABLE;
+                }
+            } else if (t >= node->deadline_ms) {
+                done = true;
+            }
+            if (!done) {
+                continue;
+            }
+
+            in_flight--;
+            if (accepted) {
+                node->next_ms = -1;
+                node->connected_ms = t;
+                res->connect_times[res->connected++] = t;
+                continue;
+            }
+            close(node->fd);
+            node->fd = -1;
+            if (busy) {
+                res->refused++;
+                if (cfg->busy_hint) {
+                    mqtt_backoff_set_hint(&node->backoff,
+                                          mqtt_backoff_hint_for_reason(MQTT3_CONNACK_UNAVAILABLE, false));
+                }
+            } else {
+                res->failed++;
+            }
+            heap_push(&heap, t + node_next_delay(node, cfg->policy), pending[k]);
+        }
+    }
+
+    for (int i = 0; i < cfg->nodes; i++) {
+        if (nodes[i].fd >= 0) {
+            close(nodes[i].fd);
+        }
+    }
+    free(pending);
+    free(pfds);
+    free(heap.items);
+    return 0;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const sim_config_t *cfg, const sim_result_t *res)
+{
+    uint32_t peak = 0;
+    size_t peak_bucket = 0;
+    uint32_t peak_second = 0;
+    for (size_t i = 0; i < res->bucket_count; i++) {
+        if (res->buckets[i] > peak) {
+            peak = res->buckets[i];
+            peak_bucket = i;
+        }
+        if (i % (1000 / BUCKET_MS) == 0) {
+            uint32_t sum = 0;
+            for (size_t j = i; j < i + 1000 / BUCKET_MS && j < res->bucket_count; j++) {
+                sum += res->buckets[j];
+            }
+            if (sum > peak_second) {
+                peak_second = sum;
+            }
+        }
+    }
+
+    if (cfg->broker) {
+        printf("policy=%s nodes=%d broker=%s hint=%s\n",
+               cfg->policy == POLICY_JITTER ? "jitter" : "fixed", cfg->nodes,
+               cfg->broker, cfg->busy_hint ? "on" : "off");
+    } else {
+        printf("policy=%s nodes=%d outage=%lds accept=%u/s hint=%s\n",
+               cfg->policy == POLICY_JITTER ? "jitter" : "fixed", cfg->nodes,
+               (long)(cfg->outage_ms / 1000), cfg->accept_rate, cfg->busy_hint ? "on" : "off");
+    }
+    printf("  attempts          %llu (%.1f per node), refused busy %llu, failed %llu\n",
+           (unsigned long long)res->attempts, (double)res->attempts / cfg->nodes,
+           (unsigned long long)res->refused, (unsigned long long)res->failed);
+    printf("  peak attempts     %u per %d ms (at %.1f s), %u per second\n",
+           peak, BUCKET_MS, peak_bucket * BUCKET_MS / 1000.0, peak_second);
+    if (res->connected > 0) {
+        int64_t p50 = res->connect_times[res->connected / 2];
+        int p99_idx = (res->connected * 99) / 100;
+        int64_t p99 = res->connect_times[p99_idx < res->connected ? p99_idx : res->connected - 1];
+        int64_t last = res->connect_times[res->connected - 1];
+        printf("  reconnected       %d/%d, p50 %.1f s, p99 %.1f s, last %.1f s\n",
+               res->connected, cfg->nodes, p50 / 1000.0, p99 / 1000.0, last / 1000.0);
+    } else {
+        printf("  reconnected       0/%d\n", cfg->nodes);
+    }
+
+    // Coarse timeline: attempts per second, one row per 5 s
+    printf("  attempts/s timeline (5 s rows):\n");
+    size_t per_row = 5000 / BUCKET_MS;
+    int64_t end_ms = res->connected > 0 ? res->connect_times[res->connected - 1] : cfg->horizon_ms;
+    for (size_t row = 0; row * per_row < res->bucket_count && (int64_t)(row * 5000) <= end_ms; row++) {
+        uint32_t sum = 0;
+        for (size_t j = row * per_row; j < (row + 1) * per_row && j < res->bucket_count; j++) {
+            sum += res->buckets[j];
+        }
+        int bar = (int)(sum / 5.0 * 40 / (peak_second ? peak_second : 1));
+        printf("  %5zu s %6.1f |%.*s\n", row * 5, sum / 5.0, bar,
+               "########################################");
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --policy fixed|jitter|both  reconnect policy (default both)\n"
+            "  --nodes N                   fleet size (default %d)\n"
+            "  --outage-ms MS              broker downtime (default %d)\n"
+            "  --accept-rate N             broker accepts per second (default %d)\n"
+            "  --detect-ms MS              spread of disconnect detection (default %d)\n"
+            "  --horizon-ms MS             simulated time limit (default %d)\n"
+            "  --no-hint                   ignore server busy refusals\n"
+            "  --seed N                    random seed\n"
+            "  --broker HOST:PORT          connect to a real broker instead of the model\n",
+            prog, DEFAULT_NODES, DEFAULT_OUTAGE_MS, DEFAULT_ACCEPT_RATE, DEFAULT_DETECT_MS,
+            DEFAULT_HORIZON_MS);
+}
+
+static int run(sim_config_t *cfg)
+{
+    s_rng = cfg->seed ? cfg->seed : 1;
+
+    node_t *nodes = calloc(cfg->nodes, sizeof(node_t));
+    sim_result_t res = {0};
+    res.bucket_count = (size_t)(cfg->horizon_ms / BUCKET_MS) + 1;
+    res.buckets = calloc(res.bucket_count, sizeof(uint32_t));
+    res.connect_times = calloc(cfg->nodes, sizeof(int64_t));
+    if (!nodes || !res.buckets || !res.connect_times) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < cfg->nodes; i++) {
+        node_init(&nodes[i], cfg);
+    }
+
+    int ret = 0;
+    if (cfg->broker) {
+        ret = run_broker(cfg, nodes, &res);
+    } else {
+        run_model(cfg, nodes, &res);
+    }
+    if (ret == 0) {
+        qsort(res.connect_times, res.connected, sizeof(int64_t), cmp_i64);
+        report(cfg, &res);
+    }
+
+    free(res.connect_times);
+    free(res.buckets);
+    free(nodes);
+    return ret == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    sim_config_t cfg = {
+        .policy = POLICY_JITTER,
+        .nodes = DEFAULT_NODES,
+        .outage_ms = DEFAULT_OUTAGE_MS,
+        .accept_rate = DEFAULT_ACCEPT_RATE,
+        .detect_ms = DEFAULT_DETECT_MS,
+        .horizon_ms = DEFAULT_HORIZON_MS,
+        .busy_hint = true,
+        .seed = 1,
+    };
+    bool both = true;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--policy") == 0 && val) {
+            both = strcmp(val, "both") == 0;
+            cfg.policy = strcmp(val, "fixed") == 0 ? POLICY_FIXED : POLICY_JITTER;
+            i++;
+        } else if (strcmp(arg, "--nodes") == 0 && val) {
+            cfg.nodes = atoi(val);
+            i++;
+        } else if (strcmp(arg, "--outage-ms") == 0 && val) {
+            cfg.outage_ms = atoll(val);
+            i++;
+        } else if (strcmp(arg, "--accept-rate") == 0 && val) {
+            cfg.accept_rate = (uint32_t)atoi(val);
+            i++;
+        } else if (strcmp(arg, "--detect-ms") == 0 && val) {
+            cfg.detect_ms = atoll(val);
+            i++;
+        } else if (strcmp(arg, "--horizon-ms") == 0 && val) {
+            cfg.horizon_ms = atoll(val);
+            i++;
+        } else if (strcmp(arg, "--seed") == 0 && val) {
+            cfg.seed = (uint32_t)strtoul(val, NULL, 0);
+            i++;
+        } else if (strcmp(arg, "--broker") == 0 && val) {
+            cfg.broker = val;
+            i++;
+        } else if (strcmp(arg, "--no-hint") == 0) {
+            cfg.busy_hint = false;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (cfg.nodes <= 0 || cfg.accept_rate == 0 || cfg.horizon_ms <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!both) {
+        return run(&cfg);
+    }
+
+    cfg.policy = POLICY_FIXED;
+    int ret = run(&cfg);
+    printf("\n");
+    cfg.policy = POLICY_JITTER;
+    return ret | run(&cfg);
+}
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""
+Per-message MQTT overhead of the CSI publish path.
+
+Builds the exact PUBLISH packets the node sends for one CSI frame and
+compares the encodings:
+
+    v3.1.1 + formatted JSON    the original cJSON_Print payload, full topic
+    v3.1.1 + compact JSON      cJSON_PrintUnformatted, full topic
+    v5 + compact JSON          topic alias, UTF-8 flag, expiry
+    v5 + binary frame          topic alias, content type, expiry,
+                               csi_frame_header_t + raw CSI
+
+The JSON follows cJSON's number formatting, so the sizes match what the
+firmware produces for the same values.
+
+    python3 mqtt_overhead.py --rates 100 500 --subcarriers 64
+"""
+
+import argparse
+import math
+import random
+import struct
+import sys
+
+CSI_FRAME_MAGIC = 0x5343
+CSI_FRAME_VERSION = 2
+CSI_FRAME_FLAG_RAW = 0x01
+CSI_FRAME_HEADER = struct.Struct("<HBBIQ6sbBBBH")
+
+# MQTT v5 property identifiers
+PROP_PAYLOAD_FORMAT = 0x01
+PROP_MESSAGE_EXPIRY = 0x02
+PROP_CONTENT_TYPE = 0x03
+PROP_TOPIC_ALIAS = 0x23
+
+CSI_MESSAGE_EXPIRY_S = 5
+CSI_FRAME_CONTENT_TYPE = "application/x-csi-frame"
+
+INT_MAX = 2**31 - 1
+INT_MIN = -2**31
+DBL_EPSILON = sys.float_info.epsilon
+
+
+def cjson_number(d):
+    """Format a double the way cJSON's print_number does."""
+    if math.isnan(d) or math.isinf(d):
+        return "null"
+    valueint = INT_MAX if d >= INT_MAX else INT_MIN if d <= INT_MIN else int(d)
+    if d == float(valueint):
+        return "%d" % valueint
+    text = "%1.15g" % d
+    test = float(text)
+    if abs(test - d) > max(abs(test), abs(d)) * DBL_EPSILON:
+        text = "%1.17g" % d
+    return text
+
+
+def float32(x):
+    return struct.unpack("<f", struct.pack("<f", x))[0]
+
+
+def csi_json(frame, formatted):
+    """Reproduce csi_data_to_json() output."""
+    fields = [
+        ("seq", cjson_number(float(frame["seq"]))),
+        ("timestamp", cjson_number(float(frame["timestamp"]))),
+        ("mac", '"%s"' % ":".join("%02X" % b for b in frame["mac"])),
+        ("rssi", cjson_number(float(frame["rssi"]))),
+        ("channel", cjson_number(float(frame["channel"]))),
+        ("secondary_channel", cjson_number(0.0)),
+        ("subcarrier_count", cjson_number(float(frame["subcarriers"]))),
+    ]
+    sep = ", " if formatted else ","
+    for key in ("amplitude", "phase"):
+        fields.append((key, "[" + sep.join(cjson_number(v) for v in frame[key]) + "]"))
+
+    if formatted:
+        body = ",\n".join('\t"%s":\t%s' % (k, v) for k, v in fields)
+        return ("{\n" + body + "\n}").encode()
+    return ("{" + ",".join('"%s":%s' % (k, v) for k, v in fields) + "}").encode()
+
+
+def csi_frame(frame):
+    """Reproduce csi_data_to_frame() output."""
+    header = CSI_FRAME_HEADER.pack(CSI_FRAME_MAGIC, CSI_FRAME_VERSION, CSI_FRAME_FLAG_RAW,
+                                   frame["seq"], frame["timestamp"], bytes(frame["mac"]), frame["rssi"],
+                                   frame["channel"], 0, frame["subcarriers"], len(frame["raw"]))
+    return header + frame["raw"]
+
+
+def varint(n):
+    out = bytearray()
+    while True:
+        byte = n % 128
+        n //= 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def utf8_string(s):
+    data = s.encode()
+    return struct.pack(">H", len(data)) + data
+
+
+def publish_packet(topic, payload, qos, v5=False, alias=0, alias_established=False,
+                   utf8=False, content_type=None, expiry=0):
+    var = utf8_string("" if alias_established else topic)
+    if qos > 0:
+        var += struct.pack(">H", 1)
+    if v5:
+        props = b""
+        if utf8:
+            props += bytes([PROP_PAYLOAD_FORMAT, 1])
+        if expiry:
+            props += bytes([PROP_MESSAGE_EXPIRY]) + struct.pack(">I", expiry)
+        if content_type:
+            props += bytes([PROP_CONTENT_TYPE]) + utf8_string(content_type)
+        if alias:
+            props += bytes([PROP_TOPIC_ALIAS]) + struct.pack(">H", alias)
+        var += varint(len(props)) + props
+    body = var + payload
+    return bytes([0x30 | (qos << 1)]) + varint(len(body)) + body
+
+
+def make_frame(rng, subcarriers, seq):
+    raw = bytes(rng.randrange(256) for _ in range(subcarriers * 2))
+    amplitude, phase = [], []
+    for i in range(subcarriers):
+        imag = struct.unpack("b", raw[2 * i:2 * i + 1])[0]
+        real = struct.unpack("b", raw[2 * i + 1:2 * i + 2])[0]
+        amplitude.append(float32(math.sqrt(real * real + imag * imag)))
+        phase.append(float32(math.atan2(imag, real)))
+    return {
+        "seq": seq,
+        "timestamp": rng.randrange(10**9, 10**11),
+        "mac": [rng.randrange(256) for _ in range(6)],
+        "rssi": -rng.randrange(30, 90),
+        "channel": 6,
+        "subcarriers": subcarriers,
+        "raw": raw,
+        "amplitude": amplitude,
+        "phase": phase,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rates", type=int, nargs="+", default=[100, 500],
+                        help="frames per second to report")
+    parser.add_argument("--subcarriers", type=int, default=64)
+    parser.add_argument("--prefix", default="csi-device", help="topic prefix")
+    parser.add_argument("--qos", type=int, default=0, choices=(0, 1))
+    parser.add_argument("--frames", type=int, default=200, help="frames to average over")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    frames = [make_frame(rng, args.subcarriers, 100000 + i) for i in range(args.frames)]
+    json_topic = args.prefix + "/csi_data"
+    frame_topic = args.prefix + "/csi_frame"
+
+    def average(build):
+        # The first message of a connection carries the full topic with the alias
+        sizes = [len(build(f, i > 0)) for i, f in enumerate(frames)]
+        return sum(sizes) / len(sizes)
+
+    encodings = [
+        ("v3.1.1 + formatted JSON", average(lambda f, _: publish_packet(
+            json_topic, csi_json(f, True), args.qos))),
+        ("v3.1.1 + compact JSON", average(lambda f, _: publish_packet(
+            json_topic, csi_json(f, False), args.qos))),
+        ("v5 + compact JSON", average(lambda f, est: publish_packet(
+            json_topic, csi_json(f, False), args.qos, v5=True, alias=1, alias_established=est,
+            utf8=True, expiry=CSI_MESSAGE_EXPIRY_S))),
+        ("v5 + binary frame", average(lambda f, est: publish_packet(
+            frame_topic, csi_frame(f), args.qos, v5=True, alias=2, alias_established=est,
+            content_type=CSI_FRAME_CONTENT_TYPE, expiry=CSI_MESSAGE_EXPIRY_S))),
+    ]
+
+    # Framing alone: same payload, full topic vs alias plus properties
+    payload = csi_json(frames[0], False)
+    v3_framing = len(publish_packet(json_topic, payload, args.qos)) - len(payload)
+    v5_framing = len(publish_packet(json_topic, payload, args.qos, v5=True, alias=1,
+                                    alias_established=True, utf8=True,
+                                    expiry=CSI_MESSAGE_EXPIRY_S)) - len(payload)
+    v5_bare = len(publish_packet(json_topic, payload, args.qos, v5=True, alias=1,
+                                 alias_established=True)) - len(payload)
+
+    baseline = encodings[0][1]
+    print("CSI publish, %d subcarriers, QoS %d, topic prefix '%s'"
+          % (args.subcarriers, args.qos, args.prefix))
+    print("framing: v3.1.1 %d B, v5 alias only %d B, v5 alias + properties %d B"
+          % (v3_framing, v5_bare, v5_framing))
+    header = "%-26s %10s %8s" % ("encoding", "bytes/msg", "saved")
+    for rate in args.rates:
+        header += " %14s" % ("KiB/s @%d" % rate)
+    print(header)
+    for name, size in encodings:
+        line = "%-26s %10.1f %7.1f%%" % (name, size, 100.0 * (baseline - size) / baseline)
+        for rate in args.rates:
+            line += " %14.1f" % (size * rate / 1024.0)
+        print(line)
+
+
+if __name__ == "__main__":
+    main()
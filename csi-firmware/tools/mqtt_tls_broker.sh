@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+#
+# Local mosquitto TLS listener for testing MQTT session resumption.
+#
+# Generates a throwaway CA and server certificate, writes a mosquitto
+# configuration with a TLS listener and starts the broker:
+#
+#     tools/mqtt_tls_broker.sh [workdir] [port]
+#
+# Flash the node with ssl_enabled, the broker set to this host and ca.pem
+# added to the global CA store. The node logs every handshake as
+# "TLS full handshake" or "TLS resumed handshake" together with its
+# duration and heap peak; the same numbers are in mqtt_client_get_stats().
+#
+# Use "check" as the first argument to probe an already running listener
+# with openssl: it reconnects five times and reports how many of the
+# connections reused the session.
+#
+#     tools/mqtt_tls_broker.sh check [host] [port] [workdir]
+
+set -euo pipefail
+
+if [[ "${1:-}" == "check" ]]; then
+    host="${2:-localhost}"
+    port="${3:-8883}"
+    workdir="${4:-/tmp/mqtt-tls}"
+    out=$(openssl s_client -connect "${host}:${port}" -CAfile "${workdir}/ca.pem" \
+          -servername "${host}" -tls1_2 -reconnect </dev/null 2>/dev/null || true)
+    total=$(grep -c "^New, \|^Reused, " <<<"${out}" || true)
+    reused=$(grep -c "^Reused, " <<<"${out}" || true)
+    echo "${reused}/${total} connections resumed the TLS session"
+    [[ "${reused}" -gt 0 ]]
+    exit
+fi
+
+workdir="${1:-/tmp/mqtt-tls}"
+port="${2:-8883}"
+host="$(hostname)"
+
+mkdir -p "${workdir}"
+cd "${workdir}"
+
+if [[ ! -f server.pem ]]; then
+    openssl req -x509 -newkey rsa:2048 -nodes -days 30 -subj "/CN=csi-test-ca" \
+        -keyout ca.key -out ca.pem 2>/dev/null
+    openssl req -newkey rsa:2048 -nodes -subj "/CN=${host}" \
+        -keyout server.key -out server.csr 2>/dev/null
+    printf "subjectAltName=DNS:%s,DNS:localhost,IP:127.0.0.1\n" "${host}" > san.ext
+    openssl x509 -req -in server.csr -CA ca.pem -CAkey ca.key -CAcreateserial \
+        -days 30 -extfile san.ext -out server.pem 2>/dev/null
+    echo "Generated test CA and server certificate in ${workdir}"
+fi
+
+cat > mosquitto.conf <<EOF
+listener ${port}
+allow_anonymous true
+cafile ${workdir}/ca.pem
+certfile ${workdir}/server.pem
+keyfile ${workdir}/server.key
+tls_version tlsv1.2
+log_type all
+EOF
+
+echo "Starting mosquitto with a TLS listener on port ${port} (CA: ${workdir}/ca.pem)"
+exec mosquitto -c "${workdir}/mosquitto.conf"
@@ -0,0 +1,391 @@
+/**
+ * @file ota_pack.c
+ * @brief Pack firmware images into the compressed OTA format
+ *
+ * Produces images the ota_updater component decodes while streaming them
+ * into the update partition. The decoder is compiled from the firmware
+ * sources, so --bench checks the exact code that runs on the node.
+ *
+ *     ota_pack build/csi_positioning_firmware.bin firmware.csiz
+ *     ota_pack --bench --link-kbps 500 build/csi_positioning_firmware.bin
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+
+#include "ota_lz.h"
+
+#define DEFAULT_WINDOW_BITS     11
+#define DEFAULT_LOOKAHEAD_BITS  5
+#define DEFAULT_LINK_KBPS       1000
+#define MAX_CHAIN_DEPTH         256
+#define BENCH_FEED_SIZE         1460    // one TCP segment per HTTP read
+#define HASH_SIZE               65536
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} byte_buf_t;
+
+typedef struct {
+    byte_buf_t *out;
+    uint8_t acc;
+    uint8_t bits;
+} bit_writer_t;
+
+static void buf_reserve(byte_buf_t *buf, size_t extra)
+{
+    if (buf->len + extra <= buf->cap) {
+        return;
+    }
+    size_t cap = buf->cap ? buf->cap : 65536;
+    while (cap < buf->len + extra) {
+        cap *= 2;
+    }
+    buf->data = realloc(buf->data, cap);
+    if (!buf->data) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    buf->cap = cap;
+}
+
+static void buf_append(byte_buf_t *buf, const uint8_t *data, size_t len)
+{
+    buf_reserve(buf, len);
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+static void bits_put(bit_writer_t *bw, uint32_t value, uint8_t count)
+{
+    while (count--) {
+        bw->acc = (uint8_t)((bw->acc << 1) | ((value >> count) & 1));
+        if (++bw->bits == 8) {
+            buf_append(bw->out, &bw->acc, 1);
+            bw->acc = 0;
+            bw->bits = 0;
+        }
+    }
+}
+
+static void bits_flush(bit_writer_t *bw)
+{
+    if (bw->bits > 0) {
+        bw->acc <<= (8 - bw->bits);
+        buf_append(bw->out, &bw->acc, 1);
+        bw->acc = 0;
+        bw->bits = 0;
+    }
+}
+
+/**
+ * @brief Greedy LZSS over one independent block using hash chains
+ */
+static void encode_block(const uint8_t *in, size_t len, uint8_t window_bits,
+                         uint8_t lookahead_bits, byte_buf_t *out)
+{
+    static int32_t head[HASH_SIZE];
+    static int32_t prev[OTA_LZ_BLOCK_SIZE];
+    const size_t max_offset = (size_t)1 << window_bits;
+    const size_t max_len = (size_t)1 << lookahead_bits;
+    // Shortest match that is cheaper than emitting literals
+    const size_t min_len = (1 + window_bits + lookahead_bits) / 9 + 1;
+    bit_writer_t bw = { .out = out };
+
+    for (size_t i = 0; i < HASH_SIZE; i++) {
+        head[i] = -1;
+    }
+
+    size_t pos = 0;
+    while (pos < len) {
+        size_t best_len = 0;
+        size_t best_off = 0;
+
+        if (pos + 1 < len) {
+            uint32_t h = ((uint32_t)in[pos] << 8) | in[pos + 1];
+            int depth = MAX_CHAIN_DEPTH;
+            for (int32_t cand = head[h]; cand >= 0 && depth-- > 0; cand = prev[cand]) {
+                size_t off = pos - (size_t)cand;
+                if (off > max_offset) {
+                    break;
+                }
+                size_t limit = len - pos < max_len ? len - pos : max_len;
+                size_t n = 0;
+                while (n < limit && in[cand + n] == in[pos + n]) {
+                    n++;
+                }
+                if (n > best_len) {
+                    best_len = n;
+                    best_off = off;
+                    if (n == limit) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        size_t advance = 1;
+        if (best_len >= min_len) {
+            bits_put(&bw, 0, 1);
+            bits_put(&bw, (uint32_t)(best_off - 1), window_bits);
+            bits_put(&bw, (uint32_t)(best_len - 1), lookahead_bits);
+            advance = best_len;
+        } else {
+            bits_put(&bw, 1, 1);
+            bits_put(&bw, in[pos], 8);
+        }
+
+        for (size_t k = 0; k < advance; k++, pos++) {
+            if (pos + 1 < len) {
+                uint32_t h = ((uint32_t)in[pos] << 8) | in[pos + 1];
+                prev[pos] = head[h];
+                head[h] = (int32_t)pos;
+            }
+        }
+    }
+
+    bits_flush(&bw);
+}
+
+static void pack_image(const uint8_t *raw, size_t raw_len, uint8_t window_bits,
+                       uint8_t lookahead_bits, byte_buf_t *out, size_t *stored_blocks)
+{
+    ota_lz_header_t header = {
+        .version = OTA_LZ_VERSION,
+        .window_bits = window_bits,
+        .lookahead_bits = lookahead_bits,
+        .raw_size = (uint32_t)raw_len,
+        .block_size = OTA_LZ_BLOCK_SIZE,
+    };
+    EVP_Digest(raw, raw_len, header.sha256, NULL, EVP_sha256(), NULL);
+
+    uint8_t header_bytes[OTA_LZ_HEADER_SIZE];
+    ota_lz_write_header(&header, header_bytes);
+    buf_append(out, header_bytes, sizeof(header_bytes));
+
+    byte_buf_t block = {0};
+    *stored_blocks = 0;
+    for (size_t off = 0; off < raw_len; off += OTA_LZ_BLOCK_SIZE) {
+        size_t n = raw_len - off < OTA_LZ_BLOCK_SIZE ? raw_len - off : OTA_LZ_BLOCK_SIZE;
+        block.len = 0;
+        encode_block(raw + off, n, window_bits, lookahead_bits, &block);
+
+        uint16_t tag;
+        const uint8_t *payload;
+        size_t payload_len;
+        if (block.len >= n) {
+            tag = (uint16_t)(n | OTA_LZ_BLOCK_STORED);
+            payload = raw + off;
+            payload_len = n;
+            (*stored_blocks)++;
+        } else {
+            tag = (uint16_t)block.len;
+            payload = block.data;
+            payload_len = block.len;
+        }
+
+        uint8_t len_bytes[2] = { tag & 0xFF, tag >> 8 };
+        buf_append(out, len_bytes, 2);
+        buf_append(out, payload, payload_len);
+    }
+    free(block.data);
+}
+
+typedef struct {
+    EVP_MD_CTX *sha;
+    size_t produced;
+} verify_ctx_t;
+
+static int verify_output(const uint8_t *data, size_t len, void *user_ctx)
+{
+    verify_ctx_t *ctx = (verify_ctx_t *)user_ctx;
+    EVP_DigestUpdate(ctx->sha, data, len);
+    ctx->produced += len;
+    return 0;
+}
+
+/**
+ * @brief Decode a packed image the way the node does and check its hash
+ */
+static int verify_image(const byte_buf_t *packed, size_t feed_size, size_t *produced)
+{
+    static ota_lz_decoder_t dec;
+    verify_ctx_t ctx;
+    ctx.sha = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx.sha, EVP_sha256(), NULL);
+    ctx.produced = 0;
+    ota_lz_decoder_init(&dec, verify_output, &ctx);
+
+    ota_lz_result_t ret = OTA_LZ_OK;
+    for (size_t off = 0; off < packed->len && ret == OTA_LZ_OK; off += feed_size) {
+        size_t n = packed->len - off < feed_size ? packed->len - off : feed_size;
+        ret = ota_lz_decoder_feed(&dec, packed->data + off, n);
+    }
+    uint8_t digest[32];
+    EVP_DigestFinal_ex(ctx.sha, digest, NULL);
+    EVP_MD_CTX_free(ctx.sha);
+    if (ret != OTA_LZ_DONE) {
+        fprintf(stderr, "decode failed (%d) after %zu bytes\n", ret, ctx.produced);
+        return -1;
+    }
+
+    if (memcmp(digest, dec.header.sha256, sizeof(digest)) != 0) {
+        fprintf(stderr, "decoded image hash mismatch\n");
+        return -1;
+    }
+    *produced = ctx.produced;
+    return 0;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    if (!data || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "failed to read %s\n", path);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *len = (size_t)size;
+    return data;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options] <input.bin> [output.csiz]\n"
+            "  -w <bits>          window bits (%d-%d, default %d)\n"
+            "  -l <bits>          lookahead bits (default %d)\n"
+            "  --bench            compare raw and compressed transfer\n"
+            "  --link-kbps <n>    link rate used by --bench (default %d)\n",
+            prog, OTA_LZ_MIN_WINDOW_BITS, OTA_LZ_MAX_WINDOW_BITS, DEFAULT_WINDOW_BITS,
+            DEFAULT_LOOKAHEAD_BITS, DEFAULT_LINK_KBPS);
+}
+
+int main(int argc, char **argv)
+{
+    int window_bits = DEFAULT_WINDOW_BITS;
+    int lookahead_bits = DEFAULT_LOOKAHEAD_BITS;
+    int bench = 0;
+    double link_kbps = DEFAULT_LINK_KBPS;
+    const char *input = NULL;
+    const char *output = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            window_bits = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            lookahead_bits = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "--link-kbps") == 0 && i + 1 < argc) {
+            link_kbps = atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else if (!input) {
+            input = argv[i];
+        } else if (!output) {
+            output = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!input || (!output && !bench) || link_kbps <= 0 ||
+        window_bits < OTA_LZ_MIN_WINDOW_BITS || window_bits > OTA_LZ_MAX_WINDOW_BITS ||
+        lookahead_bits < OTA_LZ_MIN_LOOKAHEAD_BITS || lookahead_bits > window_bits) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t raw_len;
+    uint8_t *raw = read_file(input, &raw_len);
+    if (!raw) {
+        return 1;
+    }
+    if (raw_len == 0 || raw_len > UINT32_MAX) {
+        fprintf(stderr, "unsupported image size %zu\n", raw_len);
+        free(raw);
+        return 1;
+    }
+
+    byte_buf_t packed = {0};
+    size_t stored_blocks;
+    double t0 = now_seconds();
+    pack_image(raw, raw_len, (uint8_t)window_bits, (uint8_t)lookahead_bits, &packed, &stored_blocks);
+    double encode_s = now_seconds() - t0;
+
+    t0 = now_seconds();
+    size_t produced = 0;
+    int ret = verify_image(&packed, BENCH_FEED_SIZE, &produced);
+    double decode_s = now_seconds() - t0;
+    if (ret != 0 || produced != raw_len) {
+        fprintf(stderr, "roundtrip verification failed\n");
+        free(raw);
+        free(packed.data);
+        return 1;
+    }
+
+    if (output) {
+        FILE *f = fopen(output, "wb");
+        if (!f || fwrite(packed.data, 1, packed.len, f) != packed.len) {
+            perror(output);
+            if (f) {
+                fclose(f);
+            }
+            free(raw);
+            free(packed.data);
+            return 1;
+        }
+        fclose(f);
+    }
+
+    size_t blocks = (raw_len + OTA_LZ_BLOCK_SIZE - 1) / OTA_LZ_BLOCK_SIZE;
+    printf("%s: %zu -> %zu bytes (%.1f%%), %zu blocks, %zu stored, W=%d L=%d\n",
+           input, raw_len, packed.len, 100.0 * packed.len / raw_len,
+           blocks, stored_blocks, window_bits, lookahead_bits);
+
+    if (bench) {
+        double bytes_per_s = link_kbps * 1000.0 / 8.0;
+        double raw_transfer = raw_len / bytes_per_s;
+        double packed_transfer = packed.len / bytes_per_s;
+        printf("\n%-12s %12s %14s\n", "image", "bytes", "transfer (s)");
+        printf("%-12s %12zu %14.2f\n", "raw", raw_len, raw_transfer);
+        printf("%-12s %12zu %14.2f\n", "compressed", packed.len, packed_transfer);
+        printf("\nlink rate        : %.0f kbit/s\n", link_kbps);
+        printf("encode           : %.3f s (%.1f MB/s)\n", encode_s, raw_len / encode_s / 1e6);
+        printf("decode (host)    : %.3f s (%.1f MB/s)\n", decode_s, raw_len / decode_s / 1e6);
+        printf("decoder memory   : %zu bytes\n", sizeof(ota_lz_decoder_t));
+        printf("transfer saved   : %.2f s (%.1f%%)\n", raw_transfer - packed_transfer,
+               100.0 * (raw_transfer - packed_transfer) / raw_transfer);
+    }
+
+    free(raw);
+    free(packed.data);
+    return 0;
+}
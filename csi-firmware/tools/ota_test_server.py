@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""
+Local OTA test server for the CSI firmware.
+
+Serves a firmware image with HTTP Range / If-Range support and an
+X-Firmware-SHA256 header, and deliberately drops connections part way
+through a transfer so resumable downloads can be exercised end to end.
+
+    python3 ota_test_server.py build/csi_positioning_firmware.bin \
+        --port 8070 --drop-after 200000 --drop-count 3
+
+Point the node's OTA URL at http://<host>:8070/firmware.bin. The
+version manifest is served at /firmware.bin/version.json.
+
+Images packed with tools/ota_pack are served as application/x-csi-lz;
+X-Firmware-SHA256 then carries the hash of the uncompressed image, which
+is what the node verifies after decoding.
+"""
+
+import argparse
+import hashlib
+import http.server
+import json
+import os
+import re
+import socketserver
+import struct
+import sys
+import threading
+
+CHUNK_SIZE = 4096
+LZ_MAGIC = b"CSIZ"
+LZ_HEADER_SIZE = 48
+
+
+class FlakyOtaHandler(http.server.BaseHTTPRequestHandler):
+    """Request handler that serves one image and drops some transfers."""
+
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        sys.stderr.write("[ota-test] %s - %s\n" % (self.address_string(), fmt % args))
+
+    def do_GET(self):
+        server = self.server
+        if self.path.endswith("/version.json"):
+            self._send_manifest()
+            return
+        if not self.path.endswith(server.image_name):
+            self.send_error(404)
+            return
+
+        size = len(server.image)
+        start = 0
+        status = 200
+
+        range_header = self.headers.get("Range")
+        if_range = self.headers.get("If-Range")
+        if range_header and (if_range is None or if_range == server.etag):
+            match = re.match(r"bytes=(\d+)-$", range_header.strip())
+            if not match:
+                self.send_error(400, "Unsupported range")
+                return
+            start = int(match.group(1))
+            if start >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % size)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            status = 206
+
+        body_len = size - start
+        self.send_response(status)
+        self.send_header("Content-Type", server.content_type)
+        self.send_header("Content-Length", str(body_len))
+        self.send_header("Accept-Ranges", "bytes")
+        self.send_header("ETag", server.etag)
+        self.send_header("X-Firmware-SHA256", server.sha256)
+        if status == 206:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, size - 1, size))
+        self.end_headers()
+
+        drop_at = None
+        with server.lock:
+            if server.drops_left > 0 and body_len > server.drop_after:
+                server.drops_left -= 1
+                drop_at = start + server.drop_after
+
+        offset = start
+        while offset < size:
+            end = min(offset + CHUNK_SIZE, size)
+            if drop_at is not None and end >= drop_at:
+                self.wfile.write(server.image[offset:drop_at])
+                self.wfile.flush()
+                self.log_message("dropping connection at byte %d", drop_at)
+                self.close_connection = True
+                self.connection.shutdown(2)
+                return
+            self.wfile.write(server.image[offset:end])
+            offset = end
+        self.log_message("served bytes %d-%d", start, size - 1)
+
+    def _send_manifest(self):
+        if self.headers.get("If-None-Match") == self.server.etag:
+            self.send_response(304)
+            self.send_header("ETag", self.server.etag)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            self.log_message("manifest not modified")
+            return
+        body = json.dumps({
+            "version": self.server.version,
+            "size": len(self.server.image),
+            "raw_size": self.server.raw_size,
+            "compressed": self.server.compressed,
+            "sha256": self.server.sha256,
+        }).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("ETag", self.server.etag)
+        self.end_headers()
+        self.wfile.write(body)
+
+
+class FlakyOtaServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+    def __init__(self, address, image_path, version, drop_after, drop_count):
+        super().__init__(address, FlakyOtaHandler)
+        with open(image_path, "rb") as f:
+            self.image = f.read()
+        self.image_name = os.path.basename(image_path)
+        self.compressed = (len(self.image) >= LZ_HEADER_SIZE and
+                           self.image[:4] == LZ_MAGIC)
+        if self.compressed:
+            self.raw_size = struct.unpack_from("<I", self.image, 8)[0]
+            self.sha256 = self.image[16:48].hex()
+            self.content_type = "application/x-csi-lz"
+        else:
+            self.raw_size = len(self.image)
+            self.sha256 = hashlib.sha256(self.image).hexdigest()
+            self.content_type = "application/octet-stream"
+        # The ETag identifies the bytes on the wire, not the decoded image
+        self.etag = '"%s"' % hashlib.sha256(self.image).hexdigest()[:16]
+        self.version = version
+        self.drop_after = drop_after
+        self.drops_left = drop_count
+        self.lock = threading.Lock()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="OTA server that drops connections")
+    parser.add_argument("image", help="firmware image to serve")
+    parser.add_argument("--port", type=int, default=8070)
+    parser.add_argument("--version", default="1.0.1", help="version announced in version.json")
+    parser.add_argument("--drop-after", type=int, default=256 * 1024,
+                        help="bytes sent per request before the connection is dropped")
+    parser.add_argument("--drop-count", type=int, default=3,
+                        help="number of transfers to drop before serving normally")
+    args = parser.parse_args()
+
+    server = FlakyOtaServer(("0.0.0.0", args.port), args.image, args.version,
+                            args.drop_after, args.drop_count)
+    print("Serving %s (%d bytes%s, sha256 %s) on port %d" %
+          (server.image_name, len(server.image),
+           ", %d uncompressed" % server.raw_size if server.compressed else "",
+           server.sha256, args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
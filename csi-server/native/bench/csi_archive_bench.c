@@ -0,0 +1,300 @@
+/**
+ * @file csi_archive_bench.c
+ * @brief Size and scan speed of the CSI archive
+ *
+ * Archives synthetic CSI of slowly moving people (per-subcarrier phasors
+ * drifting at a few hertz, plus noise) for a number of nodes, then maps
+ * every segment and reads one column back, the access pattern of model
+ * training:
+ *
+ *     csi_archive_bench --nodes 50 --frames 100000 --rate 100 --column amplitude
+ *
+ * Reports bytes per frame next to the firmware's JSON for the same frames,
+ * and frames per second for the write and the scan. Exits non-zero if the
+ * scan does not return every frame.
+ */
+
+#define _GNU_SOURCE
+#include "csi_archive.h"
+
+#include <dirent.h>
+#include <ftw.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define BATCH_FRAMES    256
+#define SUBCARRIERS     CSI_MAX_SUBCARRIERS
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t s_rng = 12345;
+
+static uint32_t next_random(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+/**
+ * @brief Columns of one batch, filled like csi_ingest fills them
+ */
+static struct {
+    uint32_t sequence[BATCH_FRAMES];
+    uint64_t timestamp[BATCH_FRAMES];
+    uint8_t mac[BATCH_FRAMES * 6];
+    int8_t rssi[BATCH_FRAMES];
+    uint8_t channel[BATCH_FRAMES];
+    uint8_t secondary_channel[BATCH_FRAMES];
+    uint8_t subcarrier_count[BATCH_FRAMES];
+    uint8_t flags[BATCH_FRAMES];
+    int8_t iq[BATCH_FRAMES * CSI_INGEST_IQ_STRIDE];
+    float amplitude[BATCH_FRAMES * SUBCARRIERS];
+    float phase[BATCH_FRAMES * SUBCARRIERS];
+} s_batch;
+
+static void fill_frame(int row, int node, uint64_t frame, int rate)
+{
+    double t = (double)frame / rate;
+    s_batch.sequence[row] = (uint32_t)frame;
+    s_batch.timestamp[row] = 5000000 + frame * (1000000 / rate) + next_random() % 200;
+    memcpy(s_batch.mac + 6 * row, (const uint8_t[]){ 0x24, 0x0A, 0xC4, 0, 0, (uint8_t)node }, 6);
+    s_batch.rssi[row] = (int8_t)(-50 + (int)(next_random() % 5));
+    s_batch.channel[row] = 6;
+    s_batch.secondary_channel[row] = 0;
+    s_batch.subcarrier_count[row] = SUBCARRIERS;
+    s_batch.flags[row] = CSI_FRAME_FLAG_RAW;
+    for (int k = 0; k < SUBCARRIERS; k++) {
+        double amplitude = 20 + 8 * sin(0.3 * k + node) + 4 * sin(2 * M_PI * 0.7 * t + k * 0.1);
+        double phase = 0.2 * k + node + 1.5 * sin(2 * M_PI * 0.4 * t);
+        int real = (int)lrint(amplitude * cos(phase)) + (int)(next_random() % 3) - 1;
+        int imag = (int)lrint(amplitude * sin(phase)) + (int)(next_random() % 3) - 1;
+        s_batch.iq[row * CSI_INGEST_IQ_STRIDE + 2 * k] = (int8_t)real;
+        s_batch.iq[row * CSI_INGEST_IQ_STRIDE + 2 * k + 1] = (int8_t)imag;
+        s_batch.amplitude[row * SUBCARRIERS + k] = sqrtf(real * real + imag * imag);
+        s_batch.phase[row * SUBCARRIERS + k] = atan2f(imag, real);
+    }
+}
+
+/**
+ * @brief Length of the firmware's JSON for the batch's first frame
+ */
+static size_t json_bytes(int row)
+{
+    char out[4096];
+    char *p = out;
+    p += sprintf(p, "{\"seq\":%u,\"timestamp\":%llu,\"mac\":\"24:0A:C4:00:00:01\",\"rssi\":%d,\"channel\":6,"
+                 "\"secondary_channel\":0,\"subcarrier_count\":%d,\"amplitude\":[",
+                 s_batch.sequence[row], (unsigned long long)s_batch.timestamp[row], s_batch.rssi[row], SUBCARRIERS);
+    for (int k = 0; k < SUBCARRIERS; k++) {
+        p += sprintf(p, "%s%.17g", k ? "," : "", s_batch.amplitude[row * SUBCARRIERS + k]);
+    }
+    p += sprintf(p, "],\"phase\":[");
+    for (int k = 0; k < SUBCARRIERS; k++) {
+        p += sprintf(p, "%s%.17g", k ? "," : "", s_batch.phase[row * SUBCARRIERS + k]);
+    }
+    p += sprintf(p, "]}");
+    return p - out;
+}
+
+static uint64_t s_scan_rows;
+static uint64_t s_scan_bytes;
+static uint64_t s_scan_segments;
+static double s_scan_checksum;
+static csi_archive_column_t s_scan_column;
+static void *s_scratch;
+
+static int scan_segment(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)ftw;
+    size_t len = strlen(path);
+    if (flag != FTW_F || len < 5 || strcmp(path + len - 5, CSI_ARCHIVE_SUFFIX) != 0) {
+        return 0;
+    }
+    csi_archive_reader_t *reader = csi_archive_reader_open(path);
+    if (!reader) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return 1;
+    }
+    size_t stride = csi_archive_column_stride(s_scan_column);
+    csi_archive_group_t group;
+    for (uint32_t g = 0; csi_archive_reader_group(reader, g, &group); g++) {
+        const uint8_t *col = csi_archive_reader_column(reader, g, s_scan_column, s_scratch);
+        if (!col) {
+            fprintf(stderr, "Corrupt chunk in %s\n", path);
+            csi_archive_reader_close(reader);
+            return 1;
+        }
+        // Touch every row so the scan cannot be skipped
+        for (uint32_t r = 0; r < group.rows; r++) {
+            s_scan_checksum += col[r * stride + stride - 1];
+        }
+        s_scan_rows += group.rows;
+        s_scan_bytes += group.rows * stride;
+    }
+    s_scan_segments++;
+    csi_archive_reader_close(reader);
+    return 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+int main(int argc, char **argv)
+{
+    int nodes = 50;
+    long frames = 100000;
+    int rate = 100;
+    bool compress = true;
+    const char *column = "amplitude";
+    char dir[] = "/tmp/csi_archive_bench_XXXXXX";
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--nodes") == 0 && val) {
+            nodes = atoi(val);
+        } else if (strcmp(argv[i], "--frames") == 0 && val) {
+            frames = atol(val);
+        } else if (strcmp(argv[i], "--rate") == 0 && val) {
+            rate = atoi(val);
+        } else if (strcmp(argv[i], "--column") == 0 && val) {
+            column = val;
+        } else if (strcmp(argv[i], "--no-compress") == 0) {
+            compress = false;
+            continue;
+        } else {
+            fprintf(stderr, "Usage: %s [--nodes N] [--frames N] [--rate HZ] [--column NAME] [--no-compress]\n",
+                    argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    s_scan_column = CSI_ARCHIVE_COLUMNS;
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        if (strcmp(column, csi_archive_column_name(c)) == 0) {
+            s_scan_column = c;
+        }
+    }
+    if (nodes <= 0 || nodes > 255 || frames < nodes || rate <= 0 || rate > 1000000 ||
+        s_scan_column == CSI_ARCHIVE_COLUMNS) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    config.dir = dir;
+    config.writer.compress = compress;
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    if (!store) {
+        perror("store");
+        return 1;
+    }
+
+    // Nodes interleaved batch by batch, as the ingest workers deliver them
+    long per_node = frames / nodes;
+    uint64_t json_total = 0, json_samples = 0;
+    double write_time = 0;
+    for (long first = 0; first < per_node; first += BATCH_FRAMES) {
+        int count = per_node - first < BATCH_FRAMES ? (int)(per_node - first) : BATCH_FRAMES;
+        for (int n = 0; n < nodes; n++) {
+            char name[32];
+            snprintf(name, sizeof(name), "node-%03d", n);
+            for (int r = 0; r < count; r++) {
+                fill_frame(r, n, first + r, rate);
+            }
+            json_total += json_bytes(0);
+            json_samples++;
+            csi_ingest_batch_t batch = {
+                .node = name,
+                .count = count,
+                .sequence = s_batch.sequence,
+                .timestamp = s_batch.timestamp,
+                .mac = s_batch.mac,
+                .rssi = s_batch.rssi,
+                .channel = s_batch.channel,
+                .secondary_channel = s_batch.secondary_channel,
+                .subcarrier_count = s_batch.subcarrier_count,
+                .flags = s_batch.flags,
+                .iq = s_batch.iq,
+                .amplitude = s_batch.amplitude,
+                .phase = s_batch.phase,
+            };
+            double start = now_s();
+            csi_archive_store_append(store, &batch);
+            write_time += now_s() - start;
+        }
+    }
+    double start = now_s();
+    csi_archive_store_stats_t stats;
+    csi_archive_store_get_stats(store, &stats);
+    bool ok = csi_archive_store_close(store);
+    write_time += now_s() - start;
+
+    // Archive size on disk
+    uint64_t archive_bytes = 0;
+    char path[512];
+    for (int n = 0; n < nodes; n++) {
+        snprintf(path, sizeof(path), "%s/node-%03d", dir, n);
+        DIR *d = opendir(path);
+        struct dirent *e;
+        while (d && (e = readdir(d)) != NULL) {
+            struct stat st;
+            char file[1024];
+            snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+            if (e->d_name[0] != '.' && stat(file, &st) == 0) {
+                archive_bytes += st.st_size;
+            }
+        }
+        if (d) {
+            closedir(d);
+        }
+    }
+
+    s_scratch = aligned_alloc(8, (size_t)65536 * CSI_INGEST_IQ_STRIDE);
+    start = now_s();
+    if (nftw(dir, scan_segment, 16, FTW_PHYS) != 0) {
+        ok = false;
+    }
+    double scan_time = now_s() - start;
+
+    uint64_t written = stats.rows;
+    printf("%d nodes, %llu frames in %llu segments, %s\n", nodes, (unsigned long long)written,
+           (unsigned long long)stats.segments, compress ? "compressed" : "raw");
+    printf("size   %.1f bytes/frame archived, %.1f bytes/frame as JSON (%.1fx)\n",
+           (double)archive_bytes / written, (double)json_total / json_samples,
+           ((double)json_total / json_samples) / ((double)archive_bytes / written));
+    printf("write  %.0f frames/s\n", written / write_time);
+    printf("scan   %s: %.0f frames/s, %.0f MB/s of column data (checksum %.0f)\n",
+           csi_archive_column_name(s_scan_column), s_scan_rows / scan_time, s_scan_bytes / scan_time / 1e6,
+           s_scan_checksum);
+
+    nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    free(s_scratch);
+
+    if (written != (uint64_t)per_node * nodes || s_scan_rows != written || stats.write_errors) {
+        fprintf(stderr, "%llu frames written, %llu scanned, %llu write errors\n", (unsigned long long)written,
+                (unsigned long long)s_scan_rows, (unsigned long long)stats.write_errors);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file csi_archive_csv_bench.c
+ * @brief Throughput of converting ESP32-CSI-Tool CSV captures
+ *
+ * Writes a capture as ESP32-CSI-Tool prints it (or takes a real one) and
+ * converts it with the line-by-line converter and with the parallel one:
+ *
+ *     csi_archive_csv_bench --lines 1000000 --max-workers 16
+ *     csi_archive_csv_bench --file lab/capture.csv
+ *
+ * Reports GB/s of the parsers alone at 1, 2, 4, ... and max-workers
+ * threads, and of whole conversions into an archive. Exits non-zero if
+ * the parallel converter does not write byte for byte the segments of
+ * the line-by-line one.
+ */
+
+#define _GNU_SOURCE
+#include "csi_archive.h"
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t s_rng = 12345;
+
+static uint32_t next_random(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+/**
+ * @brief Capture of one station hearing a few transmitters, as _wifi_csi_cb prints it
+ */
+static bool write_capture(const char *path, long lines)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "type,role,mac,rssi,rate,sig_mode,mcs,bandwidth,smoothing,not_sounding,aggregation,stbc,"
+               "fec_coding,sgi,noise_floor,ampdu_cnt,channel,secondary_channel,local_timestamp,ant,sig_len,"
+               "rx_state,real_time_set,real_timestamp,len,CSI_DATA\n");
+    uint32_t ts = 4000000000u;
+    for (long line = 0; line < lines; line++) {
+        ts += 9000 + next_random() % 2000;
+        fprintf(f, "CSI_DATA,STA,24:0A:C4:00:00:%02X,%d,11,1,7,1,1,1,1,0,0,0,-93,0,6,1,%d,0,128,0,0,0.0,128,[",
+                (unsigned)(line % 4), -40 - (int)(next_random() % 40), (int32_t)ts);
+        for (int k = 0; k < 128; k++) {
+            int v = k < 12 || k >= 116 ? 0 : (int)(next_random() % 61) - 30;
+            fprintf(f, "%d ", v);
+        }
+        fprintf(f, "]\n");
+    }
+    return fclose(f) == 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static char s_other[4096];
+static bool s_same;
+
+/**
+ * @brief nftw() callback: compare a segment with its twin under s_other
+ */
+static const char *s_root;
+
+static int compare_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)ftw;
+    if (flag != FTW_F) {
+        return 0;
+    }
+    char twin[8192];
+    snprintf(twin, sizeof(twin), "%s%s", s_other, path + strlen(s_root));
+    FILE *a = fopen(path, "rb"), *b = fopen(twin, "rb");
+    bool same = a && b;
+    char x[65536], y[65536];
+    size_t n = 0;
+    while (same && (n = fread(x, 1, sizeof(x), a)) > 0) {
+        same = fread(y, 1, n, b) == n && memcmp(x, y, n) == 0;
+    }
+    same = same && fread(y, 1, 1, b) == 0;
+    if (a) {
+        fclose(a);
+    }
+    if (b) {
+        fclose(b);
+    }
+    if (!same) {
+        fprintf(stderr, "%s differs from %s (%lld bytes)\n", twin, path, (long long)st->st_size);
+        s_same = false;
+    }
+    return 0;
+}
+
+static bool same_tree(const char *a, const char *b)
+{
+    s_same = true;
+    s_root = a;
+    snprintf(s_other, sizeof(s_other), "%s", b);
+    nftw(a, compare_entry, 8, FTW_PHYS);
+    return s_same;
+}
+
+static csi_archive_store_t *open_store(const char *dir)
+{
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    config.dir = dir;
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    if (!store) {
+        fprintf(stderr, "Cannot open %s\n", dir);
+        exit(1);
+    }
+    return store;
+}
+
+int main(int argc, char **argv)
+{
+    long lines = 200000;
+    const char *file = NULL;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_workers = cpus > 0 ? (int)cpus : 1;
+    size_t chunk_mb = 4;
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--lines") == 0 && val) {
+            lines = atol(val);
+        } else if (strcmp(argv[i], "--file") == 0 && val) {
+            file = val;
+        } else if (strcmp(argv[i], "--max-workers") == 0 && val) {
+            max_workers = atoi(val);
+        } else if (strcmp(argv[i], "--chunk-mb") == 0 && val) {
+            chunk_mb = (size_t)atol(val);
+        } else {
+            fprintf(stderr, "Usage: %s [--lines N | --file CSV] [--max-workers N] [--chunk-mb N]\n", argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (lines <= 0 || max_workers <= 0 || max_workers > CSI_ARCHIVE_CSV_MAX_WORKERS || chunk_mb == 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    char dir[] = "/tmp/csi_archive_csv_bench_XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char capture[256], seq_dir[256], par_dir[256];
+    snprintf(capture, sizeof(capture), "%s/capture.csv", dir);
+    snprintf(seq_dir, sizeof(seq_dir), "%s/seq", dir);
+    snprintf(par_dir, sizeof(par_dir), "%s/par", dir);
+    if (!file) {
+        if (!write_capture(capture, lines)) {
+            fprintf(stderr, "Cannot write %s\n", capture);
+            return 1;
+        }
+        file = capture;
+    }
+    struct stat st;
+    if (stat(file, &st) != 0) {
+        perror(file);
+        return 1;
+    }
+    const double gb = st.st_size / 1e9;
+    printf("%s: %.1f MB, %ld CPUs\n", file, st.st_size / 1e6, cpus);
+
+    csi_archive_csv_config_t csv = { .chunk_bytes = chunk_mb << 20 };
+    csi_archive_convert_stats_t reference = {0}, stats;
+    bool ok = true;
+
+    printf("parse only\nworkers        GB/s   speedup  frames\n");
+    double base = 0;
+    for (int workers = 1;; workers = workers * 2 < max_workers ? workers * 2 : max_workers) {
+        csv.workers = workers;
+        double start = now_s();
+        if (!csi_archive_convert_file(file, CSI_ARCHIVE_INPUT_CSV, "bench", &csv, NULL, &stats)) {
+            perror("convert");
+            return 1;
+        }
+        double rate = gb / (now_s() - start);
+        base = workers == 1 ? rate : base;
+        reference = workers == 1 ? stats : reference;
+        bool same = stats.frames == reference.frames && stats.lines == reference.lines;
+        ok = ok && same;
+        printf("%7d %11.3f %8.2fx  %llu%s\n", workers, rate, rate / base, (unsigned long long)stats.frames,
+               same ? "" : " DIFFER");
+        if (workers == max_workers) {
+            break;
+        }
+    }
+
+    printf("into an archive\nconverter           GB/s  frames/s\n");
+    csi_archive_store_t *store = open_store(seq_dir);
+    FILE *input = fopen(file, "r");
+    double start = now_s();
+    ok = input && csi_archive_convert(input, CSI_ARCHIVE_INPUT_CSV, "bench", store, &stats) && ok;
+    ok = csi_archive_store_close(store) && ok;
+    double seconds = now_s() - start;
+    if (input) {
+        fclose(input);
+    }
+    printf("line by line %11.3f %9.0f\n", gb / seconds, stats.frames / seconds);
+    uint64_t frames = stats.frames;
+
+    store = open_store(par_dir);
+    csv.workers = max_workers;
+    start = now_s();
+    ok = csi_archive_convert_file(file, CSI_ARCHIVE_INPUT_CSV, "bench", &csv, store, &stats) && ok;
+    ok = csi_archive_store_close(store) && ok;
+    seconds = now_s() - start;
+    printf("parallel %2d  %11.3f %9.0f\n", max_workers, gb / seconds, stats.frames / seconds);
+
+    bool same = stats.frames == frames && stats.frames == reference.frames && same_tree(seq_dir, par_dir);
+    printf("archives %s\n", same ? "identical" : "DIFFER");
+    ok = ok && same;
+
+    nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    return ok ? 0 : 1;
+}
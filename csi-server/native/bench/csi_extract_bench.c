@@ -0,0 +1,242 @@
+/**
+ * @file csi_extract_bench.c
+ * @brief Scaling of per-link feature extraction from one worker to all cores
+ *
+ * Simulates nodes that each hear a few transmitters, and pushes their
+ * batches into the feature engine as csi_ingest would deliver them:
+ *
+ *     csi_extract_bench --nodes 64 --macs 4 --frames 2000 --max-workers 16
+ *
+ * Runs the same stream with 1, 2, 4, ... and max-workers workers and
+ * reports frames per second, the speedup over one worker and the share of
+ * link turns that were stolen. The pushing thread keeps only a few
+ * batches per link queued, so the figures include handing frames over,
+ * not just computing. Every run must output bit-identical features per
+ * link; the bench exits non-zero if they differ or frames were dropped.
+ */
+
+#include "csi_extract.h"
+#include "csi_sched.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH           64
+#define MAX_MACS        BATCH
+#define QUEUED_PER_LINK 4
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Columns of one node's batch; only sequence and timestamp change between rounds
+ */
+typedef struct {
+    char name[32];
+    uint32_t sequence[BATCH];
+    uint64_t timestamp[BATCH];
+    uint8_t mac[BATCH * 6];
+    int8_t rssi[BATCH];
+    uint8_t channel[BATCH];
+    uint8_t secondary_channel[BATCH];
+    uint8_t subcarrier_count[BATCH];
+    uint8_t flags[BATCH];
+    int8_t iq[BATCH * CSI_INGEST_IQ_STRIDE];
+    float amplitude[BATCH * CSI_MAX_SUBCARRIERS];
+    float phase[BATCH * CSI_MAX_SUBCARRIERS];
+} sim_node_t;
+
+static int s_macs;
+static uint64_t *s_checksum;            ///< Per link, written by its strand only
+
+static uint64_t fold(uint64_t h, const float *v, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t bits;
+        memcpy(&bits, &v[i], sizeof(bits));
+        h = (h ^ bits) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+static void checksum(const csi_extract_features_t *f, void *ctx)
+{
+    (void)ctx;
+    int node = f->mac[3] << 8 | f->mac[4];
+    uint64_t *h = &s_checksum[(size_t)node * s_macs + f->mac[5]];
+    *h = fold(*h, f->amplitude, f->subcarrier_count);
+    *h = fold(*h, f->phase, f->subcarrier_count);
+    if (f->variance) {
+        *h = fold(*h, f->variance, f->subcarrier_count);
+    }
+    if (f->spectrum) {
+        *h = fold(*h, f->spectrum, f->spectrum_bins);
+    }
+}
+
+static void make_node(sim_node_t *node, int index)
+{
+    snprintf(node->name, sizeof(node->name), "node-%d", index);
+    for (int r = 0; r < BATCH; r++) {
+        int m = r % s_macs;
+        const uint8_t mac[6] = { 0x24, 0x0A, 0xC4, (uint8_t)(index >> 8), (uint8_t)index, (uint8_t)m };
+        memcpy(node->mac + 6 * r, mac, 6);
+        node->rssi[r] = -50;
+        node->channel[r] = 6;
+        node->subcarrier_count[r] = CSI_MAX_SUBCARRIERS;
+        for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+            float t = 0.01f * r;
+            node->amplitude[r * CSI_MAX_SUBCARRIERS + k] =
+                20.0f + 5.0f * sinf(0.3f * k + index + m) + 2.0f * sinf(2.0f * (float)M_PI * 1.5f * t + 0.1f * k);
+            node->phase[r * CSI_MAX_SUBCARRIERS + k] = remainderf(0.3f * k + 0.7f * m + t, 6.2831853f);
+        }
+    }
+}
+
+typedef struct {
+    double seconds;
+    uint64_t steals;
+    uint64_t tasks;
+    uint64_t dropped;
+} run_result_t;
+
+static run_result_t run(sim_node_t *nodes, int node_count, int frames, int workers)
+{
+    csi_extract_config_t config = CSI_EXTRACT_CONFIG_DEFAULT();
+    config.workers = workers;
+    config.output = checksum;
+    csi_extract_t *x = csi_extract_create(&config);
+    if (!x) {
+        fprintf(stderr, "Could not start %d workers\n", workers);
+        exit(1);
+    }
+    const uint64_t links = (uint64_t)node_count * s_macs;
+    const int per_batch = BATCH / s_macs, rounds = (frames + per_batch - 1) / per_batch;
+
+    double start = now_s();
+    for (int round = 0; round < rounds; round++) {
+        for (int n = 0; n < node_count; n++) {
+            sim_node_t *node = &nodes[n];
+            for (int r = 0; r < BATCH; r++) {
+                node->sequence[r] = (uint32_t)(round * per_batch + r / s_macs);
+                node->timestamp[r] = 10000ULL * node->sequence[r];
+            }
+            csi_ingest_batch_t batch = {
+                .node = node->name,
+                .count = (uint32_t)(per_batch * s_macs),
+                .sequence = node->sequence,
+                .timestamp = node->timestamp,
+                .mac = node->mac,
+                .rssi = node->rssi,
+                .channel = node->channel,
+                .secondary_channel = node->secondary_channel,
+                .subcarrier_count = node->subcarrier_count,
+                .flags = node->flags,
+                .iq = node->iq,
+                .amplitude = node->amplitude,
+                .phase = node->phase,
+            };
+            csi_extract_push(x, &batch);
+        }
+        // Keep a few batches per link queued, as a live feed would
+        csi_extract_stats_t stats;
+        csi_extract_get_stats(x, &stats);
+        while (stats.pending > QUEUED_PER_LINK * links) {
+            nanosleep(&(struct timespec){ .tv_nsec = 20000 }, NULL);
+            csi_extract_get_stats(x, &stats);
+        }
+    }
+    csi_extract_drain(x);
+    run_result_t result = { .seconds = now_s() - start };
+
+    csi_extract_stats_t stats;
+    csi_extract_get_stats(x, &stats);
+    result.steals = stats.steals;
+    result.tasks = stats.tasks;
+    result.dropped = stats.backlog_full + stats.link_limit;
+    csi_extract_destroy(x);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    int node_count = 64;
+    int frames = 2000;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_workers = cpus > 0 ? (int)cpus : 1;
+    s_macs = 4;
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--nodes") == 0 && val) {
+            node_count = atoi(val);
+        } else if (strcmp(argv[i], "--macs") == 0 && val) {
+            s_macs = atoi(val);
+        } else if (strcmp(argv[i], "--frames") == 0 && val) {
+            frames = atoi(val);
+        } else if (strcmp(argv[i], "--max-workers") == 0 && val) {
+            max_workers = atoi(val);
+        } else {
+            fprintf(stderr, "Usage: %s [--nodes N] [--macs N] [--frames N] [--max-workers N]\n", argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (node_count <= 0 || node_count > 65535 || s_macs <= 0 || s_macs > MAX_MACS || frames <= 0 ||
+        max_workers <= 0 || max_workers > CSI_SCHED_MAX_WORKERS) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    const size_t links = (size_t)node_count * s_macs;
+    sim_node_t *nodes = calloc(node_count, sizeof(*nodes));
+    uint64_t *reference = calloc(links, sizeof(*reference));
+    s_checksum = calloc(links, sizeof(*s_checksum));
+    if (!nodes || !reference || !s_checksum) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int n = 0; n < node_count; n++) {
+        make_node(&nodes[n], n);
+    }
+    const int per_batch = BATCH / s_macs;
+    const uint64_t total = links * (uint64_t)(((frames + per_batch - 1) / per_batch) * per_batch);
+
+    printf("%d nodes x %d transmitters = %zu links, %d frames each, %ld CPUs\n", node_count, s_macs, links,
+           frames, cpus);
+    printf("workers    frames/s   speedup  efficiency  stolen  features\n");
+    double base = 0;
+    bool ok = true;
+    for (int workers = 1;; workers = workers * 2 < max_workers ? workers * 2 : max_workers) {
+        memset(s_checksum, 0, links * sizeof(*s_checksum));
+        run_result_t r = run(nodes, node_count, frames, workers);
+        double rate = total / r.seconds;
+        base = workers == 1 ? rate : base;
+        bool same = true;
+        if (workers == 1) {
+            memcpy(reference, s_checksum, links * sizeof(*reference));
+        } else {
+            same = memcmp(reference, s_checksum, links * sizeof(*reference)) == 0;
+        }
+        ok = ok && same && r.dropped == 0;
+        printf("%7d %11.0f %8.2fx %10.0f%% %6.1f%%  %s%s\n", workers, rate, rate / base,
+               100.0 * rate / base / workers, r.tasks ? 100.0 * r.steals / r.tasks : 0.0,
+               same ? "identical" : "DIFFER", r.dropped ? ", frames dropped" : "");
+        if (workers == max_workers) {
+            break;
+        }
+    }
+
+    free(nodes);
+    free(reference);
+    free(s_checksum);
+    return ok ? 0 : 1;
+}
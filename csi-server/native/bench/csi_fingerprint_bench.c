@@ -0,0 +1,299 @@
+/**
+ * @file csi_fingerprint_bench.c
+ * @brief Recall and query rate of the fingerprint index against brute force
+ *
+ * Surveys synthetic rooms: each room has its own smooth feature field (a
+ * sum of random plane waves per feature, the way multipath shapes CSI
+ * amplitude across a room), sampled at random positions with measurement
+ * noise. Queries are fresh measurements at other positions:
+ *
+ *     csi_fingerprint_bench --vectors 200000 --queries 1000 --dim 64 --rooms 50
+ *
+ * Builds the index through the survey path (adding vectors in batches and
+ * letting it train itself), then reports bytes per vector next to the raw
+ * floats, queries per second of an exact scan, and queries per second
+ * and recall@k of the index for a range of probes. The index is then
+ * saved, mapped back and checked to answer alike. Exits non-zero if the
+ * mapped index differs or the recall at the most probes is below 0.8.
+ */
+
+#define _GNU_SOURCE
+#include "csi_fingerprint.h"
+
+#include <ftw.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WAVES           8
+#define ROOM_SIZE       10.0f
+#define NOISE           0.05f
+#define ADD_BATCH       1000
+#define MAX_K           100
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ULL;
+
+static float uniform(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (s_rng >> 40) * (1.0f / 16777216.0f);
+}
+
+static float gaussian(void)
+{
+    float u = uniform() + 1e-7f, v = uniform();
+    return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+/**
+ * @brief Plane waves of every room and feature
+ */
+typedef struct {
+    float kx, ky, phase, amplitude;
+} wave_t;
+
+static wave_t *s_waves;
+static float *s_offset;
+static int s_dim;
+
+static void make_rooms(int rooms)
+{
+    s_waves = malloc((size_t)rooms * s_dim * WAVES * sizeof(*s_waves));
+    s_offset = malloc((size_t)rooms * s_dim * sizeof(*s_offset));
+    for (int i = 0; i < rooms * s_dim; i++) {
+        s_offset[i] = 2.0f * uniform();
+        for (int w = 0; w < WAVES; w++) {
+            float angle = 2.0f * (float)M_PI * uniform(), k = 0.2f + 1.5f * uniform();
+            s_waves[i * WAVES + w] = (wave_t){
+                .kx = k * cosf(angle),
+                .ky = k * sinf(angle),
+                .phase = 2.0f * (float)M_PI * uniform(),
+                .amplitude = 0.3f * uniform(),
+            };
+        }
+    }
+}
+
+/**
+ * @brief A noisy measurement at a random position in a random room
+ */
+static void measure(int rooms, float *v, csi_fingerprint_ref_t *ref)
+{
+    int room = (int)(uniform() * rooms) % rooms;
+    float x = ROOM_SIZE * uniform(), y = ROOM_SIZE * uniform();
+    for (int d = 0; d < s_dim; d++) {
+        const wave_t *wave = &s_waves[((size_t)room * s_dim + d) * WAVES];
+        float sum = s_offset[room * s_dim + d];
+        for (int w = 0; w < WAVES; w++) {
+            sum += wave[w].amplitude * cosf(wave[w].kx * x + wave[w].ky * y + wave[w].phase);
+        }
+        v[d] = sum + NOISE * gaussian();
+    }
+    *ref = (csi_fingerprint_ref_t){ .x = x, .y = y, .z = 1.0f, .label = (uint32_t)room };
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+int main(int argc, char **argv)
+{
+    long vectors = 200000;
+    int queries = 1000;
+    int dim = 64;
+    int rooms = 50;
+    int lists = 0;
+    int pq_m = 16;
+    int k = 10;
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--vectors") == 0 && val) {
+            vectors = atol(val);
+        } else if (strcmp(argv[i], "--queries") == 0 && val) {
+            queries = atoi(val);
+        } else if (strcmp(argv[i], "--dim") == 0 && val) {
+            dim = atoi(val);
+        } else if (strcmp(argv[i], "--rooms") == 0 && val) {
+            rooms = atoi(val);
+        } else if (strcmp(argv[i], "--lists") == 0 && val) {
+            lists = atoi(val);
+        } else if (strcmp(argv[i], "--pq-m") == 0 && val) {
+            pq_m = atoi(val);
+        } else if (strcmp(argv[i], "-k") == 0 && val) {
+            k = atoi(val);
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--vectors N] [--queries N] [--dim N] [--rooms N] [--lists N] [--pq-m N] [-k N]\n",
+                    argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    // About sqrt(vectors) lists by default, as IVF is usually sized
+    if (lists == 0) {
+        lists = (int)sqrt((double)vectors);
+        lists = lists < 16 ? 16 : lists;
+    }
+    if (vectors < 1000 || vectors > UINT32_MAX || queries <= 0 || dim <= 0 || dim > CSI_FINGERPRINT_MAX_DIM ||
+        rooms <= 0 || pq_m <= 0 || dim % pq_m || k <= 0 || k > MAX_K) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    s_dim = dim;
+    make_rooms(rooms);
+
+    size_t n = (size_t)vectors;
+    float *base = malloc(n * dim * sizeof(float));
+    csi_fingerprint_ref_t *refs = malloc(n * sizeof(*refs));
+    float *query = malloc((size_t)queries * dim * sizeof(float));
+    csi_fingerprint_ref_t *query_ref = malloc((size_t)queries * sizeof(*query_ref));
+    csi_fingerprint_hit_t *truth = malloc((size_t)queries * k * sizeof(*truth));
+    float *dist = malloc(n * sizeof(float));
+    if (!s_waves || !s_offset || !base || !refs || !query || !query_ref || !truth || !dist) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        measure(rooms, base + i * dim, &refs[i]);
+    }
+    for (int q = 0; q < queries; q++) {
+        measure(rooms, query + (size_t)q * dim, &query_ref[q]);
+    }
+
+    // Build as a survey would: batches of measurements, training on the way
+    csi_fingerprint_config_t config = CSI_FINGERPRINT_CONFIG_DEFAULT();
+    config.dim = (uint32_t)dim;
+    config.lists = (uint32_t)lists;
+    config.pq_m = (uint32_t)pq_m;
+    config.train_size = (uint32_t)(n / 4 > 256 * (size_t)lists ? 256 * (size_t)lists : n / 4);
+    csi_fingerprint_t *db = csi_fingerprint_create(&config);
+    if (!db) {
+        fprintf(stderr, "Invalid index settings\n");
+        return 1;
+    }
+    double start = now_s();
+    for (size_t i = 0; i < n; i += ADD_BATCH) {
+        uint32_t count = n - i < ADD_BATCH ? (uint32_t)(n - i) : ADD_BATCH;
+        if (csi_fingerprint_add(db, base + i * dim, refs + i, count) < 0) {
+            fprintf(stderr, "Add failed\n");
+            return 1;
+        }
+    }
+    double build = now_s() - start;
+    csi_fingerprint_info_t info;
+    csi_fingerprint_get_info(db, &info);
+
+    // Exact answers by scanning every vector
+    start = now_s();
+    for (int q = 0; q < queries; q++) {
+        csi_fingerprint_l2_many(query + (size_t)q * dim, base, (uint32_t)n, (uint32_t)dim, dist);
+        csi_fingerprint_hit_t *t = truth + (size_t)q * k;
+        int found = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (found == k && dist[i] >= t[k - 1].distance) {
+                continue;
+            }
+            int j = found < k ? found++ : k - 1;
+            while (j > 0 && t[j - 1].distance > dist[i]) {
+                t[j] = t[j - 1];
+                j--;
+            }
+            t[j] = (csi_fingerprint_hit_t){ .id = (uint32_t)i, .distance = dist[i] };
+        }
+    }
+    double exact = now_s() - start;
+
+    printf("%zu vectors of %d, %d rooms, %d lists, %d bytes per code, trained on %u\n", n, dim, rooms, lists, pq_m,
+           config.train_size);
+    printf("build     %.2f s (%.0f vectors/s with training)\n", build, n / build);
+    printf("memory    %.1f bytes/vector, raw %zu (%.1fx smaller)\n", (double)info.bytes / n,
+           dim * sizeof(float) + sizeof(csi_fingerprint_ref_t),
+           (double)(dim * sizeof(float) + sizeof(csi_fingerprint_ref_t)) * n / info.bytes);
+    printf("exact     %8.0f queries/s\n", queries / exact);
+
+    csi_fingerprint_hit_t hits[MAX_K];
+    float best_recall = 0;
+    for (int probes = 1; probes <= lists && probes <= 64; probes *= 2) {
+        uint64_t matched = 0;
+        double room_hits = 0, error = 0;
+        start = now_s();
+        for (int q = 0; q < queries; q++) {
+            int found = csi_fingerprint_search(db, query + (size_t)q * dim, (uint32_t)probes, (uint32_t)k, hits);
+            const csi_fingerprint_hit_t *t = truth + (size_t)q * k;
+            for (int h = 0; h < found; h++) {
+                for (int j = 0; j < k; j++) {
+                    matched += hits[h].id == t[j].id;
+                }
+            }
+        }
+        double elapsed = now_s() - start;
+        for (int q = 0; q < queries; q++) {
+            csi_fingerprint_ref_t pos;
+            if (csi_fingerprint_locate(db, query + (size_t)q * dim, (uint32_t)probes, (uint32_t)k, &pos)) {
+                room_hits += pos.label == query_ref[q].label;
+                error += hypotf(pos.x - query_ref[q].x, pos.y - query_ref[q].y);
+            }
+        }
+        float recall = (float)matched / ((size_t)queries * k);
+        best_recall = recall > best_recall ? recall : best_recall;
+        printf("probes %2d %8.0f queries/s (%5.1fx exact), recall@%d %.3f, room %.1f%%, mean error %.2f m\n", probes,
+               queries / elapsed, exact / elapsed, k, recall, 100.0 * room_hits / queries, error / queries);
+    }
+
+    // Save, map back and check the answers agree
+    char dir[] = "/tmp/csi_fingerprint_bench_XXXXXX";
+    char path[64];
+    int same = 0;
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/survey.csfp", dir);
+    start = now_s();
+    bool saved = csi_fingerprint_save(db, path);
+    double save = now_s() - start;
+    start = now_s();
+    csi_fingerprint_t *mapped = saved ? csi_fingerprint_open(path) : NULL;
+    double open = now_s() - start;
+    if (mapped) {
+        csi_fingerprint_hit_t other[MAX_K];
+        for (int q = 0; q < queries; q++) {
+            int a = csi_fingerprint_search(db, query + (size_t)q * dim, 8, (uint32_t)k, hits);
+            int b = csi_fingerprint_search(mapped, query + (size_t)q * dim, 8, (uint32_t)k, other);
+            same += a == b && memcmp(hits, other, a * sizeof(*hits)) == 0;
+        }
+        printf("mapped    saved in %.1f ms, opened in %.2f ms, %d/%d queries alike\n", save * 1e3, open * 1e3, same,
+               queries);
+        csi_fingerprint_destroy(mapped);
+    } else {
+        perror("save/open");
+    }
+    nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+
+    csi_fingerprint_destroy(db);
+    free(base);
+    free(refs);
+    free(query);
+    free(query_ref);
+    free(truth);
+    free(dist);
+    free(s_waves);
+    free(s_offset);
+    return same == queries && best_recall >= 0.8f ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/**
+ * @file csi_ingest_bench.c
+ * @brief Throughput of the csi_ingest worker pool
+ *
+ * Pre-encodes a pool of CSI messages the way the firmware does (cJSON
+ * number formatting for csi_data, csi_frame_header_t for csi_frame),
+ * pushes them through csi_ingest_submit() from one thread as fast as the
+ * queues take them and reports decoded frames per second:
+ *
+ *     csi_ingest_bench --nodes 1000 --frames 1000000 --workers 4
+ *
+ * The single submitting thread stands in for the daemon's MQTT reader,
+ * so the figures include queueing but not socket reads. Exits non-zero if
+ * a frame is lost or fails to decode.
+ */
+
+#include "csi_ingest.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define POOL_MESSAGES       1024
+#define MAX_MESSAGE         8192
+#define SUBCARRIERS         64
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} message_t;
+
+static atomic_uint_fast64_t s_sunk_frames;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void count_sink(const csi_ingest_batch_t *batch, void *ctx)
+{
+    (void)ctx;
+    atomic_fetch_add_explicit(&s_sunk_frames, batch->count, memory_order_relaxed);
+}
+
+/**
+ * @brief Print a number as cJSON's print_number() does
+ */
+static int print_number(char *out, double d)
+{
+    int valueint = d >= INT_MAX ? INT_MAX : d <= (double)INT_MIN ? INT_MIN : (int)d;
+    if (isnan(d) || isinf(d)) {
+        return sprintf(out, "null");
+    }
+    if (d == (double)valueint) {
+        return sprintf(out, "%d", valueint);
+    }
+    int len = sprintf(out, "%1.15g", d);
+    double test = strtod(out, NULL);
+    double max = fabs(test) > fabs(d) ? fabs(test) : fabs(d);
+    if (!(fabs(test - d) <= max * DBL_EPSILON)) {
+        len = sprintf(out, "%1.17g", d);
+    }
+    return len;
+}
+
+static size_t encode_json(char *out, uint32_t seq, uint64_t timestamp, const int8_t *raw)
+{
+    char *p = out;
+    p += sprintf(p, "{\"seq\":");
+    p += print_number(p, seq);
+    p += sprintf(p, ",\"timestamp\":");
+    p += print_number(p, (double)timestamp);
+    p += sprintf(p, ",\"mac\":\"24:0A:C4:12:34:56\",\"rssi\":-52,\"channel\":6,"
+                 "\"secondary_channel\":0,\"subcarrier_count\":%d,\"amplitude\":[", SUBCARRIERS);
+    for (int i = 0; i < SUBCARRIERS; i++) {
+        int real = raw[2 * i], imag = raw[2 * i + 1];
+        p += sprintf(p, i ? "," : "");
+        p += print_number(p, sqrtf(real * real + imag * imag));
+    }
+    p += sprintf(p, "],\"phase\":[");
+    for (int i = 0; i < SUBCARRIERS; i++) {
+        p += sprintf(p, i ? "," : "");
+        p += print_number(p, atan2f(raw[2 * i + 1], raw[2 * i]));
+    }
+    p += sprintf(p, "]}");
+    return p - out;
+}
+
+static size_t encode_frame(uint8_t *out, uint32_t seq, uint64_t timestamp, const int8_t *raw)
+{
+    csi_frame_header_t header = {
+        .magic = CSI_FRAME_MAGIC,
+        .version = CSI_FRAME_VERSION,
+        .flags = CSI_FRAME_FLAG_RAW,
+        .sequence = seq,
+        .timestamp = timestamp,
+        .mac = { 0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56 },
+        .rssi = -52,
+        .channel = 6,
+        .subcarrier_count = SUBCARRIERS,
+        .raw_len = 2 * SUBCARRIERS,
+    };
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), raw, 2 * SUBCARRIERS);
+    return sizeof(header) + 2 * SUBCARRIERS;
+}
+
+static void build_pool(message_t *pool, csi_ingest_format_t format)
+{
+    uint32_t rng = 12345;
+    for (int m = 0; m < POOL_MESSAGES; m++) {
+        int8_t raw[2 * SUBCARRIERS];
+        for (int i = 0; i < 2 * SUBCARRIERS; i++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            raw[i] = (int8_t)((int)(rng % 61) - 30);
+        }
+        pool[m].data = malloc(MAX_MESSAGE);
+        uint64_t timestamp = 1000000ULL * (m + 1) + rng % 100000;
+        pool[m].len = format == CSI_INGEST_FORMAT_JSON ? encode_json((char *)pool[m].data, m, timestamp, raw)
+                                                       : encode_frame(pool[m].data, m, timestamp, raw);
+    }
+}
+
+static bool run(const char *label, csi_ingest_format_t format, int nodes, long frames, int workers)
+{
+    static message_t pool[POOL_MESSAGES];
+    build_pool(pool, format);
+
+    char (*names)[24] = malloc(nodes * sizeof(*names));
+    size_t *name_len = malloc(nodes * sizeof(size_t));
+    for (int n = 0; n < nodes; n++) {
+        name_len[n] = snprintf(names[n], sizeof(names[n]), "node-%05d", n);
+    }
+
+    csi_ingest_config_t config = CSI_INGEST_CONFIG_DEFAULT();
+    config.workers = workers;
+    config.max_nodes = nodes;
+    config.sink = count_sink;
+    atomic_store(&s_sunk_frames, 0);
+
+    csi_ingest_t *ingest = csi_ingest_create(&config);
+    if (!ingest) {
+        fprintf(stderr, "Cannot start the pool\n");
+        return false;
+    }
+
+    uint64_t bytes = 0;
+    uint64_t retries = 0;
+    double start = now_s();
+    for (long i = 0; i < frames; i++) {
+        const message_t *msg = &pool[i % POOL_MESSAGES];
+        int node = (int)(i % nodes);
+        while (csi_ingest_submit(ingest, names[node], name_len[node], format, msg->data, msg->len) ==
+               CSI_INGEST_QUEUE_FULL) {
+            retries++;
+            sched_yield();
+        }
+        bytes += msg->len;
+    }
+
+    csi_ingest_stats_t stats;
+    csi_ingest_get_stats(ingest, &stats);
+    csi_ingest_destroy(ingest);
+    double elapsed = now_s() - start;
+
+    uint64_t sunk = atomic_load(&s_sunk_frames);
+    uint64_t decode_errors = stats.decode_errors;
+    printf("%-6s %d nodes, %ld frames in %.2f s: %.0f frames/s, %.1f MB/s, %d workers, "
+           "%llu queue-full retries\n",
+           label, nodes, frames, elapsed, sunk / elapsed, bytes / elapsed / 1e6, workers,
+           (unsigned long long)retries);
+
+    for (int m = 0; m < POOL_MESSAGES; m++) {
+        free(pool[m].data);
+    }
+    free(names);
+    free(name_len);
+
+    if (sunk != (uint64_t)frames || decode_errors) {
+        fprintf(stderr, "%s: %llu of %ld frames reached the sink, %llu decode errors\n", label,
+                (unsigned long long)sunk, frames, (unsigned long long)decode_errors);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int nodes = 1000;
+    long frames = 500000;
+    int workers = 0;
+    const char *format = "both";
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--nodes") == 0 && val) {
+            nodes = atoi(val);
+        } else if (strcmp(argv[i], "--frames") == 0 && val) {
+            frames = atol(val);
+        } else if (strcmp(argv[i], "--workers") == 0 && val) {
+            workers = atoi(val);
+        } else if (strcmp(argv[i], "--format") == 0 && val) {
+            format = val;
+        } else {
+            fprintf(stderr, "Usage: %s [--nodes N] [--frames N] [--workers N] [--format json|binary|both]\n",
+                    argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (nodes <= 0 || frames <= 0 || workers < 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    if (workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+
+    bool ok = true;
+    if (strcmp(format, "json") == 0 || strcmp(format, "both") == 0) {
+        ok &= run("json", CSI_INGEST_FORMAT_JSON, nodes, frames, workers);
+    }
+    if (strcmp(format, "binary") == 0 || strcmp(format, "both") == 0) {
+        ok &= run("binary", CSI_INGEST_FORMAT_FRAME, nodes, frames, workers);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+/**
+ * @file csi_join_bench.c
+ * @brief Throughput and accuracy of the multi-node joiner
+ *
+ * Simulates nodes that all capture one transmitter at a fixed rate, each
+ * with its own uptime clock (booted at a random time, drifting by up to
+ * 20 ppm), its own network delay with random jitter, and some lost
+ * frames. Their batches are pushed into a joiner in order of arrival on
+ * simulated time, as fast as it takes them:
+ *
+ *     csi_join_bench --nodes 50 --rate 200 --seconds 60
+ *
+ * Reports frames per second and how many times real time that is, the
+ * share of sets whose frames all belong to the same transmission, and the
+ * latency of the sets. Exits non-zero if fewer than 99% of the sets are
+ * aligned or more than 1% of the frames are late.
+ */
+
+#include "csi_join.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_NODES       CSI_JOIN_MAX_NODES
+#define MAX_BATCH       64
+#define POLL_US         10000
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ULL;
+
+static double next_uniform(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (s_rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief A simulated node
+ */
+typedef struct {
+    char name[32];
+    double boot_s;                  ///< Node clock reads zero at this true time
+    double drift;                   ///< Relative rate error of the node clock
+    double delay_s;                 ///< Smallest network delay
+    uint64_t next_moment;           ///< First moment of the next batch
+    double arrival_s;               ///< Arrival of the next batch
+    double last_arrival_s;
+    uint32_t count;                 ///< Frames in the next batch
+    uint32_t sequence[MAX_BATCH];
+    uint64_t timestamp[MAX_BATCH];
+} sim_node_t;
+
+static sim_node_t s_nodes[MAX_NODES];
+
+/**
+ * @brief Columns that are the same in every batch
+ */
+static struct {
+    uint8_t mac[MAX_BATCH * 6];
+    int8_t rssi[MAX_BATCH];
+    uint8_t channel[MAX_BATCH];
+    uint8_t secondary_channel[MAX_BATCH];
+    uint8_t subcarrier_count[MAX_BATCH];
+    uint8_t flags[MAX_BATCH];
+    int8_t iq[MAX_BATCH * CSI_INGEST_IQ_STRIDE];
+    float amplitude[MAX_BATCH * CSI_MAX_SUBCARRIERS];
+    float phase[MAX_BATCH * CSI_MAX_SUBCARRIERS];
+} s_batch;
+
+static struct {
+    uint64_t sets;
+    uint64_t aligned;
+    uint64_t rows;
+    double abs_skew_us;
+} s_result;
+
+static void check_set(const csi_join_set_t *set, void *ctx)
+{
+    (void)ctx;
+    uint32_t sequence = 0;
+    bool first = true, aligned = true;
+    for (uint32_t i = 0; i < set->nodes; i++) {
+        if (!set->valid[i]) {
+            continue;
+        }
+        if (first) {
+            sequence = set->sequence[i];
+            first = false;
+        } else if (set->sequence[i] != sequence) {
+            aligned = false;
+        }
+        s_result.abs_skew_us += abs(set->skew_us[i]);
+    }
+    s_result.sets++;
+    s_result.aligned += aligned;
+    s_result.rows += set->present;
+}
+
+/**
+ * @brief True time of moment m, with the transmitter's scheduling jitter
+ */
+static double moment_time(uint64_t m, int rate)
+{
+    // Deterministic per moment so every node sees the same instant
+    uint64_t h = (m + 1) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 31;
+    return 1.0 + (double)m / rate + (double)(h % 200) * 1e-6;
+}
+
+/**
+ * @brief Fill the batch a node delivers next and the time it arrives
+ */
+static void fill_batch(sim_node_t *n, int batch, int rate, double loss)
+{
+    uint32_t count = 0;
+    double last_capture = 0;
+    for (int i = 0; i < batch; i++) {
+        uint64_t m = n->next_moment + i;
+        if (next_uniform() < loss) {
+            continue;
+        }
+        double t = moment_time(m, rate);
+        n->sequence[count] = (uint32_t)m;
+        n->timestamp[count] = (uint64_t)llround((t - n->boot_s) * (1 + n->drift) * 1e6);
+        last_capture = t;
+        count++;
+    }
+    n->next_moment += batch;
+    // Exponential jitter, 2 ms on average
+    double arrival = last_capture + n->delay_s - 0.002 * log(1 - next_uniform());
+    n->arrival_s = arrival > n->last_arrival_s ? arrival : n->last_arrival_s;
+    n->last_arrival_s = n->arrival_s;
+    n->count = count;
+}
+
+int main(int argc, char **argv)
+{
+    int nodes = 50;
+    int rate = 200;
+    double seconds = 60;
+    int batch = 16;
+    double loss = 0.01;
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--nodes") == 0 && val) {
+            nodes = atoi(val);
+        } else if (strcmp(argv[i], "--rate") == 0 && val) {
+            rate = atoi(val);
+        } else if (strcmp(argv[i], "--seconds") == 0 && val) {
+            seconds = atof(val);
+        } else if (strcmp(argv[i], "--batch") == 0 && val) {
+            batch = atoi(val);
+        } else if (strcmp(argv[i], "--loss") == 0 && val) {
+            loss = atof(val);
+        } else {
+            fprintf(stderr, "Usage: %s [--nodes N] [--rate HZ] [--seconds S] [--batch N] [--loss P]\n", argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (nodes < 2 || nodes > MAX_NODES || rate <= 0 || rate > 2000 || seconds <= 0 || batch <= 0 ||
+        batch > MAX_BATCH || loss < 0 || loss >= 1) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    csi_join_config_t config = CSI_JOIN_CONFIG_DEFAULT();
+    config.max_nodes = nodes;
+    // Half the capture period, so neighbouring moments never share a set
+    config.tolerance_us = 500000 / rate;
+    config.output = check_set;
+    csi_join_t *join = csi_join_create(&config);
+    if (!join) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < batch; i++) {
+        memcpy(s_batch.mac + 6 * i, (const uint8_t[]){ 0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56 }, 6);
+        s_batch.rssi[i] = -55;
+        s_batch.channel[i] = 6;
+        s_batch.subcarrier_count[i] = CSI_MAX_SUBCARRIERS;
+        for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+            s_batch.amplitude[i * CSI_MAX_SUBCARRIERS + k] = 20.0f + k % 7;
+            s_batch.phase[i * CSI_MAX_SUBCARRIERS + k] = 0.1f * k;
+        }
+    }
+    for (int n = 0; n < nodes; n++) {
+        sim_node_t *node = &s_nodes[n];
+        snprintf(node->name, sizeof(node->name), "site/node-%03d", n);
+        node->boot_s = -3600 * next_uniform();
+        node->drift = (next_uniform() - 0.5) * 40e-6;
+        node->delay_s = 0.001 + 0.001 * next_uniform();
+    }
+    for (int n = 0; n < nodes; n++) {
+        fill_batch(&s_nodes[n], batch, rate, loss);
+    }
+
+    uint64_t moments = (uint64_t)(seconds * rate);
+    uint64_t pushed = 0;
+    double next_poll = 0;
+    double start = now_s();
+    for (;;) {
+        // Next batch to arrive, over all nodes
+        int next = -1;
+        for (int n = 0; n < nodes; n++) {
+            if (s_nodes[n].next_moment <= moments + batch &&
+                (next < 0 || s_nodes[n].arrival_s < s_nodes[next].arrival_s)) {
+                next = n;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        sim_node_t *node = &s_nodes[next];
+        double arrival = node->arrival_s;
+        while (next_poll < arrival) {
+            csi_join_poll(join, (uint64_t)(next_poll * 1e6));
+            next_poll += POLL_US / 1e6;
+        }
+        if (node->count > 0) {
+            csi_ingest_batch_t b = {
+                .node = node->name,
+                .count = node->count,
+                .sequence = node->sequence,
+                .timestamp = node->timestamp,
+                .mac = s_batch.mac,
+                .rssi = s_batch.rssi,
+                .channel = s_batch.channel,
+                .secondary_channel = s_batch.secondary_channel,
+                .subcarrier_count = s_batch.subcarrier_count,
+                .flags = s_batch.flags,
+                .iq = s_batch.iq,
+                .amplitude = s_batch.amplitude,
+                .phase = s_batch.phase,
+            };
+            csi_join_push(join, &b, (uint64_t)(arrival * 1e6));
+            pushed += node->count;
+        }
+        fill_batch(node, batch, rate, loss);
+    }
+    csi_join_flush(join);
+    double elapsed = now_s() - start;
+
+    csi_join_stats_t stats;
+    csi_join_get_stats(join, &stats);
+    csi_join_destroy(join);
+
+    double fps = pushed / elapsed;
+    printf("%d nodes x %d Hz, %.0f s simulated, %llu frames in %.2f s\n", nodes, rate, seconds,
+           (unsigned long long)pushed, elapsed);
+    printf("join   %.0f frames/s, %.1fx real time\n", fps, fps / ((double)nodes * rate));
+    printf("sets   %llu, %.1f nodes each, %.2f%% aligned, %llu partial, %llu dropped, %llu forced\n",
+           (unsigned long long)s_result.sets, s_result.sets ? (double)s_result.rows / s_result.sets : 0.0,
+           s_result.sets ? 100.0 * s_result.aligned / s_result.sets : 0.0, (unsigned long long)stats.sets_partial,
+           (unsigned long long)stats.sets_dropped, (unsigned long long)stats.sets_forced);
+    printf("frames %llu late (%.3f%%), %llu unjoined, mean skew in a set %.0f us\n",
+           (unsigned long long)stats.frames_late, 100.0 * stats.frames_late / pushed,
+           (unsigned long long)stats.frames_unjoined, s_result.rows ? s_result.abs_skew_us / s_result.rows : 0.0);
+    printf("latency mean %.1f ms, max %.1f ms\n",
+           stats.sets ? stats.latency_us_sum / 1e3 / stats.sets : 0.0, stats.latency_us_max / 1e3);
+
+    bool ok = s_result.sets > 0 && s_result.aligned >= 0.99 * s_result.sets && stats.frames_late <= 0.01 * pushed;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file csi_locate_bench.c
+ * @brief Speed and accuracy of multilateration on synthetic rooms
+ *
+ * Places nodes around the walls of a room, scatters targets inside it and
+ * derives each node's RSSI to each target from the log-distance model
+ * with Gaussian shadowing. Solves all targets from the RSSI, the way the
+ * server would from joined CSI sets:
+ *
+ *     csi_locate_bench --targets 100000 --nodes 8 --shadowing 2
+ *
+ * Reports targets per second, the median and 90th percentile error next
+ * to the weighted centroid of the nodes, and how often the error stays
+ * within the reported two sigma. Exits non-zero if the solver is not
+ * more accurate than the centroid. The default 2 dB is RSSI averaged over
+ * a joined set; from about 3 dB of shadowing on, the range errors swamp
+ * the geometry and the centroid does as well as the solver.
+ */
+
+#include "csi_locate.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_NODES       64
+#define ROOM_X          20.0f
+#define ROOM_Y          15.0f
+#define NODE_HEIGHT     2.5f
+#define TARGET_HEIGHT   1.0f
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t s_rng = 0x2545F4914F6CDD1DULL;
+
+static float uniform(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (s_rng >> 40) * (1.0f / 16777216.0f);
+}
+
+static float gaussian(void)
+{
+    float u = uniform() + 1e-7f, v = uniform();
+    return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+static int compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static float percentile(float *v, size_t n, float p)
+{
+    qsort(v, n, sizeof(*v), compare_float);
+    return v[(size_t)(p * (n - 1))];
+}
+
+int main(int argc, char **argv)
+{
+    long targets = 100000;
+    int nodes = 8;
+    int dims = 2;
+    float shadowing = 2.0f;
+    int repeat = 5;
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--targets") == 0 && val) {
+            targets = atol(val);
+        } else if (strcmp(argv[i], "--nodes") == 0 && val) {
+            nodes = atoi(val);
+        } else if (strcmp(argv[i], "--dims") == 0 && val) {
+            dims = atoi(val);
+        } else if (strcmp(argv[i], "--shadowing") == 0 && val) {
+            shadowing = (float)atof(val);
+        } else if (strcmp(argv[i], "--repeat") == 0 && val) {
+            repeat = atoi(val);
+        } else {
+            fprintf(stderr, "Usage: %s [--targets N] [--nodes N] [--dims 2|3] [--shadowing DB] [--repeat N]\n",
+                    argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (targets <= 0 || nodes < 4 || nodes > MAX_NODES || (dims != 2 && dims != 3) || shadowing < 0 ||
+        repeat <= 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    // Nodes evenly around the walls; alternate heights so 3D is observable
+    float ax[MAX_NODES], ay[MAX_NODES], az[MAX_NODES];
+    float perimeter = 2 * (ROOM_X + ROOM_Y);
+    for (int a = 0; a < nodes; a++) {
+        float s = perimeter * a / nodes;
+        ax[a] = s < ROOM_X ? s : s < ROOM_X + ROOM_Y ? ROOM_X : s < 2 * ROOM_X + ROOM_Y ? 2 * ROOM_X + ROOM_Y - s : 0;
+        ay[a] = s < ROOM_X ? 0 : s < ROOM_X + ROOM_Y ? s - ROOM_X : s < 2 * ROOM_X + ROOM_Y ? ROOM_Y : perimeter - s;
+        az[a] = dims == 3 && a % 2 ? 0.3f : NODE_HEIGHT;
+    }
+
+    size_t n = (size_t)targets;
+    float *true_x = malloc(n * sizeof(float)), *true_y = malloc(n * sizeof(float));
+    float *true_z = malloc(n * sizeof(float));
+    float *rssi = malloc(n * nodes * sizeof(float));
+    float *range = malloc(n * nodes * sizeof(float)), *weight = malloc(n * nodes * sizeof(float));
+    float *x = malloc(n * sizeof(float)), *y = malloc(n * sizeof(float)), *z = malloc(n * sizeof(float));
+    float *sx = malloc(n * sizeof(float)), *sy = malloc(n * sizeof(float));
+    float *error = malloc(n * sizeof(float)), *centroid_error = malloc(n * sizeof(float));
+    if (!true_x || !true_y || !true_z || !rssi || !range || !weight || !x || !y || !z || !sx || !sy || !error ||
+        !centroid_error) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    csi_locate_path_loss_t model = CSI_LOCATE_PATH_LOSS_DEFAULT();
+    model.shadowing_db = shadowing > 0 ? shadowing : 0.1f;
+    for (size_t t = 0; t < n; t++) {
+        true_x[t] = 0.5f + (ROOM_X - 1) * uniform();
+        true_y[t] = 0.5f + (ROOM_Y - 1) * uniform();
+        true_z[t] = dims == 3 ? 0.5f + 1.5f * uniform() : TARGET_HEIGHT;
+    }
+    for (int a = 0; a < nodes; a++) {
+        for (size_t t = 0; t < n; t++) {
+            float dx = true_x[t] - ax[a], dy = true_y[t] - ay[a], dz = true_z[t] - az[a];
+            float d = sqrtf(dx * dx + dy * dy + dz * dz);
+            rssi[a * n + t] = model.rssi_at_1m - 10 * model.exponent * log10f(d) + shadowing * gaussian();
+        }
+    }
+
+    csi_locate_config_t config = CSI_LOCATE_CONFIG_DEFAULT();
+    config.dims = dims;
+    csi_locate_input_t input = {
+        .anchors = (uint32_t)nodes,
+        .anchor_x = ax,
+        .anchor_y = ay,
+        .anchor_z = az,
+        .targets = (uint32_t)n,
+        .range = range,
+        .weight = weight,
+    };
+    csi_locate_output_t output = { .x = x, .y = y, .z = z, .sigma_x = sx, .sigma_y = sy };
+
+    // Timed: RSSI to range and the solve, as a server would run them per batch
+    int converged = 0;
+    double best = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        memcpy(z, true_z, n * sizeof(float));
+        double start = now_s();
+        csi_locate_rssi_to_range(&model, rssi, n * nodes, range, weight);
+        converged = csi_locate_solve(&config, &input, &output);
+        double elapsed = now_s() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    size_t inside = 0;
+    for (size_t t = 0; t < n; t++) {
+        float dx = x[t] - true_x[t], dy = y[t] - true_y[t], dz = z[t] - true_z[t];
+        error[t] = sqrtf(dx * dx + dy * dy + dz * dz);
+        inside += fabsf(dx) < 2 * sx[t] && fabsf(dy) < 2 * sy[t];
+
+        // The old approach: average the node positions, nearer nodes weighing more
+        float cx = 0, cy = 0, cz = 0, sw = 0;
+        for (int a = 0; a < nodes; a++) {
+            float w = 1.0f / (range[a * n + t] * range[a * n + t]);
+            cx += w * ax[a];
+            cy += w * ay[a];
+            cz += w * az[a];
+            sw += w;
+        }
+        dx = cx / sw - true_x[t];
+        dy = cy / sw - true_y[t];
+        dz = dims == 3 ? cz / sw - true_z[t] : 0;
+        centroid_error[t] = sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+
+    float median = percentile(error, n, 0.5f), p90 = percentile(error, n, 0.9f);
+    float centroid_median = percentile(centroid_error, n, 0.5f);
+    float centroid_p90 = percentile(centroid_error, n, 0.9f);
+    printf("%ld targets, %d nodes, %dD, %.1f dB shadowing in a %.0f x %.0f m room\n", targets, nodes, dims,
+           shadowing, ROOM_X, ROOM_Y);
+    printf("solve     %.0f targets/s (%.2f ms per batch), %d converged\n", n / best, best * 1e3, converged);
+    printf("solver    median %.2f m, p90 %.2f m, %.1f%% within 2 sigma\n", median, p90, 100.0 * inside / n);
+    printf("centroid  median %.2f m, p90 %.2f m\n", centroid_median, centroid_p90);
+
+    free(true_x);
+    free(true_y);
+    free(true_z);
+    free(rssi);
+    free(range);
+    free(weight);
+    free(x);
+    free(y);
+    free(z);
+    free(sx);
+    free(sy);
+    free(error);
+    free(centroid_error);
+    return median < centroid_median ? 0 : 1;
+}
@@ -0,0 +1,382 @@
+/**
+ * @file probe_fingerprint_bench.c
+ * @brief Collision rate and cost of the probe request fingerprint
+ *
+ * Fingerprints every probe request of recorded captures (classic pcap,
+ * raw 802.11 or radiotap), or of a synthetic one in which each
+ * transmission is heard by one to three sniffers, some only as a retry:
+ *
+ *     probe_fingerprint_bench --probes 1000000
+ *     probe_fingerprint_bench --pcap lab/mon0.pcap --pcap lab/mon1.pcap
+ *
+ * Reports the distinct transmissions (by the bytes the fingerprint
+ * covers), how many of them share a fingerprint, at 64 bits and cut to
+ * 32 bits next to the birthday expectation, and nanoseconds per probe of
+ * the fingerprint and of the MD5 the sniffers used to compute. Exits
+ * non-zero on a 64-bit collision, or if copies of one synthetic
+ * transmission do not all get the same fingerprint.
+ */
+
+#include "probe_fingerprint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_FRAME       2346
+#define LINKTYPE_80211  105
+#define LINKTYPE_RADIOTAP 127
+
+void md5(const uint8_t *initial_msg, size_t initial_len, uint8_t *digest);
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)(s_rng >> 32);
+}
+
+/**
+ * @brief Probe requests kept for the collision count, frames back to back
+ */
+static struct {
+    uint8_t *bytes;
+    size_t used, size;
+    size_t *offset;                     ///< Of each frame in bytes
+    uint16_t *len;
+    size_t count, cap;
+} s_frames;
+
+static void keep_frame(const uint8_t *frame, size_t len)
+{
+    if (s_frames.used + len > s_frames.size) {
+        s_frames.size = 2 * (s_frames.size + len);
+        s_frames.bytes = realloc(s_frames.bytes, s_frames.size);
+    }
+    if (s_frames.count == s_frames.cap) {
+        s_frames.cap = 2 * s_frames.cap + 1024;
+        s_frames.offset = realloc(s_frames.offset, s_frames.cap * sizeof(*s_frames.offset));
+        s_frames.len = realloc(s_frames.len, s_frames.cap * sizeof(*s_frames.len));
+    }
+    if (!s_frames.bytes || !s_frames.offset || !s_frames.len) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memcpy(s_frames.bytes + s_frames.used, frame, len);
+    s_frames.offset[s_frames.count] = s_frames.used;
+    s_frames.len[s_frames.count++] = (uint16_t)len;
+    s_frames.used += len;
+}
+
+/**
+ * @brief A probe request as the sniffers hand it over: from frame control, without FCS
+ */
+typedef struct {
+    uint64_t fp;
+    size_t frame;                       ///< Index in s_frames
+} entry_t;
+
+static uint64_t s_mask;
+static volatile uint8_t s_sink;         ///< Keeps the MD5 loop
+static const uint8_t s_key[PROBE_FP_KEY_LEN] = PROBE_FP_KEY_DEFAULT;
+
+/**
+ * @brief Order by masked fingerprint, then by the bytes it covers
+ */
+static int compare_entry(const void *a, const void *b)
+{
+    const entry_t *x = a, *y = b;
+    uint64_t fx = x->fp & s_mask, fy = y->fp & s_mask;
+    if (fx != fy) {
+        return fx < fy ? -1 : 1;
+    }
+    probe_fp_canon_t cx = { 0 }, cy = { 0 };
+    probe_fp_canonicalize(s_frames.bytes + s_frames.offset[x->frame], s_frames.len[x->frame], &cx);
+    probe_fp_canonicalize(s_frames.bytes + s_frames.offset[y->frame], s_frames.len[y->frame], &cy);
+    int c = memcmp(cx.sa, cy.sa, 6);
+    c = c ? c : memcmp(cx.seq_ctrl, cy.seq_ctrl, 2);
+    if (c || cx.ies_len != cy.ies_len) {
+        return c ? c : (cx.ies_len < cy.ies_len ? -1 : 1);
+    }
+    return memcmp(cx.ies, cy.ies, cx.ies_len);
+}
+
+/**
+ * @brief Distinct transmissions and how many of them share a masked fingerprint with another
+ */
+static void count_collisions(entry_t *entries, size_t n, uint64_t mask, size_t *distinct, size_t *collisions)
+{
+    s_mask = mask;
+    qsort(entries, n, sizeof(*entries), compare_entry);
+    *distinct = *collisions = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && compare_entry(&entries[i - 1], &entries[i]) == 0) {
+            continue;
+        }
+        ++*distinct;
+        if (i > 0 && (entries[i - 1].fp & mask) == (entries[i].fp & mask)) {
+            ++*collisions;
+        }
+    }
+}
+
+static size_t get_le16(const uint8_t *p)
+{
+    return p[0] | (size_t)p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p, bool swap)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+/**
+ * @brief Length of the radiotap header and whether the frame ends with its FCS
+ */
+static bool parse_radiotap(const uint8_t *p, size_t len, size_t *header, bool *fcs)
+{
+    if (len < 8) {
+        return false;
+    }
+    *header = get_le16(p + 2);
+    *fcs = false;
+    uint32_t present = get_u32(p + 4, false);
+    size_t off = 8;
+    for (uint32_t word = present; word & 0x80000000u; off += 4) {
+        if (off + 4 > len) {
+            return false;
+        }
+        word = get_u32(p + off, false);
+    }
+    if (present & 1) {                  // TSFT, 8-byte aligned
+        off = ((off + 7) & ~(size_t)7) + 8;
+    }
+    if ((present & 2) && off < *header) {
+        *fcs = (p[off] & 0x10) != 0;
+    }
+    return *header <= len;
+}
+
+/**
+ * @brief Keep the probe requests of a classic pcap file
+ */
+static bool read_pcap(const char *path, bool fcs_80211)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t header[24], record[16];
+    static uint8_t frame[65536];
+    bool ok = fread(header, 1, sizeof(header), f) == sizeof(header);
+    uint32_t magic = ok ? get_u32(header, false) : 0;
+    bool swap = magic == 0xd4c3b2a1u || magic == 0x4d3cb2a1u;
+    uint32_t linktype = get_u32(header + 20, swap);
+    if (!ok || (!swap && magic != 0xa1b2c3d4u && magic != 0xa1b23c4du) ||
+        (linktype != LINKTYPE_80211 && linktype != LINKTYPE_RADIOTAP)) {
+        fprintf(stderr, "%s: not a classic pcap of 802.11 or radiotap frames\n", path);
+        fclose(f);
+        return false;
+    }
+    while (fread(record, 1, sizeof(record), f) == sizeof(record)) {
+        size_t len = get_u32(record + 8, swap);
+        if (len > sizeof(frame) || fread(frame, 1, len, f) != len) {
+            fprintf(stderr, "%s: truncated\n", path);
+            break;
+        }
+        size_t skip = 0;
+        bool fcs = fcs_80211;
+        if (linktype == LINKTYPE_RADIOTAP && !parse_radiotap(frame, len, &skip, &fcs)) {
+            continue;
+        }
+        len -= skip;
+        if (fcs) {
+            len = len >= 4 ? len - 4 : 0;
+        }
+        probe_fp_canon_t canon;
+        if (len <= MAX_FRAME && probe_fp_canonicalize(frame + skip, len, &canon)) {
+            keep_frame(frame + skip, len);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/**
+ * @brief A phone: address, next sequence number and the elements of its probe requests
+ */
+typedef struct {
+    uint8_t sa[6];
+    uint16_t seq;
+    uint8_t ies[256];
+    size_t ies_len;
+} device_t;
+
+static void add_ie(device_t *d, uint8_t id, size_t len)
+{
+    d->ies[d->ies_len++] = id;
+    d->ies[d->ies_len++] = (uint8_t)len;
+    for (size_t i = 0; i < len; i++) {
+        d->ies[d->ies_len++] = (uint8_t)next_random();
+    }
+}
+
+static void make_device(device_t *d)
+{
+    for (int i = 0; i < 6; i++) {
+        d->sa[i] = (uint8_t)next_random();
+    }
+    d->sa[0] = (d->sa[0] & 0xfc) | 0x02;    // randomised, locally administered
+    d->seq = next_random() & 0xfff;
+    d->ies_len = 0;
+    // Most phones probe the wildcard SSID; a few name a network
+    add_ie(d, 0, next_random() % 4 == 0 ? 1 + next_random() % 32 : 0);
+    static const uint8_t rates[] = { 0x02, 0x04, 0x0b, 0x16, 0x0c, 0x12, 0x18, 0x24 };
+    d->ies[d->ies_len++] = 1;
+    d->ies[d->ies_len++] = sizeof(rates);
+    memcpy(d->ies + d->ies_len, rates, sizeof(rates));
+    d->ies_len += sizeof(rates);
+    add_ie(d, 50, 4);
+    add_ie(d, 45, 26);
+    add_ie(d, 127, 8);
+    for (uint32_t v = next_random() % 3; v > 0; v--) {
+        add_ie(d, 221, 4 + next_random() % 24);
+    }
+}
+
+/**
+ * @brief Frame of d's next probe request as one sniffer heard it
+ */
+static size_t build_probe(const device_t *d, uint16_t seq, bool retry, uint8_t *frame)
+{
+    memset(frame, 0, PROBE_FP_HDR_LEN);
+    frame[0] = 0x40;
+    frame[1] = retry ? 0x08 : 0x00;
+    frame[2] = (uint8_t)(next_random() % 3);    // duration as each receiver decoded it
+    memset(frame + 4, 0xff, 6);
+    memcpy(frame + 10, d->sa, 6);
+    memset(frame + 16, 0xff, 6);
+    frame[22] = (uint8_t)(seq << 4);
+    frame[23] = (uint8_t)(seq >> 4);
+    memcpy(frame + PROBE_FP_HDR_LEN, d->ies, d->ies_len);
+    return PROBE_FP_HDR_LEN + d->ies_len;
+}
+
+/**
+ * @brief Capture of devices probing in bursts, each transmission heard by 1-3 sniffers
+ *
+ * @return Transmissions whose copies got different fingerprints
+ */
+static size_t synthesise(size_t probes)
+{
+    size_t devices = probes / 64 + 1, mismatched = 0;
+    device_t *device = malloc(devices * sizeof(*device));
+    uint8_t frame[PROBE_FP_HDR_LEN + 256];
+    for (size_t i = 0; i < devices; i++) {
+        make_device(&device[i]);
+    }
+    while (s_frames.count < probes) {
+        device_t *d = &device[next_random() % devices];
+        // A new random address every few bursts, as phones do
+        if (next_random() % 8 == 0) {
+            make_device(d);
+        }
+        for (int burst = 1 + next_random() % 4; burst > 0; burst--) {
+            uint16_t seq = d->seq;
+            d->seq = (d->seq + 1) & 0xfff;
+            uint64_t fp = 0;
+            for (int heard = 1 + next_random() % 3; heard > 0; heard--) {
+                size_t len = build_probe(d, seq, next_random() % 5 == 0, frame);
+                uint64_t copy = probe_fingerprint(s_key, frame, len);
+                mismatched += fp != 0 && copy != fp;
+                fp = copy;
+                keep_frame(frame, len);
+            }
+        }
+    }
+    free(device);
+    return mismatched;
+}
+
+int main(int argc, char **argv)
+{
+    size_t probes = 200000;
+    bool fcs = false, synthetic = true, ok = true;
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--probes") == 0 && val) {
+            probes = (size_t)atol(val);
+            i++;
+        } else if (strcmp(argv[i], "--pcap") == 0 && val) {
+            ok = read_pcap(val, fcs) && ok;
+            synthetic = false;
+            i++;
+        } else if (strcmp(argv[i], "--fcs") == 0) {
+            fcs = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--probes N | [--fcs] --pcap FILE ...]\n"
+                            "  --fcs: raw 802.11 frames of the following files end with their FCS\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!ok || (synthetic && probes == 0)) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    size_t mismatched = synthetic ? synthesise(probes) : 0;
+    size_t n = s_frames.count;
+    if (n == 0) {
+        fprintf(stderr, "No probe requests\n");
+        return 1;
+    }
+
+    entry_t *entries = malloc(n * sizeof(*entries));
+    uint8_t digest[16];
+    double start = now_s();
+    for (size_t i = 0; i < n; i++) {
+        entries[i].fp = probe_fingerprint(s_key, s_frames.bytes + s_frames.offset[i], s_frames.len[i]);
+        entries[i].frame = i;
+    }
+    double fp_ns = (now_s() - start) / n * 1e9;
+    start = now_s();
+    for (size_t i = 0; i < n; i++) {
+        md5(s_frames.bytes + s_frames.offset[i], s_frames.len[i], digest);
+        s_sink ^= digest[0];
+    }
+    double md5_ns = (now_s() - start) / n * 1e9;
+
+    size_t distinct, collisions64, collisions32;
+    count_collisions(entries, n, ~0ULL, &distinct, &collisions64);
+    count_collisions(entries, n, 0xffffffffULL, &distinct, &collisions32);
+    double expected32 = (double)distinct * (distinct - 1) / 2 / 4294967296.0;
+
+    printf("%zu probe requests, %zu distinct transmissions, %.1f bytes each\n", n, distinct,
+           (double)s_frames.used / n);
+    printf("collisions     64-bit %zu, 32-bit %zu (birthday expectation %.2f)\n", collisions64, collisions32,
+           expected32);
+    printf("ns per probe   fingerprint %.1f, md5 %.1f (%.1fx)\n", fp_ns, md5_ns, md5_ns / fp_ns);
+    if (synthetic) {
+        printf("copies of one transmission with different fingerprints: %zu\n", mismatched);
+    }
+
+    free(entries);
+    free(s_frames.bytes);
+    free(s_frames.offset);
+    free(s_frames.len);
+    return collisions64 == 0 && mismatched == 0 ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+/**
+ * @file csi_archive.h
+ * @brief Columnar, memory-mappable archive of CSI frames
+ *
+ * An archive is a directory with one subdirectory per node, holding
+ * segments that each cover one time partition (an hour by default):
+ *
+ *     <dir>/<node>/<partition start in us>.csia
+ *     <dir>/<node>/<partition start in us>-<n>.csia   (later segments of a partition)
+ *
+ * A segment is a header, a run of row groups and a footer index:
+ *
+ *     [segment header][group][group]...[group offsets][footer]
+ *
+ * A group holds up to group_rows consecutive frames. It starts with a
+ * descriptor (row count, time range, where each column chunk is and how it
+ * is encoded), followed by one chunk per column. Every column has a fixed
+ * stride, so row i of a column is at i * csi_archive_column_stride(). A
+ * chunk is stored as is when encoding does not make it smaller; those
+ * chunks are read straight from the mapping without a copy. Timestamps
+ * never go backwards within a segment, so a time range is found by binary
+ * search.
+ *
+ * A segment whose writer died before writing the footer is still
+ * readable: the reader then finds the groups by walking the descriptors
+ * from the start, and loses only the group that was being written.
+ *
+ * All integers are little-endian.
+ */
+
+#ifndef CSI_ARCHIVE_H
+#define CSI_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "csi_ingest.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_ARCHIVE_VERSION             1
+#define CSI_ARCHIVE_SUFFIX              ".csia"
+
+/**
+ * @brief Fixed-point scales of the amplitude and phase columns
+ *
+ * Stored value = round(value * scale). The largest amplitude of 8-bit CSI
+ * is 181 and phase lies in [-pi, pi], so both fit int16 with room to spare.
+ */
+#define CSI_ARCHIVE_AMPLITUDE_SCALE     128.0f
+#define CSI_ARCHIVE_PHASE_SCALE         8192.0f
+
+/**
+ * @brief Stored in place of a missing value (JSON null)
+ */
+#define CSI_ARCHIVE_INT16_NAN           INT16_MIN
+
+/**
+ * @brief Columns of a segment
+ */
+typedef enum {
+    CSI_ARCHIVE_COL_TIMESTAMP = 0,      ///< uint64_t, microseconds
+    CSI_ARCHIVE_COL_SEQUENCE,           ///< uint32_t
+    CSI_ARCHIVE_COL_RSSI,               ///< int8_t
+    CSI_ARCHIVE_COL_CHANNEL,            ///< uint8_t
+    CSI_ARCHIVE_COL_SECONDARY_CHANNEL,  ///< uint8_t
+    CSI_ARCHIVE_COL_SUBCARRIER_COUNT,   ///< uint8_t
+    CSI_ARCHIVE_COL_FLAGS,              ///< uint8_t, CSI_FRAME_FLAG_* bits
+    CSI_ARCHIVE_COL_MAC,                ///< uint8_t[6]
+    CSI_ARCHIVE_COL_IQ,                 ///< int8_t[CSI_INGEST_IQ_STRIDE], valid with CSI_FRAME_FLAG_RAW
+    CSI_ARCHIVE_COL_AMPLITUDE,          ///< int16_t[CSI_MAX_SUBCARRIERS], CSI_ARCHIVE_AMPLITUDE_SCALE
+    CSI_ARCHIVE_COL_PHASE,              ///< int16_t[CSI_MAX_SUBCARRIERS], CSI_ARCHIVE_PHASE_SCALE
+    CSI_ARCHIVE_COLUMNS
+} csi_archive_column_t;
+
+/**
+ * @brief Chunk encodings
+ */
+typedef enum {
+    CSI_ARCHIVE_CODEC_RAW = 0,          ///< Stored as is, readable in place
+    CSI_ARCHIVE_CODEC_CONST,            ///< One row, repeated for every row of the group
+    CSI_ARCHIVE_CODEC_DELTA,            ///< Difference to the previous row, zigzag varints
+} csi_archive_codec_t;
+
+/**
+ * @brief Writer settings
+ */
+typedef struct {
+    uint32_t group_rows;                ///< Frames per group
+    bool compress;                      ///< Try CONST and DELTA; false stores every chunk raw
+} csi_archive_writer_config_t;
+
+#define CSI_ARCHIVE_WRITER_CONFIG_DEFAULT() { \
+    .group_rows = 1024,                     \
+    .compress = true,                       \
+}
+
+typedef struct csi_archive_writer csi_archive_writer_t;
+
+/**
+ * @brief Create a segment
+ * @param path File to create; fails if it exists
+ * @param node Node name stored in the header
+ * @param config Settings, or NULL for the defaults
+ * @return Writer, or NULL with errno set
+ */
+csi_archive_writer_t *csi_archive_writer_create(const char *path, const char *node,
+                                                const csi_archive_writer_config_t *config);
+
+/**
+ * @brief Append frames
+ *
+ * Amplitude and phase are stored in fixed point. Timestamps must not go
+ * backwards (see csi_archive_writer_accepts()).
+ *
+ * @param writer Writer
+ * @param batch Frames; batch->node is ignored
+ * @param first First row of batch to append
+ * @param count Rows to append
+ * @return false on a write error (errno set) or a timestamp going backwards (EINVAL)
+ */
+bool csi_archive_writer_append(csi_archive_writer_t *writer, const csi_ingest_batch_t *batch,
+                               uint32_t first, uint32_t count);
+
+/**
+ * @brief Check if a frame may follow the frames written so far
+ * @param writer Writer
+ * @param timestamp Frame timestamp
+ * @param flags Frame flags; a segment holds UTC or uptime timestamps, not both
+ * @return true if the frame can be appended
+ */
+bool csi_archive_writer_accepts(const csi_archive_writer_t *writer, uint64_t timestamp, uint8_t flags);
+
+/**
+ * @brief Rows appended so far
+ */
+uint64_t csi_archive_writer_rows(const csi_archive_writer_t *writer);
+
+/**
+ * @brief Write the last group and the footer and close the file
+ * @param writer Writer, freed
+ * @return false on a write error
+ */
+bool csi_archive_writer_close(csi_archive_writer_t *writer);
+
+/**
+ * @brief Time range and size of a group
+ */
+typedef struct {
+    uint32_t rows;
+    uint64_t first_row;                 ///< Row number of the group's first row in the segment
+    uint64_t first_timestamp;
+    uint64_t last_timestamp;
+    uint64_t stored_bytes;              ///< Group size on disk
+    uint8_t codec[CSI_ARCHIVE_COLUMNS]; ///< csi_archive_codec_t of each chunk
+    uint32_t chunk_bytes[CSI_ARCHIVE_COLUMNS];  ///< Stored size of each chunk
+} csi_archive_group_t;
+
+/**
+ * @brief Summary of a segment
+ */
+typedef struct {
+    char node[CSI_INGEST_MAX_NODE_LEN + 1];
+    bool utc;                           ///< Timestamps are UTC, not uptime
+    bool recovered;                     ///< No footer; groups were found by scanning
+    uint32_t groups;
+    uint64_t rows;
+    uint64_t first_timestamp;
+    uint64_t last_timestamp;
+    uint64_t file_bytes;
+} csi_archive_info_t;
+
+typedef struct csi_archive_reader csi_archive_reader_t;
+
+/**
+ * @brief Map a segment
+ * @param path Segment file
+ * @return Reader, or NULL with errno set (EINVAL for a file that is not a segment)
+ */
+csi_archive_reader_t *csi_archive_reader_open(const char *path);
+
+/**
+ * @brief Segment summary
+ */
+const csi_archive_info_t *csi_archive_reader_info(const csi_archive_reader_t *reader);
+
+/**
+ * @brief Describe one group
+ * @return false if group is out of range
+ */
+bool csi_archive_reader_group(const csi_archive_reader_t *reader, uint32_t group, csi_archive_group_t *out);
+
+/**
+ * @brief Bytes csi_archive_reader_column() may need as scratch for a group
+ */
+size_t csi_archive_reader_column_bytes(const csi_archive_reader_t *reader, uint32_t group,
+                                       csi_archive_column_t column);
+
+/**
+ * @brief Access one column of a group
+ *
+ * A raw chunk is returned in place: the pointer is into the mapping and
+ * valid until the reader is closed. Other chunks are decoded into scratch.
+ *
+ * @param reader Reader
+ * @param group Group index
+ * @param column Column
+ * @param scratch At least csi_archive_reader_column_bytes() bytes, 8-byte
+ *                aligned; may be NULL if only raw chunks are read
+ * @return Rows of the column, or NULL if the chunk is corrupt or needs scratch
+ */
+const void *csi_archive_reader_column(const csi_archive_reader_t *reader, uint32_t group,
+                                      csi_archive_column_t column, void *scratch);
+
+/**
+ * @brief Find the first frame at or after a time
+ * @param reader Reader
+ * @param timestamp Time in microseconds
+ * @param group Group of the frame
+ * @param row Row of the frame within the group
+ * @return false if every frame is earlier
+ */
+bool csi_archive_reader_seek(const csi_archive_reader_t *reader, uint64_t timestamp,
+                             uint32_t *group, uint32_t *row);
+
+/**
+ * @brief Unmap a segment
+ */
+void csi_archive_reader_close(csi_archive_reader_t *reader);
+
+/**
+ * @brief Bytes per row of a column
+ */
+size_t csi_archive_column_stride(csi_archive_column_t column);
+
+/**
+ * @brief Column name ("timestamp", "iq", ...)
+ */
+const char *csi_archive_column_name(csi_archive_column_t column);
+
+/**
+ * @brief Convert a fixed-point column to float; CSI_ARCHIVE_INT16_NAN becomes NaN
+ * @param in Values
+ * @param n Number of values
+ * @param scale CSI_ARCHIVE_AMPLITUDE_SCALE or CSI_ARCHIVE_PHASE_SCALE
+ * @param out n floats
+ */
+void csi_archive_to_float(const int16_t *in, size_t n, float scale, float *out);
+
+/**
+ * @brief Store settings
+ */
+typedef struct {
+    const char *dir;                    ///< Archive directory, created if missing
+    uint64_t partition_us;              ///< Time covered by a segment
+    uint32_t max_open;                  ///< Segments open at once; the least recently used is closed
+    csi_archive_writer_config_t writer;
+} csi_archive_store_config_t;
+
+#define CSI_ARCHIVE_STORE_CONFIG_DEFAULT() {            \
+    .dir = NULL,                                        \
+    .partition_us = 3600ULL * 1000000,                  \
+    .max_open = 256,                                    \
+    .writer = CSI_ARCHIVE_WRITER_CONFIG_DEFAULT(),      \
+}
+
+/**
+ * @brief Store counters
+ */
+typedef struct {
+    uint64_t rows;                      ///< Frames written
+    uint64_t segments;                  ///< Segments created
+    uint64_t write_errors;              ///< Frames lost to write errors
+    uint32_t open_segments;
+} csi_archive_store_stats_t;
+
+typedef struct csi_archive_store csi_archive_store_t;
+
+/**
+ * @brief Open an archive directory for writing
+ * @param config Settings; dir is required, zero fields take the defaults
+ * @return Store, or NULL with errno set
+ */
+csi_archive_store_t *csi_archive_store_open(const csi_archive_store_config_t *config);
+
+/**
+ * @brief Append a batch to the node's segment of each frame's partition
+ *
+ * Thread safe for different nodes; frames of one node must come from one
+ * thread at a time, as csi_ingest delivers them. A timestamp going
+ * backwards (a node restart) starts a new segment.
+ *
+ * @return false if frames were lost to a write error
+ */
+bool csi_archive_store_append(csi_archive_store_t *store, const csi_ingest_batch_t *batch);
+
+/**
+ * @brief csi_ingest sink writing to a store; ctx is the store
+ */
+void csi_archive_store_sink(const csi_ingest_batch_t *batch, void *ctx);
+
+/**
+ * @brief Read the counters
+ */
+void csi_archive_store_get_stats(csi_archive_store_t *store, csi_archive_store_stats_t *stats);
+
+/**
+ * @brief Close every open segment
+ * @param store Store, freed
+ * @return false if a segment could not be completed
+ */
+bool csi_archive_store_close(csi_archive_store_t *store);
+
+/**
+ * @brief Directory name of a node: characters outside [A-Za-z0-9_-] and a
+ *        leading '.' become %XX
+ * @param node Node name
+ * @param out Buffer of at least 3 * CSI_INGEST_MAX_NODE_LEN + 1 bytes
+ */
+void csi_archive_node_dir(const char *node, char *out);
+
+/**
+ * @brief Converter input formats
+ */
+typedef enum {
+    CSI_ARCHIVE_INPUT_AUTO = 0,         ///< Detect from the first line
+    CSI_ARCHIVE_INPUT_CSV,              ///< ESP32-CSI-Tool "CSI_DATA,..." lines
+    CSI_ARCHIVE_INPUT_JSON,             ///< csi_data JSON, one message per line
+} csi_archive_input_t;
+
+/**
+ * @brief Converter counters
+ */
+typedef struct {
+    uint64_t lines;
+    uint64_t frames;                    ///< Decoded and handed to the store
+    uint64_t skipped;                   ///< Lines that hold no frame
+} csi_archive_convert_stats_t;
+
+/**
+ * @brief Convert a recording into an archive
+ *
+ * CSV lines carry the raw CSI, which is archived as iq together with the
+ * amplitude and phase the firmware would compute from it; the 32-bit
+ * local_timestamp is unwrapped and lines are numbered for the sequence.
+ * JSON lines may be prefixed with their topic as "mosquitto_sub -v"
+ * prints them, which then names the node.
+ *
+ * @param input Recording
+ * @param format Input format
+ * @param node Node name for lines without a topic
+ * @param store Destination
+ * @param stats Counters, may be NULL
+ * @return false on a read or write error
+ */
+bool csi_archive_convert(FILE *input, csi_archive_input_t format, const char *node,
+                         csi_archive_store_t *store, csi_archive_convert_stats_t *stats);
+
+#define CSI_ARCHIVE_CSV_MAX_WORKERS 64
+
+/**
+ * @brief Settings of the parallel CSV converter
+ */
+typedef struct {
+    int workers;                        ///< Parser threads (1-CSI_ARCHIVE_CSV_MAX_WORKERS); 0 for one per CPU
+    size_t chunk_bytes;                 ///< File bytes a parser takes at a time
+} csi_archive_csv_config_t;
+
+#define CSI_ARCHIVE_CSV_CONFIG_DEFAULT() {  \
+    .workers = 0,                           \
+    .chunk_bytes = 4 * 1024 * 1024,         \
+}
+
+/**
+ * @brief Convert a recording file, in parallel when it is CSV
+ *
+ * A regular file read as CSV, or as auto with no JSON in it, is mapped
+ * and split into chunks of whole lines that parser threads decode into
+ * columns, scanning for fields with SIMD and parsing the CSI values
+ * without branches. Chunks are appended to the store in file order, so
+ * the archive is byte for byte the one csi_archive_convert() writes.
+ * Anything else is read with csi_archive_convert().
+ *
+ * @param path Recording
+ * @param format Input format
+ * @param node Node name for lines without a topic
+ * @param config Parser settings, may be NULL; zero fields take the defaults
+ * @param store Destination, or NULL to only parse and count CSV
+ * @param stats Counters, may be NULL
+ * @return false with errno set if the file cannot be read, or on a write error
+ */
+bool csi_archive_convert_file(const char *path, csi_archive_input_t format, const char *node,
+                              const csi_archive_csv_config_t *config, csi_archive_store_t *store,
+                              csi_archive_convert_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_ARCHIVE_H
@@ -0,0 +1,258 @@
+/**
+ * @file csi_archive_codec.c
+ * @brief Chunk encodings of the CSI archive
+ *
+ * DELTA stores each element as the difference to the same element of the
+ * previous row, wrapped to the element width, as a zigzag LEB128 varint.
+ * Consecutive frames of a node differ little in everything but IQ, so
+ * timestamps take two or three bytes, sequence numbers one, and slowly
+ * varying amplitude and phase one or two.
+ */
+
+#include "csi_archive_format.h"
+
+#include <string.h>
+
+const column_shape_t g_column_shape[CSI_ARCHIVE_COLUMNS] = {
+    [CSI_ARCHIVE_COL_TIMESTAMP] = { 8, 1 },
+    [CSI_ARCHIVE_COL_SEQUENCE] = { 4, 1 },
+    [CSI_ARCHIVE_COL_RSSI] = { 1, 1 },
+    [CSI_ARCHIVE_COL_CHANNEL] = { 1, 1 },
+    [CSI_ARCHIVE_COL_SECONDARY_CHANNEL] = { 1, 1 },
+    [CSI_ARCHIVE_COL_SUBCARRIER_COUNT] = { 1, 1 },
+    [CSI_ARCHIVE_COL_FLAGS] = { 1, 1 },
+    [CSI_ARCHIVE_COL_MAC] = { 1, 6 },
+    [CSI_ARCHIVE_COL_IQ] = { 1, CSI_INGEST_IQ_STRIDE },
+    [CSI_ARCHIVE_COL_AMPLITUDE] = { 2, CSI_MAX_SUBCARRIERS },
+    [CSI_ARCHIVE_COL_PHASE] = { 2, CSI_MAX_SUBCARRIERS },
+};
+
+#define VARINT_MAX_BYTES    10
+
+uint32_t archive_crc32(const void *data, size_t len)
+{
+    // Bitwise: only descriptors and group offsets are checked
+    const uint8_t *p = data;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static inline size_t put_varint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/**
+ * @brief Read a varint
+ * @return Bytes consumed, 0 if truncated or too long
+ */
+static inline size_t get_varint(const uint8_t *in, size_t len, uint64_t *v)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < len && i < VARINT_MAX_BYTES; i++) {
+        result |= (uint64_t)(in[i] & 0x7f) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *v = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static inline uint64_t zigzag(int64_t s)
+{
+    return ((uint64_t)s << 1) ^ (uint64_t)(s >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t z)
+{
+    return (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+}
+
+/**
+ * @brief Delta encoder and decoder for one element width
+ *
+ * The encoder gives up and returns SIZE_MAX as soon as the output would
+ * reach limit, since the chunk is then stored raw anyway.
+ */
+#define DELTA_CODEC(BITS)                                                                       \
+static size_t delta_encode_##BITS(const uint8_t *data, uint32_t rows, uint32_t per_row,        \
+                                  uint8_t *out, size_t limit)                                   \
+{                                                                                               \
+    const uint##BITS##_t *in = (const uint##BITS##_t *)data;                                    \
+    size_t n = 0;                                                                               \
+    for (uint32_t k = 0; k < per_row; k++) {                                                    \
+        n += put_varint(out + n, zigzag((int##BITS##_t)in[k]));                                 \
+    }                                                                                           \
+    for (size_t i = per_row; i < (size_t)rows * per_row; i++) {                                 \
+        if (n + VARINT_MAX_BYTES > limit) {                                                     \
+            return SIZE_MAX;                                                                    \
+        }                                                                                       \
+        int##BITS##_t d = (int##BITS##_t)(uint##BITS##_t)(in[i] - in[i - per_row]);             \
+        n += put_varint(out + n, zigzag(d));                                                    \
+    }                                                                                           \
+    return n;                                                                                   \
+}                                                                                               \
+                                                                                                \
+static bool delta_decode_##BITS(const uint8_t *in, size_t len, uint32_t rows, uint32_t per_row,\
+                                uint8_t *data)                                                  \
+{                                                                                               \
+    uint##BITS##_t *out = (uint##BITS##_t *)data;                                               \
+    size_t pos = 0;                                                                             \
+    for (size_t i = 0; i < (size_t)rows * per_row; i++) {                                       \
+        uint64_t z;                                                                             \
+        size_t used = get_varint(in + pos, len - pos, &z);                                      \
+        if (!used) {                                                                            \
+            return false;                                                                       \
+        }                                                                                       \
+        pos += used;                                                                            \
+        uint##BITS##_t prev = i >= per_row ? out[i - per_row] : 0;                              \
+        out[i] = (uint##BITS##_t)(prev + (uint##BITS##_t)unzigzag(z));                          \
+    }                                                                                           \
+    return pos == len;                                                                          \
+}
+
+DELTA_CODEC(8)
+DELTA_CODEC(16)
+DELTA_CODEC(32)
+DELTA_CODEC(64)
+
+size_t archive_encode(csi_archive_column_t column, uint32_t rows, const uint8_t *data,
+                      uint8_t *out, bool allow_compression, csi_archive_codec_t *codec)
+{
+    const column_shape_t shape = g_column_shape[column];
+    size_t stride = (size_t)shape.width * shape.per_row;
+    size_t raw = rows * stride;
+
+    if (allow_compression && rows > 1) {
+        if (memcmp(data + stride, data, raw - stride) == 0) {
+            memcpy(out, data, stride);
+            *codec = CSI_ARCHIVE_CODEC_CONST;
+            return stride;
+        }
+
+        size_t n;
+        switch (shape.width) {
+            case 1:
+                n = delta_encode_8(data, rows, shape.per_row, out, raw);
+                break;
+            case 2:
+                n = delta_encode_16(data, rows, shape.per_row, out, raw);
+                break;
+            case 4:
+                n = delta_encode_32(data, rows, shape.per_row, out, raw);
+                break;
+            default:
+                n = delta_encode_64(data, rows, shape.per_row, out, raw);
+                break;
+        }
+        if (n < raw) {
+            *codec = CSI_ARCHIVE_CODEC_DELTA;
+            return n;
+        }
+    }
+
+    memcpy(out, data, raw);
+    *codec = CSI_ARCHIVE_CODEC_RAW;
+    return raw;
+}
+
+bool archive_decode(csi_archive_column_t column, uint32_t rows, csi_archive_codec_t codec,
+                    const uint8_t *in, size_t len, uint8_t *out)
+{
+    const column_shape_t shape = g_column_shape[column];
+    size_t stride = (size_t)shape.width * shape.per_row;
+
+    switch (codec) {
+        case CSI_ARCHIVE_CODEC_RAW:
+            if (len != rows * stride) {
+                return false;
+            }
+            memcpy(out, in, len);
+            return true;
+        case CSI_ARCHIVE_CODEC_CONST:
+            if (len != stride) {
+                return false;
+            }
+            for (uint32_t r = 0; r < rows; r++) {
+                memcpy(out + r * stride, in, stride);
+            }
+            return true;
+        case CSI_ARCHIVE_CODEC_DELTA:
+            switch (shape.width) {
+                case 1:
+                    return delta_decode_8(in, len, rows, shape.per_row, out);
+                case 2:
+                    return delta_decode_16(in, len, rows, shape.per_row, out);
+                case 4:
+                    return delta_decode_32(in, len, rows, shape.per_row, out);
+                default:
+                    return delta_decode_64(in, len, rows, shape.per_row, out);
+            }
+        default:
+            return false;
+    }
+}
+
+int64_t archive_seek_timestamp(uint32_t rows, csi_archive_codec_t codec, const uint8_t *in,
+                               size_t len, uint64_t timestamp)
+{
+    switch (codec) {
+        case CSI_ARCHIVE_CODEC_RAW: {
+            if (len != rows * sizeof(uint64_t)) {
+                return -1;
+            }
+            const uint64_t *ts = (const uint64_t *)in;
+            uint32_t lo = 0, hi = rows;
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (ts[mid] < timestamp) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+        case CSI_ARCHIVE_CODEC_CONST: {
+            uint64_t ts;
+            if (len != sizeof(ts)) {
+                return -1;
+            }
+            memcpy(&ts, in, sizeof(ts));
+            return ts >= timestamp ? 0 : rows;
+        }
+        case CSI_ARCHIVE_CODEC_DELTA: {
+            // Walk the deltas instead of decoding the chunk into a buffer
+            uint64_t ts = 0;
+            size_t pos = 0;
+            for (uint32_t r = 0; r < rows; r++) {
+                uint64_t z;
+                size_t used = get_varint(in + pos, len - pos, &z);
+                if (!used) {
+                    return -1;
+                }
+                pos += used;
+                ts += (uint64_t)unzigzag(z);
+                if (ts >= timestamp) {
+                    return r;
+                }
+            }
+            return rows;
+        }
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,153 @@
+/**
+ * @file csi_archive_convert.c
+ * @brief Conversion of ESP32-CSI-Tool CSV and firmware JSON recordings
+ *
+ * Both go through csi_ingest, so a converted recording holds exactly the
+ * numbers the ingest daemon would have archived live: CSV lines become
+ * binary frames with raw CSI, JSON lines are decoded as received.
+ */
+
+#include "csi_archive.h"
+#include "csi_archive_csv.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    csi_archive_store_t *store;
+    atomic_uint_fast64_t frames;
+} convert_sink_t;
+
+typedef struct {
+    csi_archive_csv_clock_t clock;
+    uint8_t frame[CSI_ARCHIVE_CSV_FRAME_BYTES];
+} csv_state_t;
+
+static void convert_sink(const csi_ingest_batch_t *batch, void *ctx)
+{
+    convert_sink_t *sink = ctx;
+    csi_archive_store_append(sink->store, batch);
+    atomic_fetch_add(&sink->frames, batch->count);
+}
+
+static bool submit(csi_ingest_t *ingest, const char *node, size_t node_len, csi_ingest_format_t format,
+                   const uint8_t *payload, size_t len)
+{
+    csi_ingest_result_t result;
+    while ((result = csi_ingest_submit(ingest, node, node_len, format, payload, len)) == CSI_INGEST_QUEUE_FULL) {
+        sched_yield();
+    }
+    return result == CSI_INGEST_QUEUED;
+}
+
+/**
+ * @brief Turn an ESP32-CSI-Tool "CSI_DATA,..." line into a stamped binary frame
+ * @return Frame length, 0 if the line holds no complete report
+ */
+static size_t csv_to_frame(csv_state_t *state, char *line)
+{
+    size_t len = csi_archive_csv_parse(line, state->frame);
+    if (len) {
+        csi_frame_header_t header;
+        memcpy(&header, state->frame, sizeof(header));
+        csi_archive_csv_stamp(&state->clock, &header);
+        memcpy(state->frame, &header, sizeof(header));
+    }
+    return len;
+}
+
+bool csi_archive_convert(FILE *input, csi_archive_input_t format, const char *node,
+                         csi_archive_store_t *store, csi_archive_convert_stats_t *stats)
+{
+    csi_archive_convert_stats_t local = {0};
+    csi_archive_store_stats_t before;
+    csi_archive_store_get_stats(store, &before);
+
+    // One worker keeps the frames of a node in file order
+    convert_sink_t sink = { .store = store };
+    csi_ingest_config_t config = CSI_INGEST_CONFIG_DEFAULT();
+    config.workers = 1;
+    config.batch_frames = 1024;
+    config.node_idle_ms = UINT32_MAX;
+    config.sink = convert_sink;
+    config.sink_ctx = &sink;
+    csi_ingest_t *ingest = csi_ingest_create(&config);
+    if (!ingest) {
+        return false;
+    }
+
+    csv_state_t *csv = calloc(1, sizeof(*csv));
+    if (!csv) {
+        csi_ingest_destroy(ingest);
+        return false;
+    }
+    size_t node_len = strlen(node);
+    uint64_t submitted = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &cap, input)) >= 0) {
+        local.lines++;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        if (format != CSI_ARCHIVE_INPUT_JSON && strncmp(line, "CSI_DATA,", 9) == 0) {
+            size_t frame_len = csv_to_frame(csv, line);
+            if (frame_len && submit(ingest, node, node_len, CSI_INGEST_FORMAT_FRAME, csv->frame, frame_len)) {
+                submitted++;
+                continue;
+            }
+        } else if (format != CSI_ARCHIVE_INPUT_CSV) {
+            // "{...}" or "<topic> {...}"
+            const char *payload = line;
+            const char *name = node;
+            size_t name_len = node_len;
+            csi_ingest_format_t topic_format = CSI_INGEST_FORMAT_JSON;
+            if (*line != '{') {
+                char *space = strchr(line, ' ');
+                if (space && csi_ingest_parse_topic(line, space - line, &name_len, &topic_format) &&
+                    topic_format == CSI_INGEST_FORMAT_JSON) {
+                    name = line;
+                    payload = space + 1;
+                    while (*payload == ' ') {
+                        payload++;
+                    }
+                } else {
+                    payload = NULL;
+                }
+            }
+            if (payload && *payload == '{' &&
+                submit(ingest, name, name_len, CSI_INGEST_FORMAT_JSON, (const uint8_t *)payload,
+                       line + len - payload)) {
+                submitted++;
+                continue;
+            }
+        }
+        local.skipped++;
+    }
+    bool ok = !ferror(input);
+    free(line);
+    free(csv);
+    csi_ingest_destroy(ingest);
+
+    // Messages that did not decode never reach the sink
+    local.frames = atomic_load(&sink.frames);
+    local.skipped += submitted - local.frames;
+
+    csi_archive_store_stats_t after;
+    csi_archive_store_get_stats(store, &after);
+    if (after.write_errors != before.write_errors) {
+        ok = false;
+    }
+    if (stats) {
+        *stats = local;
+    }
+    return ok;
+}
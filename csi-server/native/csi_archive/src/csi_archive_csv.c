@@ -0,0 +1,753 @@
+/**
+ * @file csi_archive_csv.c
+ * @brief ESP32-CSI-Tool CSV parsing, and conversion of CSV files in parallel
+ *
+ * The file is mapped and cut into chunks of whole lines. Parser threads
+ * turn each chunk into batch columns: a line's 25 fields are found by
+ * comparing 16 bytes at a time against ',' (SSE2, NEON, or 8 bytes at a
+ * time in a 64-bit word elsewhere), and the "[v v v ...]" CSI is read
+ * value by value without a branch per digit or sign. A line the fast path
+ * does not take exactly as written (quotes, extra spaces, a '+' sign, a
+ * broken line) goes through csi_archive_csv_parse(), the parser the
+ * sequential converter uses, so both accept and read the same lines.
+ *
+ * The recording's clock runs through the whole file, so a chunk is
+ * parsed with a clock of its own and its timestamps and sequence numbers
+ * are shifted when the chunk is committed. Chunks are committed in file
+ * order by the calling thread, which is also the one writing the store;
+ * parsers run at most two chunks per thread ahead of it.
+ */
+
+#include "csi_archive.h"
+#include "csi_archive_csv.h"
+#include "csi_ingest_decode.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define CHUNKS_PER_WORKER   2
+#define MIN_CHUNK_BYTES     4096
+
+/* ===== Scalar parser ===== */
+
+size_t csi_archive_csv_parse(char *line, uint8_t *frame)
+{
+    // The role (field 1) and real_timestamp (field 23) are free text and not used
+    char *fields[CSI_ARCHIVE_CSV_FIELDS];
+    char *p = line;
+    for (int i = 0; i < CSI_ARCHIVE_CSV_FIELDS; i++) {
+        fields[i] = p;
+        p = strchr(p, ',');
+        if (!p) {
+            return 0;
+        }
+        *p++ = '\0';
+    }
+    long values[CSI_ARCHIVE_CSV_FIELDS] = {0};
+    for (int i = 3; i < CSI_ARCHIVE_CSV_FIELDS; i++) {
+        if (i == 23) {
+            continue;
+        }
+        char *end;
+        values[i] = strtol(fields[i], &end, 10);
+        if (end == fields[i]) {
+            return 0;
+        }
+    }
+
+    csi_frame_header_t header = {
+        .magic = CSI_FRAME_MAGIC,
+        .version = CSI_FRAME_VERSION,
+        .flags = CSI_FRAME_FLAG_RAW,
+        .rssi = (int8_t)values[3],
+        .channel = (uint8_t)values[16],
+        .secondary_channel = (uint8_t)values[17],
+        .timestamp = (uint32_t)values[18],
+    };
+    unsigned mac[6];
+    if (sscanf(fields[2], "%2x:%2x:%2x:%2x:%2x:%2x", &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) != 6) {
+        return 0;
+    }
+    for (int i = 0; i < 6; i++) {
+        header.mac[i] = (uint8_t)mac[i];
+    }
+
+    // Raw CSI: "[v v v ...]", sometimes quoted
+    int8_t *csi = (int8_t *)frame + sizeof(header);
+    while (*p == ' ' || *p == '"') {
+        p++;
+    }
+    if (*p++ != '[') {
+        return 0;
+    }
+    uint16_t len = 0;
+    while (true) {
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p == ']') {
+            break;
+        }
+        char *end;
+        long v = strtol(p, &end, 10);
+        if (end == p || v < INT8_MIN || v > INT8_MAX || len >= CSI_ARCHIVE_CSV_MAX_CSI) {
+            return 0;
+        }
+        csi[len++] = (int8_t)v;
+        p = end;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    header.raw_len = len;
+    header.subcarrier_count = len / 2 > CSI_MAX_SUBCARRIERS ? CSI_MAX_SUBCARRIERS : len / 2;
+
+    memcpy(frame, &header, sizeof(header));
+    return sizeof(header) + len;
+}
+
+/* ===== Fast path ===== */
+
+/*
+ * scan_block() marks the bytes equal to a or b among SCAN_BLOCK bytes
+ * with SCAN_BITS bits each, lowest address in the lowest bits.
+ */
+#if defined(__SSE2__)
+#define SCAN_BLOCK  16
+#define SCAN_SHIFT  0
+
+static inline uint64_t scan_block(const uint8_t *p, char a, char b)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)), _mm_cmpeq_epi8(v, _mm_set1_epi8(b)));
+    return (uint32_t)_mm_movemask_epi8(hit);
+}
+#elif defined(__ARM_NEON)
+#define SCAN_BLOCK  16
+#define SCAN_SHIFT  2
+
+static inline uint64_t scan_block(const uint8_t *p, char a, char b)
+{
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t hit = vorrq_u8(vceqq_u8(v, vdupq_n_u8((uint8_t)a)), vceqq_u8(v, vdupq_n_u8((uint8_t)b)));
+    // Narrowing shift: 4 bits per byte
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+}
+#else
+#define SCAN_BLOCK  8
+#define SCAN_SHIFT  3
+
+/**
+ * @brief High bit of each zero byte, without carries between bytes
+ */
+static inline uint64_t zero_bytes(uint64_t v)
+{
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    return ~(((v & low7) + low7) | v | low7);
+}
+
+static inline uint64_t scan_block(const uint8_t *p, char a, char b)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    const uint64_t ones = 0x0101010101010101ULL;
+    return zero_bytes(v ^ ((uint8_t)a * ones)) | zero_bytes(v ^ ((uint8_t)b * ones));
+}
+#endif
+
+#define SCAN_BITS   (1u << SCAN_SHIFT)
+#define SCAN_LANE   ((1ULL << SCAN_BITS) - 1)
+
+/**
+ * @brief Byte offset of the lowest mark, which is then cleared
+ */
+static inline unsigned scan_next(uint64_t *mask)
+{
+    unsigned bit = (unsigned)__builtin_ctzll(*mask);
+    *mask &= ~(SCAN_LANE << (bit & ~(SCAN_BITS - 1)));
+    return bit >> SCAN_SHIFT;
+}
+
+static const uint8_t s_hex[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+/**
+ * @brief Decimal field as strtol() reads it, if it starts with '-' or a digit
+ */
+static inline bool parse_long(const uint8_t *p, const uint8_t *end, long *out)
+{
+    bool neg = p < end && *p == '-';
+    p += neg;
+    if (p >= end || (unsigned)(*p - '0') > 9) {
+        return false;
+    }
+    long v = 0;
+    int digits = 0;
+    while (p < end && (unsigned)(*p - '0') <= 9) {
+        if (++digits > 18) {
+            return false;               // Leave overflow to strtol()
+        }
+        v = v * 10 + (*p++ - '0');
+    }
+    *out = neg ? -v : v;
+    return true;
+}
+
+/**
+ * @brief One CSI value of n characters: an optional '-' and up to three digits
+ *
+ * Works on the value's first four bytes as one word, whatever n is; the
+ * caller guarantees they are mapped. Sets *bad for anything that is not
+ * an int8 in plain decimal.
+ */
+static inline int8_t parse_int8(const uint8_t *p, uint32_t n, uint32_t *bad)
+{
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    uint32_t neg = (w & 0xFF) == '-';
+    uint32_t digits = n - neg;
+    uint32_t shift = 8 * ((3 - digits) & 3);
+    uint32_t keep = 0xFFFFFFu >> shift;
+    uint32_t x = (w >> (8 * neg)) & keep;
+
+    // Every kept byte in '0'-'9'; no carries cross bytes below 0x80
+    uint32_t at_least_0 = (x + (0x505050u & keep)) & 0x808080u;
+    uint32_t above_9 = (x + (0x464646u & keep)) & 0x808080u;
+    uint32_t d = (x - (0x303030u & keep)) << shift;
+    int32_t v = (int32_t)((d & 0xFF) * 100 + ((d >> 8) & 0xFF) * 10 + (d >> 16));
+    v = (v ^ -(int32_t)neg) + (int32_t)neg;
+    *bad |= (digits - 1 > 2) | (at_least_0 != (0x808080u & keep)) | (above_9 != 0) | ((x & 0x808080u) != 0) |
+            (v < INT8_MIN) | (v > INT8_MAX);
+    return (int8_t)v;
+}
+
+/**
+ * @brief csi_archive_csv_parse() for lines exactly as ESP32-CSI-Tool writes them
+ *
+ * Reads up to SCAN_BLOCK bytes past the end of the line, which must be
+ * mapped.
+ *
+ * @param line Line without its line break
+ * @param stop End of the line
+ * @param frame CSI_ARCHIVE_CSV_FRAME_BYTES bytes
+ * @return Frame length, or 0 to leave the line to csi_archive_csv_parse()
+ */
+static size_t parse_fast(const uint8_t *line, const uint8_t *stop, uint8_t *frame)
+{
+    const size_t n = stop - line;
+    uint32_t comma[CSI_ARCHIVE_CSV_FIELDS];
+    int found = 0;
+    for (size_t base = 0; base < n && found < CSI_ARCHIVE_CSV_FIELDS; base += SCAN_BLOCK) {
+        uint64_t mask = scan_block(line + base, ',', '\0');
+        while (mask && found < CSI_ARCHIVE_CSV_FIELDS) {
+            size_t i = base + scan_next(&mask);
+            if (i >= n || line[i] == '\0') {
+                return 0;
+            }
+            comma[found++] = (uint32_t)i;
+        }
+    }
+    if (found < CSI_ARCHIVE_CSV_FIELDS) {
+        return 0;
+    }
+
+    long values[CSI_ARCHIVE_CSV_FIELDS];
+    for (int i = 3; i < CSI_ARCHIVE_CSV_FIELDS; i++) {
+        if (i != 23 && !parse_long(line + comma[i - 1] + 1, line + comma[i], &values[i])) {
+            return 0;
+        }
+    }
+    csi_frame_header_t header = {
+        .magic = CSI_FRAME_MAGIC,
+        .version = CSI_FRAME_VERSION,
+        .flags = CSI_FRAME_FLAG_RAW,
+        .rssi = (int8_t)values[3],
+        .channel = (uint8_t)values[16],
+        .secondary_channel = (uint8_t)values[17],
+        .timestamp = (uint32_t)values[18],
+    };
+
+    // "XX:XX:XX:XX:XX:XX"
+    const uint8_t *mac = line + comma[1] + 1;
+    if (line + comma[2] - mac != 17) {
+        return 0;
+    }
+    for (int i = 0; i < 6; i++) {
+        uint8_t hi = s_hex[mac[3 * i]], lo = s_hex[mac[3 * i + 1]];
+        if (!hi || !lo || (i < 5 && mac[3 * i + 2] != ':')) {
+            return 0;
+        }
+        header.mac[i] = (uint8_t)((hi - 1) << 4 | (lo - 1));
+    }
+
+    const uint8_t *p = line + comma[CSI_ARCHIVE_CSV_FIELDS - 1] + 1;
+    while (p < stop && (*p == ' ' || *p == '"')) {
+        p++;
+    }
+    if (p >= stop || *p++ != '[') {
+        return 0;
+    }
+
+    // Find the separators first, so values do not wait for the length of the one before
+    const uint8_t *close = memchr(p, ']', stop - p);
+    if (!close) {
+        return 0;
+    }
+    int8_t *csi = (int8_t *)frame + sizeof(header);
+    const size_t m = close - p;
+    uint32_t len = 0, bad = 0;
+    size_t value = 0;
+    for (size_t base = 0; base < m; base += SCAN_BLOCK) {
+        uint64_t mask = scan_block(p + base, ' ', ' ');
+        while (mask) {
+            size_t i = base + scan_next(&mask);
+            if (i >= m) {
+                break;
+            }
+            if (i > value) {
+                if (len == CSI_ARCHIVE_CSV_MAX_CSI) {
+                    return 0;
+                }
+                csi[len++] = parse_int8(p + value, (uint32_t)(i - value), &bad);
+            }
+            value = i + 1;
+        }
+    }
+    if (m > value) {
+        if (len == CSI_ARCHIVE_CSV_MAX_CSI) {
+            return 0;
+        }
+        csi[len++] = parse_int8(p + value, (uint32_t)(m - value), &bad);
+    }
+    if (bad || len == 0) {
+        return 0;
+    }
+    header.raw_len = (uint16_t)len;
+    header.subcarrier_count = len / 2 > CSI_MAX_SUBCARRIERS ? CSI_MAX_SUBCARRIERS : len / 2;
+
+    memcpy(frame, &header, sizeof(header));
+    return sizeof(header) + len;
+}
+
+/* ===== Parallel conversion ===== */
+
+/**
+ * @brief Columns parsed from one chunk
+ *
+ * timestamp and sequence come from the chunk's own clock until the chunk
+ * is committed.
+ */
+typedef struct {
+    uint32_t rows;
+    uint32_t capacity;
+    uint32_t *sequence;
+    uint64_t *timestamp;
+    uint8_t *mac;
+    int8_t *rssi;
+    uint8_t *channel;
+    uint8_t *secondary_channel;
+    uint8_t *subcarrier_count;
+    uint8_t *flags;
+    int8_t *iq;
+    float *amplitude;
+    float *phase;
+    csi_archive_csv_clock_t clock;
+    uint32_t first_timestamp;           ///< local_timestamp of the first frame
+    uint64_t lines;
+    uint64_t skipped;
+    bool failed;                        ///< Out of memory; rows are incomplete
+    bool ready;                         ///< Parsed and waiting to be committed
+} csv_chunk_t;
+
+typedef struct {
+    const uint8_t *map;
+    size_t *bounds;                     ///< chunk_count + 1 offsets of chunk starts
+    uint32_t chunk_count;
+    csv_chunk_t *slots;
+    uint32_t slot_count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t next;                      ///< Next chunk to parse
+    uint32_t committed;                 ///< Chunks committed
+} csv_job_t;
+
+static bool chunk_reserve(csv_chunk_t *c, uint32_t rows)
+{
+    if (rows <= c->capacity) {
+        return true;
+    }
+    uint32_t cap = c->capacity ? c->capacity : 1024;
+    while (cap < rows) {
+        cap *= 2;
+    }
+#define GROW(field, per_row)                                                        \
+    do {                                                                            \
+        void *grown = realloc(c->field, (size_t)cap * (per_row) * sizeof(*c->field)); \
+        if (!grown) {                                                               \
+            return false;                                                           \
+        }                                                                           \
+        c->field = grown;                                                           \
+    } while (0)
+    GROW(sequence, 1);
+    GROW(timestamp, 1);
+    GROW(mac, 6);
+    GROW(rssi, 1);
+    GROW(channel, 1);
+    GROW(secondary_channel, 1);
+    GROW(subcarrier_count, 1);
+    GROW(flags, 1);
+    GROW(iq, CSI_INGEST_IQ_STRIDE);
+    GROW(amplitude, CSI_MAX_SUBCARRIERS);
+    GROW(phase, CSI_MAX_SUBCARRIERS);
+#undef GROW
+    c->capacity = cap;
+    return true;
+}
+
+static void chunk_free(csv_chunk_t *c)
+{
+    free(c->sequence);
+    free(c->timestamp);
+    free(c->mac);
+    free(c->rssi);
+    free(c->channel);
+    free(c->secondary_channel);
+    free(c->subcarrier_count);
+    free(c->flags);
+    free(c->iq);
+    free(c->amplitude);
+    free(c->phase);
+}
+
+/**
+ * @brief Per-thread buffers
+ */
+typedef struct {
+    uint8_t frame[CSI_ARCHIVE_CSV_FRAME_BYTES];
+    char *line;                         ///< NUL-terminated copy for csi_archive_csv_parse()
+    size_t line_capacity;
+} csv_parser_t;
+
+/**
+ * @brief Count and convert the lines of [p, end), as getline() would see them
+ */
+static void parse_chunk(csv_chunk_t *c, csv_parser_t *parser, const uint8_t *p, const uint8_t *end)
+{
+    c->rows = 0;
+    c->lines = 0;
+    c->skipped = 0;
+    c->failed = false;
+    c->clock = (csi_archive_csv_clock_t){0};
+
+    while (p < end) {
+        const uint8_t *eol = memchr(p, '\n', end - p);
+        const uint8_t *next = eol ? eol + 1 : end;
+        const uint8_t *stop = eol ? eol : end;
+        while (stop > p && stop[-1] == '\r') {
+            stop--;
+        }
+        c->lines++;
+        if (stop == p) {
+            p = next;
+            continue;
+        }
+
+        size_t len = 0;
+        if (stop - p >= 9 && memcmp(p, "CSI_DATA,", 9) == 0) {
+            len = parse_fast(p, stop, parser->frame);
+            if (!len) {
+                size_t n = stop - p;
+                if (n >= parser->line_capacity) {
+                    char *grown = realloc(parser->line, n + 1);
+                    if (!grown) {
+                        c->failed = true;
+                        return;
+                    }
+                    parser->line = grown;
+                    parser->line_capacity = n + 1;
+                }
+                memcpy(parser->line, p, n);
+                parser->line[n] = '\0';
+                len = csi_archive_csv_parse(parser->line, parser->frame);
+            }
+        }
+        if (len && !chunk_reserve(c, c->rows + 1)) {
+            c->failed = true;
+            return;
+        }
+
+        csi_ingest_meta_t meta;
+        uint32_t r = c->rows;
+        if (len) {
+            csi_frame_header_t header;
+            memcpy(&header, parser->frame, sizeof(header));
+            if (!c->clock.have_timestamp) {
+                c->first_timestamp = (uint32_t)header.timestamp;
+            }
+            csi_archive_csv_stamp(&c->clock, &header);
+            memcpy(parser->frame, &header, sizeof(header));
+        }
+        if (len && csi_ingest_decode_frame(parser->frame, len, &meta, c->iq + (size_t)r * CSI_INGEST_IQ_STRIDE,
+                                           c->amplitude + (size_t)r * CSI_MAX_SUBCARRIERS,
+                                           c->phase + (size_t)r * CSI_MAX_SUBCARRIERS)) {
+            c->sequence[r] = meta.sequence;
+            c->timestamp[r] = meta.timestamp;
+            memcpy(c->mac + (size_t)r * 6, meta.mac, 6);
+            c->rssi[r] = meta.rssi;
+            c->channel[r] = meta.channel;
+            c->secondary_channel[r] = meta.secondary_channel;
+            c->subcarrier_count[r] = meta.subcarrier_count;
+            c->flags[r] = meta.flags;
+            c->rows++;
+        } else {
+            c->skipped++;
+        }
+        p = next;
+    }
+}
+
+static void *parser_main(void *arg)
+{
+    csv_job_t *job = arg;
+    csv_parser_t *parser = calloc(1, sizeof(*parser));
+
+    pthread_mutex_lock(&job->lock);
+    while (true) {
+        while (job->next < job->chunk_count && job->next >= job->committed + job->slot_count) {
+            pthread_cond_wait(&job->cond, &job->lock);
+        }
+        if (job->next >= job->chunk_count) {
+            break;
+        }
+        uint32_t k = job->next++;
+        csv_chunk_t *c = &job->slots[k % job->slot_count];
+        pthread_mutex_unlock(&job->lock);
+
+        if (parser) {
+            parse_chunk(c, parser, job->map + job->bounds[k], job->map + job->bounds[k + 1]);
+        } else {
+            c->failed = true;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        c->ready = true;
+        pthread_cond_broadcast(&job->cond);
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    if (parser) {
+        free(parser->line);
+        free(parser);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Put a chunk on the recording's clock and append it
+ * @return false if the store lost frames
+ */
+static bool commit_chunk(csv_chunk_t *c, csi_archive_csv_clock_t *clock, const char *node,
+                         csi_archive_store_t *store)
+{
+    if (c->clock.have_timestamp) {
+        uint64_t base = clock->timestamp_base;
+        if (clock->have_timestamp && c->first_timestamp < clock->last_timestamp) {
+            base += 1ULL << 32;
+        }
+        for (uint32_t r = 0; r < c->rows; r++) {
+            c->timestamp[r] += base;
+            c->sequence[r] += clock->sequence;
+        }
+        clock->have_timestamp = true;
+        clock->last_timestamp = c->clock.last_timestamp;
+        clock->timestamp_base = base + c->clock.timestamp_base;
+        clock->sequence += c->clock.sequence;
+    }
+    if (!store || c->rows == 0) {
+        return true;
+    }
+    csi_ingest_batch_t batch = {
+        .node = node,
+        .count = c->rows,
+        .sequence = c->sequence,
+        .timestamp = c->timestamp,
+        .mac = c->mac,
+        .rssi = c->rssi,
+        .channel = c->channel,
+        .secondary_channel = c->secondary_channel,
+        .subcarrier_count = c->subcarrier_count,
+        .flags = c->flags,
+        .iq = c->iq,
+        .amplitude = c->amplitude,
+        .phase = c->phase,
+    };
+    return csi_archive_store_append(store, &batch);
+}
+
+/**
+ * @brief Parse a mapped CSV file on worker threads and commit it in order
+ */
+static bool convert_mapped(const uint8_t *map, size_t size, const char *node, const csi_archive_csv_config_t *config,
+                           csi_archive_store_t *store, csi_archive_convert_stats_t *stats)
+{
+    csi_archive_csv_config_t cfg = CSI_ARCHIVE_CSV_CONFIG_DEFAULT();
+    if (config && config->workers) {
+        cfg.workers = config->workers;
+    }
+    if (config && config->chunk_bytes) {
+        cfg.chunk_bytes = config->chunk_bytes < MIN_CHUNK_BYTES ? MIN_CHUNK_BYTES : config->chunk_bytes;
+    }
+    if (cfg.workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.workers = cpus > 0 ? (cpus > CSI_ARCHIVE_CSV_MAX_WORKERS ? CSI_ARCHIVE_CSV_MAX_WORKERS : (int)cpus) : 1;
+    }
+    if (cfg.workers < 0 || cfg.workers > CSI_ARCHIVE_CSV_MAX_WORKERS) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // Chunks start at line starts
+    csv_job_t job = { .map = map, .slot_count = (uint32_t)cfg.workers * CHUNKS_PER_WORKER };
+    size_t max_chunks = size / cfg.chunk_bytes + 2;
+    job.bounds = malloc(max_chunks * sizeof(*job.bounds));
+    job.slots = calloc(job.slot_count, sizeof(*job.slots));
+    if (!job.bounds || !job.slots) {
+        free(job.bounds);
+        free(job.slots);
+        errno = ENOMEM;
+        return false;
+    }
+    job.bounds[0] = 0;
+    while (job.bounds[job.chunk_count] < size) {
+        size_t from = (job.chunk_count + 1) * cfg.chunk_bytes;
+        from = from > job.bounds[job.chunk_count] ? from : job.bounds[job.chunk_count];
+        const uint8_t *nl = from < size ? memchr(map + from, '\n', size - from) : NULL;
+        job.bounds[++job.chunk_count] = nl ? (size_t)(nl + 1 - map) : size;
+    }
+
+    csi_ingest_decode_init();
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    pthread_t threads[CSI_ARCHIVE_CSV_MAX_WORKERS];
+    int started = 0;
+    while (started < cfg.workers && pthread_create(&threads[started], NULL, parser_main, &job) == 0) {
+        started++;
+    }
+
+    csi_archive_convert_stats_t local = {0};
+    csi_archive_csv_clock_t clock = {0};
+    bool ok = true, failed = false;
+    for (uint32_t k = 0; started > 0 && k < job.chunk_count; k++) {
+        csv_chunk_t *c = &job.slots[k % job.slot_count];
+        pthread_mutex_lock(&job.lock);
+        while (!c->ready) {
+            pthread_cond_wait(&job.cond, &job.lock);
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        failed = failed || c->failed;
+        ok = commit_chunk(c, &clock, node, store) && ok;
+        local.lines += c->lines;
+        local.frames += c->rows;
+        local.skipped += c->skipped;
+
+        pthread_mutex_lock(&job.lock);
+        c->ready = false;
+        job.committed++;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+    for (uint32_t s = 0; s < job.slot_count; s++) {
+        chunk_free(&job.slots[s]);
+    }
+    free(job.slots);
+    free(job.bounds);
+    if (stats) {
+        *stats = local;
+    }
+    if (failed || started == 0) {
+        errno = started == 0 ? EAGAIN : ENOMEM;
+        return false;
+    }
+    return ok;
+}
+
+bool csi_archive_convert_file(const char *path, csi_archive_input_t format, const char *node,
+                              const csi_archive_csv_config_t *config, csi_archive_store_t *store,
+                              csi_archive_convert_stats_t *stats)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Map with a zero page behind the file, so scanning may read past the last line
+    uint8_t *map = NULL;
+    size_t size = (size_t)st.st_size, mapped = 0;
+    if (S_ISREG(st.st_mode) && format != CSI_ARCHIVE_INPUT_JSON) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        mapped = (size + page - 1) / page * page + page;
+        map = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            map = NULL;
+        } else if (size && mmap(map, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(map, mapped);
+            map = NULL;
+        }
+    }
+    // Auto reads every line as what it is; only CSV is parsed in parallel
+    if (map && format == CSI_ARCHIVE_INPUT_AUTO && memchr(map, '{', size)) {
+        munmap(map, mapped);
+        map = NULL;
+    }
+
+    bool ok;
+    if (map) {
+        close(fd);
+        ok = convert_mapped(map, size, node, config, store, stats);
+        int err = errno;
+        munmap(map, mapped);
+        errno = err;
+    } else if (!store) {
+        close(fd);
+        errno = EINVAL;
+        ok = false;
+    } else {
+        FILE *input = fdopen(fd, "r");
+        if (!input) {
+            close(fd);
+            return false;
+        }
+        ok = csi_archive_convert(input, format, node, store, stats);
+        int err = errno;
+        fclose(input);
+        errno = err;
+    }
+    return ok;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file csi_archive_csv.h
+ * @brief ESP32-CSI-Tool line parsing shared by the converters (internal)
+ *
+ * A "CSI_DATA,..." line becomes a binary frame (csi_frame_header_t and
+ * the raw CSI), which csi_ingest then decodes like any frame a node sent.
+ * The line only carries the 32-bit local_timestamp; the recording's clock
+ * unwraps it and numbers the frames in file order.
+ */
+
+#ifndef CSI_ARCHIVE_CSV_H
+#define CSI_ARCHIVE_CSV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "csi_frame.h"
+
+#define CSI_ARCHIVE_CSV_FIELDS      25  ///< Fields before the bracketed CSI
+#define CSI_ARCHIVE_CSV_MAX_CSI     1024
+#define CSI_ARCHIVE_CSV_FRAME_BYTES (sizeof(csi_frame_header_t) + CSI_ARCHIVE_CSV_MAX_CSI)
+
+/**
+ * @brief Clock of one recording
+ */
+typedef struct {
+    bool have_timestamp;
+    uint32_t last_timestamp;            ///< Last 32-bit local_timestamp
+    uint64_t timestamp_base;            ///< Accumulated wraps
+    uint32_t sequence;                  ///< Frames so far
+} csi_archive_csv_clock_t;
+
+/**
+ * @brief Turn a "CSI_DATA,..." line into a binary frame
+ *
+ * The header's timestamp is left as the 32-bit local_timestamp and its
+ * sequence as 0; csi_archive_csv_stamp() sets both.
+ *
+ * @param line Line without its line break, NUL terminated; modified
+ * @param frame CSI_ARCHIVE_CSV_FRAME_BYTES bytes
+ * @return Frame length, 0 if the line holds no complete report
+ */
+size_t csi_archive_csv_parse(char *line, uint8_t *frame);
+
+/**
+ * @brief Unwrap the frame's local_timestamp and number it
+ */
+static inline void csi_archive_csv_stamp(csi_archive_csv_clock_t *clock, csi_frame_header_t *header)
+{
+    uint32_t ts = (uint32_t)header->timestamp;
+    if (clock->have_timestamp && ts < clock->last_timestamp) {
+        clock->timestamp_base += 1ULL << 32;
+    }
+    clock->have_timestamp = true;
+    clock->last_timestamp = ts;
+    header->timestamp = clock->timestamp_base + ts;
+    header->sequence = clock->sequence++;
+}
+
+#endif // CSI_ARCHIVE_CSV_H
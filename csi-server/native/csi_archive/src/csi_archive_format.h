@@ -0,0 +1,127 @@
+/**
+ * @file csi_archive_format.h
+ * @brief On-disk layout of a segment and the chunk codecs
+ *
+ * Every structure has natural alignment and a size that is a multiple of
+ * 8, and groups and chunks start at 8-byte offsets, so a mapped segment
+ * can be read through these types and raw columns used in place.
+ */
+
+#ifndef CSI_ARCHIVE_FORMAT_H
+#define CSI_ARCHIVE_FORMAT_H
+
+#include "csi_archive.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Segments are read in place and assume a little-endian host"
+#endif
+
+#define SEGMENT_MAGIC           0x41495343u     // "CSIA"
+#define GROUP_MAGIC             0x47495343u     // "CSIG"
+#define FOOTER_MAGIC            0x46495343u     // "CSIF"
+
+#define GROUP_FLAG_UTC          0x01            // Timestamps are UTC
+#define MAX_GROUP_ROWS          65536
+#define ARCHIVE_ALIGN           8
+
+/**
+ * @brief Start of a segment
+ */
+typedef struct {
+    uint32_t magic;                     ///< SEGMENT_MAGIC
+    uint16_t version;                   ///< CSI_ARCHIVE_VERSION
+    uint16_t header_bytes;              ///< sizeof(segment_header_t)
+    uint32_t group_rows;                ///< Rows per full group
+    float amplitude_scale;
+    float phase_scale;
+    uint8_t node_len;
+    uint8_t reserved[11];
+    char node[CSI_INGEST_MAX_NODE_LEN];
+} segment_header_t;
+
+/**
+ * @brief Where a column chunk of a group is
+ */
+typedef struct {
+    uint32_t offset;                    ///< From the start of the group
+    uint32_t bytes;                     ///< Stored size
+    uint8_t codec;                      ///< csi_archive_codec_t
+    uint8_t reserved[3];
+} chunk_desc_t;
+
+/**
+ * @brief Start of a group, followed by its chunks
+ */
+typedef struct {
+    uint32_t magic;                     ///< GROUP_MAGIC
+    uint32_t rows;
+    uint64_t first_timestamp;
+    uint64_t last_timestamp;
+    uint64_t bytes;                     ///< Whole group, descriptor included
+    uint32_t flags;                     ///< GROUP_FLAG_* bits
+    uint32_t reserved;
+    chunk_desc_t chunk[CSI_ARCHIVE_COLUMNS];
+    uint32_t crc;                       ///< CRC-32 of the descriptor up to here
+} group_desc_t;
+
+/**
+ * @brief End of a segment, preceded by the offset of every group
+ */
+typedef struct {
+    uint64_t index_offset;              ///< Offset of the group offsets
+    uint64_t rows;
+    uint32_t groups;
+    uint32_t crc;                       ///< CRC-32 of the group offsets
+    uint32_t magic;                     ///< FOOTER_MAGIC
+    uint32_t version;
+} segment_footer_t;
+
+_Static_assert(sizeof(segment_header_t) % ARCHIVE_ALIGN == 0, "segment header size");
+_Static_assert(sizeof(group_desc_t) % ARCHIVE_ALIGN == 0, "group descriptor size");
+_Static_assert(sizeof(segment_footer_t) % ARCHIVE_ALIGN == 0, "footer size");
+
+/**
+ * @brief Shape of a column: stride = width * per_row
+ */
+typedef struct {
+    uint8_t width;                      ///< Bytes per element: 1, 2, 4 or 8
+    uint8_t per_row;                    ///< Elements per row
+} column_shape_t;
+
+extern const column_shape_t g_column_shape[CSI_ARCHIVE_COLUMNS];
+
+static inline size_t align_up(size_t n)
+{
+    return (n + ARCHIVE_ALIGN - 1) & ~(size_t)(ARCHIVE_ALIGN - 1);
+}
+
+uint32_t archive_crc32(const void *data, size_t len);
+
+/**
+ * @brief Encode a chunk, picking the smallest encoding
+ * @param column Column
+ * @param rows Rows in data
+ * @param data rows * stride bytes
+ * @param out Room for rows * stride bytes
+ * @param allow_compression false to always store raw
+ * @param codec Chosen encoding
+ * @return Encoded size
+ */
+size_t archive_encode(csi_archive_column_t column, uint32_t rows, const uint8_t *data,
+                      uint8_t *out, bool allow_compression, csi_archive_codec_t *codec);
+
+/**
+ * @brief Decode a chunk into rows * stride bytes
+ * @return false if the chunk is corrupt
+ */
+bool archive_decode(csi_archive_column_t column, uint32_t rows, csi_archive_codec_t codec,
+                    const uint8_t *in, size_t len, uint8_t *out);
+
+/**
+ * @brief Find the first row whose timestamp is at or after a time
+ * @return Row, rows if none, or -1 if the chunk is corrupt
+ */
+int64_t archive_seek_timestamp(uint32_t rows, csi_archive_codec_t codec, const uint8_t *in,
+                               size_t len, uint64_t timestamp);
+
+#endif // CSI_ARCHIVE_FORMAT_H
@@ -0,0 +1,299 @@
+/**
+ * @file csi_archive_reader.c
+ * @brief Memory-mapped reader of archive segments
+ */
+
+#include "csi_archive_format.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct csi_archive_reader {
+    const uint8_t *map;
+    size_t size;
+    csi_archive_info_t info;
+    uint64_t *group_offset;
+    uint64_t *first_row;
+    uint32_t group_cap;
+};
+
+/**
+ * @brief Check a group descriptor and that the group lies within limit
+ */
+static const group_desc_t *valid_group(const csi_archive_reader_t *r, uint64_t offset, uint64_t limit)
+{
+    if (offset % ARCHIVE_ALIGN || offset > limit || limit - offset < sizeof(group_desc_t)) {
+        return NULL;
+    }
+    const group_desc_t *desc = (const group_desc_t *)(r->map + offset);
+    if (desc->magic != GROUP_MAGIC || desc->rows == 0 || desc->rows > MAX_GROUP_ROWS ||
+        desc->bytes > limit - offset || desc->first_timestamp > desc->last_timestamp ||
+        desc->crc != archive_crc32(desc, offsetof(group_desc_t, crc))) {
+        return NULL;
+    }
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        const chunk_desc_t *chunk = &desc->chunk[c];
+        if (chunk->offset % ARCHIVE_ALIGN || chunk->offset < sizeof(*desc) || chunk->offset > desc->bytes ||
+            chunk->bytes > desc->bytes - chunk->offset || chunk->codec > CSI_ARCHIVE_CODEC_DELTA) {
+            return NULL;
+        }
+    }
+    return desc;
+}
+
+static const group_desc_t *group_at(const csi_archive_reader_t *r, uint32_t group)
+{
+    return (const group_desc_t *)(r->map + r->group_offset[group]);
+}
+
+/**
+ * @brief Append a group to the index if its time range continues the previous one
+ * @return false if it does not, or out of memory (errno ENOMEM)
+ */
+static bool add_group(csi_archive_reader_t *r, uint64_t offset)
+{
+    const group_desc_t *desc = (const group_desc_t *)(r->map + offset);
+    if (r->info.groups > 0) {
+        const group_desc_t *prev = group_at(r, r->info.groups - 1);
+        if (desc->first_timestamp < prev->last_timestamp || (desc->flags ^ prev->flags) & GROUP_FLAG_UTC) {
+            return false;
+        }
+    }
+    if (r->info.groups == r->group_cap) {
+        uint32_t cap = r->group_cap ? 2 * r->group_cap : 64;
+        uint64_t *offsets = realloc(r->group_offset, cap * sizeof(*offsets));
+        if (!offsets) {
+            errno = ENOMEM;
+            return false;
+        }
+        r->group_offset = offsets;
+        uint64_t *rows = realloc(r->first_row, cap * sizeof(*rows));
+        if (!rows) {
+            errno = ENOMEM;
+            return false;
+        }
+        r->first_row = rows;
+        r->group_cap = cap;
+    }
+    r->first_row[r->info.groups] = r->info.rows;
+    r->group_offset[r->info.groups++] = offset;
+    r->info.rows += desc->rows;
+    return true;
+}
+
+/**
+ * @brief Index the groups listed in the footer
+ * @return false if there is no intact footer
+ */
+static bool load_footer(csi_archive_reader_t *r)
+{
+    segment_footer_t footer;
+    if (r->size < sizeof(segment_header_t) + sizeof(footer)) {
+        return false;
+    }
+    memcpy(&footer, r->map + r->size - sizeof(footer), sizeof(footer));
+    uint64_t index_end = r->size - sizeof(footer);
+    if (footer.magic != FOOTER_MAGIC || footer.version != CSI_ARCHIVE_VERSION ||
+        footer.index_offset < sizeof(segment_header_t) || footer.index_offset > index_end ||
+        index_end - footer.index_offset != (uint64_t)footer.groups * sizeof(uint64_t)) {
+        return false;
+    }
+    const uint64_t *offsets = (const uint64_t *)(r->map + footer.index_offset);
+    if (archive_crc32(offsets, footer.groups * sizeof(uint64_t)) != footer.crc) {
+        return false;
+    }
+    for (uint32_t g = 0; g < footer.groups; g++) {
+        if (!valid_group(r, offsets[g], footer.index_offset) || !add_group(r, offsets[g])) {
+            return false;
+        }
+    }
+    return r->info.rows == footer.rows;
+}
+
+/**
+ * @brief Index the groups by walking them from the start, as far as they are intact
+ */
+static bool scan_groups(csi_archive_reader_t *r)
+{
+    uint64_t offset = sizeof(segment_header_t);
+    const group_desc_t *desc;
+    while ((desc = valid_group(r, offset, r->size)) != NULL) {
+        if (!add_group(r, offset)) {
+            return errno != ENOMEM;
+        }
+        offset += desc->bytes;
+    }
+    return true;
+}
+
+csi_archive_reader_t *csi_archive_reader_open(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(segment_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = err;
+        return NULL;
+    }
+
+    csi_archive_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        munmap(map, st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    r->map = map;
+    r->size = st.st_size;
+    r->info.file_bytes = st.st_size;
+
+    const segment_header_t *header = map;
+    if (header->magic != SEGMENT_MAGIC || header->version != CSI_ARCHIVE_VERSION ||
+        header->header_bytes != sizeof(*header) || header->node_len > CSI_INGEST_MAX_NODE_LEN) {
+        csi_archive_reader_close(r);
+        errno = EINVAL;
+        return NULL;
+    }
+    memcpy(r->info.node, header->node, header->node_len);
+    r->info.node[header->node_len] = '\0';
+
+    if (!load_footer(r)) {
+        r->info.groups = 0;
+        r->info.rows = 0;
+        r->info.recovered = true;
+        errno = 0;
+        if (!scan_groups(r)) {
+            csi_archive_reader_close(r);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    if (r->info.groups > 0) {
+        r->info.utc = group_at(r, 0)->flags & GROUP_FLAG_UTC;
+        r->info.first_timestamp = group_at(r, 0)->first_timestamp;
+        r->info.last_timestamp = group_at(r, r->info.groups - 1)->last_timestamp;
+    }
+    return r;
+}
+
+const csi_archive_info_t *csi_archive_reader_info(const csi_archive_reader_t *reader)
+{
+    return &reader->info;
+}
+
+bool csi_archive_reader_group(const csi_archive_reader_t *reader, uint32_t group, csi_archive_group_t *out)
+{
+    if (group >= reader->info.groups) {
+        return false;
+    }
+    const group_desc_t *desc = group_at(reader, group);
+    out->rows = desc->rows;
+    out->first_row = reader->first_row[group];
+    out->first_timestamp = desc->first_timestamp;
+    out->last_timestamp = desc->last_timestamp;
+    out->stored_bytes = desc->bytes;
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        out->codec[c] = desc->chunk[c].codec;
+        out->chunk_bytes[c] = desc->chunk[c].bytes;
+    }
+    return true;
+}
+
+size_t csi_archive_reader_column_bytes(const csi_archive_reader_t *reader, uint32_t group,
+                                       csi_archive_column_t column)
+{
+    if (group >= reader->info.groups || (unsigned)column >= CSI_ARCHIVE_COLUMNS) {
+        return 0;
+    }
+    return group_at(reader, group)->rows * csi_archive_column_stride(column);
+}
+
+const void *csi_archive_reader_column(const csi_archive_reader_t *reader, uint32_t group,
+                                      csi_archive_column_t column, void *scratch)
+{
+    if (group >= reader->info.groups || (unsigned)column >= CSI_ARCHIVE_COLUMNS) {
+        return NULL;
+    }
+    const group_desc_t *desc = group_at(reader, group);
+    const chunk_desc_t *chunk = &desc->chunk[column];
+    const uint8_t *data = (const uint8_t *)desc + chunk->offset;
+
+    if (chunk->codec == CSI_ARCHIVE_CODEC_RAW) {
+        return chunk->bytes == desc->rows * csi_archive_column_stride(column) ? data : NULL;
+    }
+    if (!scratch || !archive_decode(column, desc->rows, chunk->codec, data, chunk->bytes, scratch)) {
+        return NULL;
+    }
+    return scratch;
+}
+
+bool csi_archive_reader_seek(const csi_archive_reader_t *reader, uint64_t timestamp,
+                             uint32_t *group, uint32_t *row)
+{
+    // First group that ends at or after timestamp
+    uint32_t lo = 0, hi = reader->info.groups;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (group_at(reader, mid)->last_timestamp < timestamp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == reader->info.groups) {
+        return false;
+    }
+
+    const group_desc_t *desc = group_at(reader, lo);
+    const chunk_desc_t *chunk = &desc->chunk[CSI_ARCHIVE_COL_TIMESTAMP];
+    int64_t found = archive_seek_timestamp(desc->rows, chunk->codec, (const uint8_t *)desc + chunk->offset,
+                                           chunk->bytes, timestamp);
+    if (found < 0 || found >= desc->rows) {
+        return false;
+    }
+    *group = lo;
+    *row = (uint32_t)found;
+    return true;
+}
+
+void csi_archive_reader_close(csi_archive_reader_t *reader)
+{
+    if (!reader) {
+        return;
+    }
+    munmap((void *)reader->map, reader->size);
+    free(reader->group_offset);
+    free(reader->first_row);
+    free(reader);
+}
+
+void csi_archive_to_float(const int16_t *in, size_t n, float scale, float *out)
+{
+    float inverse = 1.0f / scale;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = in[i] == CSI_ARCHIVE_INT16_NAN ? NAN : in[i] * inverse;
+    }
+}
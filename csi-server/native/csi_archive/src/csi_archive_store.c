@@ -0,0 +1,339 @@
+/**
+ * @file csi_archive_store.c
+ * @brief Archive directory of per-node, time-partitioned segments
+ */
+
+#include "csi_archive_format.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define STORE_BUCKETS           1024
+#define MAX_SEGMENT_SUFFIX      1000
+
+/**
+ * @brief A node's open segment
+ */
+typedef struct store_node {
+    struct store_node *next;            ///< Hash chain
+    struct store_node *lru_prev;        ///< Towards the most recently used
+    struct store_node *lru_next;
+    uint32_t hash;
+    int busy;                           ///< Appends in progress; never evicted while set
+    char name[CSI_INGEST_MAX_NODE_LEN + 1];
+    uint64_t partition;                 ///< Partition of the open segment
+    csi_archive_writer_t *writer;
+} store_node_t;
+
+struct csi_archive_store {
+    csi_archive_store_config_t config;
+    char *dir;
+    pthread_mutex_t lock;
+    store_node_t *buckets[STORE_BUCKETS];
+    store_node_t *lru_head;             ///< Most recently used
+    store_node_t *lru_tail;
+    uint32_t open;
+
+    atomic_uint_fast64_t rows;
+    atomic_uint_fast64_t segments;
+    atomic_uint_fast64_t write_errors;
+};
+
+static uint32_t hash_name(const char *name)
+{
+    uint32_t h = 2166136261u;           // FNV-1a
+    for (; *name; name++) {
+        h = (h ^ (uint8_t)*name) * 16777619u;
+    }
+    return h;
+}
+
+void csi_archive_node_dir(const char *node, char *out)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; node[i] && i < CSI_INGEST_MAX_NODE_LEN; i++) {
+        unsigned char c = (unsigned char)node[i];
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                     c == '_' || c == '-' || (c == '.' && i > 0);
+        if (plain) {
+            *out++ = (char)c;
+        } else {
+            *out++ = '%';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 15];
+        }
+    }
+    *out = '\0';
+}
+
+// ===== LRU =====
+
+static void lru_unlink(csi_archive_store_t *s, store_node_t *n)
+{
+    if (n->lru_prev) {
+        n->lru_prev->lru_next = n->lru_next;
+    } else {
+        s->lru_head = n->lru_next;
+    }
+    if (n->lru_next) {
+        n->lru_next->lru_prev = n->lru_prev;
+    } else {
+        s->lru_tail = n->lru_prev;
+    }
+    n->lru_prev = n->lru_next = NULL;
+}
+
+static void lru_push(csi_archive_store_t *s, store_node_t *n)
+{
+    n->lru_next = s->lru_head;
+    if (s->lru_head) {
+        s->lru_head->lru_prev = n;
+    } else {
+        s->lru_tail = n;
+    }
+    s->lru_head = n;
+}
+
+static void table_remove(csi_archive_store_t *s, store_node_t *n)
+{
+    store_node_t **link = &s->buckets[n->hash % STORE_BUCKETS];
+    while (*link != n) {
+        link = &(*link)->next;
+    }
+    *link = n->next;
+    lru_unlink(s, n);
+    s->open--;
+}
+
+// ===== SEGMENTS =====
+
+/**
+ * @brief Close a node's segment
+ */
+static void close_segment(csi_archive_store_t *s, store_node_t *n)
+{
+    if (n->writer && !csi_archive_writer_close(n->writer)) {
+        atomic_fetch_add(&s->write_errors, 1);
+    }
+    n->writer = NULL;
+}
+
+/**
+ * @brief Create the segment of a partition; later segments of the same
+ *        partition get a -<n> suffix
+ */
+static csi_archive_writer_t *open_segment(csi_archive_store_t *s, const char *node, uint64_t partition)
+{
+    char node_dir[3 * CSI_INGEST_MAX_NODE_LEN + 1];
+    csi_archive_node_dir(node, node_dir);
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", s->dir, node_dir) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    uint64_t start = partition * s->config.partition_us;
+    for (int suffix = 0; suffix < MAX_SEGMENT_SUFFIX; suffix++) {
+        int len = suffix ? snprintf(path, sizeof(path), "%s/%s/%llu-%d" CSI_ARCHIVE_SUFFIX, s->dir, node_dir,
+                                    (unsigned long long)start, suffix)
+                         : snprintf(path, sizeof(path), "%s/%s/%llu" CSI_ARCHIVE_SUFFIX, s->dir, node_dir,
+                                    (unsigned long long)start);
+        if (len >= (int)sizeof(path)) {
+            errno = ENAMETOOLONG;
+            return NULL;
+        }
+        csi_archive_writer_t *writer = csi_archive_writer_create(path, node, &s->config.writer);
+        if (writer || errno != EEXIST) {
+            if (writer) {
+                atomic_fetch_add(&s->segments, 1);
+            }
+            return writer;
+        }
+    }
+    errno = EEXIST;
+    return NULL;
+}
+
+/**
+ * @brief Find or add a node and mark it busy; closes least recently used
+ *        idle nodes beyond max_open
+ */
+static store_node_t *acquire_node(csi_archive_store_t *s, const char *name)
+{
+    uint32_t hash = hash_name(name);
+    store_node_t *evicted = NULL;
+
+    pthread_mutex_lock(&s->lock);
+    store_node_t *n = s->buckets[hash % STORE_BUCKETS];
+    while (n && (n->hash != hash || strcmp(n->name, name) != 0)) {
+        n = n->next;
+    }
+    if (n) {
+        lru_unlink(s, n);
+    } else {
+        n = calloc(1, sizeof(*n));
+        if (!n) {
+            pthread_mutex_unlock(&s->lock);
+            return NULL;
+        }
+        n->hash = hash;
+        snprintf(n->name, sizeof(n->name), "%s", name);
+        n->next = s->buckets[hash % STORE_BUCKETS];
+        s->buckets[hash % STORE_BUCKETS] = n;
+        s->open++;
+    }
+    lru_push(s, n);
+    n->busy++;
+
+    // Detach idle nodes here, close their files outside the lock
+    for (store_node_t *victim = s->lru_tail; victim && s->open > s->config.max_open;) {
+        store_node_t *prev = victim->lru_prev;
+        if (!victim->busy) {
+            table_remove(s, victim);
+            victim->next = evicted;
+            evicted = victim;
+        }
+        victim = prev;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    while (evicted) {
+        store_node_t *next = evicted->next;
+        close_segment(s, evicted);
+        free(evicted);
+        evicted = next;
+    }
+    return n;
+}
+
+static void release_node(csi_archive_store_t *s, store_node_t *n)
+{
+    pthread_mutex_lock(&s->lock);
+    n->busy--;
+    pthread_mutex_unlock(&s->lock);
+}
+
+// ===== API =====
+
+csi_archive_store_t *csi_archive_store_open(const csi_archive_store_config_t *config)
+{
+    csi_archive_store_config_t defaults = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    if (!config || !config->dir || !*config->dir) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (mkdir(config->dir, 0755) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    csi_archive_store_t *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return NULL;
+    }
+    s->config = *config;
+    if (!s->config.partition_us) {
+        s->config.partition_us = defaults.partition_us;
+    }
+    if (!s->config.max_open) {
+        s->config.max_open = defaults.max_open;
+    }
+    if (!s->config.writer.group_rows) {
+        s->config.writer.group_rows = defaults.writer.group_rows;
+    }
+    s->dir = strdup(config->dir);
+    if (!s->dir) {
+        free(s);
+        return NULL;
+    }
+    s->config.dir = s->dir;
+    pthread_mutex_init(&s->lock, NULL);
+    return s;
+}
+
+bool csi_archive_store_append(csi_archive_store_t *store, const csi_ingest_batch_t *batch)
+{
+    store_node_t *n = acquire_node(store, batch->node);
+    if (!n) {
+        atomic_fetch_add(&store->write_errors, batch->count);
+        return false;
+    }
+
+    bool ok = true;
+    uint32_t i = 0;
+    while (i < batch->count) {
+        uint64_t partition = batch->timestamp[i] / store->config.partition_us;
+        if (!n->writer || n->partition != partition ||
+            !csi_archive_writer_accepts(n->writer, batch->timestamp[i], batch->flags[i])) {
+            close_segment(store, n);
+            n->writer = open_segment(store, n->name, partition);
+            n->partition = partition;
+            if (!n->writer) {
+                atomic_fetch_add(&store->write_errors, batch->count - i);
+                ok = false;
+                break;
+            }
+        }
+
+        // Run of frames that stays in this segment
+        uint32_t end = i + 1;
+        while (end < batch->count && batch->timestamp[end] >= batch->timestamp[end - 1] &&
+               batch->timestamp[end] / store->config.partition_us == partition &&
+               !((batch->flags[end] ^ batch->flags[i]) & CSI_FRAME_FLAG_UTC)) {
+            end++;
+        }
+        if (csi_archive_writer_append(n->writer, batch, i, end - i)) {
+            atomic_fetch_add(&store->rows, end - i);
+        } else {
+            atomic_fetch_add(&store->write_errors, end - i);
+            close_segment(store, n);
+            ok = false;
+        }
+        i = end;
+    }
+
+    release_node(store, n);
+    return ok;
+}
+
+void csi_archive_store_sink(const csi_ingest_batch_t *batch, void *ctx)
+{
+    csi_archive_store_append(ctx, batch);
+}
+
+void csi_archive_store_get_stats(csi_archive_store_t *store, csi_archive_store_stats_t *stats)
+{
+    stats->rows = atomic_load(&store->rows);
+    stats->segments = atomic_load(&store->segments);
+    stats->write_errors = atomic_load(&store->write_errors);
+    pthread_mutex_lock(&store->lock);
+    stats->open_segments = store->open;
+    pthread_mutex_unlock(&store->lock);
+}
+
+bool csi_archive_store_close(csi_archive_store_t *store)
+{
+    uint64_t errors = atomic_load(&store->write_errors);
+    for (int b = 0; b < STORE_BUCKETS; b++) {
+        store_node_t *n = store->buckets[b];
+        while (n) {
+            store_node_t *next = n->next;
+            close_segment(store, n);
+            free(n);
+            n = next;
+        }
+    }
+    bool ok = atomic_load(&store->write_errors) == errors;
+    pthread_mutex_destroy(&store->lock);
+    free(store->dir);
+    free(store);
+    return ok;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file csi_archive_writer.c
+ * @brief Writer of one archive segment
+ */
+
+#include "csi_archive_format.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct csi_archive_writer {
+    int fd;
+    csi_archive_writer_config_t config;
+    uint64_t offset;                    ///< End of the file
+    uint64_t rows;                      ///< Rows in written groups
+
+    // Current group, by column
+    uint8_t *column[CSI_ARCHIVE_COLUMNS];
+    uint32_t group_rows;
+    bool have_last;
+    bool utc;
+    uint64_t last_timestamp;
+
+    uint64_t *group_offset;
+    uint32_t groups;
+    uint32_t group_cap;
+
+    uint8_t *out;                       ///< Group being assembled
+    size_t out_cap;
+    bool failed;
+};
+
+static bool write_all(csi_archive_writer_t *w, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = write(w->fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            w->failed = true;
+            return false;
+        }
+        p += n;
+        len -= n;
+        w->offset += n;
+    }
+    return true;
+}
+
+static int16_t quantize(float value, float scale)
+{
+    if (isnan(value)) {
+        return CSI_ARCHIVE_INT16_NAN;
+    }
+    float q = rintf(value * scale);
+    return q > INT16_MAX ? INT16_MAX : q < -INT16_MAX ? -INT16_MAX : (int16_t)q;
+}
+
+/**
+ * @brief Encode the current group and append it to the file
+ */
+static bool flush_group(csi_archive_writer_t *w)
+{
+    if (w->group_rows == 0) {
+        return true;
+    }
+    if (w->groups == w->group_cap) {
+        uint32_t cap = w->group_cap ? 2 * w->group_cap : 64;
+        uint64_t *offsets = realloc(w->group_offset, cap * sizeof(*offsets));
+        if (!offsets) {
+            w->failed = true;
+            return false;
+        }
+        w->group_offset = offsets;
+        w->group_cap = cap;
+    }
+
+    const uint64_t *timestamp = (const uint64_t *)w->column[CSI_ARCHIVE_COL_TIMESTAMP];
+    group_desc_t *desc = (group_desc_t *)w->out;
+    memset(desc, 0, sizeof(*desc));
+    desc->magic = GROUP_MAGIC;
+    desc->rows = w->group_rows;
+    desc->first_timestamp = timestamp[0];
+    desc->last_timestamp = timestamp[w->group_rows - 1];
+    desc->flags = w->utc ? GROUP_FLAG_UTC : 0;
+
+    size_t pos = sizeof(*desc);
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        csi_archive_codec_t codec;
+        size_t n = archive_encode(c, w->group_rows, w->column[c], w->out + pos, w->config.compress, &codec);
+        desc->chunk[c].offset = (uint32_t)pos;
+        desc->chunk[c].bytes = (uint32_t)n;
+        desc->chunk[c].codec = codec;
+        size_t padded = align_up(n);
+        memset(w->out + pos + n, 0, padded - n);
+        pos += padded;
+    }
+    desc->bytes = pos;
+    desc->crc = archive_crc32(desc, offsetof(group_desc_t, crc));
+
+    w->group_offset[w->groups] = w->offset;
+    if (!write_all(w, w->out, pos)) {
+        return false;
+    }
+    w->groups++;
+    w->rows += w->group_rows;
+    w->group_rows = 0;
+    return true;
+}
+
+csi_archive_writer_t *csi_archive_writer_create(const char *path, const char *node,
+                                                const csi_archive_writer_config_t *config)
+{
+    csi_archive_writer_config_t defaults = CSI_ARCHIVE_WRITER_CONFIG_DEFAULT();
+    size_t node_len = strlen(node);
+    if (node_len > CSI_INGEST_MAX_NODE_LEN) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    csi_archive_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        return NULL;
+    }
+    w->config = config ? *config : defaults;
+    if (w->config.group_rows == 0) {
+        w->config.group_rows = defaults.group_rows;
+    }
+    if (w->config.group_rows > MAX_GROUP_ROWS) {
+        w->config.group_rows = MAX_GROUP_ROWS;
+    }
+
+    // Column buffers and the assembly buffer: every chunk padded, at most raw size
+    size_t rows = w->config.group_rows;
+    size_t columns_bytes = 0;
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        columns_bytes += align_up(rows * csi_archive_column_stride(c));
+    }
+    w->out_cap = sizeof(group_desc_t) + columns_bytes;
+    uint8_t *buffers = malloc(columns_bytes + w->out_cap);
+    if (!buffers) {
+        free(w);
+        return NULL;
+    }
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        w->column[c] = buffers;
+        buffers += align_up(rows * csi_archive_column_stride(c));
+    }
+    w->out = buffers;
+
+    w->fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        int err = errno;
+        free(w->column[0]);
+        free(w);
+        errno = err;
+        return NULL;
+    }
+
+    segment_header_t header = {
+        .magic = SEGMENT_MAGIC,
+        .version = CSI_ARCHIVE_VERSION,
+        .header_bytes = sizeof(header),
+        .group_rows = w->config.group_rows,
+        .amplitude_scale = CSI_ARCHIVE_AMPLITUDE_SCALE,
+        .phase_scale = CSI_ARCHIVE_PHASE_SCALE,
+        .node_len = (uint8_t)node_len,
+    };
+    memcpy(header.node, node, node_len);
+    if (!write_all(w, &header, sizeof(header))) {
+        int err = errno;
+        close(w->fd);
+        unlink(path);
+        free(w->column[0]);
+        free(w);
+        errno = err;
+        return NULL;
+    }
+    return w;
+}
+
+bool csi_archive_writer_accepts(const csi_archive_writer_t *writer, uint64_t timestamp, uint8_t flags)
+{
+    if (!writer->have_last) {
+        return true;
+    }
+    return timestamp >= writer->last_timestamp && !!(flags & CSI_FRAME_FLAG_UTC) == writer->utc;
+}
+
+bool csi_archive_writer_append(csi_archive_writer_t *w, const csi_ingest_batch_t *batch,
+                               uint32_t first, uint32_t count)
+{
+    if (w->failed) {
+        errno = EIO;
+        return false;
+    }
+    for (uint32_t i = first; i < first + count; i++) {
+        if (!csi_archive_writer_accepts(w, batch->timestamp[i], batch->flags[i])) {
+            errno = EINVAL;
+            return false;
+        }
+        w->have_last = true;
+        w->utc = batch->flags[i] & CSI_FRAME_FLAG_UTC;
+        w->last_timestamp = batch->timestamp[i];
+
+        uint32_t r = w->group_rows;
+        ((uint64_t *)w->column[CSI_ARCHIVE_COL_TIMESTAMP])[r] = batch->timestamp[i];
+        ((uint32_t *)w->column[CSI_ARCHIVE_COL_SEQUENCE])[r] = batch->sequence[i];
+        ((int8_t *)w->column[CSI_ARCHIVE_COL_RSSI])[r] = batch->rssi[i];
+        w->column[CSI_ARCHIVE_COL_CHANNEL][r] = batch->channel[i];
+        w->column[CSI_ARCHIVE_COL_SECONDARY_CHANNEL][r] = batch->secondary_channel[i];
+        w->column[CSI_ARCHIVE_COL_SUBCARRIER_COUNT][r] = batch->subcarrier_count[i];
+        w->column[CSI_ARCHIVE_COL_FLAGS][r] = batch->flags[i];
+        memcpy(w->column[CSI_ARCHIVE_COL_MAC] + 6 * r, batch->mac + 6 * (size_t)i, 6);
+        memcpy(w->column[CSI_ARCHIVE_COL_IQ] + (size_t)CSI_INGEST_IQ_STRIDE * r,
+               batch->iq + (size_t)CSI_INGEST_IQ_STRIDE * i, CSI_INGEST_IQ_STRIDE);
+
+        int16_t *amplitude = (int16_t *)w->column[CSI_ARCHIVE_COL_AMPLITUDE] + (size_t)CSI_MAX_SUBCARRIERS * r;
+        int16_t *phase = (int16_t *)w->column[CSI_ARCHIVE_COL_PHASE] + (size_t)CSI_MAX_SUBCARRIERS * r;
+        const float *amplitude_in = batch->amplitude + (size_t)CSI_MAX_SUBCARRIERS * i;
+        const float *phase_in = batch->phase + (size_t)CSI_MAX_SUBCARRIERS * i;
+        for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+            amplitude[k] = quantize(amplitude_in[k], CSI_ARCHIVE_AMPLITUDE_SCALE);
+            phase[k] = quantize(phase_in[k], CSI_ARCHIVE_PHASE_SCALE);
+        }
+
+        if (++w->group_rows == w->config.group_rows && !flush_group(w)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t csi_archive_writer_rows(const csi_archive_writer_t *writer)
+{
+    return writer->rows + writer->group_rows;
+}
+
+bool csi_archive_writer_close(csi_archive_writer_t *w)
+{
+    bool ok = !w->failed && flush_group(w);
+    if (ok) {
+        segment_footer_t footer = {
+            .index_offset = w->offset,
+            .rows = w->rows,
+            .groups = w->groups,
+            .crc = archive_crc32(w->group_offset, w->groups * sizeof(uint64_t)),
+            .magic = FOOTER_MAGIC,
+            .version = CSI_ARCHIVE_VERSION,
+        };
+        ok = write_all(w, w->group_offset, w->groups * sizeof(uint64_t)) &&
+             write_all(w, &footer, sizeof(footer));
+    }
+    if (close(w->fd) != 0) {
+        ok = false;
+    }
+    free(w->column[0]);
+    free(w->group_offset);
+    free(w);
+    return ok;
+}
+
+size_t csi_archive_column_stride(csi_archive_column_t column)
+{
+    return (size_t)g_column_shape[column].width * g_column_shape[column].per_row;
+}
+
+const char *csi_archive_column_name(csi_archive_column_t column)
+{
+    static const char *const names[CSI_ARCHIVE_COLUMNS] = {
+        [CSI_ARCHIVE_COL_TIMESTAMP] = "timestamp",
+        [CSI_ARCHIVE_COL_SEQUENCE] = "sequence",
+        [CSI_ARCHIVE_COL_RSSI] = "rssi",
+        [CSI_ARCHIVE_COL_CHANNEL] = "channel",
+        [CSI_ARCHIVE_COL_SECONDARY_CHANNEL] = "secondary_channel",
+        [CSI_ARCHIVE_COL_SUBCARRIER_COUNT] = "subcarrier_count",
+        [CSI_ARCHIVE_COL_FLAGS] = "flags",
+        [CSI_ARCHIVE_COL_MAC] = "mac",
+        [CSI_ARCHIVE_COL_IQ] = "iq",
+        [CSI_ARCHIVE_COL_AMPLITUDE] = "amplitude",
+        [CSI_ARCHIVE_COL_PHASE] = "phase",
+    };
+    return (unsigned)column < CSI_ARCHIVE_COLUMNS ? names[column] : "unknown";
+}
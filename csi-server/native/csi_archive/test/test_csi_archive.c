@@ -0,0 +1,701 @@
+/**
+ * @file test_csi_archive.c
+ * @brief Unit tests for the CSI archive writer, reader, store and converters
+ */
+
+#define _GNU_SOURCE
+#include <unity.h>
+#include <errno.h>
+#include <ftw.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "csi_archive.h"
+#include "csi_archive_format.h"
+
+#define MAX_ROWS    256
+
+/**
+ * @brief Columns of the batches handed to the writer
+ */
+static struct {
+    uint32_t sequence[MAX_ROWS];
+    uint64_t timestamp[MAX_ROWS];
+    uint8_t mac[MAX_ROWS * 6];
+    int8_t rssi[MAX_ROWS];
+    uint8_t channel[MAX_ROWS];
+    uint8_t secondary_channel[MAX_ROWS];
+    uint8_t subcarrier_count[MAX_ROWS];
+    uint8_t flags[MAX_ROWS];
+    int8_t iq[MAX_ROWS * CSI_INGEST_IQ_STRIDE];
+    float amplitude[MAX_ROWS * CSI_MAX_SUBCARRIERS];
+    float phase[MAX_ROWS * CSI_MAX_SUBCARRIERS];
+} s_rows;
+
+static char s_dir[64];
+static char s_path[256];
+static uint8_t s_scratch[MAX_ROWS * CSI_INGEST_IQ_STRIDE] __attribute__((aligned(8)));
+
+static csi_ingest_batch_t make_batch(const char *node, uint32_t count, uint64_t start, uint64_t step, uint8_t flags)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        s_rows.sequence[i] = 100 + i;
+        s_rows.timestamp[i] = start + i * step;
+        memcpy(s_rows.mac + 6 * i, (const uint8_t[]){ 0x24, 0x0A, 0xC4, 0, 0, (uint8_t)(i % 3) }, 6);
+        s_rows.rssi[i] = (int8_t)(-40 - (int)(i % 20));
+        s_rows.channel[i] = 6;
+        s_rows.secondary_channel[i] = 0;
+        s_rows.subcarrier_count[i] = CSI_MAX_SUBCARRIERS;
+        s_rows.flags[i] = flags;
+        for (int k = 0; k < CSI_INGEST_IQ_STRIDE; k++) {
+            s_rows.iq[i * CSI_INGEST_IQ_STRIDE + k] = (int8_t)(((k * 37 + i * 11) % 97) - 48);
+        }
+        for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+            int real = s_rows.iq[i * CSI_INGEST_IQ_STRIDE + 2 * k];
+            int imag = s_rows.iq[i * CSI_INGEST_IQ_STRIDE + 2 * k + 1];
+            s_rows.amplitude[i * CSI_MAX_SUBCARRIERS + k] = sqrtf(real * real + imag * imag);
+            s_rows.phase[i * CSI_MAX_SUBCARRIERS + k] = atan2f(imag, real);
+        }
+    }
+    return (csi_ingest_batch_t){
+        .node = node,
+        .count = count,
+        .sequence = s_rows.sequence,
+        .timestamp = s_rows.timestamp,
+        .mac = s_rows.mac,
+        .rssi = s_rows.rssi,
+        .channel = s_rows.channel,
+        .secondary_channel = s_rows.secondary_channel,
+        .subcarrier_count = s_rows.subcarrier_count,
+        .flags = s_rows.flags,
+        .iq = s_rows.iq,
+        .amplitude = s_rows.amplitude,
+        .phase = s_rows.phase,
+    };
+}
+
+static void write_segment(const char *path, uint32_t rows, uint32_t group_rows, bool compress)
+{
+    csi_archive_writer_config_t config = { .group_rows = group_rows, .compress = compress };
+    csi_archive_writer_t *writer = csi_archive_writer_create(path, "node-1", &config);
+    TEST_ASSERT_NOT_NULL(writer);
+    csi_ingest_batch_t batch = make_batch("node-1", rows, 1000, 10, CSI_FRAME_FLAG_RAW);
+    TEST_ASSERT_TRUE(csi_archive_writer_append(writer, &batch, 0, rows));
+    TEST_ASSERT_EQUAL_UINT64(rows, csi_archive_writer_rows(writer));
+    TEST_ASSERT_TRUE(csi_archive_writer_close(writer));
+}
+
+/**
+ * @brief Rows of a segment across all groups
+ */
+static uint64_t segment_rows(const char *path)
+{
+    csi_archive_reader_t *reader = csi_archive_reader_open(path);
+    if (!reader) {
+        return 0;
+    }
+    uint64_t rows = csi_archive_reader_info(reader)->rows;
+    csi_archive_reader_close(reader);
+    return rows;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+void setUp(void)
+{
+    snprintf(s_dir, sizeof(s_dir), "/tmp/csi_archive_test_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(s_dir));
+    snprintf(s_path, sizeof(s_path), "%s/segment" CSI_ARCHIVE_SUFFIX, s_dir);
+}
+
+void tearDown(void)
+{
+    nftw(s_dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+/**
+ * @brief Test that each codec round-trips and the smallest is picked
+ */
+static void test_csi_archive_codecs(void)
+{
+    static uint8_t data[MAX_ROWS * CSI_INGEST_IQ_STRIDE];
+    static uint8_t encoded[MAX_ROWS * CSI_INGEST_IQ_STRIDE];
+    static uint8_t decoded[MAX_ROWS * CSI_INGEST_IQ_STRIDE];
+    csi_archive_codec_t codec;
+
+    // Regular timestamps: two bytes per row
+    uint64_t *ts = (uint64_t *)data;
+    for (int i = 0; i < 100; i++) {
+        ts[i] = 1700000000000000ULL + i * 5000 + (i % 3);
+    }
+    size_t n = archive_encode(CSI_ARCHIVE_COL_TIMESTAMP, 100, data, encoded, true, &codec);
+    TEST_ASSERT_EQUAL(CSI_ARCHIVE_CODEC_DELTA, codec);
+    TEST_ASSERT_LESS_OR_EQUAL(8 + 99 * 2 + 2, n);
+    TEST_ASSERT_TRUE(archive_decode(CSI_ARCHIVE_COL_TIMESTAMP, 100, codec, encoded, n, decoded));
+    TEST_ASSERT_EQUAL_MEMORY(data, decoded, 100 * sizeof(uint64_t));
+    TEST_ASSERT_FALSE(archive_decode(CSI_ARCHIVE_COL_TIMESTAMP, 100, codec, encoded, n - 1, decoded));
+    TEST_ASSERT_EQUAL(3, archive_seek_timestamp(100, codec, encoded, n, ts[2] + 1));
+    TEST_ASSERT_EQUAL(100, archive_seek_timestamp(100, codec, encoded, n, ts[99] + 1));
+
+    // Wrapping deltas of narrow elements
+    int16_t *amp = (int16_t *)data;
+    for (int i = 0; i < 64 * 10; i++) {
+        amp[i] = (int16_t)(i % 2 ? INT16_MAX - i : INT16_MIN + i);
+    }
+    n = archive_encode(CSI_ARCHIVE_COL_AMPLITUDE, 10, data, encoded, true, &codec);
+    TEST_ASSERT_TRUE(archive_decode(CSI_ARCHIVE_COL_AMPLITUDE, 10, codec, encoded, n, decoded));
+    TEST_ASSERT_EQUAL_MEMORY(data, decoded, 10 * 64 * sizeof(int16_t));
+
+    // The same channel in every row
+    memset(data, 6, 50);
+    n = archive_encode(CSI_ARCHIVE_COL_CHANNEL, 50, data, encoded, true, &codec);
+    TEST_ASSERT_EQUAL(CSI_ARCHIVE_CODEC_CONST, codec);
+    TEST_ASSERT_EQUAL(1, n);
+    TEST_ASSERT_TRUE(archive_decode(CSI_ARCHIVE_COL_CHANNEL, 50, codec, encoded, n, decoded));
+    TEST_ASSERT_EQUAL_MEMORY(data, decoded, 50);
+
+    // Noise does not compress and stays raw
+    uint32_t rng = 1;
+    for (int i = 0; i < 20 * CSI_INGEST_IQ_STRIDE; i++) {
+        rng = rng * 1103515245u + 12345u;
+        data[i] = (uint8_t)(rng >> 16);
+    }
+    n = archive_encode(CSI_ARCHIVE_COL_IQ, 20, data, encoded, true, &codec);
+    TEST_ASSERT_EQUAL(CSI_ARCHIVE_CODEC_RAW, codec);
+    TEST_ASSERT_EQUAL(20 * CSI_INGEST_IQ_STRIDE, n);
+
+    // Compression off
+    memset(data, 6, 50);
+    archive_encode(CSI_ARCHIVE_COL_CHANNEL, 50, data, encoded, false, &codec);
+    TEST_ASSERT_EQUAL(CSI_ARCHIVE_CODEC_RAW, codec);
+}
+
+/**
+ * @brief Test that every column reads back as written
+ */
+static void test_csi_archive_round_trip(void)
+{
+    write_segment(s_path, 40, 16, true);
+    csi_ingest_batch_t batch = make_batch("node-1", 40, 1000, 10, CSI_FRAME_FLAG_RAW);
+
+    csi_archive_reader_t *reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_NOT_NULL(reader);
+    const csi_archive_info_t *info = csi_archive_reader_info(reader);
+    TEST_ASSERT_EQUAL_STRING("node-1", info->node);
+    TEST_ASSERT_FALSE(info->utc);
+    TEST_ASSERT_FALSE(info->recovered);
+    TEST_ASSERT_EQUAL_UINT32(3, info->groups);
+    TEST_ASSERT_EQUAL_UINT64(40, info->rows);
+    TEST_ASSERT_EQUAL_UINT64(1000, info->first_timestamp);
+    TEST_ASSERT_EQUAL_UINT64(1390, info->last_timestamp);
+
+    csi_archive_group_t group;
+    TEST_ASSERT_TRUE(csi_archive_reader_group(reader, 2, &group));
+    TEST_ASSERT_EQUAL_UINT32(8, group.rows);
+    TEST_ASSERT_EQUAL_UINT64(32, group.first_row);
+    TEST_ASSERT_EQUAL(CSI_ARCHIVE_CODEC_CONST, group.codec[CSI_ARCHIVE_COL_CHANNEL]);
+    TEST_ASSERT_EQUAL(CSI_ARCHIVE_CODEC_DELTA, group.codec[CSI_ARCHIVE_COL_TIMESTAMP]);
+    TEST_ASSERT_FALSE(csi_archive_reader_group(reader, 3, &group));
+
+    for (uint32_t g = 0; g < 3; g++) {
+        TEST_ASSERT_TRUE(csi_archive_reader_group(reader, g, &group));
+        uint32_t first = (uint32_t)group.first_row;
+        const void *col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_TIMESTAMP, s_scratch);
+        TEST_ASSERT_EQUAL_MEMORY(batch.timestamp + first, col, group.rows * sizeof(uint64_t));
+        col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_SEQUENCE, s_scratch);
+        TEST_ASSERT_EQUAL_MEMORY(batch.sequence + first, col, group.rows * sizeof(uint32_t));
+        col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_RSSI, s_scratch);
+        TEST_ASSERT_EQUAL_MEMORY(batch.rssi + first, col, group.rows);
+        col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_MAC, s_scratch);
+        TEST_ASSERT_EQUAL_MEMORY(batch.mac + 6 * first, col, 6 * group.rows);
+        col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_IQ, s_scratch);
+        TEST_ASSERT_EQUAL_MEMORY(batch.iq + CSI_INGEST_IQ_STRIDE * first, col, CSI_INGEST_IQ_STRIDE * group.rows);
+        col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_FLAGS, s_scratch);
+        TEST_ASSERT_EQUAL_UINT8(CSI_FRAME_FLAG_RAW, ((const uint8_t *)col)[group.rows - 1]);
+
+        float values[MAX_ROWS * CSI_MAX_SUBCARRIERS];
+        col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_AMPLITUDE, s_scratch);
+        TEST_ASSERT_NOT_NULL(col);
+        csi_archive_to_float(col, group.rows * CSI_MAX_SUBCARRIERS, CSI_ARCHIVE_AMPLITUDE_SCALE, values);
+        for (uint32_t k = 0; k < group.rows * CSI_MAX_SUBCARRIERS; k++) {
+            TEST_ASSERT_FLOAT_WITHIN(0.51f / CSI_ARCHIVE_AMPLITUDE_SCALE, batch.amplitude[first * CSI_MAX_SUBCARRIERS + k],
+                                     values[k]);
+        }
+        col = csi_archive_reader_column(reader, g, CSI_ARCHIVE_COL_PHASE, s_scratch);
+        TEST_ASSERT_NOT_NULL(col);
+        csi_archive_to_float(col, group.rows * CSI_MAX_SUBCARRIERS, CSI_ARCHIVE_PHASE_SCALE, values);
+        for (uint32_t k = 0; k < group.rows * CSI_MAX_SUBCARRIERS; k++) {
+            TEST_ASSERT_FLOAT_WITHIN(0.51f / CSI_ARCHIVE_PHASE_SCALE, batch.phase[first * CSI_MAX_SUBCARRIERS + k],
+                                     values[k]);
+        }
+    }
+    csi_archive_reader_close(reader);
+}
+
+/**
+ * @brief Test that raw chunks are read in place and encoded ones need scratch
+ */
+static void test_csi_archive_zero_copy(void)
+{
+    write_segment(s_path, 32, 32, false);
+    csi_ingest_batch_t batch = make_batch("node-1", 32, 1000, 10, CSI_FRAME_FLAG_RAW);
+
+    csi_archive_reader_t *reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_NOT_NULL(reader);
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        const void *col = csi_archive_reader_column(reader, 0, c, NULL);
+        TEST_ASSERT_NOT_NULL(col);
+        TEST_ASSERT_EQUAL(0, (uintptr_t)col % 8);
+    }
+    const int8_t *iq = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_IQ, NULL);
+    TEST_ASSERT_EQUAL_MEMORY(batch.iq, iq, 32 * CSI_INGEST_IQ_STRIDE);
+    csi_archive_reader_close(reader);
+
+    // The same data compressed: the timestamp chunk has to be decoded
+    unlink(s_path);
+    write_segment(s_path, 32, 32, true);
+    reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_NULL(csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_TIMESTAMP, NULL));
+    TEST_ASSERT_EQUAL(32 * sizeof(uint64_t), csi_archive_reader_column_bytes(reader, 0, CSI_ARCHIVE_COL_TIMESTAMP));
+    TEST_ASSERT_NOT_NULL(csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_TIMESTAMP, s_scratch));
+    TEST_ASSERT_NULL(csi_archive_reader_column(reader, 1, CSI_ARCHIVE_COL_TIMESTAMP, s_scratch));
+    csi_archive_reader_close(reader);
+}
+
+/**
+ * @brief Test time-range seeks within and across groups
+ */
+static void test_csi_archive_seek(void)
+{
+    write_segment(s_path, 40, 16, true);
+    csi_archive_reader_t *reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_NOT_NULL(reader);
+
+    uint32_t group = 99, row = 99;
+    TEST_ASSERT_TRUE(csi_archive_reader_seek(reader, 0, &group, &row));
+    TEST_ASSERT_EQUAL_UINT32(0, group);
+    TEST_ASSERT_EQUAL_UINT32(0, row);
+    TEST_ASSERT_TRUE(csi_archive_reader_seek(reader, 1005, &group, &row));
+    TEST_ASSERT_EQUAL_UINT32(0, group);
+    TEST_ASSERT_EQUAL_UINT32(1, row);
+    TEST_ASSERT_TRUE(csi_archive_reader_seek(reader, 1151, &group, &row));    // After the last row of group 0
+    TEST_ASSERT_EQUAL_UINT32(1, group);
+    TEST_ASSERT_EQUAL_UINT32(0, row);
+    TEST_ASSERT_TRUE(csi_archive_reader_seek(reader, 1390, &group, &row));
+    TEST_ASSERT_EQUAL_UINT32(2, group);
+    TEST_ASSERT_EQUAL_UINT32(7, row);
+    TEST_ASSERT_FALSE(csi_archive_reader_seek(reader, 1391, &group, &row));
+    csi_archive_reader_close(reader);
+
+    // Uncompressed timestamps are searched in place
+    unlink(s_path);
+    write_segment(s_path, 40, 16, false);
+    reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_TRUE(csi_archive_reader_seek(reader, 1205, &group, &row));
+    TEST_ASSERT_EQUAL_UINT32(1, group);
+    TEST_ASSERT_EQUAL_UINT32(5, row);
+    csi_archive_reader_close(reader);
+}
+
+/**
+ * @brief Test reading a segment whose writer died, and rejecting other files
+ */
+static void test_csi_archive_recovery(void)
+{
+    write_segment(s_path, 40, 16, true);
+    csi_archive_reader_t *reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_NOT_NULL(reader);
+    csi_archive_group_t last;
+    TEST_ASSERT_TRUE(csi_archive_reader_group(reader, 2, &last));
+    csi_archive_reader_close(reader);
+
+    // Cut into the last group: footer and that group are lost
+    FILE *f = fopen(s_path, "r+");
+    TEST_ASSERT_NOT_NULL(f);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    TEST_ASSERT_EQUAL(0, truncate(s_path, size - (long)sizeof(segment_footer_t) - 8 * 3 - 40));
+
+    reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_TRUE(csi_archive_reader_info(reader)->recovered);
+    TEST_ASSERT_EQUAL_UINT32(2, csi_archive_reader_info(reader)->groups);
+    TEST_ASSERT_EQUAL_UINT64(32, csi_archive_reader_info(reader)->rows);
+    TEST_ASSERT_EQUAL_UINT64(1310, csi_archive_reader_info(reader)->last_timestamp);
+    TEST_ASSERT_NOT_NULL(csi_archive_reader_column(reader, 1, CSI_ARCHIVE_COL_PHASE, s_scratch));
+    csi_archive_reader_close(reader);
+
+    // A corrupt descriptor ends the scan there
+    f = fopen(s_path, "r+");
+    fseek(f, sizeof(segment_header_t) + offsetof(group_desc_t, rows), SEEK_SET);
+    fputc(0x55, f);
+    fclose(f);
+    reader = csi_archive_reader_open(s_path);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_UINT32(0, csi_archive_reader_info(reader)->groups);
+    csi_archive_reader_close(reader);
+
+    // Not a segment
+    f = fopen(s_path, "w");
+    for (int i = 0; i < 200; i++) {
+        fputc('x', f);
+    }
+    fclose(f);
+    errno = 0;
+    TEST_ASSERT_NULL(csi_archive_reader_open(s_path));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+}
+
+/**
+ * @brief Test that a segment refuses time going backwards and mixed clocks
+ */
+static void test_csi_archive_writer_order(void)
+{
+    csi_archive_writer_t *writer = csi_archive_writer_create(s_path, "node-1", NULL);
+    TEST_ASSERT_NOT_NULL(writer);
+    TEST_ASSERT_NULL(csi_archive_writer_create(s_path, "node-1", NULL));
+    TEST_ASSERT_EQUAL(EEXIST, errno);
+
+    csi_ingest_batch_t batch = make_batch("node-1", 10, 5000, 10, CSI_FRAME_FLAG_RAW);
+    TEST_ASSERT_TRUE(csi_archive_writer_append(writer, &batch, 5, 5));
+    TEST_ASSERT_FALSE(csi_archive_writer_accepts(writer, 5000, CSI_FRAME_FLAG_RAW));
+    TEST_ASSERT_TRUE(csi_archive_writer_accepts(writer, 5090, CSI_FRAME_FLAG_RAW));
+    TEST_ASSERT_FALSE(csi_archive_writer_accepts(writer, 6000, CSI_FRAME_FLAG_UTC));
+    errno = 0;
+    TEST_ASSERT_FALSE(csi_archive_writer_append(writer, &batch, 0, 1));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+    TEST_ASSERT_EQUAL_UINT64(5, csi_archive_writer_rows(writer));
+    TEST_ASSERT_TRUE(csi_archive_writer_close(writer));
+    TEST_ASSERT_EQUAL_UINT64(5, segment_rows(s_path));
+}
+
+/**
+ * @brief Test partitioning, restarts, node names and the open segment limit
+ */
+static void test_csi_archive_store(void)
+{
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    config.dir = s_dir;
+    config.partition_us = 1000000;
+    config.writer.group_rows = 16;
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    TEST_ASSERT_NOT_NULL(store);
+
+    // 0.0-2.5 s in steps of 50 ms: three partitions
+    csi_ingest_batch_t batch = make_batch("room/a", 50, 0, 50000, CSI_FRAME_FLAG_RAW);
+    TEST_ASSERT_TRUE(csi_archive_store_append(store, &batch));
+    // Restart: uptime starts over and lands in a second segment of partition 0
+    batch = make_batch("room/a", 10, 100000, 50000, CSI_FRAME_FLAG_RAW);
+    TEST_ASSERT_TRUE(csi_archive_store_append(store, &batch));
+
+    csi_archive_store_stats_t stats;
+    csi_archive_store_get_stats(store, &stats);
+    TEST_ASSERT_EQUAL_UINT64(60, stats.rows);
+    TEST_ASSERT_EQUAL_UINT64(4, stats.segments);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.open_segments);
+    TEST_ASSERT_TRUE(csi_archive_store_close(store));
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/room%%2Fa/0" CSI_ARCHIVE_SUFFIX, s_dir);
+    TEST_ASSERT_EQUAL_UINT64(20, segment_rows(path));
+    snprintf(path, sizeof(path), "%s/room%%2Fa/1000000" CSI_ARCHIVE_SUFFIX, s_dir);
+    TEST_ASSERT_EQUAL_UINT64(20, segment_rows(path));
+    snprintf(path, sizeof(path), "%s/room%%2Fa/2000000" CSI_ARCHIVE_SUFFIX, s_dir);
+    TEST_ASSERT_EQUAL_UINT64(10, segment_rows(path));
+    snprintf(path, sizeof(path), "%s/room%%2Fa/0-1" CSI_ARCHIVE_SUFFIX, s_dir);
+    TEST_ASSERT_EQUAL_UINT64(10, segment_rows(path));
+
+    csi_archive_reader_t *reader = csi_archive_reader_open(path);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_STRING("room/a", csi_archive_reader_info(reader)->node);
+    csi_archive_reader_close(reader);
+
+    // One open segment for two nodes: each switch closes the other's
+    config.max_open = 1;
+    config.partition_us = 3600ULL * 1000000;
+    store = csi_archive_store_open(&config);
+    TEST_ASSERT_NOT_NULL(store);
+    for (int round = 0; round < 3; round++) {
+        batch = make_batch("b", 5, 1000000 + round * 1000, 10, CSI_FRAME_FLAG_RAW);
+        TEST_ASSERT_TRUE(csi_archive_store_append(store, &batch));
+        batch = make_batch("c", 5, 1000000 + round * 1000, 10, CSI_FRAME_FLAG_RAW);
+        TEST_ASSERT_TRUE(csi_archive_store_append(store, &batch));
+    }
+    csi_archive_store_get_stats(store, &stats);
+    TEST_ASSERT_EQUAL_UINT64(30, stats.rows);
+    TEST_ASSERT_EQUAL_UINT64(6, stats.segments);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.open_segments);
+    TEST_ASSERT_TRUE(csi_archive_store_close(store));
+    snprintf(path, sizeof(path), "%s/b/0-2" CSI_ARCHIVE_SUFFIX, s_dir);
+    TEST_ASSERT_EQUAL_UINT64(5, segment_rows(path));
+
+    char name[3 * CSI_INGEST_MAX_NODE_LEN + 1];
+    csi_archive_node_dir("..", name);
+    TEST_ASSERT_EQUAL_STRING("%2E.", name);
+    csi_archive_node_dir("node-1.lab_2", name);
+    TEST_ASSERT_EQUAL_STRING("node-1.lab_2", name);
+}
+
+/**
+ * @brief Test converting ESP32-CSI-Tool CSV
+ */
+static void test_csi_archive_convert_csv(void)
+{
+    static char csv[4096];
+    char *p = csv;
+    p += sprintf(p, "type,role,mac,rssi,rate,sig_mode,mcs,bandwidth,smoothing,not_sounding,aggregation,stbc,"
+                 "fec_coding,sgi,noise_floor,ampdu_cnt,channel,secondary_channel,local_timestamp,ant,sig_len,"
+                 "rx_state,real_time_set,real_timestamp,len,CSI_DATA\n");
+    p += sprintf(p, "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,4294967000,0,128,0,0,0.0,8,"
+                 "[3 4 -6 8 0 0 5 12]\n");
+    p += sprintf(p, "I (1234) wifi: some log output\n");
+    p += sprintf(p, "CSI_DATA,STA,24:0A:C4:00:00:01,-53,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,200,0,128,0,0,0.0,4,"
+                 "\"[1 -1 2 2]\"\r\n");
+    p += sprintf(p, "CSI_DATA,STA,24:0A:C4");
+
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    config.dir = s_dir;
+    config.partition_us = 1ULL << 40;
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    TEST_ASSERT_NOT_NULL(store);
+    FILE *input = fmemopen(csv, strlen(csv), "r");
+    csi_archive_convert_stats_t stats;
+    TEST_ASSERT_TRUE(csi_archive_convert(input, CSI_ARCHIVE_INPUT_AUTO, "esp", store, &stats));
+    fclose(input);
+    TEST_ASSERT_TRUE(csi_archive_store_close(store));
+    TEST_ASSERT_EQUAL_UINT64(5, stats.lines);
+    TEST_ASSERT_EQUAL_UINT64(2, stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(3, stats.skipped);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/esp/0" CSI_ARCHIVE_SUFFIX, s_dir);
+    csi_archive_reader_t *reader = csi_archive_reader_open(path);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_UINT64(2, csi_archive_reader_info(reader)->rows);
+
+    // local_timestamp wrapped between the lines
+    const uint64_t *ts = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_TIMESTAMP, s_scratch);
+    TEST_ASSERT_EQUAL_UINT64(4294967000ULL, ts[0]);
+    TEST_ASSERT_EQUAL_UINT64((1ULL << 32) + 200, ts[1]);
+    const int8_t *rssi = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_RSSI, s_scratch);
+    TEST_ASSERT_EQUAL_INT8(-53, rssi[1]);
+    const uint8_t *count = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_SUBCARRIER_COUNT, s_scratch);
+    TEST_ASSERT_EQUAL_UINT8(4, count[0]);
+    TEST_ASSERT_EQUAL_UINT8(2, count[1]);
+    const int8_t *iq = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_IQ, s_scratch);
+    TEST_ASSERT_EQUAL_INT8_ARRAY(((const int8_t[]){ 3, 4, -6, 8, 0, 0, 5, 12, 0 }), iq, 9);
+    const int16_t *amplitude = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_AMPLITUDE, s_scratch);
+    TEST_ASSERT_EQUAL(5 * (int)CSI_ARCHIVE_AMPLITUDE_SCALE, amplitude[0]);
+    TEST_ASSERT_EQUAL(10 * (int)CSI_ARCHIVE_AMPLITUDE_SCALE, amplitude[1]);
+    TEST_ASSERT_EQUAL(13 * (int)CSI_ARCHIVE_AMPLITUDE_SCALE, amplitude[3]);
+    TEST_ASSERT_EQUAL(0, amplitude[4]);
+    csi_archive_reader_close(reader);
+}
+
+/**
+ * @brief Contents of a file, NULL if it cannot be read
+ */
+static char *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = (size_t)ftell(f);
+    rewind(f);
+    char *data = malloc(*size + 1);
+    if (data && fread(data, 1, *size, f) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+/**
+ * @brief Test that the parallel CSV converter writes what the sequential one does
+ */
+static void test_csi_archive_convert_csv_parallel(void)
+{
+    // Lines as ESP32-CSI-Tool writes them, and lines only the scalar parser takes or rejects
+    static const char *const odd[] = {
+        "CSI_DATA,STA,24:0a:c4:00:00:02,-60,11,1,7,0,0,0,0,0,0,0,-92,0,11,1,%d,0,128,0,0,0.0,4,\"[1 -1 2 2]\"\r\n",
+        "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,6,[1  2 +3 007 -0 5]\n",
+        "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,4,[1 2 200 4 ]\n",
+        "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,4,[1 2 -1000 4 ]\n",
+        "CSI_DATA,STA,24:0A:C4:00:00:01, -52,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,2,[9 -9]\n",
+        "CSI_DATA,STA,24:A:C4:0:0:1,-53,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,2,[-128 127 ]\n",
+        "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,0,[]\n",
+        "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d\n",
+        "I (1234) wifi: some log output %d\n",
+        "\r\n",
+    };
+    char csv_path[256];
+    snprintf(csv_path, sizeof(csv_path), "%s/capture.csv", s_dir);
+    FILE *f = fopen(csv_path, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "type,role,mac,rssi,rate,sig_mode,mcs,bandwidth,smoothing,not_sounding,aggregation,stbc,"
+               "fec_coding,sgi,noise_floor,ampdu_cnt,channel,secondary_channel,local_timestamp,ant,sig_len,"
+               "rx_state,real_time_set,real_timestamp,len,CSI_DATA\n");
+    // local_timestamp printed with %d, so it goes negative, and wraps twice
+    uint32_t ts = 4000000000u;
+    for (int line = 0; line < 3000; line++, ts += 3000000) {
+        if (line % 7 == 3) {
+            fprintf(f, odd[(line / 7) % (sizeof(odd) / sizeof(odd[0]))], (int32_t)ts);
+            continue;
+        }
+        fprintf(f, "CSI_DATA,STA,24:0A:C4:00:00:%02X,%d,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,128,[",
+                line % 3, -40 - line % 50, (int32_t)ts);
+        for (int k = 0; k < 128; k++) {
+            fprintf(f, "%d ", (int8_t)((k * 37 + line * 11) % 256));
+        }
+        fprintf(f, "]\n");
+    }
+    fprintf(f, "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,5,0,128,0,0,0.0,2,[3 4]");
+    fclose(f);
+
+    char seq_dir[256], par_dir[256];
+    snprintf(seq_dir, sizeof(seq_dir), "%s/seq", s_dir);
+    snprintf(par_dir, sizeof(par_dir), "%s/par", s_dir);
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    config.partition_us = 1ULL << 40;
+    config.writer.group_rows = 100;
+
+    config.dir = seq_dir;
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    TEST_ASSERT_NOT_NULL(store);
+    FILE *input = fopen(csv_path, "r");
+    csi_archive_convert_stats_t seq;
+    TEST_ASSERT_TRUE(csi_archive_convert(input, CSI_ARCHIVE_INPUT_CSV, "esp", store, &seq));
+    fclose(input);
+    TEST_ASSERT_TRUE(csi_archive_store_close(store));
+
+    config.dir = par_dir;
+    store = csi_archive_store_open(&config);
+    TEST_ASSERT_NOT_NULL(store);
+    csi_archive_csv_config_t csv = { .workers = 3, .chunk_bytes = 4096 };
+    csi_archive_convert_stats_t par;
+    TEST_ASSERT_TRUE(csi_archive_convert_file(csv_path, CSI_ARCHIVE_INPUT_AUTO, "esp", &csv, store, &par));
+    TEST_ASSERT_TRUE(csi_archive_store_close(store));
+
+    TEST_ASSERT_EQUAL_UINT64(3002, seq.lines);
+    TEST_ASSERT_EQUAL_UINT64(seq.lines, par.lines);
+    TEST_ASSERT_EQUAL_UINT64(seq.frames, par.frames);
+    TEST_ASSERT_EQUAL_UINT64(seq.skipped, par.skipped);
+    TEST_ASSERT_TRUE(seq.frames > 2500);
+
+    char seq_path[512], par_path[512];
+    snprintf(seq_path, sizeof(seq_path), "%s/esp/0" CSI_ARCHIVE_SUFFIX, seq_dir);
+    snprintf(par_path, sizeof(par_path), "%s/esp/0" CSI_ARCHIVE_SUFFIX, par_dir);
+    size_t seq_size = 0, par_size = 0;
+    char *seq_data = read_file(seq_path, &seq_size);
+    char *par_data = read_file(par_path, &par_size);
+    TEST_ASSERT_NOT_NULL(seq_data);
+    TEST_ASSERT_NOT_NULL(par_data);
+    TEST_ASSERT_EQUAL_UINT64(seq_size, par_size);
+    TEST_ASSERT_EQUAL_MEMORY(seq_data, par_data, seq_size);
+    free(seq_data);
+    free(par_data);
+    TEST_ASSERT_EQUAL_UINT64(seq.frames, segment_rows(par_path));
+
+    // Parse only
+    csi_archive_convert_stats_t counted;
+    TEST_ASSERT_TRUE(csi_archive_convert_file(csv_path, CSI_ARCHIVE_INPUT_CSV, "esp", NULL, NULL, &counted));
+    TEST_ASSERT_EQUAL_UINT64(seq.frames, counted.frames);
+
+    // A JSON line makes auto read the file line by line
+    f = fopen(csv_path, "a");
+    fprintf(f, "\n{\"seq\":1,\"timestamp\":1000,\"mac\":\"24:0A:C4:00:00:01\",\"rssi\":-50,\"channel\":6,"
+               "\"secondary_channel\":0,\"subcarrier_count\":1,\"amplitude\":[1],\"phase\":[0]}\n");
+    fclose(f);
+    TEST_ASSERT_FALSE(csi_archive_convert_file(csv_path, CSI_ARCHIVE_INPUT_AUTO, "esp", NULL, NULL, &counted));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+    config.dir = par_dir;
+    store = csi_archive_store_open(&config);
+    TEST_ASSERT_NOT_NULL(store);
+    TEST_ASSERT_TRUE(csi_archive_convert_file(csv_path, CSI_ARCHIVE_INPUT_AUTO, "json", &csv, store, &counted));
+    TEST_ASSERT_TRUE(csi_archive_store_close(store));
+    TEST_ASSERT_EQUAL_UINT64(seq.frames + 1, counted.frames);
+
+    errno = 0;
+    TEST_ASSERT_FALSE(csi_archive_convert_file("/nonexistent/capture.csv", CSI_ARCHIVE_INPUT_CSV, "esp", NULL,
+                                               NULL, &counted));
+    TEST_ASSERT_EQUAL(ENOENT, errno);
+}
+
+/**
+ * @brief Test converting firmware JSON, with and without topics
+ */
+static void test_csi_archive_convert_json(void)
+{
+    static const char json[] =
+        "node-a/csi_data {\"seq\":1,\"timestamp\":1000,\"mac\":\"24:0A:C4:00:00:01\",\"rssi\":-50,\"channel\":6,"
+        "\"secondary_channel\":0,\"subcarrier_count\":2,\"amplitude\":[1.5,2],\"phase\":[0.25,null]}\n"
+        "node-a/csi_drops {\"dropped\":3}\n"
+        "{\"seq\":7,\"timestamp\":2000,\"mac\":\"24:0A:C4:00:00:02\",\"rssi\":-60,\"channel\":1,"
+        "\"secondary_channel\":0,\"subcarrier_count\":1,\"amplitude\":[3],\"phase\":[-1]}\n"
+        "node-a/csi_data {\"seq\":2,\"timestamp\":1100,\"mac\":\"24:0A:C4:00:00:01\",\"rssi\":-51,\"channel\":6,"
+        "\"secondary_channel\":0,\"subcarrier_count\":0,\"amplitude\":[],\"phase\":[]}\n"
+        "node-a/csi_data {\"seq\":3,\"timestamp\":\n";
+
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    config.dir = s_dir;
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    TEST_ASSERT_NOT_NULL(store);
+    FILE *input = fmemopen((void *)json, strlen(json), "r");
+    csi_archive_convert_stats_t stats;
+    TEST_ASSERT_TRUE(csi_archive_convert(input, CSI_ARCHIVE_INPUT_JSON, "default", store, &stats));
+    fclose(input);
+    TEST_ASSERT_TRUE(csi_archive_store_close(store));
+    TEST_ASSERT_EQUAL_UINT64(5, stats.lines);
+    TEST_ASSERT_EQUAL_UINT64(3, stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(2, stats.skipped);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/node-a/0" CSI_ARCHIVE_SUFFIX, s_dir);
+    csi_archive_reader_t *reader = csi_archive_reader_open(path);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_UINT64(2, csi_archive_reader_info(reader)->rows);
+    const int16_t *phase = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_PHASE, s_scratch);
+    TEST_ASSERT_EQUAL(2048, phase[0]);
+    TEST_ASSERT_EQUAL(CSI_ARCHIVE_INT16_NAN, phase[1]);
+    float values[2];
+    csi_archive_to_float(phase, 2, CSI_ARCHIVE_PHASE_SCALE, values);
+    TEST_ASSERT_EQUAL_FLOAT(0.25f, values[0]);
+    TEST_ASSERT_TRUE(isnan(values[1]));
+    const uint8_t *flags = csi_archive_reader_column(reader, 0, CSI_ARCHIVE_COL_FLAGS, s_scratch);
+    TEST_ASSERT_EQUAL_UINT8(0, flags[0]);
+    csi_archive_reader_close(reader);
+
+    snprintf(path, sizeof(path), "%s/default/0" CSI_ARCHIVE_SUFFIX, s_dir);
+    TEST_ASSERT_EQUAL_UINT64(1, segment_rows(path));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_csi_archive_codecs);
+    RUN_TEST(test_csi_archive_round_trip);
+    RUN_TEST(test_csi_archive_zero_copy);
+    RUN_TEST(test_csi_archive_seek);
+    RUN_TEST(test_csi_archive_recovery);
+    RUN_TEST(test_csi_archive_writer_order);
+    RUN_TEST(test_csi_archive_store);
+    RUN_TEST(test_csi_archive_convert_csv);
+    RUN_TEST(test_csi_archive_convert_csv_parallel);
+    RUN_TEST(test_csi_archive_convert_json);
+
+    return UNITY_END();
+}
@@ -0,0 +1,142 @@
+/**
+ * @file csi_extract.h
+ * @brief Per-link CSI features, computed in parallel on a work-stealing pool
+ *
+ * Takes the batches csi_ingest decodes (csi_extract_sink() is a
+ * csi_ingest_sink_t) and computes, for every frame of every link (a node
+ * and the transmitter it hears):
+ *
+ *  - amplitude scaled to unit RMS, removing the receiver's gain,
+ *  - phase with the timing and carrier offsets removed,
+ *  - every `hop` frames, the variance of each subcarrier's amplitude over
+ *    the last `window` frames, and the magnitude spectrum of the link's
+ *    mean amplitude over the last fft_size frames.
+ *
+ * Each link is a strand of csi_sched.h: its frames are processed one at a
+ * time in the order they were pushed, while links run in parallel. The
+ * stages are the firmware's own kernels (csi_features.h), compiled the
+ * same way, so a node computing features itself gets the same bits.
+ *
+ * Links are created on first sight and kept for the engine's life;
+ * max_links bounds them. Frames of a link whose backlog is full are
+ * dropped and counted.
+ */
+
+#ifndef CSI_EXTRACT_H
+#define CSI_EXTRACT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "csi_ingest.h"
+#include "csi_features.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_EXTRACT_MAX_WINDOW  1024
+
+/**
+ * @brief Features of one frame
+ *
+ * Valid only during the output call.
+ */
+typedef struct {
+    const char *node;
+    const uint8_t *mac;                 ///< Transmitter, 6 bytes
+    uint64_t frame;                     ///< Frames of the link before this one
+    uint32_t sequence;
+    uint64_t timestamp;
+    uint8_t flags;                      ///< CSI_FRAME_FLAG_* bits
+    uint8_t subcarrier_count;
+    const float *amplitude;             ///< subcarrier_count values of unit RMS
+    const float *phase;                 ///< subcarrier_count values, offsets removed
+    const float *variance;              ///< subcarrier_count values on a hop with a full window, else NULL
+    const float *spectrum;              ///< spectrum_bins values on a hop with fft_size frames, else NULL
+    uint32_t spectrum_bins;             ///< fft_size / 2 + 1
+} csi_extract_features_t;
+
+/**
+ * @brief Consumer of features
+ *
+ * Called on a worker thread. Calls for one link are serial and in frame
+ * order; different links are delivered at the same time.
+ */
+typedef void (*csi_extract_output_t)(const csi_extract_features_t *features, void *ctx);
+
+typedef struct {
+    int workers;                        ///< Worker threads; 0 for one per CPU
+    uint32_t quantum;                   ///< Batches a link processes before yielding its worker
+    uint32_t window;                    ///< Frames of the variance window (2-CSI_EXTRACT_MAX_WINDOW)
+    uint32_t fft_size;                  ///< Frames of the spectrum; a power of two up to CSI_FEATURES_MAX_FFT
+    uint32_t hop;                       ///< Frames between variance and spectrum outputs
+    uint32_t max_links;
+    uint32_t link_backlog;              ///< Batches waiting per link
+    csi_extract_output_t output;        ///< Feature consumer, or NULL to only count
+    void *output_ctx;
+} csi_extract_config_t;
+
+#define CSI_EXTRACT_CONFIG_DEFAULT() {  \
+    .workers = 0,                       \
+    .quantum = 8,                       \
+    .window = 64,                       \
+    .fft_size = 128,                    \
+    .hop = 16,                          \
+    .max_links = 65536,                 \
+    .link_backlog = 64,                 \
+}
+
+typedef struct {
+    uint64_t frames;                    ///< Processed
+    uint64_t hops;                      ///< Frames that carried variance or spectrum
+    uint64_t backlog_full;              ///< Frames dropped because their link's backlog was full
+    uint64_t link_limit;                ///< Frames dropped because max_links links exist
+    uint64_t pending;                   ///< Batches waiting or being processed
+    uint64_t tasks;                     ///< Link turns run by the pool
+    uint64_t steals;                    ///< Of those, taken from another worker
+    uint32_t links;
+    int workers;
+} csi_extract_stats_t;
+
+typedef struct csi_extract csi_extract_t;
+
+/**
+ * @brief Start the engine
+ * @param config Settings; zero fields take the defaults
+ * @return Engine, or NULL with errno set (EINVAL for bad settings)
+ */
+csi_extract_t *csi_extract_create(const csi_extract_config_t *config);
+
+/**
+ * @brief Queue the frames of a batch on their links
+ *
+ * Copies what it needs; never waits for processing. Frames of one node
+ * must be pushed in order, as csi_ingest delivers them; any thread may
+ * push.
+ *
+ * @return Frames queued; the rest were dropped and counted
+ */
+uint32_t csi_extract_push(csi_extract_t *x, const csi_ingest_batch_t *batch);
+
+/**
+ * @brief csi_extract_push() as a csi_ingest_sink_t, with the engine as ctx
+ */
+void csi_extract_sink(const csi_ingest_batch_t *batch, void *ctx);
+
+/**
+ * @brief Wait until every frame pushed so far has been output
+ */
+void csi_extract_drain(csi_extract_t *x);
+
+void csi_extract_get_stats(csi_extract_t *x, csi_extract_stats_t *stats);
+
+/**
+ * @brief Process what is queued and stop
+ */
+void csi_extract_destroy(csi_extract_t *x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_EXTRACT_H
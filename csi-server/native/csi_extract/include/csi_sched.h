@@ -0,0 +1,113 @@
+/**
+ * @file csi_sched.h
+ * @brief Work-stealing scheduler of serial strands
+ *
+ * A strand is a FIFO of items run one at a time, in order, by its
+ * function; different strands run in parallel. Feature extraction gives
+ * every link (node and transmitter) a strand, so a link's frames are
+ * processed in capture order without locks while the links spread over
+ * the cores.
+ *
+ * Posting to an idle strand schedules it as a task. Every worker has a
+ * deque of tasks: it runs its own newest task first, which keeps a
+ * strand's state warm in its cache, and an idle worker steals the oldest
+ * task of another. A task runs at most `quantum` items and then, if more
+ * are waiting, goes back to the stealable end of its worker's deque, so a
+ * busy link neither starves the others nor pins a worker while others
+ * idle. A strand is scheduled at most once, which is what keeps it
+ * serial.
+ *
+ * Strands are bounded: posting to a full strand fails and is counted,
+ * never queued without limit.
+ */
+
+#ifndef CSI_SCHED_H
+#define CSI_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_SCHED_MAX_WORKERS   256
+
+/**
+ * @brief Runs one item of a strand
+ */
+typedef void (*csi_sched_fn_t)(void *item, void *ctx);
+
+typedef struct {
+    int workers;                    ///< Worker threads (1-CSI_SCHED_MAX_WORKERS); 0 for one per CPU
+    uint32_t quantum;               ///< Items a strand runs before yielding its worker
+} csi_sched_config_t;
+
+#define CSI_SCHED_CONFIG_DEFAULT() {    \
+    .workers = 0,                       \
+    .quantum = 32,                      \
+}
+
+/**
+ * @brief Counters, summed over the workers
+ */
+typedef struct {
+    uint64_t items;                 ///< Run
+    uint64_t tasks;                 ///< Strand turns: a strand running up to quantum items
+    uint64_t steals;                ///< Tasks taken from another worker's deque
+    uint64_t full;                  ///< Posts refused because the strand was full
+    uint64_t pending;               ///< Posted and not yet run
+    uint32_t strands;
+    int workers;
+} csi_sched_stats_t;
+
+typedef struct csi_sched csi_sched_t;
+typedef struct csi_strand csi_strand_t;
+
+/**
+ * @brief Start the workers
+ * @param config Settings; zero fields take the defaults
+ * @return Scheduler, or NULL with errno set
+ */
+csi_sched_t *csi_sched_create(const csi_sched_config_t *config);
+
+/**
+ * @brief Add a strand
+ *
+ * Strands live until the scheduler is destroyed.
+ *
+ * @param sched Scheduler
+ * @param capacity Items waiting at most
+ * @param fn Runs each item
+ * @param ctx Passed to fn
+ * @return Strand, or NULL if out of memory
+ */
+csi_strand_t *csi_strand_create(csi_sched_t *sched, uint32_t capacity, csi_sched_fn_t fn, void *ctx);
+
+/**
+ * @brief Queue an item on a strand
+ *
+ * Never blocks on the strand's work. Any thread may post, workers
+ * included.
+ *
+ * @return false if the strand is full; the item stays the caller's
+ */
+bool csi_strand_post(csi_strand_t *strand, void *item);
+
+/**
+ * @brief Wait until every item posted so far has run
+ */
+void csi_sched_drain(csi_sched_t *sched);
+
+void csi_sched_get_stats(csi_sched_t *sched, csi_sched_stats_t *stats);
+
+/**
+ * @brief Run what is queued, stop the workers and free the strands
+ */
+void csi_sched_destroy(csi_sched_t *sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_SCHED_H
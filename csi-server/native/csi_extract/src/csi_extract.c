@@ -0,0 +1,349 @@
+/**
+ * @file csi_extract.c
+ * @brief Per-link CSI features, computed in parallel on a work-stealing pool
+ */
+
+#include "csi_extract.h"
+#include "csi_sched.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief A link with the state its strand alone touches
+ */
+typedef struct extract_link {
+    struct extract_link *next;          ///< Hash chain
+    uint32_t hash;
+    char node[CSI_INGEST_MAX_NODE_LEN + 1];
+    uint8_t mac[6];
+    csi_extract_t *x;
+    csi_strand_t *strand;
+    uint64_t frames;
+    csi_features_window_t amplitude;    ///< window rows of CSI_MAX_SUBCARRIERS
+    csi_features_window_t mean;         ///< fft_size rows of one value
+    float storage[];
+} extract_link_t;
+
+/**
+ * @brief Frame as copied out of a batch
+ */
+typedef struct {
+    uint64_t timestamp;
+    uint32_t sequence;
+    uint8_t flags;
+    uint8_t subcarrier_count;
+    float amplitude[CSI_MAX_SUBCARRIERS];
+    float phase[CSI_MAX_SUBCARRIERS];
+} extract_row_t;
+
+/**
+ * @brief Frames of one link from one batch: the unit a strand runs
+ */
+typedef struct {
+    extract_link_t *link;
+    uint32_t count;
+    extract_row_t row[];
+} extract_item_t;
+
+struct csi_extract {
+    csi_extract_config_t config;
+    csi_sched_t *sched;
+
+    pthread_mutex_t links_lock;
+    extract_link_t **bucket;
+    uint32_t bucket_mask;
+    uint32_t links;
+
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t hops;
+    atomic_uint_fast64_t backlog_full;
+    atomic_uint_fast64_t link_limit;
+};
+
+static uint32_t link_hash(const char *node, const uint8_t *mac)
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = node; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void process(void *arg, void *ctx);
+
+/**
+ * @brief Find or create the link of a node and transmitter
+ * @return NULL if max_links exist or out of memory
+ */
+static extract_link_t *get_link(csi_extract_t *x, const char *node, const uint8_t *mac)
+{
+    uint32_t hash = link_hash(node, mac);
+    pthread_mutex_lock(&x->links_lock);
+    extract_link_t **slot = &x->bucket[hash & x->bucket_mask];
+    for (extract_link_t *link = *slot; link; link = link->next) {
+        if (link->hash == hash && memcmp(link->mac, mac, 6) == 0 && strcmp(link->node, node) == 0) {
+            pthread_mutex_unlock(&x->links_lock);
+            return link;
+        }
+    }
+    extract_link_t *link = NULL;
+    if (x->links < x->config.max_links && strlen(node) <= CSI_INGEST_MAX_NODE_LEN) {
+        const uint32_t window = x->config.window, fft = x->config.fft_size;
+        link = calloc(1, sizeof(*link) + ((size_t)window * CSI_MAX_SUBCARRIERS + fft) * sizeof(float));
+    }
+    if (link) {
+        link->hash = hash;
+        strcpy(link->node, node);
+        memcpy(link->mac, mac, 6);
+        link->x = x;
+        csi_features_window_init(&link->amplitude, link->storage, x->config.window, CSI_MAX_SUBCARRIERS);
+        csi_features_window_init(&link->mean, link->storage + (size_t)x->config.window * CSI_MAX_SUBCARRIERS,
+                                 x->config.fft_size, 1);
+        link->strand = csi_strand_create(x->sched, x->config.link_backlog, process, link);
+        if (link->strand) {
+            link->next = *slot;
+            *slot = link;
+            x->links++;
+        } else {
+            free(link);
+            link = NULL;
+        }
+    }
+    pthread_mutex_unlock(&x->links_lock);
+    return link;
+}
+
+/**
+ * @brief Run the stages over the frames of an item, on the link's strand
+ */
+static void process(void *arg, void *ctx)
+{
+    extract_item_t *item = arg;
+    extract_link_t *link = ctx;
+    csi_extract_t *x = link->x;
+    const uint32_t hop = x->config.hop, bins = x->config.fft_size / 2 + 1;
+
+    float amplitude[CSI_MAX_SUBCARRIERS], phase[CSI_MAX_SUBCARRIERS], variance[CSI_MAX_SUBCARRIERS];
+    float series[CSI_FEATURES_MAX_FFT], scratch[2 * CSI_FEATURES_MAX_FFT], spectrum[CSI_FEATURES_MAX_FFT / 2 + 1];
+    uint64_t hops = 0;
+
+    for (uint32_t i = 0; i < item->count; i++) {
+        const extract_row_t *row = &item->row[i];
+        const uint32_t n = row->subcarrier_count;
+        csi_features_normalize_amplitude(row->amplitude, n, amplitude);
+        csi_features_sanitize_phase(row->phase, n, phase);
+        memset(amplitude + n, 0, (CSI_MAX_SUBCARRIERS - n) * sizeof(float));
+
+        float mean, unused;
+        csi_features_mean_variance(amplitude, n, &mean, &unused);
+        csi_features_window_push(&link->amplitude, amplitude);
+        csi_features_window_push(&link->mean, &mean);
+
+        csi_extract_features_t f = {
+            .node = link->node,
+            .mac = link->mac,
+            .frame = link->frames++,
+            .sequence = row->sequence,
+            .timestamp = row->timestamp,
+            .flags = row->flags,
+            .subcarrier_count = row->subcarrier_count,
+            .amplitude = amplitude,
+            .phase = phase,
+        };
+        if (link->frames % hop == 0) {
+            if (link->amplitude.count == link->amplitude.window) {
+                csi_features_window_variance(&link->amplitude, variance);
+                f.variance = variance;
+            }
+            if (link->mean.count == link->mean.window) {
+                // Spectrum of the motion, not of the level: remove the mean first
+                float level, var;
+                csi_features_window_column(&link->mean, 0, series);
+                csi_features_mean_variance(series, link->mean.count, &level, &var);
+                for (uint32_t k = 0; k < link->mean.count; k++) {
+                    series[k] -= level;
+                }
+                csi_features_fft_magnitude(series, link->mean.count, scratch, spectrum);
+                f.spectrum = spectrum;
+                f.spectrum_bins = bins;
+            }
+            hops += f.variance || f.spectrum;
+        }
+        if (x->config.output) {
+            x->config.output(&f, x->config.output_ctx);
+        }
+    }
+    atomic_fetch_add_explicit(&x->frames, item->count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&x->hops, hops, memory_order_relaxed);
+    free(item);
+}
+
+csi_extract_t *csi_extract_create(const csi_extract_config_t *config)
+{
+    const csi_extract_config_t defaults = CSI_EXTRACT_CONFIG_DEFAULT();
+    csi_extract_t *x = calloc(1, sizeof(*x));
+    if (!x) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    x->config = *config;
+    csi_extract_config_t *c = &x->config;
+    c->quantum = c->quantum ? c->quantum : defaults.quantum;
+    c->window = c->window ? c->window : defaults.window;
+    c->fft_size = c->fft_size ? c->fft_size : defaults.fft_size;
+    c->hop = c->hop ? c->hop : defaults.hop;
+    c->max_links = c->max_links ? c->max_links : defaults.max_links;
+    c->link_backlog = c->link_backlog ? c->link_backlog : defaults.link_backlog;
+    if (c->workers < 0 || c->workers > CSI_SCHED_MAX_WORKERS || c->window < 2 ||
+        c->window > CSI_EXTRACT_MAX_WINDOW || c->fft_size < 2 || c->fft_size > CSI_FEATURES_MAX_FFT ||
+        (c->fft_size & (c->fft_size - 1))) {
+        free(x);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    uint32_t buckets = 64;
+    while (buckets < c->max_links && buckets < (1u << 20)) {
+        buckets <<= 1;
+    }
+    x->bucket = calloc(buckets, sizeof(*x->bucket));
+    x->bucket_mask = buckets - 1;
+    pthread_mutex_init(&x->links_lock, NULL);
+    csi_sched_config_t sched = { .workers = c->workers, .quantum = c->quantum };
+    x->sched = x->bucket ? csi_sched_create(&sched) : NULL;
+    if (!x->sched) {
+        int err = x->bucket ? errno : ENOMEM;
+        pthread_mutex_destroy(&x->links_lock);
+        free(x->bucket);
+        free(x);
+        errno = err;
+        return NULL;
+    }
+    return x;
+}
+
+uint32_t csi_extract_push(csi_extract_t *x, const csi_ingest_batch_t *batch)
+{
+    if (batch->count == 0) {
+        return 0;
+    }
+    extract_link_t **link_of = malloc(batch->count * sizeof(*link_of));
+    extract_link_t **distinct = malloc(batch->count * sizeof(*distinct));
+    uint32_t *rows = malloc(batch->count * sizeof(*rows));
+    if (!link_of || !distinct || !rows) {
+        free(link_of);
+        free(distinct);
+        free(rows);
+        atomic_fetch_add_explicit(&x->backlog_full, batch->count, memory_order_relaxed);
+        return 0;
+    }
+
+    // Resolve each frame's link, locking the table once per transmitter of the batch (usually a handful)
+    uint32_t links = 0, unknown = 0;
+    for (uint32_t i = 0; i < batch->count; i++) {
+        const uint8_t *mac = batch->mac + 6 * (size_t)i;
+        uint32_t d = 0;
+        while (d < links && memcmp(distinct[d]->mac, mac, 6) != 0) {
+            d++;
+        }
+        if (d == links) {
+            extract_link_t *link = get_link(x, batch->node, mac);
+            if (!link) {
+                link_of[i] = NULL;
+                unknown++;
+                continue;
+            }
+            distinct[links] = link;
+            rows[links++] = 0;
+        }
+        link_of[i] = distinct[d];
+        rows[d]++;
+    }
+    atomic_fetch_add_explicit(&x->link_limit, unknown, memory_order_relaxed);
+
+    uint32_t queued = 0;
+    for (uint32_t d = 0; d < links; d++) {
+        extract_item_t *item = malloc(sizeof(*item) + rows[d] * sizeof(extract_row_t));
+        if (item) {
+            item->link = distinct[d];
+            item->count = 0;
+            for (uint32_t i = 0; i < batch->count; i++) {
+                if (link_of[i] != distinct[d]) {
+                    continue;
+                }
+                extract_row_t *row = &item->row[item->count++];
+                uint8_t n = batch->subcarrier_count[i];
+                row->timestamp = batch->timestamp[i];
+                row->sequence = batch->sequence[i];
+                row->flags = batch->flags[i];
+                row->subcarrier_count = n > CSI_MAX_SUBCARRIERS ? CSI_MAX_SUBCARRIERS : n;
+                memcpy(row->amplitude, batch->amplitude + (size_t)i * CSI_MAX_SUBCARRIERS,
+                       row->subcarrier_count * sizeof(float));
+                memcpy(row->phase, batch->phase + (size_t)i * CSI_MAX_SUBCARRIERS,
+                       row->subcarrier_count * sizeof(float));
+            }
+        }
+        if (item && csi_strand_post(distinct[d]->strand, item)) {
+            queued += rows[d];
+        } else {
+            free(item);
+            atomic_fetch_add_explicit(&x->backlog_full, rows[d], memory_order_relaxed);
+        }
+    }
+    free(link_of);
+    free(distinct);
+    free(rows);
+    return queued;
+}
+
+void csi_extract_sink(const csi_ingest_batch_t *batch, void *ctx)
+{
+    csi_extract_push(ctx, batch);
+}
+
+void csi_extract_drain(csi_extract_t *x)
+{
+    csi_sched_drain(x->sched);
+}
+
+void csi_extract_get_stats(csi_extract_t *x, csi_extract_stats_t *stats)
+{
+    csi_sched_stats_t sched;
+    csi_sched_get_stats(x->sched, &sched);
+    memset(stats, 0, sizeof(*stats));
+    stats->frames = atomic_load_explicit(&x->frames, memory_order_relaxed);
+    stats->hops = atomic_load_explicit(&x->hops, memory_order_relaxed);
+    stats->backlog_full = atomic_load_explicit(&x->backlog_full, memory_order_relaxed);
+    stats->link_limit = atomic_load_explicit(&x->link_limit, memory_order_relaxed);
+    stats->pending = sched.pending;
+    stats->tasks = sched.tasks;
+    stats->steals = sched.steals;
+    stats->links = sched.strands;
+    stats->workers = sched.workers;
+}
+
+void csi_extract_destroy(csi_extract_t *x)
+{
+    if (!x) {
+        return;
+    }
+    csi_sched_destroy(x->sched);
+    for (uint32_t b = 0; b <= x->bucket_mask; b++) {
+        extract_link_t *link = x->bucket[b];
+        while (link) {
+            extract_link_t *next = link->next;
+            free(link);
+            link = next;
+        }
+    }
+    pthread_mutex_destroy(&x->links_lock);
+    free(x->bucket);
+    free(x);
+}
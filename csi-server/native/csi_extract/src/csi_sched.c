@@ -0,0 +1,424 @@
+/**
+ * @file csi_sched.c
+ * @brief Work-stealing scheduler of serial strands
+ *
+ * Deques are short ring buffers under a mutex each. A task is a whole
+ * strand turn of up to quantum items, so the lock is taken a few times per
+ * turn rather than per item and a lock-free deque would buy little.
+ */
+
+#include "csi_sched.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEQUE_INITIAL   64
+
+struct csi_strand {
+    struct csi_strand *next;        ///< All strands of the scheduler
+    csi_sched_t *sched;
+    csi_sched_fn_t fn;
+    void *ctx;
+    pthread_mutex_t lock;
+    void **items;                   ///< Ring of capacity items
+    uint32_t capacity;
+    uint32_t head;                  ///< Oldest item
+    uint32_t count;
+    bool scheduled;                 ///< In a deque or running; never twice
+};
+
+/**
+ * @brief Ring of tasks: the owner works the tail, thieves take the head
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    csi_strand_t **task;
+    uint32_t mask;
+    uint32_t head;
+    uint32_t tail;
+} deque_t;
+
+typedef struct {
+    _Alignas(64) deque_t deque;
+    csi_sched_t *sched;
+    pthread_t thread;
+    uint64_t rng;
+    void **batch;                   ///< quantum items taken from a strand
+    atomic_uint_fast64_t items;
+    atomic_uint_fast64_t tasks;
+    atomic_uint_fast64_t steals;
+} sched_worker_t;
+
+struct csi_sched {
+    csi_sched_config_t config;
+    sched_worker_t *worker;
+    int workers;
+
+    atomic_int queued;              ///< Tasks in the deques, counted before they are pushed
+    atomic_uint_fast64_t pending;   ///< Items posted and not yet run
+    atomic_int sleepers;
+    atomic_uint next;               ///< Deque for the next task from outside the pool
+    atomic_bool stop;
+    atomic_uint_fast64_t full;
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;            ///< A task was queued, or stop
+    pthread_cond_t idle;            ///< pending reached 0
+
+    pthread_mutex_t strands_lock;
+    csi_strand_t *strands;
+    uint32_t strand_count;
+};
+
+static _Thread_local sched_worker_t *t_worker;
+
+static bool deque_grow(deque_t *d)
+{
+    uint32_t cap = d->mask + 1, count = d->tail - d->head;
+    csi_strand_t **task = malloc(2 * (size_t)cap * sizeof(*task));
+    if (!task) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        task[i] = d->task[(d->head + i) & d->mask];
+    }
+    free(d->task);
+    d->task = task;
+    d->mask = 2 * cap - 1;
+    d->head = 0;
+    d->tail = count;
+    return true;
+}
+
+/**
+ * @brief Push at the owner's end, or at the thieves' end to yield
+ *
+ * Cannot overflow: a strand is queued at most once, and every deque has
+ * room for all strands (see csi_strand_create()).
+ */
+static void deque_push(deque_t *d, csi_strand_t *strand, bool yield)
+{
+    pthread_mutex_lock(&d->lock);
+    if (yield) {
+        d->task[--d->head & d->mask] = strand;
+    } else {
+        d->task[d->tail++ & d->mask] = strand;
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+static csi_strand_t *deque_take(deque_t *d, bool steal)
+{
+    csi_strand_t *strand = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail != d->head) {
+        strand = steal ? d->task[d->head++ & d->mask] : d->task[--d->tail & d->mask];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return strand;
+}
+
+static void wake_one(csi_sched_t *s)
+{
+    if (atomic_load(&s->sleepers) > 0) {
+        pthread_mutex_lock(&s->sleep_lock);
+        pthread_cond_signal(&s->wake);
+        pthread_mutex_unlock(&s->sleep_lock);
+    }
+}
+
+/**
+ * @brief Queue a strand turn, on the calling worker's own deque if it is one
+ */
+static void schedule(csi_sched_t *s, csi_strand_t *strand, bool yield)
+{
+    sched_worker_t *w = t_worker;
+    if (!w || w->sched != s) {
+        w = &s->worker[atomic_fetch_add_explicit(&s->next, 1, memory_order_relaxed) % s->workers];
+    }
+    atomic_fetch_add(&s->queued, 1);
+    deque_push(&w->deque, strand, yield);
+    wake_one(s);
+}
+
+static csi_strand_t *find_task(sched_worker_t *w)
+{
+    csi_sched_t *s = w->sched;
+    csi_strand_t *strand = deque_take(&w->deque, false);
+    if (!strand && s->workers > 1) {
+        // Thieves start at a random victim so they do not all contend for the same deque
+        w->rng ^= w->rng << 13;
+        w->rng ^= w->rng >> 7;
+        w->rng ^= w->rng << 17;
+        int first = (int)(w->rng % (uint64_t)s->workers);
+        for (int i = 0; i < s->workers && !strand; i++) {
+            sched_worker_t *victim = &s->worker[(first + i) % s->workers];
+            if (victim != w) {
+                strand = deque_take(&victim->deque, true);
+            }
+        }
+        if (strand) {
+            atomic_fetch_add_explicit(&w->steals, 1, memory_order_relaxed);
+        }
+    }
+    if (strand) {
+        atomic_fetch_sub(&s->queued, 1);
+    }
+    return strand;
+}
+
+/**
+ * @brief One turn of a strand: up to quantum items, then yield or go idle
+ */
+static void run(sched_worker_t *w, csi_strand_t *strand)
+{
+    csi_sched_t *s = w->sched;
+    pthread_mutex_lock(&strand->lock);
+    uint32_t n = strand->count < s->config.quantum ? strand->count : s->config.quantum;
+    for (uint32_t i = 0; i < n; i++) {
+        w->batch[i] = strand->items[strand->head];
+        strand->head = strand->head + 1 == strand->capacity ? 0 : strand->head + 1;
+    }
+    strand->count -= n;
+    pthread_mutex_unlock(&strand->lock);
+
+    for (uint32_t i = 0; i < n; i++) {
+        strand->fn(w->batch[i], strand->ctx);
+    }
+    atomic_fetch_add_explicit(&w->items, n, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->tasks, 1, memory_order_relaxed);
+
+    pthread_mutex_lock(&strand->lock);
+    bool more = strand->count > 0;
+    strand->scheduled = more;
+    pthread_mutex_unlock(&strand->lock);
+    if (more) {
+        schedule(s, strand, true);
+    }
+
+    if (atomic_fetch_sub(&s->pending, n) == n) {
+        pthread_mutex_lock(&s->sleep_lock);
+        pthread_cond_broadcast(&s->idle);
+        pthread_mutex_unlock(&s->sleep_lock);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    sched_worker_t *w = arg;
+    csi_sched_t *s = w->sched;
+    t_worker = w;
+
+    for (;;) {
+        csi_strand_t *strand = find_task(w);
+        if (strand) {
+            run(w, strand);
+            continue;
+        }
+        // Counted as a sleeper before looking, so a task queued meanwhile signals us
+        atomic_fetch_add(&s->sleepers, 1);
+        pthread_mutex_lock(&s->sleep_lock);
+        while (atomic_load(&s->queued) <= 0 && !atomic_load(&s->stop)) {
+            pthread_cond_wait(&s->wake, &s->sleep_lock);
+        }
+        pthread_mutex_unlock(&s->sleep_lock);
+        atomic_fetch_sub(&s->sleepers, 1);
+        if (atomic_load(&s->stop) && atomic_load(&s->queued) <= 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+csi_sched_t *csi_sched_create(const csi_sched_config_t *config)
+{
+    const csi_sched_config_t defaults = CSI_SCHED_CONFIG_DEFAULT();
+    if (!config) {
+        config = &defaults;
+    }
+    if (config->workers < 0 || config->workers > CSI_SCHED_MAX_WORKERS) {
+        errno = EINVAL;
+        return NULL;
+    }
+    csi_sched_t *s = calloc(1, sizeof(*s));
+    if (!s) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    s->config = *config;
+    if (s->config.workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        s->config.workers = cpus > CSI_SCHED_MAX_WORKERS ? CSI_SCHED_MAX_WORKERS : cpus > 0 ? (int)cpus : 1;
+    }
+    s->config.quantum = s->config.quantum ? s->config.quantum : defaults.quantum;
+    pthread_mutex_init(&s->sleep_lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    pthread_cond_init(&s->idle, NULL);
+    pthread_mutex_init(&s->strands_lock, NULL);
+
+    s->worker = aligned_alloc(64, s->config.workers * sizeof(sched_worker_t));
+    if (!s->worker) {
+        csi_sched_destroy(s);
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(s->worker, 0, s->config.workers * sizeof(sched_worker_t));
+
+    int err = 0;
+    for (; s->workers < s->config.workers; s->workers++) {
+        sched_worker_t *w = &s->worker[s->workers];
+        w->sched = s;
+        w->rng = 0x9E3779B97F4A7C15ULL * (s->workers + 1);
+        w->batch = malloc(s->config.quantum * sizeof(void *));
+        w->deque.task = malloc(DEQUE_INITIAL * sizeof(csi_strand_t *));
+        w->deque.mask = DEQUE_INITIAL - 1;
+        pthread_mutex_init(&w->deque.lock, NULL);
+        if (!w->batch || !w->deque.task) {
+            err = ENOMEM;
+        } else {
+            err = pthread_create(&w->thread, NULL, worker_main, w);
+        }
+        if (err) {
+            free(w->batch);
+            free(w->deque.task);
+            pthread_mutex_destroy(&w->deque.lock);
+            break;
+        }
+    }
+    if (err) {
+        csi_sched_destroy(s);
+        errno = err;
+        return NULL;
+    }
+    return s;
+}
+
+csi_strand_t *csi_strand_create(csi_sched_t *sched, uint32_t capacity, csi_sched_fn_t fn, void *ctx)
+{
+    csi_strand_t *strand = calloc(1, sizeof(*strand));
+    void **items = capacity ? malloc(capacity * sizeof(void *)) : NULL;
+    if (!strand || !items) {
+        free(strand);
+        free(items);
+        errno = capacity ? ENOMEM : EINVAL;
+        return NULL;
+    }
+    strand->sched = sched;
+    strand->fn = fn;
+    strand->ctx = ctx;
+    strand->items = items;
+    strand->capacity = capacity;
+    pthread_mutex_init(&strand->lock, NULL);
+
+    // Make room for one more strand in every deque, so pushing never has to
+    pthread_mutex_lock(&sched->strands_lock);
+    bool ok = true;
+    for (int i = 0; i < sched->workers && ok; i++) {
+        deque_t *d = &sched->worker[i].deque;
+        pthread_mutex_lock(&d->lock);
+        ok = d->mask >= sched->strand_count || deque_grow(d);
+        pthread_mutex_unlock(&d->lock);
+    }
+    if (ok) {
+        strand->next = sched->strands;
+        sched->strands = strand;
+        sched->strand_count++;
+    }
+    pthread_mutex_unlock(&sched->strands_lock);
+    if (!ok) {
+        pthread_mutex_destroy(&strand->lock);
+        free(items);
+        free(strand);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return strand;
+}
+
+bool csi_strand_post(csi_strand_t *strand, void *item)
+{
+    csi_sched_t *s = strand->sched;
+    pthread_mutex_lock(&strand->lock);
+    if (strand->count == strand->capacity) {
+        pthread_mutex_unlock(&strand->lock);
+        atomic_fetch_add_explicit(&s->full, 1, memory_order_relaxed);
+        return false;
+    }
+    uint32_t slot = strand->head + strand->count;
+    strand->items[slot >= strand->capacity ? slot - strand->capacity : slot] = item;
+    strand->count++;
+    // Counted before it can run, so drain never sees it done early
+    atomic_fetch_add(&s->pending, 1);
+    bool idle = !strand->scheduled;
+    strand->scheduled = true;
+    pthread_mutex_unlock(&strand->lock);
+    if (idle) {
+        schedule(s, strand, false);
+    }
+    return true;
+}
+
+void csi_sched_drain(csi_sched_t *sched)
+{
+    pthread_mutex_lock(&sched->sleep_lock);
+    while (atomic_load(&sched->pending) > 0) {
+        pthread_cond_wait(&sched->idle, &sched->sleep_lock);
+    }
+    pthread_mutex_unlock(&sched->sleep_lock);
+}
+
+void csi_sched_get_stats(csi_sched_t *sched, csi_sched_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < sched->workers; i++) {
+        sched_worker_t *w = &sched->worker[i];
+        stats->items += atomic_load_explicit(&w->items, memory_order_relaxed);
+        stats->tasks += atomic_load_explicit(&w->tasks, memory_order_relaxed);
+        stats->steals += atomic_load_explicit(&w->steals, memory_order_relaxed);
+    }
+    stats->pending = atomic_load_explicit(&sched->pending, memory_order_relaxed);
+    stats->full = atomic_load_explicit(&sched->full, memory_order_relaxed);
+    pthread_mutex_lock(&sched->strands_lock);
+    stats->strands = sched->strand_count;
+    pthread_mutex_unlock(&sched->strands_lock);
+    stats->workers = sched->workers;
+}
+
+void csi_sched_destroy(csi_sched_t *sched)
+{
+    if (!sched) {
+        return;
+    }
+    if (sched->workers > 0) {
+        csi_sched_drain(sched);
+    }
+    atomic_store(&sched->stop, true);
+    pthread_mutex_lock(&sched->sleep_lock);
+    pthread_cond_broadcast(&sched->wake);
+    pthread_mutex_unlock(&sched->sleep_lock);
+    for (int i = 0; i < sched->workers; i++) {
+        sched_worker_t *w = &sched->worker[i];
+        pthread_join(w->thread, NULL);
+        pthread_mutex_destroy(&w->deque.lock);
+        free(w->deque.task);
+        free(w->batch);
+    }
+    free(sched->worker);
+
+    csi_strand_t *strand = sched->strands;
+    while (strand) {
+        csi_strand_t *next = strand->next;
+        pthread_mutex_destroy(&strand->lock);
+        free(strand->items);
+        free(strand);
+        strand = next;
+    }
+    pthread_mutex_destroy(&sched->strands_lock);
+    pthread_mutex_destroy(&sched->sleep_lock);
+    pthread_cond_destroy(&sched->wake);
+    pthread_cond_destroy(&sched->idle);
+    free(sched);
+}
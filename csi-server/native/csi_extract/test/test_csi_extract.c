@@ -0,0 +1,371 @@
+/**
+ * @file test_csi_extract.c
+ * @brief Unit tests for the strand scheduler and the feature engine
+ */
+
+#include <unity.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csi_extract.h"
+#include "csi_sched.h"
+
+#define STRANDS     16
+#define POSTS       2000
+#define FRAMES      300
+#define BATCH       32
+#define WINDOW      16
+#define FFT         32
+#define HOP         8
+
+/**
+ * @brief What a test strand saw; checked on the main thread, as Unity cannot fail on a worker
+ */
+typedef struct {
+    atomic_int running;
+    int overlaps;
+    int out_of_order;
+    int next;
+} strand_log_t;
+
+static strand_log_t s_log[STRANDS];
+
+static void record_item(void *item, void *ctx)
+{
+    strand_log_t *log = ctx;
+    if (atomic_fetch_add(&log->running, 1) != 0) {
+        log->overlaps++;
+    }
+    int value = (int)(uintptr_t)item;
+    if (value != log->next) {
+        log->out_of_order++;
+    }
+    log->next = value + 1;
+    atomic_fetch_sub(&log->running, 1);
+}
+
+/**
+ * @brief Gate that holds a strand's function until opened
+ */
+static pthread_mutex_t s_gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_gate_cond = PTHREAD_COND_INITIALIZER;
+static bool s_gate_open;
+static atomic_int s_gate_entered;
+
+static void wait_gate(void *item, void *ctx)
+{
+    (void)item;
+    (void)ctx;
+    atomic_fetch_add(&s_gate_entered, 1);
+    pthread_mutex_lock(&s_gate_lock);
+    while (!s_gate_open) {
+        pthread_cond_wait(&s_gate_cond, &s_gate_lock);
+    }
+    pthread_mutex_unlock(&s_gate_lock);
+}
+
+/**
+ * @brief Features the engine output for one link
+ */
+typedef struct {
+    int frames;
+    int out_of_order;
+    float amplitude[FRAMES][CSI_MAX_SUBCARRIERS];
+    float phase[FRAMES][CSI_MAX_SUBCARRIERS];
+    bool has_variance[FRAMES];
+    float variance[FRAMES][CSI_MAX_SUBCARRIERS];
+    bool has_spectrum[FRAMES];
+    float spectrum[FRAMES][FFT / 2 + 1];
+} link_log_t;
+
+static link_log_t s_links[2];
+
+static void record_features(const csi_extract_features_t *f, void *ctx)
+{
+    (void)ctx;
+    link_log_t *log = &s_links[f->mac[5] & 1];
+    if (f->frame != (uint64_t)log->frames || f->sequence != (uint32_t)log->frames || log->frames >= FRAMES) {
+        log->out_of_order++;
+        return;
+    }
+    int i = log->frames++;
+    memcpy(log->amplitude[i], f->amplitude, f->subcarrier_count * sizeof(float));
+    memcpy(log->phase[i], f->phase, f->subcarrier_count * sizeof(float));
+    if (f->variance) {
+        log->has_variance[i] = true;
+        memcpy(log->variance[i], f->variance, f->subcarrier_count * sizeof(float));
+    }
+    if (f->spectrum && f->spectrum_bins == FFT / 2 + 1) {
+        log->has_spectrum[i] = true;
+        memcpy(log->spectrum[i], f->spectrum, f->spectrum_bins * sizeof(float));
+    }
+}
+
+static struct {
+    uint32_t sequence[BATCH];
+    uint64_t timestamp[BATCH];
+    uint8_t mac[BATCH * 6];
+    int8_t rssi[BATCH];
+    uint8_t channel[BATCH];
+    uint8_t secondary_channel[BATCH];
+    uint8_t subcarrier_count[BATCH];
+    uint8_t flags[BATCH];
+    int8_t iq[BATCH * CSI_INGEST_IQ_STRIDE];
+    float amplitude[BATCH * CSI_MAX_SUBCARRIERS];
+    float phase[BATCH * CSI_MAX_SUBCARRIERS];
+} s_rows;
+
+/**
+ * @brief Amplitude and phase of frame i of link l: a moving reflector over a tilted, wrapped phase
+ */
+static float amplitude_of(int l, int i, int k)
+{
+    return 20.0f + 3.0f * l + 2.0f * sinf(0.3f * i + 0.2f * k) + 0.5f * cosf(1.7f * i);
+}
+
+static float phase_of(int l, int i, int k)
+{
+    float p = 0.4f * l + 0.11f * i + 0.35f * k + 0.1f * sinf(0.5f * i);
+    return remainderf(p, 6.2831853f);
+}
+
+/**
+ * @brief Frames [first, first + count) of both links, interleaved
+ */
+static csi_ingest_batch_t make_batch(int first, int count)
+{
+    for (int r = 0; r < count; r++) {
+        int l = (first + r) & 1, i = (first + r) / 2;
+        s_rows.sequence[r] = (uint32_t)i;
+        s_rows.timestamp[r] = 1000ULL * i;
+        memcpy(s_rows.mac + 6 * r, (const uint8_t[]){ 0x24, 0x0A, 0xC4, 0, 0, (uint8_t)l }, 6);
+        s_rows.subcarrier_count[r] = CSI_MAX_SUBCARRIERS;
+        s_rows.flags[r] = 0;
+        for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+            s_rows.amplitude[r * CSI_MAX_SUBCARRIERS + k] = amplitude_of(l, i, k);
+            s_rows.phase[r * CSI_MAX_SUBCARRIERS + k] = phase_of(l, i, k);
+        }
+    }
+    csi_ingest_batch_t batch = {
+        .node = "node-1",
+        .count = (uint32_t)count,
+        .sequence = s_rows.sequence,
+        .timestamp = s_rows.timestamp,
+        .mac = s_rows.mac,
+        .rssi = s_rows.rssi,
+        .channel = s_rows.channel,
+        .secondary_channel = s_rows.secondary_channel,
+        .subcarrier_count = s_rows.subcarrier_count,
+        .flags = s_rows.flags,
+        .iq = s_rows.iq,
+        .amplitude = s_rows.amplitude,
+        .phase = s_rows.phase,
+    };
+    return batch;
+}
+
+void setUp(void)
+{
+    memset(s_log, 0, sizeof(s_log));
+    memset(s_links, 0, sizeof(s_links));
+}
+
+void tearDown(void)
+{
+}
+
+void test_csi_sched_strands_serial_and_ordered(void)
+{
+    csi_sched_config_t config = CSI_SCHED_CONFIG_DEFAULT();
+    config.workers = 4;
+    config.quantum = 3;
+    csi_sched_t *sched = csi_sched_create(&config);
+    TEST_ASSERT_NOT_NULL(sched);
+    csi_strand_t *strand[STRANDS];
+    for (int s = 0; s < STRANDS; s++) {
+        strand[s] = csi_strand_create(sched, POSTS, record_item, &s_log[s]);
+        TEST_ASSERT_NOT_NULL(strand[s]);
+    }
+    // Interleaved across strands, as frames of many links arrive
+    for (int i = 0; i < POSTS; i++) {
+        for (int s = 0; s < STRANDS; s++) {
+            TEST_ASSERT_TRUE(csi_strand_post(strand[s], (void *)(uintptr_t)i));
+        }
+    }
+    csi_sched_drain(sched);
+
+    csi_sched_stats_t stats;
+    csi_sched_get_stats(sched, &stats);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)STRANDS * POSTS, stats.items);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.pending);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.full);
+    TEST_ASSERT_EQUAL(STRANDS, stats.strands);
+    TEST_ASSERT_EQUAL(4, stats.workers);
+    // A turn runs at most quantum items
+    TEST_ASSERT_TRUE(stats.tasks >= (uint64_t)STRANDS * POSTS / 3);
+    for (int s = 0; s < STRANDS; s++) {
+        TEST_ASSERT_EQUAL(0, s_log[s].overlaps);
+        TEST_ASSERT_EQUAL(0, s_log[s].out_of_order);
+        TEST_ASSERT_EQUAL(POSTS, s_log[s].next);
+    }
+    csi_sched_destroy(sched);
+}
+
+void test_csi_sched_full_strand(void)
+{
+    csi_sched_config_t config = CSI_SCHED_CONFIG_DEFAULT();
+    config.workers = 2;
+    csi_sched_t *sched = csi_sched_create(&config);
+    TEST_ASSERT_NOT_NULL(sched);
+    csi_strand_t *strand = csi_strand_create(sched, 2, wait_gate, NULL);
+    TEST_ASSERT_NOT_NULL(strand);
+    TEST_ASSERT_NULL(csi_strand_create(sched, 0, wait_gate, NULL));
+
+    s_gate_open = false;
+    atomic_store(&s_gate_entered, 0);
+    TEST_ASSERT_TRUE(csi_strand_post(strand, NULL));
+    while (atomic_load(&s_gate_entered) == 0) {
+        sched_yield();
+    }
+    // The first item is running; two more fit, the fourth does not
+    TEST_ASSERT_TRUE(csi_strand_post(strand, NULL));
+    TEST_ASSERT_TRUE(csi_strand_post(strand, NULL));
+    TEST_ASSERT_FALSE(csi_strand_post(strand, NULL));
+
+    csi_sched_stats_t stats;
+    csi_sched_get_stats(sched, &stats);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.full);
+    TEST_ASSERT_EQUAL_UINT64(3, stats.pending);
+
+    pthread_mutex_lock(&s_gate_lock);
+    s_gate_open = true;
+    pthread_cond_broadcast(&s_gate_cond);
+    pthread_mutex_unlock(&s_gate_lock);
+    csi_sched_drain(sched);
+    TEST_ASSERT_EQUAL(3, atomic_load(&s_gate_entered));
+    csi_sched_destroy(sched);
+}
+
+void test_csi_extract_matches_kernels(void)
+{
+    csi_extract_config_t config = CSI_EXTRACT_CONFIG_DEFAULT();
+    config.workers = 3;
+    config.window = WINDOW;
+    config.fft_size = FFT;
+    config.hop = HOP;
+    config.link_backlog = 2 * FRAMES / BATCH + 1;
+    config.output = record_features;
+    csi_extract_t *x = csi_extract_create(&config);
+    TEST_ASSERT_NOT_NULL(x);
+    for (int first = 0; first < 2 * FRAMES; first += BATCH) {
+        int count = 2 * FRAMES - first < BATCH ? 2 * FRAMES - first : BATCH;
+        csi_ingest_batch_t batch = make_batch(first, count);
+        TEST_ASSERT_EQUAL_UINT32(count, csi_extract_push(x, &batch));
+    }
+    csi_extract_drain(x);
+
+    csi_extract_stats_t stats;
+    csi_extract_get_stats(x, &stats);
+    TEST_ASSERT_EQUAL_UINT64(2 * FRAMES, stats.frames);
+    TEST_ASSERT_EQUAL(2, stats.links);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.backlog_full);
+    csi_extract_destroy(x);
+
+    // The same stages run frame by frame, as the node would
+    for (int l = 0; l < 2; l++) {
+        link_log_t *log = &s_links[l];
+        TEST_ASSERT_EQUAL(0, log->out_of_order);
+        TEST_ASSERT_EQUAL(FRAMES, log->frames);
+
+        float ring[WINDOW * CSI_MAX_SUBCARRIERS], means[FFT];
+        csi_features_window_t window, mean_window;
+        csi_features_window_init(&window, ring, WINDOW, CSI_MAX_SUBCARRIERS);
+        csi_features_window_init(&mean_window, means, FFT, 1);
+        for (int i = 0; i < FRAMES; i++) {
+            float amplitude[CSI_MAX_SUBCARRIERS], phase[CSI_MAX_SUBCARRIERS], variance[CSI_MAX_SUBCARRIERS];
+            for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+                amplitude[k] = amplitude_of(l, i, k);
+                phase[k] = phase_of(l, i, k);
+            }
+            csi_features_normalize_amplitude(amplitude, CSI_MAX_SUBCARRIERS, amplitude);
+            csi_features_sanitize_phase(phase, CSI_MAX_SUBCARRIERS, phase);
+            TEST_ASSERT_EQUAL_MEMORY(amplitude, log->amplitude[i], sizeof(amplitude));
+            TEST_ASSERT_EQUAL_MEMORY(phase, log->phase[i], sizeof(phase));
+
+            float mean, unused;
+            csi_features_mean_variance(amplitude, CSI_MAX_SUBCARRIERS, &mean, &unused);
+            csi_features_window_push(&window, amplitude);
+            csi_features_window_push(&mean_window, &mean);
+            bool hop = (i + 1) % HOP == 0;
+            TEST_ASSERT_EQUAL(hop && i + 1 >= WINDOW, log->has_variance[i]);
+            TEST_ASSERT_EQUAL(hop && i + 1 >= FFT, log->has_spectrum[i]);
+            if (log->has_variance[i]) {
+                csi_features_window_variance(&window, variance);
+                TEST_ASSERT_EQUAL_MEMORY(variance, log->variance[i], sizeof(variance));
+            }
+            if (log->has_spectrum[i]) {
+                float series[FFT], scratch[2 * FFT], spectrum[FFT / 2 + 1], level, var;
+                csi_features_window_column(&mean_window, 0, series);
+                csi_features_mean_variance(series, FFT, &level, &var);
+                for (int k = 0; k < FFT; k++) {
+                    series[k] -= level;
+                }
+                TEST_ASSERT_TRUE(csi_features_fft_magnitude(series, FFT, scratch, spectrum));
+                TEST_ASSERT_EQUAL_MEMORY(spectrum, log->spectrum[i], sizeof(spectrum));
+            }
+        }
+        // The phase offsets are gone: what is left is the small wobble
+        for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+            TEST_ASSERT_FLOAT_WITHIN(0.2f, 0.0f, log->phase[FRAMES - 1][k]);
+        }
+    }
+}
+
+void test_csi_extract_link_limit(void)
+{
+    csi_extract_config_t config = CSI_EXTRACT_CONFIG_DEFAULT();
+    config.workers = 1;
+    config.max_links = 1;
+    csi_extract_t *x = csi_extract_create(&config);
+    TEST_ASSERT_NOT_NULL(x);
+    csi_ingest_batch_t batch = make_batch(0, BATCH);
+    TEST_ASSERT_EQUAL_UINT32(BATCH / 2, csi_extract_push(x, &batch));
+    csi_extract_drain(x);
+
+    csi_extract_stats_t stats;
+    csi_extract_get_stats(x, &stats);
+    TEST_ASSERT_EQUAL(1, stats.links);
+    TEST_ASSERT_EQUAL_UINT64(BATCH / 2, stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(BATCH / 2, stats.link_limit);
+    csi_extract_destroy(x);
+}
+
+void test_csi_extract_invalid_config(void)
+{
+    csi_extract_config_t config = CSI_EXTRACT_CONFIG_DEFAULT();
+    config.fft_size = 100;
+    errno = 0;
+    TEST_ASSERT_NULL(csi_extract_create(&config));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+
+    config = (csi_extract_config_t)CSI_EXTRACT_CONFIG_DEFAULT();
+    config.window = CSI_EXTRACT_MAX_WINDOW + 1;
+    TEST_ASSERT_NULL(csi_extract_create(&config));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_csi_sched_strands_serial_and_ordered);
+    RUN_TEST(test_csi_sched_full_strand);
+    RUN_TEST(test_csi_extract_matches_kernels);
+    RUN_TEST(test_csi_extract_link_limit);
+    RUN_TEST(test_csi_extract_invalid_config);
+
+    return UNITY_END();
+}
@@ -0,0 +1,201 @@
+/**
+ * @file csi_fingerprint.h
+ * @brief Fingerprint database: nearest surveyed CSI features to a live one
+ *
+ * A site survey records, at known positions, a feature vector derived
+ * from the CSI (amplitude per subcarrier and node, for example). To
+ * locate a live vector the database finds the surveyed vectors nearest to
+ * it in L2 distance and averages their positions.
+ *
+ * The index is IVF-PQ. A coarse quantizer of `lists` centroids splits the
+ * vectors into inverted lists; a query visits only the `probes` lists
+ * whose centroids are nearest. Within a list a vector is stored as its
+ * residual to the centroid, product quantized: the vector is cut into
+ * pq_m sub-vectors and each is replaced by the index of the nearest of
+ * 256 codewords, so a vector costs pq_m bytes instead of 4 * dim. A query
+ * builds one table of distances to every codeword per visited list and
+ * then sums pq_m table entries per stored vector. List codes are stored
+ * sub-vector by sub-vector, so that scan, like the float kernels, steps
+ * through memory with unit stride and compiles to SIMD without
+ * intrinsics.
+ *
+ * Vectors can be added at any time, which suits a survey in progress.
+ * Until the index is trained they are kept as they are and searched
+ * exhaustively; after train_size vectors (or csi_fingerprint_train()) the
+ * quantizers are trained on them and they are encoded.
+ *
+ * A saved database is opened with mmap and searched in place. Adding to
+ * an opened database copies what grows (the list added to, the positions)
+ * to the heap; the file is not modified.
+ *
+ * Searches may run concurrently; adding, training and saving need the
+ * database to themselves.
+ */
+
+#ifndef CSI_FINGERPRINT_H
+#define CSI_FINGERPRINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_FINGERPRINT_VERSION         1
+#define CSI_FINGERPRINT_MAX_DIM         4096
+#define CSI_FINGERPRINT_CODEWORDS       256     ///< Per sub-quantizer, so a code is one byte
+
+/**
+ * @brief Index settings
+ */
+typedef struct {
+    uint32_t dim;                       ///< Feature length; a multiple of pq_m
+    uint32_t lists;                     ///< Coarse centroids
+    uint32_t pq_m;                      ///< Bytes per stored vector
+    uint32_t train_size;                ///< Vectors added before the index trains itself; 0 for never
+    uint32_t train_iterations;          ///< k-means iterations
+    uint32_t seed;
+} csi_fingerprint_config_t;
+
+#define CSI_FINGERPRINT_CONFIG_DEFAULT() {  \
+    .dim = 0,                               \
+    .lists = 256,                           \
+    .pq_m = 16,                             \
+    .train_size = 20000,                    \
+    .train_iterations = 10,                 \
+    .seed = 1,                              \
+}
+
+/**
+ * @brief Where a fingerprint was surveyed
+ */
+typedef struct {
+    float x, y, z;                      ///< Metres
+    uint32_t label;                     ///< Room or survey point, free for the caller
+} csi_fingerprint_ref_t;
+
+/**
+ * @brief One search result
+ */
+typedef struct {
+    uint32_t id;                        ///< Order of addition, from 0
+    float distance;                     ///< Approximate squared L2 distance
+} csi_fingerprint_hit_t;
+
+typedef struct csi_fingerprint csi_fingerprint_t;
+
+/**
+ * @brief Create an empty database
+ * @param config Settings; dim is required, zero fields take the defaults
+ * @return Database, or NULL with errno set (EINVAL for bad settings)
+ */
+csi_fingerprint_t *csi_fingerprint_create(const csi_fingerprint_config_t *config);
+
+/**
+ * @brief Add surveyed vectors
+ *
+ * Trains the index when the vectors kept untrained reach train_size.
+ *
+ * @param db Database
+ * @param vectors n * dim values
+ * @param refs n positions
+ * @param n Number of vectors
+ * @return Id of the first vector, or -1 with errno set
+ */
+int64_t csi_fingerprint_add(csi_fingerprint_t *db, const float *vectors, const csi_fingerprint_ref_t *refs,
+                            uint32_t n);
+
+/**
+ * @brief Train the quantizers on the vectors added so far and encode them
+ * @return false if the database is trained already (EALREADY), holds fewer
+ *         than max(lists, CSI_FINGERPRINT_CODEWORDS) vectors (EINVAL), or
+ *         out of memory
+ */
+bool csi_fingerprint_train(csi_fingerprint_t *db);
+
+/**
+ * @brief Nearest vectors to a query
+ * @param db Database
+ * @param query dim values
+ * @param probes Lists to visit; more is slower and finds more of the true nearest
+ * @param k Results wanted
+ * @param hits Room for k results, nearest first
+ * @return Results found (fewer than k if the visited lists hold fewer), or -1 if out of memory
+ */
+int csi_fingerprint_search(const csi_fingerprint_t *db, const float *query, uint32_t probes, uint32_t k,
+                           csi_fingerprint_hit_t *hits);
+
+/**
+ * @brief Position of a query: the k nearest positions weighted by inverse distance
+ * @param db Database
+ * @param query dim values
+ * @param probes Lists to visit
+ * @param k Neighbours to average
+ * @param out Position; label is that of the nearest neighbour
+ * @return false if nothing was found
+ */
+bool csi_fingerprint_locate(const csi_fingerprint_t *db, const float *query, uint32_t probes, uint32_t k,
+                            csi_fingerprint_ref_t *out);
+
+/**
+ * @brief Position of a vector
+ * @return NULL if id is out of range
+ */
+const csi_fingerprint_ref_t *csi_fingerprint_ref(const csi_fingerprint_t *db, uint32_t id);
+
+/**
+ * @brief Summary
+ */
+typedef struct {
+    uint32_t dim;
+    uint32_t lists;
+    uint32_t pq_m;
+    bool trained;
+    bool mapped;                        ///< Opened from a file
+    uint64_t vectors;
+    uint64_t bytes;                     ///< Index memory: quantizers, codes, ids and positions
+} csi_fingerprint_info_t;
+
+void csi_fingerprint_get_info(const csi_fingerprint_t *db, csi_fingerprint_info_t *info);
+
+/**
+ * @brief Write a trained database to a file
+ *
+ * Writes to path.tmp and renames it over path, so readers never map a
+ * partial file.
+ *
+ * @return false with errno set (EINVAL if not trained)
+ */
+bool csi_fingerprint_save(const csi_fingerprint_t *db, const char *path);
+
+/**
+ * @brief Map a saved database
+ * @param path File written by csi_fingerprint_save()
+ * @return Database, or NULL with errno set (EINVAL for a file that is not a database)
+ */
+csi_fingerprint_t *csi_fingerprint_open(const char *path);
+
+void csi_fingerprint_destroy(csi_fingerprint_t *db);
+
+/**
+ * @brief Squared L2 distance
+ */
+float csi_fingerprint_l2(const float *a, const float *b, uint32_t dim);
+
+/**
+ * @brief Squared L2 distance of a query to n vectors
+ * @param query dim values
+ * @param vectors n * dim values
+ * @param n Number of vectors
+ * @param dim Vector length
+ * @param out n distances
+ */
+void csi_fingerprint_l2_many(const float *query, const float *vectors, uint32_t n, uint32_t dim, float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_FINGERPRINT_H
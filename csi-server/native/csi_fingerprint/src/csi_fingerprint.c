@@ -0,0 +1,432 @@
+/**
+ * @file csi_fingerprint.c
+ * @brief IVF-PQ fingerprint index: adding, training and searching
+ */
+
+#include "csi_fingerprint_internal.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define SCAN_BLOCK          1024        ///< Entries of a list summed per pass
+#define TRAIN_PER_CENTROID  64          ///< k-means sample cap per centroid
+#define LOCATE_EPSILON      1e-6f       ///< Keeps an exact match's weight finite
+
+csi_fingerprint_t *csi_fingerprint_create(const csi_fingerprint_config_t *config)
+{
+    csi_fingerprint_config_t defaults = CSI_FINGERPRINT_CONFIG_DEFAULT();
+    csi_fingerprint_config_t cfg = *config;
+    cfg.lists = cfg.lists ? cfg.lists : defaults.lists;
+    cfg.pq_m = cfg.pq_m ? cfg.pq_m : defaults.pq_m;
+    cfg.train_iterations = cfg.train_iterations ? cfg.train_iterations : defaults.train_iterations;
+    cfg.seed = cfg.seed ? cfg.seed : defaults.seed;
+    if (cfg.dim == 0 || cfg.dim > CSI_FINGERPRINT_MAX_DIM || cfg.pq_m > cfg.dim || cfg.dim % cfg.pq_m) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    csi_fingerprint_t *db = calloc(1, sizeof(*db));
+    if (!db) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    db->config = cfg;
+    db->dsub = cfg.dim / cfg.pq_m;
+    db->refs_owned = true;
+    db->rng = cfg.seed;
+    return db;
+}
+
+/**
+ * @brief Make room for n more positions, copying mapped ones to the heap
+ */
+static bool reserve_refs(csi_fingerprint_t *db, uint64_t n)
+{
+    if (db->count + n <= db->ref_cap && db->refs_owned) {
+        return true;
+    }
+    uint64_t cap = db->ref_cap ? db->ref_cap : 1024;
+    while (cap < db->count + n) {
+        cap *= 2;
+    }
+    csi_fingerprint_ref_t *refs = malloc(cap * sizeof(*refs));
+    if (!refs) {
+        return false;
+    }
+    if (db->count) {
+        memcpy(refs, db->refs, db->count * sizeof(*refs));
+    }
+    if (db->refs_owned) {
+        free(db->refs);
+    }
+    db->refs = refs;
+    db->ref_cap = cap;
+    db->refs_owned = true;
+    return true;
+}
+
+int64_t csi_fingerprint_add(csi_fingerprint_t *db, const float *vectors, const csi_fingerprint_ref_t *refs,
+                            uint32_t n)
+{
+    const uint32_t dim = db->config.dim;
+    if (db->count + n > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    if (!reserve_refs(db, n)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    int64_t first = (int64_t)db->count;
+
+    if (!db->trained) {
+        if (db->count + n > db->raw_cap) {
+            uint64_t cap = db->raw_cap ? db->raw_cap : 1024;
+            while (cap < db->count + n) {
+                cap *= 2;
+            }
+            float *raw = realloc(db->raw, cap * dim * sizeof(float));
+            if (!raw) {
+                errno = ENOMEM;
+                return -1;
+            }
+            db->raw = raw;
+            db->raw_cap = cap;
+        }
+        memcpy(db->raw + db->count * dim, vectors, (size_t)n * dim * sizeof(float));
+        memcpy(db->refs + db->count, refs, n * sizeof(*refs));
+        db->count += n;
+        if (db->config.train_size && db->count >= db->config.train_size && !csi_fingerprint_train(db) &&
+            errno == ENOMEM) {
+            return -1;
+        }
+        return first;
+    }
+
+    float *scratch = malloc(fp_encode_scratch(db) * sizeof(float));
+    uint8_t *code = malloc(db->config.pq_m);
+    if (!scratch || !code) {
+        free(scratch);
+        free(code);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t list = fp_encode(db, vectors + (size_t)i * dim, code, scratch);
+        if (!fp_list_append(&db->list[list], db->config.pq_m, (uint32_t)db->count, code)) {
+            free(scratch);
+            free(code);
+            errno = ENOMEM;
+            return -1;
+        }
+        db->refs[db->count++] = refs[i];
+    }
+    free(scratch);
+    free(code);
+    return first;
+}
+
+bool csi_fingerprint_train(csi_fingerprint_t *db)
+{
+    const uint32_t dim = db->config.dim, lists = db->config.lists, pq_m = db->config.pq_m;
+    const uint32_t dsub = db->dsub;
+    if (db->trained) {
+        errno = EALREADY;
+        return false;
+    }
+    if (db->count < lists || db->count < CSI_FINGERPRINT_CODEWORDS) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // Train on a random sample of what has been added
+    uint32_t most = TRAIN_PER_CENTROID * (lists > CSI_FINGERPRINT_CODEWORDS ? lists : CSI_FINGERPRINT_CODEWORDS);
+    uint32_t n = db->count < most ? (uint32_t)db->count : most;
+    float *sample = malloc((size_t)n * dim * sizeof(float));
+    float *sub = malloc((size_t)n * dsub * sizeof(float));
+    float *codebook = malloc((size_t)CSI_FINGERPRINT_CODEWORDS * dsub * sizeof(float));
+    uint32_t *pick = malloc(db->count * sizeof(*pick));
+    float *centroids = malloc((size_t)lists * dim * sizeof(float));
+    float *codebooks = malloc((size_t)pq_m * CSI_FINGERPRINT_CODEWORDS * dsub * sizeof(float));
+    fp_list_t *list = calloc(lists, sizeof(*list));
+    float *scratch = NULL;
+    uint8_t *code = NULL;
+    if (!sample || !sub || !codebook || !pick || !centroids || !codebooks || !list) {
+        goto fail;
+    }
+    for (uint32_t i = 0; i < db->count; i++) {
+        pick[i] = i;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t j = i + fp_random(&db->rng) % (uint32_t)(db->count - i);
+        uint32_t t = pick[i];
+        pick[i] = pick[j];
+        pick[j] = t;
+        memcpy(sample + (size_t)i * dim, db->raw + (size_t)pick[i] * dim, dim * sizeof(float));
+    }
+
+    if (!fp_kmeans(sample, n, dim, lists, db->config.train_iterations, &db->rng, centroids)) {
+        goto fail;
+    }
+
+    // Product quantizer on the residuals; codebooks are kept transposed
+    float *dist = malloc(lists * sizeof(float));
+    if (!dist) {
+        goto fail;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        float *v = sample + (size_t)i * dim;
+        csi_fingerprint_l2_many(v, centroids, lists, dim, dist);
+        const float *c = centroids + (size_t)fp_argmin(dist, lists) * dim;
+        for (uint32_t d = 0; d < dim; d++) {
+            v[d] -= c[d];
+        }
+    }
+    free(dist);
+    for (uint32_t j = 0; j < pq_m; j++) {
+        for (uint32_t i = 0; i < n; i++) {
+            memcpy(sub + (size_t)i * dsub, sample + (size_t)i * dim + j * dsub, dsub * sizeof(float));
+        }
+        if (!fp_kmeans(sub, n, dsub, CSI_FINGERPRINT_CODEWORDS, db->config.train_iterations, &db->rng, codebook)) {
+            goto fail;
+        }
+        float *out = codebooks + (size_t)j * dsub * CSI_FINGERPRINT_CODEWORDS;
+        for (uint32_t c = 0; c < CSI_FINGERPRINT_CODEWORDS; c++) {
+            for (uint32_t d = 0; d < dsub; d++) {
+                out[d * CSI_FINGERPRINT_CODEWORDS + c] = codebook[c * dsub + d];
+            }
+        }
+    }
+
+    db->centroids = centroids;
+    db->codebooks = codebooks;
+    db->list = list;
+    scratch = malloc(fp_encode_scratch(db) * sizeof(float));
+    code = malloc(pq_m);
+    if (!scratch || !code) {
+        goto fail_encode;
+    }
+    for (uint32_t i = 0; i < db->count; i++) {
+        uint32_t l = fp_encode(db, db->raw + (size_t)i * dim, code, scratch);
+        if (!fp_list_append(&list[l], pq_m, i, code)) {
+            goto fail_encode;
+        }
+    }
+
+    db->trained = true;
+    free(db->raw);
+    db->raw = NULL;
+    db->raw_cap = 0;
+    free(sample);
+    free(sub);
+    free(codebook);
+    free(pick);
+    free(scratch);
+    free(code);
+    return true;
+
+fail_encode:
+    for (uint32_t l = 0; l < lists; l++) {
+        free(list[l].ids);
+        free(list[l].codes);
+    }
+    db->centroids = NULL;
+    db->codebooks = NULL;
+    db->list = NULL;
+fail:
+    free(sample);
+    free(sub);
+    free(codebook);
+    free(pick);
+    free(centroids);
+    free(codebooks);
+    free(list);
+    free(scratch);
+    free(code);
+    errno = ENOMEM;
+    return false;
+}
+
+/**
+ * @brief Keep the k nearest, sorted, in hits
+ */
+static void push_hit(csi_fingerprint_hit_t *hits, uint32_t k, uint32_t *found, uint32_t id, float distance)
+{
+    if (*found == k && distance >= hits[k - 1].distance) {
+        return;
+    }
+    uint32_t i = *found < k ? (*found)++ : k - 1;
+    while (i > 0 && hits[i - 1].distance > distance) {
+        hits[i] = hits[i - 1];
+        i--;
+    }
+    hits[i].id = id;
+    hits[i].distance = distance;
+}
+
+int csi_fingerprint_search(const csi_fingerprint_t *db, const float *query, uint32_t probes, uint32_t k,
+                           csi_fingerprint_hit_t *hits)
+{
+    const uint32_t dim = db->config.dim, lists = db->config.lists, pq_m = db->config.pq_m;
+    uint32_t found = 0;
+    if (k == 0 || db->count == 0) {
+        return 0;
+    }
+
+    if (!db->trained) {
+        float dist[SCAN_BLOCK];
+        for (uint64_t base = 0; base < db->count; base += SCAN_BLOCK) {
+            uint32_t n = db->count - base < SCAN_BLOCK ? (uint32_t)(db->count - base) : SCAN_BLOCK;
+            csi_fingerprint_l2_many(query, db->raw + base * dim, n, dim, dist);
+            for (uint32_t i = 0; i < n; i++) {
+                push_hit(hits, k, &found, (uint32_t)(base + i), dist[i]);
+            }
+        }
+        return (int)found;
+    }
+
+    probes = probes == 0 ? 1 : probes > lists ? lists : probes;
+    float *coarse = malloc(lists * sizeof(float));
+    csi_fingerprint_hit_t *probe = malloc(probes * sizeof(*probe));
+    float *residual = malloc(dim * sizeof(float));
+    float *table = malloc((size_t)pq_m * CSI_FINGERPRINT_CODEWORDS * sizeof(float));
+    if (!coarse || !probe || !residual || !table) {
+        free(coarse);
+        free(probe);
+        free(residual);
+        free(table);
+        return -1;
+    }
+
+    csi_fingerprint_l2_many(query, db->centroids, lists, dim, coarse);
+    uint32_t nprobe = 0;
+    for (uint32_t l = 0; l < lists; l++) {
+        push_hit(probe, probes, &nprobe, l, coarse[l]);
+    }
+
+    float dist[SCAN_BLOCK];
+    for (uint32_t p = 0; p < nprobe; p++) {
+        const fp_list_t *list = &db->list[probe[p].id];
+        if (list->count == 0) {
+            continue;
+        }
+        const float *centroid = db->centroids + (size_t)probe[p].id * dim;
+        for (uint32_t d = 0; d < dim; d++) {
+            residual[d] = query[d] - centroid[d];
+        }
+        fp_pq_table(db, residual, table);
+
+        for (uint32_t base = 0; base < list->count; base += SCAN_BLOCK) {
+            uint32_t n = list->count - base < SCAN_BLOCK ? list->count - base : SCAN_BLOCK;
+            memset(dist, 0, n * sizeof(float));
+            for (uint32_t j = 0; j < pq_m; j++) {
+                const uint8_t *restrict col = list->codes + (size_t)j * list->cap + base;
+                const float *restrict t = table + j * CSI_FINGERPRINT_CODEWORDS;
+                for (uint32_t i = 0; i < n; i++) {
+                    dist[i] += t[col[i]];
+                }
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                push_hit(hits, k, &found, list->ids[base + i], dist[i]);
+            }
+        }
+    }
+
+    free(coarse);
+    free(probe);
+    free(residual);
+    free(table);
+    return (int)found;
+}
+
+bool csi_fingerprint_locate(const csi_fingerprint_t *db, const float *query, uint32_t probes, uint32_t k,
+                            csi_fingerprint_ref_t *out)
+{
+    csi_fingerprint_hit_t *hits = malloc((k ? k : 1) * sizeof(*hits));
+    if (!hits) {
+        return false;
+    }
+    int found = csi_fingerprint_search(db, query, probes, k, hits);
+    if (found <= 0) {
+        free(hits);
+        return false;
+    }
+
+    float x = 0, y = 0, z = 0, sw = 0;
+    for (int i = 0; i < found; i++) {
+        const csi_fingerprint_ref_t *ref = &db->refs[hits[i].id];
+        float w = 1.0f / (sqrtf(fmaxf(hits[i].distance, 0)) + LOCATE_EPSILON);
+        x += w * ref->x;
+        y += w * ref->y;
+        z += w * ref->z;
+        sw += w;
+    }
+    out->x = x / sw;
+    out->y = y / sw;
+    out->z = z / sw;
+    out->label = db->refs[hits[0].id].label;
+    free(hits);
+    return true;
+}
+
+const csi_fingerprint_ref_t *csi_fingerprint_ref(const csi_fingerprint_t *db, uint32_t id)
+{
+    return id < db->count ? &db->refs[id] : NULL;
+}
+
+void csi_fingerprint_get_info(const csi_fingerprint_t *db, csi_fingerprint_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    info->dim = db->config.dim;
+    info->lists = db->config.lists;
+    info->pq_m = db->config.pq_m;
+    info->trained = db->trained;
+    info->mapped = db->map != NULL;
+    info->vectors = db->count;
+    info->bytes = db->count * sizeof(csi_fingerprint_ref_t);
+    if (db->trained) {
+        info->bytes += (uint64_t)db->config.lists * db->config.dim * sizeof(float);
+        info->bytes += (uint64_t)CSI_FINGERPRINT_CODEWORDS * db->config.dim * sizeof(float);
+        for (uint32_t l = 0; l < db->config.lists; l++) {
+            info->bytes += (uint64_t)db->list[l].count * (sizeof(uint32_t) + db->config.pq_m);
+        }
+    } else {
+        info->bytes += db->count * db->config.dim * sizeof(float);
+    }
+}
+
+void fp_release(csi_fingerprint_t *db)
+{
+    if (db->list) {
+        for (uint32_t l = 0; l < db->config.lists; l++) {
+            if (db->list[l].owned) {
+                free(db->list[l].ids);
+                free(db->list[l].codes);
+            }
+        }
+        free(db->list);
+    }
+    if (!db->map) {
+        free(db->centroids);
+        free(db->codebooks);
+    }
+    if (db->refs_owned) {
+        free(db->refs);
+    }
+    free(db->raw);
+}
+
+void csi_fingerprint_destroy(csi_fingerprint_t *db)
+{
+    if (!db) {
+        return;
+    }
+    fp_release(db);
+    if (db->map) {
+        munmap((void *)db->map, db->map_size);
+    }
+    free(db);
+}
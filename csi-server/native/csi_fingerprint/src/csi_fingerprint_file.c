@@ -0,0 +1,298 @@
+/**
+ * @file csi_fingerprint_file.c
+ * @brief Saving a database and mapping it back
+ *
+ * File layout, every part at an 8-byte offset:
+ *
+ *     [header][coarse centroids][codebooks][positions][list directory][list]...[list]
+ *
+ * The centroids and codebooks are stored exactly as held in memory, and a
+ * list is its ids followed by its codes sub-quantizer by sub-quantizer
+ * (cap == count), so a mapped file is searched in place. All integers
+ * and floats are little-endian.
+ */
+
+#include "csi_fingerprint_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Databases are read in place and assume a little-endian host"
+#endif
+
+#define FILE_MAGIC      0x50465343u     // "CSFP"
+#define FILE_ALIGN      8
+
+typedef struct {
+    uint32_t magic;                     ///< FILE_MAGIC
+    uint16_t version;                   ///< CSI_FINGERPRINT_VERSION
+    uint16_t header_bytes;              ///< sizeof(file_header_t)
+    uint32_t dim;
+    uint32_t lists;
+    uint32_t pq_m;
+    uint32_t train_iterations;
+    uint64_t count;
+    uint64_t centroids_offset;
+    uint64_t codebooks_offset;
+    uint64_t refs_offset;
+    uint64_t lists_offset;
+    uint32_t seed;
+    uint32_t crc;                       ///< CRC-32 of the header up to here and the list directory
+} file_header_t;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t count;
+    uint32_t reserved;
+} file_list_t;
+
+_Static_assert(sizeof(file_header_t) % FILE_ALIGN == 0, "header size");
+_Static_assert(sizeof(file_list_t) % FILE_ALIGN == 0, "list directory size");
+
+static uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint64_t align_up(uint64_t n)
+{
+    return (n + FILE_ALIGN - 1) & ~(uint64_t)(FILE_ALIGN - 1);
+}
+
+static uint64_t list_bytes(uint32_t count, uint32_t pq_m)
+{
+    return align_up((uint64_t)count * sizeof(uint32_t)) + align_up((uint64_t)count * pq_m);
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static const uint8_t s_zero[FILE_ALIGN];
+
+static bool write_padded(int fd, const void *data, size_t len)
+{
+    return write_all(fd, data, len) && write_all(fd, s_zero, align_up(len) - len);
+}
+
+bool csi_fingerprint_save(const csi_fingerprint_t *db, const char *path)
+{
+    if (!db->trained) {
+        errno = EINVAL;
+        return false;
+    }
+    const uint32_t dim = db->config.dim, lists = db->config.lists, pq_m = db->config.pq_m;
+
+    file_list_t *dir = calloc(lists, sizeof(*dir));
+    char *tmp = malloc(strlen(path) + 5);
+    if (!dir || !tmp) {
+        free(dir);
+        free(tmp);
+        errno = ENOMEM;
+        return false;
+    }
+    file_header_t header = {
+        .magic = FILE_MAGIC,
+        .version = CSI_FINGERPRINT_VERSION,
+        .header_bytes = sizeof(file_header_t),
+        .dim = dim,
+        .lists = lists,
+        .pq_m = pq_m,
+        .train_iterations = db->config.train_iterations,
+        .count = db->count,
+        .seed = db->config.seed,
+    };
+    header.centroids_offset = sizeof(header);
+    header.codebooks_offset = header.centroids_offset + align_up((uint64_t)lists * dim * sizeof(float));
+    header.refs_offset = header.codebooks_offset + align_up((uint64_t)CSI_FINGERPRINT_CODEWORDS * dim * sizeof(float));
+    header.lists_offset = header.refs_offset + align_up(db->count * sizeof(csi_fingerprint_ref_t));
+    uint64_t offset = header.lists_offset + (uint64_t)lists * sizeof(file_list_t);
+    for (uint32_t l = 0; l < lists; l++) {
+        dir[l].offset = offset;
+        dir[l].count = db->list[l].count;
+        offset += list_bytes(db->list[l].count, pq_m);
+    }
+    header.crc = crc32_update(0, &header, offsetof(file_header_t, crc));
+    header.crc = crc32_update(header.crc, dir, lists * sizeof(*dir));
+
+    sprintf(tmp, "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0;
+    ok = ok && write_all(fd, &header, sizeof(header));
+    ok = ok && write_padded(fd, db->centroids, (size_t)lists * dim * sizeof(float));
+    ok = ok && write_padded(fd, db->codebooks, (size_t)CSI_FINGERPRINT_CODEWORDS * dim * sizeof(float));
+    ok = ok && write_padded(fd, db->refs, db->count * sizeof(csi_fingerprint_ref_t));
+    ok = ok && write_all(fd, dir, lists * sizeof(*dir));
+    for (uint32_t l = 0; ok && l < lists; l++) {
+        const fp_list_t *list = &db->list[l];
+        ok = write_padded(fd, list->ids, list->count * sizeof(uint32_t));
+        for (uint32_t j = 0; ok && j < pq_m; j++) {
+            ok = write_all(fd, list->codes + (size_t)j * list->cap, list->count);
+        }
+        uint64_t codes = (uint64_t)list->count * pq_m;
+        ok = ok && write_all(fd, s_zero, align_up(codes) - codes);
+    }
+    ok = ok && fsync(fd) == 0;
+    int err = errno;
+    if (fd >= 0 && close(fd) != 0 && ok) {
+        ok = false;
+        err = errno;
+    }
+    if (ok && rename(tmp, path) != 0) {
+        ok = false;
+        err = errno;
+    }
+    if (!ok) {
+        unlink(tmp);
+        errno = err;
+    }
+    free(dir);
+    free(tmp);
+    return ok;
+}
+
+/**
+ * @brief Check that [offset, offset + len) lies within size
+ */
+static bool within(uint64_t offset, uint64_t len, uint64_t size)
+{
+    return offset % FILE_ALIGN == 0 && offset <= size && len <= size - offset;
+}
+
+/**
+ * @brief Point the database at the sections of the mapping, checking each
+ */
+static bool load(csi_fingerprint_t *db)
+{
+    const uint64_t size = db->map_size;
+    if (size < sizeof(file_header_t)) {
+        return false;
+    }
+    const file_header_t *h = (const file_header_t *)db->map;
+    if (h->magic != FILE_MAGIC || h->version != CSI_FINGERPRINT_VERSION || h->header_bytes != sizeof(*h) ||
+        h->dim == 0 || h->dim > CSI_FINGERPRINT_MAX_DIM || h->pq_m == 0 || h->dim % h->pq_m || h->lists == 0 ||
+        h->count > UINT32_MAX ||
+        !within(h->centroids_offset, (uint64_t)h->lists * h->dim * sizeof(float), size) ||
+        !within(h->codebooks_offset, (uint64_t)CSI_FINGERPRINT_CODEWORDS * h->dim * sizeof(float), size) ||
+        !within(h->refs_offset, h->count * sizeof(csi_fingerprint_ref_t), size) ||
+        !within(h->lists_offset, (uint64_t)h->lists * sizeof(file_list_t), size)) {
+        return false;
+    }
+    const file_list_t *dir = (const file_list_t *)(db->map + h->lists_offset);
+    uint32_t crc = crc32_update(0, h, offsetof(file_header_t, crc));
+    if (crc32_update(crc, dir, h->lists * sizeof(*dir)) != h->crc) {
+        return false;
+    }
+
+    db->config.dim = h->dim;
+    db->config.lists = h->lists;
+    db->config.pq_m = h->pq_m;
+    db->config.train_iterations = h->train_iterations;
+    db->config.seed = h->seed;
+    db->dsub = h->dim / h->pq_m;
+    db->trained = true;
+    db->count = h->count;
+    db->centroids = (float *)(db->map + h->centroids_offset);
+    db->codebooks = (float *)(db->map + h->codebooks_offset);
+    db->refs = (csi_fingerprint_ref_t *)(db->map + h->refs_offset);
+    db->ref_cap = h->count;
+    db->refs_owned = false;
+    db->list = calloc(h->lists, sizeof(*db->list));
+    if (!db->list) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    uint64_t total = 0;
+    for (uint32_t l = 0; l < h->lists; l++) {
+        if (!within(dir[l].offset, list_bytes(dir[l].count, h->pq_m), size)) {
+            return false;
+        }
+        fp_list_t *list = &db->list[l];
+        list->count = list->cap = dir[l].count;
+        list->ids = (uint32_t *)(db->map + dir[l].offset);
+        list->codes = (uint8_t *)(db->map + dir[l].offset + align_up((uint64_t)dir[l].count * sizeof(uint32_t)));
+        for (uint32_t i = 0; i < list->count; i++) {
+            if (list->ids[i] >= h->count) {
+                return false;
+            }
+        }
+        total += list->count;
+    }
+    return total == h->count;
+}
+
+csi_fingerprint_t *csi_fingerprint_open(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if (st.st_size < (off_t)sizeof(file_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = err;
+        return NULL;
+    }
+
+    csi_fingerprint_config_t config = CSI_FINGERPRINT_CONFIG_DEFAULT();
+    csi_fingerprint_t *db = calloc(1, sizeof(*db));
+    if (!db) {
+        munmap(map, st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    db->config = config;
+    db->map = map;
+    db->map_size = st.st_size;
+    errno = 0;
+    if (!load(db)) {
+        err = errno == ENOMEM ? ENOMEM : EINVAL;
+        csi_fingerprint_destroy(db);
+        errno = err;
+        return NULL;
+    }
+    db->rng = db->config.seed;
+    return db;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file csi_fingerprint_internal.h
+ * @brief Database layout shared by the index, the trainer and the file code
+ */
+
+#ifndef CSI_FINGERPRINT_INTERNAL_H
+#define CSI_FINGERPRINT_INTERNAL_H
+
+#include "csi_fingerprint.h"
+
+/**
+ * @brief One inverted list
+ *
+ * Codes are stored sub-quantizer by sub-quantizer: code j of entry i is
+ * codes[j * cap + i]. A list read from a file points into the mapping
+ * with cap == count and is copied to the heap when it grows.
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *ids;
+    uint8_t *codes;
+    bool owned;
+} fp_list_t;
+
+struct csi_fingerprint {
+    csi_fingerprint_config_t config;
+    uint32_t dsub;                      ///< dim / pq_m
+    bool trained;
+
+    float *centroids;                   ///< lists * dim
+    float *codebooks;                   ///< Per sub-quantizer, dsub rows of CSI_FINGERPRINT_CODEWORDS
+    fp_list_t *list;
+
+    uint64_t count;                     ///< Vectors added
+    csi_fingerprint_ref_t *refs;        ///< count positions
+    uint64_t ref_cap;
+    bool refs_owned;
+
+    float *raw;                         ///< count * dim vectors until trained
+    uint64_t raw_cap;
+
+    const uint8_t *map;                 ///< Mapped file, or NULL
+    size_t map_size;
+    uint32_t rng;
+};
+
+/**
+ * @brief Next value of the database's xorshift generator
+ */
+uint32_t fp_random(uint32_t *state);
+
+/**
+ * @brief Squared L2 distances of x to k vectors stored transposed
+ * @param x dim values
+ * @param transposed dim rows of k values: component d of vector c at [d * k + c]
+ * @param k Vectors
+ * @param dim Vector length
+ * @param out k distances
+ */
+void fp_l2_transposed(const float *x, const float *transposed, uint32_t k, uint32_t dim, float *out);
+
+/**
+ * @brief Index of the smallest of n values
+ */
+uint32_t fp_argmin(const float *v, uint32_t n);
+
+/**
+ * @brief Lloyd's k-means from k distinct samples
+ * @param x n * dim vectors
+ * @param n Number of vectors, at least k
+ * @param dim Vector length
+ * @param k Clusters
+ * @param iterations Iterations
+ * @param rng Generator state
+ * @param centroids k * dim output
+ * @return false if out of memory
+ */
+bool fp_kmeans(const float *x, uint32_t n, uint32_t dim, uint32_t k, uint32_t iterations, uint32_t *rng,
+               float *centroids);
+
+/**
+ * @brief Distances of a residual's sub-vectors to every codeword
+ * @param db Trained database
+ * @param residual dim values
+ * @param table pq_m * CSI_FINGERPRINT_CODEWORDS distances
+ */
+void fp_pq_table(const csi_fingerprint_t *db, const float *residual, float *table);
+
+/**
+ * @brief Floats of scratch fp_encode() needs
+ */
+size_t fp_encode_scratch(const csi_fingerprint_t *db);
+
+/**
+ * @brief Quantize one vector: its list and the pq_m codes of its residual
+ * @return The list
+ */
+uint32_t fp_encode(const csi_fingerprint_t *db, const float *vector, uint8_t *code, float *scratch);
+
+/**
+ * @brief Append an encoded vector to a list
+ * @return false if out of memory
+ */
+bool fp_list_append(fp_list_t *list, uint32_t pq_m, uint32_t id, const uint8_t *code);
+
+/**
+ * @brief Free what the database owns, not the database itself
+ */
+void fp_release(csi_fingerprint_t *db);
+
+#endif // CSI_FINGERPRINT_INTERNAL_H
@@ -0,0 +1,227 @@
+/**
+ * @file csi_fingerprint_quant.c
+ * @brief Distance kernels, k-means and product quantization
+ *
+ * The kernels are plain loops shaped for the vectoriser: the L2 distance
+ * keeps LANES independent partial sums so the reduction needs no
+ * reassociation, and distances to many centroids are computed from a
+ * transposed copy, one component at a time across all centroids.
+ */
+
+#include "csi_fingerprint_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LANES           16
+#define SPLIT_EPSILON   (1.0f / 1024)   ///< Relative nudge when an empty cluster takes half of another
+
+float csi_fingerprint_l2(const float *a, const float *b, uint32_t dim)
+{
+    float acc[LANES] = { 0 };
+    uint32_t i = 0;
+    for (; i + LANES <= dim; i += LANES) {
+        for (int l = 0; l < LANES; l++) {
+            float d = a[i + l] - b[i + l];
+            acc[l] += d * d;
+        }
+    }
+    for (int l = 0; i < dim; i++, l++) {
+        float d = a[i] - b[i];
+        acc[l] += d * d;
+    }
+    float sum = 0;
+    for (int l = 0; l < LANES; l++) {
+        sum += acc[l];
+    }
+    return sum;
+}
+
+void csi_fingerprint_l2_many(const float *query, const float *vectors, uint32_t n, uint32_t dim, float *out)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = csi_fingerprint_l2(query, vectors + (size_t)i * dim, dim);
+    }
+}
+
+void fp_l2_transposed(const float *x, const float *transposed, uint32_t k, uint32_t dim, float *out)
+{
+    memset(out, 0, k * sizeof(*out));
+    for (uint32_t d = 0; d < dim; d++) {
+        const float v = x[d];
+        const float *restrict row = transposed + (size_t)d * k;
+        float *restrict o = out;
+        for (uint32_t c = 0; c < k; c++) {
+            float t = v - row[c];
+            o[c] += t * t;
+        }
+    }
+}
+
+uint32_t fp_argmin(const float *v, uint32_t n)
+{
+    uint32_t best = 0;
+    for (uint32_t i = 1; i < n; i++) {
+        best = v[i] < v[best] ? i : best;
+    }
+    return best;
+}
+
+uint32_t fp_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void transpose(const float *in, uint32_t rows, uint32_t cols, float *out)
+{
+    for (uint32_t r = 0; r < rows; r++) {
+        for (uint32_t c = 0; c < cols; c++) {
+            out[(size_t)c * rows + r] = in[(size_t)r * cols + c];
+        }
+    }
+}
+
+bool fp_kmeans(const float *x, uint32_t n, uint32_t dim, uint32_t k, uint32_t iterations, uint32_t *rng,
+               float *centroids)
+{
+    uint32_t *pick = malloc(n * sizeof(*pick));
+    uint32_t *size = malloc(k * sizeof(*size));
+    float *transposed = malloc((size_t)k * dim * sizeof(*transposed));
+    float *dist = malloc(k * sizeof(*dist));
+    if (!pick || !size || !transposed || !dist) {
+        free(pick);
+        free(size);
+        free(transposed);
+        free(dist);
+        return false;
+    }
+
+    // Start from k distinct samples
+    for (uint32_t i = 0; i < n; i++) {
+        pick[i] = i;
+    }
+    for (uint32_t i = 0; i < k; i++) {
+        uint32_t j = i + fp_random(rng) % (n - i);
+        uint32_t t = pick[i];
+        pick[i] = pick[j];
+        pick[j] = t;
+        memcpy(centroids + (size_t)i * dim, x + (size_t)pick[i] * dim, dim * sizeof(float));
+    }
+
+    for (uint32_t it = 0; it < iterations; it++) {
+        transpose(centroids, k, dim, transposed);
+        memset(centroids, 0, (size_t)k * dim * sizeof(float));
+        memset(size, 0, k * sizeof(*size));
+        for (uint32_t i = 0; i < n; i++) {
+            const float *v = x + (size_t)i * dim;
+            fp_l2_transposed(v, transposed, k, dim, dist);
+            uint32_t c = fp_argmin(dist, k);
+            float *sum = centroids + (size_t)c * dim;
+            for (uint32_t d = 0; d < dim; d++) {
+                sum[d] += v[d];
+            }
+            size[c]++;
+        }
+        for (uint32_t c = 0; c < k; c++) {
+            float inv = size[c] ? 1.0f / size[c] : 0;
+            for (uint32_t d = 0; d < dim; d++) {
+                centroids[(size_t)c * dim + d] *= inv;
+            }
+        }
+
+        // An empty cluster takes half of the largest, nudged apart from it
+        for (uint32_t c = 0; c < k; c++) {
+            if (size[c]) {
+                continue;
+            }
+            uint32_t big = 0;
+            for (uint32_t b = 1; b < k; b++) {
+                big = size[b] > size[big] ? b : big;
+            }
+            float *from = centroids + (size_t)big * dim, *to = centroids + (size_t)c * dim;
+            for (uint32_t d = 0; d < dim; d++) {
+                float sign = d % 2 ? 1.0f : -1.0f;
+                to[d] = from[d] * (1 + sign * SPLIT_EPSILON);
+                from[d] *= 1 - sign * SPLIT_EPSILON;
+            }
+            size[c] = size[big] / 2;
+            size[big] -= size[c];
+        }
+    }
+
+    free(pick);
+    free(size);
+    free(transposed);
+    free(dist);
+    return true;
+}
+
+void fp_pq_table(const csi_fingerprint_t *db, const float *residual, float *table)
+{
+    const uint32_t dsub = db->dsub;
+    for (uint32_t j = 0; j < db->config.pq_m; j++) {
+        fp_l2_transposed(residual + j * dsub, db->codebooks + (size_t)j * dsub * CSI_FINGERPRINT_CODEWORDS,
+                         CSI_FINGERPRINT_CODEWORDS, dsub, table + j * CSI_FINGERPRINT_CODEWORDS);
+    }
+}
+
+size_t fp_encode_scratch(const csi_fingerprint_t *db)
+{
+    size_t table = (size_t)db->config.pq_m * CSI_FINGERPRINT_CODEWORDS;
+    return db->config.dim + (db->config.lists > table ? db->config.lists : table);
+}
+
+uint32_t fp_encode(const csi_fingerprint_t *db, const float *vector, uint8_t *code, float *scratch)
+{
+    const uint32_t dim = db->config.dim;
+    float *residual = scratch, *dist = scratch + dim;
+    csi_fingerprint_l2_many(vector, db->centroids, db->config.lists, dim, dist);
+    uint32_t list = fp_argmin(dist, db->config.lists);
+
+    const float *centroid = db->centroids + (size_t)list * dim;
+    for (uint32_t d = 0; d < dim; d++) {
+        residual[d] = vector[d] - centroid[d];
+    }
+    fp_pq_table(db, residual, dist);
+    for (uint32_t j = 0; j < db->config.pq_m; j++) {
+        code[j] = (uint8_t)fp_argmin(dist + j * CSI_FINGERPRINT_CODEWORDS, CSI_FINGERPRINT_CODEWORDS);
+    }
+    return list;
+}
+
+bool fp_list_append(fp_list_t *list, uint32_t pq_m, uint32_t id, const uint8_t *code)
+{
+    if (list->count == list->cap || !list->owned) {
+        uint32_t cap = list->cap > list->count ? list->cap : list->cap ? 2 * list->cap : 16;
+        uint32_t *ids = malloc(cap * sizeof(*ids));
+        uint8_t *codes = malloc((size_t)cap * pq_m);
+        if (!ids || !codes) {
+            free(ids);
+            free(codes);
+            return false;
+        }
+        if (list->count) {
+            memcpy(ids, list->ids, list->count * sizeof(*ids));
+            for (uint32_t j = 0; j < pq_m; j++) {
+                memcpy(codes + (size_t)j * cap, list->codes + (size_t)j * list->cap, list->count);
+            }
+        }
+        if (list->owned) {
+            free(list->ids);
+            free(list->codes);
+        }
+        list->ids = ids;
+        list->codes = codes;
+        list->cap = cap;
+        list->owned = true;
+    }
+    for (uint32_t j = 0; j < pq_m; j++) {
+        list->codes[(size_t)j * list->cap + list->count] = code[j];
+    }
+    list->ids[list->count++] = id;
+    return true;
+}
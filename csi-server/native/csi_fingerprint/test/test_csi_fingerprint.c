@@ -0,0 +1,281 @@
+/**
+ * @file test_csi_fingerprint.c
+ * @brief Unit tests for the fingerprint database
+ */
+
+#define _GNU_SOURCE
+#include <unity.h>
+#include <errno.h>
+#include <ftw.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "csi_fingerprint.h"
+
+#define DIM         32
+#define CLUSTERS    40
+#define VECTORS     4000
+#define LISTS       16
+#define PQ_M        8
+
+static float s_vectors[VECTORS * DIM];
+static csi_fingerprint_ref_t s_refs[VECTORS];
+static char s_dir[64];
+static char s_path[96];
+static uint32_t s_rng;
+
+static float uniform(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (s_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+void setUp(void)
+{
+    // Vectors scattered around CLUSTERS centres, one centre per surveyed room
+    float centre[CLUSTERS][DIM];
+    s_rng = 7;
+    for (int c = 0; c < CLUSTERS; c++) {
+        for (int d = 0; d < DIM; d++) {
+            centre[c][d] = 10.0f * uniform();
+        }
+    }
+    for (int i = 0; i < VECTORS; i++) {
+        int c = i % CLUSTERS;
+        for (int d = 0; d < DIM; d++) {
+            s_vectors[i * DIM + d] = centre[c][d] + uniform() - 0.5f;
+        }
+        s_refs[i] = (csi_fingerprint_ref_t){ .x = (float)c, .y = (float)(i / CLUSTERS), .z = 1.0f, .label = c };
+    }
+
+    snprintf(s_dir, sizeof(s_dir), "/tmp/csi_fingerprint_test_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(s_dir));
+    snprintf(s_path, sizeof(s_path), "%s/survey.csfp", s_dir);
+}
+
+void tearDown(void)
+{
+    nftw(s_dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+static csi_fingerprint_t *create(uint32_t train_size)
+{
+    csi_fingerprint_config_t config = CSI_FINGERPRINT_CONFIG_DEFAULT();
+    config.dim = DIM;
+    config.lists = LISTS;
+    config.pq_m = PQ_M;
+    config.train_size = train_size;
+    csi_fingerprint_t *db = csi_fingerprint_create(&config);
+    TEST_ASSERT_NOT_NULL(db);
+    return db;
+}
+
+/**
+ * @brief Fraction of stored vectors found among the k nearest to themselves
+ */
+static float self_recall(const csi_fingerprint_t *db, uint32_t probes, uint32_t k)
+{
+    csi_fingerprint_hit_t hits[16];
+    int found = 0;
+    for (int i = 0; i < VECTORS; i += 37) {
+        int n = csi_fingerprint_search(db, &s_vectors[i * DIM], probes, k, hits);
+        for (int h = 0; h < n; h++) {
+            found += hits[h].id == (uint32_t)i;
+        }
+    }
+    return found / (float)((VECTORS + 36) / 37);
+}
+
+static void test_csi_fingerprint_l2(void)
+{
+    float a[70], b[70];
+    for (int i = 0; i < 70; i++) {
+        a[i] = uniform();
+        b[i] = uniform();
+    }
+    for (uint32_t dim = 1; dim <= 70; dim++) {
+        float expected = 0;
+        for (uint32_t i = 0; i < dim; i++) {
+            expected += (a[i] - b[i]) * (a[i] - b[i]);
+        }
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected, csi_fingerprint_l2(a, b, dim));
+    }
+}
+
+static void test_csi_fingerprint_untrained_is_exact(void)
+{
+    csi_fingerprint_t *db = create(0);
+    TEST_ASSERT_EQUAL_INT64(0, csi_fingerprint_add(db, s_vectors, s_refs, 500));
+    TEST_ASSERT_EQUAL_INT64(500, csi_fingerprint_add(db, s_vectors + 500 * DIM, s_refs + 500, 500));
+
+    csi_fingerprint_hit_t hits[5];
+    TEST_ASSERT_EQUAL_INT(5, csi_fingerprint_search(db, &s_vectors[123 * DIM], 1, 5, hits));
+    TEST_ASSERT_EQUAL_UINT32(123, hits[0].id);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, hits[0].distance);
+    for (int h = 1; h < 5; h++) {
+        TEST_ASSERT_TRUE(hits[h].distance >= hits[h - 1].distance);
+        TEST_ASSERT_EQUAL_UINT32(123 % CLUSTERS, csi_fingerprint_ref(db, hits[h].id)->label);
+    }
+
+    csi_fingerprint_ref_t pos;
+    TEST_ASSERT_TRUE(csi_fingerprint_locate(db, &s_vectors[123 * DIM], 1, 3, &pos));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, s_refs[123].x, pos.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, s_refs[123].y, pos.y);
+    TEST_ASSERT_EQUAL_UINT32(s_refs[123].label, pos.label);
+    csi_fingerprint_destroy(db);
+}
+
+static void test_csi_fingerprint_train_and_search(void)
+{
+    csi_fingerprint_t *db = create(0);
+    TEST_ASSERT_EQUAL_INT64(0, csi_fingerprint_add(db, s_vectors, s_refs, VECTORS));
+    TEST_ASSERT_TRUE(csi_fingerprint_train(db));
+
+    csi_fingerprint_info_t info;
+    csi_fingerprint_get_info(db, &info);
+    TEST_ASSERT_TRUE(info.trained);
+    TEST_ASSERT_EQUAL_UINT64(VECTORS, info.vectors);
+    // Codes and ids take PQ_M + 4 bytes per vector against 4 * DIM raw
+    TEST_ASSERT_TRUE(info.bytes < (uint64_t)VECTORS * DIM * sizeof(float) / 2);
+
+    TEST_ASSERT_TRUE(self_recall(db, LISTS, 10) > 0.9f);
+    TEST_ASSERT_TRUE(self_recall(db, 2, 10) > 0.8f);
+
+    // Nearest neighbours of a query are in its own cluster
+    csi_fingerprint_hit_t hits[10];
+    TEST_ASSERT_EQUAL_INT(10, csi_fingerprint_search(db, &s_vectors[5 * DIM], 2, 10, hits));
+    for (int h = 0; h < 10; h++) {
+        TEST_ASSERT_EQUAL_UINT32(5, csi_fingerprint_ref(db, hits[h].id)->label);
+    }
+    csi_fingerprint_ref_t pos;
+    TEST_ASSERT_TRUE(csi_fingerprint_locate(db, &s_vectors[5 * DIM], 2, 10, &pos));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 5.0f, pos.x);
+    TEST_ASSERT_EQUAL_UINT32(5, pos.label);
+    csi_fingerprint_destroy(db);
+}
+
+static void test_csi_fingerprint_trains_itself(void)
+{
+    csi_fingerprint_t *db = create(1000);
+    csi_fingerprint_info_t info;
+    for (int i = 0; i < VECTORS; i += 250) {
+        TEST_ASSERT_EQUAL_INT64(i, csi_fingerprint_add(db, s_vectors + i * DIM, s_refs + i, 250));
+        csi_fingerprint_get_info(db, &info);
+        TEST_ASSERT_EQUAL(i + 250 >= 1000, info.trained);
+    }
+    TEST_ASSERT_EQUAL_UINT64(VECTORS, info.vectors);
+    // Vectors added after training were encoded with the trained quantizers
+    TEST_ASSERT_TRUE(self_recall(db, LISTS, 10) > 0.9f);
+    errno = 0;
+    TEST_ASSERT_FALSE(csi_fingerprint_train(db));
+    TEST_ASSERT_EQUAL_INT(EALREADY, errno);
+    csi_fingerprint_destroy(db);
+}
+
+static void test_csi_fingerprint_save_and_map(void)
+{
+    csi_fingerprint_t *db = create(0);
+    csi_fingerprint_add(db, s_vectors, s_refs, VECTORS - 1);
+    TEST_ASSERT_TRUE(csi_fingerprint_train(db));
+    TEST_ASSERT_TRUE(csi_fingerprint_save(db, s_path));
+
+    csi_fingerprint_t *mapped = csi_fingerprint_open(s_path);
+    TEST_ASSERT_NOT_NULL(mapped);
+    csi_fingerprint_info_t info;
+    csi_fingerprint_get_info(mapped, &info);
+    TEST_ASSERT_TRUE(info.mapped);
+    TEST_ASSERT_EQUAL_UINT32(DIM, info.dim);
+    TEST_ASSERT_EQUAL_UINT64(VECTORS - 1, info.vectors);
+
+    csi_fingerprint_hit_t a[10], b[10];
+    for (int i = 0; i < VECTORS; i += 101) {
+        int n = csi_fingerprint_search(db, &s_vectors[i * DIM], 3, 10, a);
+        TEST_ASSERT_EQUAL_INT(n, csi_fingerprint_search(mapped, &s_vectors[i * DIM], 3, 10, b));
+        TEST_ASSERT_EQUAL_MEMORY(a, b, n * sizeof(a[0]));
+    }
+    TEST_ASSERT_EQUAL_FLOAT(s_refs[42].y, csi_fingerprint_ref(mapped, 42)->y);
+
+    // Adding to a mapped database copies what grows; the file stays as saved
+    const float *last = &s_vectors[(VECTORS - 1) * DIM];
+    TEST_ASSERT_EQUAL_INT64(VECTORS - 1, csi_fingerprint_add(mapped, last, &s_refs[VECTORS - 1], 1));
+    TEST_ASSERT_EQUAL_INT(1, csi_fingerprint_search(mapped, last, LISTS, 1, a));
+    TEST_ASSERT_EQUAL_UINT32(VECTORS - 1, a[0].id);
+    TEST_ASSERT_EQUAL_FLOAT(s_refs[42].y, csi_fingerprint_ref(mapped, 42)->y);
+    csi_fingerprint_destroy(mapped);
+
+    mapped = csi_fingerprint_open(s_path);
+    TEST_ASSERT_NOT_NULL(mapped);
+    csi_fingerprint_get_info(mapped, &info);
+    TEST_ASSERT_EQUAL_UINT64(VECTORS - 1, info.vectors);
+    csi_fingerprint_destroy(mapped);
+    csi_fingerprint_destroy(db);
+}
+
+static void test_csi_fingerprint_rejects_corrupt_file(void)
+{
+    csi_fingerprint_t *db = create(0);
+    csi_fingerprint_add(db, s_vectors, s_refs, 1000);
+    TEST_ASSERT_TRUE(csi_fingerprint_train(db));
+    TEST_ASSERT_TRUE(csi_fingerprint_save(db, s_path));
+    csi_fingerprint_destroy(db);
+
+    FILE *f = fopen(s_path, "r+b");
+    TEST_ASSERT_NOT_NULL(f);
+    fseek(f, 16, SEEK_SET);
+    fputc(0x7F, f);
+    fclose(f);
+    errno = 0;
+    TEST_ASSERT_NULL(csi_fingerprint_open(s_path));
+    TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+
+    TEST_ASSERT_EQUAL_INT(0, truncate(s_path, 8));
+    TEST_ASSERT_NULL(csi_fingerprint_open(s_path));
+    TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+static void test_csi_fingerprint_invalid(void)
+{
+    csi_fingerprint_config_t config = CSI_FINGERPRINT_CONFIG_DEFAULT();
+    TEST_ASSERT_NULL(csi_fingerprint_create(&config));
+    config.dim = 30;
+    config.pq_m = 8;
+    TEST_ASSERT_NULL(csi_fingerprint_create(&config));
+    TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+
+    csi_fingerprint_t *db = create(0);
+    csi_fingerprint_hit_t hits[1];
+    TEST_ASSERT_EQUAL_INT(0, csi_fingerprint_search(db, s_vectors, 1, 1, hits));
+    csi_fingerprint_add(db, s_vectors, s_refs, 100);
+    errno = 0;
+    TEST_ASSERT_FALSE(csi_fingerprint_train(db));
+    TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+    TEST_ASSERT_FALSE(csi_fingerprint_save(db, s_path));
+    TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+    TEST_ASSERT_NULL(csi_fingerprint_ref(db, 100));
+    csi_fingerprint_destroy(db);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_csi_fingerprint_l2);
+    RUN_TEST(test_csi_fingerprint_untrained_is_exact);
+    RUN_TEST(test_csi_fingerprint_train_and_search);
+    RUN_TEST(test_csi_fingerprint_trains_itself);
+    RUN_TEST(test_csi_fingerprint_save_and_map);
+    RUN_TEST(test_csi_fingerprint_rejects_corrupt_file);
+    RUN_TEST(test_csi_fingerprint_invalid);
+
+    return UNITY_END();
+}
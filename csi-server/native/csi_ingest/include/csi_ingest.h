@@ -0,0 +1,200 @@
+/**
+ * @file csi_ingest.h
+ * @brief Worker pool that decodes CSI messages into per-node column batches
+ *
+ * The network side hands every message published to <prefix>/csi_data or
+ * <prefix>/csi_frame to csi_ingest_submit() together with the node's
+ * prefix. Messages are routed by node to one of the workers through a
+ * bounded byte queue, so all frames of a node are decoded in order by the
+ * same thread and need no locking. A worker decodes JSON
+ * (csi_collector_data_to_json()) and binary frames (csi_frame_header_t)
+ * into the same columns and hands each full batch, or one that has waited
+ * flush_ms, to the sink.
+ *
+ * Memory is bounded by the configuration: workers * queue_bytes for the
+ * queues and max_nodes * batch_frames * CSI_INGEST_FRAME_BYTES for the
+ * columns. Messages that do not fit are dropped and counted, never queued
+ * without limit.
+ */
+
+#ifndef CSI_INGEST_H
+#define CSI_INGEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "csi_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_INGEST_MAX_WORKERS  64
+#define CSI_INGEST_MAX_NODE_LEN 64      ///< Longest node name (topic prefix)
+#define CSI_INGEST_IQ_STRIDE    (2 * CSI_MAX_SUBCARRIERS)
+
+/**
+ * @brief Column bytes per frame of a batch
+ */
+#define CSI_INGEST_FRAME_BYTES  (4 + 8 + 6 + 5 + CSI_INGEST_IQ_STRIDE + \
+                                 2 * CSI_MAX_SUBCARRIERS * sizeof(float))
+
+/**
+ * @brief Payload encoding of a message
+ */
+typedef enum {
+    CSI_INGEST_FORMAT_AUTO = 0,     ///< Decide from the first bytes
+    CSI_INGEST_FORMAT_JSON,         ///< <prefix>/csi_data
+    CSI_INGEST_FORMAT_FRAME,        ///< <prefix>/csi_frame
+} csi_ingest_format_t;
+
+/**
+ * @brief Batch of consecutive frames of one node, stored by column
+ *
+ * Row i of every column belongs to the same frame. Per-subcarrier columns
+ * have a fixed stride: CSI_INGEST_IQ_STRIDE bytes of iq and
+ * CSI_MAX_SUBCARRIERS floats of amplitude and phase per frame, of which
+ * subcarrier_count[i] are valid. iq is only valid for frames with
+ * CSI_FRAME_FLAG_RAW in flags; JSON carries amplitude and phase only.
+ * Amplitude and phase of binary frames are derived from iq exactly as the
+ * collector derives them, so both formats give the same numbers.
+ */
+typedef struct {
+    const char *node;               ///< Node name, NUL terminated
+    uint32_t count;                 ///< Frames in the batch
+    const uint32_t *sequence;
+    const uint64_t *timestamp;      ///< Microseconds, uptime unless CSI_FRAME_FLAG_UTC
+    const uint8_t *mac;             ///< 6 bytes per frame
+    const int8_t *rssi;
+    const uint8_t *channel;
+    const uint8_t *secondary_channel;
+    const uint8_t *subcarrier_count;
+    const uint8_t *flags;           ///< CSI_FRAME_FLAG_* bits
+    const int8_t *iq;               ///< Raw CSI in radio order
+    const float *amplitude;
+    const float *phase;
+} csi_ingest_batch_t;
+
+/**
+ * @brief Consumer of sealed batches
+ *
+ * Called on a worker thread; different nodes may be delivered from
+ * different workers at the same time. The batch is only valid during the
+ * call.
+ */
+typedef void (*csi_ingest_sink_t)(const csi_ingest_batch_t *batch, void *ctx);
+
+/**
+ * @brief Ingest configuration
+ */
+typedef struct {
+    int workers;                    ///< Worker threads (1-CSI_INGEST_MAX_WORKERS)
+    size_t queue_bytes;             ///< Queue capacity of each worker
+    uint32_t batch_frames;          ///< Frames per batch
+    uint32_t flush_ms;              ///< Longest time a frame waits in a partial batch
+    uint32_t max_nodes;             ///< Nodes with columns at once
+    uint32_t node_idle_ms;          ///< Columns of a silent node are released after this
+    csi_ingest_sink_t sink;         ///< Batch consumer, or NULL to only count
+    void *sink_ctx;
+} csi_ingest_config_t;
+
+/**
+ * @brief Default configuration: one worker per CPU, 64-frame batches
+ */
+#define CSI_INGEST_CONFIG_DEFAULT() {   \
+    .workers = 0,                       \
+    .queue_bytes = 8 * 1024 * 1024,     \
+    .batch_frames = 64,                 \
+    .flush_ms = 1000,                   \
+    .max_nodes = 4096,                  \
+    .node_idle_ms = 60000,              \
+}
+
+/**
+ * @brief Result of csi_ingest_submit()
+ */
+typedef enum {
+    CSI_INGEST_QUEUED = 0,
+    CSI_INGEST_QUEUE_FULL,          ///< Worker queue has no room, message dropped
+    CSI_INGEST_INVALID,             ///< Empty payload or node name too long
+} csi_ingest_result_t;
+
+/**
+ * @brief Counters, summed over the workers
+ */
+typedef struct {
+    uint64_t messages;              ///< Accepted by csi_ingest_submit()
+    uint64_t bytes;                 ///< Payload bytes accepted
+    uint64_t queue_full;            ///< Dropped because a queue was full
+    uint64_t invalid;               ///< Rejected by csi_ingest_submit()
+    uint64_t frames;                ///< Decoded into columns
+    uint64_t frames_json;
+    uint64_t frames_binary;
+    uint64_t decode_errors;         ///< Messages that did not decode
+    uint64_t node_limit;            ///< Dropped because max_nodes nodes had columns
+    uint64_t sequence_gaps;         ///< Frames missing between consecutive sequence numbers
+    uint64_t sequence_resets;       ///< Sequence went backwards (node restarted)
+    uint64_t batches;               ///< Delivered to the sink
+    uint64_t batches_partial;       ///< Of those, sealed by flush_ms or at shutdown
+    uint32_t nodes;                 ///< Nodes with columns now
+    uint32_t nodes_evicted;         ///< Columns released for idleness
+    size_t queued_bytes;            ///< Waiting in the queues now
+    size_t queued_bytes_peak;       ///< Highest fill of any single queue
+} csi_ingest_stats_t;
+
+typedef struct csi_ingest csi_ingest_t;
+
+/**
+ * @brief Start the worker pool
+ * @param config Configuration; zero fields take the defaults
+ * @return Handle, or NULL if out of memory or threads could not start
+ */
+csi_ingest_t *csi_ingest_create(const csi_ingest_config_t *config);
+
+/**
+ * @brief Queue one message for decoding
+ *
+ * Never blocks. Must be called from a single thread.
+ *
+ * @param ingest Handle
+ * @param node Node name (the topic prefix), need not be terminated
+ * @param node_len Length of node
+ * @param format Payload encoding
+ * @param payload Message payload, copied
+ * @param len Payload length
+ * @return CSI_INGEST_QUEUED, or why the message was dropped
+ */
+csi_ingest_result_t csi_ingest_submit(csi_ingest_t *ingest, const char *node, size_t node_len,
+                                      csi_ingest_format_t format, const uint8_t *payload, size_t len);
+
+/**
+ * @brief Read the counters
+ */
+void csi_ingest_get_stats(csi_ingest_t *ingest, csi_ingest_stats_t *stats);
+
+/**
+ * @brief Decode what is queued, hand every partial batch to the sink and stop
+ * @param ingest Handle, freed
+ */
+void csi_ingest_destroy(csi_ingest_t *ingest);
+
+/**
+ * @brief Split a CSI topic into node name and format
+ *
+ * Accepts <node>/csi_data and <node>/csi_frame. A leading $share/<group>/
+ * is not part of a received topic and needs no handling.
+ *
+ * @param topic Topic, need not be terminated
+ * @param topic_len Length of topic
+ * @param node_len Length of the node name at the start of topic
+ * @param format Format implied by the topic
+ * @return true if topic is a CSI topic
+ */
+bool csi_ingest_parse_topic(const char *topic, size_t topic_len, size_t *node_len,
+                            csi_ingest_format_t *format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_INGEST_H
@@ -0,0 +1,602 @@
+/**
+ * @file csi_ingest.c
+ * @brief Worker pool that decodes CSI messages into per-node column batches
+ */
+
+#include "csi_ingest.h"
+#include "csi_ingest_decode.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define QUEUE_ALIGN         8
+#define QUEUE_WRAP          0xFFFFFFFFu     // Rest of the ring is unused, continue at the start
+#define MIN_QUEUE_BYTES     (64 * 1024)
+#define MIN_SCAN_MS         10
+
+#define TOPIC_SUFFIX_JSON   "/" CSI_TOPIC_JSON
+#define TOPIC_SUFFIX_FRAME  "/" CSI_TOPIC_FRAME
+
+/**
+ * @brief Message header in a worker queue, followed by node name, payload and a NUL
+ */
+typedef struct {
+    uint32_t size;              ///< Whole record, aligned; QUEUE_WRAP marks the end of the ring
+    uint32_t payload_len;
+    uint8_t node_len;
+    uint8_t format;
+    uint16_t reserved;
+    uint32_t hash;
+} queue_record_t;
+
+/**
+ * @brief Node with its current batch
+ */
+typedef struct ingest_node {
+    struct ingest_node *next;   ///< Hash chain
+    uint32_t hash;
+    uint32_t count;             ///< Frames in the batch
+    int64_t batch_start_ms;     ///< Arrival of the first frame of the batch
+    int64_t last_frame_ms;
+    bool have_sequence;
+    uint32_t next_sequence;
+    char name[CSI_INGEST_MAX_NODE_LEN + 1];
+
+    // Columns of batch_frames rows, widest first
+    uint64_t *timestamp;
+    float *amplitude;
+    float *phase;
+    uint32_t *sequence;
+    int8_t *iq;
+    uint8_t *mac;
+    int8_t *rssi;
+    uint8_t *channel;
+    uint8_t *secondary_channel;
+    uint8_t *subcarrier_count;
+    uint8_t *flags;
+} ingest_node_t;
+
+/**
+ * @brief Counters written by one worker
+ */
+typedef struct {
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t frames_json;
+    atomic_uint_fast64_t frames_binary;
+    atomic_uint_fast64_t decode_errors;
+    atomic_uint_fast64_t node_limit;
+    atomic_uint_fast64_t sequence_gaps;
+    atomic_uint_fast64_t sequence_resets;
+    atomic_uint_fast64_t batches;
+    atomic_uint_fast64_t batches_partial;
+    atomic_uint_fast32_t nodes_evicted;
+} worker_stats_t;
+
+typedef struct {
+    struct csi_ingest *ingest;
+    pthread_t thread;
+
+    // Single producer, single consumer byte ring
+    uint8_t *ring;
+    size_t capacity;
+    _Alignas(64) atomic_size_t head;    ///< Consumer position
+    _Alignas(64) atomic_size_t tail;    ///< Producer position
+    atomic_size_t peak;                 ///< Written by the producer only
+    atomic_int sleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+    // Owned by the worker thread
+    ingest_node_t **buckets;
+    uint32_t bucket_mask;
+    worker_stats_t stats;
+} ingest_worker_t;
+
+struct csi_ingest {
+    csi_ingest_config_t config;
+    int workers;
+    ingest_worker_t *worker;
+    atomic_bool stop;
+    atomic_uint nodes;
+
+    // Written by the producer only
+    atomic_uint_fast64_t messages;
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t queue_full;
+    atomic_uint_fast64_t invalid;
+};
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t hash_name(const char *name, size_t len)
+{
+    uint32_t h = 2166136261u;           // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void count(atomic_uint_fast64_t *counter, uint64_t n)
+{
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+// ===== NODES =====
+
+static ingest_node_t *node_create(csi_ingest_t *ingest, const char *name, size_t len, uint32_t hash)
+{
+    unsigned int nodes = atomic_fetch_add(&ingest->nodes, 1);
+    if (nodes >= ingest->config.max_nodes) {
+        atomic_fetch_sub(&ingest->nodes, 1);
+        return NULL;
+    }
+
+    size_t rows = ingest->config.batch_frames;
+    size_t size = sizeof(ingest_node_t) + rows * CSI_INGEST_FRAME_BYTES;
+    ingest_node_t *node = calloc(1, size);
+    if (!node) {
+        atomic_fetch_sub(&ingest->nodes, 1);
+        return NULL;
+    }
+    memcpy(node->name, name, len);
+    node->hash = hash;
+
+    uint8_t *p = (uint8_t *)(node + 1);
+    node->timestamp = (uint64_t *)p;            p += rows * sizeof(uint64_t);
+    node->amplitude = (float *)p;               p += rows * CSI_MAX_SUBCARRIERS * sizeof(float);
+    node->phase = (float *)p;                   p += rows * CSI_MAX_SUBCARRIERS * sizeof(float);
+    node->sequence = (uint32_t *)p;             p += rows * sizeof(uint32_t);
+    node->iq = (int8_t *)p;                     p += rows * CSI_INGEST_IQ_STRIDE;
+    node->mac = p;                              p += rows * 6;
+    node->rssi = (int8_t *)p;                   p += rows;
+    node->channel = p;                          p += rows;
+    node->secondary_channel = p;                p += rows;
+    node->subcarrier_count = p;                 p += rows;
+    node->flags = p;
+    return node;
+}
+
+static ingest_node_t *node_find(ingest_worker_t *w, const char *name, size_t len, uint32_t hash, bool create)
+{
+    ingest_node_t **slot = &w->buckets[(hash >> 8) & w->bucket_mask];
+    for (ingest_node_t *node = *slot; node; node = node->next) {
+        if (node->hash == hash && memcmp(node->name, name, len) == 0 && node->name[len] == '\0') {
+            return node;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    ingest_node_t *node = node_create(w->ingest, name, len, hash);
+    if (node) {
+        node->next = *slot;
+        *slot = node;
+    }
+    return node;
+}
+
+static void node_seal(ingest_worker_t *w, ingest_node_t *node, bool partial)
+{
+    if (node->count == 0) {
+        return;
+    }
+
+    const csi_ingest_config_t *config = &w->ingest->config;
+    if (config->sink) {
+        csi_ingest_batch_t batch = {
+            .node = node->name,
+            .count = node->count,
+            .sequence = node->sequence,
+            .timestamp = node->timestamp,
+            .mac = node->mac,
+            .rssi = node->rssi,
+            .channel = node->channel,
+            .secondary_channel = node->secondary_channel,
+            .subcarrier_count = node->subcarrier_count,
+            .flags = node->flags,
+            .iq = node->iq,
+            .amplitude = node->amplitude,
+            .phase = node->phase,
+        };
+        config->sink(&batch, config->sink_ctx);
+    }
+
+    count(&w->stats.batches, 1);
+    if (partial) {
+        count(&w->stats.batches_partial, 1);
+    }
+    node->count = 0;
+}
+
+/**
+ * @brief Seal batches that waited flush_ms and release nodes idle for node_idle_ms
+ */
+static void worker_scan(ingest_worker_t *w, int64_t now, bool all)
+{
+    const csi_ingest_config_t *config = &w->ingest->config;
+
+    for (uint32_t b = 0; b <= w->bucket_mask; b++) {
+        ingest_node_t **slot = &w->buckets[b];
+        while (*slot) {
+            ingest_node_t *node = *slot;
+            if (node->count && (all || now - node->batch_start_ms >= config->flush_ms)) {
+                node_seal(w, node, true);
+            }
+            if (all || (node->count == 0 && now - node->last_frame_ms >= config->node_idle_ms)) {
+                *slot = node->next;
+                free(node);
+                atomic_fetch_sub(&w->ingest->nodes, 1);
+                if (!all) {
+                    atomic_fetch_add_explicit(&w->stats.nodes_evicted, 1, memory_order_relaxed);
+                }
+                continue;
+            }
+            slot = &node->next;
+        }
+    }
+}
+
+static void worker_ingest(ingest_worker_t *w, const queue_record_t *record, int64_t now)
+{
+    const char *name = (const char *)(record + 1);
+    const uint8_t *payload = (const uint8_t *)name + record->node_len;
+
+    ingest_node_t *node = node_find(w, name, record->node_len, record->hash, true);
+    if (!node) {
+        count(&w->stats.node_limit, 1);
+        return;
+    }
+
+    uint32_t row = node->count;
+    csi_ingest_format_t format = record->format;
+    if (format == CSI_INGEST_FORMAT_AUTO) {
+        format = record->payload_len >= 2 && payload[0] == (CSI_FRAME_MAGIC & 0xFF) &&
+                 payload[1] == (CSI_FRAME_MAGIC >> 8) ? CSI_INGEST_FORMAT_FRAME : CSI_INGEST_FORMAT_JSON;
+    }
+
+    csi_ingest_meta_t meta;
+    int8_t *iq = node->iq + (size_t)row * CSI_INGEST_IQ_STRIDE;
+    float *amplitude = node->amplitude + (size_t)row * CSI_MAX_SUBCARRIERS;
+    float *phase = node->phase + (size_t)row * CSI_MAX_SUBCARRIERS;
+    bool ok;
+    if (format == CSI_INGEST_FORMAT_FRAME) {
+        ok = csi_ingest_decode_frame(payload, record->payload_len, &meta, iq, amplitude, phase);
+        count(ok ? &w->stats.frames_binary : &w->stats.decode_errors, 1);
+    } else {
+        ok = csi_ingest_decode_json((const char *)payload, record->payload_len, &meta, iq, amplitude, phase);
+        count(ok ? &w->stats.frames_json : &w->stats.decode_errors, 1);
+    }
+    node->last_frame_ms = now;
+    if (!ok) {
+        return;
+    }
+
+    if (meta.has_sequence) {
+        if (node->have_sequence && meta.sequence != node->next_sequence) {
+            if (meta.sequence > node->next_sequence) {
+                count(&w->stats.sequence_gaps, meta.sequence - node->next_sequence);
+            } else {
+                count(&w->stats.sequence_resets, 1);
+            }
+        }
+        node->have_sequence = true;
+        node->next_sequence = meta.sequence + 1;
+    }
+
+    node->sequence[row] = meta.sequence;
+    node->timestamp[row] = meta.timestamp;
+    memcpy(node->mac + (size_t)row * 6, meta.mac, 6);
+    node->rssi[row] = meta.rssi;
+    node->channel[row] = meta.channel;
+    node->secondary_channel[row] = meta.secondary_channel;
+    node->subcarrier_count[row] = meta.subcarrier_count;
+    node->flags[row] = meta.flags;
+    count(&w->stats.frames, 1);
+
+    if (row == 0) {
+        node->batch_start_ms = now;
+    }
+    if (++node->count == w->ingest->config.batch_frames) {
+        node_seal(w, node, false);
+    }
+}
+
+/**
+ * @brief Decode everything queued
+ * @return true if anything was there
+ */
+static bool worker_drain(ingest_worker_t *w)
+{
+    size_t head = atomic_load_explicit(&w->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+
+    int64_t now = now_ms();
+    while (head != tail) {
+        size_t pos = head % w->capacity;
+        const queue_record_t *record = (const queue_record_t *)(w->ring + pos);
+        if (record->size == QUEUE_WRAP) {
+            head += w->capacity - pos;
+            continue;
+        }
+        worker_ingest(w, record, now);
+        head += record->size;
+        atomic_store_explicit(&w->head, head, memory_order_release);
+        if (head == tail) {
+            tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+        }
+    }
+    atomic_store_explicit(&w->head, head, memory_order_release);
+    return true;
+}
+
+static void *worker_main(void *arg)
+{
+    ingest_worker_t *w = arg;
+    csi_ingest_t *ingest = w->ingest;
+    int64_t scan_ms = ingest->config.flush_ms / 4;
+    if (scan_ms < MIN_SCAN_MS) {
+        scan_ms = MIN_SCAN_MS;
+    }
+    int64_t next_scan = now_ms() + scan_ms;
+
+    while (true) {
+        bool busy = worker_drain(w);
+
+        int64_t now = now_ms();
+        if (now >= next_scan) {
+            worker_scan(w, now, false);
+            next_scan = now + scan_ms;
+        }
+        if (busy) {
+            continue;
+        }
+        if (atomic_load(&ingest->stop)) {
+            if (!worker_drain(w)) {
+                break;
+            }
+            continue;
+        }
+
+        // Announce the sleep before the last look, so a producer either sees it or we see its data
+        atomic_store(&w->sleeping, 1);
+        pthread_mutex_lock(&w->lock);
+        if (atomic_load(&w->tail) == atomic_load(&w->head) && !atomic_load(&ingest->stop)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            int64_t wait_ms = next_scan - now;
+            deadline.tv_sec += wait_ms / 1000;
+            deadline.tv_nsec += (wait_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&w->wake, &w->lock, &deadline);
+        }
+        pthread_mutex_unlock(&w->lock);
+        atomic_store(&w->sleeping, 0);
+    }
+
+    worker_scan(w, now_ms(), true);
+    return NULL;
+}
+
+// ===== API =====
+
+csi_ingest_result_t csi_ingest_submit(csi_ingest_t *ingest, const char *node, size_t node_len,
+                                      csi_ingest_format_t format, const uint8_t *payload, size_t len)
+{
+    if (node_len == 0 || node_len > CSI_INGEST_MAX_NODE_LEN || len == 0 || len > UINT32_MAX / 2) {
+        count(&ingest->invalid, 1);
+        return CSI_INGEST_INVALID;
+    }
+
+    uint32_t hash = hash_name(node, node_len);
+    ingest_worker_t *w = &ingest->worker[hash % ingest->workers];
+
+    size_t size = (sizeof(queue_record_t) + node_len + len + 1 + QUEUE_ALIGN - 1) & ~(size_t)(QUEUE_ALIGN - 1);
+    size_t tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&w->head, memory_order_acquire);
+    size_t pos = tail % w->capacity;
+    size_t skip = w->capacity - pos < size ? w->capacity - pos : 0;
+    if (size > w->capacity / 2 || w->capacity - (tail - head) < skip + size) {
+        count(&ingest->queue_full, 1);
+        return CSI_INGEST_QUEUE_FULL;
+    }
+
+    if (skip) {
+        ((queue_record_t *)(w->ring + pos))->size = QUEUE_WRAP;
+        tail += skip;
+        pos = 0;
+    }
+    queue_record_t *record = (queue_record_t *)(w->ring + pos);
+    record->size = (uint32_t)size;
+    record->payload_len = (uint32_t)len;
+    record->node_len = (uint8_t)node_len;
+    record->format = (uint8_t)format;
+    record->hash = hash;
+    uint8_t *p = (uint8_t *)(record + 1);
+    memcpy(p, node, node_len);
+    memcpy(p + node_len, payload, len);
+    p[node_len + len] = '\0';
+    tail += size;
+
+    if (tail - head > atomic_load_explicit(&w->peak, memory_order_relaxed)) {
+        atomic_store_explicit(&w->peak, tail - head, memory_order_relaxed);
+    }
+    count(&ingest->messages, 1);
+    count(&ingest->bytes, len);
+
+    atomic_store(&w->tail, tail);
+    if (atomic_load(&w->sleeping)) {
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+    }
+    return CSI_INGEST_QUEUED;
+}
+
+csi_ingest_t *csi_ingest_create(const csi_ingest_config_t *config)
+{
+    const csi_ingest_config_t defaults = CSI_INGEST_CONFIG_DEFAULT();
+    csi_ingest_t *ingest = calloc(1, sizeof(csi_ingest_t));
+    if (!ingest) {
+        return NULL;
+    }
+
+    ingest->config = *config;
+    csi_ingest_config_t *c = &ingest->config;
+    if (c->workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        c->workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (c->workers > CSI_INGEST_MAX_WORKERS) {
+        c->workers = CSI_INGEST_MAX_WORKERS;
+    }
+    c->queue_bytes = c->queue_bytes ? c->queue_bytes : defaults.queue_bytes;
+    if (c->queue_bytes < MIN_QUEUE_BYTES) {
+        c->queue_bytes = MIN_QUEUE_BYTES;
+    }
+    c->queue_bytes &= ~(size_t)(QUEUE_ALIGN - 1);
+    c->batch_frames = c->batch_frames ? c->batch_frames : defaults.batch_frames;
+    c->flush_ms = c->flush_ms ? c->flush_ms : defaults.flush_ms;
+    c->max_nodes = c->max_nodes ? c->max_nodes : defaults.max_nodes;
+    c->node_idle_ms = c->node_idle_ms ? c->node_idle_ms : defaults.node_idle_ms;
+
+    csi_ingest_decode_init();
+
+    ingest->workers = c->workers;
+    ingest->worker = calloc(c->workers, sizeof(ingest_worker_t));
+    if (!ingest->worker) {
+        free(ingest);
+        return NULL;
+    }
+
+    // Routing by hash leaves workers with uneven shares, so each table is sized for twice the average
+    uint32_t buckets = 64;
+    while (buckets < 2 * c->max_nodes / c->workers && buckets < (1u << 20)) {
+        buckets <<= 1;
+    }
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+
+    int started = 0;
+    for (; started < c->workers; started++) {
+        ingest_worker_t *w = &ingest->worker[started];
+        w->ingest = ingest;
+        w->capacity = c->queue_bytes;
+        w->ring = malloc(w->capacity);
+        w->buckets = calloc(buckets, sizeof(ingest_node_t *));
+        w->bucket_mask = buckets - 1;
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_cond_init(&w->wake, &cond_attr);
+        if (!w->ring || !w->buckets || pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            free(w->ring);
+            free(w->buckets);
+            break;
+        }
+    }
+    pthread_condattr_destroy(&cond_attr);
+
+    if (started < c->workers) {
+        ingest->workers = started;
+        csi_ingest_destroy(ingest);
+        return NULL;
+    }
+    return ingest;
+}
+
+void csi_ingest_get_stats(csi_ingest_t *ingest, csi_ingest_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->messages = atomic_load_explicit(&ingest->messages, memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&ingest->bytes, memory_order_relaxed);
+    stats->queue_full = atomic_load_explicit(&ingest->queue_full, memory_order_relaxed);
+    stats->invalid = atomic_load_explicit(&ingest->invalid, memory_order_relaxed);
+    stats->nodes = atomic_load(&ingest->nodes);
+
+    for (int i = 0; i < ingest->workers; i++) {
+        ingest_worker_t *w = &ingest->worker[i];
+        worker_stats_t *s = &w->stats;
+        stats->frames += atomic_load_explicit(&s->frames, memory_order_relaxed);
+        stats->frames_json += atomic_load_explicit(&s->frames_json, memory_order_relaxed);
+        stats->frames_binary += atomic_load_explicit(&s->frames_binary, memory_order_relaxed);
+        stats->decode_errors += atomic_load_explicit(&s->decode_errors, memory_order_relaxed);
+        stats->node_limit += atomic_load_explicit(&s->node_limit, memory_order_relaxed);
+        stats->sequence_gaps += atomic_load_explicit(&s->sequence_gaps, memory_order_relaxed);
+        stats->sequence_resets += atomic_load_explicit(&s->sequence_resets, memory_order_relaxed);
+        stats->batches += atomic_load_explicit(&s->batches, memory_order_relaxed);
+        stats->batches_partial += atomic_load_explicit(&s->batches_partial, memory_order_relaxed);
+        stats->nodes_evicted += atomic_load_explicit(&s->nodes_evicted, memory_order_relaxed);
+
+        size_t queued = atomic_load(&w->tail) - atomic_load(&w->head);
+        stats->queued_bytes += queued;
+        size_t peak = atomic_load_explicit(&w->peak, memory_order_relaxed);
+        if (peak > stats->queued_bytes_peak) {
+            stats->queued_bytes_peak = peak;
+        }
+    }
+}
+
+void csi_ingest_destroy(csi_ingest_t *ingest)
+{
+    if (!ingest) {
+        return;
+    }
+
+    atomic_store(&ingest->stop, true);
+    for (int i = 0; i < ingest->workers; i++) {
+        ingest_worker_t *w = &ingest->worker[i];
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+    }
+    for (int i = 0; i < ingest->workers; i++) {
+        ingest_worker_t *w = &ingest->worker[i];
+        pthread_join(w->thread, NULL);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->wake);
+        free(w->ring);
+        free(w->buckets);
+    }
+    free(ingest->worker);
+    free(ingest);
+}
+
+bool csi_ingest_parse_topic(const char *topic, size_t topic_len, size_t *node_len,
+                            csi_ingest_format_t *format)
+{
+    static const struct {
+        const char *suffix;
+        size_t len;
+        csi_ingest_format_t format;
+    } suffixes[] = {
+        { TOPIC_SUFFIX_JSON, sizeof(TOPIC_SUFFIX_JSON) - 1, CSI_INGEST_FORMAT_JSON },
+        { TOPIC_SUFFIX_FRAME, sizeof(TOPIC_SUFFIX_FRAME) - 1, CSI_INGEST_FORMAT_FRAME },
+    };
+
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t len = suffixes[i].len;
+        if (topic_len > len && memcmp(topic + topic_len - len, suffixes[i].suffix, len) == 0) {
+            *node_len = topic_len - len;
+            *format = suffixes[i].format;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,453 @@
+/**
+ * @file csi_ingest_decode.c
+ * @brief Decoders for the two CSI payload formats
+ */
+
+#include "csi_ingest_decode.h"
+#include "csi_ingest.h"
+#include "csi_features.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "csi_frame_header_t is little-endian on the wire"
+#endif
+
+#define AMPLITUDE_ENTRIES   (2 * 128 * 128 + 1)     // every real^2 + imag^2 of int8 pairs
+#define PHASE_ENTRIES       (256 * 256)
+#define JSON_MAX_DEPTH      16
+
+// Raw CSI is int8, so every amplitude and phase the collector can compute is known up front,
+// with the collector's own kernel
+static float s_amplitude[AMPLITUDE_ENTRIES];
+static float s_phase[PHASE_ENTRIES];
+static pthread_once_t s_tables_once = PTHREAD_ONCE_INIT;
+
+static const double s_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static void build_tables(void)
+{
+    for (int r2 = 0; r2 < AMPLITUDE_ENTRIES; r2++) {
+        s_amplitude[r2] = sqrtf((float)r2);
+    }
+    for (int i = 0; i < PHASE_ENTRIES; i++) {
+        const int8_t iq[2] = {(int8_t)(i >> 8), (int8_t)(i & 0xFF)};
+        csi_features_amplitude_phase(iq, 1, NULL, &s_phase[i]);
+    }
+}
+
+void csi_ingest_decode_init(void)
+{
+    pthread_once(&s_tables_once, build_tables);
+}
+
+bool csi_ingest_decode_frame(const uint8_t *payload, size_t len, csi_ingest_meta_t *meta,
+                             int8_t *iq, float *amplitude, float *phase)
+{
+    csi_frame_header_t header;
+    if (len < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, payload, sizeof(header));
+    if (header.magic != CSI_FRAME_MAGIC || header.version != CSI_FRAME_VERSION ||
+        len - sizeof(header) < header.raw_len) {
+        return false;
+    }
+    const int8_t *raw = (const int8_t *)payload + sizeof(header);
+
+    meta->sequence = header.sequence;
+    meta->has_sequence = true;
+    meta->timestamp = header.timestamp;
+    memcpy(meta->mac, header.mac, sizeof(meta->mac));
+    meta->rssi = header.rssi;
+    meta->channel = header.channel;
+    meta->secondary_channel = header.secondary_channel;
+    meta->flags = header.flags & (CSI_FRAME_FLAG_RAW | CSI_FRAME_FLAG_UTC);
+
+    int count = header.subcarrier_count > CSI_MAX_SUBCARRIERS ? CSI_MAX_SUBCARRIERS : header.subcarrier_count;
+    int copied = 0;
+    if (header.raw_len) {
+        meta->flags |= CSI_FRAME_FLAG_RAW;
+        copied = header.raw_len > CSI_INGEST_IQ_STRIDE ? CSI_INGEST_IQ_STRIDE : header.raw_len;
+        if (count > copied / 2) {
+            count = copied / 2;
+        }
+        memcpy(iq, raw, copied);
+    } else {
+        meta->flags &= ~CSI_FRAME_FLAG_RAW;
+        count = 0;
+    }
+    memset(iq + copied, 0, CSI_INGEST_IQ_STRIDE - copied);
+    meta->subcarrier_count = (uint8_t)count;
+
+    // Same reading of the pairs as the collector: buf[2i] real, buf[2i + 1] imaginary
+    for (int i = 0; i < count; i++) {
+        int real = raw[2 * i];
+        int imag = raw[2 * i + 1];
+        amplitude[i] = s_amplitude[real * real + imag * imag];
+        phase[i] = s_phase[((uint8_t)real << 8) | (uint8_t)imag];
+    }
+    memset(amplitude + count, 0, (CSI_MAX_SUBCARRIERS - count) * sizeof(float));
+    memset(phase + count, 0, (CSI_MAX_SUBCARRIERS - count) * sizeof(float));
+    return true;
+}
+
+/**
+ * @brief Cursor over a JSON document
+ */
+typedef struct {
+    const char *p;
+    const char *end;
+} scan_t;
+
+static void skip_ws(scan_t *s)
+{
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r')) {
+        s->p++;
+    }
+}
+
+static bool take(scan_t *s, char c)
+{
+    skip_ws(s);
+    if (s->p < s->end && *s->p == c) {
+        s->p++;
+        return true;
+    }
+    return false;
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * @brief Parse a number
+ *
+ * Up to 19 significant digits are gathered into an integer and scaled by
+ * an exact power of ten, which is exact for the up to 15 digits cJSON
+ * normally prints and within an ulp for its 17-digit fallback; rounded to
+ * float, the result is the float the node printed. Exponents beyond the
+ * table go through strtod(), which relies on the terminating NUL.
+ */
+static bool read_number(scan_t *s, double *out)
+{
+    skip_ws(s);
+    const char *start = s->p;
+    const char *p = s->p;
+    const char *end = s->end;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+    const char *int_start = p;
+    for (; p < end && is_digit(*p); p++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exp10++;
+        }
+    }
+    if (p == int_start) {
+        return false;
+    }
+    if (p < end && *p == '.') {
+        const char *frac_start = ++p;
+        for (; p < end && is_digit(*p); p++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits += mantissa != 0;
+                exp10--;
+            }
+        }
+        if (p == frac_start) {
+            return false;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int sign = 1;
+        if (p < end && (*p == '+' || *p == '-')) {
+            sign = *p++ == '-' ? -1 : 1;
+        }
+        const char *exp_start = p;
+        int e = 0;
+        for (; p < end && is_digit(*p); p++) {
+            if (e < 10000) {
+                e = e * 10 + (*p - '0');
+            }
+        }
+        if (p == exp_start) {
+            return false;
+        }
+        exp10 += sign * e;
+    }
+    s->p = p;
+
+    double value = (double)mantissa;
+    if (mantissa == 0 || exp10 == 0) {
+        // Exact as it is
+    } else if (exp10 > 0 && exp10 <= 22) {
+        value *= s_pow10[exp10];
+    } else if (exp10 < 0 && exp10 >= -22) {
+        value /= s_pow10[-exp10];
+    } else {
+        *out = strtod(start, NULL);
+        return true;
+    }
+    *out = negative ? -value : value;
+    return true;
+}
+
+static bool skip_string(scan_t *s)
+{
+    if (!take(s, '"')) {
+        return false;
+    }
+    while (s->p < s->end) {
+        char c = *s->p++;
+        if (c == '"') {
+            return true;
+        }
+        if (c == '\\') {
+            if (s->p >= s->end) {
+                return false;
+            }
+            s->p++;
+        }
+    }
+    return false;
+}
+
+static bool skip_literal(scan_t *s, const char *literal)
+{
+    size_t len = strlen(literal);
+    if ((size_t)(s->end - s->p) < len || memcmp(s->p, literal, len) != 0) {
+        return false;
+    }
+    s->p += len;
+    return true;
+}
+
+static bool skip_value(scan_t *s, int depth)
+{
+    skip_ws(s);
+    if (s->p >= s->end || depth > JSON_MAX_DEPTH) {
+        return false;
+    }
+
+    char open = *s->p;
+    if (open == '"') {
+        return skip_string(s);
+    }
+    if (open == '{' || open == '[') {
+        char close = open == '{' ? '}' : ']';
+        s->p++;
+        if (take(s, close)) {
+            return true;
+        }
+        do {
+            if (open == '{' && (!skip_string(s) || !take(s, ':'))) {
+                return false;
+            }
+            if (!skip_value(s, depth + 1)) {
+                return false;
+            }
+        } while (take(s, ','));
+        return take(s, close);
+    }
+    if (open == 't') {
+        return skip_literal(s, "true");
+    }
+    if (open == 'f') {
+        return skip_literal(s, "false");
+    }
+    if (open == 'n') {
+        return skip_literal(s, "null");
+    }
+    double ignored;
+    return read_number(s, &ignored);
+}
+
+/**
+ * @brief Read an array of numbers, keeping the first max of them
+ *
+ * null (cJSON's rendering of NaN) reads as NaN.
+ */
+static bool read_array(scan_t *s, float *out, int max, int *count)
+{
+    *count = 0;
+    if (!take(s, '[')) {
+        return false;
+    }
+    if (take(s, ']')) {
+        return true;
+    }
+    do {
+        double value;
+        skip_ws(s);
+        if (s->p < s->end && *s->p == 'n') {
+            if (!skip_literal(s, "null")) {
+                return false;
+            }
+            value = NAN;
+        } else if (!read_number(s, &value)) {
+            return false;
+        }
+        if (*count < max) {
+            out[*count] = (float)value;
+        }
+        (*count)++;
+    } while (take(s, ','));
+    return take(s, ']');
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool read_mac(scan_t *s, uint8_t mac[6])
+{
+    skip_ws(s);
+    const char *p = s->p;
+    if (!skip_string(s) || s->p - p != 19) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        int hi = hex_value(p[1 + 3 * i]);
+        int lo = hex_value(p[2 + 3 * i]);
+        if (hi < 0 || lo < 0 || (i < 5 && p[3 + 3 * i] != ':')) {
+            return false;
+        }
+        mac[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+static bool read_integer(scan_t *s, double min, double max, double *out)
+{
+    return read_number(s, out) && *out >= min && *out <= max;
+}
+
+static bool key_is(const char *key, size_t len, const char *name)
+{
+    return len == strlen(name) && memcmp(key, name, len) == 0;
+}
+
+bool csi_ingest_decode_json(const char *payload, size_t len, csi_ingest_meta_t *meta,
+                            int8_t *iq, float *amplitude, float *phase)
+{
+    scan_t s = { payload, payload + len };
+    memset(meta, 0, sizeof(*meta));
+    memset(iq, 0, CSI_INGEST_IQ_STRIDE);
+
+    bool have_timestamp = false;
+    int declared = -1;
+    int amplitude_count = 0;
+    int phase_count = 0;
+
+    if (!take(&s, '{')) {
+        return false;
+    }
+    if (!take(&s, '}')) {
+        do {
+            skip_ws(&s);
+            const char *key = s.p + 1;
+            if (!skip_string(&s)) {
+                return false;
+            }
+            size_t key_len = s.p - key - 1;
+            if (!take(&s, ':')) {
+                return false;
+            }
+
+            double value;
+            bool ok;
+            if (key_is(key, key_len, "seq")) {
+                ok = read_integer(&s, 0, UINT32_MAX, &value);
+                meta->sequence = (uint32_t)value;
+                meta->has_sequence = true;
+            } else if (key_is(key, key_len, "timestamp")) {
+                ok = read_integer(&s, 0, 18446744073709549568.0, &value);
+                meta->timestamp = (uint64_t)value;
+                have_timestamp = true;
+            } else if (key_is(key, key_len, "mac")) {
+                ok = read_mac(&s, meta->mac);
+            } else if (key_is(key, key_len, "rssi")) {
+                ok = read_integer(&s, INT8_MIN, INT8_MAX, &value);
+                meta->rssi = (int8_t)value;
+            } else if (key_is(key, key_len, "channel")) {
+                ok = read_integer(&s, 0, UINT8_MAX, &value);
+                meta->channel = (uint8_t)value;
+            } else if (key_is(key, key_len, "secondary_channel")) {
+                ok = read_integer(&s, 0, UINT8_MAX, &value);
+                meta->secondary_channel = (uint8_t)value;
+            } else if (key_is(key, key_len, "subcarrier_count")) {
+                ok = read_integer(&s, 0, UINT8_MAX, &value);
+                declared = (int)value;
+            } else if (key_is(key, key_len, "amplitude")) {
+                ok = read_array(&s, amplitude, CSI_MAX_SUBCARRIERS, &amplitude_count);
+            } else if (key_is(key, key_len, "phase")) {
+                ok = read_array(&s, phase, CSI_MAX_SUBCARRIERS, &phase_count);
+            } else {
+                ok = skip_value(&s, 1);
+            }
+            if (!ok) {
+                return false;
+            }
+        } while (take(&s, ','));
+        if (!take(&s, '}')) {
+            return false;
+        }
+    }
+    skip_ws(&s);
+    if (s.p != s.end || !have_timestamp) {
+        return false;
+    }
+
+    // Arrays the node left out (amplitude or phase disabled) read as zeros
+    int count = amplitude_count > phase_count ? amplitude_count : phase_count;
+    if (declared >= 0 && declared < count) {
+        count = declared;
+    }
+    if (count > CSI_MAX_SUBCARRIERS) {
+        count = CSI_MAX_SUBCARRIERS;
+    }
+    if (amplitude_count > count) {
+        amplitude_count = count;
+    }
+    if (phase_count > count) {
+        phase_count = count;
+    }
+    memset(amplitude + amplitude_count, 0, (CSI_MAX_SUBCARRIERS - amplitude_count) * sizeof(float));
+    memset(phase + phase_count, 0, (CSI_MAX_SUBCARRIERS - phase_count) * sizeof(float));
+
+    meta->subcarrier_count = (uint8_t)count;
+    if (meta->timestamp >= CSI_INGEST_UTC_THRESHOLD_US) {
+        meta->flags |= CSI_FRAME_FLAG_UTC;
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file csi_ingest_decode.h
+ * @brief Decoders for the two CSI payload formats
+ *
+ * Both write one row of the batch columns in place. Per-subcarrier rows
+ * are written in full: entries past the subcarrier count are zeroed, so
+ * a column never carries stale data from an earlier frame.
+ */
+
+#ifndef CSI_INGEST_DECODE_H
+#define CSI_INGEST_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Scalar fields of a decoded frame
+ */
+typedef struct {
+    uint32_t sequence;
+    bool has_sequence;          ///< false for JSON from firmware without sequence numbers
+    uint64_t timestamp;
+    uint8_t mac[6];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t secondary_channel;
+    uint8_t subcarrier_count;
+    uint8_t flags;              ///< CSI_FRAME_FLAG_* bits
+} csi_ingest_meta_t;
+
+/**
+ * @brief Build the amplitude and phase tables; safe to call more than once
+ */
+void csi_ingest_decode_init(void);
+
+/**
+ * @brief Decode a binary frame (csi_frame_header_t and raw CSI)
+ * @param payload Frame
+ * @param len Frame length
+ * @param meta Scalar fields
+ * @param iq Row of CSI_INGEST_IQ_STRIDE bytes
+ * @param amplitude Row of CSI_MAX_SUBCARRIERS floats
+ * @param phase Row of CSI_MAX_SUBCARRIERS floats
+ * @return false if the frame is truncated or of another version
+ */
+bool csi_ingest_decode_frame(const uint8_t *payload, size_t len, csi_ingest_meta_t *meta,
+                             int8_t *iq, float *amplitude, float *phase);
+
+/**
+ * @brief Decode csi_data JSON
+ *
+ * Members may come in any order and unknown members are skipped. The
+ * JSON carries no UTC flag; timestamps past CSI_INGEST_UTC_THRESHOLD_US
+ * are taken to be UTC.
+ *
+ * @param payload JSON, followed by a NUL byte not counted in len
+ * @param len JSON length
+ * @param meta Scalar fields
+ * @param iq Row of CSI_INGEST_IQ_STRIDE bytes, zeroed
+ * @param amplitude Row of CSI_MAX_SUBCARRIERS floats
+ * @param phase Row of CSI_MAX_SUBCARRIERS floats
+ * @return false if the JSON is malformed or has no timestamp
+ */
+bool csi_ingest_decode_json(const char *payload, size_t len, csi_ingest_meta_t *meta,
+                            int8_t *iq, float *amplitude, float *phase);
+
+/**
+ * @brief Smallest timestamp read as UTC: 2001-09-09 in microseconds, or 31 years of uptime
+ */
+#define CSI_INGEST_UTC_THRESHOLD_US     1000000000000000ULL
+
+#endif // CSI_INGEST_DECODE_H
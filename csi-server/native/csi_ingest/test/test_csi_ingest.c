@@ -0,0 +1,485 @@
+/**
+ * @file test_csi_ingest.c
+ * @brief Unit tests for the CSI ingest worker pool and decoders
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "csi_ingest.h"
+#include "csi_ingest_decode.h"
+#include "csi_features.h"
+
+#define TEST_SUBCARRIERS    64
+#define MAX_BATCHES         64
+
+/**
+ * @brief Copies of the batches seen by the test sink
+ */
+static struct {
+    pthread_mutex_t lock;
+    int batches;
+    char node[MAX_BATCHES][CSI_INGEST_MAX_NODE_LEN + 1];
+    uint32_t count[MAX_BATCHES];
+    uint32_t first_sequence[MAX_BATCHES];
+    uint32_t frames;
+    float amplitude[2][CSI_MAX_SUBCARRIERS];   ///< First row of the first two batches
+    float phase[2][CSI_MAX_SUBCARRIERS];
+} s_sink = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void test_sink(const csi_ingest_batch_t *batch, void *ctx)
+{
+    (void)ctx;
+    pthread_mutex_lock(&s_sink.lock);
+    int i = s_sink.batches++;
+    if (i < MAX_BATCHES) {
+        snprintf(s_sink.node[i], sizeof(s_sink.node[i]), "%s", batch->node);
+        s_sink.count[i] = batch->count;
+        s_sink.first_sequence[i] = batch->sequence[0];
+    }
+    if (i < 2) {
+        memcpy(s_sink.amplitude[i], batch->amplitude, sizeof(s_sink.amplitude[i]));
+        memcpy(s_sink.phase[i], batch->phase, sizeof(s_sink.phase[i]));
+    }
+    s_sink.frames += batch->count;
+    pthread_mutex_unlock(&s_sink.lock);
+}
+
+static void reset_sink(void)
+{
+    pthread_mutex_lock(&s_sink.lock);
+    s_sink.batches = 0;
+    s_sink.frames = 0;
+    pthread_mutex_unlock(&s_sink.lock);
+}
+
+void setUp(void)
+{
+    reset_sink();
+}
+
+void tearDown(void)
+{
+}
+
+static void fill_raw(int8_t *raw, int seed)
+{
+    for (int i = 0; i < 2 * TEST_SUBCARRIERS; i++) {
+        raw[i] = (int8_t)(((i * 37 + seed * 11) % 97) - 48);
+    }
+}
+
+static size_t make_frame(uint8_t *out, uint32_t seq, const int8_t *raw, uint16_t raw_len)
+{
+    csi_frame_header_t header = {
+        .magic = CSI_FRAME_MAGIC,
+        .version = CSI_FRAME_VERSION,
+        .flags = raw_len ? CSI_FRAME_FLAG_RAW : 0,
+        .sequence = seq,
+        .timestamp = 123456789,
+        .mac = { 0x24, 0x0A, 0xC4, 0x01, 0x02, 0x03 },
+        .rssi = -61,
+        .channel = 11,
+        .secondary_channel = 1,
+        .subcarrier_count = raw_len / 2,
+        .raw_len = raw_len,
+    };
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), raw, raw_len);
+    return sizeof(header) + raw_len;
+}
+
+/**
+ * @brief Phase of one I/Q pair as the node computes it
+ */
+static float node_phase(int real, int imag)
+{
+    int8_t iq[2] = {(int8_t)real, (int8_t)imag};
+    float phase;
+    csi_features_amplitude_phase(iq, 1, NULL, &phase);
+    return phase;
+}
+
+/**
+ * @brief JSON as the firmware prints it, numbers in cJSON's 17-digit form
+ */
+static size_t make_json(char *out, uint32_t seq, const int8_t *raw)
+{
+    char *p = out;
+    p += sprintf(p, "{\"seq\":%u,\"timestamp\":123456789,\"mac\":\"24:0A:C4:01:02:03\",\"rssi\":-61,"
+                 "\"channel\":11,\"secondary_channel\":1,\"subcarrier_count\":%d,\"amplitude\":[",
+                 seq, TEST_SUBCARRIERS);
+    for (int i = 0; i < TEST_SUBCARRIERS; i++) {
+        p += sprintf(p, "%s%1.17g", i ? "," : "", sqrtf(raw[2 * i] * raw[2 * i] + raw[2 * i + 1] * raw[2 * i + 1]));
+    }
+    p += sprintf(p, "],\"phase\":[");
+    for (int i = 0; i < TEST_SUBCARRIERS; i++) {
+        p += sprintf(p, "%s%1.17g", i ? "," : "", node_phase(raw[2 * i], raw[2 * i + 1]));
+    }
+    p += sprintf(p, "]}");
+    return p - out;
+}
+
+static void wait_for_frames(uint32_t frames, int timeout_ms)
+{
+    for (int waited = 0; waited < timeout_ms; waited += 10) {
+        pthread_mutex_lock(&s_sink.lock);
+        uint32_t seen = s_sink.frames;
+        pthread_mutex_unlock(&s_sink.lock);
+        if (seen >= frames) {
+            return;
+        }
+        struct timespec ts = { 0, 10 * 1000000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void test_csi_ingest_parse_topic(void)
+{
+    size_t node_len;
+    csi_ingest_format_t format;
+
+    TEST_ASSERT_TRUE(csi_ingest_parse_topic("lab/node-1/csi_data", 19, &node_len, &format));
+    TEST_ASSERT_EQUAL(10, node_len);
+    TEST_ASSERT_EQUAL(CSI_INGEST_FORMAT_JSON, format);
+
+    TEST_ASSERT_TRUE(csi_ingest_parse_topic("csi-device/csi_frame", 20, &node_len, &format));
+    TEST_ASSERT_EQUAL(10, node_len);
+    TEST_ASSERT_EQUAL(CSI_INGEST_FORMAT_FRAME, format);
+
+    TEST_ASSERT_FALSE(csi_ingest_parse_topic("csi-device/csi_drops", 20, &node_len, &format));
+    TEST_ASSERT_FALSE(csi_ingest_parse_topic("/csi_data", 9, &node_len, &format));
+    TEST_ASSERT_FALSE(csi_ingest_parse_topic("devices/x/status", 16, &node_len, &format));
+}
+
+static void test_csi_ingest_decode_frame(void)
+{
+    int8_t raw[2 * TEST_SUBCARRIERS];
+    uint8_t frame[256];
+    fill_raw(raw, 1);
+    size_t len = make_frame(frame, 42, raw, sizeof(raw));
+
+    csi_ingest_meta_t meta;
+    int8_t iq[CSI_INGEST_IQ_STRIDE];
+    float amplitude[CSI_MAX_SUBCARRIERS], phase[CSI_MAX_SUBCARRIERS];
+    csi_ingest_decode_init();
+    TEST_ASSERT_TRUE(csi_ingest_decode_frame(frame, len, &meta, iq, amplitude, phase));
+
+    TEST_ASSERT_EQUAL_UINT32(42, meta.sequence);
+    TEST_ASSERT_TRUE(meta.has_sequence);
+    TEST_ASSERT_EQUAL_UINT64(123456789, meta.timestamp);
+    TEST_ASSERT_EQUAL_INT8(-61, meta.rssi);
+    TEST_ASSERT_EQUAL_UINT8(11, meta.channel);
+    TEST_ASSERT_EQUAL_UINT8(TEST_SUBCARRIERS, meta.subcarrier_count);
+    TEST_ASSERT_EQUAL_UINT8(CSI_FRAME_FLAG_RAW, meta.flags);
+    TEST_ASSERT_EQUAL_INT8_ARRAY(raw, iq, sizeof(raw));
+    for (int i = 0; i < TEST_SUBCARRIERS; i++) {
+        int real = raw[2 * i], imag = raw[2 * i + 1];
+        TEST_ASSERT_EQUAL_FLOAT(sqrtf(real * real + imag * imag), amplitude[i]);
+        TEST_ASSERT_TRUE(node_phase(real, imag) == phase[i]);
+    }
+
+    // Truncated, wrong version, raw_len past the end
+    TEST_ASSERT_FALSE(csi_ingest_decode_frame(frame, sizeof(csi_frame_header_t) - 1, &meta, iq, amplitude, phase));
+    TEST_ASSERT_FALSE(csi_ingest_decode_frame(frame, len - 1, &meta, iq, amplitude, phase));
+    frame[2] = CSI_FRAME_VERSION + 1;
+    TEST_ASSERT_FALSE(csi_ingest_decode_frame(frame, len, &meta, iq, amplitude, phase));
+
+    // Header only: no subcarriers, rows zeroed
+    len = make_frame(frame, 43, raw, 0);
+    memset(amplitude, 0xFF, sizeof(amplitude));
+    TEST_ASSERT_TRUE(csi_ingest_decode_frame(frame, len, &meta, iq, amplitude, phase));
+    TEST_ASSERT_EQUAL_UINT8(0, meta.subcarrier_count);
+    TEST_ASSERT_EQUAL_UINT8(0, meta.flags);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, amplitude[0]);
+    TEST_ASSERT_EQUAL_INT8(0, iq[0]);
+}
+
+static void test_csi_ingest_decode_json(void)
+{
+    int8_t raw[2 * TEST_SUBCARRIERS];
+    char json[4096];
+    fill_raw(raw, 2);
+    size_t len = make_json(json, 7, raw);
+
+    csi_ingest_meta_t meta;
+    int8_t iq[CSI_INGEST_IQ_STRIDE];
+    float amplitude[CSI_MAX_SUBCARRIERS], phase[CSI_MAX_SUBCARRIERS];
+    TEST_ASSERT_TRUE(csi_ingest_decode_json(json, len, &meta, iq, amplitude, phase));
+
+    TEST_ASSERT_EQUAL_UINT32(7, meta.sequence);
+    TEST_ASSERT_EQUAL_UINT64(123456789, meta.timestamp);
+    TEST_ASSERT_EQUAL_HEX8(0x24, meta.mac[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x03, meta.mac[5]);
+    TEST_ASSERT_EQUAL_INT8(-61, meta.rssi);
+    TEST_ASSERT_EQUAL_UINT8(1, meta.secondary_channel);
+    TEST_ASSERT_EQUAL_UINT8(TEST_SUBCARRIERS, meta.subcarrier_count);
+    TEST_ASSERT_EQUAL_UINT8(0, meta.flags);
+    for (int i = 0; i < TEST_SUBCARRIERS; i++) {
+        int real = raw[2 * i], imag = raw[2 * i + 1];
+        // Bit-exact: the float the node printed comes back
+        TEST_ASSERT_TRUE(sqrtf(real * real + imag * imag) == amplitude[i]);
+        TEST_ASSERT_TRUE(node_phase(real, imag) == phase[i]);
+    }
+}
+
+static void test_csi_ingest_decode_json_variants(void)
+{
+    csi_ingest_meta_t meta;
+    int8_t iq[CSI_INGEST_IQ_STRIDE];
+    float amplitude[CSI_MAX_SUBCARRIERS], phase[CSI_MAX_SUBCARRIERS];
+
+    // Any member order, whitespace, unknown members, exponents and null
+    const char *reordered =
+        " {\n\t\"phase\": [ -1.5, 2.5e-1 ],\"extra\":{\"a\":[1,{\"b\":\"x\\\"y\"}],\"c\":true},"
+        "\"timestamp\": 1700000000000000, \"amplitude\":[1E+1,null], \"rssi\":-90 } ";
+    TEST_ASSERT_TRUE(csi_ingest_decode_json(reordered, strlen(reordered), &meta, iq, amplitude, phase));
+    TEST_ASSERT_FALSE(meta.has_sequence);
+    TEST_ASSERT_EQUAL_UINT64(1700000000000000ULL, meta.timestamp);
+    TEST_ASSERT_EQUAL_UINT8(CSI_FRAME_FLAG_UTC, meta.flags);
+    TEST_ASSERT_EQUAL_INT8(-90, meta.rssi);
+    TEST_ASSERT_EQUAL_UINT8(2, meta.subcarrier_count);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, amplitude[0]);
+    TEST_ASSERT_TRUE(isnan(amplitude[1]));
+    TEST_ASSERT_EQUAL_FLOAT(-1.5f, phase[0]);
+    TEST_ASSERT_EQUAL_FLOAT(0.25f, phase[1]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, phase[2]);
+
+    // Amplitude only, subcarrier_count smaller than the array
+    const char *short_count = "{\"timestamp\":5,\"subcarrier_count\":1,\"amplitude\":[3,4,5]}";
+    TEST_ASSERT_TRUE(csi_ingest_decode_json(short_count, strlen(short_count), &meta, iq, amplitude, phase));
+    TEST_ASSERT_EQUAL_UINT8(1, meta.subcarrier_count);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, amplitude[0]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, amplitude[1]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, phase[0]);
+
+    const char *bad[] = {
+        "",
+        "{",
+        "{\"seq\":1}",                                      // No timestamp
+        "{\"timestamp\":1,}",
+        "{\"timestamp\":1} x",
+        "{\"timestamp\":-1}",
+        "{\"timestamp\":1,\"rssi\":300}",
+        "{\"timestamp\":1,\"mac\":\"24:0A:C4:01:02\"}",
+        "{\"timestamp\":1,\"amplitude\":[1,]}",
+        "{\"timestamp\":1,\"x\":[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]}",
+        "{\"timestamp\":1.}",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        TEST_ASSERT_FALSE_MESSAGE(csi_ingest_decode_json(bad[i], strlen(bad[i]), &meta, iq, amplitude, phase),
+                                  bad[i]);
+    }
+}
+
+static void test_csi_ingest_batches(void)
+{
+    reset_sink();
+    csi_ingest_config_t config = CSI_INGEST_CONFIG_DEFAULT();
+    config.workers = 3;
+    config.batch_frames = 8;
+    config.flush_ms = 60000;
+    config.sink = test_sink;
+    csi_ingest_t *ingest = csi_ingest_create(&config);
+    TEST_ASSERT_NOT_NULL(ingest);
+
+    int8_t raw[2 * TEST_SUBCARRIERS];
+    uint8_t frame[256];
+    fill_raw(raw, 3);
+
+    // Two nodes: 20 frames each, so two full batches and a partial one per node
+    for (uint32_t seq = 0; seq < 20; seq++) {
+        size_t len = make_frame(frame, seq, raw, sizeof(raw));
+        TEST_ASSERT_EQUAL(CSI_INGEST_QUEUED,
+                          csi_ingest_submit(ingest, "room-a", 6, CSI_INGEST_FORMAT_AUTO, frame, len));
+        TEST_ASSERT_EQUAL(CSI_INGEST_QUEUED,
+                          csi_ingest_submit(ingest, "room-b", 6, CSI_INGEST_FORMAT_FRAME, frame, len));
+    }
+    wait_for_frames(32, 2000);
+
+    csi_ingest_stats_t stats;
+    csi_ingest_get_stats(ingest, &stats);
+    TEST_ASSERT_EQUAL_UINT64(40, stats.messages);
+    TEST_ASSERT_EQUAL_UINT64(40, stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(40, stats.frames_binary);
+    TEST_ASSERT_EQUAL_UINT64(4, stats.batches);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.nodes);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.sequence_gaps);
+
+    // The partial batches are delivered on shutdown
+    csi_ingest_destroy(ingest);
+    TEST_ASSERT_EQUAL(6, s_sink.batches);
+    TEST_ASSERT_EQUAL_UINT32(40, s_sink.frames);
+
+    int a_batches = 0;
+    for (int i = 0; i < s_sink.batches; i++) {
+        if (strcmp(s_sink.node[i], "room-a") == 0) {
+            // Batches of one node arrive in order
+            TEST_ASSERT_EQUAL_UINT32(8 * a_batches, s_sink.first_sequence[i]);
+            TEST_ASSERT_EQUAL_UINT32(a_batches < 2 ? 8 : 4, s_sink.count[i]);
+            a_batches++;
+        }
+    }
+    TEST_ASSERT_EQUAL(3, a_batches);
+}
+
+static void test_csi_ingest_formats_agree(void)
+{
+    reset_sink();
+    csi_ingest_config_t config = CSI_INGEST_CONFIG_DEFAULT();
+    config.workers = 1;
+    config.batch_frames = 1;
+    config.sink = test_sink;
+    csi_ingest_t *ingest = csi_ingest_create(&config);
+    TEST_ASSERT_NOT_NULL(ingest);
+
+    int8_t raw[2 * TEST_SUBCARRIERS];
+    uint8_t frame[256];
+    char json[4096];
+    fill_raw(raw, 4);
+    size_t frame_len = make_frame(frame, 0, raw, sizeof(raw));
+    size_t json_len = make_json(json, 0, raw);
+
+    TEST_ASSERT_EQUAL(CSI_INGEST_QUEUED, csi_ingest_submit(ingest, "n", 1, CSI_INGEST_FORMAT_AUTO, frame, frame_len));
+    wait_for_frames(1, 2000);
+    TEST_ASSERT_EQUAL(CSI_INGEST_QUEUED,
+                      csi_ingest_submit(ingest, "n", 1, CSI_INGEST_FORMAT_AUTO, (uint8_t *)json, json_len));
+    csi_ingest_destroy(ingest);
+
+    TEST_ASSERT_EQUAL(2, s_sink.batches);
+    TEST_ASSERT_EQUAL_MEMORY(s_sink.amplitude[0], s_sink.amplitude[1], sizeof(s_sink.amplitude[0]));
+    TEST_ASSERT_EQUAL_MEMORY(s_sink.phase[0], s_sink.phase[1], sizeof(s_sink.phase[0]));
+}
+
+static void test_csi_ingest_sequence_and_limits(void)
+{
+    reset_sink();
+    csi_ingest_config_t config = CSI_INGEST_CONFIG_DEFAULT();
+    config.workers = 2;
+    config.queue_bytes = 64 * 1024;
+    config.max_nodes = 1;
+    config.sink = test_sink;
+    csi_ingest_t *ingest = csi_ingest_create(&config);
+    TEST_ASSERT_NOT_NULL(ingest);
+
+    int8_t raw[2 * TEST_SUBCARRIERS];
+    uint8_t frame[256];
+    fill_raw(raw, 5);
+
+    // 0, 1, 5 (3 missing), 0 (restart), then a second node over the limit
+    const uint32_t seqs[] = { 0, 1, 5, 0 };
+    for (size_t i = 0; i < 4; i++) {
+        size_t len = make_frame(frame, seqs[i], raw, sizeof(raw));
+        csi_ingest_submit(ingest, "only", 4, CSI_INGEST_FORMAT_FRAME, frame, len);
+    }
+    struct timespec ts = { 0, 100 * 1000000 };
+    nanosleep(&ts, NULL);
+    size_t len = make_frame(frame, 0, raw, sizeof(raw));
+    csi_ingest_submit(ingest, "other", 5, CSI_INGEST_FORMAT_FRAME, frame, len);
+
+    // Rejected without reaching a worker
+    static uint8_t huge[48 * 1024];
+    TEST_ASSERT_EQUAL(CSI_INGEST_QUEUE_FULL, csi_ingest_submit(ingest, "only", 4, CSI_INGEST_FORMAT_FRAME, huge,
+                                                               sizeof(huge)));
+    TEST_ASSERT_EQUAL(CSI_INGEST_INVALID, csi_ingest_submit(ingest, "only", 0, CSI_INGEST_FORMAT_FRAME, frame, len));
+    TEST_ASSERT_EQUAL(CSI_INGEST_INVALID, csi_ingest_submit(ingest, "only", 4, CSI_INGEST_FORMAT_FRAME, frame, 0));
+    // Not a frame: counted as a decode error
+    TEST_ASSERT_EQUAL(CSI_INGEST_QUEUED, csi_ingest_submit(ingest, "only", 4, CSI_INGEST_FORMAT_AUTO,
+                                                           (const uint8_t *)"{]", 2));
+
+    nanosleep(&ts, NULL);
+    csi_ingest_stats_t stats;
+    csi_ingest_get_stats(ingest, &stats);
+    TEST_ASSERT_EQUAL_UINT64(4, stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(3, stats.sequence_gaps);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.sequence_resets);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.node_limit);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.queue_full);
+    TEST_ASSERT_EQUAL_UINT64(2, stats.invalid);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.decode_errors);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.nodes);
+    csi_ingest_destroy(ingest);
+}
+
+static void test_csi_ingest_flush_and_idle(void)
+{
+    reset_sink();
+    csi_ingest_config_t config = CSI_INGEST_CONFIG_DEFAULT();
+    config.workers = 1;
+    config.flush_ms = 50;
+    config.node_idle_ms = 200;
+    config.sink = test_sink;
+    csi_ingest_t *ingest = csi_ingest_create(&config);
+    TEST_ASSERT_NOT_NULL(ingest);
+
+    int8_t raw[2 * TEST_SUBCARRIERS];
+    uint8_t frame[256];
+    fill_raw(raw, 6);
+    for (uint32_t seq = 0; seq < 3; seq++) {
+        size_t len = make_frame(frame, seq, raw, sizeof(raw));
+        csi_ingest_submit(ingest, "slow", 4, CSI_INGEST_FORMAT_FRAME, frame, len);
+    }
+
+    // A partial batch goes out after flush_ms, the node's columns after node_idle_ms
+    wait_for_frames(3, 1000);
+    TEST_ASSERT_EQUAL(1, s_sink.batches);
+    TEST_ASSERT_EQUAL_UINT32(3, s_sink.count[0]);
+
+    struct timespec ts = { 0, 400 * 1000000 };
+    nanosleep(&ts, NULL);
+    csi_ingest_stats_t stats;
+    csi_ingest_get_stats(ingest, &stats);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.batches_partial);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.nodes);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.nodes_evicted);
+    csi_ingest_destroy(ingest);
+}
+
+static void test_csi_ingest_queue_wraps(void)
+{
+    reset_sink();
+    csi_ingest_config_t config = CSI_INGEST_CONFIG_DEFAULT();
+    config.workers = 1;
+    config.queue_bytes = 64 * 1024;
+    config.batch_frames = 16;
+    config.sink = test_sink;
+    csi_ingest_t *ingest = csi_ingest_create(&config);
+    TEST_ASSERT_NOT_NULL(ingest);
+
+    // Odd-sized JSON messages through a small ring, many times around it
+    int8_t raw[2 * TEST_SUBCARRIERS];
+    char json[4096];
+    uint32_t queued = 0;
+    for (uint32_t seq = 0; seq < 2000; seq++) {
+        fill_raw(raw, seq);
+        size_t len = make_json(json, seq, raw);
+        while (csi_ingest_submit(ingest, "ring", 4, CSI_INGEST_FORMAT_JSON, (uint8_t *)json, len) !=
+               CSI_INGEST_QUEUED) {
+            struct timespec ts = { 0, 100000 };
+            nanosleep(&ts, NULL);
+        }
+        queued++;
+    }
+    csi_ingest_destroy(ingest);
+    TEST_ASSERT_EQUAL_UINT32(queued, s_sink.frames);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_csi_ingest_parse_topic);
+    RUN_TEST(test_csi_ingest_decode_frame);
+    RUN_TEST(test_csi_ingest_decode_json);
+    RUN_TEST(test_csi_ingest_decode_json_variants);
+    RUN_TEST(test_csi_ingest_batches);
+    RUN_TEST(test_csi_ingest_formats_agree);
+    RUN_TEST(test_csi_ingest_sequence_and_limits);
+    RUN_TEST(test_csi_ingest_flush_and_idle);
+    RUN_TEST(test_csi_ingest_queue_wraps);
+
+    return UNITY_END();
+}
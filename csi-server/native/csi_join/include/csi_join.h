@@ -0,0 +1,179 @@
+/**
+ * @file csi_join.h
+ * @brief Streaming join of the frames several nodes capture of the same moment
+ *
+ * Every node timestamps its frames with its own clock (uptime, or UTC
+ * with the error of its last NTP sync) and publishes them on its own, so
+ * the frames of one transmission arrive from different nodes at different
+ * times and with timestamps that do not agree. The joiner takes the
+ * nodes' batches (csi_join_sink() is a csi_ingest sink), maps every
+ * timestamp onto the server's clock and emits one set per moment: the
+ * frame each node captured of it, in a tensor of nodes by subcarriers.
+ *
+ * Clock correction: the offset of a node's clock is the smallest
+ * difference between arrival and capture time seen over the last one to
+ * two clock_window_ms, which tracks drift and ignores frames that were
+ * delayed on the way. UTC timestamps are taken as they are. On top of
+ * that every emitted set nudges its nodes towards the set's median time,
+ * which removes the remaining per-node delay difference.
+ *
+ * Joining: each node's frames wait in a reorder buffer of reorder_frames,
+ * sorted by corrected time. The earliest waiting frame of any node
+ * anchors a set, and every other node contributes its earliest frame
+ * within tolerance_us after it, of the same source MAC when match_mac is
+ * set. A set is emitted once every active node has delivered frames past
+ * the window, or max_latency_ms after its moment at the latest, so a
+ * silent node delays the others by a bounded time. A frame older than a
+ * set already emitted is late; it is dropped and counted.
+ */
+
+#ifndef CSI_JOIN_H
+#define CSI_JOIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "csi_ingest.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_JOIN_MAX_NODES      1024
+
+/**
+ * @brief Frames of one moment, one row per node
+ *
+ * Rows are node slots: a node keeps its slot, and so its row, until it has
+ * been idle for node_idle_ms. Rows with valid[i] == 0 are nodes that did
+ * not see the moment; their values are zero. Per-subcarrier arrays have
+ * CSI_MAX_SUBCARRIERS values per row, of which subcarrier_count[i] are
+ * valid. Raw iq is not carried.
+ */
+typedef struct {
+    uint64_t timestamp;             ///< Moment on the server's clock, microseconds
+    const uint8_t *mac;             ///< Source MAC of the anchoring frame
+    uint32_t nodes;                 ///< Rows
+    uint32_t present;               ///< Rows with a frame
+    const char *const *node;        ///< Node name of each row, NULL for a free slot
+    const uint8_t *valid;
+    const int32_t *skew_us;         ///< Corrected capture time minus timestamp
+    const uint64_t *node_timestamp; ///< Capture time on the node's clock
+    const uint32_t *sequence;
+    const int8_t *rssi;
+    const uint8_t *subcarrier_count;
+    const float *amplitude;
+    const float *phase;
+} csi_join_set_t;
+
+/**
+ * @brief Consumer of joined sets
+ *
+ * Called with the joiner locked, from whichever thread made the set ready;
+ * must not call back into the joiner. The set is only valid during the call.
+ */
+typedef void (*csi_join_output_t)(const csi_join_set_t *set, void *ctx);
+
+/**
+ * @brief Joiner configuration
+ */
+typedef struct {
+    uint32_t max_nodes;             ///< Node slots (1-CSI_JOIN_MAX_NODES)
+    uint32_t reorder_frames;        ///< Frames waiting per node; a full buffer forces sets out
+    uint32_t tolerance_us;          ///< Widest gap between the frames of a set
+    uint32_t max_latency_ms;        ///< Longest a set waits for slow nodes
+    uint32_t min_nodes;             ///< Sets seen by fewer nodes are dropped
+    bool match_mac;                 ///< Join only frames of the same source MAC
+    uint32_t clock_window_ms;       ///< Window of the clock offset estimate
+    uint32_t node_idle_ms;          ///< A silent node stops being waited for, then loses its slot
+    csi_join_output_t output;
+    void *output_ctx;
+} csi_join_config_t;
+
+/**
+ * @brief Default configuration: 2 ms windows, which separates 200 Hz captures
+ */
+#define CSI_JOIN_CONFIG_DEFAULT() {     \
+    .max_nodes = 64,                    \
+    .reorder_frames = 256,              \
+    .tolerance_us = 2000,               \
+    .max_latency_ms = 500,              \
+    .min_nodes = 2,                     \
+    .match_mac = true,                  \
+    .clock_window_ms = 10000,           \
+    .node_idle_ms = 5000,               \
+}
+
+/**
+ * @brief Counters
+ */
+typedef struct {
+    uint64_t frames;                ///< Accepted into the reorder buffers
+    uint64_t frames_late;           ///< Older than a set already emitted, dropped
+    uint64_t frames_unjoined;       ///< In sets dropped for min_nodes
+    uint64_t node_limit;            ///< Dropped because every node slot was taken
+    uint64_t sets;                  ///< Emitted
+    uint64_t sets_partial;          ///< Of those, missing an active node
+    uint64_t sets_forced;           ///< Emitted early because a reorder buffer was full
+    uint64_t sets_dropped;          ///< Seen by fewer than min_nodes nodes
+    uint64_t clock_resets;          ///< Node restarted or changed clock
+    uint64_t latency_us_sum;        ///< Emission minus moment, summed over sets
+    uint64_t latency_us_max;
+    uint32_t nodes;                 ///< Nodes with a slot now
+    uint32_t waiting;               ///< Frames in the reorder buffers now
+} csi_join_stats_t;
+
+typedef struct csi_join csi_join_t;
+
+/**
+ * @brief Create a joiner
+ * @param config Configuration; zero fields take the defaults
+ * @return Handle, or NULL if out of memory
+ */
+csi_join_t *csi_join_create(const csi_join_config_t *config);
+
+/**
+ * @brief Add a batch of one node's frames
+ *
+ * Emits every set the batch makes ready. Thread safe.
+ *
+ * @param join Handle
+ * @param batch Frames in capture order
+ * @param now_us Arrival of the batch on the server's clock (csi_join_clock_us())
+ */
+void csi_join_push(csi_join_t *join, const csi_ingest_batch_t *batch, uint64_t now_us);
+
+/**
+ * @brief csi_ingest sink: csi_join_push() at the current time
+ * @param ctx The joiner
+ */
+void csi_join_sink(const csi_ingest_batch_t *batch, void *ctx);
+
+/**
+ * @brief Emit the sets that have waited max_latency_ms
+ *
+ * Call periodically so that sets go out when no node is delivering.
+ */
+void csi_join_poll(csi_join_t *join, uint64_t now_us);
+
+/**
+ * @brief Emit every waiting frame, joined as far as it can be
+ */
+void csi_join_flush(csi_join_t *join);
+
+void csi_join_get_stats(csi_join_t *join, csi_join_stats_t *stats);
+
+/**
+ * @brief Flush and free
+ */
+void csi_join_destroy(csi_join_t *join);
+
+/**
+ * @brief The server's clock: UTC in microseconds
+ */
+uint64_t csi_join_clock_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_JOIN_H
@@ -0,0 +1,607 @@
+/**
+ * @file csi_join.c
+ * @brief Streaming multi-node frame joiner
+ */
+
+#include "csi_join.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RESTART_BACKSTEP_US     1000000     ///< A node clock going back this far restarted
+#define ADJUST_GAIN_SHIFT       3           ///< Each set moves a node 1/8 of the way to the median
+
+/**
+ * @brief A frame waiting in a reorder buffer
+ */
+typedef struct {
+    uint64_t ts;                        ///< Corrected capture time
+    uint64_t node_ts;
+    uint32_t sequence;
+    uint8_t mac[6];
+    int8_t rssi;
+    uint8_t subcarrier_count;
+    float amplitude[CSI_MAX_SUBCARRIERS];
+    float phase[CSI_MAX_SUBCARRIERS];
+} join_frame_t;
+
+/**
+ * @brief A node slot: its reorder buffer and clock estimate
+ *
+ * order[] is a ring of indices into frames[], sorted by corrected time;
+ * free_idx[] is a stack of the unused frames[] entries.
+ */
+typedef struct {
+    bool used;
+    char name[CSI_INGEST_MAX_NODE_LEN + 1];
+    join_frame_t *frames;
+    uint32_t *order;
+    uint32_t *free_idx;
+    uint32_t head;
+    uint32_t count;
+    uint32_t free_count;
+
+    bool have_clock;
+    bool utc;
+    uint64_t last_node_ts;
+    int64_t min_cur;                    ///< Smallest arrival minus capture time in this window
+    int64_t min_prev;                   ///< and in the previous one
+    uint64_t window_start;
+    int64_t adjust;                     ///< Correction learned from the sets
+    uint64_t newest;                    ///< Latest corrected time delivered
+    uint64_t last_arrival;
+} join_node_t;
+
+struct csi_join {
+    csi_join_config_t config;
+    pthread_mutex_t lock;
+    join_node_t *nodes;
+    uint32_t rows;                      ///< Highest slot in use + 1
+    bool emitted;
+    uint64_t last_anchor;               ///< Moment of the latest set
+    uint64_t last_now;
+    csi_join_stats_t stats;
+
+    // Output tensor, one row per slot
+    const char **out_node;
+    uint8_t *out_valid;
+    int32_t *out_skew;
+    uint64_t *out_node_ts;
+    uint32_t *out_sequence;
+    int8_t *out_rssi;
+    uint8_t *out_subcarriers;
+    float *out_amplitude;
+    float *out_phase;
+    int32_t *median_scratch;
+};
+
+uint64_t csi_join_clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// ===== REORDER BUFFERS =====
+
+static join_frame_t *frame_at(const join_node_t *n, uint32_t i, uint32_t cap)
+{
+    return &n->frames[n->order[(n->head + i) % cap]];
+}
+
+/**
+ * @brief Take a free entry and insert it in time order; the caller fills it first
+ */
+static join_frame_t *buffer_reserve(join_node_t *n)
+{
+    return &n->frames[n->free_idx[n->free_count - 1]];
+}
+
+static void buffer_insert(join_node_t *n, uint32_t cap)
+{
+    uint32_t idx = n->free_idx[--n->free_count];
+    uint64_t ts = n->frames[idx].ts;
+    // Frames arrive nearly in order, so the walk back is short
+    uint32_t pos = n->count;
+    while (pos > 0 && frame_at(n, pos - 1, cap)->ts > ts) {
+        n->order[(n->head + pos) % cap] = n->order[(n->head + pos - 1) % cap];
+        pos--;
+    }
+    n->order[(n->head + pos) % cap] = idx;
+    n->count++;
+}
+
+static void buffer_remove(join_node_t *n, uint32_t i, uint32_t cap)
+{
+    n->free_idx[n->free_count++] = n->order[(n->head + i) % cap];
+    if (i == 0) {
+        n->head = (n->head + 1) % cap;
+    } else {
+        for (uint32_t k = i; k + 1 < n->count; k++) {
+            n->order[(n->head + k) % cap] = n->order[(n->head + k + 1) % cap];
+        }
+    }
+    n->count--;
+}
+
+// ===== NODES =====
+
+static bool node_active(const csi_join_t *j, const join_node_t *n, uint64_t now)
+{
+    return n->last_arrival + (uint64_t)j->config.node_idle_ms * 1000 >= now;
+}
+
+static void release_idle(csi_join_t *j, uint64_t now)
+{
+    for (uint32_t s = 0; s < j->rows; s++) {
+        join_node_t *n = &j->nodes[s];
+        if (n->used && n->count == 0 && !node_active(j, n, now)) {
+            n->used = false;
+            j->out_node[s] = NULL;
+            j->stats.nodes--;
+        }
+    }
+    while (j->rows > 0 && !j->nodes[j->rows - 1].used) {
+        j->rows--;
+    }
+}
+
+static join_node_t *find_node(csi_join_t *j, const char *name, uint64_t now)
+{
+    join_node_t *free_slot = NULL;
+    for (uint32_t s = 0; s < j->rows; s++) {
+        join_node_t *n = &j->nodes[s];
+        if (n->used && strcmp(n->name, name) == 0) {
+            return n;
+        }
+        if (!n->used && !free_slot) {
+            free_slot = n;
+        }
+    }
+    if (!free_slot) {
+        if (j->rows == j->config.max_nodes) {
+            release_idle(j, now);
+        }
+        if (j->rows == j->config.max_nodes) {
+            return NULL;
+        }
+        free_slot = &j->nodes[j->rows];
+    }
+
+    join_node_t *n = free_slot;
+    uint32_t cap = j->config.reorder_frames;
+    if (!n->frames) {
+        n->frames = malloc(cap * sizeof(*n->frames));
+        n->order = malloc(cap * sizeof(*n->order));
+        n->free_idx = malloc(cap * sizeof(*n->free_idx));
+        if (!n->frames || !n->order || !n->free_idx) {
+            free(n->frames);
+            free(n->order);
+            free(n->free_idx);
+            n->frames = NULL;
+            n->order = NULL;
+            n->free_idx = NULL;
+            return NULL;
+        }
+    }
+    n->used = true;
+    snprintf(n->name, sizeof(n->name), "%s", name);
+    n->head = 0;
+    n->count = 0;
+    n->free_count = cap;
+    for (uint32_t i = 0; i < cap; i++) {
+        n->free_idx[i] = cap - 1 - i;
+    }
+    n->have_clock = false;
+    n->newest = 0;
+    n->last_arrival = now;
+    uint32_t slot = (uint32_t)(n - j->nodes);
+    if (slot >= j->rows) {
+        j->rows = slot + 1;
+    }
+    j->out_node[slot] = n->name;
+    j->stats.nodes++;
+    return n;
+}
+
+/**
+ * @brief Fold a batch's last frame into the node's clock estimate
+ */
+static void update_clock(csi_join_t *j, join_node_t *n, const csi_ingest_batch_t *b, uint64_t now)
+{
+    uint64_t first = b->timestamp[0];
+    uint64_t last = b->timestamp[b->count - 1];
+    bool utc = b->flags[b->count - 1] & CSI_FRAME_FLAG_UTC;
+    int64_t sample = (int64_t)(now - last);
+
+    if (!n->have_clock || utc != n->utc || first + RESTART_BACKSTEP_US < n->last_node_ts) {
+        if (n->have_clock) {
+            j->stats.clock_resets++;
+        }
+        n->have_clock = true;
+        n->utc = utc;
+        n->min_cur = sample;
+        n->min_prev = sample;
+        n->window_start = now;
+        n->adjust = 0;
+    } else if (now - n->window_start >= (uint64_t)j->config.clock_window_ms * 1000) {
+        n->min_prev = n->min_cur;
+        n->min_cur = sample;
+        n->window_start = now;
+    } else if (sample < n->min_cur) {
+        n->min_cur = sample;
+    }
+    n->last_node_ts = last;
+}
+
+static uint64_t corrected(const join_node_t *n, uint64_t node_ts)
+{
+    int64_t offset = n->utc ? 0 : (n->min_cur < n->min_prev ? n->min_cur : n->min_prev);
+    int64_t ts = (int64_t)node_ts + offset + n->adjust;
+    return ts > 0 ? (uint64_t)ts : 0;
+}
+
+// ===== SETS =====
+
+static bool mac_matches(const uint8_t *a, const uint8_t *b)
+{
+    static const uint8_t zero[6];
+    return memcmp(a, zero, 6) == 0 || memcmp(b, zero, 6) == 0 || memcmp(a, b, 6) == 0;
+}
+
+/**
+ * @brief Node with the earliest waiting frame, or NULL if none waits
+ */
+static join_node_t *earliest(csi_join_t *j)
+{
+    join_node_t *best = NULL;
+    uint64_t best_ts = 0;
+    uint32_t cap = j->config.reorder_frames;
+    for (uint32_t s = 0; s < j->rows; s++) {
+        join_node_t *n = &j->nodes[s];
+        if (n->used && n->count > 0 && (!best || frame_at(n, 0, cap)->ts < best_ts)) {
+            best = n;
+            best_ts = frame_at(n, 0, cap)->ts;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Move a waiting frame into its node's row of the output
+ */
+static void take(csi_join_t *j, join_node_t *n, uint32_t i, uint64_t moment)
+{
+    uint32_t cap = j->config.reorder_frames;
+    uint32_t row = (uint32_t)(n - j->nodes);
+    const join_frame_t *f = frame_at(n, i, cap);
+    j->out_valid[row] = 1;
+    j->out_skew[row] = (int32_t)(f->ts - moment);
+    j->out_node_ts[row] = f->node_ts;
+    j->out_sequence[row] = f->sequence;
+    j->out_rssi[row] = f->rssi;
+    j->out_subcarriers[row] = f->subcarrier_count;
+    memcpy(j->out_amplitude + (size_t)row * CSI_MAX_SUBCARRIERS, f->amplitude, sizeof(f->amplitude));
+    memcpy(j->out_phase + (size_t)row * CSI_MAX_SUBCARRIERS, f->phase, sizeof(f->phase));
+    buffer_remove(n, i, cap);
+}
+
+static void clear_row(csi_join_t *j, uint32_t row)
+{
+    j->out_valid[row] = 0;
+    j->out_skew[row] = 0;
+    j->out_node_ts[row] = 0;
+    j->out_sequence[row] = 0;
+    j->out_rssi[row] = 0;
+    j->out_subcarriers[row] = 0;
+    memset(j->out_amplitude + (size_t)row * CSI_MAX_SUBCARRIERS, 0, CSI_MAX_SUBCARRIERS * sizeof(float));
+    memset(j->out_phase + (size_t)row * CSI_MAX_SUBCARRIERS, 0, CSI_MAX_SUBCARRIERS * sizeof(float));
+}
+
+/**
+ * @brief Pull the nodes of a set towards its median time
+ */
+static void refine_clocks(csi_join_t *j, uint32_t present)
+{
+    int32_t *skew = j->median_scratch;
+    uint32_t k = 0;
+    for (uint32_t row = 0; row < j->rows; row++) {
+        if (j->out_valid[row]) {
+            // Insertion sort: sets are small
+            uint32_t pos = k++;
+            while (pos > 0 && skew[pos - 1] > j->out_skew[row]) {
+                skew[pos] = skew[pos - 1];
+                pos--;
+            }
+            skew[pos] = j->out_skew[row];
+        }
+    }
+    int32_t median = skew[present / 2];
+    int64_t limit = (int64_t)j->config.max_latency_ms * 1000;
+    for (uint32_t row = 0; row < j->rows; row++) {
+        if (j->out_valid[row]) {
+            join_node_t *n = &j->nodes[row];
+            n->adjust -= (j->out_skew[row] - median) / (1 << ADJUST_GAIN_SHIFT);
+            n->adjust = n->adjust > limit ? limit : n->adjust < -limit ? -limit : n->adjust;
+        }
+    }
+}
+
+/**
+ * @brief Form the set anchored by the earliest waiting frame and emit it
+ */
+static void emit(csi_join_t *j, join_node_t *anchor, uint64_t now)
+{
+    uint32_t cap = j->config.reorder_frames;
+    const join_frame_t *first = frame_at(anchor, 0, cap);
+    uint64_t moment = first->ts;
+    uint64_t window_end = moment + j->config.tolerance_us;
+    uint8_t mac[6];
+    memcpy(mac, first->mac, sizeof(mac));
+
+    uint32_t present = 0, active = 0;
+    for (uint32_t row = 0; row < j->rows; row++) {
+        join_node_t *n = &j->nodes[row];
+        clear_row(j, row);
+        if (!n->used) {
+            continue;
+        }
+        if (node_active(j, n, now) || n->count > 0) {
+            active++;
+        }
+        for (uint32_t i = 0; i < n->count; i++) {
+            const join_frame_t *f = frame_at(n, i, cap);
+            if (f->ts > window_end) {
+                break;
+            }
+            if (!j->config.match_mac || mac_matches(f->mac, mac)) {
+                take(j, n, i, moment);
+                present++;
+                break;
+            }
+        }
+    }
+    if (!j->emitted || moment > j->last_anchor) {
+        j->last_anchor = moment;
+    }
+    j->emitted = true;
+
+    if (present < j->config.min_nodes) {
+        j->stats.sets_dropped++;
+        j->stats.frames_unjoined += present;
+        return;
+    }
+    j->stats.sets++;
+    if (present < active) {
+        j->stats.sets_partial++;
+    }
+    uint64_t latency = now > moment ? now - moment : 0;
+    j->stats.latency_us_sum += latency;
+    if (latency > j->stats.latency_us_max) {
+        j->stats.latency_us_max = latency;
+    }
+    if (present >= 3) {
+        refine_clocks(j, present);
+    }
+
+    if (j->config.output) {
+        csi_join_set_t set = {
+            .timestamp = moment,
+            .mac = mac,
+            .nodes = j->rows,
+            .present = present,
+            .node = (const char *const *)j->out_node,
+            .valid = j->out_valid,
+            .skew_us = j->out_skew,
+            .node_timestamp = j->out_node_ts,
+            .sequence = j->out_sequence,
+            .rssi = j->out_rssi,
+            .subcarrier_count = j->out_subcarriers,
+            .amplitude = j->out_amplitude,
+            .phase = j->out_phase,
+        };
+        j->config.output(&set, j->config.output_ctx);
+    }
+}
+
+/**
+ * @brief Whether every active node, and at least min_nodes, delivered frames past the window
+ */
+static bool window_complete(const csi_join_t *j, uint64_t window_end, uint64_t now)
+{
+    uint32_t active = 0;
+    for (uint32_t s = 0; s < j->rows; s++) {
+        const join_node_t *n = &j->nodes[s];
+        if (n->used && node_active(j, n, now)) {
+            if (n->newest <= window_end) {
+                return false;
+            }
+            active++;
+        }
+    }
+    return active >= j->config.min_nodes;
+}
+
+static void drain(csi_join_t *j, uint64_t now)
+{
+    uint32_t cap = j->config.reorder_frames;
+    uint64_t max_latency = (uint64_t)j->config.max_latency_ms * 1000;
+    join_node_t *anchor;
+    while ((anchor = earliest(j)) != NULL) {
+        uint64_t moment = frame_at(anchor, 0, cap)->ts;
+        if (now < moment + max_latency && !window_complete(j, moment + j->config.tolerance_us, now)) {
+            break;
+        }
+        emit(j, anchor, now);
+    }
+}
+
+// ===== API =====
+
+csi_join_t *csi_join_create(const csi_join_config_t *config)
+{
+    csi_join_config_t defaults = CSI_JOIN_CONFIG_DEFAULT();
+    csi_join_config_t c = *config;
+    if (c.max_nodes == 0 || c.max_nodes > CSI_JOIN_MAX_NODES) {
+        c.max_nodes = defaults.max_nodes;
+    }
+    if (c.reorder_frames == 0) {
+        c.reorder_frames = defaults.reorder_frames;
+    }
+    if (c.tolerance_us == 0) {
+        c.tolerance_us = defaults.tolerance_us;
+    }
+    if (c.max_latency_ms == 0) {
+        c.max_latency_ms = defaults.max_latency_ms;
+    }
+    if (c.min_nodes == 0) {
+        c.min_nodes = 1;
+    }
+    if (c.clock_window_ms == 0) {
+        c.clock_window_ms = defaults.clock_window_ms;
+    }
+    if (c.node_idle_ms == 0) {
+        c.node_idle_ms = defaults.node_idle_ms;
+    }
+
+    csi_join_t *j = calloc(1, sizeof(*j));
+    if (!j) {
+        return NULL;
+    }
+    j->config = c;
+    size_t rows = c.max_nodes;
+    j->nodes = calloc(rows, sizeof(*j->nodes));
+    j->out_node = calloc(rows, sizeof(*j->out_node));
+    j->out_valid = calloc(rows, sizeof(*j->out_valid));
+    j->out_skew = calloc(rows, sizeof(*j->out_skew));
+    j->out_node_ts = calloc(rows, sizeof(*j->out_node_ts));
+    j->out_sequence = calloc(rows, sizeof(*j->out_sequence));
+    j->out_rssi = calloc(rows, sizeof(*j->out_rssi));
+    j->out_subcarriers = calloc(rows, sizeof(*j->out_subcarriers));
+    j->out_amplitude = calloc(rows * CSI_MAX_SUBCARRIERS, sizeof(float));
+    j->out_phase = calloc(rows * CSI_MAX_SUBCARRIERS, sizeof(float));
+    j->median_scratch = calloc(rows, sizeof(*j->median_scratch));
+    if (!j->nodes || !j->out_node || !j->out_valid || !j->out_skew || !j->out_node_ts || !j->out_sequence ||
+        !j->out_rssi || !j->out_subcarriers || !j->out_amplitude || !j->out_phase || !j->median_scratch ||
+        pthread_mutex_init(&j->lock, NULL) != 0) {
+        free(j->nodes);
+        j->nodes = NULL;
+        j->config.max_nodes = 0;
+        csi_join_destroy(j);
+        return NULL;
+    }
+    return j;
+}
+
+void csi_join_push(csi_join_t *join, const csi_ingest_batch_t *batch, uint64_t now_us)
+{
+    if (batch->count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&join->lock);
+    join->last_now = now_us;
+    join_node_t *n = find_node(join, batch->node, now_us);
+    if (!n) {
+        join->stats.node_limit += batch->count;
+        pthread_mutex_unlock(&join->lock);
+        return;
+    }
+    n->last_arrival = now_us;
+    update_clock(join, n, batch, now_us);
+
+    for (uint32_t i = 0; i < batch->count; i++) {
+        uint64_t ts = corrected(n, batch->timestamp[i]);
+        if (join->emitted && ts < join->last_anchor) {
+            join->stats.frames_late++;
+            continue;
+        }
+        while (n->count == join->config.reorder_frames) {
+            join->stats.sets_forced++;
+            emit(join, earliest(join), now_us);
+        }
+        join_frame_t *f = buffer_reserve(n);
+        f->ts = ts;
+        f->node_ts = batch->timestamp[i];
+        f->sequence = batch->sequence[i];
+        memcpy(f->mac, batch->mac + 6 * i, 6);
+        f->rssi = batch->rssi[i];
+        f->subcarrier_count = batch->subcarrier_count[i];
+        memcpy(f->amplitude, batch->amplitude + (size_t)i * CSI_MAX_SUBCARRIERS, sizeof(f->amplitude));
+        memcpy(f->phase, batch->phase + (size_t)i * CSI_MAX_SUBCARRIERS, sizeof(f->phase));
+        buffer_insert(n, join->config.reorder_frames);
+        if (ts > n->newest) {
+            n->newest = ts;
+        }
+        join->stats.frames++;
+    }
+    drain(join, now_us);
+    pthread_mutex_unlock(&join->lock);
+}
+
+void csi_join_sink(const csi_ingest_batch_t *batch, void *ctx)
+{
+    csi_join_push(ctx, batch, csi_join_clock_us());
+}
+
+void csi_join_poll(csi_join_t *join, uint64_t now_us)
+{
+    pthread_mutex_lock(&join->lock);
+    if (now_us > join->last_now) {
+        join->last_now = now_us;
+    }
+    drain(join, now_us);
+    release_idle(join, now_us);
+    pthread_mutex_unlock(&join->lock);
+}
+
+void csi_join_flush(csi_join_t *join)
+{
+    pthread_mutex_lock(&join->lock);
+    join_node_t *anchor;
+    while ((anchor = earliest(join)) != NULL) {
+        emit(join, anchor, join->last_now);
+    }
+    pthread_mutex_unlock(&join->lock);
+}
+
+void csi_join_get_stats(csi_join_t *join, csi_join_stats_t *stats)
+{
+    pthread_mutex_lock(&join->lock);
+    *stats = join->stats;
+    stats->waiting = 0;
+    for (uint32_t s = 0; s < join->rows; s++) {
+        stats->waiting += join->nodes[s].used ? join->nodes[s].count : 0;
+    }
+    pthread_mutex_unlock(&join->lock);
+}
+
+void csi_join_destroy(csi_join_t *join)
+{
+    if (!join) {
+        return;
+    }
+    if (join->nodes) {
+        csi_join_flush(join);
+        pthread_mutex_destroy(&join->lock);
+        for (uint32_t s = 0; s < join->config.max_nodes; s++) {
+            free(join->nodes[s].frames);
+            free(join->nodes[s].order);
+            free(join->nodes[s].free_idx);
+        }
+    }
+    free(join->nodes);
+    free(join->out_node);
+    free(join->out_valid);
+    free(join->out_skew);
+    free(join->out_node_ts);
+    free(join->out_sequence);
+    free(join->out_rssi);
+    free(join->out_subcarriers);
+    free(join->out_amplitude);
+    free(join->out_phase);
+    free(join->median_scratch);
+    free(join);
+}
@@ -0,0 +1,381 @@
+/**
+ * @file test_csi_join.c
+ * @brief Unit tests for the multi-node frame joiner
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csi_join.h"
+
+#define MAX_ROWS    64
+#define MAX_SETS    256
+#define MAX_NODES   8
+
+/**
+ * @brief Columns of the batches pushed into the joiner
+ */
+static struct {
+    uint32_t sequence[MAX_ROWS];
+    uint64_t timestamp[MAX_ROWS];
+    uint8_t mac[MAX_ROWS * 6];
+    int8_t rssi[MAX_ROWS];
+    uint8_t channel[MAX_ROWS];
+    uint8_t secondary_channel[MAX_ROWS];
+    uint8_t subcarrier_count[MAX_ROWS];
+    uint8_t flags[MAX_ROWS];
+    int8_t iq[MAX_ROWS * CSI_INGEST_IQ_STRIDE];
+    float amplitude[MAX_ROWS * CSI_MAX_SUBCARRIERS];
+    float phase[MAX_ROWS * CSI_MAX_SUBCARRIERS];
+} s_rows;
+
+/**
+ * @brief What the output saw of each set
+ */
+static struct {
+    uint64_t timestamp;
+    uint32_t nodes;
+    uint32_t present;
+    uint8_t valid[MAX_NODES];
+    uint32_t sequence[MAX_NODES];
+    int32_t skew_us[MAX_NODES];
+    uint8_t mac_last;
+    float amplitude0[MAX_NODES];
+} s_sets[MAX_SETS];
+static int s_set_count;
+
+static void record_set(const csi_join_set_t *set, void *ctx)
+{
+    (void)ctx;
+    TEST_ASSERT_TRUE(s_set_count < MAX_SETS);
+    TEST_ASSERT_TRUE(set->nodes <= MAX_NODES);
+    s_sets[s_set_count].timestamp = set->timestamp;
+    s_sets[s_set_count].nodes = set->nodes;
+    s_sets[s_set_count].present = set->present;
+    s_sets[s_set_count].mac_last = set->mac[5];
+    for (uint32_t i = 0; i < set->nodes; i++) {
+        s_sets[s_set_count].valid[i] = set->valid[i];
+        s_sets[s_set_count].sequence[i] = set->sequence[i];
+        s_sets[s_set_count].skew_us[i] = set->skew_us[i];
+        s_sets[s_set_count].amplitude0[i] = set->amplitude[i * CSI_MAX_SUBCARRIERS];
+    }
+    s_set_count++;
+}
+
+void setUp(void)
+{
+    s_set_count = 0;
+    memset(s_sets, 0, sizeof(s_sets));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Batch of count frames; frame i has sequence seq[i], timestamp ts[i] and source MAC ..:mac[i]
+ */
+static csi_ingest_batch_t make_batch(const char *node, uint32_t count, const uint32_t *seq, const uint64_t *ts,
+                                     const uint8_t *mac, uint8_t flags)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        s_rows.sequence[i] = seq[i];
+        s_rows.timestamp[i] = ts[i];
+        memcpy(s_rows.mac + 6 * i, (const uint8_t[]){ 0x24, 0x0A, 0xC4, 0, 0, mac ? mac[i] : 1 }, 6);
+        s_rows.rssi[i] = -50;
+        s_rows.channel[i] = 6;
+        s_rows.secondary_channel[i] = 0;
+        s_rows.subcarrier_count[i] = CSI_MAX_SUBCARRIERS;
+        s_rows.flags[i] = flags;
+        for (int k = 0; k < CSI_MAX_SUBCARRIERS; k++) {
+            s_rows.amplitude[i * CSI_MAX_SUBCARRIERS + k] = (float)(seq[i] + k);
+            s_rows.phase[i * CSI_MAX_SUBCARRIERS + k] = 0.01f * k;
+        }
+    }
+    csi_ingest_batch_t batch = {
+        .node = node,
+        .count = count,
+        .sequence = s_rows.sequence,
+        .timestamp = s_rows.timestamp,
+        .mac = s_rows.mac,
+        .rssi = s_rows.rssi,
+        .channel = s_rows.channel,
+        .secondary_channel = s_rows.secondary_channel,
+        .subcarrier_count = s_rows.subcarrier_count,
+        .flags = s_rows.flags,
+        .iq = s_rows.iq,
+        .amplitude = s_rows.amplitude,
+        .phase = s_rows.phase,
+    };
+    return batch;
+}
+
+/**
+ * @brief Push moments [first, first + count) of a 200 Hz transmitter as one node sees them
+ * @param boot_us Node clock reads capture time minus this
+ * @param delay_us Arrival minus capture time of the batch's last frame
+ */
+static void push_moments(csi_join_t *join, const char *node, uint32_t first, uint32_t count, uint64_t boot_us,
+                         uint64_t delay_us, uint8_t flags)
+{
+    uint32_t seq[MAX_ROWS];
+    uint64_t ts[MAX_ROWS];
+    for (uint32_t i = 0; i < count; i++) {
+        seq[i] = first + i;
+        ts[i] = 10000000 + (uint64_t)(first + i) * 5000 - boot_us;
+    }
+    csi_ingest_batch_t batch = make_batch(node, count, seq, ts, NULL, flags);
+    csi_join_push(join, &batch, ts[count - 1] + boot_us + delay_us);
+}
+
+static csi_join_config_t test_config(void)
+{
+    csi_join_config_t config = CSI_JOIN_CONFIG_DEFAULT();
+    config.output = record_set;
+    return config;
+}
+
+void test_csi_join_aligns_offset_clocks(void)
+{
+    // Nodes booted seconds apart, with links 1.5 ms apart in delay
+    static const char *const nodes[] = { "room/a", "room/b", "room/c" };
+    static const uint64_t boot[] = { 1000000, 3000000, 5000000 };
+    static const uint64_t delay[] = { 2000, 3500, 2500 };
+    csi_join_config_t config = test_config();
+    csi_join_t *join = csi_join_create(&config);
+    TEST_ASSERT_NOT_NULL(join);
+
+    // Every node announces itself before the first set is due
+    for (int n = 0; n < 3; n++) {
+        push_moments(join, nodes[n], 0, 1, boot[n], delay[n], 0);
+    }
+    for (uint32_t first = 1; first < 200; first += 10) {
+        uint32_t count = first + 10 <= 200 ? 10 : 200 - first;
+        for (int n = 0; n < 3; n++) {
+            push_moments(join, nodes[n], first, count, boot[n], delay[n], 0);
+        }
+    }
+    csi_join_flush(join);
+
+    TEST_ASSERT_EQUAL_INT(200, s_set_count);
+    for (int s = 0; s < s_set_count; s++) {
+        TEST_ASSERT_EQUAL_UINT32(3, s_sets[s].nodes);
+        TEST_ASSERT_EQUAL_UINT32(3, s_sets[s].present);
+        for (int n = 0; n < 3; n++) {
+            TEST_ASSERT_EQUAL_UINT32(s, s_sets[s].sequence[n]);
+            TEST_ASSERT_EQUAL_FLOAT((float)s, s_sets[s].amplitude0[n]);
+        }
+        if (s > 0) {
+            TEST_ASSERT_TRUE(s_sets[s].timestamp > s_sets[s - 1].timestamp);
+        }
+    }
+    // The sets have taught the joiner the difference in delay
+    for (int n = 0; n < 3; n++) {
+        TEST_ASSERT_TRUE(abs(s_sets[s_set_count - 1].skew_us[n]) < 300);
+    }
+
+    csi_join_stats_t stats;
+    csi_join_get_stats(join, &stats);
+    TEST_ASSERT_EQUAL_UINT64(600, stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(200, stats.sets);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.sets_partial);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.frames_late);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.nodes);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.waiting);
+    csi_join_destroy(join);
+}
+
+void test_csi_join_bounded_latency(void)
+{
+    csi_join_config_t config = test_config();
+    config.max_latency_ms = 100;
+    config.node_idle_ms = 60000;
+    csi_join_t *join = csi_join_create(&config);
+    TEST_ASSERT_NOT_NULL(join);
+
+    // c delivers moment 0 and falls silent
+    push_moments(join, "c", 0, 1, 0, 1000, CSI_FRAME_FLAG_UTC);
+    push_moments(join, "a", 0, 11, 0, 1000, CSI_FRAME_FLAG_UTC);
+    push_moments(join, "b", 0, 11, 0, 1000, CSI_FRAME_FLAG_UTC);
+    TEST_ASSERT_EQUAL_INT(0, s_set_count);
+
+    csi_join_poll(join, 10000000 + 100000);
+    TEST_ASSERT_EQUAL_INT(1, s_set_count);
+    TEST_ASSERT_EQUAL_UINT32(3, s_sets[0].present);
+
+    for (uint64_t now = 10000000 + 100000; now <= 10000000 + 150000; now += 1000) {
+        csi_join_poll(join, now);
+    }
+    TEST_ASSERT_EQUAL_INT(11, s_set_count);
+    for (int s = 1; s < s_set_count; s++) {
+        TEST_ASSERT_EQUAL_UINT32(2, s_sets[s].present);
+        TEST_ASSERT_EQUAL_UINT8(0, s_sets[s].valid[0]);
+    }
+
+    csi_join_stats_t stats;
+    csi_join_get_stats(join, &stats);
+    TEST_ASSERT_EQUAL_UINT64(10, stats.sets_partial);
+    TEST_ASSERT_TRUE(stats.latency_us_max <= 100000);
+    csi_join_destroy(join);
+}
+
+void test_csi_join_late_frames(void)
+{
+    csi_join_config_t config = test_config();
+    csi_join_t *join = csi_join_create(&config);
+    TEST_ASSERT_NOT_NULL(join);
+
+    push_moments(join, "a", 0, 10, 0, 1000, CSI_FRAME_FLAG_UTC);
+    push_moments(join, "b", 0, 10, 0, 1000, CSI_FRAME_FLAG_UTC);
+    csi_join_poll(join, 20000000);
+    TEST_ASSERT_EQUAL_INT(10, s_set_count);
+
+    // c's report of the same moments comes after they were emitted
+    push_moments(join, "c", 0, 5, 0, 10000000, CSI_FRAME_FLAG_UTC);
+    csi_join_flush(join);
+    TEST_ASSERT_EQUAL_INT(10, s_set_count);
+
+    csi_join_stats_t stats;
+    csi_join_get_stats(join, &stats);
+    TEST_ASSERT_EQUAL_UINT64(5, stats.frames_late);
+    TEST_ASSERT_EQUAL_UINT64(20, stats.frames);
+    csi_join_destroy(join);
+}
+
+void test_csi_join_match_mac(void)
+{
+    // Transmitters 1 and 2 send 500 us apart every 5 ms; b misses transmitter 1 at moment 2
+    uint32_t seq[8];
+    uint64_t ts[8];
+    uint8_t mac[8];
+    uint32_t b_seq[8];
+    uint64_t b_ts[8];
+    uint8_t b_mac[8];
+    int b_count = 0;
+    for (int i = 0; i < 8; i++) {
+        seq[i] = i;
+        ts[i] = 10000000 + (i / 2) * 5000 + (i % 2) * 500;
+        mac[i] = 1 + i % 2;
+        if (i != 4) {
+            b_seq[b_count] = seq[i];
+            b_ts[b_count] = ts[i];
+            b_mac[b_count++] = mac[i];
+        }
+    }
+
+    for (int match = 1; match >= 0; match--) {
+        setUp();
+        csi_join_config_t config = test_config();
+        config.match_mac = match;
+        csi_join_t *join = csi_join_create(&config);
+        TEST_ASSERT_NOT_NULL(join);
+        csi_ingest_batch_t batch = make_batch("a", 8, seq, ts, mac, CSI_FRAME_FLAG_UTC);
+        csi_join_push(join, &batch, 10100000);
+        batch = make_batch("b", b_count, b_seq, b_ts, b_mac, CSI_FRAME_FLAG_UTC);
+        csi_join_push(join, &batch, 10100000);
+        csi_join_flush(join);
+
+        int mismatched = 0;
+        for (int s = 0; s < s_set_count; s++) {
+            if (s_sets[s].present == 2 && s_sets[s].sequence[0] != s_sets[s].sequence[1]) {
+                mismatched++;
+            }
+        }
+        csi_join_stats_t stats;
+        csi_join_get_stats(join, &stats);
+        if (match) {
+            // a's lone frame of transmitter 1 is dropped, the rest pair up
+            TEST_ASSERT_EQUAL_INT(7, s_set_count);
+            TEST_ASSERT_EQUAL_INT(0, mismatched);
+            TEST_ASSERT_EQUAL_UINT64(1, stats.sets_dropped);
+            TEST_ASSERT_EQUAL_UINT64(1, stats.frames_unjoined);
+        } else {
+            TEST_ASSERT_TRUE(mismatched > 0);
+        }
+        csi_join_destroy(join);
+    }
+}
+
+void test_csi_join_reorders(void)
+{
+    static const uint32_t seq[] = { 2, 0, 3, 1 };
+    static const uint64_t ts[] = { 10010000, 10000000, 10015000, 10005000 };
+    csi_join_config_t config = test_config();
+    csi_join_t *join = csi_join_create(&config);
+    TEST_ASSERT_NOT_NULL(join);
+
+    csi_ingest_batch_t batch = make_batch("a", 4, seq, ts, NULL, CSI_FRAME_FLAG_UTC);
+    csi_join_push(join, &batch, 10020000);
+    push_moments(join, "b", 0, 4, 0, 5000, CSI_FRAME_FLAG_UTC);
+    csi_join_flush(join);
+
+    TEST_ASSERT_EQUAL_INT(4, s_set_count);
+    for (int s = 0; s < 4; s++) {
+        TEST_ASSERT_EQUAL_UINT32(2, s_sets[s].present);
+        TEST_ASSERT_EQUAL_UINT32(s, s_sets[s].sequence[0]);
+        TEST_ASSERT_EQUAL_UINT32(s, s_sets[s].sequence[1]);
+    }
+    csi_join_destroy(join);
+}
+
+void test_csi_join_reorder_limit(void)
+{
+    csi_join_config_t config = test_config();
+    config.reorder_frames = 8;
+    config.max_latency_ms = 60000;
+    csi_join_t *join = csi_join_create(&config);
+    TEST_ASSERT_NOT_NULL(join);
+
+    // b stalls after moment 0, so a's frames pile up
+    push_moments(join, "b", 0, 1, 0, 1000, CSI_FRAME_FLAG_UTC);
+    push_moments(join, "a", 0, 20, 0, 1000, CSI_FRAME_FLAG_UTC);
+
+    csi_join_stats_t stats;
+    csi_join_get_stats(join, &stats);
+    TEST_ASSERT_EQUAL_UINT64(12, stats.sets_forced);
+    TEST_ASSERT_EQUAL_UINT32(8, stats.waiting);
+    TEST_ASSERT_EQUAL_UINT64(21, stats.frames);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.sets);
+    TEST_ASSERT_EQUAL_UINT64(11, stats.sets_dropped);
+    csi_join_destroy(join);
+}
+
+void test_csi_join_node_restart(void)
+{
+    csi_join_config_t config = test_config();
+    csi_join_t *join = csi_join_create(&config);
+    TEST_ASSERT_NOT_NULL(join);
+
+    push_moments(join, "a", 0, 10, 5000000, 2000, 0);
+    push_moments(join, "b", 0, 10, 0, 2000, CSI_FRAME_FLAG_UTC);
+    // a reboots: its uptime restarts from zero for the next moments
+    push_moments(join, "a", 10, 10, 10000000 + 10 * 5000, 2000, 0);
+    push_moments(join, "b", 10, 10, 0, 2000, CSI_FRAME_FLAG_UTC);
+    csi_join_flush(join);
+
+    csi_join_stats_t stats;
+    csi_join_get_stats(join, &stats);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.clock_resets);
+    TEST_ASSERT_EQUAL_UINT64(20, stats.sets);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.frames_late);
+    for (int s = 0; s < s_set_count; s++) {
+        TEST_ASSERT_EQUAL_UINT32(2, s_sets[s].present);
+        TEST_ASSERT_EQUAL_UINT32(s_sets[s].sequence[0], s_sets[s].sequence[1]);
+    }
+    csi_join_destroy(join);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_csi_join_aligns_offset_clocks);
+    RUN_TEST(test_csi_join_bounded_latency);
+    RUN_TEST(test_csi_join_late_frames);
+    RUN_TEST(test_csi_join_match_mac);
+    RUN_TEST(test_csi_join_reorders);
+    RUN_TEST(test_csi_join_reorder_limit);
+    RUN_TEST(test_csi_join_node_restart);
+
+    return UNITY_END();
+}
@@ -0,0 +1,138 @@
+/**
+ * @file csi_locate.h
+ * @brief Batched multilateration: target positions from ranges to known nodes
+ *
+ * Every node reports its position (node_position_x/y/z of its
+ * configuration, published in devices/<id>/status/detailed). Given the
+ * range, or the RSSI, that each node measured to a target, the solver
+ * finds the position that minimises the weighted squared range residuals
+ * with Levenberg-Marquardt, for thousands of targets per call.
+ *
+ * Data is laid out structure-of-arrays: measurements are stored node by
+ * node, each a run of one value per target, so the inner loops step
+ * through targets with unit stride and compile to SIMD without
+ * intrinsics. Weights are inverse variances; a weight of 0 marks a node
+ * that did not measure the target. With such weights the inverse of the
+ * normal matrix is the covariance of the estimate, which gives the
+ * reported uncertainty.
+ */
+
+#ifndef CSI_LOCATE_H
+#define CSI_LOCATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Log-distance path loss: RSSI = rssi_at_1m - 10 * exponent * log10(d)
+ */
+typedef struct {
+    float rssi_at_1m;               ///< dBm
+    float exponent;
+    float shadowing_db;             ///< Standard deviation of RSSI about the model
+    float min_range;                ///< Ranges are clamped to [min_range, max_range] metres
+    float max_range;
+} csi_locate_path_loss_t;
+
+/**
+ * @brief Free-space-like defaults; calibrate per site
+ */
+#define CSI_LOCATE_PATH_LOSS_DEFAULT() {    \
+    .rssi_at_1m = -30.0f,                   \
+    .exponent = 2.0f,                       \
+    .shadowing_db = 4.0f,                   \
+    .min_range = 0.1f,                      \
+    .max_range = 100.0f,                    \
+}
+
+/**
+ * @brief Ranges and their weights from RSSI
+ *
+ * Shadowing is log-normal, so the range error grows with the range:
+ * sigma = range * ln(10) / (10 * exponent) * shadowing_db.
+ *
+ * @param model Path loss model
+ * @param rssi n values in dBm; NaN for no measurement
+ * @param n Number of values
+ * @param range n ranges in metres
+ * @param weight n weights (1 / sigma^2), 0 where rssi is NaN
+ */
+void csi_locate_rssi_to_range(const csi_locate_path_loss_t *model, const float *rssi, size_t n,
+                              float *range, float *weight);
+
+/**
+ * @brief Measurements of a batch of targets
+ *
+ * range and weight hold anchors * targets values, node-major: the
+ * measurement of node a to target t is at [a * targets + t].
+ */
+typedef struct {
+    uint32_t anchors;               ///< Nodes
+    const float *anchor_x;          ///< anchors positions, metres
+    const float *anchor_y;
+    const float *anchor_z;
+    uint32_t targets;
+    const float *range;
+    const float *weight;            ///< Inverse variance, 0 if not measured
+} csi_locate_input_t;
+
+/**
+ * @brief Outcome for one target
+ */
+typedef enum {
+    CSI_LOCATE_CONVERGED = 0,
+    CSI_LOCATE_MAX_ITERATIONS,      ///< Best estimate after max_iterations
+    CSI_LOCATE_UNDERDETERMINED,     ///< Fewer than dims + 1 nodes measured it; weighted centroid
+} csi_locate_status_t;
+
+/**
+ * @brief Results, one value per target; optional arrays may be NULL
+ */
+typedef struct {
+    float *x;                       ///< Estimate; also the start with use_initial
+    float *y;
+    float *z;                       ///< With dims = 2, the target height on input, kept
+    float *sigma_x;                 ///< Standard deviations, optional
+    float *sigma_y;
+    float *sigma_z;                 ///< 0 with dims = 2
+    float *chi2;                    ///< Weighted sum of squared residuals, optional
+    uint8_t *status;                ///< csi_locate_status_t, optional
+} csi_locate_output_t;
+
+/**
+ * @brief Solver settings
+ */
+typedef struct {
+    int dims;                       ///< 3, or 2 to solve x and y at a known height
+    int max_iterations;
+    float tolerance;                ///< Converged when a step is shorter, metres
+    bool use_initial;               ///< Start from the output position, not the weighted centroid
+} csi_locate_config_t;
+
+#define CSI_LOCATE_CONFIG_DEFAULT() {   \
+    .dims = 3,                          \
+    .max_iterations = 30,               \
+    .tolerance = 1e-3f,                 \
+    .use_initial = false,               \
+}
+
+/**
+ * @brief Locate a batch of targets
+ * @param config Settings
+ * @param input Node positions and measurements
+ * @param output Estimates
+ * @return Targets that converged, or -1 if the arguments are invalid
+ */
+int csi_locate_solve(const csi_locate_config_t *config, const csi_locate_input_t *input,
+                     const csi_locate_output_t *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSI_LOCATE_H
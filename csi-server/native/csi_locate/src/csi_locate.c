@@ -0,0 +1,312 @@
+/**
+ * @file csi_locate.c
+ * @brief Levenberg-Marquardt multilateration over blocks of targets
+ *
+ * Targets are solved BLOCK at a time. Every per-target quantity of a
+ * block (position, damping, normal equations) is an array indexed by
+ * target, and every pass loops over the nodes outside and the targets
+ * inside, so the inner loops are branch-free and vectorise. Targets that
+ * have converged ride along with a zero step until the whole block is
+ * done.
+ */
+
+#include "csi_locate.h"
+
+#include <math.h>
+#include <string.h>
+
+#define BLOCK           256
+#define LAMBDA_START    1e-3f
+#define LAMBDA_DOWN     0.2f
+#define LAMBDA_UP       8.0f
+#define LAMBDA_MAX      1e7f
+#define MIN_DISTANCE2   1e-8f           ///< Keeps the unit vector finite on top of a node
+#define DIAG_EPSILON    1e-9f           ///< Keeps the damped matrix invertible
+
+/**
+ * @brief Working set of one block of targets
+ */
+typedef struct {
+    float x[BLOCK], y[BLOCK], z[BLOCK];
+    float tx[BLOCK], ty[BLOCK], tz[BLOCK];      ///< Trial position
+    float h00[BLOCK], h01[BLOCK], h02[BLOCK];   ///< J^T W J, upper triangle
+    float h11[BLOCK], h12[BLOCK], h22[BLOCK];
+    float g0[BLOCK], g1[BLOCK], g2[BLOCK];      ///< J^T W r
+    float cost[BLOCK];
+    float trial_cost[BLOCK];
+    float lambda[BLOCK];
+    float active[BLOCK];                        ///< 1 while iterating, else 0
+    float converged[BLOCK];
+    float measured[BLOCK];                      ///< Nodes with a weight
+} block_t;
+
+void csi_locate_rssi_to_range(const csi_locate_path_loss_t *model, const float *rssi, size_t n,
+                              float *range, float *weight)
+{
+    float inv_slope = 1.0f / (10.0f * model->exponent);
+    float rel_sigma = (float)M_LN10 * inv_slope * model->shadowing_db;
+    for (size_t i = 0; i < n; i++) {
+        if (isnan(rssi[i])) {
+            range[i] = 0;
+            weight[i] = 0;
+            continue;
+        }
+        float d = powf(10.0f, (model->rssi_at_1m - rssi[i]) * inv_slope);
+        d = fminf(fmaxf(d, model->min_range), model->max_range);
+        float sigma = d * rel_sigma;
+        range[i] = d;
+        weight[i] = 1.0f / (sigma * sigma);
+    }
+}
+
+/**
+ * @brief Normal equations and cost at the block's positions
+ */
+static void accumulate(const csi_locate_input_t *in, uint32_t base, int n, block_t *b)
+{
+    memset(b->h00, 0, sizeof(b->h00));
+    memset(b->h01, 0, sizeof(b->h01));
+    memset(b->h02, 0, sizeof(b->h02));
+    memset(b->h11, 0, sizeof(b->h11));
+    memset(b->h12, 0, sizeof(b->h12));
+    memset(b->h22, 0, sizeof(b->h22));
+    memset(b->g0, 0, sizeof(b->g0));
+    memset(b->g1, 0, sizeof(b->g1));
+    memset(b->g2, 0, sizeof(b->g2));
+    memset(b->cost, 0, sizeof(b->cost));
+
+    for (uint32_t a = 0; a < in->anchors; a++) {
+        const float ax = in->anchor_x[a], ay = in->anchor_y[a], az = in->anchor_z[a];
+        const float *restrict r = in->range + (size_t)a * in->targets + base;
+        const float *restrict w = in->weight + (size_t)a * in->targets + base;
+        for (int t = 0; t < n; t++) {
+            float dx = b->x[t] - ax, dy = b->y[t] - ay, dz = b->z[t] - az;
+            float inv = 1.0f / sqrtf(dx * dx + dy * dy + dz * dz + MIN_DISTANCE2);
+            float ux = dx * inv, uy = dy * inv, uz = dz * inv;
+            float res = (dx * dx + dy * dy + dz * dz) * inv - r[t];
+            float wt = w[t];
+            b->h00[t] += wt * ux * ux;
+            b->h01[t] += wt * ux * uy;
+            b->h02[t] += wt * ux * uz;
+            b->h11[t] += wt * uy * uy;
+            b->h12[t] += wt * uy * uz;
+            b->h22[t] += wt * uz * uz;
+            b->g0[t] += wt * ux * res;
+            b->g1[t] += wt * uy * res;
+            b->g2[t] += wt * uz * res;
+            b->cost[t] += wt * res * res;
+        }
+    }
+}
+
+/**
+ * @brief Cost at the block's trial positions
+ */
+static void trial_cost(const csi_locate_input_t *in, uint32_t base, int n, block_t *b)
+{
+    memset(b->trial_cost, 0, sizeof(b->trial_cost));
+    for (uint32_t a = 0; a < in->anchors; a++) {
+        const float ax = in->anchor_x[a], ay = in->anchor_y[a], az = in->anchor_z[a];
+        const float *restrict r = in->range + (size_t)a * in->targets + base;
+        const float *restrict w = in->weight + (size_t)a * in->targets + base;
+        for (int t = 0; t < n; t++) {
+            float dx = b->tx[t] - ax, dy = b->ty[t] - ay, dz = b->tz[t] - az;
+            float res = sqrtf(dx * dx + dy * dy + dz * dz) - r[t];
+            b->trial_cost[t] += w[t] * res * res;
+        }
+    }
+}
+
+/**
+ * @brief Damped Gauss-Newton step of every target into the trial position
+ */
+static void step(int dims, int n, block_t *b)
+{
+    for (int t = 0; t < n; t++) {
+        float k = 1.0f + b->lambda[t];
+        float a00 = b->h00[t] * k + DIAG_EPSILON, a11 = b->h11[t] * k + DIAG_EPSILON;
+        float a22 = b->h22[t] * k + DIAG_EPSILON;
+        float a01 = b->h01[t], a02 = b->h02[t], a12 = b->h12[t];
+        float r0 = -b->g0[t], r1 = -b->g1[t], r2 = -b->g2[t];
+        float d0, d1, d2;
+        if (dims == 3) {
+            // Cramer's rule on the symmetric 3x3 system
+            float c00 = a11 * a22 - a12 * a12;
+            float c01 = a02 * a12 - a01 * a22;
+            float c02 = a01 * a12 - a02 * a11;
+            float c11 = a00 * a22 - a02 * a02;
+            float c12 = a01 * a02 - a00 * a12;
+            float c22 = a00 * a11 - a01 * a01;
+            float inv_det = 1.0f / (a00 * c00 + a01 * c01 + a02 * c02);
+            d0 = (c00 * r0 + c01 * r1 + c02 * r2) * inv_det;
+            d1 = (c01 * r0 + c11 * r1 + c12 * r2) * inv_det;
+            d2 = (c02 * r0 + c12 * r1 + c22 * r2) * inv_det;
+        } else {
+            float inv_det = 1.0f / (a00 * a11 - a01 * a01);
+            d0 = (a11 * r0 - a01 * r1) * inv_det;
+            d1 = (a00 * r1 - a01 * r0) * inv_det;
+            d2 = 0;
+        }
+        float on = b->active[t];
+        b->tx[t] = b->x[t] + on * d0;
+        b->ty[t] = b->y[t] + on * d1;
+        b->tz[t] = b->z[t] + on * d2;
+    }
+}
+
+/**
+ * @brief Keep improving trials, adapt damping and retire converged targets
+ * @return Targets still iterating
+ */
+static int update(float tolerance, int n, block_t *b)
+{
+    int active = 0;
+    float tol2 = tolerance * tolerance;
+    for (int t = 0; t < n; t++) {
+        float dx = b->tx[t] - b->x[t], dy = b->ty[t] - b->y[t], dz = b->tz[t] - b->z[t];
+        bool accept = b->trial_cost[t] < b->cost[t];
+        bool small = dx * dx + dy * dy + dz * dz < tol2;
+        b->x[t] = accept ? b->tx[t] : b->x[t];
+        b->y[t] = accept ? b->ty[t] : b->y[t];
+        b->z[t] = accept ? b->tz[t] : b->z[t];
+        b->lambda[t] = accept ? b->lambda[t] * LAMBDA_DOWN : fminf(b->lambda[t] * LAMBDA_UP, LAMBDA_MAX);
+        // A rejected short step means the minimum is within tolerance too
+        float done = (small && b->active[t] > 0) ? 1.0f : 0.0f;
+        b->converged[t] = fmaxf(b->converged[t], done);
+        b->active[t] = (b->active[t] > 0 && !small && b->lambda[t] < LAMBDA_MAX) ? 1.0f : 0.0f;
+        active += b->active[t] > 0;
+    }
+    return active;
+}
+
+/**
+ * @brief Start at the centroid of the nodes, weighted towards the nearest
+ */
+static void initial_position(const csi_locate_config_t *config, const csi_locate_input_t *in,
+                             const csi_locate_output_t *out, uint32_t base, int n, block_t *b)
+{
+    float sw[BLOCK];
+    memset(sw, 0, sizeof(sw));
+    memset(b->tx, 0, sizeof(b->tx));
+    memset(b->ty, 0, sizeof(b->ty));
+    memset(b->tz, 0, sizeof(b->tz));
+    memset(b->measured, 0, sizeof(b->measured));
+    float mean_x = 0, mean_y = 0, mean_z = 0;
+    for (uint32_t a = 0; a < in->anchors; a++) {
+        const float ax = in->anchor_x[a], ay = in->anchor_y[a], az = in->anchor_z[a];
+        const float *restrict r = in->range + (size_t)a * in->targets + base;
+        const float *restrict w = in->weight + (size_t)a * in->targets + base;
+        for (int t = 0; t < n; t++) {
+            float has = w[t] > 0 ? 1.0f : 0.0f;
+            float c = has / (r[t] * r[t] + 0.01f);
+            b->tx[t] += c * ax;
+            b->ty[t] += c * ay;
+            b->tz[t] += c * az;
+            sw[t] += c;
+            b->measured[t] += has;
+        }
+        mean_x += ax / in->anchors;
+        mean_y += ay / in->anchors;
+        mean_z += az / in->anchors;
+    }
+
+    for (int t = 0; t < n; t++) {
+        bool any = sw[t] > 0;
+        float cx = any ? b->tx[t] / sw[t] : mean_x;
+        float cy = any ? b->ty[t] / sw[t] : mean_y;
+        float cz = any ? b->tz[t] / sw[t] : mean_z;
+        if (config->use_initial) {
+            b->x[t] = out->x[base + t];
+            b->y[t] = out->y[base + t];
+            b->z[t] = out->z[base + t];
+        } else {
+            b->x[t] = cx;
+            b->y[t] = cy;
+            b->z[t] = config->dims == 2 ? out->z[base + t] : cz;
+        }
+        b->lambda[t] = LAMBDA_START;
+        b->converged[t] = 0;
+        b->active[t] = b->measured[t] >= config->dims + 1 ? 1.0f : 0.0f;
+    }
+}
+
+/**
+ * @brief Standard deviations from the undamped normal matrix at the solution
+ */
+static void uncertainty(int dims, const csi_locate_output_t *out, uint32_t base, int n, const block_t *b)
+{
+    for (int t = 0; t < n; t++) {
+        float a00 = b->h00[t], a01 = b->h01[t], a02 = b->h02[t];
+        float a11 = b->h11[t], a12 = b->h12[t], a22 = b->h22[t];
+        float v0, v1, v2;
+        if (dims == 3) {
+            float c00 = a11 * a22 - a12 * a12;
+            float c11 = a00 * a22 - a02 * a02;
+            float c22 = a00 * a11 - a01 * a01;
+            float det = a00 * c00 + a01 * (a02 * a12 - a01 * a22) + a02 * (a01 * a12 - a02 * a11);
+            v0 = c00 / det;
+            v1 = c11 / det;
+            v2 = c22 / det;
+        } else {
+            float det = a00 * a11 - a01 * a01;
+            v0 = a11 / det;
+            v1 = a00 / det;
+            v2 = 0;
+        }
+        bool solved = b->measured[t] >= dims + 1 && v0 >= 0 && v1 >= 0 && v2 >= 0;
+        if (out->sigma_x) {
+            out->sigma_x[base + t] = solved ? sqrtf(v0) : INFINITY;
+        }
+        if (out->sigma_y) {
+            out->sigma_y[base + t] = solved ? sqrtf(v1) : INFINITY;
+        }
+        if (out->sigma_z) {
+            out->sigma_z[base + t] = dims == 2 ? 0 : solved ? sqrtf(v2) : INFINITY;
+        }
+    }
+}
+
+int csi_locate_solve(const csi_locate_config_t *config, const csi_locate_input_t *input,
+                     const csi_locate_output_t *output)
+{
+    if ((config->dims != 2 && config->dims != 3) || config->max_iterations < 0 || input->anchors == 0 ||
+        !input->anchor_x || !input->anchor_y || !input->anchor_z || !input->range || !input->weight ||
+        !output->x || !output->y || !output->z) {
+        return -1;
+    }
+
+    block_t b;
+    int converged = 0;
+    for (uint32_t base = 0; base < input->targets; base += BLOCK) {
+        int n = input->targets - base < BLOCK ? (int)(input->targets - base) : BLOCK;
+        initial_position(config, input, output, base, n, &b);
+        accumulate(input, base, n, &b);
+        for (int it = 0; it < config->max_iterations; it++) {
+            step(config->dims, n, &b);
+            trial_cost(input, base, n, &b);
+            if (update(config->tolerance, n, &b) == 0) {
+                break;
+            }
+            accumulate(input, base, n, &b);
+        }
+        accumulate(input, base, n, &b);
+        uncertainty(config->dims, output, base, n, &b);
+
+        for (int t = 0; t < n; t++) {
+            output->x[base + t] = b.x[t];
+            output->y[base + t] = b.y[t];
+            output->z[base + t] = b.z[t];
+            if (output->chi2) {
+                output->chi2[base + t] = b.cost[t];
+            }
+            csi_locate_status_t status = b.measured[t] < config->dims + 1 ? CSI_LOCATE_UNDERDETERMINED
+                                         : b.converged[t] > 0               ? CSI_LOCATE_CONVERGED
+                                                                            : CSI_LOCATE_MAX_ITERATIONS;
+            if (output->status) {
+                output->status[base + t] = (uint8_t)status;
+            }
+            converged += status == CSI_LOCATE_CONVERGED;
+        }
+    }
+    return converged;
+}
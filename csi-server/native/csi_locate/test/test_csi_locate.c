@@ -0,0 +1,230 @@
+/**
+ * @file test_csi_locate.c
+ * @brief Unit tests for the multilateration solver
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csi_locate.h"
+
+#define ANCHORS     6
+#define TARGETS     600         ///< More than two solver blocks, not a multiple of one
+
+// Nodes on the walls of a 10 x 8 x 3 m room, at different heights
+static const float s_ax[ANCHORS] = { 0.0f, 10.0f, 10.0f, 0.0f, 5.0f, 5.0f };
+static const float s_ay[ANCHORS] = { 0.0f, 0.0f, 8.0f, 8.0f, 0.0f, 8.0f };
+static const float s_az[ANCHORS] = { 0.5f, 2.5f, 0.5f, 2.5f, 1.5f, 2.8f };
+
+static float s_range[ANCHORS * TARGETS];
+static float s_weight[ANCHORS * TARGETS];
+static float s_true_x[TARGETS], s_true_y[TARGETS], s_true_z[TARGETS];
+static float s_x[TARGETS], s_y[TARGETS], s_z[TARGETS];
+static float s_sx[TARGETS], s_sy[TARGETS], s_sz[TARGETS];
+static float s_chi2[TARGETS];
+static uint8_t s_status[TARGETS];
+
+static uint32_t s_rng;
+
+static float uniform(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (s_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static float gaussian(void)
+{
+    float u = uniform() + 1e-7f, v = uniform();
+    return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+void setUp(void)
+{
+    s_rng = 42;
+    for (int t = 0; t < TARGETS; t++) {
+        s_true_x[t] = 0.5f + 9.0f * uniform();
+        s_true_y[t] = 0.5f + 7.0f * uniform();
+        s_true_z[t] = 0.2f + 2.6f * uniform();
+    }
+    memset(s_x, 0, sizeof(s_x));
+    memset(s_y, 0, sizeof(s_y));
+    memset(s_z, 0, sizeof(s_z));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Ranges from every node to every target, with Gaussian noise of sigma
+ */
+static void make_ranges(float sigma)
+{
+    for (int a = 0; a < ANCHORS; a++) {
+        for (int t = 0; t < TARGETS; t++) {
+            float dx = s_true_x[t] - s_ax[a], dy = s_true_y[t] - s_ay[a], dz = s_true_z[t] - s_az[a];
+            s_range[a * TARGETS + t] = sqrtf(dx * dx + dy * dy + dz * dz) + sigma * gaussian();
+            s_weight[a * TARGETS + t] = sigma > 0 ? 1.0f / (sigma * sigma) : 1.0f;
+        }
+    }
+}
+
+static csi_locate_input_t make_input(void)
+{
+    csi_locate_input_t input = {
+        .anchors = ANCHORS,
+        .anchor_x = s_ax,
+        .anchor_y = s_ay,
+        .anchor_z = s_az,
+        .targets = TARGETS,
+        .range = s_range,
+        .weight = s_weight,
+    };
+    return input;
+}
+
+static csi_locate_output_t make_output(void)
+{
+    csi_locate_output_t output = {
+        .x = s_x, .y = s_y, .z = s_z,
+        .sigma_x = s_sx, .sigma_y = s_sy, .sigma_z = s_sz,
+        .chi2 = s_chi2,
+        .status = s_status,
+    };
+    return output;
+}
+
+void test_csi_locate_rssi_to_range(void)
+{
+    csi_locate_path_loss_t model = CSI_LOCATE_PATH_LOSS_DEFAULT();
+    const float rssi[] = { -30.0f, -50.0f, -70.0f, NAN, 0.0f };
+    float range[5], weight[5];
+    csi_locate_rssi_to_range(&model, rssi, 5, range, weight);
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.0f, range[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 10.0f, range[1]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-2f, 100.0f, range[2]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, weight[3]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, model.min_range, range[4]);
+    // Range error grows with the range: 4 dB at n = 2 is 46% of the range
+    float sigma1 = 1.0f / sqrtf(weight[0]), sigma10 = 1.0f / sqrtf(weight[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.4605f, sigma1);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 10.0f, sigma10 / sigma1);
+}
+
+void test_csi_locate_exact_3d(void)
+{
+    make_ranges(0);
+    csi_locate_config_t config = CSI_LOCATE_CONFIG_DEFAULT();
+    config.tolerance = 1e-5f;
+    csi_locate_input_t input = make_input();
+    csi_locate_output_t output = make_output();
+
+    TEST_ASSERT_EQUAL_INT(TARGETS, csi_locate_solve(&config, &input, &output));
+    for (int t = 0; t < TARGETS; t++) {
+        TEST_ASSERT_EQUAL_UINT8(CSI_LOCATE_CONVERGED, s_status[t]);
+        TEST_ASSERT_FLOAT_WITHIN(2e-3f, s_true_x[t], s_x[t]);
+        TEST_ASSERT_FLOAT_WITHIN(2e-3f, s_true_y[t], s_y[t]);
+        TEST_ASSERT_FLOAT_WITHIN(2e-3f, s_true_z[t], s_z[t]);
+        TEST_ASSERT_TRUE(s_chi2[t] < 1e-4f);
+    }
+}
+
+void test_csi_locate_known_height(void)
+{
+    make_ranges(0);
+    csi_locate_config_t config = CSI_LOCATE_CONFIG_DEFAULT();
+    config.dims = 2;
+    csi_locate_input_t input = make_input();
+    csi_locate_output_t output = make_output();
+    memcpy(s_z, s_true_z, sizeof(s_z));
+
+    TEST_ASSERT_EQUAL_INT(TARGETS, csi_locate_solve(&config, &input, &output));
+    for (int t = 0; t < TARGETS; t++) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-2f, s_true_x[t], s_x[t]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-2f, s_true_y[t], s_y[t]);
+        TEST_ASSERT_EQUAL_FLOAT(s_true_z[t], s_z[t]);
+        TEST_ASSERT_EQUAL_FLOAT(0.0f, s_sz[t]);
+    }
+}
+
+void test_csi_locate_uncertainty(void)
+{
+    // With correct weights, about 95% of the errors lie within two sigma
+    make_ranges(0.2f);
+    csi_locate_config_t config = CSI_LOCATE_CONFIG_DEFAULT();
+    csi_locate_input_t input = make_input();
+    csi_locate_output_t output = make_output();
+    csi_locate_solve(&config, &input, &output);
+
+    int inside = 0;
+    double chi2 = 0;
+    for (int t = 0; t < TARGETS; t++) {
+        TEST_ASSERT_TRUE(isfinite(s_sx[t]) && s_sx[t] > 0);
+        inside += fabsf(s_x[t] - s_true_x[t]) < 2 * s_sx[t];
+        inside += fabsf(s_y[t] - s_true_y[t]) < 2 * s_sy[t];
+        chi2 += s_chi2[t];
+    }
+    float coverage = inside / (2.0f * TARGETS);
+    TEST_ASSERT_TRUE(coverage > 0.9f && coverage < 0.99f);
+    // 6 ranges, 3 unknowns: chi2 averages 3
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 3.0f, (float)(chi2 / TARGETS));
+}
+
+void test_csi_locate_missing_nodes(void)
+{
+    make_ranges(0);
+    // Target 0 seen by 3 nodes: enough for x and y only; target 1 by 2 nodes
+    for (int a = 3; a < ANCHORS; a++) {
+        s_weight[a * TARGETS + 0] = 0;
+        s_range[a * TARGETS + 0] = 1000.0f;
+    }
+    for (int a = 2; a < ANCHORS; a++) {
+        s_weight[a * TARGETS + 1] = 0;
+    }
+    csi_locate_config_t config = CSI_LOCATE_CONFIG_DEFAULT();
+    config.dims = 2;
+    csi_locate_input_t input = make_input();
+    csi_locate_output_t output = make_output();
+    memcpy(s_z, s_true_z, sizeof(s_z));
+
+    TEST_ASSERT_EQUAL_INT(TARGETS - 1, csi_locate_solve(&config, &input, &output));
+    TEST_ASSERT_EQUAL_UINT8(CSI_LOCATE_CONVERGED, s_status[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-2f, s_true_x[0], s_x[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-2f, s_true_y[0], s_y[0]);
+    TEST_ASSERT_EQUAL_UINT8(CSI_LOCATE_UNDERDETERMINED, s_status[1]);
+    TEST_ASSERT_TRUE(isinf(s_sx[1]));
+    TEST_ASSERT_TRUE(isfinite(s_x[1]));
+}
+
+void test_csi_locate_invalid(void)
+{
+    make_ranges(0);
+    csi_locate_config_t config = CSI_LOCATE_CONFIG_DEFAULT();
+    csi_locate_input_t input = make_input();
+    csi_locate_output_t output = make_output();
+
+    config.dims = 1;
+    TEST_ASSERT_EQUAL_INT(-1, csi_locate_solve(&config, &input, &output));
+    config.dims = 3;
+    input.anchors = 0;
+    TEST_ASSERT_EQUAL_INT(-1, csi_locate_solve(&config, &input, &output));
+    input.anchors = ANCHORS;
+    input.targets = 0;
+    TEST_ASSERT_EQUAL_INT(0, csi_locate_solve(&config, &input, &output));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_csi_locate_rssi_to_range);
+    RUN_TEST(test_csi_locate_exact_3d);
+    RUN_TEST(test_csi_locate_known_height);
+    RUN_TEST(test_csi_locate_uncertainty);
+    RUN_TEST(test_csi_locate_missing_nodes);
+    RUN_TEST(test_csi_locate_invalid);
+
+    return UNITY_END();
+}
@@ -0,0 +1,161 @@
+/**
+ * @file test_probe_fingerprint.c
+ * @brief Unit tests for the probe request fingerprint shared with the sniffers
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "probe_fingerprint.h"
+
+static const uint8_t s_key[PROBE_FP_KEY_LEN] = PROBE_FP_KEY_DEFAULT;
+
+/**
+ * @brief Broadcast probe request for "home", without its FCS
+ */
+static const uint8_t s_probe[] = {
+    0x40, 0x00, 0x00, 0x00,                                 // frame control, duration
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff,                     // addr1
+    0x02, 0x11, 0x22, 0x33, 0x44, 0x55,                     // addr2, the transmitter
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff,                     // addr3
+    0x10, 0x7a,                                             // sequence control
+    0x00, 0x04, 'h', 'o', 'm', 'e',                         // SSID
+    0x01, 0x08, 0x02, 0x04, 0x0b, 0x16, 0x0c, 0x12, 0x18, 0x24, // supported rates
+    0x32, 0x04, 0x30, 0x48, 0x60, 0x6c,                     // extended rates
+    0x2d, 0x04, 0xef, 0x01, 0x1b, 0xff,                     // HT capabilities, shortened
+    0xdd, 0x07, 0x00, 0x50, 0xf2, 0x08, 0x00, 0x23, 0x00,   // vendor specific
+};
+
+static uint8_t s_frame[sizeof(s_probe) + 16];
+
+void setUp(void)
+{
+    memcpy(s_frame, s_probe, sizeof(s_probe));
+}
+
+void tearDown(void)
+{
+}
+
+static uint64_t fingerprint(size_t len)
+{
+    return probe_fingerprint(s_key, s_frame, len);
+}
+
+void test_probe_fp_halfsip_reference_vectors(void)
+{
+    // HalfSipHash-2-4 with 64-bit output, key 00..07, messages 00, 00 01, ...
+    static const uint64_t expected[] = { 0xc83cb8b9591f8d21ULL, 0x157338f8122455beULL, 0x57eb507cef394f06ULL };
+    uint8_t key[PROBE_FP_KEY_LEN], msg[8];
+    for (int i = 0; i < 8; i++) {
+        key[i] = (uint8_t)i;
+        msg[i] = (uint8_t)i;
+    }
+    for (size_t len = 0; len < 3; len++) {
+        TEST_ASSERT_EQUAL_UINT64(expected[len], probe_fp_halfsip(key, 2, 4, NULL, 0, msg, len));
+    }
+
+    // Leading words hash as the bytes they stand for
+    uint32_t word = 0x03020100;
+    TEST_ASSERT_EQUAL_UINT64(probe_fp_halfsip(key, 1, 3, NULL, 0, msg, 7),
+                             probe_fp_halfsip(key, 1, 3, &word, 1, msg + 4, 3));
+}
+
+void test_probe_fp_canonical_parts(void)
+{
+    probe_fp_canon_t canon;
+    TEST_ASSERT_TRUE(probe_fp_canonicalize(s_frame, sizeof(s_probe), &canon));
+    TEST_ASSERT_EQUAL_PTR(s_frame + 10, canon.sa);
+    TEST_ASSERT_EQUAL_PTR(s_frame + 22, canon.seq_ctrl);
+    TEST_ASSERT_EQUAL_PTR(s_frame + PROBE_FP_HDR_LEN, canon.ies);
+    TEST_ASSERT_EQUAL(sizeof(s_probe) - PROBE_FP_HDR_LEN, canon.ies_len);
+    TEST_ASSERT_EQUAL_UINT64(probe_fp_hash(s_key, &canon), fingerprint(sizeof(s_probe)));
+}
+
+void test_probe_fp_same_at_every_receiver(void)
+{
+    const uint64_t fp = fingerprint(sizeof(s_probe));
+
+    // Retransmission heard alone
+    s_frame[1] |= 0x08;
+    TEST_ASSERT_EQUAL_UINT64(fp, fingerprint(sizeof(s_probe)));
+    s_frame[2] = 0x3a;
+    TEST_ASSERT_EQUAL_UINT64(fp, fingerprint(sizeof(s_probe)));
+
+    // Capture cut inside an element that was not in the frame
+    memcpy(s_frame + sizeof(s_probe), (const uint8_t[]){ 0x7f, 0x08, 0x04 }, 3);
+    TEST_ASSERT_EQUAL_UINT64(fp, fingerprint(sizeof(s_probe) + 3));
+    TEST_ASSERT_EQUAL_UINT64(fp, fingerprint(sizeof(s_probe) + 1));
+}
+
+void test_probe_fp_distinguishes(void)
+{
+    const uint64_t fp = fingerprint(sizeof(s_probe));
+
+    s_frame[15] ^= 1;                                       // transmitter
+    TEST_ASSERT_NOT_EQUAL(fp, fingerprint(sizeof(s_probe)));
+    setUp();
+    s_frame[23] ^= 0x10;                                    // next sequence number
+    TEST_ASSERT_NOT_EQUAL(fp, fingerprint(sizeof(s_probe)));
+    setUp();
+    s_frame[sizeof(s_probe) - 1] ^= 1;                      // last element byte
+    TEST_ASSERT_NOT_EQUAL(fp, fingerprint(sizeof(s_probe)));
+    setUp();
+    // Last element dropped
+    TEST_ASSERT_NOT_EQUAL(fp, fingerprint(sizeof(s_probe) - 9));
+    // A different key
+    uint8_t key[PROBE_FP_KEY_LEN] = PROBE_FP_KEY_DEFAULT;
+    key[7] ^= 1;
+    TEST_ASSERT_NOT_EQUAL(fp, probe_fingerprint(key, s_frame, sizeof(s_probe)));
+}
+
+void test_probe_fp_not_a_probe_request(void)
+{
+    TEST_ASSERT_EQUAL_UINT64(0, fingerprint(PROBE_FP_HDR_LEN - 1));
+    s_frame[0] = 0x80;                                      // beacon
+    TEST_ASSERT_EQUAL_UINT64(0, fingerprint(sizeof(s_probe)));
+    // Header alone is a probe request without elements
+    setUp();
+    TEST_ASSERT_NOT_EQUAL(0, fingerprint(PROBE_FP_HDR_LEN));
+}
+
+void test_probe_fp_pinned(void)
+{
+    // What the sniffers report for s_probe with the default key
+    TEST_ASSERT_EQUAL_UINT64(0x7df6c28db43c2f44ULL, fingerprint(sizeof(s_probe)));
+}
+
+void test_probe_fp_key_parse(void)
+{
+    const uint8_t expected[PROBE_FP_KEY_LEN] = PROBE_FP_KEY_DEFAULT;
+    uint8_t key[PROBE_FP_KEY_LEN];
+
+    TEST_ASSERT_TRUE(probe_fp_key_parse("70726f6265667031", key));
+    TEST_ASSERT_EQUAL_MEMORY(expected, key, PROBE_FP_KEY_LEN);
+    TEST_ASSERT_TRUE(probe_fp_key_parse("70726F6265667031", key));
+    TEST_ASSERT_EQUAL_MEMORY(expected, key, PROBE_FP_KEY_LEN);
+
+    // Rejected ones leave key alone
+    uint8_t untouched[PROBE_FP_KEY_LEN];
+    memset(key, 0xA5, sizeof(key));
+    memcpy(untouched, key, sizeof(key));
+    TEST_ASSERT_FALSE(probe_fp_key_parse("", key));                     // unconfigured
+    TEST_ASSERT_FALSE(probe_fp_key_parse("70726f626566703", key));      // short
+    TEST_ASSERT_FALSE(probe_fp_key_parse("70726f62656670310", key));    // long
+    TEST_ASSERT_FALSE(probe_fp_key_parse("70726f62656670g1", key));
+    TEST_ASSERT_EQUAL_MEMORY(untouched, key, PROBE_FP_KEY_LEN);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_probe_fp_halfsip_reference_vectors);
+    RUN_TEST(test_probe_fp_canonical_parts);
+    RUN_TEST(test_probe_fp_same_at_every_receiver);
+    RUN_TEST(test_probe_fp_distinguishes);
+    RUN_TEST(test_probe_fp_not_a_probe_request);
+    RUN_TEST(test_probe_fp_pinned);
+    RUN_TEST(test_probe_fp_key_parse);
+
+    return UNITY_END();
+}
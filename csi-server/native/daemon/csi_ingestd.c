@@ -0,0 +1,851 @@
+/**
+ * @file csi_ingestd.c
+ * @brief Server-side CSI ingest daemon
+ *
+ * Subscribes to the CSI topics of every node over MQTT v5 and feeds the
+ * messages to the csi_ingest worker pool, which decodes JSON and binary
+ * frames into per-node column batches. Counters are served in the
+ * Prometheus text format and logged periodically. With --archive the
+ * batches are written to a columnar archive (csi_archive.h):
+ *
+ *     csi_ingestd --broker mosquitto:1883 --workers 4 --archive /var/lib/csi
+ *     curl -s localhost:9108/metrics
+ *
+ * One thread reads the broker connection and only parses MQTT framing,
+ * so decoding scales with --workers. Several daemons can split the load
+ * with --share GROUP (MQTT v5 shared subscriptions). The broker connection
+ * is retried with the firmware's jittered backoff (mqtt_backoff.c).
+ */
+
+#include "csi_archive.h"
+#include "csi_ingest.h"
+#include "mqtt5_codec.h"
+#include "mqtt_backoff.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_PORT            1883
+#define DEFAULT_METRICS_PORT    9108
+#define MAX_TOPICS              16
+#define RX_BUFFER_INITIAL       (256 * 1024)
+#define RX_BUFFER_MAX           (64 * 1024 * 1024)
+#define SOCKET_RCVBUF           (4 * 1024 * 1024)
+#define IO_TIMEOUT_S            10
+#define POLL_MS                 200
+#define METRICS_BUFFER          8192
+
+typedef enum {
+    LOG_ERROR = 0,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG,
+} log_level_t;
+
+static struct {
+    char host[256];
+    char port[8];
+    const char *client_id;
+    const char *topics[MAX_TOPICS];
+    int topic_count;
+    const char *share;
+    int qos;
+    uint16_t keepalive;
+    int metrics_port;
+    int stats_interval_s;
+    log_level_t log_level;
+    csi_ingest_config_t ingest;
+    csi_archive_store_config_t archive;
+} s_cfg;
+
+/**
+ * @brief Broker connection counters, read by the metrics thread
+ */
+static struct {
+    atomic_bool connected;
+    atomic_uint_fast64_t connects;
+    atomic_uint_fast64_t connect_failures;
+    atomic_uint_fast64_t disconnects;
+    atomic_uint_fast64_t publishes;
+    atomic_uint_fast64_t ignored;       ///< PUBLISH on a topic that is not a CSI topic
+    atomic_uint_fast64_t rx_bytes;
+} s_mqtt;
+
+static csi_ingest_t *s_ingest;
+static csi_archive_store_t *s_archive;      // NULL without --archive
+static atomic_int s_stop;      // Set from the signal handler; lock-free, so async-signal-safe
+static int64_t s_start_ms;
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void log_msg(log_level_t level, const char *fmt, ...)
+{
+    static const char *names[] = { "E", "W", "I", "D" };
+    if (level > s_cfg.log_level) {
+        return;
+    }
+
+    char stamp[32];
+    time_t t = time(NULL);
+    struct tm tm;
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", gmtime_r(&t, &tm));
+
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s %s ", stamp, names[level]);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    s_stop = 1;
+}
+
+// ===== BROKER CONNECTION =====
+
+typedef struct {
+    int fd;
+    uint8_t *rx;
+    size_t rx_off;              ///< Start of the bytes not yet consumed
+    size_t rx_len;              ///< End of the received bytes
+    size_t rx_cap;
+    int64_t last_tx_ms;
+    int64_t last_rx_ms;
+    uint16_t keepalive;
+    uint32_t retry_hint_ms;     ///< From a CONNACK or DISCONNECT reason
+} session_t;
+
+static bool send_all(session_t *s, const uint8_t *data, size_t len)
+{
+    while (len) {
+        ssize_t n = send(s->fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_msg(LOG_WARN, "send failed: %s", strerror(errno));
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    s->last_tx_ms = now_ms();
+    return true;
+}
+
+static int open_socket(void)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    int err = getaddrinfo(s_cfg.host, s_cfg.port, &hints, &res);
+    if (err) {
+        log_msg(LOG_WARN, "Cannot resolve %s: %s", s_cfg.host, gai_strerror(err));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        // Bounds connect() and blocking sends; receives go through poll()
+        struct timeval timeout = { .tv_sec = IO_TIMEOUT_S };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int rcvbuf = SOCKET_RCVBUF;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        log_msg(LOG_WARN, "Cannot connect to %s:%s: %s", s_cfg.host, s_cfg.port, strerror(errno));
+    }
+    return fd;
+}
+
+/**
+ * @brief Wait for the next complete packet
+ * @return 1 with a packet at s->rx + s->rx_off, 0 on timeout, -1 on error
+ */
+static int read_packet(session_t *s, int timeout_ms, uint8_t *type, size_t *header_len, size_t *total)
+{
+    while (true) {
+        *total = 0;
+        int found = mqtt5_next_packet(s->rx + s->rx_off, s->rx_len - s->rx_off, type, header_len, total);
+        if (found < 0) {
+            log_msg(LOG_WARN, "Malformed packet from broker");
+            return -1;
+        }
+        if (found) {
+            return 1;
+        }
+
+        // Move the partial packet to the front before reading more
+        if (s->rx_off) {
+            memmove(s->rx, s->rx + s->rx_off, s->rx_len - s->rx_off);
+            s->rx_len -= s->rx_off;
+            s->rx_off = 0;
+        }
+        if (*total > s->rx_cap) {
+            if (*total > RX_BUFFER_MAX) {
+                log_msg(LOG_WARN, "Packet of %zu bytes exceeds the receive limit", *total);
+                return -1;
+            }
+            size_t cap = s->rx_cap;
+            while (cap < *total) {
+                cap *= 2;
+            }
+            uint8_t *rx = realloc(s->rx, cap);
+            if (!rx) {
+                return -1;
+            }
+            s->rx = rx;
+            s->rx_cap = cap;
+        }
+
+        struct pollfd pfd = { .fd = s->fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            return -1;
+        }
+        if (ready <= 0) {
+            return 0;
+        }
+        ssize_t n = recv(s->fd, s->rx + s->rx_len, s->rx_cap - s->rx_len, 0);
+        if (n <= 0) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            log_msg(LOG_WARN, "Broker closed the connection");
+            return -1;
+        }
+        s->rx_len += n;
+        s->last_rx_ms = now_ms();
+        atomic_fetch_add_explicit(&s_mqtt.rx_bytes, n, memory_order_relaxed);
+    }
+}
+
+static void consume_packet(session_t *s, size_t total)
+{
+    s->rx_off += total;
+}
+
+static bool session_connect(session_t *s)
+{
+    uint8_t buf[512];
+    size_t len = mqtt5_encode_connect(buf, s_cfg.client_id, s_cfg.keepalive);
+    if (!send_all(s, buf, len)) {
+        return false;
+    }
+
+    uint8_t type;
+    size_t header_len, total;
+    if (read_packet(s, IO_TIMEOUT_S * 1000, &type, &header_len, &total) != 1 ||
+        (type & 0xF0) != MQTT5_CONNACK) {
+        log_msg(LOG_WARN, "No CONNACK from broker");
+        return false;
+    }
+    mqtt5_connack_t connack = {0};
+    bool ok = mqtt5_parse_connack(s->rx + s->rx_off + header_len, total - header_len, &connack);
+    consume_packet(s, total);
+    if (!ok) {
+        log_msg(LOG_WARN, "Malformed CONNACK from broker");
+        return false;
+    }
+    if (connack.reason != 0) {
+        log_msg(LOG_WARN, "Broker refused the connection (reason 0x%02x)", connack.reason);
+        s->retry_hint_ms = mqtt_backoff_hint_for_reason(connack.reason, true);
+        return false;
+    }
+    s->keepalive = connack.server_keepalive ? connack.server_keepalive : s_cfg.keepalive;
+
+    for (int i = 0; i < s_cfg.topic_count; i++) {
+        char filter[320];
+        if (s_cfg.share) {
+            snprintf(filter, sizeof(filter), "$share/%s/%s", s_cfg.share, s_cfg.topics[i]);
+        } else {
+            snprintf(filter, sizeof(filter), "%s", s_cfg.topics[i]);
+        }
+        len = mqtt5_encode_subscribe(buf, (uint16_t)(i + 1), filter, s_cfg.qos);
+        if (!send_all(s, buf, len)) {
+            return false;
+        }
+        log_msg(LOG_INFO, "Subscribing to %s", filter);
+    }
+    return true;
+}
+
+static void handle_publish(session_t *s, uint8_t type, const uint8_t *body, size_t len)
+{
+    mqtt5_incoming_t msg;
+    if (!mqtt5_parse_publish(type, body, len, &msg)) {
+        log_msg(LOG_DEBUG, "Malformed PUBLISH");
+        return;
+    }
+    atomic_fetch_add_explicit(&s_mqtt.publishes, 1, memory_order_relaxed);
+
+    size_t node_len;
+    csi_ingest_format_t format;
+    if (csi_ingest_parse_topic(msg.topic, msg.topic_len, &node_len, &format)) {
+        csi_ingest_submit(s_ingest, msg.topic, node_len, format, msg.payload, msg.payload_len);
+    } else {
+        atomic_fetch_add_explicit(&s_mqtt.ignored, 1, memory_order_relaxed);
+    }
+
+    if (msg.qos == 1) {
+        uint8_t ack[4];
+        send_all(s, ack, mqtt5_encode_puback(ack, msg.packet_id));
+    }
+}
+
+/**
+ * @brief Read and dispatch packets until the connection fails or the daemon stops
+ */
+static void session_run(session_t *s)
+{
+    while (!s_stop) {
+        int64_t now = now_ms();
+        int64_t keepalive_ms = (int64_t)s->keepalive * 1000;
+        if (keepalive_ms) {
+            if (now - s->last_rx_ms > keepalive_ms * 3 / 2) {
+                log_msg(LOG_WARN, "Broker silent for %d s", (int)((now - s->last_rx_ms) / 1000));
+                return;
+            }
+            if (now - s->last_tx_ms >= keepalive_ms) {
+                uint8_t ping[2];
+                if (!send_all(s, ping, mqtt5_encode_pingreq(ping))) {
+                    return;
+                }
+            }
+        }
+
+        uint8_t type;
+        size_t header_len, total;
+        int got = read_packet(s, POLL_MS, &type, &header_len, &total);
+        if (got < 0) {
+            return;
+        }
+        if (got == 0) {
+            continue;
+        }
+
+        const uint8_t *body = s->rx + s->rx_off + header_len;
+        size_t body_len = total - header_len;
+        switch (type & 0xF0) {
+        case MQTT5_PUBLISH:
+            handle_publish(s, type, body, body_len);
+            break;
+        case MQTT5_SUBACK & 0xF0:
+            // Reason codes follow the packet id and properties; any >= 0x80 is a refusal
+            if (body_len >= 3) {
+                uint32_t props = body[2];
+                size_t offset = 3 + (props < 0x80 ? props : 0);
+                uint16_t id = mqtt5_ack_packet_id(body, body_len);
+                if (offset < body_len && body[offset] >= 0x80) {
+                    log_msg(LOG_ERROR, "Subscription %u refused (reason 0x%02x)", id, body[offset]);
+                }
+            }
+            break;
+        case MQTT5_DISCONNECT: {
+            uint8_t reason = mqtt5_disconnect_reason(body, body_len);
+            log_msg(LOG_WARN, "Broker disconnected (reason 0x%02x)", reason);
+            s->retry_hint_ms = mqtt_backoff_hint_for_reason(reason, true);
+            consume_packet(s, total);
+            return;
+        }
+        default:
+            break;
+        }
+        consume_packet(s, total);
+    }
+
+    uint8_t disconnect[2];
+    send_all(s, disconnect, mqtt5_encode_disconnect(disconnect));
+}
+
+static void sleep_interruptible(uint32_t ms)
+{
+    int64_t until = now_ms() + ms;
+    while (!s_stop && now_ms() < until) {
+        struct timespec ts = { 0, 50 * 1000000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void run_broker_loop(void)
+{
+    uint8_t mac[6] = {0};
+    uint32_t id_hash = 2166136261u;
+    for (const char *c = s_cfg.client_id; *c; c++) {
+        id_hash = (id_hash ^ (uint8_t)*c) * 16777619u;
+    }
+    memcpy(mac + 2, &id_hash, sizeof(id_hash));
+
+    mqtt_backoff_t backoff;
+    mqtt_backoff_init(&backoff, MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_CAP_MS, mac, id_hash ^ (uint32_t)getpid());
+
+    session_t s = { .fd = -1, .rx_cap = RX_BUFFER_INITIAL };
+    s.rx = malloc(s.rx_cap);
+    if (!s.rx) {
+        log_msg(LOG_ERROR, "Out of memory");
+        return;
+    }
+
+    while (!s_stop) {
+        s.rx_off = s.rx_len = 0;
+        s.retry_hint_ms = 0;
+        s.fd = open_socket();
+        int64_t connected_at = now_ms();
+        s.last_rx_ms = s.last_tx_ms = connected_at;
+
+        if (s.fd >= 0 && session_connect(&s)) {
+            log_msg(LOG_INFO, "Connected to %s:%s as %s", s_cfg.host, s_cfg.port, s_cfg.client_id);
+            atomic_store(&s_mqtt.connected, true);
+            atomic_fetch_add(&s_mqtt.connects, 1);
+            session_run(&s);
+            atomic_store(&s_mqtt.connected, false);
+            if (!s_stop) {
+                atomic_fetch_add(&s_mqtt.disconnects, 1);
+            }
+        } else {
+            atomic_fetch_add(&s_mqtt.connect_failures, 1);
+        }
+        if (s.fd >= 0) {
+            close(s.fd);
+            s.fd = -1;
+        }
+        if (s_stop) {
+            break;
+        }
+
+        if (now_ms() - connected_at >= MQTT_BACKOFF_STABLE_MS) {
+            mqtt_backoff_reset(&backoff);
+        }
+        if (s.retry_hint_ms) {
+            mqtt_backoff_set_hint(&backoff, s.retry_hint_ms);
+        }
+        uint32_t delay = mqtt_backoff_next(&backoff);
+        log_msg(LOG_INFO, "Reconnecting in %u ms", delay);
+        sleep_interruptible(delay);
+    }
+    free(s.rx);
+}
+
+// ===== METRICS =====
+
+typedef struct {
+    char *p;
+    char *end;
+} text_t;
+
+static void metric(text_t *t, const char *name, const char *type, const char *help, uint64_t value)
+{
+    int n = snprintf(t->p, t->end - t->p, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n",
+                     name, help, name, type, name, (unsigned long long)value);
+    if (n > 0 && n < t->end - t->p) {
+        t->p += n;
+    }
+}
+
+static size_t format_metrics(char *buf, size_t size)
+{
+    csi_ingest_stats_t st;
+    csi_ingest_get_stats(s_ingest, &st);
+    text_t t = { buf, buf + size };
+
+    metric(&t, "csi_ingest_mqtt_connected", "gauge", "1 while subscribed to the broker",
+           atomic_load(&s_mqtt.connected));
+    metric(&t, "csi_ingest_mqtt_connects_total", "counter", "Successful broker connections",
+           atomic_load(&s_mqtt.connects));
+    metric(&t, "csi_ingest_mqtt_connect_failures_total", "counter", "Failed connection attempts",
+           atomic_load(&s_mqtt.connect_failures));
+    metric(&t, "csi_ingest_mqtt_disconnects_total", "counter", "Connections lost",
+           atomic_load(&s_mqtt.disconnects));
+    metric(&t, "csi_ingest_mqtt_publishes_total", "counter", "PUBLISH packets received",
+           atomic_load(&s_mqtt.publishes));
+    metric(&t, "csi_ingest_mqtt_ignored_total", "counter", "PUBLISH packets on topics that carry no CSI",
+           atomic_load(&s_mqtt.ignored));
+    metric(&t, "csi_ingest_mqtt_received_bytes_total", "counter", "Bytes read from the broker",
+           atomic_load(&s_mqtt.rx_bytes));
+
+    metric(&t, "csi_ingest_messages_total", "counter", "CSI messages queued for decoding", st.messages);
+    metric(&t, "csi_ingest_message_bytes_total", "counter", "Payload bytes queued for decoding", st.bytes);
+    metric(&t, "csi_ingest_queue_full_total", "counter", "Messages dropped because a worker queue was full",
+           st.queue_full);
+    metric(&t, "csi_ingest_invalid_total", "counter", "Messages with an empty payload or an overlong node name",
+           st.invalid);
+    metric(&t, "csi_ingest_frames_total", "counter", "Frames decoded into columns", st.frames);
+    metric(&t, "csi_ingest_frames_json_total", "counter", "Frames decoded from JSON", st.frames_json);
+    metric(&t, "csi_ingest_frames_binary_total", "counter", "Frames decoded from binary frames",
+           st.frames_binary);
+    metric(&t, "csi_ingest_decode_errors_total", "counter", "Messages that did not decode", st.decode_errors);
+    metric(&t, "csi_ingest_node_limit_total", "counter", "Messages dropped because the node limit was reached",
+           st.node_limit);
+    metric(&t, "csi_ingest_sequence_gap_frames_total", "counter", "Frames missing from node sequences",
+           st.sequence_gaps);
+    metric(&t, "csi_ingest_sequence_resets_total", "counter", "Node sequences that restarted",
+           st.sequence_resets);
+    metric(&t, "csi_ingest_batches_total", "counter", "Column batches sealed", st.batches);
+    metric(&t, "csi_ingest_batches_partial_total", "counter", "Batches sealed before they were full",
+           st.batches_partial);
+    metric(&t, "csi_ingest_nodes", "gauge", "Nodes with columns", st.nodes);
+    metric(&t, "csi_ingest_nodes_evicted_total", "counter", "Node columns released for idleness",
+           st.nodes_evicted);
+    metric(&t, "csi_ingest_queued_bytes", "gauge", "Bytes waiting in the worker queues", st.queued_bytes);
+    metric(&t, "csi_ingest_queue_peak_bytes", "gauge", "Highest fill of a worker queue", st.queued_bytes_peak);
+    metric(&t, "csi_ingest_workers", "gauge", "Decoder threads", s_cfg.ingest.workers);
+    if (s_archive) {
+        csi_archive_store_stats_t archive;
+        csi_archive_store_get_stats(s_archive, &archive);
+        metric(&t, "csi_ingest_archive_frames_total", "counter", "Frames written to the archive", archive.rows);
+        metric(&t, "csi_ingest_archive_segments_total", "counter", "Archive segments created", archive.segments);
+        metric(&t, "csi_ingest_archive_write_errors_total", "counter", "Frames lost to archive write errors",
+               archive.write_errors);
+        metric(&t, "csi_ingest_archive_open_segments", "gauge", "Archive segments open for writing",
+               archive.open_segments);
+    }
+    metric(&t, "csi_ingest_uptime_seconds", "gauge", "Time since start", (now_ms() - s_start_ms) / 1000);
+    return t.p - buf;
+}
+
+static void serve_metrics(int client)
+{
+    char request[1024];
+    ssize_t n = recv(client, request, sizeof(request) - 1, 0);
+    if (n <= 0) {
+        return;
+    }
+    request[n] = '\0';
+
+    char body[METRICS_BUFFER];
+    char header[256];
+    size_t body_len = 0;
+    const char *status = "404 Not Found";
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        status = "200 OK";
+        body_len = format_metrics(body, sizeof(body));
+    }
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, body_len);
+    send(client, header, header_len, MSG_NOSIGNAL);
+    send(client, body, body_len, MSG_NOSIGNAL);
+}
+
+static void *metrics_main(void *arg)
+{
+    int fd = *(int *)arg;
+    while (!s_stop) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, POLL_MS) <= 0) {
+            continue;
+        }
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        struct timeval timeout = { .tv_sec = 2 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve_metrics(client);
+        close(client);
+    }
+    close(fd);
+    return NULL;
+}
+
+static int open_metrics_listener(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        log_msg(LOG_ERROR, "Cannot listen on metrics port %d: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void *stats_main(void *arg)
+{
+    (void)arg;
+    csi_ingest_stats_t prev = {0};
+    int64_t prev_ms = now_ms();
+
+    while (!s_stop) {
+        sleep_interruptible(s_cfg.stats_interval_s * 1000);
+        if (s_stop) {
+            break;
+        }
+        csi_ingest_stats_t st;
+        csi_ingest_get_stats(s_ingest, &st);
+        int64_t now = now_ms();
+        double seconds = (now - prev_ms) / 1000.0;
+
+        log_msg(LOG_INFO, "%.0f frames/s, %.1f MB/s, %u nodes, %llu decode errors, %llu queue drops, "
+                "%llu gap frames, queue peak %zu kB",
+                (st.frames - prev.frames) / seconds, (st.bytes - prev.bytes) / seconds / 1e6, st.nodes,
+                (unsigned long long)st.decode_errors, (unsigned long long)st.queue_full,
+                (unsigned long long)st.sequence_gaps, st.queued_bytes_peak / 1024);
+        prev = st;
+        prev_ms = now;
+    }
+    return NULL;
+}
+
+// ===== OPTIONS =====
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --broker HOST[:PORT]     MQTT broker (default $MQTT_BROKER or 127.0.0.1:%d)\n"
+            "  --client-id ID           MQTT client id (default csi-ingestd-<host>-<pid>)\n"
+            "  --topic FILTER           subscription, repeatable (default +/" CSI_TOPIC_JSON
+            " and +/" CSI_TOPIC_FRAME ")\n"
+            "  --share GROUP            subscribe as part of shared subscription GROUP\n"
+            "  --qos 0|1                subscription QoS (default 0)\n"
+            "  --keepalive S            MQTT keepalive (default 60)\n"
+            "  --workers N              decoder threads (default one per CPU)\n"
+            "  --queue-mb N             queue per worker (default 8)\n"
+            "  --batch N                frames per column batch (default 64)\n"
+            "  --flush-ms N             seal partial batches after N ms (default 1000)\n"
+            "  --max-nodes N            nodes with columns at once (default 4096)\n"
+            "  --archive DIR            write the batches to a CSI archive in DIR\n"
+            "  --archive-partition S    seconds covered by an archive segment (default 3600)\n"
+            "  --metrics-port N         Prometheus endpoint, 0 to disable (default %d)\n"
+            "  --stats-interval S       log counters every S seconds, 0 to disable (default 10)\n"
+            "  --log-level LEVEL        error, warn, info or debug (default $LOG_LEVEL or info)\n",
+            prog, DEFAULT_PORT, DEFAULT_METRICS_PORT);
+}
+
+static bool parse_level(const char *name, log_level_t *level)
+{
+    static const char *names[] = { "error", "warn", "info", "debug" };
+    for (int i = 0; i < 4; i++) {
+        if (strncasecmp(name, names[i], strlen(names[i])) == 0) {
+            *level = (log_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_broker(const char *arg)
+{
+    const char *colon = strrchr(arg, ':');
+    size_t host_len = colon ? (size_t)(colon - arg) : strlen(arg);
+    if (host_len == 0 || host_len >= sizeof(s_cfg.host)) {
+        return false;
+    }
+    memcpy(s_cfg.host, arg, host_len);
+    s_cfg.host[host_len] = '\0';
+    int port = colon ? atoi(colon + 1) : DEFAULT_PORT;
+    if (port <= 0 || port > 65535) {
+        return false;
+    }
+    snprintf(s_cfg.port, sizeof(s_cfg.port), "%d", port);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    csi_ingest_config_t ingest = CSI_INGEST_CONFIG_DEFAULT();
+    csi_archive_store_config_t archive = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    s_cfg.ingest = ingest;
+    s_cfg.archive = archive;
+    s_cfg.keepalive = 60;
+    s_cfg.metrics_port = DEFAULT_METRICS_PORT;
+    s_cfg.stats_interval_s = 10;
+    s_cfg.log_level = LOG_INFO;
+
+    const char *env_broker = getenv("MQTT_BROKER");
+    const char *env_level = getenv("LOG_LEVEL");
+    if (!parse_broker(env_broker && *env_broker ? env_broker : "127.0.0.1")) {
+        fprintf(stderr, "Invalid MQTT_BROKER\n");
+        return 1;
+    }
+    if (env_level && !parse_level(env_level, &s_cfg.log_level)) {
+        fprintf(stderr, "Invalid LOG_LEVEL\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        bool ok = val != NULL;
+
+        if (strcmp(arg, "--broker") == 0 && val) {
+            ok = parse_broker(val);
+        } else if (strcmp(arg, "--client-id") == 0 && val) {
+            s_cfg.client_id = val;
+        } else if (strcmp(arg, "--topic") == 0 && val) {
+            ok = s_cfg.topic_count < MAX_TOPICS && strlen(val) < 256;
+            if (ok) {
+                s_cfg.topics[s_cfg.topic_count++] = val;
+            }
+        } else if (strcmp(arg, "--share") == 0 && val) {
+            s_cfg.share = val;
+            ok = strlen(val) < 32 && !strpbrk(val, "/+#");
+        } else if (strcmp(arg, "--qos") == 0 && val) {
+            s_cfg.qos = atoi(val);
+            ok = s_cfg.qos == 0 || s_cfg.qos == 1;
+        } else if (strcmp(arg, "--keepalive") == 0 && val) {
+            int keepalive = atoi(val);
+            ok = keepalive >= 0 && keepalive <= 65535;
+            s_cfg.keepalive = (uint16_t)keepalive;
+        } else if (strcmp(arg, "--workers") == 0 && val) {
+            s_cfg.ingest.workers = atoi(val);
+            ok = s_cfg.ingest.workers > 0 && s_cfg.ingest.workers <= CSI_INGEST_MAX_WORKERS;
+        } else if (strcmp(arg, "--queue-mb") == 0 && val) {
+            int mb = atoi(val);
+            ok = mb > 0 && mb <= 4096;
+            s_cfg.ingest.queue_bytes = (size_t)mb * 1024 * 1024;
+        } else if (strcmp(arg, "--batch") == 0 && val) {
+            int frames = atoi(val);
+            ok = frames > 0 && frames <= 65536;
+            s_cfg.ingest.batch_frames = (uint32_t)frames;
+        } else if (strcmp(arg, "--flush-ms") == 0 && val) {
+            int ms = atoi(val);
+            ok = ms > 0;
+            s_cfg.ingest.flush_ms = (uint32_t)ms;
+        } else if (strcmp(arg, "--max-nodes") == 0 && val) {
+            int nodes = atoi(val);
+            ok = nodes > 0;
+            s_cfg.ingest.max_nodes = (uint32_t)nodes;
+        } else if (strcmp(arg, "--archive") == 0 && val) {
+            s_cfg.archive.dir = val;
+        } else if (strcmp(arg, "--archive-partition") == 0 && val) {
+            long seconds = atol(val);
+            ok = seconds > 0;
+            s_cfg.archive.partition_us = (uint64_t)seconds * 1000000;
+        } else if (strcmp(arg, "--metrics-port") == 0 && val) {
+            s_cfg.metrics_port = atoi(val);
+            ok = s_cfg.metrics_port >= 0 && s_cfg.metrics_port <= 65535;
+        } else if (strcmp(arg, "--stats-interval") == 0 && val) {
+            s_cfg.stats_interval_s = atoi(val);
+            ok = s_cfg.stats_interval_s >= 0;
+        } else if (strcmp(arg, "--log-level") == 0 && val) {
+            ok = parse_level(val, &s_cfg.log_level);
+        } else {
+            usage(argv[0]);
+            return strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid value for %s\n", arg);
+            return 1;
+        }
+        i++;
+    }
+
+    if (s_cfg.topic_count == 0) {
+        s_cfg.topics[s_cfg.topic_count++] = "+/" CSI_TOPIC_JSON;
+        s_cfg.topics[s_cfg.topic_count++] = "+/" CSI_TOPIC_FRAME;
+    }
+    char client_id[128];
+    if (!s_cfg.client_id) {
+        char host[64] = "host";
+        gethostname(host, sizeof(host) - 1);
+        snprintf(client_id, sizeof(client_id), "csi-ingestd-%s-%d", host, (int)getpid());
+        s_cfg.client_id = client_id;
+    }
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    s_start_ms = now_ms();
+
+    if (s_cfg.ingest.workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        s_cfg.ingest.workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (s_cfg.archive.dir) {
+        s_archive = csi_archive_store_open(&s_cfg.archive);
+        if (!s_archive) {
+            log_msg(LOG_ERROR, "Cannot open archive %s: %s", s_cfg.archive.dir, strerror(errno));
+            return 1;
+        }
+        s_cfg.ingest.sink = csi_archive_store_sink;
+        s_cfg.ingest.sink_ctx = s_archive;
+        log_msg(LOG_INFO, "Archiving to %s, %llu s per segment", s_cfg.archive.dir,
+                (unsigned long long)(s_cfg.archive.partition_us / 1000000));
+    }
+    s_ingest = csi_ingest_create(&s_cfg.ingest);
+    if (!s_ingest) {
+        log_msg(LOG_ERROR, "Cannot start the ingest workers");
+        if (s_archive) {
+            csi_archive_store_close(s_archive);
+        }
+        return 1;
+    }
+    size_t column_mb = (size_t)s_cfg.ingest.max_nodes * s_cfg.ingest.batch_frames * CSI_INGEST_FRAME_BYTES >> 20;
+    log_msg(LOG_INFO, "%d workers, %zu MB of queues, up to %zu MB of columns for %u nodes",
+            s_cfg.ingest.workers, s_cfg.ingest.workers * s_cfg.ingest.queue_bytes >> 20, column_mb,
+            s_cfg.ingest.max_nodes);
+
+    pthread_t metrics_thread, stats_thread;
+    int metrics_fd = s_cfg.metrics_port ? open_metrics_listener(s_cfg.metrics_port) : -1;
+    if (metrics_fd >= 0) {
+        pthread_create(&metrics_thread, NULL, metrics_main, &metrics_fd);
+        log_msg(LOG_INFO, "Metrics on port %d", s_cfg.metrics_port);
+    }
+    if (s_cfg.stats_interval_s) {
+        pthread_create(&stats_thread, NULL, stats_main, NULL);
+    }
+
+    run_broker_loop();
+
+    log_msg(LOG_INFO, "Stopping");
+    if (metrics_fd >= 0) {
+        pthread_join(metrics_thread, NULL);
+    }
+    if (s_cfg.stats_interval_s) {
+        pthread_join(stats_thread, NULL);
+    }
+
+    // Seals the last batches into the archive before its segments are completed
+    csi_ingest_destroy(s_ingest);
+    if (s_archive && !csi_archive_store_close(s_archive)) {
+        log_msg(LOG_ERROR, "Archive segments could not be completed");
+        return 1;
+    }
+    return 0;
+}
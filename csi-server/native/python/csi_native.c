@@ -0,0 +1,747 @@
+/**
+ * @file csi_native.c
+ * @brief Python bindings: binary CSI frames and archive segments as arrays
+ *
+ * Every column is a Column object that exports its memory through the
+ * buffer protocol with a struct format, shape and strides, so
+ * numpy.asarray(column) and memoryview(column) wrap it without a copy:
+ *
+ *     import numpy as np, csi_native
+ *     seg = csi_native.Segment("archive/node-1/0.csia")
+ *     ts = np.asarray(seg.column("timestamp"))          # (rows,) uint64
+ *     amp = np.asarray(seg.scaled("amplitude"))         # (rows, 64) float32
+ *     frames = csi_native.decode_frames(open("capture.bin", "rb").read())
+ *     iq = np.asarray(frames["iq"])                     # (frames, 128) int8
+ *
+ * A column of one row group that the archive stored raw is a view into the
+ * segment's mapping and keeps the segment open. Anything else (a whole
+ * segment, an encoded chunk, decoded frames) is filled in native memory
+ * one chunk or row at a time, never element by element through Python.
+ * Decoding, converting and copying run with the GIL released.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "csi_archive.h"
+#include "csi_ingest.h"
+#include "csi_ingest_decode.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Element type and row width of each column
+ */
+typedef struct {
+    const char *format;                 ///< struct module format of one element, native order
+    Py_ssize_t itemsize;
+    Py_ssize_t width;                   ///< Elements per row; 1 for a scalar column
+} column_type_t;
+
+static const column_type_t s_types[CSI_ARCHIVE_COLUMNS] = {
+    [CSI_ARCHIVE_COL_TIMESTAMP] = { "Q", 8, 1 },
+    [CSI_ARCHIVE_COL_SEQUENCE] = { "I", 4, 1 },
+    [CSI_ARCHIVE_COL_RSSI] = { "b", 1, 1 },
+    [CSI_ARCHIVE_COL_CHANNEL] = { "B", 1, 1 },
+    [CSI_ARCHIVE_COL_SECONDARY_CHANNEL] = { "B", 1, 1 },
+    [CSI_ARCHIVE_COL_SUBCARRIER_COUNT] = { "B", 1, 1 },
+    [CSI_ARCHIVE_COL_FLAGS] = { "B", 1, 1 },
+    [CSI_ARCHIVE_COL_MAC] = { "B", 1, 6 },
+    [CSI_ARCHIVE_COL_IQ] = { "b", 1, CSI_INGEST_IQ_STRIDE },
+    [CSI_ARCHIVE_COL_AMPLITUDE] = { "h", 2, CSI_MAX_SUBCARRIERS },
+    [CSI_ARCHIVE_COL_PHASE] = { "h", 2, CSI_MAX_SUBCARRIERS },
+};
+
+static const column_type_t s_float_row = { "f", 4, CSI_MAX_SUBCARRIERS };
+
+/* ===== Column ===== */
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner;                    ///< Keeps data alive; NULL if data is ours to free
+    void *data;
+    const char *format;
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    int readonly;
+} ColumnObject;
+
+static PyTypeObject ColumnType;
+
+/**
+ * @brief Column of rows x type->width elements
+ * @param data Memory, or NULL to allocate it
+ * @param owner Object data belongs to, or NULL
+ */
+static ColumnObject *column_new(const column_type_t *type, Py_ssize_t rows, void *data, PyObject *owner)
+{
+    ColumnObject *col = PyObject_New(ColumnObject, &ColumnType);
+    if (!col) {
+        return NULL;
+    }
+    col->owner = NULL;
+    col->data = data;
+    col->format = type->format;
+    col->itemsize = type->itemsize;
+    col->ndim = type->width > 1 ? 2 : 1;
+    col->shape[0] = rows;
+    col->shape[1] = type->width;
+    col->strides[0] = type->width * type->itemsize;
+    col->strides[1] = type->itemsize;
+    col->readonly = owner != NULL;
+    if (owner) {
+        Py_INCREF(owner);
+        col->owner = owner;
+    } else if (!data) {
+        // One byte at least, so an empty column still has an address
+        col->data = PyMem_RawMalloc(rows * col->strides[0] + 1);
+        if (!col->data) {
+            Py_DECREF(col);
+            PyErr_NoMemory();
+            return NULL;
+        }
+    }
+    return col;
+}
+
+static void column_dealloc(ColumnObject *col)
+{
+    if (col->owner) {
+        Py_DECREF(col->owner);
+    } else {
+        PyMem_RawFree(col->data);
+    }
+    PyObject_Free(col);
+}
+
+static int column_getbuffer(ColumnObject *col, Py_buffer *view, int flags)
+{
+    if ((flags & PyBUF_WRITABLE) && col->readonly) {
+        PyErr_SetString(PyExc_BufferError, "column is a read-only view of the archive");
+        return -1;
+    }
+    view->obj = (PyObject *)col;
+    Py_INCREF(col);
+    view->buf = col->data;
+    view->len = col->shape[0] * col->strides[0];
+    view->readonly = col->readonly;
+    view->itemsize = col->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char *)col->format : NULL;
+    view->ndim = col->ndim;
+    view->shape = (flags & PyBUF_ND) ? col->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? col->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static Py_ssize_t column_len(ColumnObject *col)
+{
+    return col->shape[0];
+}
+
+static PyObject *column_repr(ColumnObject *col)
+{
+    if (col->ndim == 1) {
+        return PyUnicode_FromFormat("<csi_native.Column %s (%zd,)>", col->format, col->shape[0]);
+    }
+    return PyUnicode_FromFormat("<csi_native.Column %s (%zd, %zd)>", col->format, col->shape[0], col->shape[1]);
+}
+
+static PyBufferProcs column_as_buffer = {
+    .bf_getbuffer = (getbufferproc)column_getbuffer,
+};
+
+static PySequenceMethods column_as_sequence = {
+    .sq_length = (lenfunc)column_len,
+};
+
+static PyTypeObject ColumnType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "csi_native.Column",
+    .tp_doc = "Rows of one column, exported through the buffer protocol",
+    .tp_basicsize = sizeof(ColumnObject),
+    .tp_dealloc = (destructor)column_dealloc,
+    .tp_repr = (reprfunc)column_repr,
+    .tp_as_buffer = &column_as_buffer,
+    .tp_as_sequence = &column_as_sequence,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+};
+
+/**
+ * @brief Column index of a name
+ * @return -1 with an exception set if there is none
+ */
+static int column_index(const char *name)
+{
+    for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+        if (strcmp(name, csi_archive_column_name(c)) == 0) {
+            return c;
+        }
+    }
+    PyErr_Format(PyExc_KeyError, "no column named '%s'", name);
+    return -1;
+}
+
+/* ===== decode_frames ===== */
+
+/**
+ * @brief Length of the binary frame at p, or 0 if it is not one
+ */
+static size_t frame_length(const uint8_t *p, size_t left)
+{
+    csi_frame_header_t header;
+    if (left < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, p, sizeof(header));
+    size_t len = sizeof(header) + header.raw_len;
+    return header.magic == CSI_FRAME_MAGIC && len <= left ? len : 0;
+}
+
+PyDoc_STRVAR(decode_frames_doc,
+             "decode_frames(data) -> dict of Column\n\n"
+             "Decode back-to-back binary CSI frames (csi_frame_header_t and raw CSI, as\n"
+             "published to <node>/csi_frame) from any bytes-like object. Columns are named\n"
+             "as in an archive; amplitude and phase are float32 rows of CSI_MAX_SUBCARRIERS.");
+
+static PyObject *decode_frames(PyObject *self, PyObject *arg)
+{
+    (void)self;
+    Py_buffer in;
+    if (PyObject_GetBuffer(arg, &in, PyBUF_SIMPLE) != 0) {
+        return NULL;
+    }
+    const uint8_t *data = in.buf;
+    const size_t size = (size_t)in.len;
+
+    // Count first, so every column is allocated once
+    Py_ssize_t frames = 0;
+    size_t offset = 0, len = 0;
+    Py_BEGIN_ALLOW_THREADS
+    while (offset < size && (len = frame_length(data + offset, size - offset)) > 0) {
+        offset += len;
+        frames++;
+    }
+    Py_END_ALLOW_THREADS
+    if (offset != size) {
+        PyBuffer_Release(&in);
+        return PyErr_Format(PyExc_ValueError, "no CSI frame at offset %zu", offset);
+    }
+
+    PyObject *result = PyDict_New();
+    ColumnObject *col[CSI_ARCHIVE_COLUMNS] = { 0 };
+    for (int c = 0; result && c < CSI_ARCHIVE_COLUMNS; c++) {
+        const column_type_t *type =
+            c == CSI_ARCHIVE_COL_AMPLITUDE || c == CSI_ARCHIVE_COL_PHASE ? &s_float_row : &s_types[c];
+        col[c] = column_new(type, frames, NULL, NULL);
+        if (!col[c] || PyDict_SetItemString(result, csi_archive_column_name(c), (PyObject *)col[c]) != 0) {
+            Py_CLEAR(result);
+        }
+        Py_XDECREF(col[c]);
+    }
+    if (!result) {
+        PyBuffer_Release(&in);
+        return NULL;
+    }
+
+    // The dict holds the columns, so their memory stays put while the GIL is released
+    Py_ssize_t bad = -1;
+    Py_BEGIN_ALLOW_THREADS
+    csi_ingest_decode_init();
+    offset = 0;
+    for (Py_ssize_t i = 0; i < frames; i++) {
+        csi_ingest_meta_t meta;
+        len = frame_length(data + offset, size - offset);
+        if (!csi_ingest_decode_frame(data + offset, len, &meta,
+                                     (int8_t *)col[CSI_ARCHIVE_COL_IQ]->data + i * CSI_INGEST_IQ_STRIDE,
+                                     (float *)col[CSI_ARCHIVE_COL_AMPLITUDE]->data + i * CSI_MAX_SUBCARRIERS,
+                                     (float *)col[CSI_ARCHIVE_COL_PHASE]->data + i * CSI_MAX_SUBCARRIERS)) {
+            bad = i;
+            break;
+        }
+        ((uint64_t *)col[CSI_ARCHIVE_COL_TIMESTAMP]->data)[i] = meta.timestamp;
+        ((uint32_t *)col[CSI_ARCHIVE_COL_SEQUENCE]->data)[i] = meta.sequence;
+        ((int8_t *)col[CSI_ARCHIVE_COL_RSSI]->data)[i] = meta.rssi;
+        ((uint8_t *)col[CSI_ARCHIVE_COL_CHANNEL]->data)[i] = meta.channel;
+        ((uint8_t *)col[CSI_ARCHIVE_COL_SECONDARY_CHANNEL]->data)[i] = meta.secondary_channel;
+        ((uint8_t *)col[CSI_ARCHIVE_COL_SUBCARRIER_COUNT]->data)[i] = meta.subcarrier_count;
+        ((uint8_t *)col[CSI_ARCHIVE_COL_FLAGS]->data)[i] = meta.flags;
+        memcpy((uint8_t *)col[CSI_ARCHIVE_COL_MAC]->data + 6 * i, meta.mac, 6);
+        offset += len;
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&in);
+    if (bad >= 0) {
+        Py_DECREF(result);
+        return PyErr_Format(PyExc_ValueError, "frame %zd at offset %zu does not decode", bad, offset);
+    }
+    return result;
+}
+
+/* ===== Segment ===== */
+
+typedef struct {
+    PyObject_HEAD
+    csi_archive_reader_t *reader;
+} SegmentObject;
+
+static int segment_init(SegmentObject *seg, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "path", NULL };
+    PyObject *path = NULL;
+    // Columns and gathers in other threads point into the mapping until the
+    // Segment is gone, so an open Segment is never re-pointed
+    if (seg->reader) {
+        PyErr_SetString(PyExc_RuntimeError, "segment is already open");
+        return -1;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist, PyUnicode_FSConverter, &path)) {
+        return -1;
+    }
+    csi_archive_reader_t *reader;
+    Py_BEGIN_ALLOW_THREADS
+    reader = csi_archive_reader_open(PyBytes_AS_STRING(path));
+    Py_END_ALLOW_THREADS
+    if (!reader) {
+        PyErr_SetFromErrnoWithFilenameObject(errno == EINVAL ? PyExc_ValueError : PyExc_OSError, path);
+        Py_DECREF(path);
+        return -1;
+    }
+    Py_DECREF(path);
+    seg->reader = reader;
+    return 0;
+}
+
+static void segment_dealloc(SegmentObject *seg)
+{
+    if (seg->reader) {
+        csi_archive_reader_close(seg->reader);
+    }
+    Py_TYPE(seg)->tp_free((PyObject *)seg);
+}
+
+/**
+ * @brief Group argument: None for the whole segment
+ * @return 0, or -1 with an exception set
+ */
+static int parse_group(SegmentObject *seg, PyObject *arg, long *group)
+{
+    if (!arg || arg == Py_None) {
+        *group = -1;
+        return 0;
+    }
+    *group = PyLong_AsLong(arg);
+    if (*group == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    if (*group < 0 || (unsigned long)*group >= csi_archive_reader_info(seg->reader)->groups) {
+        PyErr_Format(PyExc_IndexError, "group %ld out of range", *group);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copy one column of groups [first, last] into out, decoding encoded chunks
+ * @return false if a chunk is corrupt
+ */
+static bool gather(const csi_archive_reader_t *reader, uint32_t first, uint32_t last, int column, uint8_t *out)
+{
+    void *scratch = NULL;
+    size_t scratch_bytes = 0;
+    bool ok = true;
+    for (uint32_t g = first; ok && g <= last; g++) {
+        size_t bytes = csi_archive_reader_column_bytes(reader, g, column);
+        const void *rows = csi_archive_reader_column(reader, g, column, NULL);
+        if (!rows) {
+            if (bytes > scratch_bytes) {
+                free(scratch);
+                scratch = malloc(bytes);
+                scratch_bytes = scratch ? bytes : 0;
+            }
+            rows = scratch ? csi_archive_reader_column(reader, g, column, scratch) : NULL;
+        }
+        if (rows) {
+            memcpy(out, rows, bytes);
+            out += bytes;
+        } else {
+            ok = false;
+        }
+    }
+    free(scratch);
+    return ok;
+}
+
+/**
+ * @brief Rows of a column: a view when one raw group is asked for, else a copy
+ */
+static ColumnObject *read_column(SegmentObject *seg, int column, long group)
+{
+    const csi_archive_info_t *info = csi_archive_reader_info(seg->reader);
+    if (group >= 0) {
+        csi_archive_group_t g;
+        csi_archive_reader_group(seg->reader, (uint32_t)group, &g);
+        void *rows = (void *)csi_archive_reader_column(seg->reader, (uint32_t)group, column, NULL);
+        if (rows) {
+            return column_new(&s_types[column], g.rows, rows, (PyObject *)seg);
+        }
+    }
+    uint32_t first = group >= 0 ? (uint32_t)group : 0;
+    uint32_t last = group >= 0 ? (uint32_t)group : info->groups - 1;
+    Py_ssize_t rows = 0;
+    for (uint32_t g = first; info->groups > 0 && g <= last; g++) {
+        rows += csi_archive_reader_column_bytes(seg->reader, g, column) / csi_archive_column_stride(column);
+    }
+    ColumnObject *col = column_new(&s_types[column], rows, NULL, NULL);
+    if (!col) {
+        return NULL;
+    }
+    bool ok = true;
+    if (info->groups > 0) {
+        Py_BEGIN_ALLOW_THREADS
+        ok = gather(seg->reader, first, last, column, col->data);
+        Py_END_ALLOW_THREADS
+    }
+    if (!ok) {
+        Py_DECREF(col);
+        PyErr_Format(PyExc_ValueError, "column '%s' is corrupt", csi_archive_column_name(column));
+        return NULL;
+    }
+    return col;
+}
+
+PyDoc_STRVAR(segment_column_doc,
+             "column(name, group=None) -> Column\n\n"
+             "Rows of a column, of one row group or of the whole segment. One group whose\n"
+             "chunk is stored raw is returned as a read-only view of the mapped file.");
+
+static PyObject *segment_column(SegmentObject *seg, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "name", "group", NULL };
+    const char *name;
+    PyObject *group_arg = NULL;
+    long group;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist, &name, &group_arg)) {
+        return NULL;
+    }
+    int column = column_index(name);
+    if (column < 0 || parse_group(seg, group_arg, &group) != 0) {
+        return NULL;
+    }
+    return (PyObject *)read_column(seg, column, group);
+}
+
+PyDoc_STRVAR(segment_scaled_doc,
+             "scaled(name, group=None) -> Column\n\n"
+             "Amplitude or phase as float32, with missing values as NaN.");
+
+static PyObject *segment_scaled(SegmentObject *seg, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { "name", "group", NULL };
+    const char *name;
+    PyObject *group_arg = NULL;
+    long group;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist, &name, &group_arg)) {
+        return NULL;
+    }
+    int column = column_index(name);
+    if (column < 0 || parse_group(seg, group_arg, &group) != 0) {
+        return NULL;
+    }
+    if (column != CSI_ARCHIVE_COL_AMPLITUDE && column != CSI_ARCHIVE_COL_PHASE) {
+        return PyErr_Format(PyExc_ValueError, "column '%s' is not fixed point", name);
+    }
+    ColumnObject *fixed = read_column(seg, column, group);
+    if (!fixed) {
+        return NULL;
+    }
+    ColumnObject *out = column_new(&s_float_row, fixed->shape[0], NULL, NULL);
+    if (out) {
+        float scale = column == CSI_ARCHIVE_COL_AMPLITUDE ? CSI_ARCHIVE_AMPLITUDE_SCALE : CSI_ARCHIVE_PHASE_SCALE;
+        size_t n = (size_t)fixed->shape[0] * CSI_MAX_SUBCARRIERS;
+        Py_BEGIN_ALLOW_THREADS
+        csi_archive_to_float(fixed->data, n, scale, out->data);
+        Py_END_ALLOW_THREADS
+    }
+    Py_DECREF(fixed);
+    return (PyObject *)out;
+}
+
+PyDoc_STRVAR(segment_seek_doc,
+             "seek(timestamp) -> (group, row) or None\n\n"
+             "First frame at or after a time in microseconds.");
+
+static PyObject *segment_seek(SegmentObject *seg, PyObject *arg)
+{
+    unsigned long long timestamp = PyLong_AsUnsignedLongLong(arg);
+    if (timestamp == (unsigned long long)-1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    uint32_t group, row;
+    if (!csi_archive_reader_seek(seg->reader, timestamp, &group, &row)) {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("(II)", group, row);
+}
+
+PyDoc_STRVAR(segment_group_doc, "group(index) -> dict\n\nRows, time range and size of a row group.");
+
+static PyObject *segment_group(SegmentObject *seg, PyObject *arg)
+{
+    long index;
+    if (parse_group(seg, arg, &index) != 0) {
+        return NULL;
+    }
+    if (index < 0) {
+        PyErr_SetString(PyExc_TypeError, "group index required");
+        return NULL;
+    }
+    csi_archive_group_t g;
+    csi_archive_reader_group(seg->reader, (uint32_t)index, &g);
+    return Py_BuildValue("{s:I,s:K,s:K,s:K,s:K}", "rows", g.rows, "first_row", (unsigned long long)g.first_row,
+                         "first_timestamp", (unsigned long long)g.first_timestamp, "last_timestamp",
+                         (unsigned long long)g.last_timestamp, "stored_bytes", (unsigned long long)g.stored_bytes);
+}
+
+static PyObject *segment_get(SegmentObject *seg, void *closure)
+{
+    const csi_archive_info_t *info = csi_archive_reader_info(seg->reader);
+    switch ((intptr_t)closure) {
+    case 0:
+        return PyUnicode_DecodeFSDefault(info->node);
+    case 1:
+        return PyBool_FromLong(info->utc);
+    case 2:
+        return PyBool_FromLong(info->recovered);
+    case 3:
+        return PyLong_FromUnsignedLong(info->groups);
+    case 4:
+        return PyLong_FromUnsignedLongLong(info->rows);
+    case 5:
+        return PyLong_FromUnsignedLongLong(info->first_timestamp);
+    case 6:
+        return PyLong_FromUnsignedLongLong(info->last_timestamp);
+    default:
+        return PyLong_FromUnsignedLongLong(info->file_bytes);
+    }
+}
+
+static PyObject *segment_columns(SegmentObject *seg, void *closure)
+{
+    (void)seg;
+    (void)closure;
+    PyObject *names = PyTuple_New(CSI_ARCHIVE_COLUMNS);
+    for (int c = 0; names && c < CSI_ARCHIVE_COLUMNS; c++) {
+        PyObject *name = PyUnicode_FromString(csi_archive_column_name(c));
+        if (!name) {
+            Py_CLEAR(names);
+            break;
+        }
+        PyTuple_SET_ITEM(names, c, name);
+    }
+    return names;
+}
+
+static Py_ssize_t segment_len(SegmentObject *seg)
+{
+    if (!seg->reader) {
+        PyErr_SetString(PyExc_ValueError, "segment is not open");
+        return -1;
+    }
+    return (Py_ssize_t)csi_archive_reader_info(seg->reader)->rows;
+}
+
+static PyGetSetDef segment_getset[] = {
+    { "node", (getter)segment_get, NULL, "Node name", (void *)0 },
+    { "utc", (getter)segment_get, NULL, "Timestamps are UTC, not uptime", (void *)1 },
+    { "recovered", (getter)segment_get, NULL, "No footer; groups were found by scanning", (void *)2 },
+    { "groups", (getter)segment_get, NULL, "Row groups", (void *)3 },
+    { "rows", (getter)segment_get, NULL, "Frames", (void *)4 },
+    { "first_timestamp", (getter)segment_get, NULL, "Microseconds", (void *)5 },
+    { "last_timestamp", (getter)segment_get, NULL, "Microseconds", (void *)6 },
+    { "file_bytes", (getter)segment_get, NULL, "Segment size", (void *)7 },
+    { "columns", (getter)segment_columns, NULL, "Column names", NULL },
+    { NULL },
+};
+
+static PyMethodDef segment_methods[] = {
+    { "column", (PyCFunction)(void (*)(void))segment_column, METH_VARARGS | METH_KEYWORDS, segment_column_doc },
+    { "scaled", (PyCFunction)(void (*)(void))segment_scaled, METH_VARARGS | METH_KEYWORDS, segment_scaled_doc },
+    { "seek", (PyCFunction)segment_seek, METH_O, segment_seek_doc },
+    { "group", (PyCFunction)segment_group, METH_O, segment_group_doc },
+    { NULL },
+};
+
+static PySequenceMethods segment_as_sequence = {
+    .sq_length = (lenfunc)segment_len,
+};
+
+/**
+ * @brief Methods must not run on a Segment whose __init__ failed
+ */
+static PyObject *segment_getattro(SegmentObject *seg, PyObject *name)
+{
+    if (!seg->reader) {
+        PyErr_SetString(PyExc_ValueError, "segment is not open");
+        return NULL;
+    }
+    return PyObject_GenericGetAttr((PyObject *)seg, name);
+}
+
+static PyTypeObject SegmentType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "csi_native.Segment",
+    .tp_doc = "Segment(path)\n\nA memory-mapped archive segment (.csia).",
+    .tp_basicsize = sizeof(SegmentObject),
+    .tp_dealloc = (destructor)segment_dealloc,
+    .tp_getattro = (getattrofunc)segment_getattro,
+    .tp_as_sequence = &segment_as_sequence,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_methods = segment_methods,
+    .tp_getset = segment_getset,
+    .tp_init = (initproc)segment_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* ===== convert ===== */
+
+PyDoc_STRVAR(convert_doc,
+             "convert(path, out, node=None, format='auto', partition=3600, group_rows=1024,\n"
+             "        compress=True, threads=0) -> dict\n\n"
+             "Convert an ESP32-CSI-Tool CSV or csi_data JSON recording into an archive, as\n"
+             "'csi_archive convert' does: CSV on threads parser threads (0 for one per CPU).\n"
+             "Lines without a topic are archived under node, or the file name without its\n"
+             "extension.");
+
+static PyObject *convert(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    (void)self;
+    static char *kwlist[] = { "path", "out", "node", "format", "partition", "group_rows", "compress", "threads", NULL };
+    PyObject *path = NULL, *out = NULL;
+    const char *node = NULL, *format = "auto";
+    unsigned long long partition = 3600;
+    unsigned int group_rows = 0;
+    int compress = 1, threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|zsKIpi", kwlist, PyUnicode_FSConverter, &path,
+                                     PyUnicode_FSConverter, &out, &node, &format, &partition, &group_rows,
+                                     &compress, &threads)) {
+        Py_XDECREF(path);
+        return NULL;
+    }
+    csi_archive_input_t input;
+    if (strcmp(format, "auto") == 0) {
+        input = CSI_ARCHIVE_INPUT_AUTO;
+    } else if (strcmp(format, "csv") == 0) {
+        input = CSI_ARCHIVE_INPUT_CSV;
+    } else if (strcmp(format, "json") == 0) {
+        input = CSI_ARCHIVE_INPUT_JSON;
+    } else {
+        Py_DECREF(path);
+        Py_DECREF(out);
+        return PyErr_Format(PyExc_ValueError, "unknown format '%s'", format);
+    }
+    if (partition == 0 || threads < 0 || threads > CSI_ARCHIVE_CSV_MAX_WORKERS) {
+        Py_DECREF(path);
+        Py_DECREF(out);
+        PyErr_SetString(PyExc_ValueError, partition == 0 ? "partition must be positive" : "threads out of range");
+        return NULL;
+    }
+
+    // Default node: file name without extension, as the tool does
+    char name[CSI_INGEST_MAX_NODE_LEN + 1];
+    if (!node) {
+        const char *file = PyBytes_AS_STRING(path), *slash = strrchr(file, '/');
+        snprintf(name, sizeof(name), "%s", slash ? slash + 1 : file);
+        char *dot = strrchr(name, '.');
+        if (dot && dot != name) {
+            *dot = '\0';
+        }
+        node = name;
+    }
+
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    config.dir = PyBytes_AS_STRING(out);
+    config.partition_us = partition * 1000000ULL;
+    config.writer.group_rows = group_rows ? group_rows : config.writer.group_rows;
+    config.writer.compress = compress;
+
+    csi_archive_csv_config_t csv = CSI_ARCHIVE_CSV_CONFIG_DEFAULT();
+    csv.workers = threads;
+
+    csi_archive_convert_stats_t stats = { 0 };
+    bool opened = false, converted = false, closed = false;
+    int err = 0;
+    Py_BEGIN_ALLOW_THREADS
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    opened = store != NULL;
+    err = errno;
+    if (store) {
+        converted = csi_archive_convert_file(PyBytes_AS_STRING(path), input, node, &csv, store, &stats);
+        err = errno;
+        closed = csi_archive_store_close(store);
+        err = closed ? err : errno;
+    }
+    Py_END_ALLOW_THREADS
+
+    PyObject *result = NULL;
+    if (!opened) {
+        errno = err;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, out);
+    } else if (!converted) {
+        errno = err;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+    } else if (!closed) {
+        errno = err;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, out);
+    } else {
+        result = Py_BuildValue("{s:K,s:K,s:K}", "lines", (unsigned long long)stats.lines, "frames",
+                               (unsigned long long)stats.frames, "skipped", (unsigned long long)stats.skipped);
+    }
+    Py_DECREF(path);
+    Py_DECREF(out);
+    return result;
+}
+
+/* ===== Module ===== */
+
+static PyMethodDef module_methods[] = {
+    { "decode_frames", decode_frames, METH_O, decode_frames_doc },
+    { "convert", (PyCFunction)(void (*)(void))convert, METH_VARARGS | METH_KEYWORDS, convert_doc },
+    { NULL },
+};
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "csi_native",
+    .m_doc = "Binary CSI frames and archive segments as buffer-protocol arrays",
+    .m_size = -1,
+    .m_methods = module_methods,
+};
+
+PyMODINIT_FUNC PyInit_csi_native(void)
+{
+    if (PyType_Ready(&ColumnType) < 0 || PyType_Ready(&SegmentType) < 0) {
+        return NULL;
+    }
+    PyObject *m = PyModule_Create(&module);
+    if (!m) {
+        return NULL;
+    }
+    Py_INCREF(&ColumnType);
+    Py_INCREF(&SegmentType);
+    if (PyModule_AddObject(m, "Column", (PyObject *)&ColumnType) < 0 ||
+        PyModule_AddObject(m, "Segment", (PyObject *)&SegmentType) < 0 ||
+        PyModule_AddIntConstant(m, "MAX_SUBCARRIERS", CSI_MAX_SUBCARRIERS) < 0 ||
+        PyModule_AddIntConstant(m, "FRAME_FLAG_RAW", CSI_FRAME_FLAG_RAW) < 0 ||
+        PyModule_AddIntConstant(m, "FRAME_FLAG_UTC", CSI_FRAME_FLAG_UTC) < 0) {
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
@@ -0,0 +1,158 @@
+"""Tests of the csi_native module; run with the build directory on PYTHONPATH."""
+
+import math
+import os
+import struct
+import tempfile
+import unittest
+
+import csi_native
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+HEADER = struct.Struct("<HBBIQ6sbBBBH")
+MAC = bytes([0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01])
+
+CSV_HEADER = (
+    "type,role,mac,rssi,rate,sig_mode,mcs,bandwidth,smoothing,not_sounding,aggregation,stbc,"
+    "fec_coding,sgi,noise_floor,ampdu_cnt,channel,secondary_channel,local_timestamp,ant,sig_len,"
+    "rx_state,real_time_set,real_timestamp,len,CSI_DATA\n"
+)
+
+
+def frame(sequence, timestamp, raw, rssi=-50, channel=6, flags=csi_native.FRAME_FLAG_RAW):
+    header = HEADER.pack(0x5343, 2, flags, sequence, timestamp, MAC, rssi, channel, 0, len(raw) // 2, len(raw))
+    return header + bytes(b & 0xFF for b in raw)
+
+
+def csv_line(timestamp, raw):
+    return (
+        "CSI_DATA,STA,24:0A:C4:00:00:01,-51,11,1,7,0,0,0,0,0,0,0,-92,0,6,0,%d,0,128,0,0,0.0,%d,[%s]\n"
+        % (timestamp, len(raw), " ".join(str(v) for v in raw))
+    )
+
+
+class DecodeFramesTest(unittest.TestCase):
+    def test_columns(self):
+        data = b"".join(frame(s, 1000 * s, [3, 4, 0, 5, -6, 8]) for s in range(10))
+        cols = csi_native.decode_frames(data)
+
+        ts = memoryview(cols["timestamp"])
+        self.assertEqual(ts.format, "Q")
+        self.assertEqual(ts.shape, (10,))
+        self.assertEqual(ts.tolist(), [1000 * s for s in range(10)])
+        self.assertEqual(memoryview(cols["sequence"]).tolist(), list(range(10)))
+        self.assertEqual(memoryview(cols["mac"]).tolist()[3], list(MAC))
+        self.assertEqual(memoryview(cols["subcarrier_count"]).tolist(), [3] * 10)
+
+        amp = memoryview(cols["amplitude"])
+        self.assertEqual(amp.shape, (10, csi_native.MAX_SUBCARRIERS))
+        self.assertEqual(amp.strides, (4 * csi_native.MAX_SUBCARRIERS, 4))
+        self.assertAlmostEqual(amp[2, 0], 5.0, places=4)
+        self.assertAlmostEqual(amp[2, 2], 10.0, places=4)
+        self.assertEqual(amp[2, 3], 0.0)
+        self.assertAlmostEqual(memoryview(cols["phase"])[0, 1], math.pi / 2, places=3)
+
+    def test_empty_and_bad(self):
+        self.assertEqual(len(csi_native.decode_frames(b"")["iq"]), 0)
+        good = frame(1, 1, [1, 2])
+        with self.assertRaises(ValueError):
+            csi_native.decode_frames(good + good[:-1])
+        with self.assertRaises(ValueError):
+            csi_native.decode_frames(b"\0" * 40)
+
+    @unittest.skipIf(np is None, "numpy not installed")
+    def test_numpy_shares_memory(self):
+        cols = csi_native.decode_frames(b"".join(frame(s, s, [1, 1] * 64) for s in range(4)))
+        iq = np.asarray(cols["iq"])
+        self.assertEqual((iq.dtype, iq.shape), (np.int8, (4, 128)))
+        iq[0, 0] = 7
+        self.assertEqual(np.asarray(cols["iq"])[0, 0], 7)
+
+
+class SegmentTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.TemporaryDirectory()
+        self.addCleanup(self.dir.cleanup)
+        self.csv = os.path.join(self.dir.name, "node-a.csv")
+        with open(self.csv, "w") as f:
+            f.write(CSV_HEADER)
+            for i in range(50):
+                f.write(csv_line(10000 * i, [3, 4, 0, 5, i % 100, 0]))
+
+    def convert(self, **kwargs):
+        out = os.path.join(self.dir.name, "archive")
+        stats = csi_native.convert(self.csv, out, **kwargs)
+        self.assertEqual((stats["frames"], stats["skipped"]), (50, 1))
+        node = os.path.join(out, "node-a")
+        (name,) = os.listdir(node)
+        return csi_native.Segment(os.path.join(node, name))
+
+    def test_read_back(self):
+        seg = self.convert(group_rows=16)
+        self.assertEqual((seg.node, seg.rows, seg.groups, len(seg)), ("node-a", 50, 4, 50))
+        self.assertIn("amplitude", seg.columns)
+
+        ts = memoryview(seg.column("timestamp"))
+        self.assertEqual(ts.tolist(), [10000 * i for i in range(50)])
+        self.assertEqual(memoryview(seg.column("timestamp", 3)).tolist(), [10000 * i for i in range(48, 50)])
+        self.assertEqual(seg.group(1)["first_row"], 16)
+        self.assertEqual(seg.seek(10000 * 20 + 1), (1, 5))
+        self.assertIsNone(seg.seek(10**12))
+
+        amp = memoryview(seg.scaled("amplitude"))
+        self.assertEqual(amp.shape, (50, csi_native.MAX_SUBCARRIERS))
+        self.assertAlmostEqual(amp[7, 0], 5.0, places=2)
+        self.assertAlmostEqual(amp[7, 2], 7.0, places=2)
+
+    def test_raw_group_is_a_view(self):
+        seg = self.convert(group_rows=16, compress=False)
+        iq = memoryview(seg.column("iq", 0))
+        self.assertTrue(iq.readonly)
+        self.assertEqual(iq.shape, (16, 128))
+        self.assertEqual(iq.tolist()[5][:6], [3, 4, 0, 5, 5, 0])
+        del seg
+        # The view keeps the segment mapped
+        self.assertEqual(iq[5, 4], 5)
+
+    def test_errors(self):
+        seg = self.convert()
+        with self.assertRaises(KeyError):
+            seg.column("nope")
+        with self.assertRaises(IndexError):
+            seg.column("iq", 5)
+        with self.assertRaises(ValueError):
+            seg.scaled("rssi")
+        with self.assertRaises(FileNotFoundError):
+            csi_native.Segment(os.path.join(self.dir.name, "missing.csia"))
+        with self.assertRaises(ValueError):
+            csi_native.Segment(self.csv)
+
+    def test_open_once(self):
+        seg = self.convert(group_rows=16, compress=False)
+        iq = memoryview(seg.column("iq", 0))
+        # Re-opening would unmap what iq points at
+        with self.assertRaises(RuntimeError):
+            seg.__init__(self.csv)
+        self.assertEqual(iq[5, 4], 5)
+        self.assertEqual(len(seg), 50)
+
+        unopened = csi_native.Segment.__new__(csi_native.Segment)
+        with self.assertRaises(ValueError):
+            len(unopened)
+
+    @unittest.skipIf(np is None, "numpy not installed")
+    def test_numpy(self):
+        seg = self.convert(group_rows=16)
+        ts = np.asarray(seg.column("timestamp"))
+        self.assertEqual(ts.dtype, np.uint64)
+        self.assertTrue((np.diff(ts) == 10000).all())
+        phase = np.asarray(seg.scaled("phase"))
+        self.assertEqual((phase.dtype, phase.shape), (np.float32, (50, csi_native.MAX_SUBCARRIERS)))
+
+
+if __name__ == "__main__":
+    unittest.main()
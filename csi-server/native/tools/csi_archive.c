@@ -0,0 +1,192 @@
+/**
+ * @file csi_archive.c
+ * @brief Convert recordings into a CSI archive and inspect segments
+ *
+ *     csi_archive convert --out archive [--node NAME] capture.csv mqtt.log
+ *     csi_archive info archive/node-1/0.csia
+ *
+ * convert accepts ESP32-CSI-Tool CSV and csi_data JSON lines, optionally
+ * prefixed with their topic as "mosquitto_sub -v" prints them; "-" reads
+ * standard input. Lines without a topic are archived under --node, or the
+ * file name without its extension. CSV files are parsed on one thread per
+ * CPU (--threads to change); standard input and JSON are read line by line.
+ */
+
+#include "csi_archive.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s convert --out DIR [options] FILE...\n"
+            "       %s info SEGMENT...\n"
+            "convert options:\n"
+            "  --node NAME              node of lines without a topic (default: file name)\n"
+            "  --format auto|csv|json   input format (default auto, per line)\n"
+            "  --partition S            seconds covered by a segment (default 3600)\n"
+            "  --group-rows N           frames per row group (default 1024)\n"
+            "  --no-compress            store every column raw\n"
+            "  --threads N              CSV parser threads (default: one per CPU)\n",
+            prog, prog);
+}
+
+static int cmd_convert(int argc, char **argv)
+{
+    csi_archive_store_config_t config = CSI_ARCHIVE_STORE_CONFIG_DEFAULT();
+    csi_archive_csv_config_t csv = CSI_ARCHIVE_CSV_CONFIG_DEFAULT();
+    csi_archive_input_t format = CSI_ARCHIVE_INPUT_AUTO;
+    const char *node = NULL;
+    int first_file = argc;
+
+    for (int i = 2; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--out") == 0 && val) {
+            config.dir = val;
+        } else if (strcmp(argv[i], "--node") == 0 && val) {
+            node = val;
+        } else if (strcmp(argv[i], "--format") == 0 && val) {
+            if (strcmp(val, "auto") == 0) {
+                format = CSI_ARCHIVE_INPUT_AUTO;
+            } else if (strcmp(val, "csv") == 0) {
+                format = CSI_ARCHIVE_INPUT_CSV;
+            } else if (strcmp(val, "json") == 0) {
+                format = CSI_ARCHIVE_INPUT_JSON;
+            } else {
+                fprintf(stderr, "Unknown format: %s\n", val);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--partition") == 0 && val && atol(val) > 0) {
+            config.partition_us = (uint64_t)atol(val) * 1000000;
+        } else if (strcmp(argv[i], "--group-rows") == 0 && val && atoi(val) > 0) {
+            config.writer.group_rows = (uint32_t)atoi(val);
+        } else if (strcmp(argv[i], "--threads") == 0 && val && atoi(val) > 0 &&
+                   atoi(val) <= CSI_ARCHIVE_CSV_MAX_WORKERS) {
+            csv.workers = atoi(val);
+        } else if (strcmp(argv[i], "--no-compress") == 0) {
+            config.writer.compress = false;
+            continue;
+        } else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            first_file = i;
+            break;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (!config.dir || first_file == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    csi_archive_store_t *store = csi_archive_store_open(&config);
+    if (!store) {
+        fprintf(stderr, "Cannot open %s: %s\n", config.dir, strerror(errno));
+        return 1;
+    }
+
+    bool ok = true;
+    for (int i = first_file; i < argc; i++) {
+        bool is_stdin = strcmp(argv[i], "-") == 0;
+        char name[CSI_INGEST_MAX_NODE_LEN + 1];
+        if (node) {
+            snprintf(name, sizeof(name), "%s", node);
+        } else {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s", is_stdin ? "stdin" : argv[i]);
+            snprintf(name, sizeof(name), "%s", basename(path));
+            char *dot = strrchr(name, '.');
+            if (dot && dot != name) {
+                *dot = '\0';
+            }
+        }
+
+        csi_archive_convert_stats_t stats = {0};
+        bool converted = is_stdin ? csi_archive_convert(stdin, format, name, store, &stats)
+                                  : csi_archive_convert_file(argv[i], format, name, &csv, store, &stats);
+        if (!converted) {
+            fprintf(stderr, "%s: conversion failed: %s\n", argv[i], strerror(errno));
+            ok = false;
+            if (stats.lines == 0) {
+                continue;
+            }
+        }
+        printf("%s: %llu lines, %llu frames, %llu skipped\n", argv[i], (unsigned long long)stats.lines,
+               (unsigned long long)stats.frames, (unsigned long long)stats.skipped);
+    }
+
+    csi_archive_store_stats_t stats;
+    csi_archive_store_get_stats(store, &stats);
+    if (!csi_archive_store_close(store)) {
+        ok = false;
+    }
+    printf("%llu frames in %llu segments under %s\n", (unsigned long long)stats.rows,
+           (unsigned long long)stats.segments, config.dir);
+    return ok ? 0 : 1;
+}
+
+static int cmd_info(int argc, char **argv)
+{
+    static const char *const codec_names[] = { "raw", "const", "delta" };
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bool ok = true;
+    for (int i = 2; i < argc; i++) {
+        csi_archive_reader_t *reader = csi_archive_reader_open(argv[i]);
+        if (!reader) {
+            fprintf(stderr, "%s: %s\n", argv[i], errno == EINVAL ? "not a CSI archive segment" : strerror(errno));
+            ok = false;
+            continue;
+        }
+        const csi_archive_info_t *info = csi_archive_reader_info(reader);
+        printf("%s\n  node %s, %s timestamps %llu-%llu us%s\n  %llu frames in %u groups, %llu bytes, "
+               "%.1f bytes per frame\n",
+               argv[i], info->node, info->utc ? "UTC" : "uptime", (unsigned long long)info->first_timestamp,
+               (unsigned long long)info->last_timestamp, info->recovered ? " (no footer, recovered)" : "",
+               (unsigned long long)info->rows, info->groups, (unsigned long long)info->file_bytes,
+               info->rows ? (double)info->file_bytes / info->rows : 0.0);
+
+        uint64_t stored[CSI_ARCHIVE_COLUMNS] = {0};
+        uint32_t codecs[CSI_ARCHIVE_COLUMNS][3] = {{0}};
+        csi_archive_group_t group;
+        for (uint32_t g = 0; csi_archive_reader_group(reader, g, &group); g++) {
+            for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+                stored[c] += group.chunk_bytes[c];
+                codecs[c][group.codec[c]]++;
+            }
+        }
+        for (int c = 0; c < CSI_ARCHIVE_COLUMNS; c++) {
+            uint64_t raw = info->rows * csi_archive_column_stride(c);
+            printf("  %-18s %10llu bytes  %5.1f%% of raw ", csi_archive_column_name(c),
+                   (unsigned long long)stored[c], raw ? 100.0 * stored[c] / raw : 0.0);
+            for (int k = 0; k < 3; k++) {
+                if (codecs[c][k]) {
+                    printf(" %s:%u", codec_names[k], codecs[c][k]);
+                }
+            }
+            printf("\n");
+        }
+        csi_archive_reader_close(reader);
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "convert") == 0) {
+        return cmd_convert(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "info") == 0) {
+        return cmd_info(argc, argv);
+    }
+    usage(argv[0]);
+    return 1;
+}
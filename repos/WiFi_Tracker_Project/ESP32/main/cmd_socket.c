@@ -1,4 +1,5 @@
 #include "cmd_socket.h"
+#include "sniff_log.h"
 
 const char *TAGS = "Socket";
 extern time_t server_time; //FEDE
@@ -189,7 +190,7 @@ int send_sniffed_packages(int skt, const char *path){
 	struct stat st;
 	char success='t';
 
-	FILE *f = fopen(path, "r");
+	FILE *f = fopen(path, "rb");
 	if (f == NULL) {
 		ESP_LOGE(TAGS,"(!) Error: File does not exists.");
 		return -1;
@@ -209,10 +210,11 @@ int send_sniffed_packages(int skt, const char *path){
 
 	ESP_LOGI(TAGS,"(+) Sending the file to Server through TCP Socket.");
 
-	/* Send a message with this format - |FILE|CL|LF|B1|B2|B3|B4|T1|T2|T3|T4|
-	 * where B is the size and T the last time it has been modified */
-	//sending |FILE|
-	strcpy(buf, "FILE\r\n");
+	/* Send a message with this format - |RECORDS|CL|LF|B1|B2|B3|B4|T1|T2|T3|T4|L1|L2|
+	 * where B is the size, T the last time it has been modified and L the
+	 * length of each record of the file (sniff_log.h) */
+	//sending |RECORDS|
+	strcpy(buf, "RECORDS\r\n");
 	msg_len = strlen(buf);
 	int res=0;
 	//send thge starting info about the file to the server
@@ -242,14 +244,29 @@ int send_sniffed_packages(int skt, const char *path){
 		esp_restart();
 	}
 
+	/* send the record length */
+	//sending |L1|L2|
+	uint16_t record_len = htons(SNIFF_RECORD_LEN);
+	if(write(skt, &record_len, sizeof(uint16_t)) != sizeof(uint16_t)){
+		ESP_LOGE(TAGS,"(!) Error: Fail in sending record length.");
+		success='f';
+		esp_restart();
+	}
+
 	/* file send loop */
-	/* send the file BUFLEN byte at time to the client until the sended
+	/* send the file a block at time, as the sniffer wrote it, until the sended
 	 * size is equal to the one obtained before from the file*/
+	static uint8_t block[SNIFF_BLOCK_LEN];
 	uint32_t sendn_size=0;
 	ESP_LOGI(TAGS,"(+) ntohl(size)_u = %u", ntohl(size));
 	while (sendn_size < ntohl(size)) {
-		msg_len = fread(buf, 1, BUFLEN, f);
-		if (write(skt, buf, msg_len) != msg_len) {
+		msg_len = fread(block, 1, sizeof(block), f);
+		if (msg_len == 0) {
+			ESP_LOGE(TAGS,"(!) Error: File shorter than announced.");
+			success='f';
+			break;
+		}
+		if (write(skt, block, msg_len) != msg_len) {
 			ESP_LOGE(TAGS,"(!) Error: Fail in sending file content.");
 			success='f';
 			esp_restart();
@@ -14,12 +14,14 @@
 #include "nvs_flash.h"
 /* --------------------------LED HANDLE INCLUSION */
 #include "driver/gpio.h"
+#include "xtensa/hal.h"
 #include "sdkconfig.h"
 /* --------------------------MY FILES INCLUSION */
 #include "config.h"		//for all my variable
 #include "cmd_file.h"
 #include "cmd_socket.h"
-#include "../components/md5/md5.h"
+#include "sniff_log.h"
+#include "../components/probe_fingerprint/probe_fingerprint.h"
 /* --------------------------VFS and SPIFFS INCLUSION */
 #include "esp_vfs.h"
 #include "../components/spiffs/spiffs_vfs.h"
@@ -36,14 +38,14 @@ int s = 0;	/* socket ID */
 
 /* shared resources and mutex
  * to handle the parallel storage
- * sniffed_pkg.txt is the file
- * containing the sniffed data */
+ * sniffed_pkg.bin is the file
+ * containing the sniffed data, see sniff_log.h */
 
 SemaphoreHandle_t xMutex = NULL;
 
 FILE *fSniffs;
-const char *PATH_first = "/spiffs/sniffed_pkg1.txt";
-const char *PATH_second = "/spiffs/sniffed_pkg2.txt";
+const char *PATH_first = "/spiffs/sniffed_pkg1.bin";
+const char *PATH_second = "/spiffs/sniffed_pkg2.bin";
 int id_sniFile = 1;
 char a = 'a';
 
@@ -74,6 +76,7 @@ const int TIMEOUT = 20000 / portTICK_RATE_MS;			    // sniffing timeout time
 #define BEACON_MASK 0x8000										// my own defined BEACON_MASK
 #define DEFAULT_CHANNEL CONFIG_WIFI_SELECTED_CHANNEL		//define handle for blink task
 static EventGroupHandle_t sniff_event_group;				// Event group for sniffer handle
+static uint8_t fpKey[PROBE_FP_KEY_LEN];						// fingerprint key of the deployment, from CONFIG_PROBE_FP_KEY
 const int SNIFFEND_BIT = BIT1;
 
 //-----------------------Blink led
@@ -177,6 +180,12 @@ void app_main()
 	}
 	ESP_ERROR_CHECK(ret);
 
+	// without the deployment key the server could not match the fingerprints
+	if (!probe_fp_key_parse(CONFIG_PROBE_FP_KEY, fpKey)) {
+		ESP_LOGE(TAGM,"[x] Error: PROBE_FP_KEY must be %d hex digits, set it in menuconfig.", PROBE_FP_KEY_HEX_LEN);
+		abort();
+	}
+
 	//++++++++++++++++++++++ SPIFFS ++++++++++++++++++++++++++
 	ESP_LOGI(TAGM, "[+] Starting spiffs memory function +++\n");
 
@@ -508,94 +517,60 @@ void sniffer_packet_handler(void* buff, wifi_promiscuous_pkt_type_t type)
 	const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)ppkt->payload;     //wifi_ieee80211_packet_t-> PACCHETTO->PAYLOAD->payload
 	const wifi_ieee80211_mac_hdr_t *hdr = &ipkt->hdr;									//wifi_ieee80211_packet_t-> PACCHETTO->PAYLOAD->header
 
-	uint8_t result[16];
-	int mask;
+	uint32_t start = xthal_get_ccount();
+	sniff_record_t *rec;
+	int mask, len;
 
 	//RETURN if no MGMT
 	if (type != WIFI_PKT_MGMT)
 		return;
 
 	mask = 0xFF00;
-	if ((ntohs(hdr->frame_ctrl) & mask) == PROBE_MASK)
-	{
-		fprintf(fSniffs, "Type=MGMT,");
-		fprintf(fSniffs, " SubType=PROBE,");
-
-		md5((uint8_t*) ipkt, sizeof(wifi_ieee80211_packet_t), result); //FEDE
-
-		fprintf(fSniffs, " RSSI=%02d,"
-			   " SRC=%02x:%02x:%02x:%02x:%02x:%02x,"
-			   " seq_num=%d,"
-			   " TIME=%llu,"
-			   " HASH=%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x%2.2x,",
-			   ppkt->rx_ctrl.rssi,
-			   hdr->addr2[0],hdr->addr2[1],hdr->addr2[2],
-			   hdr->addr2[3],hdr->addr2[4],hdr->addr2[5],
-			   (int)hdr->sequence_ctrl,
-			   (unsigned long long) server_time_available + (unsigned long long) time(NULL) - (unsigned long long) offset_time_available,
-			   result[0],result[1],result[2],result[3],result[4],result[5],result[6],result[7],
-			   result[8],result[9],result[10],result[11],result[12],result[13],result[14],result[15]
-		);
-
-		uint8_t SSID_len =(uint8_t) ppkt->payload[25];
-		char ssid_str[SSID_len];
-		/* Remember that:
-		 * if SSID_len == 0
-		 * + Wildcard SSID or Null Probe Request.
-		 * else
-		 * + DIRECT PROBE REQUEST
-		 * */
-		if (SSID_len!=0)
-		{
-			//get the ssid
-			for(int j=0; j<SSID_len; j++)
-				ssid_str[j] = (char) ppkt->payload[26+j];
-			ssid_str[SSID_len] = '\0';
-			fprintf(fSniffs," SSID_id=%d,"
-				   " SSID_lenght=%u,"
-				   " SSID=%s,",
-				   ppkt->payload[24],
-				   SSID_len,
-				   ssid_str
-			);
-		} else {
-			fprintf(fSniffs," SSID_id=%d,"
-				   " SSID_lenght=%u,"
-				   " SSID=%s,",
-				   ppkt->payload[24],
-				   SSID_len,
-				   "UNKNOWN"
-			);
-		}
+	len = (int) ppkt->rx_ctrl.sig_len - 4;		//FCS left out
+	if ((ntohs(hdr->frame_ctrl) & mask) != PROBE_MASK || len < 26)
+		return;
 
-		uint8_t supp_rates_len = ppkt->payload[25 + SSID_len + 2];
-		/*printf(" supp_rates_id= %x,"
-			   " supp_rates_len= %d,",
-			   ppkt->payload[25 + SSID_len + 1],
-			   supp_rates_len);
-		*/
-
-		/* if DIRECT PROBE then we have info about:
-		 * Supported rates (not usefull for us)
-		 * and HT capabilities
-		 * usefull for some statistics*/
-		int ht_start = 25 + SSID_len + 2 + supp_rates_len;
-		uint8_t HT_len = ppkt->payload[ht_start+2];
-		if(HT_len != 0)
-		{
-			fprintf(fSniffs," HT_id=%x,"
-					" HT_cap_len=%d,"
-					" HT_cap_str=",
-					ppkt->payload[ht_start+1],
-					HT_len);
-			//get the ssid
-			for(int j=0; j<HT_len; j++)
-				fprintf(fSniffs,"%x",ppkt->payload[ht_start+3+j]);
-		}else{
-			fprintf(fSniffs," HT_id = %x", HT_len);
+	/* only fill a record of the ring here, the sniff_task writes it to flash */
+	if ((rec = sniff_ring_acquire()) == NULL)
+		return;
+	memset(rec, 0, sizeof(*rec));
+	rec->time = (uint32_t) (server_time_available + time(NULL) - offset_time_available);
+	//same value for every sniffer that heard this transmission
+	rec->fingerprint = probe_fingerprint(fpKey, ppkt->payload, len);
+	memcpy(rec->src, hdr->addr2, sizeof(rec->src));
+	rec->seq_ctrl = hdr->sequence_ctrl;
+	rec->rssi = ppkt->rx_ctrl.rssi;
+
+	/* Remember that:
+	 * if SSID_len == 0
+	 * + Wildcard SSID or Null Probe Request.
+	 * else
+	 * + DIRECT PROBE REQUEST
+	 * */
+	uint8_t SSID_len = ppkt->payload[25];
+	if (26 + SSID_len <= len) {
+		rec->ssid_len = SSID_len <= SNIFF_SSID_MAX ? SSID_len : SNIFF_SSID_MAX;
+		memcpy(rec->ssid, &ppkt->payload[26], rec->ssid_len);
+	}
+
+	/* if DIRECT PROBE then we have info about:
+	 * Supported rates (not usefull for us)
+	 * and HT capabilities
+	 * usefull for some statistics*/
+	if (28 + SSID_len <= len) {
+		int ht_start = 25 + SSID_len + 2 + ppkt->payload[25 + SSID_len + 2];
+		if (ht_start + 3 <= len) {
+			rec->ht_id = ppkt->payload[ht_start+1];
+			rec->ht_len = ppkt->payload[ht_start+2];
+			int ht_copy = len - (ht_start + 3);
+			if (ht_copy > rec->ht_len)
+				ht_copy = rec->ht_len;
+			if (ht_copy > SNIFF_HT_MAX)
+				ht_copy = SNIFF_HT_MAX;
+			memcpy(rec->ht_cap, &ppkt->payload[ht_start+3], ht_copy);
 		}
-		fprintf(fSniffs,"\n");
 	}
+	sniff_ring_publish(xthal_get_ccount() - start);
 }
 
 /* Configure the IOMUX register for pad BLINK_GPIO (some pads are
@@ -671,7 +646,7 @@ void sniff_task(void *pvParameter)
 			//pthread_mutex_unlock(&mutex);
 			xSemaphoreGiveFromISR(xMutex, NULL);
 			ESP_LOGW(TAGM,"MUTEX RILASCIATO - sniff_task");
-			fSniffs = fopen(PATH_second, "w");
+			fSniffs = fopen(PATH_second, "wb");
 		}
 		else
 		{
@@ -689,12 +664,23 @@ void sniff_task(void *pvParameter)
 			//pthread_mutex_unlock(&mutex);
 			xSemaphoreGiveFromISR(xMutex, NULL);
 			ESP_LOGW(TAGM,"MUTEX RILASCIATO - sniff_task");
-			fSniffs = fopen(PATH_first, "w");
+			fSniffs = fopen(PATH_first, "wb");
 		}
+		/* whole blocks go straight to the file, no stdio buffer in between */
+		if (fSniffs != NULL)
+			setvbuf(fSniffs, NULL, _IONBF, 0);
+		TickType_t start = xTaskGetTickCount();
 		esp_wifi_set_promiscuous(true);
-		vTaskDelay(TIMEOUT);
+		//this task is the writer of the sniff log while the callback fills it
+		while (xTaskGetTickCount() - start < TIMEOUT) {
+			vTaskDelay(SNIFF_DRAIN_MS / portTICK_RATE_MS);
+			sniff_log_drain(fSniffs, false);
+		}
 		esp_wifi_set_promiscuous(false);
-		fclose(fSniffs);
+		sniff_log_drain(fSniffs, true);
+		if (fSniffs != NULL)
+			fclose(fSniffs);
+		sniff_log_report();
 		ESP_LOGW(TAGM,"[*] END OF SNIFF -> START TRASFERRING");
 		xEventGroupSetBits(sniff_event_group, SNIFFEND_BIT);
 	}
@@ -0,0 +1,96 @@
+#include "sniff_log.h"
+#include "esp_timer.h"
+
+#include <string.h>
+
+/*	VARIABLES	*/
+const char *TAGL = "SniffLog";
+
+static sniff_record_t ring[SNIFF_RING_LEN];
+static uint32_t ring_head;		/* written only by the callback */
+static uint32_t ring_tail;		/* written only by the sniff_task */
+
+static uint8_t block[SNIFF_BLOCK_LEN];
+static size_t block_len;
+
+/* counters, each written by one task only and never reset */
+typedef struct {
+	uint32_t probes;			/* records published by the callback */
+	uint32_t dropped;			/* probes lost to a full ring */
+	uint32_t cycles;			/* CPU cycles the callback spent on published probes */
+	uint32_t blocks;			/* blocks written */
+	uint32_t bytes;
+	uint32_t write_us;			/* time spent writing them */
+} sniff_stats_t;
+
+static sniff_stats_t stats;
+
+/* next free record of the ring, NULL if the sniff_task is behind */
+sniff_record_t *sniff_ring_acquire(void)
+{
+	if (ring_head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == SNIFF_RING_LEN) {
+		stats.dropped++;
+		return NULL;
+	}
+	return &ring[ring_head & (SNIFF_RING_LEN - 1)];
+}
+
+/* hand the acquired record over to the sniff_task */
+void sniff_ring_publish(uint32_t cycles)
+{
+	stats.probes++;
+	stats.cycles += cycles;
+	__atomic_store_n(&ring_head, ring_head + 1, __ATOMIC_RELEASE);
+}
+
+static int write_block(FILE *f)
+{
+	int64_t start = esp_timer_get_time();
+	size_t n = f != NULL ? fwrite(block, 1, block_len, f) : 0;
+
+	stats.write_us += (uint32_t) (esp_timer_get_time() - start);
+	stats.blocks++;
+	stats.bytes += n;
+	if (n != block_len) {
+		ESP_LOGE(TAGL, "[x] Error: %u bytes of sniffed packets lost.", (unsigned) (block_len - n));
+		block_len = 0;
+		return -1;
+	}
+	block_len = 0;
+	return 0;
+}
+
+/* move the records out of the ring, writing every full block
+ * and, with flush, the last partial one too */
+int sniff_log_drain(FILE *f, bool flush)
+{
+	uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+	int result = 0;
+
+	while (ring_tail != head) {
+		memcpy(block + block_len, &ring[ring_tail & (SNIFF_RING_LEN - 1)], SNIFF_RECORD_LEN);
+		block_len += SNIFF_RECORD_LEN;
+		//free the record at once, the callback can refill it while the block is written
+		__atomic_store_n(&ring_tail, ring_tail + 1, __ATOMIC_RELEASE);
+		if (block_len == SNIFF_BLOCK_LEN && write_block(f) == -1)
+			result = -1;
+	}
+	if (flush && block_len > 0 && write_block(f) == -1)
+		result = -1;
+	return result;
+}
+
+/* log what the sniffer did since the last report */
+void sniff_log_report(void)
+{
+	static sniff_stats_t last;
+	sniff_stats_t now = stats;
+	uint32_t probes = now.probes - last.probes;
+	uint32_t blocks = now.blocks - last.blocks;
+
+	ESP_LOGI(TAGL, "[i] %u probes, %u dropped, %u cycles per probe in the callback",
+			probes, now.dropped - last.dropped, probes ? (now.cycles - last.cycles) / probes : 0);
+	ESP_LOGI(TAGL, "[i] %u blocks, %u bytes written, %u us per block",
+			blocks, now.bytes - last.bytes, blocks ? (now.write_us - last.write_us) / blocks : 0);
+	last = now;
+}
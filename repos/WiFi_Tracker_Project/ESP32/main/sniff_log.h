@@ -0,0 +1,52 @@
+#include "esp_log.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Binary sniff log
+ * the promiscuous callback fills one fixed-size record per probe request
+ * in a lock-free ring (one producer: the Wi-Fi task, one consumer: the
+ * sniff_task), and the sniff_task appends them to the sniff file in whole
+ * blocks, so the callback never waits on the flash.
+ *
+ * The file is a sequence of records, each SNIFF_RECORD_LEN bytes, little endian:
+ * |T1|T2|T3|T4|			time, seconds on the server clock
+ * |H1|...|H8|				probe fingerprint (probe_fingerprint.h)
+ * |S1|...|S6|				source address
+ * |Q1|Q2|					sequence control, as transmitted
+ * |R|						RSSI, signed
+ * |SL|						SSID length, 0 for a wildcard probe
+ * |EI|EL|					id and length of the element after the supported rates (HT capabilities)
+ * |SSID, 32 bytes|			zero padded
+ * |element, 26 bytes|		first bytes of that element, zero padded
+ * |14 bytes|				zero
+ */
+#define SNIFF_RECORD_LEN	96
+#define SNIFF_SSID_MAX		32
+#define SNIFF_HT_MAX		26
+#define SNIFF_RING_LEN		128							/* records, a power of two */
+#define SNIFF_BLOCK_LEN		(32 * SNIFF_RECORD_LEN)		/* 3 KiB, whole SPIFFS pages */
+#define SNIFF_DRAIN_MS		100							/* how often the sniff_task empties the ring */
+
+typedef struct __attribute__((packed)) {
+	uint32_t time;
+	uint64_t fingerprint;
+	uint8_t src[6];
+	uint16_t seq_ctrl;
+	int8_t rssi;
+	uint8_t ssid_len;
+	uint8_t ht_id;
+	uint8_t ht_len;
+	char ssid[SNIFF_SSID_MAX];
+	uint8_t ht_cap[SNIFF_HT_MAX];
+	uint8_t reserved[14];
+} sniff_record_t;
+
+_Static_assert(sizeof(sniff_record_t) == SNIFF_RECORD_LEN, "sniff_record_t is the file format");
+
+//METHODS
+sniff_record_t *sniff_ring_acquire(void);
+void sniff_ring_publish(uint32_t cycles);
+int sniff_log_drain(FILE *f, bool flush);
+void sniff_log_report(void);
@@ -45,10 +45,15 @@ typedef struct {
 
 }wifi_iee80211_mac_body_t;
 
+#define WIFI_FCS_LEN 4 /* CRC32 trailing every sniffed frame */
+
+/* probe request as the sniffer callback writes it in the ring buffer */
 typedef struct {
-	struct tm timestamp;
-	wifi_promiscuous_pkt_t packet;
-} attached_timestamp_packet_t;
+	int64_t timestamp; /* esp_timer_get_time() at reception, microseconds since boot */
+	wifi_pkt_rx_ctrl_t rx_ctrl;
+	uint16_t len; /* bytes in payload */
+	uint8_t payload[0]; /* mac header and IEs, without the FCS */
+} sniffed_probe_t;
 
 const char *wifi_sniffer_packet_type2str(wifi_promiscuous_pkt_type_t type);
 string packetSubtype2Str(uint8_t subtype);
@@ -1,6 +1,14 @@
 #include "ConsumerTask.h"
 
+/* fingerprint key of the deployment, shared with the other sniffers */
+static uint8_t fpKey[PROBE_FP_KEY_LEN];
+
 ConsumerTask::ConsumerTask(int socket, RingbufHandle_t packetRingBuffer) {
+    // without the deployment key the server could not match the fingerprints
+    if (!probe_fp_key_parse(CONFIG_PROBE_FP_KEY, fpKey)) {
+        ESP_LOGE(TAG, "PROBE_FP_KEY must be %d hex digits, set it in menuconfig", PROBE_FP_KEY_HEX_LEN);
+        abort();
+    }
     // boxing task args
     map<int, void*> *args = new map<int, void*>;
     args->insert(pair<int, void*>(ConsumerTask::Keys::SOCKET, (void *) socket));
@@ -35,118 +43,99 @@ void ConsumerTask::consume(void *args) {
     RingbufHandle_t packetRingBuffer = (RingbufHandle_t) it->second;
     delete argsMap;
 
+    Uplink uplink(socket);
+    // lines are formatted here first and queued with their actual length, so a
+    // short line still fits when less than PROBE_LINE_MAX bytes are left
+    static char line[PROBE_LINE_MAX];
     while (1) {
         size_t packetSize;  
 
         // task yield in order to context switch to other task if neccessary and hence resetting
         // the watchdog because if many packets are ready i will not put the thread in sleeping queue
-        // vTaskDelay(portTICK_PERIOD_MS);
         taskYIELD();
-        void *probePacket = xRingbufferReceive(packetRingBuffer, &packetSize, portMAX_DELAY);
-        if (probePacket == NULL) {
-            ESP_LOGE(TAG, "Error retrieving element from queue\n");
-            continue;
-        }
-        // ESP_LOGD(TAG, "(Core %d) Extracted element from queue, size: %d",xPortGetCoreID(), packetSize);        
-        // if not a probe req i will discard packet
-        unique_ptr<ProbeReq> probePtr;
-        if (consumeSniffedPacket(probePacket, probePtr) == false) {
-            // remove packet from ringbuffer
+        // sleep until a probe arrives or the uplink needs polling
+        void *probePacket = xRingbufferReceive(packetRingBuffer, &packetSize,
+                uplink.idle() ? portMAX_DELAY : pdMS_TO_TICKS(UPLINK_POLL_MS));
+        // append what the sniffer queued meanwhile, one line per probe
+        for (int n = 1; probePacket != NULL; n++) {
+            size_t lineLen = consumeSniffedPacket(probePacket, line, sizeof(line));
+            char *queued = lineLen > 0 ? uplink.reserve(lineLen) : NULL;
+            if (queued != NULL) {
+                memcpy(queued, line, lineLen);
+                uplink.commit(lineLen);
+            }
             vRingbufferReturnItem(packetRingBuffer, probePacket);
-            ESP_LOGD(TAG, "discarded remaining size %d", xRingbufferGetCurFreeSize(packetRingBuffer));
-            continue;
+            probePacket = n < CONSUMER_BATCH ? xRingbufferReceive(packetRingBuffer, &packetSize, 0) : NULL;
         }
-        cout << probePtr.get();
-        // stringstream ss;
-        // ss << *probePtr;
-        // string str = ss.str();
-        // char *sendStr = new char[str.length() + 1];
-        // strcpy(sendStr, str.c_str());
-        unique_ptr<CppJSON> toSendCppJSONPtr = probePtr->toJson();
-        char *sendStr = cJSON_Print(toSendCppJSONPtr->jsonObj);
-        // char *sendStr = NULL;
-        if (sendStr == NULL)
-        {
-            ESP_LOGW(TAG, "Failed to send JSON");
+        uplink.poll();
+    }
+}
+
+/* copy an SSID as the body of a JSON string, up to its first NUL */
+static size_t ssidToJson(const uint8_t *ssid, size_t len, char *out) {
+    static const char hex[] = "0123456789abcdef";
+    char *p = out;
+
+    for (size_t i = 0; i < len && ssid[i] != '\0'; i++) {
+        uint8_t c = ssid[i];
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = c;
+        } else if (c < 0x20) {
+            *p++ = '\\';
+            *p++ = 'u';
+            *p++ = '0';
+            *p++ = '0';
+            *p++ = hex[c >> 4];
+            *p++ = hex[c & 0xF];
         } else {
-            // ESP_LOGD(TAG, "%s", sendStr);
-            while (send(socket, sendStr, strlen(sendStr), 0) == -1) {
-                ESP_LOGE(TAG, "Error sending sniffed packet info to server");
-                close(socket);
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
-                ESP_ERROR_CHECK(connect_to_server(&socket, true));
-                // connect_to_server(&socket);
-            }
-            free(sendStr);
+            *p++ = c;
         }
-        vRingbufferReturnItem(packetRingBuffer, probePacket);
-        ESP_LOGD(TAG, "sended remaining size %d", xRingbufferGetCurFreeSize(packetRingBuffer));
     }
+    *p = '\0';
+    return p - out;
 }
 
-bool ConsumerTask::consumeSniffedPacket(void *probePacket, unique_ptr<ProbeReq>& retProbeReq) {
-    char buf[32 + 1];    
-    uint8_t subtype;
+size_t ConsumerTask::consumeSniffedPacket(const void *probePacket, char *line, size_t size) {
+    char ssid[32 * 6 + 1];
     int8_t rssi;
-    uint8_t channel;
     uint8_t ssidLen;
-    unsigned char md5digest[16];
-    string ssid;
 
-    const attached_timestamp_packet_t *ppkt_with_tm = (attached_timestamp_packet_t*) probePacket;
-    const wifi_promiscuous_pkt_t *ppkt = &(ppkt_with_tm->packet);
-    const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)ppkt->payload;
+    const sniffed_probe_t *ppkt = (const sniffed_probe_t *) probePacket;
+    const wifi_ieee80211_packet_t *ipkt = (const wifi_ieee80211_packet_t *)ppkt->payload;
     const wifi_ieee80211_mac_hdr_t *hdr = &ipkt->hdr;
-    /* filter only PROBE REQ packets */
-    subtype = hdr->frame_ctrl;
-    subtype = subtype & 0xF0;
-    // if (subtype != 0x40) {
-    //     // ESP_LOGD(TAG, "remaining size %d", xRingbufferGetCurFreeSize(packetRingBuffer));
-    //     return false;
-    // }
-    // i don't know why but last 4 bytes (of FCS i think) are different for any ESP receiver
-    // also other 24 byte are different
-    int payloadSize = ppkt->rx_ctrl.sig_len - 28;
-    // debug
-    // dumpPacket(ppkt, payloadSize);
-    // uint8_t *payloadHash = new uint8_t[payloadSize];
-    // memset(payloadHash, 0, payloadSize);
-    // memcpy(payloadHash, ppkt->payload, payloadSize);
     // extracting packet info from the payload
     rssi = ppkt->rx_ctrl.rssi;
-    // take channel byte and filter useful bits
-    channel = ppkt->rx_ctrl.channel;
-    channel &= 0xF0;
-    // i don't know why but last 4 bytes (of CRC i think) are different for any ESP receiver
-    // calculating md5 packet digest
-    mbedtls_md5((const unsigned char *) ppkt->payload, payloadSize, md5digest);
+    // the sniffer already dropped the FCS; the fingerprint leaves out what else
+    // differs between receivers, so the server matches the copies of one probe
+    uint64_t fingerprint = probe_fingerprint(fpKey, ppkt->payload, ppkt->len);
     // copy from ssid begin a length of ssid length specified in the payload 
     ssidLen = ppkt->payload[25];
-    ESP_LOGD(TAG, "ssid len: %d", ssidLen);
-    if (ssidLen <= 32)  {
-        memcpy(buf, &(ppkt->payload[26]), (size_t) ppkt->payload[25]);
-        buf[ppkt->payload[25]] = '\0';
-        ESP_LOGD(TAG, "%s", buf);
-        ssid = buf;
+    if (ssidLen <= 32 && 26 + ssidLen <= ppkt->len)  {
+        ssidToJson(&ppkt->payload[26], ssidLen, ssid);
     } else {
-        ssid = "";
+        ssid[0] = '\0';
     }
-    retProbeReq.reset(new ProbeReq (
-                ProbeReq::Builder()
-                .withType(WIFI_PKT_MGMT)
-                .withSubtype(subtype)
-                .withChannel(ppkt->rx_ctrl.channel)
-                .withRssi(rssi)
-                // .withSsid((char *) &(ppkt->payload[26]), ppkt->payload[25])
-                .withSsid2(ssid)
-                .withSourceAddress(hdr->addr2)
-                .withDestAddress(hdr->addr1)
-                .withBssid(hdr->addr3)
-                .withMd5digest(md5digest)
-                .withSequenceNumber(hdr->sequence_number)
-                .withTimestamp(ppkt_with_tm->timestamp)
-                .build()
-            ));
+    struct tm timestamp = SynchronizeBoard::toTime(ppkt->timestamp);
 
-    return true;
+    // same object ProbeReq::toJson() builds, compact and on one line
+    int n = snprintf(line, size,
+            "{\"%s\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"%s\":\"%s\","
+            "\"%s\":{\"tm_sec\":%d,\"tm_min\":%d,\"tm_hour\":%d,\"tm_mday\":%d,\"tm_mon\":%d,"
+            "\"tm_year\":%d,\"tm_wday\":%d,\"tm_yday\":%d,\"tm_isdst\":%d},"
+            "\"%s\":\"%016llx\",\"%s\":%d,\"%s\":%d}\n",
+            ProbeReq::Keys::SADDR, hdr->addr2[0], hdr->addr2[1], hdr->addr2[2],
+            hdr->addr2[3], hdr->addr2[4], hdr->addr2[5],
+            ProbeReq::Keys::SSID, ssid,
+            ProbeReq::Keys::TIMESTAMP, timestamp.tm_sec, timestamp.tm_min, timestamp.tm_hour,
+            timestamp.tm_mday, timestamp.tm_mon, timestamp.tm_year, timestamp.tm_wday,
+            timestamp.tm_yday, timestamp.tm_isdst,
+            ProbeReq::Keys::MD5HASH, (unsigned long long) fingerprint,
+            ProbeReq::Keys::RSSI, rssi,
+            ProbeReq::Keys::SEQUENCE_NUM, hdr->sequence_number);
+    if (n < 0 || (size_t) n >= size) {
+        ESP_LOGW(TAG, "probe request too long to send");
+        return 0;
+    }
+    return n;
 }
@@ -12,11 +12,12 @@
 #include "esp_log.h"
 #include "80211Packet.h"
 #include "string.h"
-#include "mbedtls/md5.h"
+#include "probe_fingerprint.h"
 #include "CppJSON.h"
 #include "cJSON.h"
 #include "ProbeReq.h"
 #include "socketUtils.h"
+#include "Uplink.h"
 #include "esp_heap_trace.h"
 #include "esp32_pds.h"
 #include "synchronizeboard.h"
@@ -24,6 +25,8 @@
 // #define LOG_LOCAL_LEVEL ESP_LOG_DEBUG                   /* level of logging */
 
 #define NUM_RECORDS 100
+#define PROBE_LINE_MAX 512 /* longest line consumeSniffedPacket writes */
+#define CONSUMER_BATCH 32 /* probes taken from the ring buffer between two uplink polls */
 
 // static heap_trace_record_t trace_record[NUM_RECORDS]; // This buffer must be in internal RAM
 
@@ -52,15 +55,15 @@ private:
 	TaskHandle_t consumerHandle;
 
 	/**
-	  * @brief Utility function that given raw sniffed produce a probeReq class
+	  * @brief Utility function that given a sniffed probe request writes the line sent to the server
 	  *
-	  * @param     probePacket	raw sniffed packet
-	  * @param     retProbeReq	probeReq return pointer to instance
+	  * @param     probePacket	sniffed_probe_t from the ring buffer
+	  * @param     line		where to write the JSON object of ProbeReq::toJson(), ended by '\n'
+	  * @param     size		size of line, PROBE_LINE_MAX always suffices
 	  * @return    
-	  *    - false probePacket in not a probe request so value in retProbeReq is invalid
-	  *    - true  probePacket is a probe request
+	  *    - bytes written in line, 0 if it does not fit
 	  */  
-	static bool consumeSniffedPacket(void *probePacket, unique_ptr<ProbeReq>& retProbeReq);
+	static size_t consumeSniffedPacket(const void *probePacket, char *line, size_t size);
 };
 
 #endif //PDSPROJECT_CONSUMERTASK_H
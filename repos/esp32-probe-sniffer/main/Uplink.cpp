@@ -0,0 +1,177 @@
+#include "Uplink.h"
+#include <fcntl.h>
+
+Uplink::Uplink(int socket):
+	sock(-1), state(DISCONNECTED), since(xTaskGetTickCount()),
+	retryDelay(pdMS_TO_TICKS(UPLINK_RETRY_MIN_MS)), queue(new char[UPLINK_QUEUE_SIZE]),
+	head(0), tail(0), oldest(0), midLine(false), dropped(0), responseLen(0) {
+	if (socket >= 0) {
+		fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+		sock = socket;
+		state = CONNECTED;
+	}
+}
+
+Uplink::~Uplink() {
+	if (sock >= 0) {
+		close(sock);
+	}
+	delete[] queue;
+}
+
+char *Uplink::reserve(size_t size) {
+	if (UPLINK_QUEUE_SIZE - tail < size) {
+		// move the bytes not sent yet to the front
+		memmove(queue, queue + head, tail - head);
+		tail -= head;
+		head = 0;
+		if (UPLINK_QUEUE_SIZE - tail < size) {
+			dropped++;
+			return NULL;
+		}
+	}
+	return queue + tail;
+}
+
+void Uplink::commit(size_t size) {
+	if (head == tail) {
+		oldest = xTaskGetTickCount();
+	}
+	tail += size;
+}
+
+void Uplink::poll(void) {
+	TickType_t now = xTaskGetTickCount();
+
+	switch (state) {
+	case DISCONNECTED:
+		if (now - since >= retryDelay) {
+			startConnect(now);
+		}
+		break;
+	case CONNECTING:
+		checkConnect(now);
+		break;
+	case HANDSHAKE:
+		readResponse(now);
+		break;
+	case CONNECTED:
+		flush(now);
+		break;
+	}
+}
+
+void Uplink::enter(State state, TickType_t now) {
+	this->state = state;
+	since = now;
+}
+
+void Uplink::startConnect(TickType_t now) {
+	struct sockaddr_in serverAddress;
+
+	// wait to be connected on the AP, without blocking
+	if ((xEventGroupGetBits(wifi_event_group) & WIFI_CONNECTED_BIT) == 0) {
+		return;
+	}
+	server_address(&serverAddress);
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock < 0) {
+		ESP_LOGE(TAG, "error creating socket");
+		disconnect(now);
+		return;
+	}
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+	if (::connect(sock, (struct sockaddr *) &serverAddress, sizeof(serverAddress)) != 0 && errno != EINPROGRESS) {
+		ESP_LOGE(TAG, "fail to connect, errno %d", errno);
+		disconnect(now);
+		return;
+	}
+	enter(CONNECTING, now);
+}
+
+void Uplink::checkConnect(TickType_t now) {
+	fd_set writeSet;
+	struct timeval noWait = {0, 0};
+
+	FD_ZERO(&writeSet);
+	FD_SET(sock, &writeSet);
+	int ready = select(sock + 1, NULL, &writeSet, NULL, &noWait);
+	if (ready == 0 && now - since < pdMS_TO_TICKS(UPLINK_TIMEOUT_MS)) {
+		return;
+	}
+	if (ready <= 0 || espx_last_socket_errno(sock) != 0) {
+		ESP_LOGE(TAG, "fail to connect");
+		disconnect(now);
+		return;
+	}
+	// the socket buffer is empty, so the id goes out at once
+	uint8_t id = CONFIG_ESP32_ID;
+	if (send(sock, &id, sizeof(id), NO_FLAGS) != sizeof(id)) {
+		ESP_LOGE(TAG, "error while sending Id");
+		disconnect(now);
+		return;
+	}
+	responseLen = 0;
+	enter(HANDSHAKE, now);
+}
+
+void Uplink::readResponse(TickType_t now) {
+	ssize_t nread = recv(sock, response + responseLen, sizeof(response) - responseLen, MSG_DONTWAIT);
+	if (nread > 0) {
+		responseLen += nread;
+		if (responseLen == sizeof(response)) {
+			ESP_LOGI(TAG, "connection done on socket %d, %u lines dropped meanwhile", sock, dropped);
+			dropped = 0;
+			retryDelay = pdMS_TO_TICKS(UPLINK_RETRY_MIN_MS);
+			enter(CONNECTED, now);
+		}
+	} else if (nread == 0 || (errno != EWOULDBLOCK && errno != EAGAIN) ||
+			now - since >= pdMS_TO_TICKS(UPLINK_TIMEOUT_MS)) {
+		ESP_LOGE(TAG, "error while receiving response");
+		disconnect(now);
+	}
+}
+
+void Uplink::flush(TickType_t now) {
+	size_t queued = tail - head;
+
+	// coalesce lines until a batch is worth a send or the oldest has waited enough
+	if (queued == 0 || (queued < UPLINK_BATCH_SIZE && now - oldest < pdMS_TO_TICKS(UPLINK_FLUSH_MS))) {
+		return;
+	}
+	while (head < tail) {
+		ssize_t nwritten = send(sock, queue + head, tail - head, MSG_DONTWAIT);
+		if (nwritten > 0) {
+			head += nwritten;
+			midLine = queue[head - 1] != '\n';
+		} else if (nwritten < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+			break;
+		} else {
+			ESP_LOGE(TAG, "Error sending sniffed packet info to server");
+			disconnect(now);
+			return;
+		}
+	}
+	if (head == tail) {
+		head = tail = 0;
+	}
+}
+
+void Uplink::disconnect(TickType_t now) {
+	if (sock >= 0) {
+		close(sock);
+		sock = -1;
+	}
+	// the server discards a line cut by the connection, so its rest is not sent either
+	if (midLine) {
+		char *end = (char *) memchr(queue + head, '\n', tail - head);
+		head = end != NULL ? end - queue + 1 : tail;
+		midLine = false;
+	}
+	if (state == CONNECTED) {
+		retryDelay = pdMS_TO_TICKS(UPLINK_RETRY_MIN_MS);
+	} else if (retryDelay < pdMS_TO_TICKS(UPLINK_RETRY_MAX_MS)) {
+		retryDelay *= 2;
+	}
+	enter(DISCONNECTED, now);
+}
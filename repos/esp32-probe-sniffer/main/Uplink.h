@@ -0,0 +1,89 @@
+#ifndef PDSPROJECT_UPLINK_H
+#define PDSPROJECT_UPLINK_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "socketUtils.h"
+
+#define UPLINK_QUEUE_SIZE 16384 /* bytes waiting to be sent to the server */
+#define UPLINK_BATCH_SIZE 1400 /* bytes worth a send, about one TCP segment */
+#define UPLINK_FLUSH_MS 200 /* longest wait of queued bytes for a full batch */
+#define UPLINK_POLL_MS 20 /* poll period while there is something to do */
+#define UPLINK_TIMEOUT_MS 5000 /* longest connect or handshake */
+#define UPLINK_RETRY_MIN_MS 1000 /* first delay before reconnecting, doubled on each failure */
+#define UPLINK_RETRY_MAX_MS 16000
+
+/**
+  * Non-blocking connection to the server with an outbound byte queue
+  *
+  * Lines are written in the queue with reserve() and commit(), and poll()
+  * sends them in batches. poll() also reconnects, with backoff, when the
+  * connection is lost. Nothing blocks: while the server is unreachable the
+  * lines wait in the queue, and only when it is full are new ones dropped.
+  */
+class Uplink {
+public:
+	/**
+	  * @param     socket	connected socket, already past the handshake, or -1
+	  */
+	explicit Uplink(int socket);
+
+	~Uplink();
+
+	/**
+	  * @brief space for a line at the end of the queue
+	  *
+	  * @param     size	bytes of the line
+	  * @return
+	  *    - NULL the queue is full and the line is dropped
+	  *    - where to write the line
+	  */
+	char *reserve(size_t size);
+
+	/**
+	  * @brief queue the line written after reserve()
+	  *
+	  * @param     size	bytes written, ending with '\n'
+	  */
+	void commit(size_t size);
+
+	/**
+	  * @brief advance the connection and send what is due, without blocking
+	  */
+	void poll(void);
+
+	/**
+	  * @brief true when poll() has nothing to do until a new line is queued
+	  */
+	bool idle(void) { return state == CONNECTED && head == tail; }
+
+private:
+	enum State {
+		DISCONNECTED,
+		CONNECTING,
+		HANDSHAKE,
+		CONNECTED
+	};
+
+	int sock;
+	State state;
+	TickType_t since; /* when state was entered */
+	TickType_t retryDelay;
+	char *queue;
+	size_t head; /* first byte not sent */
+	size_t tail; /* end of the queued bytes */
+	TickType_t oldest; /* when the oldest queued byte was committed */
+	bool midLine; /* the last byte sent is not the end of a line */
+	uint32_t dropped; /* lines dropped since the last report */
+	uint8_t response[2];
+	size_t responseLen;
+
+	void enter(State state, TickType_t now);
+	void startConnect(TickType_t now);
+	void checkConnect(TickType_t now);
+	void readResponse(TickType_t now);
+	void flush(TickType_t now);
+	void disconnect(TickType_t now);
+};
+
+#endif //PDSPROJECT_UPLINK_H
@@ -13,6 +13,7 @@
 #define FIXED_CHANNEL 1 /* fixed channel to sniff */
 #define STACK_SIZE 4096 /* consumer task size */
 #define RINGBUF_SIZE 10240 /* size of ringbuffer */
+#define HANDLER_REPORT_TICKS 20 /* led blinks between two reports of the sniffer callback cost */
 #define SERVER_ADDR CONFIG_SERVER_ADDRESS
 #define SERVER_PORT CONFIG_SERVER_PORT
 #define SNTP_SERVER_IP CONFIG_SNTP_SERVER_IP
@@ -19,6 +19,8 @@
 #include "freertos/ringbuf.h"
 #include "freertos/portmacro.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "xtensa/hal.h"
 #include "synchronizeboard.h"
 #include "socketUtils.h"
 #include "ConsumerTask.h"
@@ -50,6 +52,12 @@ EventGroupHandle_t wifi_event_group;
 /* shared ringbuffer between producer and consumer */
 RingbufHandle_t packetRingBuffer;
 
+/* probe requests handled by the sniffer callback and CPU cycles spent on them */
+static volatile uint32_t handlerCalls;
+static volatile uint32_t handlerCycles;
+/* probe requests lost because the ring buffer was full */
+static volatile uint32_t handlerDrops;
+
 extern "C" {
     void app_main(void);
 }
@@ -130,45 +138,53 @@ void wifi_init_sta(void)
 	
 void wifi_sniffer_packet_handler(void* buff, wifi_promiscuous_pkt_type_t type)
 {   
-    // xSemaphoreTake(chanMutex, portMAX_DELAY);
-    // xEventGroupWaitBits(send_event_group, SEND_BIT,
-            // false, true, portMAX_DELAY);
-    // Todo try to remove it beacause of mask of promiscuous mode
-    uint8_t subtype;
-    struct tm timestamp = SynchronizeBoard::getTime();
+    uint32_t start = xthal_get_ccount();
 
     if (type != WIFI_PKT_MGMT) {
         return;
     }
-    wifi_promiscuous_pkt_t *ppkt = (wifi_promiscuous_pkt_t *) buff;
-    if (ppkt->rx_ctrl.sig_len > RINGBUF_SIZE) 
-        return;
-
+    const wifi_promiscuous_pkt_t *ppkt = (wifi_promiscuous_pkt_t *) buff;
     const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)ppkt->payload;
-    const wifi_ieee80211_mac_hdr_t *hdr = &ipkt->hdr;
     /* filter only PROBE REQ packets */
-    subtype = hdr->frame_ctrl;
-    subtype = subtype & 0xF0;
-    if (subtype != 0x40) {
-        // ESP_LOGD(TAG, "remaining size %d", xRingbufferGetCurFreeSize(packetRingBuffer));
+    if ((ipkt->hdr.frame_ctrl & 0xF0) != WIFI_MGMT_PROBE_REQ) {
+        return;
+    }
+    /* the consumer reads at least the SSID element header */
+    size_t len = ppkt->rx_ctrl.sig_len;
+    if (len < sizeof(wifi_ieee80211_mac_hdr_t) + sizeof(ssid_parameter_set) + WIFI_FCS_LEN) {
         return;
     }
+    len -= WIFI_FCS_LEN;
 
-    attached_timestamp_packet_t *ppkt_with_tm = (attached_timestamp_packet_t*) ::operator new(
-            sizeof(attached_timestamp_packet_t) + ppkt->rx_ctrl.sig_len);
-    printf("%2X:%2X:%2X:%2X:%2X:%2X", hdr->addr1[0], hdr->addr1[1], hdr->addr1[2], hdr->addr1[3], hdr->addr1[4], hdr->addr1[5]);
-    ppkt_with_tm->timestamp = timestamp;
-    memcpy(&ppkt_with_tm->packet, ppkt, ppkt->rx_ctrl.sig_len);
-    int res = xRingbufferSend(packetRingBuffer, ppkt_with_tm, ppkt_with_tm->packet.rx_ctrl.sig_len + sizeof(struct tm), 0);
-    if (res != pdTRUE) {
-        ESP_LOGW(TAG, "Error during ringBuffer insertion buffer full\n");
+    // the record is written in place in the ring buffer, time is converted by the consumer
+    sniffed_probe_t *probe;
+    if (xRingbufferSendAcquire(packetRingBuffer, (void **) &probe, sizeof(sniffed_probe_t) + len, 0) != pdTRUE) {
+        handlerDrops++;
     } else {
-        // ESP_LOGD(TAG, "(Core %d) Paket inserted, size: %d", xPortGetCoreID(), ppkt->rx_ctrl.sig_len);
-        ESP_LOGD(TAG, "inserted remaining size %d", xRingbufferGetCurFreeSize(packetRingBuffer));
+        probe->timestamp = esp_timer_get_time();
+        probe->rx_ctrl = ppkt->rx_ctrl;
+        probe->len = len;
+        memcpy(probe->payload, ppkt->payload, len);
+        xRingbufferSendComplete(packetRingBuffer, probe);
+    }
+    handlerCycles += xthal_get_ccount() - start;
+    handlerCalls++;
+}
+
+/* log the average cost of wifi_sniffer_packet_handler since the last call */
+static void report_handler_cost(void)
+{
+    static uint32_t lastCycles, lastCalls, lastDrops;
+    uint32_t cycles = handlerCycles, calls = handlerCalls, drops = handlerDrops;
+
+    if (calls != lastCalls) {
+        uint32_t perCall = (cycles - lastCycles) / (calls - lastCalls);
+        ESP_LOGI(TAG, "sniffer callback: %u probes, %u cycles (%u us) each, %u dropped",
+                calls - lastCalls, perCall, perCall / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, drops - lastDrops);
     }
-    delete ppkt_with_tm;
-    // esp_wifi_set_promiscuous(false);
-    // xSemaphoreGive(chanMutex);
+    lastCycles = cycles;
+    lastCalls = calls;
+    lastDrops = drops;
 }
 
 void esp_initialization() {
@@ -209,6 +225,7 @@ void esp_initialization() {
 void app_main(void)
 {
     int level = 0;
+    uint32_t ticks = 0;
 
     esp_initialization();
     int socket = -1;
@@ -232,5 +249,8 @@ void app_main(void)
             gpio_set_level(GPIO_NUM_2, level);
             level = !level;
             vTaskDelay(500 / portTICK_PERIOD_MS);
+            if (++ticks % HANDLER_REPORT_TICKS == 0) {
+                report_handler_cost();
+            }
     }
 }
@@ -0,0 +1,225 @@
+/**
+ * @file probe_fingerprint.h
+ * @brief Fingerprint of a probe request, the same at every sniffer that heard it
+ *
+ * Sniffers tag each probe request they report with a fingerprint so the
+ * server can tell the same transmission heard by several of them from
+ * different ones. Only the bytes every receiver gets alike are hashed:
+ * the transmitter address, the sequence control field and the complete
+ * information elements, in frame order. The frame control flags (a
+ * sniffer may only hear the retry), the duration, the FCS and an element
+ * cut short by the end of the capture are left out.
+ *
+ * The hash is HalfSipHash-1-3 with a 64-bit key and output: keyed, so
+ * the fingerprints of one deployment cannot be predicted or forged from
+ * outside it, and working on 32-bit words, which the ESP32 handles
+ * natively, unlike MD5's 64-byte blocks. Any probe_fp_hash_t can be
+ * plugged in instead, as long as sniffers and server use the same.
+ *
+ * This header is the implementation. The sniffers under repos/ carry
+ * byte-identical copies, checked by the probe_fingerprint_copy_* tests.
+ */
+
+#ifndef PROBE_FINGERPRINT_H
+#define PROBE_FINGERPRINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROBE_FP_HDR_LEN 24             ///< Management frame MAC header
+#define PROBE_FP_KEY_LEN 8
+
+/**
+ * @brief Key of the tests and the bench, "probefp1"
+ *
+ * Deployments set their own: the sniffers take it from menuconfig as
+ * PROBE_FP_KEY_HEX_LEN hex digits, see probe_fp_key_parse().
+ */
+#define PROBE_FP_KEY_DEFAULT { 0x70, 0x72, 0x6f, 0x62, 0x65, 0x66, 0x70, 0x31 }
+#define PROBE_FP_KEY_HEX_LEN (2 * PROBE_FP_KEY_LEN)
+
+/**
+ * @brief What the fingerprint of a probe request covers
+ */
+typedef struct {
+    const uint8_t *sa;                  ///< 6-byte transmitter address
+    const uint8_t *seq_ctrl;            ///< 2-byte sequence control, as transmitted
+    const uint8_t *ies;                 ///< Complete information elements
+    size_t ies_len;
+} probe_fp_canon_t;
+
+/**
+ * @brief Hash of the canonical parts of a probe request
+ */
+typedef uint64_t (*probe_fp_hash_t)(const uint8_t key[PROBE_FP_KEY_LEN], const probe_fp_canon_t *canon);
+
+/**
+ * @brief Find the parts of a probe request that every receiver gets alike
+ *
+ * @param frame 802.11 frame from its frame control field
+ * @param len Frame length without the FCS
+ * @param canon Filled in on success; points into frame
+ * @return false if frame is not a probe request
+ */
+static inline bool probe_fp_canonicalize(const uint8_t *frame, size_t len, probe_fp_canon_t *canon)
+{
+    if (len < PROBE_FP_HDR_LEN || (frame[0] & 0xFC) != 0x40) {
+        return false;
+    }
+    size_t end = PROBE_FP_HDR_LEN;
+    while (end + 2 <= len && end + 2 + frame[end + 1] <= len) {
+        end += 2 + frame[end + 1];
+    }
+    canon->sa = frame + 10;
+    canon->seq_ctrl = frame + 22;
+    canon->ies = frame + PROBE_FP_HDR_LEN;
+    canon->ies_len = end - PROBE_FP_HDR_LEN;
+    return true;
+}
+
+#define PROBE_FP_ROTL(x, b) (uint32_t)(((x) << (b)) | ((x) >> (32 - (b))))
+
+static inline void probe_fp_round(uint32_t v[4])
+{
+    v[0] += v[1]; v[1] = PROBE_FP_ROTL(v[1], 5); v[1] ^= v[0]; v[0] = PROBE_FP_ROTL(v[0], 16);
+    v[2] += v[3]; v[3] = PROBE_FP_ROTL(v[3], 8); v[3] ^= v[2];
+    v[0] += v[3]; v[3] = PROBE_FP_ROTL(v[3], 7); v[3] ^= v[0];
+    v[2] += v[1]; v[1] = PROBE_FP_ROTL(v[1], 13); v[1] ^= v[2]; v[2] = PROBE_FP_ROTL(v[2], 16);
+}
+
+static inline uint32_t probe_fp_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void probe_fp_absorb(uint32_t v[4], uint32_t m, int rounds)
+{
+    v[3] ^= m;
+    for (int i = 0; i < rounds; i++) {
+        probe_fp_round(v);
+    }
+    v[0] ^= m;
+}
+
+/**
+ * @brief HalfSipHash with 64-bit output of words w0, w1 and then bytes
+ *
+ * The two leading words let the address and sequence control, 8 bytes,
+ * precede the elements without copying them together.
+ */
+static inline uint64_t probe_fp_halfsip(const uint8_t key[PROBE_FP_KEY_LEN], int c_rounds, int d_rounds,
+                                        const uint32_t *words, size_t n_words, const uint8_t *bytes, size_t len)
+{
+    uint32_t k0 = probe_fp_le32(key), k1 = probe_fp_le32(key + 4);
+    uint32_t v[4] = { k0, k1 ^ 0xee, 0x6c796765 ^ k0, 0x74656462 ^ k1 };
+
+    for (size_t i = 0; i < n_words; i++) {
+        probe_fp_absorb(v, words[i], c_rounds);
+    }
+    const uint8_t *end = bytes + (len & ~(size_t)3);
+    for (; bytes != end; bytes += 4) {
+        probe_fp_absorb(v, probe_fp_le32(bytes), c_rounds);
+    }
+    uint32_t b = (uint32_t)(4 * n_words + len) << 24;
+    switch (len & 3) {
+    case 3:
+        b |= (uint32_t)bytes[2] << 16;
+        /* fall through */
+    case 2:
+        b |= (uint32_t)bytes[1] << 8;
+        /* fall through */
+    case 1:
+        b |= bytes[0];
+        break;
+    default:
+        break;
+    }
+    probe_fp_absorb(v, b, c_rounds);
+
+    v[2] ^= 0xee;
+    for (int i = 0; i < d_rounds; i++) {
+        probe_fp_round(v);
+    }
+    uint32_t lo = v[1] ^ v[3];
+    v[1] ^= 0xdd;
+    for (int i = 0; i < d_rounds; i++) {
+        probe_fp_round(v);
+    }
+    uint32_t hi = v[1] ^ v[3];
+    return (uint64_t)hi << 32 | lo;
+}
+
+/**
+ * @brief The default probe_fp_hash_t: HalfSipHash-1-3 of address, sequence control and elements
+ */
+static inline uint64_t probe_fp_hash(const uint8_t key[PROBE_FP_KEY_LEN], const probe_fp_canon_t *canon)
+{
+    const uint32_t head[2] = {
+        probe_fp_le32(canon->sa),
+        (uint32_t)canon->sa[4] | (uint32_t)canon->sa[5] << 8 |
+            (uint32_t)canon->seq_ctrl[0] << 16 | (uint32_t)canon->seq_ctrl[1] << 24,
+    };
+    return probe_fp_halfsip(key, 1, 3, head, 2, canon->ies, canon->ies_len);
+}
+
+/**
+ * @brief Key from its hex form, most significant digit of each byte first
+ *
+ * @param hex Exactly PROBE_FP_KEY_HEX_LEN hex digits, either case
+ * @param key Filled in on success
+ * @return false if hex is not a key, as when left unconfigured
+ */
+static inline bool probe_fp_key_parse(const char *hex, uint8_t key[PROBE_FP_KEY_LEN])
+{
+    uint8_t parsed[PROBE_FP_KEY_LEN] = {0};
+
+    for (size_t i = 0; i < PROBE_FP_KEY_HEX_LEN; i++) {
+        char c = hex[i];
+        uint8_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = (uint8_t)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            digit = (uint8_t)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            digit = (uint8_t)(c - 'A' + 10);
+        } else {
+            return false;
+        }
+        parsed[i / 2] = (uint8_t)(parsed[i / 2] << 4 | digit);
+    }
+    if (hex[PROBE_FP_KEY_HEX_LEN] != '\0') {
+        return false;
+    }
+    for (size_t i = 0; i < PROBE_FP_KEY_LEN; i++) {
+        key[i] = parsed[i];
+    }
+    return true;
+}
+
+/**
+ * @brief Fingerprint of a probe request with the default hash
+ *
+ * @param key PROBE_FP_KEY_LEN bytes
+ * @param frame 802.11 frame from its frame control field
+ * @param len Frame length without the FCS
+ * @return Fingerprint; 0 if frame is not a probe request
+ */
+static inline uint64_t probe_fingerprint(const uint8_t key[PROBE_FP_KEY_LEN], const uint8_t *frame, size_t len)
+{
+    probe_fp_canon_t canon;
+    if (!probe_fp_canonicalize(frame, len, &canon)) {
+        return 0;
+    }
+    return probe_fp_hash(key, &canon);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROBE_FINGERPRINT_H
@@ -27,6 +27,13 @@ int espx_last_socket_errno(int socket) {
     return ret;
 }
 
+void server_address(struct sockaddr_in *serverAddress) {
+    memset(serverAddress, 0, sizeof(*serverAddress));
+    serverAddress->sin_family = AF_INET;
+    inet_pton(AF_INET, SERVER_ADDR, &serverAddress->sin_addr.s_addr);
+    serverAddress->sin_port = htons((u16_t) atoi(SERVER_PORT));
+}
+
 esp_err_t connect_to_server(int *sockPtr, bool handshake) {
     int errCode;
     int ret_conn;
@@ -38,10 +45,7 @@ esp_err_t connect_to_server(int *sockPtr, bool handshake) {
     // wait to be connected on the AP in the case of new connection or connection lost
     xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT,
             false, true, portMAX_DELAY);
-    memset(&serverAddress, 0, sizeof(serverAddress));
-    serverAddress.sin_family = AF_INET;
-    inet_pton(AF_INET, SERVER_ADDR, &serverAddress.sin_addr.s_addr);
-    serverAddress.sin_port = htons((u16_t) atoi(SERVER_PORT));
+    server_address(&serverAddress);
     ESP_LOGI(TAG, "creating socket");
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
@@ -28,6 +28,16 @@ using namespace std;
   */
 ssize_t sendn (int fd, const void *vptr, size_t n, int flags);
 
+/**
+  * @brief     pending error of a socket, as SO_ERROR reports it
+  */
+int espx_last_socket_errno(int socket);
+
+/**
+  * @brief     fill the address of the server SERVER_ADDR on SERVER_PORT
+  */
+void server_address(struct sockaddr_in *serverAddress);
+
 /**
   * @brief     
   *
@@ -4,6 +4,8 @@
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <sys/time.h>
 #include <stdio.h>
 #include <string.h>
 #include "apps/sntp/sntp.h"
@@ -65,6 +67,19 @@ struct tm SynchronizeBoard::getTime(void) {
     return timeinfo;
 }
 
+struct tm SynchronizeBoard::toTime(int64_t monotonicUs) {
+	struct timeval now;
+	struct tm timeinfo;
+
+	// wall clock now, minus the time elapsed since monotonicUs
+	gettimeofday(&now, NULL);
+	int64_t nowUs = (int64_t) now.tv_sec * 1000000 + now.tv_usec;
+	time_t then = (time_t) ((nowUs - (esp_timer_get_time() - monotonicUs)) / 1000000);
+	localtime_r(&then, &timeinfo);
+
+	return timeinfo;
+}
+
 void SynchronizeBoard::tmToCStr(struct tm time, char (&timestampCStr)[64]) {
 	strftime(timestampCStr, sizeof(timestampCStr), "%c", &time);
 }
\ No newline at end of file
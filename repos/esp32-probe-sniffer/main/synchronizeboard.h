@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdint.h>
+#include <time.h>
+
 class SynchronizeBoard
 {
 	static void initialize_sntp(void);
@@ -14,6 +17,14 @@ public:
 	  *    - struct tm containing current time
 	  */  
 	static struct tm getTime(void);
+	/**
+	  * @brief Calendar time at which esp_timer_get_time() returned a given value
+	  *
+	  * @param     monotonicUs	microseconds since boot, as esp_timer_get_time() returns them
+	  * @return    
+	  *    - struct tm containing the time of that instant
+	  */  
+	static struct tm toTime(int64_t monotonicUs);
 	/**
 	  * @brief Convert time passed in tm format to a string human readable format
 	  *
@@ -0,0 +1,7 @@
+#
+# Component Makefile
+#
+
+# Header only
+COMPONENT_SRCDIRS :=
+COMPONENT_ADD_INCLUDEDIRS := .
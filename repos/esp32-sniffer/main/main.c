@@ -26,10 +26,11 @@
 #include "esp_log.h"
 #include "esp_spiffs.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 
 #include "apps/sntp/sntp.h"
 
-#include "md5.h"
+#include "probe_fingerprint.h"
 #include "mqtt_client.h"
 #include "lwip/sockets.h"
 #include "lwip/dns.h"
@@ -51,11 +52,26 @@ static int BLINK_TIME_OFF = 1000; //LED blink time init off
 
  /* --- Some configurations --- */
 #define SSID_MAX_LEN (32+1) //max length of a SSID
-#define MD5_LEN (32+1) //length of md5 hash
 #define BUFFSIZE 1024 //size of buffer used to send data to the server
-#define NROWS 11 //max rows that buffer can have inside send_data, it can be changed modifying BUFFSIZE
 #define MAX_FILES 3 //max number of files in SPIFFS partition
 
+/* --- Segments ---
+ * The sniffer task appends a record per probe request to the open segment file and, at the end
+ * of every sniffing period, hands it over to the Wi-Fi task, which sends it and frees it once the
+ * broker acknowledged all of it. Segments form a ring indexed by sequence number: seg_head (the
+ * open one) is moved only by the sniffer task, seg_tail (the oldest one not acknowledged) only by
+ * the Wi-Fi task, so neither waits for the other */
+#define SEGMENTS 4 //segment files in the ring, a power of two
+#define RECORD_LEN 64 //size of a record, and of the header at the start of a segment
+#define SEGMENT_MAGIC 0x31515250 //"PRQ1"
+#define RECORD_RING_LEN 64 //records between the packet handler and the sniffer task, a power of two
+#define DRAIN_TIME 100 //ms between two writes of the sniffer task
+#define UPLOAD_TIME 1000 //ms the Wi-Fi task sleeps when nothing wakes it
+#define ACK_TIMEOUT 30000 //ms without acknowledgements before the batches in flight are sent again
+#define INFLIGHT_MAX 8 //batches published and not acknowledged yet
+#define ACK_RING_LEN 16 //acknowledged msg_id between the MQTT handler and the Wi-Fi task, a power of two
+#define BATCH_RECORDS ((BUFFSIZE - 128) / RECORD_LEN) //records per message, leaving room for MQTT header and topic
+
 /* TAG of ESP32 for I/O operation */
 static const char *TAG = "ETS";
 /* Always set as true, when a fatal error occurs in task the variable will be set as false */
@@ -66,13 +82,6 @@ static bool ONCE = true;
 static bool WIFI_CONNECTED = false;
 /* True if ESP is connected to the MQTT broker, false otherwise */
 static bool MQTT_CONNECTED = false;
-/* If the variable is true the sniffer_task() will write on FILENAME1, otherwise on FILENAME2
- * The value of this variable is changed only by the function send_data() */
-static bool WHICH_FILE = false;
- /* True when the wifi-task lock a file (to be send) and set the other file for the sniffer-task*/
-static bool FILE_CHANGED = true;
-/* Lock used for mutual exclusion for I/O operation in the files */
-static _lock_t lck_file;
 /* Lock used for MQTT connection to access to the MQTT_CONNECTED variable */
 static _lock_t lck_mqtt;
 
@@ -97,6 +106,75 @@ typedef struct {
 	unsigned char payload[]; //network data
 } __attribute__((packed)) wifi_mgmt_hdr;
 
+/* A sniffed probe request, as saved in the segments and sent to the broker (little endian) */
+typedef struct {
+	uint32_t timestamp;
+	uint8_t sa[6]; //sender address
+	uint16_t sn; //sequence number
+	uint64_t fingerprint; //see probe_fingerprint.h
+	int8_t rssi;
+	uint8_t ssid_len;
+	uint8_t htci[2]; //HT capabilities info
+	char ssid[SSID_MAX_LEN-1]; //not terminated
+	uint8_t reserved[8];
+} __attribute__((packed)) probe_record_t;
+
+/* Start of a segment file, followed by its records */
+typedef struct {
+	uint32_t magic;
+	uint32_t seq; //sequence number of the segment
+	uint32_t tid; //start of its sniffing period
+	uint8_t reserved[RECORD_LEN-12];
+} __attribute__((packed)) segment_hdr_t;
+
+/* Start of each MQTT message, followed by up to BATCH_RECORDS records (little endian) */
+typedef struct {
+	uint32_t tid; //start of the sniffing period
+	uint32_t seq; //segment the records come from
+	uint32_t offset; //of the first record in the segment, to drop messages sent again
+	uint32_t last; //1 if no record of the segment follows
+} __attribute__((packed)) batch_hdr_t;
+
+_Static_assert(sizeof(probe_record_t) == RECORD_LEN, "probe_record_t is the segment and message format");
+_Static_assert(sizeof(segment_hdr_t) == RECORD_LEN, "segment_hdr_t is the segment format");
+
+/* Upload checkpoint, kept in NVS: segments before seq are acknowledged, and seq up to offset */
+typedef struct {
+	uint32_t seq;
+	uint32_t offset;
+} checkpoint_t;
+
+/* A published batch waiting to be acknowledged */
+typedef struct {
+	int msg_id;
+	uint32_t end; //offset in the segment after its records
+	bool acked;
+} inflight_t;
+
+/* Fingerprint key of the deployment, from CONFIG_PROBE_FP_KEY, set before sniffing starts */
+static uint8_t fp_key[PROBE_FP_KEY_LEN];
+
+/* Records the packet handler fills (the only one moving rec_head) and the sniffer task writes (the only one moving rec_tail) */
+static probe_record_t rec_ring[RECORD_RING_LEN];
+static uint32_t rec_head, rec_tail;
+/* Probe requests lost because the sniffer task was behind, written by the packet handler only */
+static uint32_t rec_dropped;
+/* Ring of segments, see SEGMENTS */
+static uint32_t seg_head, seg_tail;
+/* msg_id of acknowledged messages, from the MQTT handler (ack_head) to the Wi-Fi task (ack_tail) */
+static int ack_ring[ACK_RING_LEN];
+static uint32_t ack_head, ack_tail;
+
+/* Upload state, used only by the Wi-Fi task */
+static checkpoint_t ckpt;
+static FILE *up_fp = NULL; //segment seg_tail, open for reading
+static segment_hdr_t up_hdr;
+static uint32_t up_sent; //offset in up_fp of the next record to send
+static bool up_eof; //the last message of the segment was published
+static inflight_t inflight[INFLIGHT_MAX];
+static int inflight_n;
+static TickType_t inflight_since; //last time a message was acknowledged, or the first one published
+
 static esp_err_t event_handler(void *ctx, system_event_t *event);
 static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event);
 
@@ -112,31 +190,40 @@ static void sniffer_task(void *pvParameter);
 static void wifi_sniffer_init(void);
 static void wifi_sniffer_deinit(void);
 static void wifi_sniffer_packet_handler(void *buff, wifi_promiscuous_pkt_type_t type);
-static void get_hash(unsigned char *data, int len_res, char hash[MD5_LEN]);
 static void get_ssid(unsigned char *data, char ssid[SSID_MAX_LEN], uint8_t ssid_len);
 static int get_sn(unsigned char *data);
-static void get_ht_capabilites_info(unsigned char *data, char htci[5], int pkt_len, int ssid_len);
-static void dumb(unsigned char *data, int len);
-static void save_pkt_info(uint8_t address[6], char *ssid, time_t timestamp, char *hash, int8_t rssi, int sn, char htci[5]);
+static void get_ht_capabilites_info(unsigned char *data, uint8_t htci[2], int pkt_len, int ssid_len);
+static void dumb(unsigned char *data, int len) __attribute__((unused)); //debug builds only
 static int get_start_timestamp(void);
+static void records_write(FILE *fp);
+
+static FILE *segments_init(void);
+static FILE *segment_open(uint32_t seq, uint32_t tid);
+static void segment_name(uint32_t seq, char *name, size_t size);
 
 static void wifi_task(void *pvParameter);
 static void wifi_connect_init(void);
 static void wifi_connect_deinit(void);
 static void mqtt_app_start(void);
-static int set_waiting_time(void);
 static void send_data(void);
-static void file_init(char *filename);
+static void acks_collect(void);
+static void checkpoint_save(void);
 
 static void reboot(char *msg_err); //called only by main thread
 
 void app_main(void)
 {
+	FILE *fp; //segment the sniffer task writes first
+
 	ESP_LOGI(TAG, "[+] Startup...");
 
 	ESP_ERROR_CHECK(nvs_flash_init()); //initializing NVS (Non-Volatile Storage)
 	ESP_ERROR_CHECK(esp_event_loop_init(event_handler, NULL)); //initialize (wifi) event handler
 
+	//without the deployment key the server could not match the fingerprints
+	if(!probe_fp_key_parse(CONFIG_PROBE_FP_KEY, fp_key))
+		reboot("PROBE_FP_KEY must be 16 hex digits, set it in menuconfig");
+
 	ESP_LOGI(TAG, "[!] Starting blink task...");
 	xTaskCreate(&blink_task, "blink_task", configMINIMAL_STACK_SIZE, NULL, 5, &xHandle_led);
 	if(xHandle_led == NULL)
@@ -174,13 +261,11 @@ void app_main(void)
 	vfs_spiffs_init(); //initializing virtual file system (SPI Flash File System)
 	time_init(); //initializing time (current data time)
 
-	_lock_init(&lck_file);
 	_lock_init(&lck_mqtt);
-	file_init(CONFIG_FILENAME1);
-	file_init(CONFIG_FILENAME2);
+	fp = segments_init();
 
 	ESP_LOGI(TAG, "[!] Starting sniffing task...");
-	xTaskCreate(&sniffer_task, "sniffig_task", 10000, NULL, 1, &xHandle_sniff);
+	xTaskCreate(&sniffer_task, "sniffig_task", 10000, fp, 1, &xHandle_sniff);
 	if(xHandle_sniff == NULL)
 		reboot("Impossible to create sniffing task");
 
@@ -285,6 +370,13 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(TAG, "[MQTT] EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            //the Wi-Fi task moves the checkpoint, a full ring only delays it until ACK_TIMEOUT
+            if(ack_head - __atomic_load_n(&ack_tail, __ATOMIC_ACQUIRE) < ACK_RING_LEN){
+            	ack_ring[ack_head % ACK_RING_LEN] = event->msg_id;
+            	__atomic_store_n(&ack_head, ack_head + 1, __ATOMIC_RELEASE);
+            }
+            if(xHandle_wifi != NULL)
+            	xTaskNotifyGive(xHandle_wifi);
             break;
 
         case MQTT_EVENT_DATA:
@@ -429,53 +521,105 @@ static void initialize_sntp()
     sntp_init();
 }
 
-static void file_init(char *filename)
+static FILE *segments_init()
 {
-	FILE *fp = fopen(filename, "wb");
+	nvs_handle nvs;
+	size_t len = sizeof(ckpt);
+	segment_hdr_t hdr;
+	uint32_t i, last = 0;
+	bool found = false;
+	char name[64];
+	FILE *fp;
+
+	ckpt.seq = 0;
+	ckpt.offset = RECORD_LEN;
+	if(nvs_open("sniffer", NVS_READONLY, &nvs) == ESP_OK){
+		if(nvs_get_blob(nvs, "checkpoint", &ckpt, &len) != ESP_OK || len != sizeof(ckpt)){
+			ckpt.seq = 0;
+			ckpt.offset = RECORD_LEN;
+		}
+		nvs_close(nvs);
+	}
 
+	/* segments of the previous run not acknowledged yet, the one open at reboot
+	 * included, are sent first; what the broker acknowledged is never sent again */
+	for(i=0; i<SEGMENTS; i++){
+		segment_name(i, name, sizeof(name));
+		fp = fopen(name, "rb");
+		if(fp == NULL)
+			continue;
+		if(fread(&hdr, sizeof(hdr), 1, fp) == 1 && hdr.magic == SEGMENT_MAGIC && hdr.seq % SEGMENTS == i &&
+				(int32_t)(hdr.seq - ckpt.seq) >= 0 && (!found || (int32_t)(hdr.seq - last) > 0)){
+			last = hdr.seq;
+			found = true;
+		}
+		fclose(fp);
+	}
+	seg_tail = ckpt.seq;
+	seg_head = found ? last + 1 : ckpt.seq;
+	ESP_LOGI(TAG, "Segments %u to %u to send, from offset %u", seg_tail, seg_head, ckpt.offset);
+
+	if(seg_head - seg_tail < SEGMENTS) //one slot is for the segment the sniffer task writes
+		return segment_open(seg_head, get_start_timestamp());
+
+	//all of them wait: the last one, open at reboot, is not closed but written further
+	seg_head = last;
+	segment_name(seg_head, name, sizeof(name));
+	fp = fopen(name, "ab");
 	if(fp == NULL){
 		RUNNING = false;
-		ESP_LOGE(TAG, "Error creating or initializing file %s", filename);
-		return;
+		ESP_LOGE(TAG, "Error opening file %s", name);
 	}
+	return fp;
+}
 
-	ESP_LOGI(TAG, "File %s initialized", filename);
+static void segment_name(uint32_t seq, char *name, size_t size)
+{
+	snprintf(name, size, "%s%u.seg", CONFIG_SEGMENT_PREFIX, seq % SEGMENTS);
+}
+
+static FILE *segment_open(uint32_t seq, uint32_t tid)
+{
+	segment_hdr_t hdr = { .magic = SEGMENT_MAGIC, .seq = seq, .tid = tid };
+	char name[64];
+	FILE *fp;
 
-	fclose(fp);
+	segment_name(seq, name, sizeof(name));
+	fp = fopen(name, "wb");
+	if(fp == NULL || fwrite(&hdr, sizeof(hdr), 1, fp) != 1){
+		RUNNING = false;
+		ESP_LOGE(TAG, "Error creating or initializing file %s", name);
+		if(fp != NULL)
+			fclose(fp);
+		return NULL;
+	}
+
+	return fp;
 }
 
 static void wifi_task(void *pvParameter)
 {
-	int st = CONFIG_SNIFFING_TIME*1000;
+	bool connected;
 
 	ESP_LOGI(TAG, "[WIFI] Wi-Fi task created");
 
 	mqtt_app_start();
 
 	while(true){
-		st = set_waiting_time(); //wait until the current minute ends
-		vTaskDelay(st / portTICK_PERIOD_MS);
+		//woken by the sniffer task when a segment is ready and by the MQTT handler on acknowledgements
+		ulTaskNotifyTake(pdTRUE, UPLOAD_TIME / portTICK_PERIOD_MS);
 
 		_lock_acquire(&lck_mqtt);
-		if(MQTT_CONNECTED)
+		connected = MQTT_CONNECTED;
+		_lock_release(&lck_mqtt);
+
+		if(connected)
 			send_data();
-		else
+		else if(seg_head - seg_tail == SEGMENTS - 1)
 			ESP_LOGW(TAG, "[WI-FI] Impossible send data to %s. ESP32 is not connected to the broker", CONFIG_BROKER_ADDR);
-		_lock_release(&lck_mqtt);
 	}
 }
 
-static int set_waiting_time()
-{
-	int st;
-	time_t t;
-
-	time(&t);
-	st = (CONFIG_SNIFFING_TIME - (int)t % CONFIG_SNIFFING_TIME) * 1000;
-
-	return st;
-}
-
 static void wifi_connect_init()
 {
 	esp_log_level_set("wifi", ESP_LOG_NONE); //disable the default wifi logging
@@ -533,90 +677,137 @@ static void mqtt_app_start()
 
 static void send_data()
 {
-	FILE *fp = NULL;
-	int msg_id, tid;
-	int sending = true, reading = true, tot_read = 0, n = 1;
-	char *topic, buffer[BUFFSIZE], last_pkt = 'F';
-	ssize_t len = strlen(CONFIG_ETS)+strlen(CONFIG_ROOM)+strlen(CONFIG_ESP32_ID)+1;
-
-	_lock_acquire(&lck_file);
-	if(WHICH_FILE){
-		WHICH_FILE = false;
-		FILE_CHANGED = true;
-		fp = fopen(CONFIG_FILENAME1, "r");
-		if(fp == NULL){
-			RUNNING = false;
-			ESP_LOGE(TAG, "[WI-FI] Impossible to open file %s and read information", CONFIG_FILENAME1);
-			return;
-		}
+	static const char topic[] = CONFIG_ETS "/" CONFIG_ROOM "/" CONFIG_ESP32_ID;
+	static uint8_t buffer[sizeof(batch_hdr_t) + BATCH_RECORDS*RECORD_LEN];
+	batch_hdr_t *hdr = (batch_hdr_t *)buffer;
+	int msg_id;
+	size_t n;
+
+	acks_collect();
+
+	//nothing acknowledged for too long (broker or connection lost): send again from the checkpoint
+	if(inflight_n > 0 && xTaskGetTickCount() - inflight_since >= ACK_TIMEOUT / portTICK_PERIOD_MS){
+		ESP_LOGW(TAG, "[WI-FI] %d messages not acknowledged, sending again from offset %u", inflight_n, ckpt.offset);
+		inflight_n = 0;
+		up_sent = ckpt.offset;
+		up_eof = false;
+		fseek(up_fp, up_sent, SEEK_SET);
 	}
-	else{
-		WHICH_FILE = true;
-		FILE_CHANGED = true;
-		fp = fopen(CONFIG_FILENAME2, "r");
-		if(fp == NULL){
-			RUNNING = false;
-			ESP_LOGE(TAG, "[WI-FI] Impossible to open file %s and read information", CONFIG_FILENAME2);
+
+	while(inflight_n < INFLIGHT_MAX){
+		if(up_fp == NULL){
+			char name[64];
+
+			if(seg_tail == __atomic_load_n(&seg_head, __ATOMIC_ACQUIRE))
+				return; //the sniffer task is still writing the next segment
+
+			segment_name(seg_tail, name, sizeof(name));
+			up_fp = fopen(name, "rb");
+			if(up_fp == NULL || fread(&up_hdr, sizeof(up_hdr), 1, up_fp) != 1 ||
+					up_hdr.magic != SEGMENT_MAGIC || up_hdr.seq != seg_tail){
+				ESP_LOGE(TAG, "[WI-FI] Segment %u missing or damaged, skipped", seg_tail);
+				if(up_fp != NULL)
+					fclose(up_fp);
+				up_fp = NULL;
+				ckpt.seq = seg_tail + 1;
+				ckpt.offset = RECORD_LEN;
+				checkpoint_save();
+				__atomic_store_n(&seg_tail, seg_tail + 1, __ATOMIC_RELEASE);
+				continue;
+			}
+			//ckpt.seq is seg_tail: resume after what the broker already has
+			up_sent = ckpt.offset;
+			up_eof = false;
+			if(up_sent != RECORD_LEN)
+				fseek(up_fp, up_sent, SEEK_SET);
+			if(inflight_n == 0)
+				inflight_since = xTaskGetTickCount();
+			ESP_LOGI(TAG, "[WI-FI] Sending information about sniffed packets to %s:%d", CONFIG_BROKER_ADDR, CONFIG_BROKER_PORT);
+		}
+		if(up_eof)
+			return; //waiting for the segment to be acknowledged
+
+		//records straight from the segment, as many as a message holds
+		n = fread(buffer + sizeof(batch_hdr_t), RECORD_LEN, BATCH_RECORDS, up_fp);
+		up_eof = n < BATCH_RECORDS;
+		hdr->tid = up_hdr.tid;
+		hdr->seq = up_hdr.seq;
+		hdr->offset = up_sent;
+		hdr->last = up_eof;
+
+		msg_id = esp_mqtt_client_publish(client, topic, (const char *)buffer, sizeof(batch_hdr_t) + n*RECORD_LEN, 1, 0);
+		if(msg_id < 0){
+			ESP_LOGW(TAG, "[WI-FI] Publish failed on topic=%s, trying again later", topic);
+			up_eof = false;
+			fseek(up_fp, up_sent, SEEK_SET);
 			return;
 		}
+		if(inflight_n == 0)
+			inflight_since = xTaskGetTickCount();
+		up_sent += n*RECORD_LEN;
+		inflight[inflight_n].msg_id = msg_id;
+		inflight[inflight_n].end = up_sent;
+		inflight[inflight_n].acked = false;
+		inflight_n++;
+		ESP_LOGI(TAG, "[WI-FI] Sent publish successful on topic=%s, msg_id=%d", topic, msg_id);
 	}
-	_lock_release(&lck_file);
-
-	topic = malloc(len*sizeof(char));
-	memset(topic, '\0', len);
-	strcpy(topic, CONFIG_ETS);
-	strcat(topic, "/");
-	strcat(topic, CONFIG_ROOM);
-	strcat(topic, "/");
-	strcat(topic, CONFIG_ESP32_ID);
-
-	fscanf(fp, "%d", &tid);
-
-	ESP_LOGI(TAG, "[WI-FI] Sending information about sniffed packets to %s:%d", CONFIG_BROKER_ADDR, CONFIG_BROKER_PORT);
-	while(sending){
-		n = 1;
-		tot_read = 0;
-		memset(buffer, '\0', BUFFSIZE);
-
-		sprintf(buffer, "%c %d\n", last_pkt, tid); //sending also information about if it is last packet or not
-		tot_read = strlen(buffer);
-
-		reading = true;
-		while(fgets(buffer+tot_read, BUFFSIZE, fp) != NULL && reading){
-			n++;
-			tot_read = strlen(buffer);
-			if(n >= NROWS)
-				reading = false; //stop reading because buffer is full
-		}
+}
 
-		if(reading){ //finished to read file
-			last_pkt = 'T'; //set as TRUE last packet -> next send is the last
-			buffer[0] = last_pkt;
-			sending = false;
+static void acks_collect()
+{
+	uint32_t head = __atomic_load_n(&ack_head, __ATOMIC_ACQUIRE);
+	bool advanced = false, segment_done;
+	int i, done;
+
+	for(; ack_tail != head; __atomic_store_n(&ack_tail, ack_tail + 1, __ATOMIC_RELEASE)){
+		for(i=0; i<inflight_n; i++){
+			if(inflight[i].msg_id == ack_ring[ack_tail % ACK_RING_LEN])
+				inflight[i].acked = true;
 		}
-		//else -> i need at least one more cycle to finish to read the file
-
-		msg_id = esp_mqtt_client_publish(client, topic, buffer, strlen(buffer), 0, 0);
-		ESP_LOGI(TAG, "[WI-FI] Sent publish successful on topic=%s, msg_id=%d", topic, msg_id);
 	}
 
-	_lock_acquire(&lck_file);
-	if(WHICH_FILE){
-		fclose(fp);
-		file_init(CONFIG_FILENAME2);
+	//the checkpoint moves only over messages acknowledged without gaps
+	for(done=0; done<inflight_n && inflight[done].acked; done++)
+		ckpt.offset = inflight[done].end;
+	if(done > 0){
+		memmove(inflight, inflight + done, (inflight_n - done)*sizeof(inflight_t));
+		inflight_n -= done;
+		inflight_since = xTaskGetTickCount();
+		advanced = true;
 	}
-	else{
-		fclose(fp);
-		file_init(CONFIG_FILENAME1);
+
+	segment_done = up_fp != NULL && up_eof && inflight_n == 0;
+	if(segment_done){
+		fclose(up_fp);
+		up_fp = NULL;
+		ckpt.seq = seg_tail + 1;
+		ckpt.offset = RECORD_LEN;
+		advanced = true;
 	}
-	_lock_release(&lck_file);
+	if(advanced)
+		checkpoint_save();
+	//saved before the sniffer task may reuse the slot of the segment
+	if(segment_done)
+		__atomic_store_n(&seg_tail, seg_tail + 1, __ATOMIC_RELEASE);
+}
 
-	free(topic);
+static void checkpoint_save()
+{
+	nvs_handle nvs;
+
+	if(nvs_open("sniffer", NVS_READWRITE, &nvs) != ESP_OK){
+		ESP_LOGE(TAG, "[WI-FI] Impossible to open NVS and save the upload checkpoint");
+		return;
+	}
+	if(nvs_set_blob(nvs, "checkpoint", &ckpt, sizeof(ckpt)) != ESP_OK || nvs_commit(nvs) != ESP_OK)
+		ESP_LOGE(TAG, "[WI-FI] Impossible to save the upload checkpoint");
+	nvs_close(nvs);
 }
 
 static void sniffer_task(void *pvParameter)
 {
-	int sleep_time = CONFIG_SNIFFING_TIME*1000;
+	uint32_t tid = get_start_timestamp(), now_tid, dropped = 0;
+	FILE *fp = pvParameter; //open segment, from segments_init()
 
 	ESP_LOGI(TAG, "[SNIFFER] Sniffer task created");
 
@@ -625,20 +816,32 @@ static void sniffer_task(void *pvParameter)
 	ESP_LOGI(TAG, "[SNIFFER] Started. Sniffing on channel %d", CONFIG_CHANNEL);
 
 	while(true){
-		vTaskDelay(sleep_time / portTICK_PERIOD_MS);
-    	_lock_acquire(&lck_mqtt);
-		/* if ESP is not connected to the broker
-		 * -> need to reset file after 1 minutes, because wifi-task will not ever send it and initialize it */
-		if(!MQTT_CONNECTED){
-			ESP_LOGW(TAG, "[SNIFFER] Initializing file...");
-			_lock_acquire(&lck_file);
-			if(WHICH_FILE)
-				file_init(CONFIG_FILENAME1);
-			else
-				file_init(CONFIG_FILENAME2);
-			_lock_release(&lck_file);
+		vTaskDelay(DRAIN_TIME / portTICK_PERIOD_MS);
+		records_write(fp);
+
+		now_tid = get_start_timestamp();
+		if(now_tid == tid)
+			continue;
+
+		//sniffing period over: close the segment and start the next one
+		tid = now_tid;
+		if(rec_dropped != dropped){
+			ESP_LOGW(TAG, "[SNIFFER] %u probe requests lost, the packet handler was too fast", rec_dropped - dropped);
+			dropped = rec_dropped;
+		}
+		if(fp != NULL)
+			fclose(fp);
+		if(seg_head + 1 - __atomic_load_n(&seg_tail, __ATOMIC_ACQUIRE) < SEGMENTS){
+			__atomic_store_n(&seg_head, seg_head + 1, __ATOMIC_RELEASE);
+			if(xHandle_wifi != NULL)
+				xTaskNotifyGive(xHandle_wifi);
 		}
-    	_lock_release(&lck_mqtt);
+		else{
+			/* if ESP is not connected to the broker the segments are not sent:
+			 * when all of them wait, the one just sniffed is discarded */
+			ESP_LOGW(TAG, "[SNIFFER] No segment free, discarding segment %u", seg_head);
+		}
+		fp = segment_open(seg_head, tid);
 	}
 }
 
@@ -679,10 +882,10 @@ static void wifi_sniffer_deinit()
 
 static void wifi_sniffer_packet_handler(void* buff, wifi_promiscuous_pkt_type_t type)
 {
-	int pkt_len, fc, sn=0;
-	char ssid[SSID_MAX_LEN] = "\0", hash[MD5_LEN] = "\0", htci[5] = "\0";
+	int pkt_len, fc;
+	char ssid[SSID_MAX_LEN] = "\0";
 	uint8_t ssid_len;
-	time_t ts;
+	probe_record_t *rec;
 
 	wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buff;
 	wifi_mgmt_hdr *mgmt = (wifi_mgmt_hdr *)pkt->payload;
@@ -690,53 +893,41 @@ static void wifi_sniffer_packet_handler(void* buff, wifi_promiscuous_pkt_type_t
 	fc = ntohs(mgmt->fctl);
 
 	if((fc & 0xFF00) == 0x4000){ //only look for probe request packets
-		time(&ts);
+		//the record is filled in place, the sniffer task writes it to the segment
+		if(rec_head - __atomic_load_n(&rec_tail, __ATOMIC_ACQUIRE) == RECORD_RING_LEN){
+			rec_dropped++;
+			return;
+		}
+		rec = &rec_ring[rec_head % RECORD_RING_LEN];
+		memset(rec, 0, sizeof(*rec));
+
+		rec->timestamp = (uint32_t)time(NULL);
 
 		ssid_len = pkt->payload[25];
+		rec->ssid_len = ssid_len < SSID_MAX_LEN ? ssid_len : SSID_MAX_LEN-1;
 		if(ssid_len > 0)
-			get_ssid(pkt->payload, ssid, ssid_len);
+			get_ssid(pkt->payload, ssid, rec->ssid_len);
+		memcpy(rec->ssid, ssid, rec->ssid_len);
 
 		pkt_len = pkt->rx_ctrl.sig_len;
-		get_hash(pkt->payload, pkt_len-4, hash);
+		//same value the other sniffers and the server compute for this transmission
+		rec->fingerprint = probe_fingerprint(fp_key, pkt->payload, pkt_len-4);
 
-		if(CONFIG_VERBOSE){
-			ESP_LOGI(TAG, "Dump");
-			dumb(pkt->payload, pkt_len);
-		}
+#if CONFIG_LOG_DEFAULT_LEVEL >= 4 //ESP_LOG_DEBUG, the enum is not seen by the preprocessor
+		//the raw frame is only here, a debug build dumps it from the handler
+		ESP_LOGD(TAG, "Dump");
+		dumb(pkt->payload, pkt_len);
+#endif
 
-		sn = get_sn(pkt->payload);
-
-		get_ht_capabilites_info(pkt->payload, htci, pkt_len, ssid_len);
-
-		ESP_LOGI(TAG, "ADDR=%02x:%02x:%02x:%02x:%02x:%02x, "
-				"SSID=%s, "
-				"TIMESTAMP=%d, "
-				"HASH=%s, "
-				"RSSI=%02d, "
-				"SN=%d, "
-				"HT CAP. INFO=%s",
-				mgmt->sa[0], mgmt->sa[1], mgmt->sa[2], mgmt->sa[3], mgmt->sa[4], mgmt->sa[5],
-				ssid,
-				(int)ts,
-				hash,
-				pkt->rx_ctrl.rssi,
-				sn,
-				htci);
-
-		save_pkt_info(mgmt->sa, ssid, ts, hash, pkt->rx_ctrl.rssi, sn, htci);
-	}
-}
+		rec->sn = get_sn(pkt->payload);
 
-static void get_hash(unsigned char *data, int len_res, char hash[MD5_LEN])
-{
-	uint8_t pkt_hash[16];
+		get_ht_capabilites_info(pkt->payload, rec->htci, pkt_len, ssid_len);
 
-	md5((uint8_t *)data, len_res, pkt_hash);
+		memcpy(rec->sa, mgmt->sa, sizeof(rec->sa));
+		rec->rssi = pkt->rx_ctrl.rssi;
 
-	sprintf(hash, "%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
-			pkt_hash[0], pkt_hash[1], pkt_hash[2], pkt_hash[3], pkt_hash[4], pkt_hash[5],
-			pkt_hash[6], pkt_hash[7], pkt_hash[8], pkt_hash[9], pkt_hash[10], pkt_hash[11],
-			pkt_hash[12], pkt_hash[13], pkt_hash[14], pkt_hash[15]);
+		__atomic_store_n(&rec_head, rec_head + 1, __ATOMIC_RELEASE);
+	}
 }
 
 static void get_ssid(unsigned char *data, char ssid[SSID_MAX_LEN], uint8_t ssid_len)
@@ -761,7 +952,7 @@ static int get_sn(unsigned char *data)
     return sn;
 }
 
-static void get_ht_capabilites_info(unsigned char *data, char htci[5], int pkt_len, int ssid_len)
+static void get_ht_capabilites_info(unsigned char *data, uint8_t htci[2], int pkt_len, int ssid_len)
 {
 	int ht_start = 25+ssid_len+19;
 
@@ -771,9 +962,9 @@ static void get_ht_capabilites_info(unsigned char *data, char htci[5], int pkt_l
 
 	if(data[ht_start-1]>0 && ht_start<pkt_len-4){ //HT capabilities is present
 		if(data[ht_start-4] == 1) //DSSS parameter is set -> need to shift of three bytes
-			sprintf(htci, "%02x%02x", data[ht_start+3], data[ht_start+1+3]);
-		else
-			sprintf(htci, "%02x%02x", data[ht_start], data[ht_start+1]);
+			ht_start += 3;
+		htci[0] = data[ht_start];
+		htci[1] = data[ht_start+1];
 	}
 }
 
@@ -801,38 +992,45 @@ static void dumb(unsigned char *data, int len)
 	}
 }
 
-static void save_pkt_info(uint8_t address[6], char *ssid, time_t timestamp, char *hash, int8_t rssi, int sn, char htci[5])
+static void records_write(FILE *fp)
 {
-	FILE *fp = NULL;
-	int stime;
-
-	_lock_acquire(&lck_file);
-	if(WHICH_FILE)
-		fp = fopen(CONFIG_FILENAME1, "a");
-	else
-		fp = fopen(CONFIG_FILENAME2, "a");
-	_lock_release(&lck_file);
-
-	if(fp == NULL){
-		ESP_LOGE(TAG, "[SNIFFER] Impossible to open file and save information about sniffed packets");
+	uint32_t head = __atomic_load_n(&rec_head, __ATOMIC_ACQUIRE);
+	uint32_t n;
+	probe_record_t *rec;
+
+	//logged here and not in the packet handler, which runs in the Wi-Fi task
+	if(CONFIG_VERBOSE){
+		for(n=rec_tail; n!=head; n++){
+			rec = &rec_ring[n % RECORD_RING_LEN];
+			ESP_LOGI(TAG, "ADDR=%02x:%02x:%02x:%02x:%02x:%02x, "
+					"SSID=%.*s, "
+					"TIMESTAMP=%d, "
+					"HASH=%016llx, "
+					"RSSI=%02d, "
+					"SN=%d, "
+					"HT CAP. INFO=%02x%02x",
+					rec->sa[0], rec->sa[1], rec->sa[2], rec->sa[3], rec->sa[4], rec->sa[5],
+					rec->ssid_len, rec->ssid,
+					(int)rec->timestamp,
+					(unsigned long long)rec->fingerprint,
+					rec->rssi,
+					rec->sn,
+					rec->htci[0], rec->htci[1]);
+		}
 	}
 
-	if(FILE_CHANGED){
-		FILE_CHANGED = false;
-		stime = get_start_timestamp();
-		fprintf(fp, "%d\n", stime);
+	//at most two writes: up to the end of the ring, then from its start
+	while(rec_tail != head){
+		n = head - rec_tail;
+		if(n > RECORD_RING_LEN - rec_tail % RECORD_RING_LEN)
+			n = RECORD_RING_LEN - rec_tail % RECORD_RING_LEN;
+		if(fp != NULL && fwrite(&rec_ring[rec_tail % RECORD_RING_LEN], RECORD_LEN, n, fp) != n)
+			ESP_LOGE(TAG, "[SNIFFER] Impossible to save information about sniffed packets");
+		__atomic_store_n(&rec_tail, rec_tail + n, __ATOMIC_RELEASE);
 	}
-
-	fprintf(fp, "%02x:%02x:%02x:%02x:%02x:%02x %s %d %s %02d %d %s\n",
-			address[0], address[1], address[2], address[3], address[4], address[5],
-			ssid,
-			(int)timestamp,
-			hash,
-			rssi,
-			sn,
-			htci);
-
-	fclose(fp);
+	//on flash before a reboot can happen, the segment is sent anyway
+	if(fp != NULL)
+		fflush(fp);
 }
 
 static int get_start_timestamp()